@@ -4,24 +4,47 @@
 
 #include "chaps/chaps_adaptor.h"
 
+#include <dbus/dbus.h>
+#include <string.h>
+
+#include <base/bind.h>
 #include <base/files/file_path.h>
 #include <base/logging.h>
-#include <base/synchronization/lock.h>
 
 #include "chaps/chaps.h"
 #include "chaps/chaps_interface.h"
 #include "chaps/chaps_utility.h"
+#include "chaps/latency_stats.h"
+#include "chaps/read_write_lock.h"
+#include "chaps/request_dispatcher.h"
+#include "chaps/slot_locks.h"
+#include "chaps/slot_manager.h"
 #include "chaps/token_manager_interface.h"
 
-using base::AutoLock;
 using base::FilePath;
-using base::Lock;
 using brillo::SecureBlob;
 using std::string;
 using std::vector;
 
 namespace chaps {
 
+namespace {
+
+// Methods whose first argument after the isolate credential is a slot ID. For
+// all other methods with a uint64 there, it is a session ID.
+const char* const kSlotMethods[] = {
+  "GetTokenPath",
+  "GetSlotInfo",
+  "GetTokenInfo",
+  "GetMechanismList",
+  "GetMechanismInfo",
+  "InitToken",
+  "OpenSession",
+  "CloseAllSessions"
+};
+
+}  // namespace
+
 // Helper used when calling the ObjectAdaptor constructor.
 static DBus::Connection& GetConnection() {
   static DBus::Connection connection = DBus::Connection::SystemBus();
@@ -33,22 +56,98 @@ static DBus::Connection& GetConnection() {
   return connection;
 }
 
-ChapsAdaptor::ChapsAdaptor(Lock* lock,
+ChapsAdaptor::ChapsAdaptor(ReadWriteLock* lock,
                            ChapsInterface* service,
-                           TokenManagerInterface* token_manager)
-    : DBus::ObjectAdaptor(GetConnection(),
+                           TokenManagerInterface* token_manager,
+                           SlotManager* slot_manager,
+                           RequestDispatcher* dispatcher)
+    : ChapsAdaptor(&GetConnection(), lock, service, token_manager,
+                   slot_manager, dispatcher) {}
+
+ChapsAdaptor::ChapsAdaptor(DBus::Connection* connection,
+                           ReadWriteLock* lock,
+                           ChapsInterface* service,
+                           TokenManagerInterface* token_manager,
+                           SlotManager* slot_manager,
+                           RequestDispatcher* dispatcher)
+    : DBus::ObjectAdaptor(*connection,
                           DBus::Path(kChapsServicePath)),
       lock_(lock),
       service_(service),
-      token_manager_(token_manager) {}
+      token_manager_(token_manager),
+      slot_manager_(slot_manager),
+      dispatcher_(dispatcher),
+      slot_locks_(lock, slot_manager) {}
+
+ChapsAdaptor::~ChapsAdaptor() {
+  if (dispatcher_)
+    dispatcher_->Stop();
+}
+
+bool ChapsAdaptor::handle_message(const DBus::Message& message) {
+  if (message.type() != DBUS_MESSAGE_TYPE_METHOD_CALL)
+    return false;
+  // This is how DBus::ObjectAdaptor gets at the call, too.
+  const DBus::CallMessage& call =
+      reinterpret_cast<const DBus::CallMessage&>(message);
+  if (!find_interface(call.interface()))
+    return false;
+  if (!dispatcher_) {
+    HandleCall(call);
+    return true;
+  }
+  dispatcher_->Post(GetDispatchKey(call),
+                    base::Bind(&ChapsAdaptor::HandleCall,
+                               base::Unretained(this),
+                               call));
+  return true;
+}
+
+void ChapsAdaptor::HandleCall(const DBus::CallMessage& call) {
+  DBus::InterfaceAdaptor* interface = find_interface(call.interface());
+  CHECK(interface);
+  try {
+    conn().send(interface->dispatch_method(call));
+  } catch (DBus::Error err) {
+    conn().send(DBus::ErrorMessage(call, err.name(), err.message()));
+  }
+}
 
-ChapsAdaptor::~ChapsAdaptor() {}
+uint64_t ChapsAdaptor::GetDispatchKey(const DBus::CallMessage& call) {
+  DBus::MessageIter reader = call.reader();
+  if (reader.at_end() || reader.type() != DBUS_TYPE_ARRAY)
+    return RequestDispatcher::kGlobalKey;
+  ++reader;
+  if (reader.at_end() || reader.type() != DBUS_TYPE_UINT64)
+    return RequestDispatcher::kGlobalKey;
+  uint64_t id = reader.get_uint64();
+  for (size_t i = 0; i < arraysize(kSlotMethods); ++i) {
+    if (strcmp(call.member(), kSlotMethods[i]) == 0)
+      return RequestDispatcher::GetSlotKey(id);
+  }
+  return RequestDispatcher::GetSessionKey(id);
+}
+
+bool ChapsAdaptor::HasStaleKeys(uint64_t session_id, int* slot_id) {
+  return slot_manager_ &&
+         slot_manager_->GetSessionSlot(static_cast<int>(session_id),
+                                       slot_id) &&
+         slot_manager_->HasStaleKeys(*slot_id);
+}
+
+void ChapsAdaptor::RemoveStaleKeys(int slot_id) {
+  // Other calls on the slot may hold pointers to the objects, so they are
+  // removed only once the slot is ours alone.
+  AutoSlotLock lock(&slot_locks_, slot_id, AutoSlotLock::kWrite);
+  slot_manager_->RemoveStaleKeys(slot_id);
+}
 
 void ChapsAdaptor::OpenIsolate(
       const std::vector<uint8_t>& isolate_credential_in,
       std::vector<uint8_t>& isolate_credential_out,  // NOLINT - refs
       bool& new_isolate_created,  // NOLINT(runtime/references)
       bool& result) {  // NOLINT(runtime/references)
+  AutoWriteLock lock(*lock_);
   VLOG(1) << "CALL: " << __func__;
   result = false;
   SecureBlob isolate_credential(isolate_credential_in.begin(),
@@ -71,7 +170,7 @@ void ChapsAdaptor::OpenIsolate(
 }
 
 void ChapsAdaptor::CloseIsolate(const vector<uint8_t>& isolate_credential) {
-  AutoLock lock(*lock_);
+  AutoWriteLock lock(*lock_);
   VLOG(1) << "CALL: " << __func__;
   SecureBlob isolate_credential_blob(isolate_credential.begin(),
                                      isolate_credential.end());
@@ -91,7 +190,7 @@ void ChapsAdaptor::LoadToken(const vector<uint8_t>& isolate_credential,
                              const string& label,
                              uint64_t& slot_id,  // NOLINT(runtime/references)
                              bool& result) {  // NOLINT(runtime/references)
-  AutoLock lock(*lock_);
+  AutoWriteLock lock(*lock_);
   VLOG(1) << "CALL: " << __func__;
   SecureBlob isolate_credential_blob(isolate_credential.begin(),
                                      isolate_credential.end());
@@ -118,7 +217,7 @@ void ChapsAdaptor::LoadToken(const vector<uint8_t>& isolate_credential,
 
 void ChapsAdaptor::UnloadToken(const vector<uint8_t>& isolate_credential,
                                const string& path) {
-  AutoLock lock(*lock_);
+  AutoWriteLock lock(*lock_);
   VLOG(1) << "CALL: " << __func__;
   SecureBlob isolate_credential_blob(isolate_credential.begin(),
                                      isolate_credential.end());
@@ -136,7 +235,7 @@ void ChapsAdaptor::UnloadToken(const vector<uint8_t>& isolate_credential,
 void ChapsAdaptor::ChangeTokenAuthData(const string& path,
                                        const vector<uint8_t>& old_auth_data,
                                        const vector<uint8_t>& new_auth_data) {
-  AutoLock lock(*lock_);
+  AutoWriteLock lock(*lock_);
   VLOG(1) << "CALL: " << __func__;
   if (token_manager_)
     token_manager_->ChangeTokenAuthData(
@@ -158,7 +257,7 @@ void ChapsAdaptor::GetTokenPath(const std::vector<uint8_t>& isolate_credential,
                                 const uint64_t& slot_id,
                                 std::string& path,  // NOLINT - refs
                                 bool& result) {  // NOLINT(runtime/references)
-  AutoLock lock(*lock_);
+  AutoReadLock lock(*lock_);
   VLOG(1) << "CALL: " << __func__;
   SecureBlob isolate_credential_blob(isolate_credential.begin(),
                                      isolate_credential.end());
@@ -189,11 +288,20 @@ void ChapsAdaptor::SetLogLevel(const int32_t& level,
   SetLogLevel(level);
 }
 
+string ChapsAdaptor::GetLatencyStats() {
+  VLOG(1) << "CALL: " << __func__;
+  return LatencyStats::GetInstance()->Dump();
+}
+
+string ChapsAdaptor::GetLatencyStats(::DBus::Error& /*error*/) {
+  return GetLatencyStats();
+}
+
 void ChapsAdaptor::GetSlotList(const vector<uint8_t>& isolate_credential,
                                const bool& token_present,
                                vector<uint64_t>& slot_list,  // NOLINT - refs
                                uint32_t& result) {  // NOLINT - refs
-  AutoLock lock(*lock_);
+  AutoReadLock lock(*lock_);
   VLOG(1) << "CALL: " << __func__;
   VLOG(2) << "IN: " << "token_present=" << token_present;
   SecureBlob isolate_credential_blob(isolate_credential.begin(),
@@ -223,7 +331,7 @@ void ChapsAdaptor::GetSlotInfo(const vector<uint8_t>& isolate_credential,
                                uint8_t& firmware_version_major,  // NOLINT - refs
                                uint8_t& firmware_version_minor,  // NOLINT - refs
                                uint32_t& result) {  // NOLINT - refs
-  AutoLock lock(*lock_);
+  AutoReadLock lock(*lock_);
   VLOG(1) << "CALL: " << __func__;
   VLOG(2) << "IN: " << "slot_id=" << slot_id;
   SecureBlob isolate_credential_blob(isolate_credential.begin(),
@@ -281,7 +389,7 @@ void ChapsAdaptor::GetTokenInfo(const vector<uint8_t>& isolate_credential,
                                 uint8_t& firmware_version_major,  // NOLINT - refs
                                 uint8_t& firmware_version_minor,  // NOLINT - refs
                                 uint32_t& result) {  // NOLINT - refs
-  AutoLock lock(*lock_);
+  AutoReadLock lock(*lock_);
   VLOG(1) << "CALL: " << __func__;
   VLOG(2) << "IN: " << "slot_id=" << slot_id;
   SecureBlob isolate_credential_blob(isolate_credential.begin(),
@@ -348,7 +456,7 @@ void ChapsAdaptor::GetMechanismList(const vector<uint8_t>& isolate_credential,
                                     const uint64_t& slot_id,
                                     vector<uint64_t>& mechanism_list,  // NOLINT - refs
                                     uint32_t& result) {  // NOLINT - refs
-  AutoLock lock(*lock_);
+  AutoReadLock lock(*lock_);
   VLOG(1) << "CALL: " << __func__;
   VLOG(2) << "IN: " << "slot_id=" << slot_id;
   SecureBlob isolate_credential_blob(isolate_credential.begin(),
@@ -376,7 +484,7 @@ void ChapsAdaptor::GetMechanismInfo(const vector<uint8_t>& isolate_credential,
                                     uint64_t& max_key_size,  // NOLINT - refs
                                     uint64_t& flags,  // NOLINT - refs
                                     uint32_t& result) {  // NOLINT - refs
-  AutoLock lock(*lock_);
+  AutoReadLock lock(*lock_);
   VLOG(1) << "CALL: " << __func__;
   VLOG(2) << "IN: " << "slot_id=" << slot_id;
   VLOG(2) << "IN: " << "mechanism_type=" << mechanism_type;
@@ -411,7 +519,7 @@ uint32_t ChapsAdaptor::InitToken(const vector<uint8_t>& isolate_credential,
                                  const bool& use_null_pin,
                                  const string& optional_so_pin,
                                  const vector<uint8_t>& new_token_label) {
-  AutoLock lock(*lock_);
+  AutoReadLock lock(*lock_);
   VLOG(1) << "CALL: " << __func__;
   VLOG(2) << "IN: " << "slot_id=" << slot_id;
   VLOG(2) << "IN: " << "new_token_label="
@@ -440,7 +548,7 @@ uint32_t ChapsAdaptor::InitPIN(const vector<uint8_t>& isolate_credential,
                                const uint64_t& session_id,
                                const bool& use_null_pin,
                                const string& optional_user_pin) {
-  AutoLock lock(*lock_);
+  AutoSessionLock lock(&slot_locks_, session_id, AutoSlotLock::kRead);
   VLOG(1) << "CALL: " << __func__;
   VLOG(2) << "IN: " << "session_id=" << session_id;
   VLOG(2) << "IN: " << "use_null_pin=" << use_null_pin;
@@ -468,7 +576,7 @@ uint32_t ChapsAdaptor::SetPIN(const vector<uint8_t>& isolate_credential,
                               const string& optional_old_pin,
                               const bool& use_null_new_pin,
                               const string& optional_new_pin) {
-  AutoLock lock(*lock_);
+  AutoSessionLock lock(&slot_locks_, session_id, AutoSlotLock::kRead);
   VLOG(1) << "CALL: " << __func__;
   VLOG(2) << "IN: " << "session_id=" << session_id;
   VLOG(2) << "IN: " << "use_null_old_pin=" << use_null_old_pin;
@@ -500,7 +608,7 @@ void ChapsAdaptor::OpenSession(const vector<uint8_t>& isolate_credential,
                                const uint64_t& flags,
                                uint64_t& session_id,  // NOLINT - refs
                                uint32_t& result) {  // NOLINT - refs
-  AutoLock lock(*lock_);
+  AutoReadLock lock(*lock_);
   VLOG(1) << "CALL: " << __func__;
   VLOG(2) << "IN: " << "slot_id=" << slot_id;
   VLOG(2) << "IN: " << "flags=" << flags;
@@ -525,7 +633,7 @@ void ChapsAdaptor::OpenSession(const vector<uint8_t>& isolate_credential,
 
 uint32_t ChapsAdaptor::CloseSession(const vector<uint8_t>& isolate_credential,
                                     const uint64_t& session_id) {
-  AutoLock lock(*lock_);
+  AutoSessionLock lock(&slot_locks_, session_id, AutoSlotLock::kRead);
   VLOG(1) << "CALL: " << __func__;
   VLOG(2) << "IN: " << "session_id=" << session_id;
   SecureBlob isolate_credential_blob(isolate_credential.begin(),
@@ -544,7 +652,7 @@ uint32_t ChapsAdaptor::CloseSession(const vector<uint8_t>& isolate_credential,
 uint32_t ChapsAdaptor::CloseAllSessions(
     const vector<uint8_t>& isolate_credential,
     const uint64_t& slot_id) {
-  AutoLock lock(*lock_);
+  AutoSlotLock lock(&slot_locks_, slot_id, AutoSlotLock::kWrite);
   VLOG(1) << "CALL: " << __func__;
   VLOG(2) << "IN: " << "slot_id=" << slot_id;
   SecureBlob isolate_credential_blob(isolate_credential.begin(),
@@ -569,7 +677,7 @@ void ChapsAdaptor::GetSessionInfo(const vector<uint8_t>& isolate_credential,
                                   uint64_t& flags,  // NOLINT - refs
                                   uint64_t& device_error,  // NOLINT - refs
                                   uint32_t& result) {  // NOLINT - refs
-  AutoLock lock(*lock_);
+  AutoSessionLock lock(&slot_locks_, session_id, AutoSlotLock::kRead);
   VLOG(1) << "CALL: " << __func__;
   VLOG(2) << "IN: " << "session_id=" << session_id;
   SecureBlob isolate_credential_blob(isolate_credential.begin(),
@@ -603,7 +711,7 @@ void ChapsAdaptor::GetOperationState(const vector<uint8_t>& isolate_credential,
                                      const uint64_t& session_id,
                                      vector<uint8_t>& operation_state,  // NOLINT - refs
                                      uint32_t& result) {  // NOLINT - refs
-  AutoLock lock(*lock_);
+  AutoSessionLock lock(&slot_locks_, session_id, AutoSlotLock::kRead);
   VLOG(1) << "CALL: " << __func__;
   SecureBlob isolate_credential_blob(isolate_credential.begin(),
                                      isolate_credential.end());
@@ -627,7 +735,7 @@ uint32_t ChapsAdaptor::SetOperationState(
       const vector<uint8_t>& operation_state,
       const uint64_t& encryption_key_handle,
       const uint64_t& authentication_key_handle) {
-  AutoLock lock(*lock_);
+  AutoSessionLock lock(&slot_locks_, session_id, AutoSlotLock::kRead);
   VLOG(1) << "CALL: " << __func__;
   SecureBlob isolate_credential_blob(isolate_credential.begin(),
                                      isolate_credential.end());
@@ -655,7 +763,7 @@ uint32_t ChapsAdaptor::Login(const vector<uint8_t>& isolate_credential,
                              const uint64_t& user_type,
                              const bool& use_null_pin,
                              const string& optional_pin) {
-  AutoLock lock(*lock_);
+  AutoSessionLock lock(&slot_locks_, session_id, AutoSlotLock::kRead);
   VLOG(1) << "CALL: " << __func__;
   VLOG(2) << "IN: " << "session_id=" << session_id;
   VLOG(2) << "IN: " << "user_type=" << user_type;
@@ -682,7 +790,7 @@ uint32_t ChapsAdaptor::Login(const vector<uint8_t>& isolate_credential,
 
 uint32_t ChapsAdaptor::Logout(const vector<uint8_t>& isolate_credential,
                               const uint64_t& session_id) {
-  AutoLock lock(*lock_);
+  AutoSessionLock lock(&slot_locks_, session_id, AutoSlotLock::kRead);
   VLOG(1) << "CALL: " << __func__;
   VLOG(2) << "IN: " << "session_id=" << session_id;
   SecureBlob isolate_credential_blob(isolate_credential.begin(),
@@ -704,7 +812,7 @@ void ChapsAdaptor::CreateObject(
       const vector<uint8_t>& attributes,
       uint64_t& new_object_handle,  // NOLINT(runtime/references)
       uint32_t& result) {  // NOLINT(runtime/references)
-  AutoLock lock(*lock_);
+  AutoSessionLock lock(&slot_locks_, session_id, AutoSlotLock::kWrite);
   VLOG(1) << "CALL: " << __func__;
   VLOG(2) << "IN: " << "session_id=" << session_id;
   VLOG(2) << "IN: " << "attributes=" << PrintAttributes(attributes, true);
@@ -737,7 +845,7 @@ void ChapsAdaptor::CopyObject(
       const vector<uint8_t>& attributes,
       uint64_t& new_object_handle,  // NOLINT(runtime/references)
       uint32_t& result) {  // NOLINT(runtime/references)
-  AutoLock lock(*lock_);
+  AutoSessionLock lock(&slot_locks_, session_id, AutoSlotLock::kWrite);
   VLOG(1) << "CALL: " << __func__;
   VLOG(2) << "IN: " << "session_id=" << session_id;
   VLOG(2) << "IN: " << "object_handle=" << object_handle;
@@ -769,7 +877,7 @@ void ChapsAdaptor::CopyObject(
 uint32_t ChapsAdaptor::DestroyObject(const vector<uint8_t>& isolate_credential,
                                      const uint64_t& session_id,
                                      const uint64_t& object_handle) {
-  AutoLock lock(*lock_);
+  AutoSessionLock lock(&slot_locks_, session_id, AutoSlotLock::kWrite);
   VLOG(1) << "CALL: " << __func__;
   VLOG(2) << "IN: " << "session_id=" << session_id;
   VLOG(2) << "IN: " << "object_handle=" << object_handle;
@@ -793,7 +901,7 @@ void ChapsAdaptor::GetObjectSize(const vector<uint8_t>& isolate_credential,
                                  const uint64_t& object_handle,
                                  uint64_t& object_size,  // NOLINT - refs
                                  uint32_t& result) {  // NOLINT - refs
-  AutoLock lock(*lock_);
+  AutoSessionLock lock(&slot_locks_, session_id, AutoSlotLock::kRead);
   VLOG(1) << "CALL: " << __func__;
   VLOG(2) << "IN: " << "session_id=" << session_id;
   VLOG(2) << "IN: " << "object_handle=" << object_handle;
@@ -823,7 +931,7 @@ void ChapsAdaptor::GetAttributeValue(const vector<uint8_t>& isolate_credential,
                                      const vector<uint8_t>& attributes_in,
                                      vector<uint8_t>& attributes_out,  // NOLINT - refs
                                      uint32_t& result) {  // NOLINT - refs
-  AutoLock lock(*lock_);
+  AutoSessionLock lock(&slot_locks_, session_id, AutoSlotLock::kRead);
   VLOG(1) << "CALL: " << __func__;
   VLOG(2) << "IN: " << "session_id=" << session_id;
   VLOG(2) << "IN: " << "object_handle=" << object_handle;
@@ -857,7 +965,7 @@ uint32_t ChapsAdaptor::SetAttributeValue(
     const uint64_t& session_id,
     const uint64_t& object_handle,
     const vector<uint8_t>& attributes) {
-  AutoLock lock(*lock_);
+  AutoSessionLock lock(&slot_locks_, session_id, AutoSlotLock::kWrite);
   VLOG(1) << "CALL: " << __func__;
   VLOG(2) << "IN: " << "session_id=" << session_id;
   VLOG(2) << "IN: " << "object_handle=" << object_handle;
@@ -885,16 +993,25 @@ uint32_t ChapsAdaptor::FindObjectsInit(
     const vector<uint8_t>& isolate_credential,
     const uint64_t& session_id,
     const vector<uint8_t>& attributes) {
-  AutoLock lock(*lock_);
-  VLOG(1) << "CALL: " << __func__;
-  VLOG(2) << "IN: " << "session_id=" << session_id;
-  VLOG(2) << "IN: " << "attributes=" << PrintAttributes(attributes, true);
-  SecureBlob isolate_credential_blob(isolate_credential.begin(),
-                                     isolate_credential.end());
-  ClearVector(const_cast<vector<uint8_t>*>(&isolate_credential));
-  return service_->FindObjectsInit(isolate_credential_blob,
-                                   session_id,
-                                   attributes);
+  uint32_t result = CKR_GENERAL_ERROR;
+  bool stale_keys = false;
+  int slot_id = 0;
+  {
+    AutoSessionLock lock(&slot_locks_, session_id, AutoSlotLock::kRead);
+    VLOG(1) << "CALL: " << __func__;
+    VLOG(2) << "IN: " << "session_id=" << session_id;
+    VLOG(2) << "IN: " << "attributes=" << PrintAttributes(attributes, true);
+    SecureBlob isolate_credential_blob(isolate_credential.begin(),
+                                       isolate_credential.end());
+    ClearVector(const_cast<vector<uint8_t>*>(&isolate_credential));
+    result = service_->FindObjectsInit(isolate_credential_blob,
+                                       session_id,
+                                       attributes);
+    stale_keys = HasStaleKeys(session_id, &slot_id);
+  }
+  if (stale_keys)
+    RemoveStaleKeys(slot_id);
+  return result;
 }
 
 uint32_t ChapsAdaptor::FindObjectsInit(
@@ -910,7 +1027,7 @@ void ChapsAdaptor::FindObjects(const vector<uint8_t>& isolate_credential,
                                const uint64_t& max_object_count,
                                vector<uint64_t>& object_list,  // NOLINT - refs
                                uint32_t& result) {  // NOLINT - refs
-  AutoLock lock(*lock_);
+  AutoSessionLock lock(&slot_locks_, session_id, AutoSlotLock::kRead);
   VLOG(1) << "CALL: " << __func__;
   VLOG(2) << "IN: " << "session_id=" << session_id;
   VLOG(2) << "IN: " << "max_object_count=" << max_object_count;
@@ -938,7 +1055,7 @@ void ChapsAdaptor::FindObjects(const vector<uint8_t>& isolate_credential,
 uint32_t ChapsAdaptor::FindObjectsFinal(
     const vector<uint8_t>& isolate_credential,
     const uint64_t& session_id) {
-  AutoLock lock(*lock_);
+  AutoSessionLock lock(&slot_locks_, session_id, AutoSlotLock::kRead);
   VLOG(1) << "CALL: " << __func__;
   VLOG(2) << "IN: " << "session_id=" << session_id;
   SecureBlob isolate_credential_blob(isolate_credential.begin(),
@@ -954,13 +1071,111 @@ uint32_t ChapsAdaptor::FindObjectsFinal(
   return FindObjectsFinal(isolate_credential, session_id);
 }
 
+void ChapsAdaptor::GetAttributeValues(
+    const vector<uint8_t>& isolate_credential,
+    const uint64_t& session_id,
+    const vector<uint64_t>& object_handles,
+    const vector<uint8_t>& attributes_in,
+    vector<vector<uint8_t>>& attributes_out,  // NOLINT - refs
+    vector<uint32_t>& results,  // NOLINT - refs
+    uint32_t& result) {  // NOLINT - refs
+  AutoSessionLock lock(&slot_locks_, session_id, AutoSlotLock::kRead);
+  VLOG(1) << "CALL: " << __func__;
+  VLOG(2) << "IN: " << "session_id=" << session_id;
+  VLOG(2) << "IN: " << "object_handles=" << PrintIntVector(object_handles);
+  VLOG(2) << "IN: " << "attributes_in="
+                    << PrintAttributes(attributes_in, false);
+  SecureBlob isolate_credential_blob(isolate_credential.begin(),
+                                     isolate_credential.end());
+  ClearVector(const_cast<vector<uint8_t>*>(&isolate_credential));
+  result = service_->GetAttributeValues(isolate_credential_blob,
+                                        session_id,
+                                        object_handles,
+                                        attributes_in,
+                                        &attributes_out,
+                                        &results);
+  VLOG_IF(2, result == CKR_OK) << "OUT: " << "results="
+                               << PrintIntVector(results);
+}
+
+void ChapsAdaptor::GetAttributeValues(
+    const vector<uint8_t>& isolate_credential,
+    const uint64_t& session_id,
+    const vector<uint64_t>& object_handles,
+    const vector<uint8_t>& attributes_in,
+    vector<vector<uint8_t>>& attributes_out,  // NOLINT - refs
+    vector<uint32_t>& results,  // NOLINT - refs
+    uint32_t& result,  // NOLINT - refs
+    ::DBus::Error& /*error*/) {
+  GetAttributeValues(isolate_credential, session_id, object_handles,
+                     attributes_in, attributes_out, results, result);
+}
+
+void ChapsAdaptor::FindObjectsWithAttributes(
+    const vector<uint8_t>& isolate_credential,
+    const uint64_t& session_id,
+    const vector<uint8_t>& find_template,
+    const vector<uint8_t>& attributes_in,
+    const uint64_t& max_object_count,
+    vector<uint64_t>& object_list,  // NOLINT - refs
+    vector<vector<uint8_t>>& attributes_out,  // NOLINT - refs
+    vector<uint32_t>& results,  // NOLINT - refs
+    uint32_t& result) {  // NOLINT - refs
+  bool stale_keys = false;
+  int slot_id = 0;
+  {
+    AutoSessionLock lock(&slot_locks_, session_id, AutoSlotLock::kRead);
+    VLOG(1) << "CALL: " << __func__;
+    VLOG(2) << "IN: " << "session_id=" << session_id;
+    VLOG(2) << "IN: " << "find_template="
+                      << PrintAttributes(find_template, true);
+    VLOG(2) << "IN: " << "attributes_in="
+                      << PrintAttributes(attributes_in, false);
+    VLOG(2) << "IN: " << "max_object_count=" << max_object_count;
+    SecureBlob isolate_credential_blob(isolate_credential.begin(),
+                                       isolate_credential.end());
+    ClearVector(const_cast<vector<uint8_t>*>(&isolate_credential));
+    result = service_->FindObjectsWithAttributes(isolate_credential_blob,
+                                                 session_id,
+                                                 find_template,
+                                                 attributes_in,
+                                                 max_object_count,
+                                                 &object_list,
+                                                 &attributes_out,
+                                                 &results);
+    VLOG_IF(2, result == CKR_OK) << "OUT: " << "object_list="
+                                 << PrintIntVector(object_list);
+    VLOG_IF(2, result == CKR_OK) << "OUT: " << "results="
+                                 << PrintIntVector(results);
+    stale_keys = HasStaleKeys(session_id, &slot_id);
+  }
+  if (stale_keys)
+    RemoveStaleKeys(slot_id);
+}
+
+void ChapsAdaptor::FindObjectsWithAttributes(
+    const vector<uint8_t>& isolate_credential,
+    const uint64_t& session_id,
+    const vector<uint8_t>& find_template,
+    const vector<uint8_t>& attributes_in,
+    const uint64_t& max_object_count,
+    vector<uint64_t>& object_list,  // NOLINT - refs
+    vector<vector<uint8_t>>& attributes_out,  // NOLINT - refs
+    vector<uint32_t>& results,  // NOLINT - refs
+    uint32_t& result,  // NOLINT - refs
+    ::DBus::Error& /*error*/) {
+  FindObjectsWithAttributes(isolate_credential, session_id, find_template,
+                            attributes_in, max_object_count, object_list,
+                            attributes_out, results, result);
+}
+
 uint32_t ChapsAdaptor::EncryptInit(
     const vector<uint8_t>& isolate_credential,
     const uint64_t& session_id,
     const uint64_t& mechanism_type,
     const vector<uint8_t>& mechanism_parameter,
     const uint64_t& key_handle) {
-  AutoLock lock(*lock_);
+  AutoSessionLock lock(&slot_locks_, session_id, AutoSlotLock::kRead);
   VLOG(1) << "CALL: " << __func__;
   VLOG(2) << "IN: " << "session_id=" << session_id;
   VLOG(2) << "IN: " << "mechanism_type=" << mechanism_type;
@@ -995,7 +1210,7 @@ void ChapsAdaptor::Encrypt(const vector<uint8_t>& isolate_credential,
                            uint64_t& actual_out_length,  // NOLINT - refs
                            vector<uint8_t>& data_out,  // NOLINT - refs
                            uint32_t& result) {  // NOLINT - refs
-  AutoLock lock(*lock_);
+  AutoSessionLock lock(&slot_locks_, session_id, AutoSlotLock::kRead);
   VLOG(1) << "CALL: " << __func__;
   VLOG(2) << "IN: " << "session_id=" << session_id;
   VLOG(2) << "IN: " << "max_out_length=" << max_out_length;
@@ -1031,7 +1246,7 @@ void ChapsAdaptor::EncryptUpdate(const vector<uint8_t>& isolate_credential,
                                  uint64_t& actual_out_length,  // NOLINT - refs
                                  vector<uint8_t>& data_out,  // NOLINT - refs
                                  uint32_t& result) {  // NOLINT - refs
-  AutoLock lock(*lock_);
+  AutoSessionLock lock(&slot_locks_, session_id, AutoSlotLock::kRead);
   VLOG(1) << "CALL: " << __func__;
   VLOG(2) << "IN: " << "session_id=" << session_id;
   VLOG(2) << "IN: " << "max_out_length=" << max_out_length;
@@ -1066,7 +1281,7 @@ void ChapsAdaptor::EncryptFinal(const vector<uint8_t>& isolate_credential,
                                 uint64_t& actual_out_length,  // NOLINT - refs
                                 vector<uint8_t>& data_out,  // NOLINT - refs
                                 uint32_t& result) {  // NOLINT - refs
-  AutoLock lock(*lock_);
+  AutoSessionLock lock(&slot_locks_, session_id, AutoSlotLock::kRead);
   VLOG(1) << "CALL: " << __func__;
   VLOG(2) << "IN: " << "session_id=" << session_id;
   VLOG(2) << "IN: " << "max_out_length=" << max_out_length;
@@ -1095,7 +1310,7 @@ void ChapsAdaptor::EncryptFinal(const vector<uint8_t>& isolate_credential,
 
 void ChapsAdaptor::EncryptCancel(const vector<uint8_t>& isolate_credential,
                                  const uint64_t& session_id) {
-  AutoLock lock(*lock_);
+  AutoSessionLock lock(&slot_locks_, session_id, AutoSlotLock::kRead);
   VLOG(1) << "CALL: " << __func__;
   SecureBlob isolate_credential_blob(isolate_credential.begin(),
                                      isolate_credential.end());
@@ -1115,7 +1330,7 @@ uint32_t ChapsAdaptor::DecryptInit(
     const uint64_t& mechanism_type,
     const vector<uint8_t>& mechanism_parameter,
     const uint64_t& key_handle) {
-  AutoLock lock(*lock_);
+  AutoSessionLock lock(&slot_locks_, session_id, AutoSlotLock::kRead);
   VLOG(1) << "CALL: " << __func__;
   VLOG(2) << "IN: " << "session_id=" << session_id;
   VLOG(2) << "IN: " << "mechanism_type=" << mechanism_type;
@@ -1150,7 +1365,7 @@ void ChapsAdaptor::Decrypt(const vector<uint8_t>& isolate_credential,
                            uint64_t& actual_out_length,  // NOLINT - refs
                            vector<uint8_t>& data_out,  // NOLINT - refs
                            uint32_t& result) {  // NOLINT - refs
-  AutoLock lock(*lock_);
+  AutoSessionLock lock(&slot_locks_, session_id, AutoSlotLock::kRead);
   VLOG(1) << "CALL: " << __func__;
   VLOG(2) << "IN: " << "session_id=" << session_id;
   VLOG(2) << "IN: " << "max_out_length=" << max_out_length;
@@ -1186,7 +1401,7 @@ void ChapsAdaptor::DecryptUpdate(const vector<uint8_t>& isolate_credential,
                                  uint64_t& actual_out_length,  // NOLINT - refs
                                  vector<uint8_t>& data_out,  // NOLINT - refs
                                  uint32_t& result) {  // NOLINT - refs
-  AutoLock lock(*lock_);
+  AutoSessionLock lock(&slot_locks_, session_id, AutoSlotLock::kRead);
   VLOG(1) << "CALL: " << __func__;
   VLOG(2) << "IN: " << "session_id=" << session_id;
   VLOG(2) << "IN: " << "max_out_length=" << max_out_length;
@@ -1221,7 +1436,7 @@ void ChapsAdaptor::DecryptFinal(const vector<uint8_t>& isolate_credential,
                                 uint64_t& actual_out_length,  // NOLINT - refs
                                 vector<uint8_t>& data_out,  // NOLINT - refs
                                 uint32_t& result) {  // NOLINT - refs
-  AutoLock lock(*lock_);
+  AutoSessionLock lock(&slot_locks_, session_id, AutoSlotLock::kRead);
   VLOG(1) << "CALL: " << __func__;
   VLOG(2) << "IN: " << "session_id=" << session_id;
   VLOG(2) << "IN: " << "max_out_length=" << max_out_length;
@@ -1250,7 +1465,7 @@ void ChapsAdaptor::DecryptFinal(const vector<uint8_t>& isolate_credential,
 
 void ChapsAdaptor::DecryptCancel(const vector<uint8_t>& isolate_credential,
                                  const uint64_t& session_id) {
-  AutoLock lock(*lock_);
+  AutoSessionLock lock(&slot_locks_, session_id, AutoSlotLock::kRead);
   VLOG(1) << "CALL: " << __func__;
   SecureBlob isolate_credential_blob(isolate_credential.begin(),
                                      isolate_credential.end());
@@ -1269,7 +1484,7 @@ uint32_t ChapsAdaptor::DigestInit(
     const uint64_t& session_id,
     const uint64_t& mechanism_type,
     const vector<uint8_t>& mechanism_parameter) {
-  AutoLock lock(*lock_);
+  AutoSessionLock lock(&slot_locks_, session_id, AutoSlotLock::kRead);
   VLOG(1) << "CALL: " << __func__;
   VLOG(2) << "IN: " << "session_id=" << session_id;
   VLOG(2) << "IN: " << "mechanism_type=" << mechanism_type;
@@ -1301,7 +1516,7 @@ void ChapsAdaptor::Digest(const vector<uint8_t>& isolate_credential,
                           uint64_t& actual_out_length,  // NOLINT - refs
                           vector<uint8_t>& digest,  // NOLINT - refs
                           uint32_t& result) {  // NOLINT - refs
-  AutoLock lock(*lock_);
+  AutoSessionLock lock(&slot_locks_, session_id, AutoSlotLock::kRead);
   VLOG(1) << "CALL: " << __func__;
   VLOG(2) << "IN: " << "session_id=" << session_id;
   VLOG(2) << "IN: " << "max_out_length=" << max_out_length;
@@ -1333,7 +1548,7 @@ void ChapsAdaptor::Digest(const vector<uint8_t>& isolate_credential,
 uint32_t ChapsAdaptor::DigestUpdate(const vector<uint8_t>& isolate_credential,
                                     const uint64_t& session_id,
                                     const vector<uint8_t>& data_in) {
-  AutoLock lock(*lock_);
+  AutoSessionLock lock(&slot_locks_, session_id, AutoSlotLock::kRead);
   VLOG(1) << "CALL: " << __func__;
   VLOG(2) << "IN: " << "session_id=" << session_id;
   SecureBlob isolate_credential_blob(isolate_credential.begin(),
@@ -1354,7 +1569,7 @@ uint32_t ChapsAdaptor::DigestUpdate(const vector<uint8_t>& isolate_credential,
 uint32_t ChapsAdaptor::DigestKey(const vector<uint8_t>& isolate_credential,
                                  const uint64_t& session_id,
                                  const uint64_t& key_handle) {
-  AutoLock lock(*lock_);
+  AutoSessionLock lock(&slot_locks_, session_id, AutoSlotLock::kRead);
   VLOG(1) << "CALL: " << __func__;
   VLOG(2) << "IN: " << "session_id=" << session_id;
   VLOG(2) << "IN: " << "key_handle=" << key_handle;
@@ -1380,7 +1595,7 @@ void ChapsAdaptor::DigestFinal(const vector<uint8_t>& isolate_credential,
                                uint64_t& actual_out_length,  // NOLINT - refs
                                vector<uint8_t>& digest,  // NOLINT - refs
                                uint32_t& result) {  // NOLINT - refs
-  AutoLock lock(*lock_);
+  AutoSessionLock lock(&slot_locks_, session_id, AutoSlotLock::kRead);
   VLOG(1) << "CALL: " << __func__;
   VLOG(2) << "IN: " << "session_id=" << session_id;
   VLOG(2) << "IN: " << "max_out_length=" << max_out_length;
@@ -1409,7 +1624,7 @@ void ChapsAdaptor::DigestFinal(const vector<uint8_t>& isolate_credential,
 
 void ChapsAdaptor::DigestCancel(const vector<uint8_t>& isolate_credential,
                                 const uint64_t& session_id) {
-  AutoLock lock(*lock_);
+  AutoSessionLock lock(&slot_locks_, session_id, AutoSlotLock::kRead);
   VLOG(1) << "CALL: " << __func__;
   SecureBlob isolate_credential_blob(isolate_credential.begin(),
                                      isolate_credential.end());
@@ -1428,7 +1643,7 @@ uint32_t ChapsAdaptor::SignInit(const vector<uint8_t>& isolate_credential,
                                 const uint64_t& mechanism_type,
                                 const vector<uint8_t>& mechanism_parameter,
                                 const uint64_t& key_handle) {
-  AutoLock lock(*lock_);
+  AutoSessionLock lock(&slot_locks_, session_id, AutoSlotLock::kRead);
   VLOG(1) << "CALL: " << __func__;
   VLOG(2) << "IN: " << "session_id=" << session_id;
   VLOG(2) << "IN: " << "mechanism_type=" << mechanism_type;
@@ -1462,7 +1677,7 @@ void ChapsAdaptor::Sign(const vector<uint8_t>& isolate_credential,
                         uint64_t& actual_out_length,  // NOLINT - refs
                         vector<uint8_t>& signature,  // NOLINT - refs
                         uint32_t& result) {  // NOLINT - refs
-  AutoLock lock(*lock_);
+  AutoSessionLock lock(&slot_locks_, session_id, AutoSlotLock::kRead);
   VLOG(1) << "CALL: " << __func__;
   VLOG(2) << "IN: " << "session_id=" << session_id;
   VLOG(2) << "IN: " << "max_out_length=" << max_out_length;
@@ -1494,7 +1709,7 @@ void ChapsAdaptor::Sign(const vector<uint8_t>& isolate_credential,
 uint32_t ChapsAdaptor::SignUpdate(const vector<uint8_t>& isolate_credential,
                                   const uint64_t& session_id,
                                   const vector<uint8_t>& data_part) {
-  AutoLock lock(*lock_);
+  AutoSessionLock lock(&slot_locks_, session_id, AutoSlotLock::kRead);
   VLOG(1) << "CALL: " << __func__;
   VLOG(2) << "IN: " << "session_id=" << session_id;
   SecureBlob isolate_credential_blob(isolate_credential.begin(),
@@ -1518,7 +1733,7 @@ void ChapsAdaptor::SignFinal(const vector<uint8_t>& isolate_credential,
                              uint64_t& actual_out_length,  // NOLINT - refs
                              vector<uint8_t>& signature,  // NOLINT - refs
                              uint32_t& result) {  // NOLINT - refs
-  AutoLock lock(*lock_);
+  AutoSessionLock lock(&slot_locks_, session_id, AutoSlotLock::kRead);
   VLOG(1) << "CALL: " << __func__;
   VLOG(2) << "IN: " << "session_id=" << session_id;
   VLOG(2) << "IN: " << "max_out_length=" << max_out_length;
@@ -1547,7 +1762,7 @@ void ChapsAdaptor::SignFinal(const vector<uint8_t>& isolate_credential,
 
 void ChapsAdaptor::SignCancel(const vector<uint8_t>& isolate_credential,
                               const uint64_t& session_id) {
-  AutoLock lock(*lock_);
+  AutoSessionLock lock(&slot_locks_, session_id, AutoSlotLock::kRead);
   VLOG(1) << "CALL: " << __func__;
   SecureBlob isolate_credential_blob(isolate_credential.begin(),
                                      isolate_credential.end());
@@ -1567,7 +1782,7 @@ uint32_t ChapsAdaptor::SignRecoverInit(
       const uint64_t& mechanism_type,
       const vector<uint8_t>& mechanism_parameter,
       const uint64_t& key_handle) {
-  AutoLock lock(*lock_);
+  AutoSessionLock lock(&slot_locks_, session_id, AutoSlotLock::kRead);
   VLOG(1) << "CALL: " << __func__;
   VLOG(2) << "IN: " << "session_id=" << session_id;
   VLOG(2) << "IN: " << "mechanism_type=" << mechanism_type;
@@ -1602,7 +1817,7 @@ void ChapsAdaptor::SignRecover(const vector<uint8_t>& isolate_credential,
                                uint64_t& actual_out_length,  // NOLINT - refs
                                vector<uint8_t>& signature,  // NOLINT - refs
                                uint32_t& result) {  // NOLINT - refs
-  AutoLock lock(*lock_);
+  AutoSessionLock lock(&slot_locks_, session_id, AutoSlotLock::kRead);
   VLOG(1) << "CALL: " << __func__;
   VLOG(2) << "IN: " << "session_id=" << session_id;
   VLOG(2) << "IN: " << "max_out_length=" << max_out_length;
@@ -1636,7 +1851,7 @@ uint32_t ChapsAdaptor::VerifyInit(const vector<uint8_t>& isolate_credential,
                                   const uint64_t& mechanism_type,
                                   const vector<uint8_t>& mechanism_parameter,
                                   const uint64_t& key_handle) {
-  AutoLock lock(*lock_);
+  AutoSessionLock lock(&slot_locks_, session_id, AutoSlotLock::kRead);
   VLOG(1) << "CALL: " << __func__;
   VLOG(2) << "IN: " << "session_id=" << session_id;
   VLOG(2) << "IN: " << "mechanism_type=" << mechanism_type;
@@ -1667,7 +1882,7 @@ uint32_t ChapsAdaptor::Verify(const vector<uint8_t>& isolate_credential,
                               const uint64_t& session_id,
                               const vector<uint8_t>& data,
                               const vector<uint8_t>& signature) {
-  AutoLock lock(*lock_);
+  AutoSessionLock lock(&slot_locks_, session_id, AutoSlotLock::kRead);
   VLOG(1) << "CALL: " << __func__;
   VLOG(2) << "IN: " << "session_id=" << session_id;
   SecureBlob isolate_credential_blob(isolate_credential.begin(),
@@ -1690,7 +1905,7 @@ uint32_t ChapsAdaptor::Verify(const vector<uint8_t>& isolate_credential,
 uint32_t ChapsAdaptor::VerifyUpdate(const vector<uint8_t>& isolate_credential,
                                     const uint64_t& session_id,
                                     const vector<uint8_t>& data_part) {
-  AutoLock lock(*lock_);
+  AutoSessionLock lock(&slot_locks_, session_id, AutoSlotLock::kRead);
   VLOG(1) << "CALL: " << __func__;
   VLOG(2) << "IN: " << "session_id=" << session_id;
   SecureBlob isolate_credential_blob(isolate_credential.begin(),
@@ -1711,7 +1926,7 @@ uint32_t ChapsAdaptor::VerifyUpdate(const vector<uint8_t>& isolate_credential,
 uint32_t ChapsAdaptor::VerifyFinal(const vector<uint8_t>& isolate_credential,
                                    const uint64_t& session_id,
                                    const vector<uint8_t>& signature) {
-  AutoLock lock(*lock_);
+  AutoSessionLock lock(&slot_locks_, session_id, AutoSlotLock::kRead);
   VLOG(1) << "CALL: " << __func__;
   VLOG(2) << "IN: " << "session_id=" << session_id;
   SecureBlob isolate_credential_blob(isolate_credential.begin(),
@@ -1731,7 +1946,7 @@ uint32_t ChapsAdaptor::VerifyFinal(const vector<uint8_t>& isolate_credential,
 
 void ChapsAdaptor::VerifyCancel(const vector<uint8_t>& isolate_credential,
                                 const uint64_t& session_id) {
-  AutoLock lock(*lock_);
+  AutoSessionLock lock(&slot_locks_, session_id, AutoSlotLock::kRead);
   VLOG(1) << "CALL: " << __func__;
   SecureBlob isolate_credential_blob(isolate_credential.begin(),
                                      isolate_credential.end());
@@ -1752,7 +1967,7 @@ uint32_t ChapsAdaptor::VerifyRecoverInit(
       const uint64_t& mechanism_type,
       const vector<uint8_t>& mechanism_parameter,
       const uint64_t& key_handle) {
-  AutoLock lock(*lock_);
+  AutoSessionLock lock(&slot_locks_, session_id, AutoSlotLock::kRead);
   VLOG(1) << "CALL: " << __func__;
   VLOG(2) << "IN: " << "session_id=" << session_id;
   VLOG(2) << "IN: " << "mechanism_type=" << mechanism_type;
@@ -1787,7 +2002,7 @@ void ChapsAdaptor::VerifyRecover(const vector<uint8_t>& isolate_credential,
                                  uint64_t& actual_out_length,  // NOLINT - refs
                                  vector<uint8_t>& data,  // NOLINT - refs
                                  uint32_t& result) {  // NOLINT - refs
-  AutoLock lock(*lock_);
+  AutoSessionLock lock(&slot_locks_, session_id, AutoSlotLock::kRead);
   VLOG(1) << "CALL: " << __func__;
   VLOG(2) << "IN: " << "session_id=" << session_id;
   VLOG(2) << "IN: " << "max_out_length=" << max_out_length;
@@ -1824,7 +2039,7 @@ void ChapsAdaptor::DigestEncryptUpdate(
     uint64_t& actual_out_length,  // NOLINT - refs
     vector<uint8_t>& data_out,  // NOLINT - refs
     uint32_t& result) {  // NOLINT - refs
-  AutoLock lock(*lock_);
+  AutoSessionLock lock(&slot_locks_, session_id, AutoSlotLock::kRead);
   VLOG(1) << "CALL: " << __func__;
   VLOG(2) << "IN: " << "session_id=" << session_id;
   VLOG(2) << "IN: " << "max_out_length=" << max_out_length;
@@ -1862,7 +2077,7 @@ void ChapsAdaptor::DecryptDigestUpdate(
     uint64_t& actual_out_length,  // NOLINT - refs
     vector<uint8_t>& data_out,  // NOLINT - refs
     uint32_t& result) {  // NOLINT - refs
-  AutoLock lock(*lock_);
+  AutoSessionLock lock(&slot_locks_, session_id, AutoSlotLock::kRead);
   VLOG(1) << "CALL: " << __func__;
   VLOG(2) << "IN: " << "session_id=" << session_id;
   VLOG(2) << "IN: " << "max_out_length=" << max_out_length;
@@ -1899,7 +2114,7 @@ void ChapsAdaptor::SignEncryptUpdate(const vector<uint8_t>& isolate_credential,
                                      uint64_t& actual_out_length,  // NOLINT - refs
                                      vector<uint8_t>& data_out,  // NOLINT - refs
                                      uint32_t& result) {  // NOLINT - refs
-  AutoLock lock(*lock_);
+  AutoSessionLock lock(&slot_locks_, session_id, AutoSlotLock::kRead);
   VLOG(1) << "CALL: " << __func__;
   VLOG(2) << "IN: " << "session_id=" << session_id;
   VLOG(2) << "IN: " << "max_out_length=" << max_out_length;
@@ -1936,7 +2151,7 @@ void ChapsAdaptor::DecryptVerifyUpdate(
     uint64_t& actual_out_length,  // NOLINT - refs
     vector<uint8_t>& data_out,  // NOLINT - refs
     uint32_t& result) {  // NOLINT - refs
-  AutoLock lock(*lock_);
+  AutoSessionLock lock(&slot_locks_, session_id, AutoSlotLock::kRead);
   VLOG(1) << "CALL: " << __func__;
   VLOG(2) << "IN: " << "session_id=" << session_id;
   VLOG(2) << "IN: " << "max_out_length=" << max_out_length;
@@ -1974,7 +2189,7 @@ void ChapsAdaptor::GenerateKey(
     const vector<uint8_t>& attributes,
     uint64_t& key_handle,  // NOLINT - refs
     uint32_t& result) {  // NOLINT - refs
-  AutoLock lock(*lock_);
+  AutoSessionLock lock(&slot_locks_, session_id, AutoSlotLock::kRead);
   VLOG(1) << "CALL: " << __func__;
   VLOG(2) << "IN: " << "session_id=" << session_id;
   VLOG(2) << "IN: " << "mechanism_type=" << mechanism_type;
@@ -2016,7 +2231,7 @@ void ChapsAdaptor::GenerateKeyPair(
     uint64_t& public_key_handle,  // NOLINT - refs
     uint64_t& private_key_handle,  // NOLINT - refs
     uint32_t& result) {  // NOLINT - refs
-  AutoLock lock(*lock_);
+  AutoSessionLock lock(&slot_locks_, session_id, AutoSlotLock::kRead);
   VLOG(1) << "CALL: " << __func__;
   VLOG(2) << "IN: " << "session_id=" << session_id;
   VLOG(2) << "IN: " << "mechanism_type=" << mechanism_type;
@@ -2069,7 +2284,7 @@ void ChapsAdaptor::WrapKey(const vector<uint8_t>& isolate_credential,
                            uint64_t& actual_out_length,  // NOLINT - refs
                            vector<uint8_t>& wrapped_key,  // NOLINT - refs
                            uint32_t& result) {  // NOLINT - refs
-  AutoLock lock(*lock_);
+  AutoSessionLock lock(&slot_locks_, session_id, AutoSlotLock::kRead);
   VLOG(1) << "CALL: " << __func__;
   VLOG(2) << "IN: " << "session_id=" << session_id;
   VLOG(2) << "IN: " << "mechanism_type=" << mechanism_type;
@@ -2119,7 +2334,7 @@ void ChapsAdaptor::UnwrapKey(const vector<uint8_t>& isolate_credential,
                              const vector<uint8_t>& attributes,
                              uint64_t& key_handle,  // NOLINT - refs
                              uint32_t& result) {  // NOLINT - refs
-  AutoLock lock(*lock_);
+  AutoSessionLock lock(&slot_locks_, session_id, AutoSlotLock::kRead);
   VLOG(1) << "CALL: " << __func__;
   VLOG(2) << "IN: " << "session_id=" << session_id;
   VLOG(2) << "IN: " << "mechanism_type=" << mechanism_type;
@@ -2163,7 +2378,7 @@ void ChapsAdaptor::DeriveKey(const vector<uint8_t>& isolate_credential,
                              const vector<uint8_t>& attributes,
                              uint64_t& key_handle,  // NOLINT - refs
                              uint32_t& result) {  // NOLINT - refs
-  AutoLock lock(*lock_);
+  AutoSessionLock lock(&slot_locks_, session_id, AutoSlotLock::kRead);
   VLOG(1) << "CALL: " << __func__;
   VLOG(2) << "IN: " << "session_id=" << session_id;
   VLOG(2) << "IN: " << "mechanism_type=" << mechanism_type;
@@ -2200,7 +2415,7 @@ void ChapsAdaptor::DeriveKey(const vector<uint8_t>& isolate_credential,
 uint32_t ChapsAdaptor::SeedRandom(const vector<uint8_t>& isolate_credential,
                                   const uint64_t& session_id,
                                   const vector<uint8_t>& seed) {
-  AutoLock lock(*lock_);
+  AutoSessionLock lock(&slot_locks_, session_id, AutoSlotLock::kRead);
   VLOG(1) << "CALL: " << __func__;
   VLOG(2) << "IN: " << "session_id=" << session_id;
   VLOG(2) << "IN: " << "num_bytes=" << seed.size();
@@ -2224,7 +2439,7 @@ void ChapsAdaptor::GenerateRandom(const vector<uint8_t>& isolate_credential,
                                   const uint64_t& num_bytes,
                                   vector<uint8_t>& random_data,  // NOLINT - refs
                                   uint32_t& result) {  // NOLINT - refs
-  AutoLock lock(*lock_);
+  AutoSessionLock lock(&slot_locks_, session_id, AutoSlotLock::kRead);
   VLOG(1) << "CALL: " << __func__;
   VLOG(2) << "IN: " << "session_id=" << session_id;
   VLOG(2) << "IN: " << "num_bytes=" << num_bytes;
@@ -11,14 +11,13 @@
 #include <base/macros.h>
 
 #include "chaps/dbus_adaptors/chaps_interface.h"
-
-namespace base {
-class Lock;
-}
+#include "chaps/slot_locks.h"
 
 namespace chaps {
 
 class ChapsInterface;
+class RequestDispatcher;
+class SlotManager;
 class TokenManagerInterface;
 
 // The ChapsAdaptor class implements the dbus-c++ generated adaptor interface
@@ -27,12 +26,35 @@ class TokenManagerInterface;
 // ChapsInterface instance need not be aware of dbus-c++ or IPC.  This class
 // exists because we don't want to couple dbus-c++ with the Chaps service
 // implementation.
+//
+// If given a RequestDispatcher, the adaptor handles each call on a dispatcher
+// worker chosen by the session or slot the call is for, and the D-Bus thread
+// only reads the next call. Calls that open or close isolates or load, unload
+// or change the auth data of tokens hold |lock| for writing. All other calls
+// hold it for reading, together with the SlotLocks lock of the slot they work
+// on: for writing if they create, change or destroy objects or close all
+// sessions of the slot, and for reading otherwise. Searches refresh the NetHSM
+// keys under the read lock; keys found to be deleted from the NetHSM are
+// removed afterwards, under the write lock. |slot_manager| maps sessions to
+// their slots.
 class ChapsAdaptor : public org::chromium::Chaps_adaptor,
                      public DBus::ObjectAdaptor {
  public:
-  ChapsAdaptor(base::Lock* lock,
+  ChapsAdaptor(ReadWriteLock* lock,
+               ChapsInterface* service,
+               TokenManagerInterface* token_manager,
+               SlotManager* slot_manager,
+               RequestDispatcher* dispatcher);
+  // Like the above, but exports the adaptor on |connection| instead of the
+  // system bus, so that tests can run without a bus daemon.
+  ChapsAdaptor(DBus::Connection* connection,
+               ReadWriteLock* lock,
                ChapsInterface* service,
-               TokenManagerInterface* token_manager);
+               TokenManagerInterface* token_manager,
+               SlotManager* slot_manager,
+               RequestDispatcher* dispatcher);
+  // Runs the calls already handed to |dispatcher| and stops it, since they use
+  // the adaptor.
   virtual ~ChapsAdaptor();
 
   // These methods are generated by the ChromeOS dbus library.
@@ -64,6 +86,7 @@ class ChapsAdaptor : public org::chromium::Chaps_adaptor,
                             ::DBus::Error& error);  // NOLINT - refs
   virtual void SetLogLevel(const int32_t& level,
                            ::DBus::Error& error);  // NOLINT - refs
+  virtual std::string GetLatencyStats(::DBus::Error& error);  // NOLINT - refs
   virtual void GetSlotList(const std::vector<uint8_t>& isolate_credential,
                            const bool& token_present,
                            std::vector<uint64_t>& slot_list,  // NOLINT - refs
@@ -228,6 +251,26 @@ class ChapsAdaptor : public org::chromium::Chaps_adaptor,
       const std::vector<uint8_t>& isolate_credential,
       const uint64_t& session_id,
       ::DBus::Error& error);  // NOLINT - refs
+  virtual void GetAttributeValues(
+      const std::vector<uint8_t>& isolate_credential,
+      const uint64_t& session_id,
+      const std::vector<uint64_t>& object_handles,
+      const std::vector<uint8_t>& attributes_in,
+      std::vector<std::vector<uint8_t>>& attributes_out,  // NOLINT - refs
+      std::vector<uint32_t>& results,  // NOLINT - refs
+      uint32_t& result,  // NOLINT - refs
+      ::DBus::Error& error);  // NOLINT - refs
+  virtual void FindObjectsWithAttributes(
+      const std::vector<uint8_t>& isolate_credential,
+      const uint64_t& session_id,
+      const std::vector<uint8_t>& find_template,
+      const std::vector<uint8_t>& attributes_in,
+      const uint64_t& max_object_count,
+      std::vector<uint64_t>& object_list,  // NOLINT - refs
+      std::vector<std::vector<uint8_t>>& attributes_out,  // NOLINT - refs
+      std::vector<uint32_t>& results,  // NOLINT - refs
+      uint32_t& result,  // NOLINT - refs
+      ::DBus::Error& error);  // NOLINT - refs
   virtual uint32_t EncryptInit(const std::vector<uint8_t>& isolate_credential,
                                const uint64_t& session_id,
                                const uint64_t& mechanism_type,
@@ -522,6 +565,7 @@ class ChapsAdaptor : public org::chromium::Chaps_adaptor,
                             std::string& path,  // NOLINT - refs
                             bool& result);  // NOLINT - refs
   virtual void SetLogLevel(const int32_t& level);
+  virtual std::string GetLatencyStats();
   virtual void GetSlotList(const std::vector<uint8_t>& isolate_credential,
                            const bool& token_present,
                            std::vector<uint64_t>& slot_list,  // NOLINT - refs
@@ -660,6 +704,24 @@ class ChapsAdaptor : public org::chromium::Chaps_adaptor,
   virtual uint32_t FindObjectsFinal(
       const std::vector<uint8_t>& isolate_credential,
       const uint64_t& session_id);
+  virtual void GetAttributeValues(
+      const std::vector<uint8_t>& isolate_credential,
+      const uint64_t& session_id,
+      const std::vector<uint64_t>& object_handles,
+      const std::vector<uint8_t>& attributes_in,
+      std::vector<std::vector<uint8_t>>& attributes_out,  // NOLINT - refs
+      std::vector<uint32_t>& results,  // NOLINT - refs
+      uint32_t& result);  // NOLINT - refs
+  virtual void FindObjectsWithAttributes(
+      const std::vector<uint8_t>& isolate_credential,
+      const uint64_t& session_id,
+      const std::vector<uint8_t>& find_template,
+      const std::vector<uint8_t>& attributes_in,
+      const uint64_t& max_object_count,
+      std::vector<uint64_t>& object_list,  // NOLINT - refs
+      std::vector<std::vector<uint8_t>>& attributes_out,  // NOLINT - refs
+      std::vector<uint32_t>& results,  // NOLINT - refs
+      uint32_t& result);  // NOLINT - refs
   virtual uint32_t EncryptInit(const std::vector<uint8_t>& isolate_credential,
                                const uint64_t& session_id,
                                const uint64_t& mechanism_type,
@@ -890,9 +952,26 @@ class ChapsAdaptor : public org::chromium::Chaps_adaptor,
                               uint32_t& result);  // NOLINT - refs
 
  private:
-  base::Lock* lock_;
+  // Overrides DBus::ObjectAdaptor to hand calls to |dispatcher_|.
+  virtual bool handle_message(const DBus::Message& message);
+  // Runs the generated handler for |call| and sends the reply.
+  void HandleCall(const DBus::CallMessage& call);
+  // Returns the RequestDispatcher key of the session or slot |call| is for.
+  static uint64_t GetDispatchKey(const DBus::CallMessage& call);
+  // Returns true if the token of the slot |session_id| belongs to holds NetHSM
+  // keys that a search found to be deleted from the NetHSM, and sets |slot_id|
+  // to that slot. Must be called with the slot's lock held.
+  bool HasStaleKeys(uint64_t session_id, int* slot_id);
+  // Removes those keys from the token of |slot_id|. Must be called without any
+  // lock held.
+  void RemoveStaleKeys(int slot_id);
+
+  ReadWriteLock* lock_;
   ChapsInterface* service_;
   TokenManagerInterface* token_manager_;
+  SlotManager* slot_manager_;
+  RequestDispatcher* dispatcher_;
+  SlotLocks slot_locks_;
 
   DISALLOW_COPY_AND_ASSIGN(ChapsAdaptor);
 };
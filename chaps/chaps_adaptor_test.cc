@@ -0,0 +1,262 @@
+// Copyright 2016 The Chromium OS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "chaps/chaps_adaptor.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <base/bind.h>
+#include <base/files/scoped_temp_dir.h>
+#include <base/synchronization/waitable_event.h>
+#include <base/time/time.h>
+#include <dbus-c++/dbus.h>
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include "chaps/attributes.h"
+#include "chaps/chaps_service.h"
+#include "chaps/isolate.h"
+#include "chaps/read_write_lock.h"
+#include "chaps/request_dispatcher.h"
+#include "chaps/session_mock.h"
+#include "chaps/slot_manager_mock.h"
+
+using base::TimeDelta;
+using base::WaitableEvent;
+using brillo::SecureBlob;
+using std::vector;
+using ::testing::_;
+using ::testing::DoAll;
+using ::testing::InvokeWithoutArgs;
+using ::testing::Return;
+using ::testing::SetArgumentPointee;
+
+namespace chaps {
+
+namespace {
+
+const size_t kNumWorkers = 4;
+
+// Sessions 1 and 2 are on slot 0.
+const uint64_t kSlowSession = 1;
+const uint64_t kSearchSession = 2;
+
+// Accepts peer-to-peer connections, so that the adaptor can be exported
+// without a bus daemon.
+class TestServer : public DBus::Server {
+ public:
+  explicit TestServer(const char* address) : DBus::Server(address) {}
+
+ protected:
+  void on_new_connection(DBus::Connection& connection) override {}
+};
+
+vector<uint8_t> GetCredential() {
+  SecureBlob credential =
+      IsolateCredentialManager::GetDefaultIsolateCredential();
+  return vector<uint8_t>(credential.begin(), credential.end());
+}
+
+vector<uint8_t> NoAttributes() {
+  vector<uint8_t> serialized;
+  Attributes().Serialize(&serialized);
+  return serialized;
+}
+
+// The following call the adaptor methods the way the D-Bus handlers do.
+void GenerateKeyPair(ChapsAdaptor* adaptor, uint32_t* result) {
+  uint64_t public_key = 0;
+  uint64_t private_key = 0;
+  adaptor->GenerateKeyPair(GetCredential(), kSlowSession,
+                           CKM_RSA_PKCS_KEY_PAIR_GEN, vector<uint8_t>(),
+                           NoAttributes(), NoAttributes(), public_key,
+                           private_key, *result);
+}
+
+void FindObjectsInit(ChapsAdaptor* adaptor, WaitableEvent* done) {
+  EXPECT_EQ(CKR_OK, adaptor->FindObjectsInit(GetCredential(), kSearchSession,
+                                             NoAttributes()));
+  done->Signal();
+}
+
+void FindObjectsWithAttributes(ChapsAdaptor* adaptor, WaitableEvent* done) {
+  vector<uint64_t> objects;
+  vector<vector<uint8_t>> attributes;
+  vector<uint32_t> results;
+  uint32_t result = CKR_GENERAL_ERROR;
+  adaptor->FindObjectsWithAttributes(GetCredential(), kSearchSession,
+                                     NoAttributes(), NoAttributes(), 10,
+                                     objects, attributes, results, result);
+  EXPECT_EQ(CKR_OK, result);
+  done->Signal();
+}
+
+void DestroyObject(ChapsAdaptor* adaptor, WaitableEvent* done) {
+  EXPECT_EQ(CKR_OK, adaptor->DestroyObject(GetCredential(), kSearchSession, 1));
+  done->Signal();
+}
+
+}  // namespace
+
+// Drives ChapsAdaptor's own methods, so that the locks they take are the ones
+// chapsd uses.
+class TestChapsAdaptor : public ::testing::Test {
+ protected:
+  TestChapsAdaptor()
+      : key_generation_started_(true, false),
+        release_key_generation_(false, false),
+        key_generation_result_(CKR_GENERAL_ERROR) {}
+
+  void SetUp() {
+    ASSERT_TRUE(temp_dir_.CreateUniqueTempDir());
+    DBus::default_dispatcher = &bus_dispatcher_;
+    const std::string address =
+        "unix:path=" + temp_dir_.path().Append("bus").value();
+    server_.reset(new TestServer(address.c_str()));
+    connection_.reset(new DBus::Connection(address.c_str()));
+
+    slot_manager_ = std::make_shared<SlotManagerMock>();
+    EXPECT_CALL(*slot_manager_, GetSessionSlot(_, _))
+        .WillRepeatedly(DoAll(SetArgumentPointee<1>(0), Return(true)));
+    EXPECT_CALL(*slot_manager_, GetSession(_, kSlowSession, _))
+        .WillRepeatedly(DoAll(SetArgumentPointee<2>(&slow_session_),
+                              Return(true)));
+    EXPECT_CALL(*slot_manager_, GetSession(_, kSearchSession, _))
+        .WillRepeatedly(DoAll(SetArgumentPointee<2>(&search_session_),
+                              Return(true)));
+    service_.reset(new ChapsServiceImpl(slot_manager_));
+    ASSERT_TRUE(service_->Init());
+    adaptor_.reset(new ChapsAdaptor(connection_.get(), &lock_, service_.get(),
+                                    NULL, slot_manager_.get(), NULL));
+
+    dispatcher_.reset(new RequestDispatcher(kNumWorkers));
+    ASSERT_TRUE(dispatcher_->Start());
+    // Each call is posted with a key of its own, on a worker of its own.
+    vector<bool> used(kNumWorkers, false);
+    for (uint64_t key = 0; keys_.size() < kNumWorkers; ++key) {
+      if (!used[dispatcher_->GetWorkerIndex(key)]) {
+        used[dispatcher_->GetWorkerIndex(key)] = true;
+        keys_.push_back(key);
+      }
+    }
+  }
+
+  void TearDown() {
+    release_key_generation_.Signal();
+    dispatcher_->Stop();
+    adaptor_.reset();
+    service_->TearDown();
+  }
+
+  // Starts a key generation on |kSlowSession| that holds slot 0's lock until
+  // |release_key_generation_| is signaled.
+  void StartSlowCall() {
+    EXPECT_CALL(slow_session_, GenerateKeyPair(_, _, _, _, _, _, _, _))
+        .WillOnce(DoAll(InvokeWithoutArgs(&key_generation_started_,
+                                          &WaitableEvent::Signal),
+                        InvokeWithoutArgs(&release_key_generation_,
+                                          &WaitableEvent::Wait),
+                        Return(CKR_OK)));
+    dispatcher_->Post(keys_[0], base::Bind(&GenerateKeyPair, adaptor_.get(),
+                                           &key_generation_result_));
+    ASSERT_TRUE(key_generation_started_.TimedWait(TimeDelta::FromSeconds(10)));
+  }
+
+  base::ScopedTempDir temp_dir_;
+  DBus::BusDispatcher bus_dispatcher_;
+  std::unique_ptr<TestServer> server_;
+  std::unique_ptr<DBus::Connection> connection_;
+  std::shared_ptr<SlotManagerMock> slot_manager_;
+  SessionMock slow_session_;
+  SessionMock search_session_;
+  std::unique_ptr<ChapsServiceImpl> service_;
+  ReadWriteLock lock_;
+  std::unique_ptr<ChapsAdaptor> adaptor_;
+  std::unique_ptr<RequestDispatcher> dispatcher_;
+  vector<uint64_t> keys_;
+  WaitableEvent key_generation_started_;
+  WaitableEvent release_key_generation_;
+  uint32_t key_generation_result_;
+};
+
+// Searches on a slot don't wait for a slow call on another session of the
+// slot, while destroying an object does.
+TEST_F(TestChapsAdaptor, SearchesDoNotWaitForSlowCalls) {
+  EXPECT_CALL(*slot_manager_, HasStaleKeys(0)).WillRepeatedly(Return(false));
+  EXPECT_CALL(*slot_manager_, RemoveStaleKeys(_)).Times(0);
+  EXPECT_CALL(search_session_, FindObjectsInit(_, _))
+      .Times(2)
+      .WillRepeatedly(Return(CKR_OK));
+  EXPECT_CALL(search_session_, FindObjects(10, _)).WillOnce(Return(CKR_OK));
+  EXPECT_CALL(search_session_, FindObjectsFinal()).WillOnce(Return(CKR_OK));
+  EXPECT_CALL(search_session_, DestroyObject(1)).WillOnce(Return(CKR_OK));
+  StartSlowCall();
+
+  WaitableEvent find_init_done(true, false);
+  WaitableEvent find_with_attributes_done(true, false);
+  WaitableEvent destroy_done(true, false);
+  dispatcher_->Post(keys_[1], base::Bind(&FindObjectsInit, adaptor_.get(),
+                                         &find_init_done));
+  EXPECT_TRUE(find_init_done.TimedWait(TimeDelta::FromSeconds(10)));
+  dispatcher_->Post(keys_[2], base::Bind(&FindObjectsWithAttributes,
+                                         adaptor_.get(),
+                                         &find_with_attributes_done));
+  EXPECT_TRUE(find_with_attributes_done.TimedWait(TimeDelta::FromSeconds(10)));
+  dispatcher_->Post(keys_[3], base::Bind(&DestroyObject, adaptor_.get(),
+                                         &destroy_done));
+  EXPECT_FALSE(destroy_done.TimedWait(TimeDelta::FromMilliseconds(100)));
+
+  release_key_generation_.Signal();
+  EXPECT_TRUE(destroy_done.TimedWait(TimeDelta::FromSeconds(10)));
+  dispatcher_->Stop();
+  EXPECT_EQ(CKR_OK, key_generation_result_);
+}
+
+// Keys that a search found deleted from the NetHSM are removed only once no
+// other call on the slot is running.
+TEST_F(TestChapsAdaptor, StaleKeysAreRemovedWithTheSlotToThemselves) {
+  EXPECT_CALL(*slot_manager_, HasStaleKeys(0)).WillRepeatedly(Return(true));
+  WaitableEvent search_done(true, false);
+  EXPECT_CALL(search_session_, FindObjectsInit(_, _))
+      .WillOnce(DoAll(InvokeWithoutArgs(&search_done, &WaitableEvent::Signal),
+                      Return(CKR_OK)));
+  WaitableEvent removed(true, false);
+  EXPECT_CALL(*slot_manager_, RemoveStaleKeys(0))
+      .WillOnce(InvokeWithoutArgs(&removed, &WaitableEvent::Signal));
+  StartSlowCall();
+
+  WaitableEvent find_init_done(true, false);
+  dispatcher_->Post(keys_[1], base::Bind(&FindObjectsInit, adaptor_.get(),
+                                         &find_init_done));
+  EXPECT_TRUE(search_done.TimedWait(TimeDelta::FromSeconds(10)));
+  EXPECT_FALSE(removed.TimedWait(TimeDelta::FromMilliseconds(100)));
+
+  release_key_generation_.Signal();
+  EXPECT_TRUE(removed.TimedWait(TimeDelta::FromSeconds(10)));
+  EXPECT_TRUE(find_init_done.TimedWait(TimeDelta::FromSeconds(10)));
+  dispatcher_->Stop();
+}
+
+// Destroying the adaptor runs the calls that were already handed to its
+// RequestDispatcher, which use it.
+TEST_F(TestChapsAdaptor, DestructorDrainsDispatcher) {
+  EXPECT_CALL(*slot_manager_, HasStaleKeys(0)).WillRepeatedly(Return(false));
+  EXPECT_CALL(search_session_, FindObjectsInit(_, _))
+      .WillOnce(Return(CKR_OK));
+  RequestDispatcher dispatcher(1);
+  ASSERT_TRUE(dispatcher.Start());
+  std::unique_ptr<ChapsAdaptor> adaptor(
+      new ChapsAdaptor(connection_.get(), &lock_, service_.get(), NULL,
+                       slot_manager_.get(), &dispatcher));
+  WaitableEvent find_init_done(true, false);
+  dispatcher.Post(RequestDispatcher::GetSessionKey(kSearchSession),
+                  base::Bind(&FindObjectsInit, adaptor.get(),
+                             &find_init_done));
+  adaptor.reset();
+  EXPECT_TRUE(find_init_done.IsSignaled());
+}
+
+}  // namespace chaps
@@ -43,6 +43,8 @@ void PrintHelp() {
          "      0 - Normal\n     -1 - Verbose (Logs PKCS #11 calls.)\n"
          "     -2 - More Verbose (Logs PKCS #11 calls and arguments.)\n");
   printf("  --list : Lists all loaded token paths.\n");
+  printf("  --latency_stats : Prints call counts and latencies of chapsd"
+         " operations.\n");
 }
 
 void Ping() {
@@ -101,6 +103,16 @@ void SetLogLevel(int level) {
   proxy.SetLogLevel(level);
 }
 
+void PrintLatencyStats() {
+  chaps::ChapsProxyImpl proxy;
+  if (!proxy.Init())
+    exit(-1);
+  string stats;
+  if (!proxy.GetLatencyStats(&stats))
+    exit(-1);
+  printf("%s", stats.c_str());
+}
+
 void ListTokens() {
   chaps::ChapsProxyImpl proxy;
   if (!proxy.Init())
@@ -145,7 +157,9 @@ int main(int argc, char** argv) {
                       cl->HasSwitch("new_auth"));
   bool set_log_level = cl->HasSwitch("set_log_level");
   bool list = cl->HasSwitch("list");
-  if (ping + load + unload + change_auth + set_log_level + list != 1) {
+  bool latency_stats = cl->HasSwitch("latency_stats");
+  if (ping + load + unload + change_auth + set_log_level + list +
+      latency_stats != 1) {
     PrintHelp();
     exit(-1);
   }
@@ -173,6 +187,8 @@ int main(int argc, char** argv) {
     SetLogLevel(level);
   } else if (list) {
     ListTokens();
+  } else if (latency_stats) {
+    PrintLatencyStats();
   }
   return 0;
 }
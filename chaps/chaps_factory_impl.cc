@@ -8,6 +8,7 @@
 
 #include <base/logging.h>
 
+#include "chaps/nethsm_transport.h"
 #include "chaps/object_impl.h"
 #include "chaps/object_policy_cert.h"
 #include "chaps/object_policy_common.h"
@@ -87,8 +88,17 @@ ObjectPolicy* ChapsFactoryImpl::CreateObjectPolicy(CK_OBJECT_CLASS type) {
 NetUtility* ChapsFactoryImpl::CreateNetUtility(
   std::shared_ptr<ObjectPool> token_object_pool
 ) {
+  std::shared_ptr<NetHsmTransport> transport;
+  {
+    base::AutoLock lock(nethsm_transport_lock_);
+    if (!nethsm_transport_)
+      nethsm_transport_.reset(
+          new NetHsmTransport(NetHsmTransport::Options()));
+    transport = nethsm_transport_;
+  }
   return new NetUtilityImpl(token_object_pool,
-                            shared_from_this());
+                            shared_from_this(),
+                            transport);
 }
 
 }  // namespace chaps
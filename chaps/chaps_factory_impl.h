@@ -7,10 +7,15 @@
 
 #include "chaps/chaps_factory.h"
 
+#include <memory>
+
 #include <base/macros.h>
+#include <base/synchronization/lock.h>
 
 namespace chaps {
 
+class NetHsmTransport;
+
 class ChapsFactoryImpl : public ChapsFactory,
                          public std::enable_shared_from_this<ChapsFactoryImpl> {
  public:
@@ -29,6 +34,11 @@ class ChapsFactoryImpl : public ChapsFactory,
   virtual NetUtility* CreateNetUtility(std::shared_ptr<ObjectPool> token_object_pool);
 
  private:
+  // All NetUtility instances share one pool of NetHSM connections. It is
+  // created by the first call to CreateNetUtility().
+  base::Lock nethsm_transport_lock_;
+  std::shared_ptr<NetHsmTransport> nethsm_transport_;
+
   DISALLOW_COPY_AND_ASSIGN(ChapsFactoryImpl);
 };
 
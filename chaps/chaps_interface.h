@@ -182,6 +182,31 @@ class ChapsInterface {
   virtual uint32_t FindObjectsFinal(
       const brillo::SecureBlob& isolate_credential,
       uint64_t session_id) = 0;
+  // Not part of PKCS #11: GetAttributeValue with the template in
+  // |attributes_in| for each object in |object_handles|, in one call. The
+  // attributes and result GetAttributeValue would have returned for
+  // object_handles[i] are in (*attributes_out)[i] and (*results)[i]. Fails as a
+  // whole only if the session or the arguments are invalid.
+  virtual uint32_t GetAttributeValues(
+      const brillo::SecureBlob& isolate_credential,
+      uint64_t session_id,
+      const std::vector<uint64_t>& object_handles,
+      const std::vector<uint8_t>& attributes_in,
+      std::vector<std::vector<uint8_t>>* attributes_out,
+      std::vector<uint32_t>* results) = 0;
+  // Not part of PKCS #11: a complete search for at most |max_object_count|
+  // objects matching |find_template| (FindObjectsInit, FindObjects and
+  // FindObjectsFinal), followed by GetAttributeValues on the objects found.
+  // The session must not have a search in progress.
+  virtual uint32_t FindObjectsWithAttributes(
+      const brillo::SecureBlob& isolate_credential,
+      uint64_t session_id,
+      const std::vector<uint8_t>& find_template,
+      const std::vector<uint8_t>& attributes_in,
+      uint64_t max_object_count,
+      std::vector<uint64_t>* object_list,
+      std::vector<std::vector<uint8_t>>* attributes_out,
+      std::vector<uint32_t>* results) = 0;
   // PKCS #11 v2.20 section 11.8 page 139.
   virtual uint32_t EncryptInit(const brillo::SecureBlob& isolate_credential,
                                uint64_t session_id,
@@ -167,6 +167,21 @@ void ChapsProxyImpl::SetLogLevel(const int32_t& level) {
   }
 }
 
+bool ChapsProxyImpl::GetLatencyStats(string* stats) {
+  AutoLock lock(lock_);
+  if (!proxy_.get()) {
+    LOG(ERROR) << "Failed to get latency stats: proxy not initialized.";
+    return false;
+  }
+  try {
+    *stats = proxy_->GetLatencyStats();
+  } catch (DBus::Error err) {
+    LOG(ERROR) << "DBus::Error - " << err.what();
+    return false;
+  }
+  return true;
+}
+
 uint32_t ChapsProxyImpl::GetSlotList(const SecureBlob& isolate_credential,
                                      bool token_present,
                                      vector<uint64_t>* slot_list) {
@@ -693,6 +708,63 @@ uint32_t ChapsProxyImpl::FindObjectsFinal(const SecureBlob& isolate_credential,
   return result;
 }
 
+uint32_t ChapsProxyImpl::GetAttributeValues(
+    const SecureBlob& isolate_credential,
+    uint64_t session_id,
+    const vector<uint64_t>& object_handles,
+    const vector<uint8_t>& attributes_in,
+    vector<vector<uint8_t>>* attributes_out,
+    vector<uint32_t>* results) {
+  AutoLock lock(lock_);
+  LOG_CK_RV_AND_RETURN_IF(!proxy_.get(), CKR_CRYPTOKI_NOT_INITIALIZED);
+  LOG_CK_RV_AND_RETURN_IF(!attributes_out || !results, CKR_ARGUMENTS_BAD);
+  uint32_t result = CKR_GENERAL_ERROR;
+  try {
+    proxy_->GetAttributeValues(isolate_credential,
+                               session_id,
+                               object_handles,
+                               attributes_in,
+                               *attributes_out,
+                               *results,
+                               result);
+  } catch (DBus::Error err) {
+    result = CKR_GENERAL_ERROR;
+    LOG(ERROR) << "DBus::Error - " << err.what();
+  }
+  return result;
+}
+
+uint32_t ChapsProxyImpl::FindObjectsWithAttributes(
+    const SecureBlob& isolate_credential,
+    uint64_t session_id,
+    const vector<uint8_t>& find_template,
+    const vector<uint8_t>& attributes_in,
+    uint64_t max_object_count,
+    vector<uint64_t>* object_list,
+    vector<vector<uint8_t>>* attributes_out,
+    vector<uint32_t>* results) {
+  AutoLock lock(lock_);
+  LOG_CK_RV_AND_RETURN_IF(!proxy_.get(), CKR_CRYPTOKI_NOT_INITIALIZED);
+  LOG_CK_RV_AND_RETURN_IF(!object_list || !attributes_out || !results,
+                          CKR_ARGUMENTS_BAD);
+  uint32_t result = CKR_GENERAL_ERROR;
+  try {
+    proxy_->FindObjectsWithAttributes(isolate_credential,
+                                      session_id,
+                                      find_template,
+                                      attributes_in,
+                                      max_object_count,
+                                      *object_list,
+                                      *attributes_out,
+                                      *results,
+                                      result);
+  } catch (DBus::Error err) {
+    result = CKR_GENERAL_ERROR;
+    LOG(ERROR) << "DBus::Error - " << err.what();
+  }
+  return result;
+}
+
 uint32_t ChapsProxyImpl::EncryptInit(
     const SecureBlob& isolate_credential,
     uint64_t session_id,
@@ -49,6 +49,8 @@ class ChapsProxyImpl : public ChapsInterface {
                             std::string* path);
 
   virtual void SetLogLevel(const int32_t& level);
+  // Gets the latency statistics dump of the daemon.
+  virtual bool GetLatencyStats(std::string* stats);
 
   // ChapsInterface methods.
   virtual uint32_t GetSlotList(const brillo::SecureBlob& isolate_credential,
@@ -175,6 +177,22 @@ class ChapsProxyImpl : public ChapsInterface {
   virtual uint32_t FindObjectsFinal(
       const brillo::SecureBlob& isolate_credential,
       uint64_t session_id);
+  virtual uint32_t GetAttributeValues(
+      const brillo::SecureBlob& isolate_credential,
+      uint64_t session_id,
+      const std::vector<uint64_t>& object_handles,
+      const std::vector<uint8_t>& attributes_in,
+      std::vector<std::vector<uint8_t>>* attributes_out,
+      std::vector<uint32_t>* results);
+  virtual uint32_t FindObjectsWithAttributes(
+      const brillo::SecureBlob& isolate_credential,
+      uint64_t session_id,
+      const std::vector<uint8_t>& find_template,
+      const std::vector<uint8_t>& attributes_in,
+      uint64_t max_object_count,
+      std::vector<uint64_t>* object_list,
+      std::vector<std::vector<uint8_t>>* attributes_out,
+      std::vector<uint32_t>* results);
   virtual uint32_t EncryptInit(const brillo::SecureBlob& isolate_credential,
                                uint64_t session_id,
                                uint64_t mechanism_type,
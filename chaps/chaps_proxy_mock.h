@@ -117,6 +117,22 @@ class ChapsProxyMock : public ChapsInterface {
                                            uint64_t,
                                            const std::vector<uint8_t>&,
                                            std::vector<uint8_t>*));
+  MOCK_METHOD6(GetAttributeValues,
+               uint32_t(const brillo::SecureBlob&,
+                        uint64_t,
+                        const std::vector<uint64_t>&,
+                        const std::vector<uint8_t>&,
+                        std::vector<std::vector<uint8_t>>*,
+                        std::vector<uint32_t>*));
+  MOCK_METHOD8(FindObjectsWithAttributes,
+               uint32_t(const brillo::SecureBlob&,
+                        uint64_t,
+                        const std::vector<uint8_t>&,
+                        const std::vector<uint8_t>&,
+                        uint64_t,
+                        std::vector<uint64_t>*,
+                        std::vector<std::vector<uint8_t>>*,
+                        std::vector<uint32_t>*));
   MOCK_METHOD4(SetAttributeValue, uint32_t(const brillo::SecureBlob&,
                                            uint64_t,
                                            uint64_t,
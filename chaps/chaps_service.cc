@@ -10,6 +10,7 @@
 #include "chaps/attributes.h"
 #include "chaps/chaps.h"
 #include "chaps/chaps_utility.h"
+#include "chaps/latency_stats.h"
 #include "chaps/object.h"
 #include "chaps/session.h"
 #include "chaps/slot_manager.h"
@@ -20,6 +21,21 @@ using brillo::SecureBlob;
 
 namespace chaps {
 
+namespace {
+
+const char kLatencyCategory[] = "Service";
+
+}  // namespace
+
+// Like the LOG_CK_RV_AND_RETURN macros, but also count the value as the result
+// of the call in the enclosing ScopedLatency, which must be named |latency|.
+#define RECORD_CK_RV_AND_RETURN(value) \
+    {LOG_CK_RV(value); return latency.Return(value);}
+#define RECORD_CK_RV_AND_RETURN_IF(condition, value) if (condition) \
+    RECORD_CK_RV_AND_RETURN(value)
+#define RECORD_CK_RV_AND_RETURN_IF_ERR(value) \
+    RECORD_CK_RV_AND_RETURN_IF((value) != CKR_OK, value)
+
 ChapsServiceImpl::ChapsServiceImpl(std::shared_ptr<SlotManager> slot_manager)
     : slot_manager_(slot_manager),
       init_(false) {
@@ -42,9 +58,10 @@ void ChapsServiceImpl::TearDown() {
 uint32_t ChapsServiceImpl::GetSlotList(const SecureBlob& isolate_credential,
                                        bool token_present,
                                        vector<uint64_t>* slot_list) {
+  ScopedLatency latency(kLatencyCategory, __func__);
   CHECK(init_);
   if (!slot_list || slot_list->size() > 0)
-    LOG_CK_RV_AND_RETURN(CKR_ARGUMENTS_BAD);
+    RECORD_CK_RV_AND_RETURN(CKR_ARGUMENTS_BAD);
   int num_slots = slot_manager_->GetSlotCount();
   for (int i = 0; i < num_slots; ++i) {
     if (slot_manager_->IsTokenAccessible(isolate_credential, i) &&
@@ -52,7 +69,7 @@ uint32_t ChapsServiceImpl::GetSlotList(const SecureBlob& isolate_credential,
          slot_manager_->IsTokenPresent(isolate_credential, i)))
       slot_list->push_back(i);
   }
-  return CKR_OK;
+  return latency.Return(CKR_OK);
 }
 
 uint32_t ChapsServiceImpl::GetSlotInfo(const SecureBlob& isolate_credential,
@@ -64,14 +81,15 @@ uint32_t ChapsServiceImpl::GetSlotInfo(const SecureBlob& isolate_credential,
                                        uint8_t* hardware_version_minor,
                                        uint8_t* firmware_version_major,
                                        uint8_t* firmware_version_minor) {
+  ScopedLatency latency(kLatencyCategory, __func__);
   if (!slot_description || !manufacturer_id || !flags ||
       !hardware_version_major || !hardware_version_minor ||
       !firmware_version_major || !firmware_version_minor) {
-    LOG_CK_RV_AND_RETURN(CKR_ARGUMENTS_BAD);
+    RECORD_CK_RV_AND_RETURN(CKR_ARGUMENTS_BAD);
   }
   if (static_cast<int>(slot_id) >= slot_manager_->GetSlotCount() ||
       !slot_manager_->IsTokenAccessible(isolate_credential, slot_id))
-    LOG_CK_RV_AND_RETURN(CKR_SLOT_ID_INVALID);
+    RECORD_CK_RV_AND_RETURN(CKR_SLOT_ID_INVALID);
   CK_SLOT_INFO slot_info;
   slot_manager_->GetSlotInfo(isolate_credential, slot_id, &slot_info);
   *slot_description =
@@ -85,7 +103,7 @@ uint32_t ChapsServiceImpl::GetSlotInfo(const SecureBlob& isolate_credential,
   *hardware_version_minor = slot_info.hardwareVersion.minor;
   *firmware_version_major = slot_info.firmwareVersion.major;
   *firmware_version_minor = slot_info.firmwareVersion.minor;
-  return CKR_OK;
+  return latency.Return(CKR_OK);
 }
 
 uint32_t ChapsServiceImpl::GetTokenInfo(const SecureBlob& isolate_credential,
@@ -109,6 +127,7 @@ uint32_t ChapsServiceImpl::GetTokenInfo(const SecureBlob& isolate_credential,
                                         uint8_t* hardware_version_minor,
                                         uint8_t* firmware_version_major,
                                         uint8_t* firmware_version_minor) {
+  ScopedLatency latency(kLatencyCategory, __func__);
   if (!label || !manufacturer_id || !model || !serial_number || !flags ||
       !max_session_count || !session_count || !max_session_count_rw ||
       !session_count_rw || !max_pin_len || !min_pin_len ||
@@ -116,14 +135,14 @@ uint32_t ChapsServiceImpl::GetTokenInfo(const SecureBlob& isolate_credential,
       !total_private_memory || !free_private_memory ||
       !hardware_version_major || !hardware_version_minor ||
       !firmware_version_major || !firmware_version_minor) {
-    LOG_CK_RV_AND_RETURN(CKR_ARGUMENTS_BAD);
+    RECORD_CK_RV_AND_RETURN(CKR_ARGUMENTS_BAD);
   }
   if (static_cast<int>(slot_id) >= slot_manager_->GetSlotCount() ||
       !slot_manager_->IsTokenAccessible(isolate_credential, slot_id))
-    LOG_CK_RV_AND_RETURN(CKR_SLOT_ID_INVALID);
-  LOG_CK_RV_AND_RETURN_IF(!slot_manager_->IsTokenPresent(isolate_credential,
-                                                         slot_id),
-                          CKR_TOKEN_NOT_PRESENT);
+    RECORD_CK_RV_AND_RETURN(CKR_SLOT_ID_INVALID);
+  RECORD_CK_RV_AND_RETURN_IF(!slot_manager_->IsTokenPresent(isolate_credential,
+                                                            slot_id),
+                             CKR_TOKEN_NOT_PRESENT);
   CK_TOKEN_INFO token_info;
   slot_manager_->GetTokenInfo(isolate_credential, slot_id, &token_info);
   *label =
@@ -151,21 +170,22 @@ uint32_t ChapsServiceImpl::GetTokenInfo(const SecureBlob& isolate_credential,
   *hardware_version_minor = token_info.hardwareVersion.minor;
   *firmware_version_major = token_info.firmwareVersion.major;
   *firmware_version_minor = token_info.firmwareVersion.minor;
-  return CKR_OK;
+  return latency.Return(CKR_OK);
 }
 
 uint32_t ChapsServiceImpl::GetMechanismList(
     const SecureBlob& isolate_credential,
     uint64_t slot_id,
     vector<uint64_t>* mechanism_list) {
-  LOG_CK_RV_AND_RETURN_IF(!mechanism_list || mechanism_list->size() > 0,
-                          CKR_ARGUMENTS_BAD);
+  ScopedLatency latency(kLatencyCategory, __func__);
+  RECORD_CK_RV_AND_RETURN_IF(!mechanism_list || mechanism_list->size() > 0,
+                             CKR_ARGUMENTS_BAD);
   if (static_cast<int>(slot_id) >= slot_manager_->GetSlotCount() ||
       !slot_manager_->IsTokenAccessible(isolate_credential, slot_id))
-    LOG_CK_RV_AND_RETURN(CKR_SLOT_ID_INVALID);
-  LOG_CK_RV_AND_RETURN_IF(!slot_manager_->IsTokenPresent(isolate_credential,
-                                                         slot_id),
-                          CKR_TOKEN_NOT_PRESENT);
+    RECORD_CK_RV_AND_RETURN(CKR_SLOT_ID_INVALID);
+  RECORD_CK_RV_AND_RETURN_IF(!slot_manager_->IsTokenPresent(isolate_credential,
+                                                            slot_id),
+                             CKR_TOKEN_NOT_PRESENT);
   const MechanismMap* mechanism_info =
     slot_manager_->GetMechanismInfo(isolate_credential, slot_id);
   CHECK(mechanism_info);
@@ -174,7 +194,7 @@ uint32_t ChapsServiceImpl::GetMechanismList(
        ++it) {
     mechanism_list->push_back(it->first);
   }
-  return CKR_OK;
+  return latency.Return(CKR_OK);
 }
 
 uint32_t ChapsServiceImpl::GetMechanismInfo(
@@ -184,113 +204,121 @@ uint32_t ChapsServiceImpl::GetMechanismInfo(
       uint64_t* min_key_size,
       uint64_t* max_key_size,
       uint64_t* flags) {
+  ScopedLatency latency(kLatencyCategory, __func__);
   if (!min_key_size || !max_key_size || !flags)
-    LOG_CK_RV_AND_RETURN(CKR_ARGUMENTS_BAD);
+    RECORD_CK_RV_AND_RETURN(CKR_ARGUMENTS_BAD);
   if (static_cast<int>(slot_id) >= slot_manager_->GetSlotCount() ||
       !slot_manager_->IsTokenAccessible(isolate_credential, slot_id))
-    LOG_CK_RV_AND_RETURN(CKR_SLOT_ID_INVALID);
-  LOG_CK_RV_AND_RETURN_IF(!slot_manager_->IsTokenPresent(isolate_credential,
-                                                         slot_id),
-                          CKR_TOKEN_NOT_PRESENT);
+    RECORD_CK_RV_AND_RETURN(CKR_SLOT_ID_INVALID);
+  RECORD_CK_RV_AND_RETURN_IF(!slot_manager_->IsTokenPresent(isolate_credential,
+                                                            slot_id),
+                             CKR_TOKEN_NOT_PRESENT);
   const MechanismMap* mechanism_info =
     slot_manager_->GetMechanismInfo(isolate_credential, slot_id);
   CHECK(mechanism_info);
   MechanismMapIterator it = mechanism_info->find(mechanism_type);
-  LOG_CK_RV_AND_RETURN_IF(it == mechanism_info->end(), CKR_MECHANISM_INVALID);
+  RECORD_CK_RV_AND_RETURN_IF(it == mechanism_info->end(),
+                             CKR_MECHANISM_INVALID);
   *min_key_size = static_cast<uint64_t>(it->second.ulMinKeySize);
   *max_key_size = static_cast<uint64_t>(it->second.ulMaxKeySize);
   *flags = static_cast<uint64_t>(it->second.flags);
-  return CKR_OK;
+  return latency.Return(CKR_OK);
 }
 
 uint32_t ChapsServiceImpl::InitToken(const SecureBlob& isolate_credential,
                                      uint64_t slot_id,
                                      const string* so_pin,
                                      const vector<uint8_t>& label) {
-  LOG_CK_RV_AND_RETURN_IF(label.size() != chaps::kTokenLabelSize,
-                          CKR_ARGUMENTS_BAD);
+  ScopedLatency latency(kLatencyCategory, __func__);
+  RECORD_CK_RV_AND_RETURN_IF(label.size() != chaps::kTokenLabelSize,
+                             CKR_ARGUMENTS_BAD);
   if (static_cast<int>(slot_id) >= slot_manager_->GetSlotCount() ||
       !slot_manager_->IsTokenAccessible(isolate_credential, slot_id))
       {
         std::cout << "slot_id: " << slot_id << std::endl;
         std::cout << "GetSlotCount: " << slot_manager_->GetSlotCount() << std::endl;
-        LOG_CK_RV_AND_RETURN(CKR_SLOT_ID_INVALID);
+        RECORD_CK_RV_AND_RETURN(CKR_SLOT_ID_INVALID);
       }
-  LOG_CK_RV_AND_RETURN_IF(!slot_manager_->IsTokenPresent(isolate_credential,
-                                                         slot_id),
-                          CKR_TOKEN_NOT_PRESENT);
+  RECORD_CK_RV_AND_RETURN_IF(!slot_manager_->IsTokenPresent(isolate_credential,
+                                                            slot_id),
+                             CKR_TOKEN_NOT_PRESENT);
   // We have no notion of a security officer role and no notion of initializing
   // a token via this interface.  CKR_FUNCTION_NOT_SUPPORTED could be an option
   // here but reporting an incorrect pin is more likely to be handled gracefully
   // by the caller.
-  LOG_CK_RV_AND_RETURN(CKR_PIN_INCORRECT);
+  RECORD_CK_RV_AND_RETURN(CKR_PIN_INCORRECT);
 }
 
 uint32_t ChapsServiceImpl::InitPIN(const SecureBlob& isolate_credential,
                                    uint64_t session_id, const string* pin) {
+  ScopedLatency latency(kLatencyCategory, __func__);
   Session* session = NULL;
-  LOG_CK_RV_AND_RETURN_IF(!slot_manager_->GetSession(isolate_credential,
-                                                     session_id,
-                                                     &session),
-                          CKR_SESSION_HANDLE_INVALID);
+  RECORD_CK_RV_AND_RETURN_IF(!slot_manager_->GetSession(isolate_credential,
+                                                        session_id,
+                                                        &session),
+                             CKR_SESSION_HANDLE_INVALID);
   CHECK(session);
   // Authentication is not handled via this interface.  Since this function can
   // only be called in the "R/W SO Functions" state and we don't support this
   // state, CKR_USER_NOT_LOGGED_IN is the appropriate response.
-  LOG_CK_RV_AND_RETURN(CKR_USER_NOT_LOGGED_IN);
+  RECORD_CK_RV_AND_RETURN(CKR_USER_NOT_LOGGED_IN);
 }
 
 uint32_t ChapsServiceImpl::SetPIN(const SecureBlob& isolate_credential,
                                   uint64_t session_id,
                                   const string* old_pin,
                                   const string* new_pin) {
+  ScopedLatency latency(kLatencyCategory, __func__);
   Session* session = NULL;
-  LOG_CK_RV_AND_RETURN_IF(!slot_manager_->GetSession(isolate_credential,
-                                                     session_id,
-                                                     &session),
-                          CKR_SESSION_HANDLE_INVALID);
+  RECORD_CK_RV_AND_RETURN_IF(!slot_manager_->GetSession(isolate_credential,
+                                                        session_id,
+                                                        &session),
+                             CKR_SESSION_HANDLE_INVALID);
   CHECK(session);
   // Authentication is not handled via this interface.  We do not support
   // changing a pin or password of any kind.
-  LOG_CK_RV_AND_RETURN(CKR_PIN_INVALID);
+  RECORD_CK_RV_AND_RETURN(CKR_PIN_INVALID);
 }
 
 uint32_t ChapsServiceImpl::OpenSession(const SecureBlob& isolate_credential,
                                        uint64_t slot_id,
                                        uint64_t flags,
                                        uint64_t* session_id) {
-  LOG_CK_RV_AND_RETURN_IF(!session_id, CKR_ARGUMENTS_BAD);
+  ScopedLatency latency(kLatencyCategory, __func__);
+  RECORD_CK_RV_AND_RETURN_IF(!session_id, CKR_ARGUMENTS_BAD);
   if (static_cast<int>(slot_id) >= slot_manager_->GetSlotCount() ||
       !slot_manager_->IsTokenAccessible(isolate_credential, slot_id))
-    LOG_CK_RV_AND_RETURN(CKR_SLOT_ID_INVALID);
-  LOG_CK_RV_AND_RETURN_IF(!slot_manager_->IsTokenPresent(isolate_credential,
-                                                         slot_id),
-                          CKR_TOKEN_NOT_PRESENT);
-  LOG_CK_RV_AND_RETURN_IF(0 == (flags & CKF_SERIAL_SESSION),
-                          CKR_SESSION_PARALLEL_NOT_SUPPORTED);
+    RECORD_CK_RV_AND_RETURN(CKR_SLOT_ID_INVALID);
+  RECORD_CK_RV_AND_RETURN_IF(!slot_manager_->IsTokenPresent(isolate_credential,
+                                                            slot_id),
+                             CKR_TOKEN_NOT_PRESENT);
+  RECORD_CK_RV_AND_RETURN_IF(0 == (flags & CKF_SERIAL_SESSION),
+                             CKR_SESSION_PARALLEL_NOT_SUPPORTED);
   *session_id = slot_manager_->OpenSession(isolate_credential, slot_id,
                                            (flags & CKF_RW_SESSION) == 0);
-  return CKR_OK;
+  return latency.Return(CKR_OK);
 }
 
 uint32_t ChapsServiceImpl::CloseSession(const SecureBlob& isolate_credential,
                                         uint64_t session_id) {
+  ScopedLatency latency(kLatencyCategory, __func__);
   if (!slot_manager_->CloseSession(isolate_credential, session_id))
-    LOG_CK_RV_AND_RETURN(CKR_SESSION_HANDLE_INVALID);
-  return CKR_OK;
+    RECORD_CK_RV_AND_RETURN(CKR_SESSION_HANDLE_INVALID);
+  return latency.Return(CKR_OK);
 }
 
 uint32_t ChapsServiceImpl::CloseAllSessions(
       const SecureBlob& isolate_credential,
       uint64_t slot_id) {
+  ScopedLatency latency(kLatencyCategory, __func__);
   if (static_cast<int>(slot_id) >= slot_manager_->GetSlotCount() ||
       !slot_manager_->IsTokenAccessible(isolate_credential, slot_id))
-    LOG_CK_RV_AND_RETURN(CKR_SLOT_ID_INVALID);
-  LOG_CK_RV_AND_RETURN_IF(!slot_manager_->IsTokenPresent(isolate_credential,
-                                                         slot_id),
-                          CKR_TOKEN_NOT_PRESENT);
+    RECORD_CK_RV_AND_RETURN(CKR_SLOT_ID_INVALID);
+  RECORD_CK_RV_AND_RETURN_IF(!slot_manager_->IsTokenPresent(isolate_credential,
+                                                            slot_id),
+                             CKR_TOKEN_NOT_PRESENT);
   slot_manager_->CloseAllSessions(isolate_credential, slot_id);
-  return CKR_OK;
+  return latency.Return(CKR_OK);
 }
 
 uint32_t ChapsServiceImpl::GetSessionInfo(const SecureBlob& isolate_credential,
@@ -299,13 +327,14 @@ uint32_t ChapsServiceImpl::GetSessionInfo(const SecureBlob& isolate_credential,
                                           uint64_t* state,
                                           uint64_t* flags,
                                           uint64_t* device_error) {
+  ScopedLatency latency(kLatencyCategory, __func__);
   if (!slot_id || !state || !flags || !device_error)
-    LOG_CK_RV_AND_RETURN(CKR_ARGUMENTS_BAD);
+    RECORD_CK_RV_AND_RETURN(CKR_ARGUMENTS_BAD);
   Session* session = NULL;
-  LOG_CK_RV_AND_RETURN_IF(!slot_manager_->GetSession(isolate_credential,
-                                                     session_id,
-                                                     &session),
-                          CKR_SESSION_HANDLE_INVALID);
+  RECORD_CK_RV_AND_RETURN_IF(!slot_manager_->GetSession(isolate_credential,
+                                                        session_id,
+                                                        &session),
+                             CKR_SESSION_HANDLE_INVALID);
   CHECK(session);
   *slot_id = static_cast<uint64_t>(session->GetSlot());
   *state = static_cast<uint64_t>(session->GetState());
@@ -313,28 +342,29 @@ uint32_t ChapsServiceImpl::GetSessionInfo(const SecureBlob& isolate_credential,
   if (!session->IsReadOnly())
     *flags |= CKF_RW_SESSION;
   *device_error = 0;
-  return CKR_OK;
+  return latency.Return(CKR_OK);
 }
 
 uint32_t ChapsServiceImpl::GetOperationState(
     const SecureBlob& isolate_credential,
     uint64_t session_id,
     vector<uint8_t>* operation_state) {
-  LOG_CK_RV_AND_RETURN_IF(!operation_state, CKR_ARGUMENTS_BAD);
+  ScopedLatency latency(kLatencyCategory, __func__);
+  RECORD_CK_RV_AND_RETURN_IF(!operation_state, CKR_ARGUMENTS_BAD);
   Session* session = NULL;
-  LOG_CK_RV_AND_RETURN_IF(!slot_manager_->GetSession(isolate_credential,
-                                                     session_id,
-                                                     &session),
-                          CKR_SESSION_HANDLE_INVALID);
+  RECORD_CK_RV_AND_RETURN_IF(!slot_manager_->GetSession(isolate_credential,
+                                                        session_id,
+                                                        &session),
+                             CKR_SESSION_HANDLE_INVALID);
   CHECK(session);
-  LOG_CK_RV_AND_RETURN_IF(!session->IsOperationActive(kEncrypt) &&
-                          !session->IsOperationActive(kDecrypt) &&
-                          !session->IsOperationActive(kDigest) &&
-                          !session->IsOperationActive(kSign) &&
-                          !session->IsOperationActive(kVerify),
-                          CKR_OPERATION_NOT_INITIALIZED);
+  RECORD_CK_RV_AND_RETURN_IF(!session->IsOperationActive(kEncrypt) &&
+                             !session->IsOperationActive(kDecrypt) &&
+                             !session->IsOperationActive(kDigest) &&
+                             !session->IsOperationActive(kSign) &&
+                             !session->IsOperationActive(kVerify),
+                             CKR_OPERATION_NOT_INITIALIZED);
   // There is an active operation but we'll still refuse to give out state.
-  LOG_CK_RV_AND_RETURN(CKR_STATE_UNSAVEABLE);
+  RECORD_CK_RV_AND_RETURN(CKR_STATE_UNSAVEABLE);
 }
 
 uint32_t ChapsServiceImpl::SetOperationState(
@@ -343,74 +373,79 @@ uint32_t ChapsServiceImpl::SetOperationState(
     const vector<uint8_t>& operation_state,
     uint64_t encryption_key_handle,
     uint64_t authentication_key_handle) {
+  ScopedLatency latency(kLatencyCategory, __func__);
   Session* session = NULL;
-  LOG_CK_RV_AND_RETURN_IF(!slot_manager_->GetSession(isolate_credential,
-                                                     session_id,
-                                                     &session),
-                          CKR_SESSION_HANDLE_INVALID);
+  RECORD_CK_RV_AND_RETURN_IF(!slot_manager_->GetSession(isolate_credential,
+                                                        session_id,
+                                                        &session),
+                             CKR_SESSION_HANDLE_INVALID);
   CHECK(session);
   // We don't give out operation state so there's no way this is valid.
-  LOG_CK_RV_AND_RETURN(CKR_SAVED_STATE_INVALID);
+  RECORD_CK_RV_AND_RETURN(CKR_SAVED_STATE_INVALID);
 }
 
 uint32_t ChapsServiceImpl::Login(const SecureBlob& isolate_credential,
                                  uint64_t session_id,
                                  uint64_t user_type,
                                  const string* pin) {
+  ScopedLatency latency(kLatencyCategory, __func__);
   Session* session = NULL;
-  LOG_CK_RV_AND_RETURN_IF(!slot_manager_->GetSession(isolate_credential,
-                                                     session_id,
-                                                     &session),
-                          CKR_SESSION_HANDLE_INVALID);
+  RECORD_CK_RV_AND_RETURN_IF(!slot_manager_->GetSession(isolate_credential,
+                                                        session_id,
+                                                        &session),
+                             CKR_SESSION_HANDLE_INVALID);
   CHECK(session);
   // We have no notion of a security officer role.
-  LOG_CK_RV_AND_RETURN_IF(user_type == CKU_SO, CKR_PIN_INCORRECT);
-  LOG_CK_RV_AND_RETURN_IF(user_type != CKU_USER &&
-                          user_type != CKU_CONTEXT_SPECIFIC,
-                          CKR_USER_TYPE_INVALID);
+  RECORD_CK_RV_AND_RETURN_IF(user_type == CKU_SO, CKR_PIN_INCORRECT);
+  RECORD_CK_RV_AND_RETURN_IF(user_type != CKU_USER &&
+                             user_type != CKU_CONTEXT_SPECIFIC,
+                             CKR_USER_TYPE_INVALID);
   // For backwards compatibility we'll accept the hard-coded pin previously used
   // with openCryptoki.  We'll also accept a protected authentication path
   // operation (i.e. a null pin).
   const string legacy_pin("111111");
-  LOG_CK_RV_AND_RETURN_IF(pin && *pin != legacy_pin, CKR_PIN_INCORRECT);
+  RECORD_CK_RV_AND_RETURN_IF(pin && *pin != legacy_pin, CKR_PIN_INCORRECT);
   // After calling C_Login, applications will expect private objects to be
   // available for queries. Wait for them to become available before returning.
   session->WaitForPrivateObjects();
   // We could use CKR_USER_ALREADY_LOGGED_IN but that will cause some
   // applications to close all sessions and start from scratch which is
   // unnecessary.
-  return CKR_OK;
+  return latency.Return(CKR_OK);
 }
 
 uint32_t ChapsServiceImpl::Logout(const SecureBlob& isolate_credential,
                                   uint64_t session_id) {
+  ScopedLatency latency(kLatencyCategory, __func__);
   Session* session = NULL;
-  LOG_CK_RV_AND_RETURN_IF(!slot_manager_->GetSession(isolate_credential,
-                                                     session_id,
-                                                     &session),
-                          CKR_SESSION_HANDLE_INVALID);
+  RECORD_CK_RV_AND_RETURN_IF(!slot_manager_->GetSession(isolate_credential,
+                                                        session_id,
+                                                        &session),
+                             CKR_SESSION_HANDLE_INVALID);
   CHECK(session);
-  return CKR_OK;
+  return latency.Return(CKR_OK);
 }
 
 uint32_t ChapsServiceImpl::CreateObject(const SecureBlob& isolate_credential,
                                         uint64_t session_id,
                                         const vector<uint8_t>& attributes,
                                         uint64_t* new_object_handle) {
-  LOG_CK_RV_AND_RETURN_IF(!new_object_handle, CKR_ARGUMENTS_BAD);
+  ScopedLatency latency(kLatencyCategory, __func__);
+  RECORD_CK_RV_AND_RETURN_IF(!new_object_handle, CKR_ARGUMENTS_BAD);
   Session* session = NULL;
-  LOG_CK_RV_AND_RETURN_IF(!slot_manager_->GetSession(isolate_credential,
-                                                     session_id,
-                                                     &session),
-                          CKR_SESSION_HANDLE_INVALID);
+  RECORD_CK_RV_AND_RETURN_IF(!slot_manager_->GetSession(isolate_credential,
+                                                        session_id,
+                                                        &session),
+                             CKR_SESSION_HANDLE_INVALID);
   CHECK(session);
   Attributes parsed_attributes;
-  LOG_CK_RV_AND_RETURN_IF(!parsed_attributes.Parse(attributes),
-                          CKR_TEMPLATE_INCONSISTENT);
-  return session->CreateObject(
-      parsed_attributes.attributes(),
-      parsed_attributes.num_attributes(),
-      PreservedValue<uint64_t, int>(new_object_handle));
+  RECORD_CK_RV_AND_RETURN_IF(!parsed_attributes.Parse(attributes),
+                             CKR_TEMPLATE_INCONSISTENT);
+  return latency.Return(
+      session->CreateObject(
+          parsed_attributes.attributes(),
+          parsed_attributes.num_attributes(),
+          PreservedValue<uint64_t, int>(new_object_handle)));
 }
 
 uint32_t ChapsServiceImpl::CopyObject(const SecureBlob& isolate_credential,
@@ -418,51 +453,55 @@ uint32_t ChapsServiceImpl::CopyObject(const SecureBlob& isolate_credential,
                                       uint64_t object_handle,
                                       const vector<uint8_t>& attributes,
                                       uint64_t* new_object_handle) {
-  LOG_CK_RV_AND_RETURN_IF(!new_object_handle, CKR_ARGUMENTS_BAD);
+  ScopedLatency latency(kLatencyCategory, __func__);
+  RECORD_CK_RV_AND_RETURN_IF(!new_object_handle, CKR_ARGUMENTS_BAD);
   Session* session = NULL;
-  LOG_CK_RV_AND_RETURN_IF(!slot_manager_->GetSession(isolate_credential,
-                                                     session_id,
-                                                     &session),
-                          CKR_SESSION_HANDLE_INVALID);
+  RECORD_CK_RV_AND_RETURN_IF(!slot_manager_->GetSession(isolate_credential,
+                                                        session_id,
+                                                        &session),
+                             CKR_SESSION_HANDLE_INVALID);
   CHECK(session);
   Attributes parsed_attributes;
-  LOG_CK_RV_AND_RETURN_IF(!parsed_attributes.Parse(attributes),
-                          CKR_TEMPLATE_INCONSISTENT);
-  return session->CopyObject(parsed_attributes.attributes(),
-                             parsed_attributes.num_attributes(),
-                             object_handle,
-                             PreservedValue<uint64_t, int>(new_object_handle));
+  RECORD_CK_RV_AND_RETURN_IF(!parsed_attributes.Parse(attributes),
+                             CKR_TEMPLATE_INCONSISTENT);
+  return latency.Return(
+      session->CopyObject(parsed_attributes.attributes(),
+                          parsed_attributes.num_attributes(),
+                          object_handle,
+                          PreservedValue<uint64_t, int>(new_object_handle)));
 }
 
 uint32_t ChapsServiceImpl::DestroyObject(const SecureBlob& isolate_credential,
                                          uint64_t session_id,
                                          uint64_t object_handle) {
+  ScopedLatency latency(kLatencyCategory, __func__);
   Session* session = NULL;
-  LOG_CK_RV_AND_RETURN_IF(!slot_manager_->GetSession(isolate_credential,
-                                                     session_id,
-                                                     &session),
-                          CKR_SESSION_HANDLE_INVALID);
+  RECORD_CK_RV_AND_RETURN_IF(!slot_manager_->GetSession(isolate_credential,
+                                                        session_id,
+                                                        &session),
+                             CKR_SESSION_HANDLE_INVALID);
   CHECK(session);
-  return session->DestroyObject(object_handle);
+  return latency.Return(session->DestroyObject(object_handle));
 }
 
 uint32_t ChapsServiceImpl::GetObjectSize(const SecureBlob& isolate_credential,
                                          uint64_t session_id,
                                          uint64_t object_handle,
                                          uint64_t* object_size) {
-  LOG_CK_RV_AND_RETURN_IF(!object_size, CKR_ARGUMENTS_BAD);
+  ScopedLatency latency(kLatencyCategory, __func__);
+  RECORD_CK_RV_AND_RETURN_IF(!object_size, CKR_ARGUMENTS_BAD);
   Session* session = NULL;
-  LOG_CK_RV_AND_RETURN_IF(!slot_manager_->GetSession(isolate_credential,
-                                                     session_id,
-                                                     &session),
-                          CKR_SESSION_HANDLE_INVALID);
+  RECORD_CK_RV_AND_RETURN_IF(!slot_manager_->GetSession(isolate_credential,
+                                                        session_id,
+                                                        &session),
+                             CKR_SESSION_HANDLE_INVALID);
   CHECK(session);
   const Object* object = NULL;
-  LOG_CK_RV_AND_RETURN_IF(!session->GetObject(object_handle, &object),
-                          CKR_OBJECT_HANDLE_INVALID);
+  RECORD_CK_RV_AND_RETURN_IF(!session->GetObject(object_handle, &object),
+                             CKR_OBJECT_HANDLE_INVALID);
   CHECK(object);
   *object_size = object->GetSize();
-  return CKR_OK;
+  return latency.Return(CKR_OK);
 }
 
 uint32_t ChapsServiceImpl::GetAttributeValue(
@@ -471,28 +510,17 @@ uint32_t ChapsServiceImpl::GetAttributeValue(
     uint64_t object_handle,
     const vector<uint8_t>& attributes_in,
     vector<uint8_t>* attributes_out) {
-  LOG_CK_RV_AND_RETURN_IF(!attributes_out, CKR_ARGUMENTS_BAD);
+  ScopedLatency latency(kLatencyCategory, __func__);
+  RECORD_CK_RV_AND_RETURN_IF(!attributes_out, CKR_ARGUMENTS_BAD);
   Session* session = NULL;
-  LOG_CK_RV_AND_RETURN_IF(!slot_manager_->GetSession(isolate_credential,
-                                                     session_id,
-                                                     &session),
-                          CKR_SESSION_HANDLE_INVALID);
+  RECORD_CK_RV_AND_RETURN_IF(!slot_manager_->GetSession(isolate_credential,
+                                                        session_id,
+                                                        &session),
+                             CKR_SESSION_HANDLE_INVALID);
   CHECK(session);
-  const Object* object = NULL;
-  LOG_CK_RV_AND_RETURN_IF(!session->GetObject(object_handle, &object),
-                          CKR_OBJECT_HANDLE_INVALID);
-  CHECK(object);
-  Attributes tmp;
-  LOG_CK_RV_AND_RETURN_IF(!tmp.Parse(attributes_in), CKR_TEMPLATE_INCONSISTENT);
-  CK_RV result = object->GetAttributes(tmp.attributes(), tmp.num_attributes());
-  if (result == CKR_OK ||
-      result == CKR_ATTRIBUTE_SENSITIVE ||
-      result == CKR_ATTRIBUTE_TYPE_INVALID ||
-      result == CKR_BUFFER_TOO_SMALL) {
-    LOG_CK_RV_AND_RETURN_IF(!tmp.Serialize(attributes_out),
-                            CKR_FUNCTION_FAILED);
-  }
-  return result;
+  return latency.Return(
+      GetObjectAttributes(session, object_handle, attributes_in,
+                          attributes_out));
 }
 
 uint32_t ChapsServiceImpl::SetAttributeValue(
@@ -500,51 +528,56 @@ uint32_t ChapsServiceImpl::SetAttributeValue(
     uint64_t session_id,
     uint64_t object_handle,
     const vector<uint8_t>& attributes) {
+  ScopedLatency latency(kLatencyCategory, __func__);
   Session* session = NULL;
-  LOG_CK_RV_AND_RETURN_IF(!slot_manager_->GetSession(isolate_credential,
-                                                     session_id,
-                                                     &session),
-                          CKR_SESSION_HANDLE_INVALID);
+  RECORD_CK_RV_AND_RETURN_IF(!slot_manager_->GetSession(isolate_credential,
+                                                        session_id,
+                                                        &session),
+                             CKR_SESSION_HANDLE_INVALID);
   CHECK(session);
   Object* object = NULL;
-  LOG_CK_RV_AND_RETURN_IF(!session->GetModifiableObject(object_handle, &object),
-                          CKR_OBJECT_HANDLE_INVALID);
+  RECORD_CK_RV_AND_RETURN_IF(
+      !session->GetModifiableObject(object_handle, &object),
+      CKR_OBJECT_HANDLE_INVALID);
   CHECK(object);
   Attributes tmp;
-  LOG_CK_RV_AND_RETURN_IF(!tmp.Parse(attributes), CKR_TEMPLATE_INCONSISTENT);
+  RECORD_CK_RV_AND_RETURN_IF(!tmp.Parse(attributes), CKR_TEMPLATE_INCONSISTENT);
   CK_RV result = object->SetAttributes(tmp.attributes(), tmp.num_attributes());
-  LOG_CK_RV_AND_RETURN_IF_ERR(result);
-  LOG_CK_RV_AND_RETURN_IF(!session->FlushModifiableObject(object),
-                          CKR_FUNCTION_FAILED);
-  return CKR_OK;
+  RECORD_CK_RV_AND_RETURN_IF_ERR(result);
+  RECORD_CK_RV_AND_RETURN_IF(!session->FlushModifiableObject(object),
+                             CKR_FUNCTION_FAILED);
+  return latency.Return(CKR_OK);
 }
 
 uint32_t ChapsServiceImpl::FindObjectsInit(
     const SecureBlob& isolate_credential,
     uint64_t session_id,
     const vector<uint8_t>& attributes) {
+  ScopedLatency latency(kLatencyCategory, __func__);
   Session* session = NULL;
-  LOG_CK_RV_AND_RETURN_IF(!slot_manager_->GetSession(isolate_credential,
-                                                     session_id,
-                                                     &session),
-                          CKR_SESSION_HANDLE_INVALID);
+  RECORD_CK_RV_AND_RETURN_IF(!slot_manager_->GetSession(isolate_credential,
+                                                        session_id,
+                                                        &session),
+                             CKR_SESSION_HANDLE_INVALID);
   CHECK(session);
   Attributes tmp;
-  LOG_CK_RV_AND_RETURN_IF(!tmp.Parse(attributes), CKR_TEMPLATE_INCONSISTENT);
-  return session->FindObjectsInit(tmp.attributes(), tmp.num_attributes());
+  RECORD_CK_RV_AND_RETURN_IF(!tmp.Parse(attributes), CKR_TEMPLATE_INCONSISTENT);
+  return latency.Return(
+      session->FindObjectsInit(tmp.attributes(), tmp.num_attributes()));
 }
 
 uint32_t ChapsServiceImpl::FindObjects(const SecureBlob& isolate_credential,
                                        uint64_t session_id,
                                        uint64_t max_object_count,
                                        vector<uint64_t>* object_list) {
+  ScopedLatency latency(kLatencyCategory, __func__);
   if (!object_list || object_list->size() > 0)
-    LOG_CK_RV_AND_RETURN(CKR_ARGUMENTS_BAD);
+    RECORD_CK_RV_AND_RETURN(CKR_ARGUMENTS_BAD);
   Session* session = NULL;
-  LOG_CK_RV_AND_RETURN_IF(!slot_manager_->GetSession(isolate_credential,
-                                                     session_id,
-                                                     &session),
-                          CKR_SESSION_HANDLE_INVALID);
+  RECORD_CK_RV_AND_RETURN_IF(!slot_manager_->GetSession(isolate_credential,
+                                                        session_id,
+                                                        &session),
+                             CKR_SESSION_HANDLE_INVALID);
   CHECK(session);
   vector<int> tmp;
   CK_RV result = session->FindObjects(max_object_count, &tmp);
@@ -553,19 +586,86 @@ uint32_t ChapsServiceImpl::FindObjects(const SecureBlob& isolate_credential,
       object_list->push_back(static_cast<uint64_t>(tmp[i]));
     }
   }
-  return result;
+  return latency.Return(result);
 }
 
 uint32_t ChapsServiceImpl::FindObjectsFinal(
       const SecureBlob& isolate_credential,
       uint64_t session_id) {
+  ScopedLatency latency(kLatencyCategory, __func__);
   Session* session = NULL;
-  LOG_CK_RV_AND_RETURN_IF(!slot_manager_->GetSession(isolate_credential,
-                                                     session_id,
-                                                     &session),
-                          CKR_SESSION_HANDLE_INVALID);
+  RECORD_CK_RV_AND_RETURN_IF(!slot_manager_->GetSession(isolate_credential,
+                                                        session_id,
+                                                        &session),
+                             CKR_SESSION_HANDLE_INVALID);
   CHECK(session);
-  return session->FindObjectsFinal();
+  return latency.Return(session->FindObjectsFinal());
+}
+
+uint32_t ChapsServiceImpl::GetAttributeValues(
+    const SecureBlob& isolate_credential,
+    uint64_t session_id,
+    const vector<uint64_t>& object_handles,
+    const vector<uint8_t>& attributes_in,
+    vector<vector<uint8_t>>* attributes_out,
+    vector<uint32_t>* results) {
+  ScopedLatency latency(kLatencyCategory, __func__);
+  if (!attributes_out || attributes_out->size() > 0 ||
+      !results || results->size() > 0)
+    RECORD_CK_RV_AND_RETURN(CKR_ARGUMENTS_BAD);
+  Session* session = NULL;
+  RECORD_CK_RV_AND_RETURN_IF(!slot_manager_->GetSession(isolate_credential,
+                                                        session_id,
+                                                        &session),
+                             CKR_SESSION_HANDLE_INVALID);
+  CHECK(session);
+  attributes_out->resize(object_handles.size());
+  results->resize(object_handles.size());
+  for (size_t i = 0; i < object_handles.size(); ++i) {
+    (*results)[i] = GetObjectAttributes(session, object_handles[i],
+                                        attributes_in, &(*attributes_out)[i]);
+  }
+  return latency.Return(CKR_OK);
+}
+
+uint32_t ChapsServiceImpl::FindObjectsWithAttributes(
+    const SecureBlob& isolate_credential,
+    uint64_t session_id,
+    const vector<uint8_t>& find_template,
+    const vector<uint8_t>& attributes_in,
+    uint64_t max_object_count,
+    vector<uint64_t>* object_list,
+    vector<vector<uint8_t>>* attributes_out,
+    vector<uint32_t>* results) {
+  ScopedLatency latency(kLatencyCategory, __func__);
+  if (!object_list || object_list->size() > 0 ||
+      !attributes_out || attributes_out->size() > 0 ||
+      !results || results->size() > 0)
+    RECORD_CK_RV_AND_RETURN(CKR_ARGUMENTS_BAD);
+  Session* session = NULL;
+  RECORD_CK_RV_AND_RETURN_IF(!slot_manager_->GetSession(isolate_credential,
+                                                        session_id,
+                                                        &session),
+                             CKR_SESSION_HANDLE_INVALID);
+  CHECK(session);
+  Attributes tmp;
+  RECORD_CK_RV_AND_RETURN_IF(!tmp.Parse(find_template),
+                             CKR_TEMPLATE_INCONSISTENT);
+  CK_RV result = session->FindObjectsInit(tmp.attributes(),
+                                          tmp.num_attributes());
+  RECORD_CK_RV_AND_RETURN_IF_ERR(result);
+  vector<int> found;
+  result = session->FindObjects(max_object_count, &found);
+  session->FindObjectsFinal();
+  RECORD_CK_RV_AND_RETURN_IF_ERR(result);
+  attributes_out->resize(found.size());
+  results->resize(found.size());
+  for (size_t i = 0; i < found.size(); ++i) {
+    object_list->push_back(static_cast<uint64_t>(found[i]));
+    (*results)[i] = GetObjectAttributes(session, found[i], attributes_in,
+                                        &(*attributes_out)[i]);
+  }
+  return latency.Return(CKR_OK);
 }
 
 uint32_t ChapsServiceImpl::EncryptInit(
@@ -574,20 +674,22 @@ uint32_t ChapsServiceImpl::EncryptInit(
     uint64_t mechanism_type,
     const vector<uint8_t>& mechanism_parameter,
     uint64_t key_handle) {
+  ScopedLatency latency(kLatencyCategory, __func__);
   Session* session = NULL;
-  LOG_CK_RV_AND_RETURN_IF(!slot_manager_->GetSession(isolate_credential,
-                                                     session_id,
-                                                     &session),
-                          CKR_SESSION_HANDLE_INVALID);
+  RECORD_CK_RV_AND_RETURN_IF(!slot_manager_->GetSession(isolate_credential,
+                                                        session_id,
+                                                        &session),
+                             CKR_SESSION_HANDLE_INVALID);
   CHECK(session);
   const Object* key = NULL;
-  LOG_CK_RV_AND_RETURN_IF(!session->GetObject(key_handle, &key),
-                          CKR_KEY_HANDLE_INVALID);
+  RECORD_CK_RV_AND_RETURN_IF(!session->GetObject(key_handle, &key),
+                             CKR_KEY_HANDLE_INVALID);
   CHECK(key);
-  return session->OperationInit(kEncrypt,
-                                mechanism_type,
-                                ConvertByteVectorToString(mechanism_parameter),
-                                key);
+  return latency.Return(
+      session->OperationInit(kEncrypt,
+                             mechanism_type,
+                             ConvertByteVectorToString(mechanism_parameter),
+                             key));
 }
 
 uint32_t ChapsServiceImpl::Encrypt(const SecureBlob& isolate_credential,
@@ -596,19 +698,22 @@ uint32_t ChapsServiceImpl::Encrypt(const SecureBlob& isolate_credential,
                                    uint64_t max_out_length,
                                    uint64_t* actual_out_length,
                                    vector<uint8_t>* data_out) {
-  LOG_CK_RV_AND_RETURN_IF(!actual_out_length || !data_out, CKR_ARGUMENTS_BAD);
+  ScopedLatency latency(kLatencyCategory, __func__);
+  RECORD_CK_RV_AND_RETURN_IF(!actual_out_length || !data_out,
+                             CKR_ARGUMENTS_BAD);
   Session* session = NULL;
-  LOG_CK_RV_AND_RETURN_IF(!slot_manager_->GetSession(isolate_credential,
-                                                     session_id,
-                                                     &session),
-                          CKR_SESSION_HANDLE_INVALID);
+  RECORD_CK_RV_AND_RETURN_IF(!slot_manager_->GetSession(isolate_credential,
+                                                        session_id,
+                                                        &session),
+                             CKR_SESSION_HANDLE_INVALID);
   CHECK(session);
   *actual_out_length = max_out_length;
-  return session->OperationSinglePart(
-      kEncrypt,
-      ConvertByteVectorToString(data_in),
-      PreservedValue<uint64_t, int>(actual_out_length),
-      PreservedByteVector(data_out));
+  return latency.Return(
+      session->OperationSinglePart(
+          kEncrypt,
+          ConvertByteVectorToString(data_in),
+          PreservedValue<uint64_t, int>(actual_out_length),
+          PreservedByteVector(data_out)));
 }
 
 uint32_t ChapsServiceImpl::EncryptUpdate(
@@ -618,19 +723,22 @@ uint32_t ChapsServiceImpl::EncryptUpdate(
     uint64_t max_out_length,
     uint64_t* actual_out_length,
     vector<uint8_t>* data_out) {
-  LOG_CK_RV_AND_RETURN_IF(!actual_out_length || !data_out, CKR_ARGUMENTS_BAD);
+  ScopedLatency latency(kLatencyCategory, __func__);
+  RECORD_CK_RV_AND_RETURN_IF(!actual_out_length || !data_out,
+                             CKR_ARGUMENTS_BAD);
   Session* session = NULL;
-  LOG_CK_RV_AND_RETURN_IF(!slot_manager_->GetSession(isolate_credential,
-                                                     session_id,
-                                                     &session),
-                          CKR_SESSION_HANDLE_INVALID);
+  RECORD_CK_RV_AND_RETURN_IF(!slot_manager_->GetSession(isolate_credential,
+                                                        session_id,
+                                                        &session),
+                             CKR_SESSION_HANDLE_INVALID);
   CHECK(session);
   *actual_out_length = max_out_length;
-  return session->OperationUpdate(
-      kEncrypt,
-      ConvertByteVectorToString(data_in),
-      PreservedValue<uint64_t, int>(actual_out_length),
-      PreservedByteVector(data_out));
+  return latency.Return(
+      session->OperationUpdate(
+          kEncrypt,
+          ConvertByteVectorToString(data_in),
+          PreservedValue<uint64_t, int>(actual_out_length),
+          PreservedByteVector(data_out)));
 }
 
 uint32_t ChapsServiceImpl::EncryptFinal(const SecureBlob& isolate_credential,
@@ -638,22 +746,26 @@ uint32_t ChapsServiceImpl::EncryptFinal(const SecureBlob& isolate_credential,
                                         uint64_t max_out_length,
                                         uint64_t* actual_out_length,
                                         vector<uint8_t>* data_out) {
-  LOG_CK_RV_AND_RETURN_IF(!actual_out_length || !data_out, CKR_ARGUMENTS_BAD);
+  ScopedLatency latency(kLatencyCategory, __func__);
+  RECORD_CK_RV_AND_RETURN_IF(!actual_out_length || !data_out,
+                             CKR_ARGUMENTS_BAD);
   Session* session = NULL;
-  LOG_CK_RV_AND_RETURN_IF(!slot_manager_->GetSession(isolate_credential,
-                                                     session_id,
-                                                     &session),
-                          CKR_SESSION_HANDLE_INVALID);
+  RECORD_CK_RV_AND_RETURN_IF(!slot_manager_->GetSession(isolate_credential,
+                                                        session_id,
+                                                        &session),
+                             CKR_SESSION_HANDLE_INVALID);
   CHECK(session);
   *actual_out_length = max_out_length;
-  return session->OperationFinal(
-      kEncrypt,
-      PreservedValue<uint64_t, int>(actual_out_length),
-      PreservedByteVector(data_out));
+  return latency.Return(
+      session->OperationFinal(
+          kEncrypt,
+          PreservedValue<uint64_t, int>(actual_out_length),
+          PreservedByteVector(data_out)));
 }
 
 void ChapsServiceImpl::EncryptCancel(const SecureBlob& isolate_credential,
                                      uint64_t session_id) {
+  ScopedLatency latency(kLatencyCategory, __func__);
   Session* session = NULL;
   if (!slot_manager_->GetSession(isolate_credential,
                                  session_id,
@@ -669,20 +781,22 @@ uint32_t ChapsServiceImpl::DecryptInit(
     uint64_t mechanism_type,
     const vector<uint8_t>& mechanism_parameter,
     uint64_t key_handle) {
+  ScopedLatency latency(kLatencyCategory, __func__);
   Session* session = NULL;
-  LOG_CK_RV_AND_RETURN_IF(!slot_manager_->GetSession(isolate_credential,
-                                                     session_id,
-                                                     &session),
-                          CKR_SESSION_HANDLE_INVALID);
+  RECORD_CK_RV_AND_RETURN_IF(!slot_manager_->GetSession(isolate_credential,
+                                                        session_id,
+                                                        &session),
+                             CKR_SESSION_HANDLE_INVALID);
   CHECK(session);
   const Object* key = NULL;
-  LOG_CK_RV_AND_RETURN_IF(!session->GetObject(key_handle, &key),
-                          CKR_KEY_HANDLE_INVALID);
+  RECORD_CK_RV_AND_RETURN_IF(!session->GetObject(key_handle, &key),
+                             CKR_KEY_HANDLE_INVALID);
   CHECK(key);
-  return session->OperationInit(kDecrypt,
-                                mechanism_type,
-                                ConvertByteVectorToString(mechanism_parameter),
-                                key);
+  return latency.Return(
+      session->OperationInit(kDecrypt,
+                             mechanism_type,
+                             ConvertByteVectorToString(mechanism_parameter),
+                             key));
 }
 
 uint32_t ChapsServiceImpl::Decrypt(const SecureBlob& isolate_credential,
@@ -691,19 +805,22 @@ uint32_t ChapsServiceImpl::Decrypt(const SecureBlob& isolate_credential,
                                    uint64_t max_out_length,
                                    uint64_t* actual_out_length,
                                    vector<uint8_t>* data_out) {
-  LOG_CK_RV_AND_RETURN_IF(!actual_out_length || !data_out, CKR_ARGUMENTS_BAD);
+  ScopedLatency latency(kLatencyCategory, __func__);
+  RECORD_CK_RV_AND_RETURN_IF(!actual_out_length || !data_out,
+                             CKR_ARGUMENTS_BAD);
   Session* session = NULL;
-  LOG_CK_RV_AND_RETURN_IF(!slot_manager_->GetSession(isolate_credential,
-                                                     session_id,
-                                                     &session),
-                          CKR_SESSION_HANDLE_INVALID);
+  RECORD_CK_RV_AND_RETURN_IF(!slot_manager_->GetSession(isolate_credential,
+                                                        session_id,
+                                                        &session),
+                             CKR_SESSION_HANDLE_INVALID);
   CHECK(session);
   *actual_out_length = max_out_length;
-  return session->OperationSinglePart(
-      kDecrypt,
-      ConvertByteVectorToString(data_in),
-      PreservedValue<uint64_t, int>(actual_out_length),
-      PreservedByteVector(data_out));
+  return latency.Return(
+      session->OperationSinglePart(
+          kDecrypt,
+          ConvertByteVectorToString(data_in),
+          PreservedValue<uint64_t, int>(actual_out_length),
+          PreservedByteVector(data_out)));
 }
 
 uint32_t ChapsServiceImpl::DecryptUpdate(
@@ -713,19 +830,22 @@ uint32_t ChapsServiceImpl::DecryptUpdate(
     uint64_t max_out_length,
     uint64_t* actual_out_length,
     vector<uint8_t>* data_out) {
-  LOG_CK_RV_AND_RETURN_IF(!actual_out_length || !data_out, CKR_ARGUMENTS_BAD);
+  ScopedLatency latency(kLatencyCategory, __func__);
+  RECORD_CK_RV_AND_RETURN_IF(!actual_out_length || !data_out,
+                             CKR_ARGUMENTS_BAD);
   Session* session = NULL;
-  LOG_CK_RV_AND_RETURN_IF(!slot_manager_->GetSession(isolate_credential,
-                                                     session_id,
-                                                     &session),
-                          CKR_SESSION_HANDLE_INVALID);
+  RECORD_CK_RV_AND_RETURN_IF(!slot_manager_->GetSession(isolate_credential,
+                                                        session_id,
+                                                        &session),
+                             CKR_SESSION_HANDLE_INVALID);
   CHECK(session);
   *actual_out_length = max_out_length;
-  return session->OperationUpdate(
-      kDecrypt,
-      ConvertByteVectorToString(data_in),
-      PreservedValue<uint64_t, int>(actual_out_length),
-      PreservedByteVector(data_out));
+  return latency.Return(
+      session->OperationUpdate(
+          kDecrypt,
+          ConvertByteVectorToString(data_in),
+          PreservedValue<uint64_t, int>(actual_out_length),
+          PreservedByteVector(data_out)));
 }
 
 uint32_t ChapsServiceImpl::DecryptFinal(const SecureBlob& isolate_credential,
@@ -733,22 +853,26 @@ uint32_t ChapsServiceImpl::DecryptFinal(const SecureBlob& isolate_credential,
                                         uint64_t max_out_length,
                                         uint64_t* actual_out_length,
                                         vector<uint8_t>* data_out) {
-  LOG_CK_RV_AND_RETURN_IF(!actual_out_length || !data_out, CKR_ARGUMENTS_BAD);
+  ScopedLatency latency(kLatencyCategory, __func__);
+  RECORD_CK_RV_AND_RETURN_IF(!actual_out_length || !data_out,
+                             CKR_ARGUMENTS_BAD);
   Session* session = NULL;
-  LOG_CK_RV_AND_RETURN_IF(!slot_manager_->GetSession(isolate_credential,
-                                                     session_id,
-                                                     &session),
-                          CKR_SESSION_HANDLE_INVALID);
+  RECORD_CK_RV_AND_RETURN_IF(!slot_manager_->GetSession(isolate_credential,
+                                                        session_id,
+                                                        &session),
+                             CKR_SESSION_HANDLE_INVALID);
   CHECK(session);
   *actual_out_length = max_out_length;
-  return session->OperationFinal(
-      kDecrypt,
-      PreservedValue<uint64_t, int>(actual_out_length),
-      PreservedByteVector(data_out));
+  return latency.Return(
+      session->OperationFinal(
+          kDecrypt,
+          PreservedValue<uint64_t, int>(actual_out_length),
+          PreservedByteVector(data_out)));
 }
 
 void ChapsServiceImpl::DecryptCancel(const SecureBlob& isolate_credential,
                                      uint64_t session_id) {
+  ScopedLatency latency(kLatencyCategory, __func__);
   Session* session = NULL;
   if (!slot_manager_->GetSession(isolate_credential,
                                  session_id,
@@ -764,16 +888,18 @@ uint32_t ChapsServiceImpl::DigestInit(
     uint64_t session_id,
     uint64_t mechanism_type,
     const vector<uint8_t>& mechanism_parameter) {
+  ScopedLatency latency(kLatencyCategory, __func__);
   Session* session = NULL;
-  LOG_CK_RV_AND_RETURN_IF(!slot_manager_->GetSession(isolate_credential,
-                                                     session_id,
-                                                     &session),
-                          CKR_SESSION_HANDLE_INVALID);
+  RECORD_CK_RV_AND_RETURN_IF(!slot_manager_->GetSession(isolate_credential,
+                                                        session_id,
+                                                        &session),
+                             CKR_SESSION_HANDLE_INVALID);
   CHECK(session);
-  return session->OperationInit(kDigest,
-                                mechanism_type,
-                                ConvertByteVectorToString(mechanism_parameter),
-                                NULL);
+  return latency.Return(
+      session->OperationInit(kDigest,
+                             mechanism_type,
+                             ConvertByteVectorToString(mechanism_parameter),
+                             NULL));
 }
 
 uint32_t ChapsServiceImpl::Digest(const SecureBlob& isolate_credential,
@@ -782,41 +908,46 @@ uint32_t ChapsServiceImpl::Digest(const SecureBlob& isolate_credential,
                                   uint64_t max_out_length,
                                   uint64_t* actual_out_length,
                                   vector<uint8_t>* digest) {
-  LOG_CK_RV_AND_RETURN_IF(!actual_out_length || !digest, CKR_ARGUMENTS_BAD);
+  ScopedLatency latency(kLatencyCategory, __func__);
+  RECORD_CK_RV_AND_RETURN_IF(!actual_out_length || !digest, CKR_ARGUMENTS_BAD);
   Session* session = NULL;
-  LOG_CK_RV_AND_RETURN_IF(!slot_manager_->GetSession(isolate_credential,
-                                                     session_id,
-                                                     &session),
-                          CKR_SESSION_HANDLE_INVALID);
+  RECORD_CK_RV_AND_RETURN_IF(!slot_manager_->GetSession(isolate_credential,
+                                                        session_id,
+                                                        &session),
+                             CKR_SESSION_HANDLE_INVALID);
   CHECK(session);
   *actual_out_length = max_out_length;
-  return session->OperationSinglePart(
-      kDigest,
-      ConvertByteVectorToString(data_in),
-      PreservedValue<uint64_t, int>(actual_out_length),
-      PreservedByteVector(digest));
+  return latency.Return(
+      session->OperationSinglePart(
+          kDigest,
+          ConvertByteVectorToString(data_in),
+          PreservedValue<uint64_t, int>(actual_out_length),
+          PreservedByteVector(digest)));
 }
 
 uint32_t ChapsServiceImpl::DigestUpdate(const SecureBlob& isolate_credential,
                                         uint64_t session_id,
                                         const vector<uint8_t>& data_in) {
+  ScopedLatency latency(kLatencyCategory, __func__);
   Session* session = NULL;
-  LOG_CK_RV_AND_RETURN_IF(!slot_manager_->GetSession(isolate_credential,
-                                                     session_id,
-                                                     &session),
-                          CKR_SESSION_HANDLE_INVALID);
+  RECORD_CK_RV_AND_RETURN_IF(!slot_manager_->GetSession(isolate_credential,
+                                                        session_id,
+                                                        &session),
+                             CKR_SESSION_HANDLE_INVALID);
   CHECK(session);
-  return session->OperationUpdate(kDigest,
-                                  ConvertByteVectorToString(data_in),
-                                  NULL,
-                                  NULL);
+  return latency.Return(
+      session->OperationUpdate(kDigest,
+                               ConvertByteVectorToString(data_in),
+                               NULL,
+                               NULL));
 }
 
 uint32_t ChapsServiceImpl::DigestKey(const SecureBlob& isolate_credential,
                                      uint64_t session_id,
                                      uint64_t key_handle) {
+  ScopedLatency latency(kLatencyCategory, __func__);
   // We don't give out key digests.
-  LOG_CK_RV_AND_RETURN(CKR_KEY_INDIGESTIBLE);
+  RECORD_CK_RV_AND_RETURN(CKR_KEY_INDIGESTIBLE);
 }
 
 uint32_t ChapsServiceImpl::DigestFinal(const SecureBlob& isolate_credential,
@@ -824,22 +955,25 @@ uint32_t ChapsServiceImpl::DigestFinal(const SecureBlob& isolate_credential,
                                        uint64_t max_out_length,
                                        uint64_t* actual_out_length,
                                        vector<uint8_t>* digest) {
-  LOG_CK_RV_AND_RETURN_IF(!actual_out_length || !digest, CKR_ARGUMENTS_BAD);
+  ScopedLatency latency(kLatencyCategory, __func__);
+  RECORD_CK_RV_AND_RETURN_IF(!actual_out_length || !digest, CKR_ARGUMENTS_BAD);
   Session* session = NULL;
-  LOG_CK_RV_AND_RETURN_IF(!slot_manager_->GetSession(isolate_credential,
-                                                     session_id,
-                                                     &session),
-                          CKR_SESSION_HANDLE_INVALID);
+  RECORD_CK_RV_AND_RETURN_IF(!slot_manager_->GetSession(isolate_credential,
+                                                        session_id,
+                                                        &session),
+                             CKR_SESSION_HANDLE_INVALID);
   CHECK(session);
   *actual_out_length = max_out_length;
-  return session->OperationFinal(
-      kDigest,
-      PreservedValue<uint64_t, int>(actual_out_length),
-      PreservedByteVector(digest));
+  return latency.Return(
+      session->OperationFinal(
+          kDigest,
+          PreservedValue<uint64_t, int>(actual_out_length),
+          PreservedByteVector(digest)));
 }
 
 void ChapsServiceImpl::DigestCancel(const SecureBlob& isolate_credential,
                                     uint64_t session_id) {
+  ScopedLatency latency(kLatencyCategory, __func__);
   Session* session = NULL;
   if (!slot_manager_->GetSession(isolate_credential,
                                  session_id,
@@ -855,20 +989,22 @@ uint32_t ChapsServiceImpl::SignInit(
     uint64_t mechanism_type,
     const vector<uint8_t>& mechanism_parameter,
     uint64_t key_handle) {
+  ScopedLatency latency(kLatencyCategory, __func__);
   Session* session = NULL;
-  LOG_CK_RV_AND_RETURN_IF(!slot_manager_->GetSession(isolate_credential,
-                                                     session_id,
-                                                     &session),
-                          CKR_SESSION_HANDLE_INVALID);
+  RECORD_CK_RV_AND_RETURN_IF(!slot_manager_->GetSession(isolate_credential,
+                                                        session_id,
+                                                        &session),
+                             CKR_SESSION_HANDLE_INVALID);
   CHECK(session);
   const Object* key = NULL;
-  LOG_CK_RV_AND_RETURN_IF(!session->GetObject(key_handle, &key),
-                          CKR_KEY_HANDLE_INVALID);
+  RECORD_CK_RV_AND_RETURN_IF(!session->GetObject(key_handle, &key),
+                             CKR_KEY_HANDLE_INVALID);
   CHECK(key);
-  return session->OperationInit(kSign,
-                                mechanism_type,
-                                ConvertByteVectorToString(mechanism_parameter),
-                                key);
+  return latency.Return(
+      session->OperationInit(kSign,
+                             mechanism_type,
+                             ConvertByteVectorToString(mechanism_parameter),
+                             key));
 }
 
 uint32_t ChapsServiceImpl::Sign(const SecureBlob& isolate_credential,
@@ -877,34 +1013,39 @@ uint32_t ChapsServiceImpl::Sign(const SecureBlob& isolate_credential,
                                 uint64_t max_out_length,
                                 uint64_t* actual_out_length,
                                 vector<uint8_t>* signature) {
-  LOG_CK_RV_AND_RETURN_IF(!actual_out_length || !signature, CKR_ARGUMENTS_BAD);
+  ScopedLatency latency(kLatencyCategory, __func__);
+  RECORD_CK_RV_AND_RETURN_IF(!actual_out_length || !signature,
+                             CKR_ARGUMENTS_BAD);
   Session* session = NULL;
-  LOG_CK_RV_AND_RETURN_IF(!slot_manager_->GetSession(isolate_credential,
-                                                     session_id,
-                                                     &session),
-                          CKR_SESSION_HANDLE_INVALID);
+  RECORD_CK_RV_AND_RETURN_IF(!slot_manager_->GetSession(isolate_credential,
+                                                        session_id,
+                                                        &session),
+                             CKR_SESSION_HANDLE_INVALID);
   CHECK(session);
   *actual_out_length = max_out_length;
-  return session->OperationSinglePart(
-      kSign,
-      ConvertByteVectorToString(data),
-      PreservedValue<uint64_t, int>(actual_out_length),
-      PreservedByteVector(signature));
+  return latency.Return(
+      session->OperationSinglePart(
+          kSign,
+          ConvertByteVectorToString(data),
+          PreservedValue<uint64_t, int>(actual_out_length),
+          PreservedByteVector(signature)));
 }
 
 uint32_t ChapsServiceImpl::SignUpdate(const SecureBlob& isolate_credential,
                                       uint64_t session_id,
                                       const vector<uint8_t>& data_part) {
+  ScopedLatency latency(kLatencyCategory, __func__);
   Session* session = NULL;
-  LOG_CK_RV_AND_RETURN_IF(!slot_manager_->GetSession(isolate_credential,
-                                                     session_id,
-                                                     &session),
-                          CKR_SESSION_HANDLE_INVALID);
+  RECORD_CK_RV_AND_RETURN_IF(!slot_manager_->GetSession(isolate_credential,
+                                                        session_id,
+                                                        &session),
+                             CKR_SESSION_HANDLE_INVALID);
   CHECK(session);
-  return session->OperationUpdate(kSign,
-                                  ConvertByteVectorToString(data_part),
-                                  NULL,
-                                  NULL);
+  return latency.Return(
+      session->OperationUpdate(kSign,
+                               ConvertByteVectorToString(data_part),
+                               NULL,
+                               NULL));
 }
 
 uint32_t ChapsServiceImpl::SignFinal(const SecureBlob& isolate_credential,
@@ -912,22 +1053,26 @@ uint32_t ChapsServiceImpl::SignFinal(const SecureBlob& isolate_credential,
                                      uint64_t max_out_length,
                                      uint64_t* actual_out_length,
                                      vector<uint8_t>* signature) {
-  LOG_CK_RV_AND_RETURN_IF(!actual_out_length || !signature, CKR_ARGUMENTS_BAD);
+  ScopedLatency latency(kLatencyCategory, __func__);
+  RECORD_CK_RV_AND_RETURN_IF(!actual_out_length || !signature,
+                             CKR_ARGUMENTS_BAD);
   Session* session = NULL;
-  LOG_CK_RV_AND_RETURN_IF(!slot_manager_->GetSession(isolate_credential,
-                                                     session_id,
-                                                     &session),
-                          CKR_SESSION_HANDLE_INVALID);
+  RECORD_CK_RV_AND_RETURN_IF(!slot_manager_->GetSession(isolate_credential,
+                                                        session_id,
+                                                        &session),
+                             CKR_SESSION_HANDLE_INVALID);
   CHECK(session);
   *actual_out_length = max_out_length;
-  return session->OperationFinal(
-      kSign,
-      PreservedValue<uint64_t, int>(actual_out_length),
-      PreservedByteVector(signature));
+  return latency.Return(
+      session->OperationFinal(
+          kSign,
+          PreservedValue<uint64_t, int>(actual_out_length),
+          PreservedByteVector(signature)));
 }
 
 void ChapsServiceImpl::SignCancel(const SecureBlob& isolate_credential,
                                   uint64_t session_id) {
+  ScopedLatency latency(kLatencyCategory, __func__);
   Session* session = NULL;
   if (!slot_manager_->GetSession(isolate_credential,
                                  session_id,
@@ -943,7 +1088,8 @@ uint32_t ChapsServiceImpl::SignRecoverInit(
       uint64_t mechanism_type,
       const vector<uint8_t>& mechanism_parameter,
       uint64_t key_handle) {
-  LOG_CK_RV_AND_RETURN(CKR_FUNCTION_NOT_SUPPORTED);
+  ScopedLatency latency(kLatencyCategory, __func__);
+  RECORD_CK_RV_AND_RETURN(CKR_FUNCTION_NOT_SUPPORTED);
 }
 
 uint32_t ChapsServiceImpl::SignRecover(const SecureBlob& isolate_credential,
@@ -952,7 +1098,8 @@ uint32_t ChapsServiceImpl::SignRecover(const SecureBlob& isolate_credential,
                                        uint64_t max_out_length,
                                        uint64_t* actual_out_length,
                                        vector<uint8_t>* signature) {
-  LOG_CK_RV_AND_RETURN(CKR_FUNCTION_NOT_SUPPORTED);
+  ScopedLatency latency(kLatencyCategory, __func__);
+  RECORD_CK_RV_AND_RETURN(CKR_FUNCTION_NOT_SUPPORTED);
 }
 
 uint32_t ChapsServiceImpl::VerifyInit(
@@ -961,61 +1108,69 @@ uint32_t ChapsServiceImpl::VerifyInit(
     uint64_t mechanism_type,
     const vector<uint8_t>& mechanism_parameter,
     uint64_t key_handle) {
+  ScopedLatency latency(kLatencyCategory, __func__);
   Session* session = NULL;
-  LOG_CK_RV_AND_RETURN_IF(!slot_manager_->GetSession(isolate_credential,
-                                                     session_id,
-                                                     &session),
-                          CKR_SESSION_HANDLE_INVALID);
+  RECORD_CK_RV_AND_RETURN_IF(!slot_manager_->GetSession(isolate_credential,
+                                                        session_id,
+                                                        &session),
+                             CKR_SESSION_HANDLE_INVALID);
   CHECK(session);
   const Object* key = NULL;
-  LOG_CK_RV_AND_RETURN_IF(!session->GetObject(key_handle, &key),
-                          CKR_KEY_HANDLE_INVALID);
+  RECORD_CK_RV_AND_RETURN_IF(!session->GetObject(key_handle, &key),
+                             CKR_KEY_HANDLE_INVALID);
   CHECK(key);
-  return session->OperationInit(kVerify,
-                                mechanism_type,
-                                ConvertByteVectorToString(mechanism_parameter),
-                                key);
+  return latency.Return(
+      session->OperationInit(kVerify,
+                             mechanism_type,
+                             ConvertByteVectorToString(mechanism_parameter),
+                             key));
 }
 
 uint32_t ChapsServiceImpl::Verify(const SecureBlob& isolate_credential,
                                   uint64_t session_id,
                                   const vector<uint8_t>& data,
                                   const vector<uint8_t>& signature) {
+  ScopedLatency latency(kLatencyCategory, __func__);
   CK_RV result = VerifyUpdate(isolate_credential, session_id, data);
   if (result == CKR_OK)
     result = VerifyFinal(isolate_credential, session_id, signature);
-  return result;
+  return latency.Return(result);
 }
 
 uint32_t ChapsServiceImpl::VerifyUpdate(const SecureBlob& isolate_credential,
                                         uint64_t session_id,
                                         const vector<uint8_t>& data_part) {
+  ScopedLatency latency(kLatencyCategory, __func__);
   Session* session = NULL;
-  LOG_CK_RV_AND_RETURN_IF(!slot_manager_->GetSession(isolate_credential,
-                                                     session_id,
-                                                     &session),
-                          CKR_SESSION_HANDLE_INVALID);
+  RECORD_CK_RV_AND_RETURN_IF(!slot_manager_->GetSession(isolate_credential,
+                                                        session_id,
+                                                        &session),
+                             CKR_SESSION_HANDLE_INVALID);
   CHECK(session);
-  return session->OperationUpdate(kVerify,
-                                  ConvertByteVectorToString(data_part),
-                                  NULL,
-                                  NULL);
+  return latency.Return(
+      session->OperationUpdate(kVerify,
+                               ConvertByteVectorToString(data_part),
+                               NULL,
+                               NULL));
 }
 
 uint32_t ChapsServiceImpl::VerifyFinal(const SecureBlob& isolate_credential,
                                        uint64_t session_id,
                                        const vector<uint8_t>& signature) {
+  ScopedLatency latency(kLatencyCategory, __func__);
   Session* session = NULL;
-  LOG_CK_RV_AND_RETURN_IF(!slot_manager_->GetSession(isolate_credential,
-                                                     session_id,
-                                                     &session),
-                          CKR_SESSION_HANDLE_INVALID);
+  RECORD_CK_RV_AND_RETURN_IF(!slot_manager_->GetSession(isolate_credential,
+                                                        session_id,
+                                                        &session),
+                             CKR_SESSION_HANDLE_INVALID);
   CHECK(session);
-  return session->VerifyFinal(ConvertByteVectorToString(signature));
+  return latency.Return(
+      session->VerifyFinal(ConvertByteVectorToString(signature)));
 }
 
 void ChapsServiceImpl::VerifyCancel(const SecureBlob& isolate_credential,
                                     uint64_t session_id) {
+  ScopedLatency latency(kLatencyCategory, __func__);
   Session* session = NULL;
   if (!slot_manager_->GetSession(isolate_credential,
                                  session_id,
@@ -1031,7 +1186,8 @@ uint32_t ChapsServiceImpl::VerifyRecoverInit(
       uint64_t mechanism_type,
       const vector<uint8_t>& mechanism_parameter,
       uint64_t key_handle) {
-  LOG_CK_RV_AND_RETURN(CKR_FUNCTION_NOT_SUPPORTED);
+  ScopedLatency latency(kLatencyCategory, __func__);
+  RECORD_CK_RV_AND_RETURN(CKR_FUNCTION_NOT_SUPPORTED);
 }
 
 uint32_t ChapsServiceImpl::VerifyRecover(const SecureBlob& isolate_credential,
@@ -1040,7 +1196,8 @@ uint32_t ChapsServiceImpl::VerifyRecover(const SecureBlob& isolate_credential,
                                          uint64_t max_out_length,
                                          uint64_t* actual_out_length,
                                          vector<uint8_t>* data) {
-  LOG_CK_RV_AND_RETURN(CKR_FUNCTION_NOT_SUPPORTED);
+  ScopedLatency latency(kLatencyCategory, __func__);
+  RECORD_CK_RV_AND_RETURN(CKR_FUNCTION_NOT_SUPPORTED);
 }
 
 uint32_t ChapsServiceImpl::DigestEncryptUpdate(
@@ -1050,7 +1207,8 @@ uint32_t ChapsServiceImpl::DigestEncryptUpdate(
     uint64_t max_out_length,
     uint64_t* actual_out_length,
     vector<uint8_t>* data_out) {
-  LOG_CK_RV_AND_RETURN(CKR_FUNCTION_NOT_SUPPORTED);
+  ScopedLatency latency(kLatencyCategory, __func__);
+  RECORD_CK_RV_AND_RETURN(CKR_FUNCTION_NOT_SUPPORTED);
 }
 
 uint32_t ChapsServiceImpl::DecryptDigestUpdate(
@@ -1060,7 +1218,8 @@ uint32_t ChapsServiceImpl::DecryptDigestUpdate(
     uint64_t max_out_length,
     uint64_t* actual_out_length,
     vector<uint8_t>* data_out) {
-  LOG_CK_RV_AND_RETURN(CKR_FUNCTION_NOT_SUPPORTED);
+  ScopedLatency latency(kLatencyCategory, __func__);
+  RECORD_CK_RV_AND_RETURN(CKR_FUNCTION_NOT_SUPPORTED);
 }
 
 uint32_t ChapsServiceImpl::SignEncryptUpdate(
@@ -1070,7 +1229,8 @@ uint32_t ChapsServiceImpl::SignEncryptUpdate(
     uint64_t max_out_length,
     uint64_t* actual_out_length,
     vector<uint8_t>* data_out) {
-  LOG_CK_RV_AND_RETURN(CKR_FUNCTION_NOT_SUPPORTED);
+  ScopedLatency latency(kLatencyCategory, __func__);
+  RECORD_CK_RV_AND_RETURN(CKR_FUNCTION_NOT_SUPPORTED);
 }
 
 uint32_t ChapsServiceImpl::DecryptVerifyUpdate(
@@ -1080,7 +1240,8 @@ uint32_t ChapsServiceImpl::DecryptVerifyUpdate(
     uint64_t max_out_length,
     uint64_t* actual_out_length,
     vector<uint8_t>* data_out) {
-  LOG_CK_RV_AND_RETURN(CKR_FUNCTION_NOT_SUPPORTED);
+  ScopedLatency latency(kLatencyCategory, __func__);
+  RECORD_CK_RV_AND_RETURN(CKR_FUNCTION_NOT_SUPPORTED);
 }
 
 uint32_t ChapsServiceImpl::GenerateKey(
@@ -1090,20 +1251,22 @@ uint32_t ChapsServiceImpl::GenerateKey(
     const vector<uint8_t>& mechanism_parameter,
     const vector<uint8_t>& attributes,
     uint64_t* key_handle) {
-  LOG_CK_RV_AND_RETURN_IF(!key_handle, CKR_ARGUMENTS_BAD);
+  ScopedLatency latency(kLatencyCategory, __func__);
+  RECORD_CK_RV_AND_RETURN_IF(!key_handle, CKR_ARGUMENTS_BAD);
   Session* session = NULL;
-  LOG_CK_RV_AND_RETURN_IF(!slot_manager_->GetSession(isolate_credential,
-                                                     session_id,
-                                                     &session),
-                          CKR_SESSION_HANDLE_INVALID);
+  RECORD_CK_RV_AND_RETURN_IF(!slot_manager_->GetSession(isolate_credential,
+                                                        session_id,
+                                                        &session),
+                             CKR_SESSION_HANDLE_INVALID);
   CHECK(session);
   Attributes tmp;
-  LOG_CK_RV_AND_RETURN_IF(!tmp.Parse(attributes), CKR_TEMPLATE_INCONSISTENT);
-  return session->GenerateKey(mechanism_type,
-                              ConvertByteVectorToString(mechanism_parameter),
-                              tmp.attributes(),
-                              tmp.num_attributes(),
-                              PreservedValue<uint64_t, int>(key_handle));
+  RECORD_CK_RV_AND_RETURN_IF(!tmp.Parse(attributes), CKR_TEMPLATE_INCONSISTENT);
+  return latency.Return(
+      session->GenerateKey(mechanism_type,
+                           ConvertByteVectorToString(mechanism_parameter),
+                           tmp.attributes(),
+                           tmp.num_attributes(),
+                           PreservedValue<uint64_t, int>(key_handle)));
 }
 
 uint32_t ChapsServiceImpl::GenerateKeyPair(
@@ -1115,29 +1278,31 @@ uint32_t ChapsServiceImpl::GenerateKeyPair(
     const vector<uint8_t>& private_attributes,
     uint64_t* public_key_handle,
     uint64_t* private_key_handle) {
-  LOG_CK_RV_AND_RETURN_IF(!public_key_handle || !private_key_handle,
-                          CKR_ARGUMENTS_BAD);
+  ScopedLatency latency(kLatencyCategory, __func__);
+  RECORD_CK_RV_AND_RETURN_IF(!public_key_handle || !private_key_handle,
+                             CKR_ARGUMENTS_BAD);
   Session* session = NULL;
-  LOG_CK_RV_AND_RETURN_IF(!slot_manager_->GetSession(isolate_credential,
-                                                     session_id,
-                                                     &session),
-                          CKR_SESSION_HANDLE_INVALID);
+  RECORD_CK_RV_AND_RETURN_IF(!slot_manager_->GetSession(isolate_credential,
+                                                        session_id,
+                                                        &session),
+                             CKR_SESSION_HANDLE_INVALID);
   CHECK(session);
   Attributes tmp_public;
-  LOG_CK_RV_AND_RETURN_IF(!tmp_public.Parse(public_attributes),
-                          CKR_TEMPLATE_INCONSISTENT);
+  RECORD_CK_RV_AND_RETURN_IF(!tmp_public.Parse(public_attributes),
+                             CKR_TEMPLATE_INCONSISTENT);
   Attributes tmp_private;
-  LOG_CK_RV_AND_RETURN_IF(!tmp_private.Parse(private_attributes),
-                          CKR_TEMPLATE_INCONSISTENT);
-  return session->GenerateKeyPair(
-      mechanism_type,
-      ConvertByteVectorToString(mechanism_parameter),
-      tmp_public.attributes(),
-      tmp_public.num_attributes(),
-      tmp_private.attributes(),
-      tmp_private.num_attributes(),
-      PreservedValue<uint64_t, int>(public_key_handle),
-      PreservedValue<uint64_t, int>(private_key_handle));
+  RECORD_CK_RV_AND_RETURN_IF(!tmp_private.Parse(private_attributes),
+                             CKR_TEMPLATE_INCONSISTENT);
+  return latency.Return(
+      session->GenerateKeyPair(
+          mechanism_type,
+          ConvertByteVectorToString(mechanism_parameter),
+          tmp_public.attributes(),
+          tmp_public.num_attributes(),
+          tmp_private.attributes(),
+          tmp_private.num_attributes(),
+          PreservedValue<uint64_t, int>(public_key_handle),
+          PreservedValue<uint64_t, int>(private_key_handle)));
 }
 
 uint32_t ChapsServiceImpl::WrapKey(
@@ -1150,7 +1315,8 @@ uint32_t ChapsServiceImpl::WrapKey(
     uint64_t max_out_length,
     uint64_t* actual_out_length,
     vector<uint8_t>* wrapped_key) {
-  LOG_CK_RV_AND_RETURN(CKR_FUNCTION_NOT_SUPPORTED);
+  ScopedLatency latency(kLatencyCategory, __func__);
+  RECORD_CK_RV_AND_RETURN(CKR_FUNCTION_NOT_SUPPORTED);
 }
 
 uint32_t ChapsServiceImpl::UnwrapKey(
@@ -1162,7 +1328,8 @@ uint32_t ChapsServiceImpl::UnwrapKey(
     const vector<uint8_t>& wrapped_key,
     const vector<uint8_t>& attributes,
     uint64_t* key_handle) {
-  LOG_CK_RV_AND_RETURN(CKR_FUNCTION_NOT_SUPPORTED);
+  ScopedLatency latency(kLatencyCategory, __func__);
+  RECORD_CK_RV_AND_RETURN(CKR_FUNCTION_NOT_SUPPORTED);
 }
 
 uint32_t ChapsServiceImpl::DeriveKey(
@@ -1173,36 +1340,61 @@ uint32_t ChapsServiceImpl::DeriveKey(
     uint64_t base_key_handle,
     const vector<uint8_t>& attributes,
     uint64_t* key_handle) {
-  LOG_CK_RV_AND_RETURN(CKR_FUNCTION_NOT_SUPPORTED);
+  ScopedLatency latency(kLatencyCategory, __func__);
+  RECORD_CK_RV_AND_RETURN(CKR_FUNCTION_NOT_SUPPORTED);
 }
 
 uint32_t ChapsServiceImpl::SeedRandom(const SecureBlob& isolate_credential,
                                       uint64_t session_id,
                                       const vector<uint8_t>& seed) {
-  LOG_CK_RV_AND_RETURN_IF(seed.size() == 0, CKR_ARGUMENTS_BAD);
+  ScopedLatency latency(kLatencyCategory, __func__);
+  RECORD_CK_RV_AND_RETURN_IF(seed.size() == 0, CKR_ARGUMENTS_BAD);
   Session* session = NULL;
-  LOG_CK_RV_AND_RETURN_IF(!slot_manager_->GetSession(isolate_credential,
-                                                     session_id,
-                                                     &session),
-                          CKR_SESSION_HANDLE_INVALID);
+  RECORD_CK_RV_AND_RETURN_IF(!slot_manager_->GetSession(isolate_credential,
+                                                        session_id,
+                                                        &session),
+                             CKR_SESSION_HANDLE_INVALID);
   CHECK(session);
   session->SeedRandom(ConvertByteVectorToString(seed));
-  return CKR_OK;
+  return latency.Return(CKR_OK);
 }
 
 uint32_t ChapsServiceImpl::GenerateRandom(const SecureBlob& isolate_credential,
                                           uint64_t session_id,
                                           uint64_t num_bytes,
                                           vector<uint8_t>* random_data) {
-  LOG_CK_RV_AND_RETURN_IF(!random_data || num_bytes == 0, CKR_ARGUMENTS_BAD);
+  ScopedLatency latency(kLatencyCategory, __func__);
+  RECORD_CK_RV_AND_RETURN_IF(!random_data || num_bytes == 0, CKR_ARGUMENTS_BAD);
   Session* session = NULL;
-  LOG_CK_RV_AND_RETURN_IF(!slot_manager_->GetSession(isolate_credential,
-                                                     session_id,
-                                                     &session),
-                          CKR_SESSION_HANDLE_INVALID);
+  RECORD_CK_RV_AND_RETURN_IF(!slot_manager_->GetSession(isolate_credential,
+                                                        session_id,
+                                                        &session),
+                             CKR_SESSION_HANDLE_INVALID);
   CHECK(session);
   session->GenerateRandom(num_bytes, PreservedByteVector(random_data));
-  return CKR_OK;
+  return latency.Return(CKR_OK);
+}
+
+uint32_t ChapsServiceImpl::GetObjectAttributes(
+    Session* session,
+    uint64_t object_handle,
+    const vector<uint8_t>& attributes_in,
+    vector<uint8_t>* attributes_out) {
+  const Object* object = NULL;
+  LOG_CK_RV_AND_RETURN_IF(!session->GetObject(object_handle, &object),
+                          CKR_OBJECT_HANDLE_INVALID);
+  CHECK(object);
+  Attributes tmp;
+  LOG_CK_RV_AND_RETURN_IF(!tmp.Parse(attributes_in), CKR_TEMPLATE_INCONSISTENT);
+  CK_RV result = object->GetAttributes(tmp.attributes(), tmp.num_attributes());
+  if (result == CKR_OK ||
+      result == CKR_ATTRIBUTE_SENSITIVE ||
+      result == CKR_ATTRIBUTE_TYPE_INVALID ||
+      result == CKR_BUFFER_TOO_SMALL) {
+    LOG_CK_RV_AND_RETURN_IF(!tmp.Serialize(attributes_out),
+                            CKR_FUNCTION_FAILED);
+  }
+  return result;
 }
 
 }  // namespace chaps
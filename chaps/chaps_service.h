@@ -150,6 +150,22 @@ class ChapsServiceImpl : public ChapsInterface {
   virtual uint32_t FindObjectsFinal(
       const brillo::SecureBlob& isolate_credential,
       uint64_t session_id);
+  virtual uint32_t GetAttributeValues(
+      const brillo::SecureBlob& isolate_credential,
+      uint64_t session_id,
+      const std::vector<uint64_t>& object_handles,
+      const std::vector<uint8_t>& attributes_in,
+      std::vector<std::vector<uint8_t>>* attributes_out,
+      std::vector<uint32_t>* results);
+  virtual uint32_t FindObjectsWithAttributes(
+      const brillo::SecureBlob& isolate_credential,
+      uint64_t session_id,
+      const std::vector<uint8_t>& find_template,
+      const std::vector<uint8_t>& attributes_in,
+      uint64_t max_object_count,
+      std::vector<uint64_t>* object_list,
+      std::vector<std::vector<uint8_t>>* attributes_out,
+      std::vector<uint32_t>* results);
   virtual uint32_t EncryptInit(const brillo::SecureBlob& isolate_credential,
                                uint64_t session_id,
                                uint64_t mechanism_type,
@@ -360,6 +376,12 @@ class ChapsServiceImpl : public ChapsInterface {
       std::vector<uint8_t>* random_data);
 
  private:
+  // Implements GetAttributeValue for one object of |session|.
+  uint32_t GetObjectAttributes(Session* session,
+                               uint64_t object_handle,
+                               const std::vector<uint8_t>& attributes_in,
+                               std::vector<uint8_t>* attributes_out);
+
   std::shared_ptr<SlotManager> slot_manager_;
   bool init_;
 
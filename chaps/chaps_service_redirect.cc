@@ -557,6 +557,51 @@ uint32_t ChapsServiceRedirect::FindObjectsFinal(
   return CKR_OK;
 }
 
+uint32_t ChapsServiceRedirect::GetAttributeValues(
+    const SecureBlob& isolate_credential,
+    uint64_t session_id,
+    const vector<uint64_t>& object_handles,
+    const vector<uint8_t>& attributes_in,
+    vector<vector<uint8_t>>* attributes_out,
+    vector<uint32_t>* results) {
+  LOG_CK_RV_AND_RETURN_IF(!Init2(), CKR_GENERAL_ERROR);
+  if (!attributes_out || attributes_out->size() > 0 ||
+      !results || results->size() > 0)
+    LOG_CK_RV_AND_RETURN(CKR_ARGUMENTS_BAD);
+  // The PKCS #11 library has no batched call; get one object at a time.
+  attributes_out->resize(object_handles.size());
+  results->resize(object_handles.size());
+  for (size_t i = 0; i < object_handles.size(); ++i) {
+    (*results)[i] = GetAttributeValue(isolate_credential,
+                                      session_id,
+                                      object_handles[i],
+                                      attributes_in,
+                                      &(*attributes_out)[i]);
+  }
+  return CKR_OK;
+}
+
+uint32_t ChapsServiceRedirect::FindObjectsWithAttributes(
+    const SecureBlob& isolate_credential,
+    uint64_t session_id,
+    const vector<uint8_t>& find_template,
+    const vector<uint8_t>& attributes_in,
+    uint64_t max_object_count,
+    vector<uint64_t>* object_list,
+    vector<vector<uint8_t>>* attributes_out,
+    vector<uint32_t>* results) {
+  LOG_CK_RV_AND_RETURN_IF(!Init2(), CKR_GENERAL_ERROR);
+  uint32_t result = FindObjectsInit(isolate_credential, session_id,
+                                    find_template);
+  LOG_CK_RV_AND_RETURN_IF_ERR(result);
+  result = FindObjects(isolate_credential, session_id, max_object_count,
+                       object_list);
+  FindObjectsFinal(isolate_credential, session_id);
+  LOG_CK_RV_AND_RETURN_IF_ERR(result);
+  return GetAttributeValues(isolate_credential, session_id, *object_list,
+                            attributes_in, attributes_out, results);
+}
+
 uint32_t ChapsServiceRedirect::EncryptInit(
     const SecureBlob& isolate_credential,
     uint64_t session_id,
@@ -153,6 +153,22 @@ class ChapsServiceRedirect : public ChapsInterface {
   virtual uint32_t FindObjectsFinal(
       const brillo::SecureBlob& isolate_credential,
       uint64_t session_id);
+  virtual uint32_t GetAttributeValues(
+      const brillo::SecureBlob& isolate_credential,
+      uint64_t session_id,
+      const std::vector<uint64_t>& object_handles,
+      const std::vector<uint8_t>& attributes_in,
+      std::vector<std::vector<uint8_t>>* attributes_out,
+      std::vector<uint32_t>* results);
+  virtual uint32_t FindObjectsWithAttributes(
+      const brillo::SecureBlob& isolate_credential,
+      uint64_t session_id,
+      const std::vector<uint8_t>& find_template,
+      const std::vector<uint8_t>& attributes_in,
+      uint64_t max_object_count,
+      std::vector<uint64_t>* object_list,
+      std::vector<std::vector<uint8_t>>* attributes_out,
+      std::vector<uint32_t>* results);
   virtual uint32_t EncryptInit(const brillo::SecureBlob& isolate_credential,
                                uint64_t session_id,
                                uint64_t mechanism_type,
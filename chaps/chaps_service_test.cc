@@ -696,6 +696,96 @@ TEST_F(TestService, FindObjectsFinal) {
   EXPECT_EQ(CKR_OK, service_->FindObjectsFinal(ic_, 1));
 }
 
+TEST_F(TestService, GetAttributeValues) {
+  EXPECT_CALL(slot_manager_, GetSession(ic_, 1, _))
+    .WillOnce(Return(false))
+    .WillRepeatedly(DoAll(SetArgumentPointee<2>(&session_), Return(true)));
+  EXPECT_CALL(session_, GetObject(2, _))
+    .WillRepeatedly(DoAll(SetArgumentPointee<1>(&object_), Return(true)));
+  EXPECT_CALL(session_, GetObject(3, _))
+    .WillRepeatedly(Return(false));
+  EXPECT_CALL(object_, GetAttributes(_, 1))
+    .WillOnce(Return(CKR_ATTRIBUTE_SENSITIVE))
+    .WillRepeatedly(Return(CKR_OK));
+  vector<uint64_t> objects;
+  objects.push_back(2);
+  objects.push_back(3);
+  objects.push_back(2);
+  vector<vector<uint8_t>> output;
+  vector<uint32_t> results;
+  EXPECT_EQ(CKR_ARGUMENTS_BAD,
+            service_->GetAttributeValues(ic_, 1, objects, good_attributes_,
+                                         NULL, &results));
+  EXPECT_EQ(CKR_ARGUMENTS_BAD,
+            service_->GetAttributeValues(ic_, 1, objects, good_attributes_,
+                                         &output, NULL));
+  EXPECT_EQ(CKR_SESSION_HANDLE_INVALID,
+            service_->GetAttributeValues(ic_, 1, objects, good_attributes_,
+                                         &output, &results));
+  // Each object gets the result GetAttributeValue would return for it.
+  EXPECT_EQ(CKR_OK,
+            service_->GetAttributeValues(ic_, 1, objects, good_attributes_,
+                                         &output, &results));
+  ASSERT_EQ(3, results.size());
+  ASSERT_EQ(3, output.size());
+  EXPECT_EQ(CKR_ATTRIBUTE_SENSITIVE, results[0]);
+  EXPECT_EQ(CKR_OBJECT_HANDLE_INVALID, results[1]);
+  EXPECT_EQ(0, output[1].size());
+  EXPECT_EQ(CKR_OK, results[2]);
+  EXPECT_GT(output[2].size(), 0);
+}
+
+TEST_F(TestService, FindObjectsWithAttributes) {
+  vector<int> objects_mock(2, 2);
+  EXPECT_CALL(slot_manager_, GetSession(ic_, 1, _))
+    .WillOnce(Return(false))
+    .WillRepeatedly(DoAll(SetArgumentPointee<2>(&session_), Return(true)));
+  EXPECT_CALL(session_, FindObjectsInit(_, 1))
+    .WillOnce(Return(CKR_OPERATION_ACTIVE))
+    .WillRepeatedly(Return(CKR_OK));
+  EXPECT_CALL(session_, FindObjects(5, _))
+    .WillOnce(Return(CKR_FUNCTION_FAILED))
+    .WillRepeatedly(DoAll(SetArgumentPointee<1>(objects_mock), Return(CKR_OK)));
+  // The search is finished even if it fails.
+  EXPECT_CALL(session_, FindObjectsFinal())
+    .Times(2)
+    .WillRepeatedly(Return(CKR_OK));
+  EXPECT_CALL(session_, GetObject(2, _))
+    .WillRepeatedly(DoAll(SetArgumentPointee<1>(&object_), Return(true)));
+  EXPECT_CALL(object_, GetAttributes(_, 1))
+    .WillRepeatedly(Return(CKR_OK));
+  vector<uint64_t> objects;
+  vector<vector<uint8_t>> output;
+  vector<uint32_t> results;
+  EXPECT_EQ(CKR_ARGUMENTS_BAD,
+            service_->FindObjectsWithAttributes(ic_, 1, good_attributes_,
+                                                good_attributes_, 5, NULL,
+                                                &output, &results));
+  EXPECT_EQ(CKR_SESSION_HANDLE_INVALID,
+            service_->FindObjectsWithAttributes(ic_, 1, good_attributes_,
+                                                good_attributes_, 5, &objects,
+                                                &output, &results));
+  EXPECT_EQ(CKR_TEMPLATE_INCONSISTENT,
+            service_->FindObjectsWithAttributes(ic_, 1, bad_attributes_,
+                                                good_attributes_, 5, &objects,
+                                                &output, &results));
+  EXPECT_EQ(CKR_OPERATION_ACTIVE,
+            service_->FindObjectsWithAttributes(ic_, 1, good_attributes_,
+                                                good_attributes_, 5, &objects,
+                                                &output, &results));
+  EXPECT_EQ(CKR_FUNCTION_FAILED,
+            service_->FindObjectsWithAttributes(ic_, 1, good_attributes_,
+                                                good_attributes_, 5, &objects,
+                                                &output, &results));
+  EXPECT_EQ(CKR_OK,
+            service_->FindObjectsWithAttributes(ic_, 1, good_attributes_,
+                                                good_attributes_, 5, &objects,
+                                                &output, &results));
+  EXPECT_EQ(vector<uint64_t>(2, 2), objects);
+  EXPECT_EQ(vector<uint32_t>(2, CKR_OK), results);
+  EXPECT_EQ(2, output.size());
+}
+
 TEST_F(TestService, EncryptInit) {
   EXPECT_CALL(slot_manager_, GetSession(ic_, 1, _))
     .WillOnce(Return(false))
@@ -15,8 +15,11 @@
 #include <string>
 #include <vector>
 
+#include <base/synchronization/lock.h>
+#include <base/threading/platform_thread.h>
 #include "brillo/secure_blob.h"
 #include <openssl/bio.h>
+#include <openssl/crypto.h>
 #include <openssl/err.h>
 #include <openssl/evp.h>
 #include <openssl/hmac.h>
@@ -560,14 +563,45 @@ SecureBlob Sha512(const SecureBlob& input) {
   return hash;
 }
 
+namespace {
+
+// The locks OpenSSL 1.0 asks for to protect shared state, such as the blinding
+// and Montgomery contexts it sets up on first use of an RSA key. NULL unless a
+// ScopedOpenSSL installed them.
+base::Lock* g_openssl_locks = NULL;
+
+void LockOpenSSL(int mode, int n, const char* /*file*/, int /*line*/) {
+  if (mode & CRYPTO_LOCK)
+    g_openssl_locks[n].Acquire();
+  else
+    g_openssl_locks[n].Release();
+}
+
+void GetOpenSSLThreadId(CRYPTO_THREADID* id) {
+  CRYPTO_THREADID_set_numeric(
+      id, static_cast<unsigned long>(base::PlatformThread::CurrentId()));
+}
+
+}  // namespace
+
 ScopedOpenSSL::ScopedOpenSSL() {
   OpenSSL_add_all_algorithms();
   ERR_load_crypto_strings();
+  if (!g_openssl_locks && !CRYPTO_get_locking_callback()) {
+    g_openssl_locks = new base::Lock[CRYPTO_num_locks()];
+    CRYPTO_THREADID_set_callback(GetOpenSSLThreadId);
+    CRYPTO_set_locking_callback(LockOpenSSL);
+  }
 }
 
 ScopedOpenSSL::~ScopedOpenSSL() {
   EVP_cleanup();
   ERR_free_strings();
+  if (g_openssl_locks && CRYPTO_get_locking_callback() == LockOpenSSL) {
+    CRYPTO_set_locking_callback(NULL);
+    delete[] g_openssl_locks;
+    g_openssl_locks = NULL;
+  }
 }
 
 std::string GetOpenSSLError() {
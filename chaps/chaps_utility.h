@@ -248,7 +248,9 @@ brillo::SecureBlob Sha256(const brillo::SecureBlob& input);
 brillo::SecureBlob Sha512(const brillo::SecureBlob& input);
 
 // Initializes the OpenSSL library on construction and terminates the library on
-// destruction.
+// destruction. While it exists, OpenSSL may be used from several threads at
+// once, e.g. to sign with an RSA key that the sessions on all RequestDispatcher
+// workers share.
 class ScopedOpenSSL {
  public:
   ScopedOpenSSL();
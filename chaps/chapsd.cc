@@ -14,7 +14,6 @@
 #include <base/command_line.h>
 #include <base/logging.h>
 #include <base/strings/string_number_conversions.h>
-#include <base/synchronization/lock.h>
 #include <base/synchronization/waitable_event.h>
 #include <base/threading/platform_thread.h>
 #include <base/threading/thread.h>
@@ -27,6 +26,8 @@
 #include "chaps/chaps_service_redirect.h"
 #include "chaps/chaps_utility.h"
 #include "chaps/platform_globals.h"
+#include "chaps/read_write_lock.h"
+#include "chaps/request_dispatcher.h"
 #include "chaps/slot_manager_impl.h"
 
 #if USE_TPM2
@@ -35,8 +36,6 @@
 #include "chaps/tpm_utility_impl.h"
 #endif
 
-using base::AutoLock;
-using base::Lock;
 using base::PlatformThread;
 using base::PlatformThreadHandle;
 using base::WaitableEvent;
@@ -48,13 +47,16 @@ namespace {
 const char kTpmThreadName[] = "tpm_background_thread";
 #endif
 
+// The number of threads that handle D-Bus calls, unless set with --workers.
+const int kDefaultNumWorkers = 8;
+
 }  // namespace
 
 namespace chaps {
 
 class AsyncInitThread : public PlatformThread::Delegate {
  public:
-  AsyncInitThread(Lock* lock,
+  AsyncInitThread(ReadWriteLock* lock,
                   TPMUtility* tpm,
                   SlotManagerImpl* slot_manager,
                   ChapsServiceImpl* service)
@@ -67,7 +69,7 @@ class AsyncInitThread : public PlatformThread::Delegate {
     // It's important that we acquire 'lock' before signaling 'started_event'.
     // This will prevent any D-Bus requests from being processed until we've
     // finished initialization.
-    AutoLock lock(*lock_);
+    AutoWriteLock lock(*lock_);
     started_event_.Signal();
     LOG(INFO) << "Starting asynchronous initialization.";
     if (!tpm_->Init())
@@ -88,7 +90,7 @@ class AsyncInitThread : public PlatformThread::Delegate {
 
  private:
   WaitableEvent started_event_;
-  Lock* lock_;
+  ReadWriteLock* lock_;
   TPMUtility* tpm_;
   SlotManagerImpl* slot_manager_;
   ChapsServiceImpl* service_;
@@ -96,12 +98,16 @@ class AsyncInitThread : public PlatformThread::Delegate {
 
 std::unique_ptr<DBus::BusDispatcher> g_dispatcher;
 
-void RunDispatcher(Lock* lock,
+void RunDispatcher(ReadWriteLock* lock,
                    chaps::ChapsInterface* service,
-                   chaps::TokenManagerInterface* token_manager) {
+                   chaps::TokenManagerInterface* token_manager,
+                   chaps::SlotManager* slot_manager,
+                   chaps::RequestDispatcher* request_dispatcher) {
   CHECK(service) << "Failed to initialize service.";
   try {
-    ChapsAdaptor adaptor(lock, service, token_manager);
+    // The adaptor drains |request_dispatcher| before it goes away.
+    ChapsAdaptor adaptor(lock, service, token_manager, slot_manager,
+                         request_dispatcher);
     g_dispatcher->enter();
   } catch (DBus::Error err) {
     LOG(FATAL) << "DBus::Error - " << err.what();
@@ -115,10 +121,12 @@ int main(int argc, char** argv) {
   base::CommandLine* cl = base::CommandLine::ForCurrentProcess();
   brillo::InitLog(brillo::kLogToSyslog | brillo::kLogToStderr);
   chaps::ScopedOpenSSL openssl;
+  // Replies are sent from the request dispatcher's threads.
+  DBus::_init_threading();
   chaps::g_dispatcher.reset(new DBus::BusDispatcher());
   CHECK(chaps::g_dispatcher.get());
   DBus::default_dispatcher = chaps::g_dispatcher.get();
-  Lock lock;
+  chaps::ReadWriteLock lock;
   if (!cl->HasSwitch("lib")) {
     // We're using chaps (i.e. not passing through to another PKCS #11 library).
     LOG(INFO) << "Starting PKCS #11 services.";
@@ -161,8 +169,21 @@ int main(int argc, char** argv) {
     // We don't want to start the dispatcher until the initialization thread has
     // had a chance to acquire the lock.
     init_thread.WaitUntilStarted();
-    LOG(INFO) << "Starting D-Bus dispatcher.";
-    RunDispatcher(&lock, &service, &slot_manager);
+    int num_workers = kDefaultNumWorkers;
+    if (cl->HasSwitch("workers") &&
+        (!base::StringToInt(cl->GetSwitchValueASCII("workers"), &num_workers) ||
+         num_workers < 1)) {
+      LOG(WARNING) << "Invalid value for workers: using "
+                   << kDefaultNumWorkers << ".";
+      num_workers = kDefaultNumWorkers;
+    }
+    chaps::RequestDispatcher request_dispatcher(num_workers);
+    if (!request_dispatcher.Start())
+      LOG(FATAL) << "Failed to start request dispatcher.";
+    LOG(INFO) << "Starting D-Bus dispatcher with " << num_workers
+              << " workers.";
+    RunDispatcher(&lock, &service, &slot_manager, &slot_manager,
+                  &request_dispatcher);
     PlatformThread::Join(init_thread_handle);
 #if USE_TPM2
     tpm_background_thread.Stop();
@@ -174,7 +195,9 @@ int main(int argc, char** argv) {
     chaps::ChapsServiceRedirect service(lib.c_str());
     if (!service.Init())
       LOG(FATAL) << "Failed to initialize PKCS #11 library: " << lib;
-    RunDispatcher(&lock, &service, NULL);
+    // The library may not be thread-safe, so calls are handled one at a time
+    // on the D-Bus thread.
+    RunDispatcher(&lock, &service, NULL, NULL, NULL);
   }
 
   return 0;
@@ -0,0 +1,179 @@
+// Copyright 2016 The Chromium OS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "chaps/latency_stats.h"
+
+#include <string.h>
+
+#include <algorithm>
+
+#include <base/logging.h>
+#include <base/strings/stringprintf.h>
+#ifndef NO_METRICS
+#include <metrics/metrics_library.h>
+#endif
+
+#include "pkcs11/cryptoki.h"
+
+using base::AutoLock;
+using base::TimeDelta;
+using base::TimeTicks;
+using std::map;
+using std::string;
+
+namespace chaps {
+
+namespace {
+
+const int kDefaultReportIntervalMinutes = 30;
+
+// UMA histogram layout for the reported latencies, in milliseconds.
+const char kUMAPrefix[] = "Chaps.Latency.";
+const int kUMAMinMs = 1;
+const int kUMAMaxMs = 60 * 1000;
+const int kUMANumBuckets = 50;
+
+int GetBucket(TimeDelta latency) {
+  int64_t microseconds = latency.InMicroseconds();
+  int bucket = 0;
+  while (bucket < LatencyStats::kNumBuckets - 1 &&
+         microseconds >= (INT64_C(1) << bucket))
+    ++bucket;
+  return bucket;
+}
+
+// Returns what was recorded in |current| since |previous|.
+LatencyStats::Entry Subtract(const LatencyStats::Entry& current,
+                             const LatencyStats::Entry& previous) {
+  LatencyStats::Entry difference;
+  difference.count = current.count - previous.count;
+  difference.failures = current.failures - previous.failures;
+  difference.total = current.total - previous.total;
+  difference.max = current.max;
+  for (int i = 0; i < LatencyStats::kNumBuckets; ++i)
+    difference.buckets[i] = current.buckets[i] - previous.buckets[i];
+  return difference;
+}
+
+}  // namespace
+
+LatencyStats::Entry::Entry() : count(0), failures(0) {
+  memset(buckets, 0, sizeof(buckets));
+}
+
+LatencyStats::LatencyStats()
+    : report_interval_(
+          TimeDelta::FromMinutes(kDefaultReportIntervalMinutes)),
+      last_report_(TimeTicks::Now()) {}
+
+LatencyStats::~LatencyStats() {}
+
+LatencyStats* LatencyStats::GetInstance() {
+  static LatencyStats* instance = new LatencyStats();
+  return instance;
+}
+
+void LatencyStats::Record(const string& name,
+                          TimeDelta latency,
+                          bool success) {
+  TimeTicks now = TimeTicks::Now();
+  map<string, Entry> unreported;
+  {
+    AutoLock lock(lock_);
+    Entry& entry = entries_[name];
+    ++entry.count;
+    if (!success)
+      ++entry.failures;
+    entry.total += latency;
+    entry.max = std::max(entry.max, latency);
+    ++entry.buckets[GetBucket(latency)];
+
+    if (report_interval_.is_zero() || now - last_report_ < report_interval_)
+      return;
+    for (auto i = entries_.begin(); i != entries_.end(); ++i) {
+      Entry difference = Subtract(i->second, reported_entries_[i->first]);
+      if (difference.count > 0)
+        unreported[i->first] = difference;
+    }
+    reported_entries_ = entries_;
+    last_report_ = now;
+  }
+  ReportToUMA(unreported);
+}
+
+map<string, LatencyStats::Entry> LatencyStats::GetEntries() {
+  AutoLock lock(lock_);
+  return entries_;
+}
+
+void LatencyStats::Reset() {
+  AutoLock lock(lock_);
+  entries_.clear();
+  reported_entries_.clear();
+}
+
+string LatencyStats::Dump() {
+  map<string, Entry> entries = GetEntries();
+  string dump = base::StringPrintf("%-40s %10s %8s %9s %9s %9s %9s %9s\n",
+                                   "operation", "count", "failures", "mean ms",
+                                   "p50 ms", "p95 ms", "p99 ms", "max ms");
+  for (auto i = entries.begin(); i != entries.end(); ++i) {
+    const Entry& entry = i->second;
+    base::StringAppendF(
+        &dump, "%-40s %10ju %8ju %9.2f %9.2f %9.2f %9.2f %9.2f\n",
+        i->first.c_str(), static_cast<uintmax_t>(entry.count),
+        static_cast<uintmax_t>(entry.failures),
+        entry.total.InMillisecondsF() / entry.count,
+        Percentile(entry, 50).InMillisecondsF(),
+        Percentile(entry, 95).InMillisecondsF(),
+        Percentile(entry, 99).InMillisecondsF(),
+        entry.max.InMillisecondsF());
+  }
+  return dump;
+}
+
+TimeDelta LatencyStats::Percentile(const Entry& entry, int percent) {
+  uint64_t rank = (entry.count * percent + 99) / 100;
+  uint64_t seen = 0;
+  for (int i = 0; i < kNumBuckets - 1; ++i) {
+    seen += entry.buckets[i];
+    if (seen >= rank && seen > 0)
+      return std::min(entry.max, TimeDelta::FromMicroseconds(INT64_C(1) << i));
+  }
+  return entry.max;
+}
+
+void LatencyStats::set_report_interval(TimeDelta interval) {
+  AutoLock lock(lock_);
+  report_interval_ = interval;
+}
+
+void LatencyStats::ReportToUMA(const map<string, Entry>& entries) {
+#ifndef NO_METRICS
+  MetricsLibrary metrics;
+  metrics.Init();
+  for (auto i = entries.begin(); i != entries.end(); ++i) {
+    metrics.SendToUMA(kUMAPrefix + i->first,
+                      Percentile(i->second, 50).InMilliseconds(),
+                      kUMAMinMs, kUMAMaxMs, kUMANumBuckets);
+  }
+#endif
+}
+
+ScopedLatency::ScopedLatency(const char* category, const string& name)
+    : category_(category),
+      name_(name),
+      start_(TimeTicks::Now()),
+      success_(true) {}
+
+ScopedLatency::~ScopedLatency() {
+  LatencyStats::GetInstance()->Record(string(category_) + "." + name_,
+                                      TimeTicks::Now() - start_, success_);
+}
+
+void ScopedLatency::set_result(uint32_t result) {
+  success_ = (result == CKR_OK);
+}
+
+}  // namespace chaps
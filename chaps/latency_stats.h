@@ -0,0 +1,105 @@
+// Copyright 2016 The Chromium OS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef CHAPS_LATENCY_STATS_H_
+#define CHAPS_LATENCY_STATS_H_
+
+#include <stdint.h>
+
+#include <map>
+#include <string>
+
+#include <base/macros.h>
+#include <base/synchronization/lock.h>
+#include <base/time/time.h>
+
+namespace chaps {
+
+// LatencyStats counts calls and keeps a latency histogram for each named
+// operation, e.g. "Service.Sign" or "NetHsm.decrypt". It is thread-safe and
+// cheap enough to record every PKCS #11 call. A single instance is shared by
+// the whole process; chapsd returns its dump over D-Bus and periodically sends
+// the latencies to UMA.
+class LatencyStats {
+ public:
+  // Bucket i counts latencies below 2^i microseconds that do not fit in an
+  // earlier bucket. The last bucket also holds everything slower.
+  static const int kNumBuckets = 26;
+
+  struct Entry {
+    Entry();
+
+    uint64_t count;
+    uint64_t failures;
+    base::TimeDelta total;
+    base::TimeDelta max;
+    uint64_t buckets[kNumBuckets];
+  };
+
+  LatencyStats();
+  ~LatencyStats();
+
+  static LatencyStats* GetInstance();
+
+  void Record(const std::string& name, base::TimeDelta latency, bool success);
+  // Returns a copy of the statistics of all operations, keyed by name.
+  std::map<std::string, Entry> GetEntries();
+  void Reset();
+
+  // Returns one line per operation with its count, failures and mean, p50,
+  // p95, p99 and max latency in milliseconds.
+  std::string Dump();
+
+  // Returns an upper bound of the |percent| percentile latency in |entry|.
+  static base::TimeDelta Percentile(const Entry& entry, int percent);
+
+  // How often Record() sends the median latency of each operation since the
+  // last report to UMA. Zero disables reporting.
+  void set_report_interval(base::TimeDelta interval);
+
+ private:
+  // Sends the median latency since the last report of each operation that was
+  // recorded since then.
+  void ReportToUMA(const std::map<std::string, Entry>& entries);
+
+  base::Lock lock_;
+  std::map<std::string, Entry> entries_;
+  // The entries as they were at the last UMA report.
+  std::map<std::string, Entry> reported_entries_;
+  base::TimeDelta report_interval_;
+  base::TimeTicks last_report_;
+
+  DISALLOW_COPY_AND_ASSIGN(LatencyStats);
+};
+
+// Records the time from construction to destruction of the instance under
+// "|category|.|name|" in LatencyStats::GetInstance().
+class ScopedLatency {
+ public:
+  ScopedLatency(const char* category, const std::string& name);
+  ~ScopedLatency();
+
+  // The call counts as successful unless set otherwise.
+  void set_success(bool success) { success_ = success; }
+  // Counts the call as successful if |result| is CKR_OK.
+  void set_result(uint32_t result);
+  // Calls set_result(|result|) and returns |result|, so that a call can end
+  // with "return latency.Return(rv);".
+  uint32_t Return(uint32_t result) {
+    set_result(result);
+    return result;
+  }
+
+ private:
+  const char* category_;
+  std::string name_;
+  base::TimeTicks start_;
+  bool success_;
+
+  DISALLOW_COPY_AND_ASSIGN(ScopedLatency);
+};
+
+}  // namespace chaps
+
+#endif  // CHAPS_LATENCY_STATS_H_
@@ -0,0 +1,91 @@
+// Copyright 2016 The Chromium OS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "chaps/latency_stats.h"
+
+#include <map>
+#include <string>
+
+#include <gtest/gtest.h>
+
+#include "pkcs11/cryptoki.h"
+
+using base::TimeDelta;
+using std::map;
+using std::string;
+
+namespace chaps {
+
+class TestLatencyStats : public ::testing::Test {
+ protected:
+  void SetUp() {
+    stats_.set_report_interval(TimeDelta());
+  }
+
+  LatencyStats stats_;
+};
+
+TEST_F(TestLatencyStats, Record) {
+  stats_.Record("Service.Sign", TimeDelta::FromMilliseconds(2), true);
+  stats_.Record("Service.Sign", TimeDelta::FromMilliseconds(5), false);
+  stats_.Record("Service.Decrypt", TimeDelta::FromMilliseconds(1), true);
+  map<string, LatencyStats::Entry> entries = stats_.GetEntries();
+  ASSERT_EQ(2u, entries.size());
+  const LatencyStats::Entry& sign = entries["Service.Sign"];
+  EXPECT_EQ(2u, sign.count);
+  EXPECT_EQ(1u, sign.failures);
+  EXPECT_EQ(TimeDelta::FromMilliseconds(7), sign.total);
+  EXPECT_EQ(TimeDelta::FromMilliseconds(5), sign.max);
+  EXPECT_EQ(1u, entries["Service.Decrypt"].count);
+
+  string dump = stats_.Dump();
+  EXPECT_NE(string::npos, dump.find("Service.Sign"));
+  EXPECT_NE(string::npos, dump.find("Service.Decrypt"));
+
+  stats_.Reset();
+  EXPECT_TRUE(stats_.GetEntries().empty());
+}
+
+TEST_F(TestLatencyStats, Percentile) {
+  for (int i = 0; i < 90; ++i)
+    stats_.Record("Fast", TimeDelta::FromMicroseconds(100), true);
+  for (int i = 0; i < 10; ++i)
+    stats_.Record("Fast", TimeDelta::FromMilliseconds(10), true);
+  const LatencyStats::Entry entry = stats_.GetEntries()["Fast"];
+  // Percentiles are bucket bounds, at most twice the real value.
+  TimeDelta p50 = LatencyStats::Percentile(entry, 50);
+  EXPECT_GE(p50, TimeDelta::FromMicroseconds(100));
+  EXPECT_LT(p50, TimeDelta::FromMicroseconds(200));
+  EXPECT_EQ(p50, LatencyStats::Percentile(entry, 90));
+  // Bounds above the slowest call are capped by it.
+  EXPECT_EQ(TimeDelta::FromMilliseconds(10),
+            LatencyStats::Percentile(entry, 99));
+  EXPECT_EQ(TimeDelta(),
+            LatencyStats::Percentile(LatencyStats::Entry(), 50));
+}
+
+TEST_F(TestLatencyStats, ScopedLatency) {
+  LatencyStats* stats = LatencyStats::GetInstance();
+  stats->set_report_interval(TimeDelta());
+  stats->Reset();
+  {
+    ScopedLatency latency("Test", "Succeeds");
+  }
+  {
+    ScopedLatency latency("Test", "Fails");
+    latency.set_result(CKR_FUNCTION_FAILED);
+  }
+  {
+    ScopedLatency latency("Test", "Returns");
+    EXPECT_EQ(CKR_ARGUMENTS_BAD, latency.Return(CKR_ARGUMENTS_BAD));
+  }
+  map<string, LatencyStats::Entry> entries = stats->GetEntries();
+  EXPECT_EQ(1u, entries["Test.Succeeds"].count);
+  EXPECT_EQ(0u, entries["Test.Succeeds"].failures);
+  EXPECT_EQ(1u, entries["Test.Fails"].count);
+  EXPECT_EQ(1u, entries["Test.Fails"].failures);
+  EXPECT_EQ(1u, entries["Test.Returns"].failures);
+}
+
+}  // namespace chaps
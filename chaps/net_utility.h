@@ -5,11 +5,14 @@
 #ifndef CHAPS_NET_UTILITY_H_
 #define CHAPS_NET_UTILITY_H_
 
+#include <set>
 #include <string>
 #include <boost/optional.hpp>
 
 namespace chaps {
 
+class Object;
+
 // NetUtility is a high-level interface to NetHSM services. In practice, only a
 // single instance of this class is necessary to provide network services across
 // multiple logical tokens and sessions.
@@ -22,8 +25,20 @@ class NetUtility {
   // Returns true on success.
   virtual bool Init() = 0;
 
+  // Adds the keys on the NetHSM, or only the key |key_id| if it is not empty,
+  // to the token. Keys that have been deleted from the NetHSM are not removed
+  // from the token here, since other calls may be using them; see
+  // RemoveStaleKeys().
   virtual bool LoadKeys(const std::string& key_id) = 0;
 
+  // Returns true if LoadKeys() found keys that are no longer on the NetHSM.
+  virtual bool HasStaleKeys() = 0;
+
+  // Removes the objects of keys that are no longer on the NetHSM from the
+  // token, except for those in |in_use|, which are kept until a later call.
+  // Must be called while no other call uses the token's objects.
+  virtual void RemoveStaleKeys(const std::set<const Object*>& in_use) = 0;
+
   // Retrieves the public components of an RSA key pair. Returns true on
   // success.
   // virtual bool GetPublicKey(int key_handle,
@@ -33,8 +48,13 @@ class NetUtility {
   virtual boost::optional<std::string> Decrypt(const std::string& key_id,
                                                const std::string& input) = 0;
 
-  // virtual boost::optional<std::string> Sign(const std::string& key_id,
-  //                                           const std::string& input) = 0;
+  // Signs |input|, a DER-encoded DigestInfo, with PKCS #1 v1.5 padding. Blocks
+  // until the NetHSM answers. In chapsd, that holds up the RequestDispatcher
+  // worker of the calling session, and with it the calls of every other
+  // session that maps to the same worker, and keeps the slot's lock held for
+  // reading, so calls that need it for writing wait too.
+  virtual boost::optional<std::string> Sign(const std::string& key_id,
+                                            const std::string& input) = 0;
 };
 
 }  // namespace chaps
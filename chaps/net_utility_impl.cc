@@ -4,9 +4,15 @@
 
 #include "net_utility_impl.h"
 
+#include <set>
+
+#include <base/logging.h>
+#include <cpprest/http_client.h>
+
 #include "cppcodec/base64_default_url.hpp"
 
 #include "chaps_factory.h"
+#include "nethsm_transport.h"
 #include "object.h"
 #include "object_pool.h"
 #include "chaps.h"
@@ -18,129 +24,350 @@ namespace Purpose {
   const std::string kSign = "sign";
 }
 
+namespace {
+
+const char kKeysPath[] = "/api/v0/keys";
+
+// Keys rarely change on the NetHSM, so searches within this long of each other
+// reuse the keys already in the token.
+const int kDefaultKeyCacheTtlSeconds = 60;
+
+// Extracts the signature from the response to a sign request.
+boost::optional<std::string> ParseSignature(
+    boost::optional<web::json::value> json) {
+  if (!json)
+    return boost::none;
+  try {
+    return base64::decode<std::string>(
+        json->at("data").at("signature").as_string());
+  } catch (const std::exception& e) {
+    LOG(ERROR) << "Malformed NetHSM sign response: " << e.what();
+    return boost::none;
+  }
+}
+
+}  // namespace
+
+NetUtilityImpl::KeyCacheStats::KeyCacheStats()
+    : hits(0), misses(0), keys_fetched(0) {}
+
 NetUtilityImpl::NetUtilityImpl(std::shared_ptr<ObjectPool> token_object_pool,
-                               std::shared_ptr<ChapsFactory> factory)
-    : token_object_pool_(token_object_pool),
-      factory_(factory)
+                               std::shared_ptr<ChapsFactory> factory,
+                               std::shared_ptr<NetHsmTransport> transport)
+    : is_initialized_(false),
+      token_object_pool_(token_object_pool),
+      factory_(factory),
+      transport_(transport),
+      key_cache_ttl_(
+          base::TimeDelta::FromSeconds(kDefaultKeyCacheTtlSeconds))
   {}
 
 NetUtilityImpl::~NetUtilityImpl() {}
 
 bool NetUtilityImpl::Init() {
-  std::cout << __PRETTY_FUNCTION__ << std::endl;
-  web::http::client::http_client_config config;
-  web::http::client::credentials creds("admin", "secret");
-  config.set_credentials(creds);
-  client_.emplace(U("http://localhost:8080"), config);
-  is_initialized_ = true;
-  return true;
+  is_initialized_ = transport_ != nullptr;
+  return is_initialized_;
 }
 
 bool NetUtilityImpl::LoadKeys(const std::string& key_id) {
-  std::cout << __PRETTY_FUNCTION__ << std::endl;
+  base::TimeTicks start = base::TimeTicks::Now();
   std::vector<std::string> locations;
+  std::set<std::string> cached;
+  {
+    base::AutoLock lock(key_cache_lock_);
+    if (key_id.empty()) {
+      if (!key_list_fetched_.is_null() &&
+          start - key_list_fetched_ < key_cache_ttl_) {
+        ++key_cache_stats_.hits;
+        return true;
+      }
+    } else {
+      std::string location = std::string(kKeysPath) + "/" + key_id;
+      auto i = key_cache_.find(location);
+      if (i != key_cache_.end() && start - i->second < key_cache_ttl_) {
+        ++key_cache_stats_.hits;
+        return true;
+      }
+      key_cache_.erase(location);
+      locations.push_back(location);
+    }
+    ++key_cache_stats_.misses;
+    for (auto i = key_cache_.begin(); i != key_cache_.end(); ++i)
+      cached.insert(i->first);
+  }
+
+  // The requests go out without |key_cache_lock_|, so that other tokens'
+  // cache hits and stats don't wait for the NetHSM.
+  if (key_id.empty() && !FetchKeyList(&locations))
+    return false;
+  std::map<std::string, boost::optional<web::json::value>> fetched;
+  FetchKeys(locations, cached, &fetched);
+
+  base::AutoLock lock(key_cache_lock_);
+  base::TimeTicks now = base::TimeTicks::Now();
   if (key_id.empty()) {
-    auto response = client_->request(web::http::methods::GET, "/api/v0/keys").get();
-    printf("Received response status code:%u\n", response.status_code());
-    auto json = response.extract_json().get();
-    auto const arr = json["data"].as_array();
-    for (auto i = arr.begin(); i != arr.end(); ++i) {
-      auto const loc = i->at("location").as_string();
-      locations.push_back(loc);
+    key_list_fetched_ = start;
+    MarkUnlistedKeys(std::set<std::string>(locations.begin(),
+                                           locations.end()));
+  }
+  for (auto i = fetched.begin(); i != fetched.end(); ++i) {
+    // Another call may have added the key in the meantime.
+    if (key_cache_.count(i->first) > 0 || IsKeyInPool(i->first)) {
+      key_cache_[i->first] = now;
+    } else if (i->second && AddKeyObjects(i->first, *i->second)) {
+      key_cache_[i->first] = now;
+      ++key_cache_stats_.keys_fetched;
     }
-    //nethsm_keys_loaded_ = true;
-  } else {
-    locations.push_back("/api/v0/keys/" + key_id);
   }
+  key_cache_stats_.last_refresh_time = now - start;
+  key_cache_stats_.total_refresh_time += key_cache_stats_.last_refresh_time;
+  VLOG(1) << "Loaded NetHSM keys in "
+          << key_cache_stats_.last_refresh_time.InMilliseconds() << " ms";
+  return true;
+}
+
+void NetUtilityImpl::set_key_cache_ttl(base::TimeDelta ttl) {
+  base::AutoLock lock(key_cache_lock_);
+  key_cache_ttl_ = ttl;
+  key_list_fetched_ = base::TimeTicks();
+}
+
+NetUtilityImpl::KeyCacheStats NetUtilityImpl::key_cache_stats() {
+  base::AutoLock lock(key_cache_lock_);
+  return key_cache_stats_;
+}
+
+bool NetUtilityImpl::FetchKeyList(std::vector<std::string>* locations) {
+  auto json = transport_->Request(web::http::methods::GET, kKeysPath,
+                                  web::json::value());
+  if (!json)
+    return false;
+  try {
+    auto const arr = (*json)["data"].as_array();
+    for (auto i = arr.begin(); i != arr.end(); ++i)
+      locations->push_back(i->at("location").as_string());
+  } catch (const web::json::json_exception& e) {
+    LOG(ERROR) << "Malformed NetHSM key list: " << e.what();
+    return false;
+  }
+  return true;
+}
+
+void NetUtilityImpl::FetchKeys(
+    const std::vector<std::string>& locations,
+    const std::set<std::string>& cached,
+    std::map<std::string, boost::optional<web::json::value>>* fetched) {
+  std::vector<std::string> missing;
   for (auto i = locations.begin(); i != locations.end(); ++i) {
-    auto const loc = *i;
-    auto response = client_->request(web::http::methods::GET, loc).get();
-    printf("Received response status code:%u\n", response.status_code());
-    auto json = response.extract_json().get();
-    auto const id = json["data"]["id"].as_string();
-    auto const modulus = base64::decode<std::string>(
-      json["data"]["publicKey"]["modulus"].as_string());
-    auto const public_exponent = base64::decode<std::string>(
-      json["data"]["publicKey"]["publicExponent"].as_string());
-    auto const purpose = json["data"]["purpose"].as_string();
-    const bool forEncrypting(boost::starts_with(purpose, Purpose::kEncrypt));
-    const bool forSigning(boost::starts_with(purpose, Purpose::kSign));
-    std::cout << loc << " -> " << id << std::endl;
-
-    std::unique_ptr<Object> public_object(factory_->CreateObject());
-    CHECK(public_object.get());
-    public_object->SetAttributeString(CKA_ID, id);
-    public_object->SetAttributeString(CKA_LABEL, loc);
-    public_object->SetAttributeInt(CKA_CLASS, CKO_PUBLIC_KEY);
-    public_object->SetAttributeInt(CKA_KEY_TYPE, CKK_RSA);
-    public_object->SetAttributeBool(CKA_MODIFIABLE, false);
-    public_object->SetAttributeBool(CKA_TOKEN, true);
-    public_object->SetAttributeString(CKA_PUBLIC_EXPONENT, public_exponent);
-    public_object->SetAttributeString(CKA_MODULUS, modulus);
-    int modulus_bits = modulus.size()*8;
-    public_object->SetAttributeInt(CKA_MODULUS_BITS, modulus_bits);
-    if (forEncrypting) {
-      public_object->SetAttributeBool(CKA_ENCRYPT, true);
-    }
-    if (forSigning) {
-      public_object->SetAttributeBool(CKA_VERIFY, true);
-    }
+    if (cached.count(*i) > 0)
+      continue;
+    // Keys from earlier sessions may already be in a persistent token.
+    if (IsKeyInPool(*i))
+      (*fetched)[*i] = boost::none;
+    else
+      missing.push_back(*i);
+  }
+
+  std::vector<pplx::task<boost::optional<web::json::value>>> requests;
+  for (auto i = missing.begin(); i != missing.end(); ++i) {
+    requests.push_back(
+        transport_->RequestAsync(web::http::methods::GET, *i,
+                                 web::json::value()));
+  }
+  for (size_t i = 0; i < requests.size(); ++i)
+    (*fetched)[missing[i]] = requests[i].get();
+}
+
+bool NetUtilityImpl::HasStaleKeys() {
+  base::AutoLock lock(key_cache_lock_);
+  return !stale_keys_.empty();
+}
 
-    std::unique_ptr<Object> private_object(factory_->CreateObject());
-    CHECK(private_object.get());
-    private_object->SetAttributeString(CKA_ID, id);
-    private_object->SetAttributeString(CKA_LABEL, loc);
-    private_object->SetAttributeInt(CKA_CLASS, CKO_PRIVATE_KEY);
-    private_object->SetAttributeInt(CKA_KEY_TYPE, CKK_RSA);
-    private_object->SetAttributeBool(CKA_MODIFIABLE, false);
-    private_object->SetAttributeBool(CKA_TOKEN, true);
-    private_object->SetAttributeBool(CKA_PRIVATE, true);
-    private_object->SetAttributeBool(CKA_SENSITIVE, true);
-    private_object->SetAttributeBool(CKA_EXTRACTABLE, false);
-    private_object->SetAttributeBool(CKA_ALWAYS_SENSITIVE, true);
-    private_object->SetAttributeBool(CKA_NEVER_EXTRACTABLE, true);
-    private_object->SetAttributeString(CKA_PUBLIC_EXPONENT, public_exponent);
-    private_object->SetAttributeString(kKeyLocationAttribute, loc);
-    private_object->SetAttributeString(CKA_MODULUS, modulus);
-    if (forEncrypting) {
-      private_object->SetAttributeBool(CKA_DECRYPT, true);
+void NetUtilityImpl::RemoveStaleKeys(const std::set<const Object*>& in_use) {
+  base::AutoLock lock(key_cache_lock_);
+  for (auto i = stale_keys_.begin(); i != stale_keys_.end();) {
+    std::unique_ptr<Object> search_template(factory_->CreateObject());
+    CHECK(search_template.get());
+    search_template->SetAttributeString(CKA_LABEL, *i);
+    std::vector<const Object*> objects;
+    if (!token_object_pool_->Find(search_template.get(), &objects)) {
+      ++i;
+      continue;
+    }
+    bool removed = true;
+    for (auto j = objects.begin(); j != objects.end(); ++j) {
+      // Keys that an operation still uses are removed by a later call.
+      if (in_use.count(*j) > 0) {
+        removed = false;
+        continue;
+      }
+      VLOG(1) << "Removing " << *i << ", which is no longer on the NetHSM";
+      if (!token_object_pool_->Delete(*j)) {
+        LOG(WARNING) << "Failed to remove NetHSM key " << *i;
+        removed = false;
+      }
     }
-    if (forSigning) {
-      private_object->SetAttributeBool(CKA_SIGN, true);
+    if (removed) {
+      key_cache_.erase(*i);
+      i = stale_keys_.erase(i);
+    } else {
+      ++i;
     }
+  }
+}
 
-    if (public_object->FinalizeNewObject() != CKR_OK)
-      continue;
-    if (private_object->FinalizeNewObject() != CKR_OK)
-      continue;
-    if (!token_object_pool_->Insert(public_object.get()))
-      continue;
-    if (!token_object_pool_->Insert(private_object.get())) {
-      token_object_pool_->Delete(public_object.get());
+void NetUtilityImpl::MarkUnlistedKeys(const std::set<std::string>& listed) {
+  for (auto i = key_cache_.begin(); i != key_cache_.end();) {
+    if (listed.count(i->first) == 0)
+      i = key_cache_.erase(i);
+    else
+      ++i;
+  }
+  // A key may have been recreated at the same location.
+  for (auto i = stale_keys_.begin(); i != stale_keys_.end();) {
+    if (listed.count(*i) > 0)
+      i = stale_keys_.erase(i);
+    else
+      ++i;
+  }
+
+  // Keys from earlier sessions may be in a persistent token without ever
+  // having been cached, so look for them by label.
+  const std::string prefix = std::string(kKeysPath) + "/";
+  std::unique_ptr<Object> search_template(factory_->CreateObject());
+  CHECK(search_template.get());
+  std::vector<const Object*> objects;
+  if (!token_object_pool_->Find(search_template.get(), &objects))
+    return;
+  for (auto i = objects.begin(); i != objects.end(); ++i) {
+    if (!(*i)->IsAttributePresent(CKA_LABEL))
       continue;
-    }
-    public_object.release();
-    private_object.release();
+    const std::string label = (*i)->GetAttributeString(CKA_LABEL);
+    if (boost::starts_with(label, prefix) && listed.count(label) == 0)
+      stale_keys_.insert(label);
   }
+}
+
+bool NetUtilityImpl::IsKeyInPool(const std::string& location) {
+  std::unique_ptr<Object> search_template(factory_->CreateObject());
+  CHECK(search_template.get());
+  search_template->SetAttributeString(CKA_LABEL, location);
+  std::vector<const Object*> objects;
+  return token_object_pool_->Find(search_template.get(), &objects) &&
+         !objects.empty();
+}
+
+bool NetUtilityImpl::AddKeyObjects(const std::string& location,
+                                   const web::json::value& json) {
+  std::string id;
+  std::string modulus;
+  std::string public_exponent;
+  std::string purpose;
+  try {
+    const web::json::value& data = json.at("data");
+    id = data.at("id").as_string();
+    modulus = base64::decode<std::string>(
+      data.at("publicKey").at("modulus").as_string());
+    public_exponent = base64::decode<std::string>(
+      data.at("publicKey").at("publicExponent").as_string());
+    purpose = data.at("purpose").as_string();
+  } catch (const std::exception& e) {
+    LOG(ERROR) << "Malformed NetHSM key " << location << ": " << e.what();
+    return false;
+  }
+  const bool forEncrypting(boost::starts_with(purpose, Purpose::kEncrypt));
+  const bool forSigning(boost::starts_with(purpose, Purpose::kSign));
+  VLOG(1) << location << " -> " << id;
+
+  std::unique_ptr<Object> public_object(factory_->CreateObject());
+  CHECK(public_object.get());
+  public_object->SetAttributeString(CKA_ID, id);
+  public_object->SetAttributeString(CKA_LABEL, location);
+  public_object->SetAttributeInt(CKA_CLASS, CKO_PUBLIC_KEY);
+  public_object->SetAttributeInt(CKA_KEY_TYPE, CKK_RSA);
+  public_object->SetAttributeBool(CKA_MODIFIABLE, false);
+  public_object->SetAttributeBool(CKA_TOKEN, true);
+  public_object->SetAttributeString(CKA_PUBLIC_EXPONENT, public_exponent);
+  public_object->SetAttributeString(CKA_MODULUS, modulus);
+  int modulus_bits = modulus.size()*8;
+  public_object->SetAttributeInt(CKA_MODULUS_BITS, modulus_bits);
+  if (forEncrypting) {
+    public_object->SetAttributeBool(CKA_ENCRYPT, true);
+  }
+  if (forSigning) {
+    public_object->SetAttributeBool(CKA_VERIFY, true);
+  }
+
+  std::unique_ptr<Object> private_object(factory_->CreateObject());
+  CHECK(private_object.get());
+  private_object->SetAttributeString(CKA_ID, id);
+  private_object->SetAttributeString(CKA_LABEL, location);
+  private_object->SetAttributeInt(CKA_CLASS, CKO_PRIVATE_KEY);
+  private_object->SetAttributeInt(CKA_KEY_TYPE, CKK_RSA);
+  private_object->SetAttributeBool(CKA_MODIFIABLE, false);
+  private_object->SetAttributeBool(CKA_TOKEN, true);
+  private_object->SetAttributeBool(CKA_PRIVATE, true);
+  private_object->SetAttributeBool(CKA_SENSITIVE, true);
+  private_object->SetAttributeBool(CKA_EXTRACTABLE, false);
+  private_object->SetAttributeBool(CKA_ALWAYS_SENSITIVE, true);
+  private_object->SetAttributeBool(CKA_NEVER_EXTRACTABLE, true);
+  private_object->SetAttributeString(CKA_PUBLIC_EXPONENT, public_exponent);
+  private_object->SetAttributeString(kKeyLocationAttribute, location);
+  private_object->SetAttributeString(CKA_MODULUS, modulus);
+  if (forEncrypting) {
+    private_object->SetAttributeBool(CKA_DECRYPT, true);
+  }
+  if (forSigning) {
+    private_object->SetAttributeBool(CKA_SIGN, true);
+  }
+
+  if (public_object->FinalizeNewObject() != CKR_OK)
+    return false;
+  if (private_object->FinalizeNewObject() != CKR_OK)
+    return false;
+  if (!token_object_pool_->Insert(public_object.get()))
+    return false;
+  if (!token_object_pool_->Insert(private_object.get())) {
+    token_object_pool_->Delete(public_object.get());
+    return false;
+  }
+  public_object.release();
+  private_object.release();
   return true;
 }
 
 boost::optional<std::string> NetUtilityImpl::Decrypt(
     const std::string& key_loc,
     const std::string& encrypted_data) {
-  std::cout << __PRETTY_FUNCTION__ << std::endl;
-  std::string encrypted_data_b64 = base64::encode(encrypted_data);
-  auto body = web::json::value::parse("{\"encrypted\": \"" + encrypted_data_b64 + "\"}");
-
-  auto response = client_->request(web::http::methods::POST,
-                                 key_loc + "/actions/pkcs1/decrypt", body).get();
-  printf("Received response status code:%u\n", response.status_code());
-  auto json = response.extract_json().get();
-  std::cout << json.serialize() << std::endl;
-  std::string result = base64::decode<std::string>(json["data"]["decrypted"].as_string());
-  return result;
+  web::json::value body;
+  body["encrypted"] = web::json::value::string(base64::encode(encrypted_data));
+  auto json = transport_->Request(web::http::methods::POST,
+                                  key_loc + "/actions/pkcs1/decrypt", body);
+  if (!json)
+    return boost::none;
+  try {
+    return base64::decode<std::string>(
+        (*json)["data"]["decrypted"].as_string());
+  } catch (const std::exception& e) {
+    LOG(ERROR) << "Malformed NetHSM decrypt response: " << e.what();
+    return boost::none;
+  }
 }
 
+boost::optional<std::string> NetUtilityImpl::Sign(
+    const std::string& key_loc,
+    const std::string& input) {
+  return SignAsync(key_loc, input).get();
+}
 
+pplx::task<boost::optional<std::string>> NetUtilityImpl::SignAsync(
+    const std::string& key_loc,
+    const std::string& input) {
+  web::json::value body;
+  body["message"] = web::json::value::string(base64::encode(input));
+  return transport_->RequestAsync(web::http::methods::POST,
+                                  key_loc + "/actions/pkcs1/sign", body)
+      .then(ParseSignature);
+}
 
 }  // namespace chaps
@@ -7,33 +7,103 @@
 
 #include "net_utility.h"
 
+#include <map>
+#include <memory>
+#include <set>
 #include <string>
+#include <vector>
 #include <boost/optional.hpp>
-#include <cpprest/http_client.h>
 #include <base/macros.h>
+#include <base/synchronization/lock.h>
+#include <base/time/time.h>
+#include <cpprest/json.h>
+#include <pplx/pplxtasks.h>
 
 namespace chaps {
 
 class ObjectPool;
 class ChapsFactory;
+class NetHsmTransport;
+class Object;
 
 class NetUtilityImpl : public NetUtility {
  public:
-  explicit NetUtilityImpl(std::shared_ptr<ObjectPool> token_object_pool,
-                          std::shared_ptr<ChapsFactory> factory);
+  struct KeyCacheStats {
+    KeyCacheStats();
+
+    // LoadKeys() calls answered from the cache, and calls that went to the
+    // NetHSM.
+    int hits;
+    int misses;
+    // Keys whose details were fetched and added to the token.
+    int keys_fetched;
+    base::TimeDelta last_refresh_time;
+    base::TimeDelta total_refresh_time;
+  };
+
+  // Requests go through |transport|, which may be shared with the
+  // NetUtilityImpl instances of other tokens.
+  NetUtilityImpl(std::shared_ptr<ObjectPool> token_object_pool,
+                 std::shared_ptr<ChapsFactory> factory,
+                 std::shared_ptr<NetHsmTransport> transport);
   virtual ~NetUtilityImpl();
   virtual bool Init();
   virtual bool LoadKeys(const std::string& key_id);
+  virtual bool HasStaleKeys();
+  virtual void RemoveStaleKeys(const std::set<const Object*>& in_use);
   virtual boost::optional<std::string> Decrypt(const std::string& key_id,
                                                const std::string& input);
-  // virtual boost::optional<std::string> Sign(const std::string& key_id,
-  //                                           const std::string& input);
+  virtual boost::optional<std::string> Sign(const std::string& key_id,
+                                            const std::string& input);
+
+  // Like Sign(), but returns as soon as the request is queued, so that one
+  // caller can have many signatures in flight.
+  pplx::task<boost::optional<std::string>> SignAsync(
+      const std::string& key_id,
+      const std::string& input);
+
+  // Sets how long the key list and single keys fetched by LoadKeys() are
+  // trusted before they are fetched again.
+  void set_key_cache_ttl(base::TimeDelta ttl);
+  KeyCacheStats key_cache_stats();
 
  private:
+  // Fetches the locations of all keys on the NetHSM.
+  bool FetchKeyList(std::vector<std::string>* locations);
+  // Fetches the details of the keys at |locations| in parallel into
+  // |fetched|, by location. Keys in |cached| are skipped, and keys that are
+  // already in the token are not fetched again and map to boost::none.
+  void FetchKeys(
+      const std::vector<std::string>& locations,
+      const std::set<std::string>& cached,
+      std::map<std::string, boost::optional<web::json::value>>* fetched);
+  // Forgets the keys that are not in |listed|, the locations of all keys on the
+  // NetHSM, and adds those still in the token to |stale_keys_|. Must be called
+  // with |key_cache_lock_| held.
+  void MarkUnlistedKeys(const std::set<std::string>& listed);
+  bool IsKeyInPool(const std::string& location);
+  // Adds public and private key objects for the key at |location|, as
+  // described by |json|, to the token.
+  bool AddKeyObjects(const std::string& location,
+                     const web::json::value& json);
+
   bool is_initialized_;
-  boost::optional<web::http::client::http_client> client_;
   std::shared_ptr<ObjectPool> token_object_pool_;
   std::shared_ptr<ChapsFactory> factory_;
+  std::shared_ptr<NetHsmTransport> transport_;
+
+  // Protects the members below and the changes LoadKeys() makes to the token.
+  // It is not held while requests are in flight.
+  base::Lock key_cache_lock_;
+  base::TimeDelta key_cache_ttl_;
+  // When the key list was last fetched, and when each key known to be in the
+  // token was last seen on the NetHSM, by location.
+  base::TimeTicks key_list_fetched_;
+  std::map<std::string, base::TimeTicks> key_cache_;
+  // Locations of keys that are gone from the NetHSM but whose objects are still
+  // in the token.
+  std::set<std::string> stale_keys_;
+  KeyCacheStats key_cache_stats_;
 
   DISALLOW_COPY_AND_ASSIGN(NetUtilityImpl);
 };
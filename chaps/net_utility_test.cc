@@ -0,0 +1,182 @@
+// Copyright 2016 The Chromium OS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "chaps/net_utility_impl.h"
+
+#include <memory>
+#include <set>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "chaps/chaps_factory_impl.h"
+#include "chaps/handle_generator.h"
+#include "chaps/nethsm_server_fake.h"
+#include "chaps/nethsm_transport.h"
+#include "chaps/object.h"
+#include "chaps/object_pool.h"
+#include "chaps/object_store.h"
+
+using base::TimeDelta;
+using std::string;
+using std::vector;
+
+namespace chaps {
+
+namespace {
+
+const char kServerUrl[] = "http://localhost:18082";
+
+class TestHandleGenerator : public HandleGenerator {
+ public:
+  TestHandleGenerator() : last_handle_(0) {}
+  int CreateHandle() { return ++last_handle_; }
+
+ private:
+  int last_handle_;
+};
+
+}  // namespace
+
+class TestNetUtility : public ::testing::Test {
+ protected:
+  void SetUp() {
+    server_.reset(new NetHsmServerFake(kServerUrl));
+    ASSERT_TRUE(server_->Start());
+    server_->AddKey("key1", "AQAB", "AQAB", "encrypt");
+    server_->AddKey("key2", "AQAB", "AQAB", "sign");
+
+    factory_ = std::make_shared<ChapsFactoryImpl>();
+    pool_.reset(factory_->CreateObjectPool(
+        std::make_shared<TestHandleGenerator>(),
+        std::unique_ptr<ObjectStore>()));
+    ASSERT_TRUE(pool_);
+    NetHsmTransport::Options options;
+    options.url = kServerUrl;
+    net_utility_.reset(new NetUtilityImpl(
+        pool_, factory_, std::make_shared<NetHsmTransport>(options)));
+    ASSERT_TRUE(net_utility_->Init());
+  }
+
+  // Returns the number of objects in the pool.
+  size_t NumObjects() {
+    std::unique_ptr<Object> search_template(factory_->CreateObject());
+    vector<const Object*> objects;
+    EXPECT_TRUE(pool_->Find(search_template.get(), &objects));
+    return objects.size();
+  }
+
+  std::unique_ptr<NetHsmServerFake> server_;
+  std::shared_ptr<ChapsFactoryImpl> factory_;
+  std::shared_ptr<ObjectPool> pool_;
+  std::unique_ptr<NetUtilityImpl> net_utility_;
+};
+
+TEST_F(TestNetUtility, LoadAllKeysOnce) {
+  EXPECT_TRUE(net_utility_->LoadKeys(""));
+  // One request for the list and one for each key.
+  EXPECT_EQ(3, server_->num_requests());
+  EXPECT_EQ(4u, NumObjects());
+
+  EXPECT_TRUE(net_utility_->LoadKeys(""));
+  EXPECT_TRUE(net_utility_->LoadKeys("key1"));
+  EXPECT_EQ(3, server_->num_requests());
+  EXPECT_EQ(4u, NumObjects());
+
+  NetUtilityImpl::KeyCacheStats stats = net_utility_->key_cache_stats();
+  EXPECT_EQ(2, stats.hits);
+  EXPECT_EQ(1, stats.misses);
+  EXPECT_EQ(2, stats.keys_fetched);
+}
+
+TEST_F(TestNetUtility, RefreshAfterTtl) {
+  net_utility_->set_key_cache_ttl(TimeDelta());
+  EXPECT_TRUE(net_utility_->LoadKeys(""));
+  EXPECT_EQ(3, server_->num_requests());
+
+  // Only the list is fetched again, and only the new key is added.
+  server_->AddKey("key3", "AQAB", "AQAB", "encrypt");
+  EXPECT_TRUE(net_utility_->LoadKeys(""));
+  EXPECT_EQ(5, server_->num_requests());
+  EXPECT_EQ(6u, NumObjects());
+  EXPECT_EQ(3, net_utility_->key_cache_stats().keys_fetched);
+}
+
+TEST_F(TestNetUtility, RemoveDeletedKeys) {
+  net_utility_->set_key_cache_ttl(TimeDelta());
+  EXPECT_TRUE(net_utility_->LoadKeys(""));
+  EXPECT_EQ(4u, NumObjects());
+  EXPECT_FALSE(net_utility_->HasStaleKeys());
+
+  // A search only marks the deleted key, since other calls may be using its
+  // objects.
+  server_->RemoveKey("key1");
+  EXPECT_TRUE(net_utility_->LoadKeys(""));
+  EXPECT_TRUE(net_utility_->HasStaleKeys());
+  EXPECT_EQ(4u, NumObjects());
+
+  // A key that an operation uses stays until a later removal.
+  std::unique_ptr<Object> search_template(factory_->CreateObject());
+  search_template->SetAttributeString(CKA_LABEL, "/api/v0/keys/key1");
+  vector<const Object*> objects;
+  EXPECT_TRUE(pool_->Find(search_template.get(), &objects));
+  ASSERT_EQ(2u, objects.size());
+  net_utility_->RemoveStaleKeys(std::set<const Object*>{objects[0]});
+  EXPECT_TRUE(net_utility_->HasStaleKeys());
+  EXPECT_EQ(3u, NumObjects());
+
+  // Both objects of the deleted key leave the token, and searches for its
+  // label find nothing.
+  net_utility_->RemoveStaleKeys(std::set<const Object*>());
+  EXPECT_FALSE(net_utility_->HasStaleKeys());
+  EXPECT_EQ(2u, NumObjects());
+  objects.clear();
+  EXPECT_TRUE(pool_->Find(search_template.get(), &objects));
+  EXPECT_TRUE(objects.empty());
+
+  // The key is fetched again if it comes back.
+  server_->AddKey("key1", "AQAB", "AQAB", "encrypt");
+  EXPECT_TRUE(net_utility_->LoadKeys(""));
+  EXPECT_EQ(4u, NumObjects());
+}
+
+TEST_F(TestNetUtility, KeepKeysThatComeBack) {
+  net_utility_->set_key_cache_ttl(TimeDelta());
+  EXPECT_TRUE(net_utility_->LoadKeys(""));
+
+  // A key that is listed again before it has been removed stays in the token.
+  server_->RemoveKey("key1");
+  EXPECT_TRUE(net_utility_->LoadKeys(""));
+  EXPECT_TRUE(net_utility_->HasStaleKeys());
+  server_->AddKey("key1", "AQAB", "AQAB", "encrypt");
+  EXPECT_TRUE(net_utility_->LoadKeys(""));
+  EXPECT_FALSE(net_utility_->HasStaleKeys());
+  net_utility_->RemoveStaleKeys(std::set<const Object*>());
+  EXPECT_EQ(4u, NumObjects());
+}
+
+TEST_F(TestNetUtility, NoDuplicateObjects) {
+  EXPECT_TRUE(net_utility_->LoadKeys("key1"));
+  EXPECT_EQ(1, server_->num_requests());
+  EXPECT_EQ(2u, NumObjects());
+
+  // A second NetUtility on the same token finds the key in the token.
+  NetHsmTransport::Options options;
+  options.url = kServerUrl;
+  NetUtilityImpl other(pool_, factory_,
+                       std::make_shared<NetHsmTransport>(options));
+  ASSERT_TRUE(other.Init());
+  EXPECT_TRUE(other.LoadKeys(""));
+  EXPECT_EQ(3, server_->num_requests());
+  EXPECT_EQ(4u, NumObjects());
+}
+
+TEST_F(TestNetUtility, UnknownKey) {
+  EXPECT_TRUE(net_utility_->LoadKeys("unknown"));
+  EXPECT_EQ(0u, NumObjects());
+  EXPECT_EQ(0, net_utility_->key_cache_stats().keys_fetched);
+}
+
+}  // namespace chaps
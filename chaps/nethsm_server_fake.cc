@@ -0,0 +1,217 @@
+// Copyright 2016 The Chromium OS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "chaps/nethsm_server_fake.h"
+
+#include <algorithm>
+#include <functional>
+
+#include <base/logging.h>
+#include <base/threading/platform_thread.h>
+
+#include "cppcodec/base64_default_url.hpp"
+
+using base::AutoLock;
+using base::TimeDelta;
+using std::string;
+using web::http::http_request;
+using web::http::status_code;
+using web::http::status_codes;
+using web::json::value;
+
+namespace chaps {
+
+namespace {
+
+const char kKeysPath[] = "/api/v0/keys";
+const char kDecryptAction[] = "/actions/pkcs1/decrypt";
+const char kSignAction[] = "/actions/pkcs1/sign";
+
+// Returns whether |path| ends with |suffix|.
+bool EndsWith(const string& path, const string& suffix) {
+  return path.size() >= suffix.size() &&
+         path.compare(path.size() - suffix.size(), string::npos, suffix) == 0;
+}
+
+}  // namespace
+
+NetHsmServerFake::NetHsmServerFake(const string& url)
+    : listener_(url),
+      num_failures_(0),
+      num_requests_(0),
+      num_requests_in_flight_(0),
+      max_requests_in_flight_(0) {
+  listener_.support(std::bind(&NetHsmServerFake::HandleRequest, this,
+                              std::placeholders::_1));
+}
+
+NetHsmServerFake::~NetHsmServerFake() {
+  Stop();
+}
+
+bool NetHsmServerFake::Start() {
+  try {
+    listener_.open().wait();
+  } catch (const std::exception& e) {
+    LOG(ERROR) << "Failed to start fake NetHSM server: " << e.what();
+    return false;
+  }
+  return true;
+}
+
+void NetHsmServerFake::Stop() {
+  try {
+    listener_.close().wait();
+  } catch (const std::exception& e) {
+    LOG(WARNING) << "Failed to stop fake NetHSM server: " << e.what();
+  }
+}
+
+void NetHsmServerFake::AddKey(const string& id,
+                              const string& modulus,
+                              const string& public_exponent,
+                              const string& purpose) {
+  AutoLock lock(lock_);
+  Key& key = keys_[id];
+  key.modulus = modulus;
+  key.public_exponent = public_exponent;
+  key.purpose = purpose;
+}
+
+void NetHsmServerFake::RemoveKey(const string& id) {
+  AutoLock lock(lock_);
+  keys_.erase(id);
+}
+
+void NetHsmServerFake::set_delay(TimeDelta delay) {
+  AutoLock lock(lock_);
+  delay_ = delay;
+}
+
+void NetHsmServerFake::set_num_failures(int num_failures) {
+  AutoLock lock(lock_);
+  num_failures_ = num_failures;
+}
+
+int NetHsmServerFake::num_requests() {
+  AutoLock lock(lock_);
+  return num_requests_;
+}
+
+int NetHsmServerFake::max_requests_in_flight() {
+  AutoLock lock(lock_);
+  return max_requests_in_flight_;
+}
+
+void NetHsmServerFake::HandleRequest(http_request request) {
+  TimeDelta delay;
+  bool fail = false;
+  {
+    AutoLock lock(lock_);
+    ++num_requests_;
+    ++num_requests_in_flight_;
+    max_requests_in_flight_ =
+        std::max(max_requests_in_flight_, num_requests_in_flight_);
+    delay = delay_;
+    if (num_failures_ > 0) {
+      --num_failures_;
+      fail = true;
+    }
+  }
+  base::PlatformThread::Sleep(delay);
+
+  string path = request.relative_uri().path();
+  value response;
+  status_code status = status_codes::ServiceUnavailable;
+  if (!fail) {
+    if (request.method() == web::http::methods::GET) {
+      status = HandleGet(path, &response);
+    } else if (request.method() == web::http::methods::POST) {
+      value body;
+      try {
+        body = request.extract_json().get();
+        status = HandlePost(path, body, &response);
+      } catch (const std::exception&) {
+        status = status_codes::BadRequest;
+      }
+    } else {
+      status = status_codes::MethodNotAllowed;
+    }
+  }
+  {
+    AutoLock lock(lock_);
+    --num_requests_in_flight_;
+  }
+  if (response.is_null())
+    request.reply(status);
+  else
+    request.reply(status, response);
+}
+
+status_code NetHsmServerFake::HandleGet(const string& path, value* response) {
+  AutoLock lock(lock_);
+  if (path == kKeysPath) {
+    value keys = value::array(keys_.size());
+    size_t index = 0;
+    for (const auto& key : keys_) {
+      value entry;
+      entry["location"] =
+          value::string(string(kKeysPath) + "/" + key.first);
+      keys[index++] = entry;
+    }
+    (*response)["data"] = keys;
+    return status_codes::OK;
+  }
+  const string prefix = string(kKeysPath) + "/";
+  if (path.compare(0, prefix.size(), prefix) != 0)
+    return status_codes::NotFound;
+  auto key = keys_.find(path.substr(prefix.size()));
+  if (key == keys_.end())
+    return status_codes::NotFound;
+  value data;
+  data["id"] = value::string(key->first);
+  data["purpose"] = value::string(key->second.purpose);
+  data["publicKey"]["modulus"] = value::string(key->second.modulus);
+  data["publicKey"]["publicExponent"] =
+      value::string(key->second.public_exponent);
+  (*response)["data"] = data;
+  return status_codes::OK;
+}
+
+status_code NetHsmServerFake::HandlePost(const string& path,
+                                         const value& body,
+                                         value* response) {
+  const string prefix = string(kKeysPath) + "/";
+  string action;
+  string input_field;
+  string output_field;
+  if (EndsWith(path, kDecryptAction)) {
+    action = kDecryptAction;
+    input_field = "encrypted";
+    output_field = "decrypted";
+  } else if (EndsWith(path, kSignAction)) {
+    action = kSignAction;
+    input_field = "message";
+    output_field = "signature";
+  } else {
+    return status_codes::NotFound;
+  }
+  if (path.compare(0, prefix.size(), prefix) != 0 ||
+      path.size() < prefix.size() + action.size()) {
+    return status_codes::NotFound;
+  }
+  string id = path.substr(prefix.size(),
+                          path.size() - prefix.size() - action.size());
+  {
+    AutoLock lock(lock_);
+    if (keys_.find(id) == keys_.end())
+      return status_codes::NotFound;
+  }
+  string input = base64::decode<string>(body.at(input_field).as_string());
+  std::reverse(input.begin(), input.end());
+  (*response)["data"][output_field] = value::string(base64::encode(input));
+  return status_codes::OK;
+}
+
+}  // namespace chaps
@@ -0,0 +1,75 @@
+// Copyright 2016 The Chromium OS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef CHAPS_NETHSM_SERVER_FAKE_H_
+#define CHAPS_NETHSM_SERVER_FAKE_H_
+
+#include <map>
+#include <string>
+
+#include <base/macros.h>
+#include <base/synchronization/lock.h>
+#include <base/time/time.h>
+#include <cpprest/http_listener.h>
+
+namespace chaps {
+
+// NetHsmServerFake is a local HTTP server that answers the subset of the
+// NetHSM REST API used by chaps, for tests and benchmarks. Its decrypt and sign
+// actions return the input reversed.
+class NetHsmServerFake {
+ public:
+  // |url| is where the server listens, e.g. "http://localhost:18080".
+  explicit NetHsmServerFake(const std::string& url);
+  ~NetHsmServerFake();
+
+  bool Start();
+  void Stop();
+
+  // Adds an RSA key with the given base64-encoded public components.
+  void AddKey(const std::string& id,
+              const std::string& modulus,
+              const std::string& public_exponent,
+              const std::string& purpose);
+  void RemoveKey(const std::string& id);
+
+  // Delays every response by |delay|, to simulate network and HSM latency.
+  void set_delay(base::TimeDelta delay);
+  // Answers the next |num_failures| requests with 503 Service Unavailable.
+  void set_num_failures(int num_failures);
+
+  int num_requests();
+  // The largest number of requests that were being handled at the same time.
+  int max_requests_in_flight();
+
+ private:
+  struct Key {
+    std::string modulus;
+    std::string public_exponent;
+    std::string purpose;
+  };
+
+  void HandleRequest(web::http::http_request request);
+  web::http::status_code HandleGet(const std::string& path,
+                                   web::json::value* response);
+  web::http::status_code HandlePost(const std::string& path,
+                                    const web::json::value& body,
+                                    web::json::value* response);
+
+  web::http::experimental::listener::http_listener listener_;
+
+  base::Lock lock_;
+  std::map<std::string, Key> keys_;
+  base::TimeDelta delay_;
+  int num_failures_;
+  int num_requests_;
+  int num_requests_in_flight_;
+  int max_requests_in_flight_;
+
+  DISALLOW_COPY_AND_ASSIGN(NetHsmServerFake);
+};
+
+}  // namespace chaps
+
+#endif  // CHAPS_NETHSM_SERVER_FAKE_H_
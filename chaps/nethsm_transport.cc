@@ -0,0 +1,228 @@
+// Copyright 2016 The Chromium OS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "chaps/nethsm_transport.h"
+
+#include <chrono>
+#include <functional>
+#include <utility>
+
+#include <base/logging.h>
+#include <boost/asio/deadline_timer.hpp>
+#include <pplx/threadpool.h>
+
+#include "chaps/latency_stats.h"
+
+using base::AutoLock;
+using base::TimeDelta;
+using base::TimeTicks;
+using std::shared_ptr;
+using std::string;
+using web::http::client::http_client;
+using web::http::http_response;
+using web::json::value;
+
+namespace chaps {
+
+namespace {
+
+const char kLatencyCategory[] = "NetHsm";
+
+// Names a request for LatencyStats by its action, e.g. "decrypt", or by its
+// method if it is not an action. Key IDs are left out so the set of names
+// stays small.
+string GetRequestName(const web::http::method& method, const string& path) {
+  if (method != web::http::methods::POST)
+    return method;
+  return path.substr(path.rfind('/') + 1);
+}
+
+}  // namespace
+
+NetHsmTransport::Options::Options()
+    : url("http://localhost:8080"),
+      user("admin"),
+      password("secret"),
+      max_connections(8),
+      timeout(TimeDelta::FromSeconds(10)),
+      max_retries(2),
+      retry_delay(TimeDelta::FromMilliseconds(50)) {}
+
+NetHsmTransport::NetHsmTransport(const Options& options)
+    : options_(options),
+      request_completed_(&lock_),
+      num_pending_requests_(0) {
+  CHECK_GT(options_.max_connections, 0u);
+  config_.set_credentials(
+      web::http::client::credentials(options_.user, options_.password));
+  config_.set_timeout(
+      std::chrono::milliseconds(options_.timeout.InMilliseconds()));
+}
+
+NetHsmTransport::~NetHsmTransport() {
+  AutoLock lock(lock_);
+  while (num_pending_requests_ > 0)
+    request_completed_.Wait();
+}
+
+NetHsmTransport::Result NetHsmTransport::RequestAsync(
+    const web::http::method& method,
+    const string& path,
+    const value& body) {
+  shared_ptr<PendingRequest> request(new PendingRequest);
+  request->method = method;
+  request->path = path;
+  request->body = body;
+  request->attempt = 0;
+  request->start = TimeTicks::Now();
+  Result result(request->result);
+  {
+    AutoLock lock(lock_);
+    ++num_pending_requests_;
+  }
+  Enqueue(request);
+  return result;
+}
+
+boost::optional<value> NetHsmTransport::Request(
+    const web::http::method& method,
+    const string& path,
+    const value& body) {
+  return RequestAsync(method, path, body).get();
+}
+
+void NetHsmTransport::Enqueue(shared_ptr<PendingRequest> request) {
+  Connection* connection = NULL;
+  {
+    AutoLock lock(lock_);
+    if (!idle_connections_.empty()) {
+      connection = idle_connections_.back();
+      idle_connections_.pop_back();
+    } else if (connections_.size() < options_.max_connections) {
+      connections_.emplace_back(new http_client(options_.url, config_));
+      connection = connections_.back().get();
+    } else {
+      queue_.push_back(request);
+      return;
+    }
+  }
+  Send(connection, request);
+}
+
+void NetHsmTransport::Send(Connection* connection,
+                           shared_ptr<PendingRequest> request) {
+  pplx::task<http_response> response =
+      request->body.is_null()
+          ? connection->request(request->method, request->path)
+          : connection->request(request->method, request->path,
+                                request->body);
+  response.then(std::bind(&NetHsmTransport::OnResponse, this, connection,
+                          request, std::placeholders::_1));
+}
+
+void NetHsmTransport::OnResponse(Connection* connection,
+                                 shared_ptr<PendingRequest> request,
+                                 pplx::task<http_response> response_task) {
+  bool retry = false;
+  try {
+    http_response response = response_task.get();
+    web::http::status_code status = response.status_code();
+    VLOG(1) << request->method << " " << request->path << ": " << status;
+    if (status >= 200 && status < 300) {
+      // The connection stays busy until the body has been read.
+      response.extract_json().then(
+          std::bind(&NetHsmTransport::OnBody, this, connection, request,
+                    std::placeholders::_1));
+      return;
+    }
+    if (status >= 500) {
+      LOG(WARNING) << "NetHSM server error for " << request->path << ": "
+                   << status;
+      retry = true;
+    } else {
+      LOG(ERROR) << "NetHSM request for " << request->path << " failed: "
+                 << status;
+    }
+  } catch (const web::http::http_exception& e) {
+    LOG(WARNING) << "NetHSM request for " << request->path << " failed: "
+                 << e.what();
+    retry = true;
+  }
+  Complete(connection, request, boost::none, retry);
+}
+
+void NetHsmTransport::OnBody(Connection* connection,
+                             shared_ptr<PendingRequest> request,
+                             pplx::task<value> body) {
+  boost::optional<value> result;
+  bool retry = false;
+  try {
+    result = body.get();
+  } catch (const web::http::http_exception& e) {
+    LOG(WARNING) << "Reading the NetHSM response for " << request->path
+                 << " failed: " << e.what();
+    retry = true;
+  } catch (const web::json::json_exception& e) {
+    LOG(ERROR) << "Malformed NetHSM response for " << request->path << ": "
+               << e.what();
+  }
+  Complete(connection, request, result, retry);
+}
+
+void NetHsmTransport::Complete(Connection* connection,
+                               shared_ptr<PendingRequest> request,
+                               boost::optional<value> result,
+                               bool retry) {
+  ReleaseConnection(connection);
+  if (retry && request->attempt < options_.max_retries) {
+    ++request->attempt;
+    EnqueueAfter(request, options_.retry_delay * request->attempt);
+    return;
+  }
+  // Retries are included, as callers wait for them too.
+  LatencyStats::GetInstance()->Record(
+      string(kLatencyCategory) + "." +
+          GetRequestName(request->method, request->path),
+      TimeTicks::Now() - request->start, static_cast<bool>(result));
+  {
+    AutoLock lock(lock_);
+    --num_pending_requests_;
+    request_completed_.Broadcast();
+  }
+  // |this| may be gone from here on.
+  request->result.set(result);
+}
+
+void NetHsmTransport::EnqueueAfter(shared_ptr<PendingRequest> request,
+                                   TimeDelta delay) {
+  RunAfter(delay, std::bind(&NetHsmTransport::Enqueue, this, request));
+}
+
+void NetHsmTransport::RunAfter(TimeDelta delay,
+                               const std::function<void()>& task) {
+  // The handler owns the timer, which must outlive the wait.
+  shared_ptr<boost::asio::deadline_timer> timer(
+      new boost::asio::deadline_timer(
+          crossplat::threadpool::shared_instance().service(),
+          boost::posix_time::milliseconds(delay.InMilliseconds())));
+  timer->async_wait([task, timer](const boost::system::error_code&) {
+    task();
+  });
+}
+
+void NetHsmTransport::ReleaseConnection(Connection* connection) {
+  shared_ptr<PendingRequest> next;
+  {
+    AutoLock lock(lock_);
+    if (queue_.empty()) {
+      idle_connections_.push_back(connection);
+      return;
+    }
+    next = queue_.front();
+    queue_.pop_front();
+  }
+  Send(connection, next);
+}
+
+}  // namespace chaps
@@ -0,0 +1,133 @@
+// Copyright 2016 The Chromium OS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef CHAPS_NETHSM_TRANSPORT_H_
+#define CHAPS_NETHSM_TRANSPORT_H_
+
+#include <deque>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <base/macros.h>
+#include <base/synchronization/condition_variable.h>
+#include <base/synchronization/lock.h>
+#include <base/time/time.h>
+#include <boost/optional.hpp>
+#include <cpprest/http_client.h>
+
+namespace chaps {
+
+// NetHsmTransport sends REST requests to a NetHSM over a bounded pool of
+// persistent HTTP connections. It is thread-safe. Requests are queued and sent
+// as soon as a connection is free, without blocking the caller, so callers can
+// keep any number of requests in flight; at most |max_connections| of them are
+// on the wire at once. Nothing blocks on the cpprest threads that deliver the
+// responses: bodies are read by continuations, and retries wait on timers run
+// by the cpprest thread pool. A single instance is shared by all
+// tokens.
+class NetHsmTransport {
+ public:
+  struct Options {
+    Options();
+
+    std::string url;
+    std::string user;
+    std::string password;
+    // The maximum number of connections, and so of requests on the wire.
+    size_t max_connections;
+    // How long to wait for a response before the attempt fails.
+    base::TimeDelta timeout;
+    // How many times a request is sent again after a connection error, a
+    // timeout or a 5xx response. Attempt n waits n * |retry_delay| first, then
+    // goes back through the queue like a new request, so it may be sent on
+    // any connection of the pool, including the one that failed.
+    int max_retries;
+    base::TimeDelta retry_delay;
+  };
+
+  typedef pplx::task<boost::optional<web::json::value>> Result;
+
+  explicit NetHsmTransport(const Options& options);
+  // Waits for all requests to complete.
+  virtual ~NetHsmTransport();
+
+  // Queues a request to |path| and returns right away. The result is the JSON
+  // body of a 2xx response, or none if the request failed. A null |body| sends
+  // no body.
+  virtual Result RequestAsync(const web::http::method& method,
+                              const std::string& path,
+                              const web::json::value& body);
+
+  // Like RequestAsync(), but waits for the result.
+  boost::optional<web::json::value> Request(const web::http::method& method,
+                                            const std::string& path,
+                                            const web::json::value& body);
+
+  const Options& options() const { return options_; }
+
+ protected:
+  // Runs |task| on a cpprest thread once |delay| has passed. Tests override it
+  // to decide when retries are sent.
+  virtual void RunAfter(base::TimeDelta delay,
+                        const std::function<void()>& task);
+
+ private:
+  typedef web::http::client::http_client Connection;
+
+  struct PendingRequest {
+    web::http::method method;
+    std::string path;
+    web::json::value body;
+    int attempt;
+    base::TimeTicks start;
+    pplx::task_completion_event<boost::optional<web::json::value>> result;
+  };
+
+  // Sends |request| on an idle connection, opening a new one if fewer than
+  // |max_connections| are open, or queues it until a connection is free.
+  void Enqueue(std::shared_ptr<PendingRequest> request);
+  void Send(Connection* connection, std::shared_ptr<PendingRequest> request);
+  // Reads the body of a successful response, or passes the failure on to
+  // Complete().
+  void OnResponse(Connection* connection,
+                  std::shared_ptr<PendingRequest> request,
+                  pplx::task<web::http::http_response> response);
+  void OnBody(Connection* connection,
+              std::shared_ptr<PendingRequest> request,
+              pplx::task<web::json::value> body);
+  // Hands |connection| to the next request, then completes |request| with
+  // |result|, or schedules it to be sent again if |retry| and it has retries
+  // left.
+  void Complete(Connection* connection,
+                std::shared_ptr<PendingRequest> request,
+                boost::optional<web::json::value> result,
+                bool retry);
+  // Queues |request| again after |delay|.
+  void EnqueueAfter(std::shared_ptr<PendingRequest> request,
+                    base::TimeDelta delay);
+  // Sends the next queued request on |connection|, or makes it idle.
+  void ReleaseConnection(Connection* connection);
+
+  const Options options_;
+  web::http::client::http_client_config config_;
+
+  base::Lock lock_;
+  base::ConditionVariable request_completed_;
+  // All open connections, and those of them that are not sending a request.
+  // cpprest reopens the socket of a connection by itself if it breaks.
+  std::vector<std::unique_ptr<Connection>> connections_;
+  std::vector<Connection*> idle_connections_;
+  std::deque<std::shared_ptr<PendingRequest>> queue_;
+  // Requests that have not completed yet, whether queued, on the wire or
+  // waiting to be retried.
+  int num_pending_requests_;
+
+  DISALLOW_COPY_AND_ASSIGN(NetHsmTransport);
+};
+
+}  // namespace chaps
+
+#endif  // CHAPS_NETHSM_TRANSPORT_H_
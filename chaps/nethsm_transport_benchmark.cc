@@ -0,0 +1,115 @@
+// Copyright 2016 The Chromium OS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// Measures NetHSM decrypt latency and throughput through NetHsmTransport
+// against a local fake server with a fixed response delay, for several
+// connection pool sizes. Also measures the throughput of signatures that are
+// all queued at once by a single thread.
+
+#include <stdio.h>
+
+#include <algorithm>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <base/at_exit.h>
+#include <base/logging.h>
+#include <base/threading/platform_thread.h>
+#include <base/time/time.h>
+
+#include "chaps/nethsm_server_fake.h"
+#include "chaps/nethsm_transport.h"
+#include "chaps/net_utility_impl.h"
+
+using base::PlatformThread;
+using base::PlatformThreadHandle;
+using base::TimeDelta;
+using base::TimeTicks;
+using std::string;
+using std::vector;
+
+namespace {
+
+const char kServerUrl[] = "http://localhost:18081";
+const char kKeyPath[] = "/api/v0/keys/key1";
+const int kNumThreads = 16;
+const int kNumIterations = 50;
+const size_t kMaxConnections[] = {1, 2, 4, 8, 16};
+
+class DecryptThread : public PlatformThread::Delegate {
+ public:
+  explicit DecryptThread(chaps::NetUtility* net_utility)
+      : net_utility_(net_utility) {}
+  void ThreadMain() {
+    const string input(256, 'x');
+    for (int i = 0; i < kNumIterations; ++i) {
+      TimeTicks start = TimeTicks::Now();
+      CHECK(net_utility_->Decrypt(kKeyPath, input));
+      latencies_.push_back(TimeTicks::Now() - start);
+    }
+  }
+  const vector<TimeDelta>& latencies() const { return latencies_; }
+
+ private:
+  chaps::NetUtility* net_utility_;
+  vector<TimeDelta> latencies_;
+};
+
+// Returns the number of signatures per second when |kNumThreads| *
+// |kNumIterations| signatures are queued at once.
+double MeasurePipelinedSigns(chaps::NetUtilityImpl* net_utility) {
+  const string input(51, 'x');
+  TimeTicks start = TimeTicks::Now();
+  vector<pplx::task<boost::optional<string>>> signatures;
+  for (int i = 0; i < kNumThreads * kNumIterations; ++i)
+    signatures.push_back(net_utility->SignAsync(kKeyPath, input));
+  for (size_t i = 0; i < signatures.size(); ++i)
+    CHECK(signatures[i].get());
+  return signatures.size() / (TimeTicks::Now() - start).InSecondsF();
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  base::AtExitManager at_exit;
+  chaps::NetHsmServerFake server(kServerUrl);
+  CHECK(server.Start());
+  server.AddKey("key1", "AQAB", "AQAB", "encrypt");
+  server.set_delay(TimeDelta::FromMilliseconds(5));
+
+  printf("%12s %12s %12s %12s %12s\n", "connections", "decrypts/s", "p50 ms",
+         "p99 ms", "signs/s");
+  for (size_t max_connections : kMaxConnections) {
+    chaps::NetHsmTransport::Options options;
+    options.url = kServerUrl;
+    options.max_connections = max_connections;
+    chaps::NetUtilityImpl net_utility(
+        nullptr, nullptr, std::make_shared<chaps::NetHsmTransport>(options));
+    CHECK(net_utility.Init());
+
+    vector<std::unique_ptr<DecryptThread>> threads;
+    vector<PlatformThreadHandle> handles(kNumThreads);
+    TimeTicks start = TimeTicks::Now();
+    for (int i = 0; i < kNumThreads; ++i) {
+      threads.emplace_back(new DecryptThread(&net_utility));
+      CHECK(PlatformThread::Create(0, threads[i].get(), &handles[i]));
+    }
+    vector<TimeDelta> latencies;
+    for (int i = 0; i < kNumThreads; ++i) {
+      PlatformThread::Join(handles[i]);
+      latencies.insert(latencies.end(), threads[i]->latencies().begin(),
+                       threads[i]->latencies().end());
+    }
+    TimeDelta elapsed = TimeTicks::Now() - start;
+
+    std::sort(latencies.begin(), latencies.end());
+    printf("%12zu %12.0f %12.2f %12.2f %12.0f\n", max_connections,
+           latencies.size() / elapsed.InSecondsF(),
+           latencies[latencies.size() / 2].InMillisecondsF(),
+           latencies[latencies.size() * 99 / 100].InMillisecondsF(),
+           MeasurePipelinedSigns(&net_utility));
+  }
+  return 0;
+}
@@ -0,0 +1,224 @@
+// Copyright 2016 The Chromium OS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "chaps/nethsm_transport.h"
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <base/synchronization/condition_variable.h>
+#include <base/synchronization/lock.h>
+#include <base/threading/platform_thread.h>
+#include <gtest/gtest.h>
+
+#include "chaps/nethsm_server_fake.h"
+#include "chaps/net_utility_impl.h"
+
+using base::PlatformThread;
+using base::PlatformThreadHandle;
+using base::TimeDelta;
+using std::string;
+using std::vector;
+using web::json::value;
+
+namespace chaps {
+
+namespace {
+
+const char kServerUrl[] = "http://localhost:18080";
+const char kKeyPath[] = "/api/v0/keys/key1";
+
+// Decrypts through a NetUtilityImpl |num_iterations| times.
+class DecryptThread : public PlatformThread::Delegate {
+ public:
+  DecryptThread(NetUtility* net_utility, int num_iterations)
+      : net_utility_(net_utility),
+        num_iterations_(num_iterations),
+        num_successes_(0) {}
+  void ThreadMain() {
+    for (int i = 0; i < num_iterations_; ++i) {
+      boost::optional<string> result = net_utility_->Decrypt(kKeyPath, "abc");
+      if (result && *result == "cba")
+        ++num_successes_;
+    }
+  }
+  int num_successes() const { return num_successes_; }
+
+ private:
+  NetUtility* net_utility_;
+  int num_iterations_;
+  int num_successes_;
+};
+
+// Holds the requests waiting to be retried until RunRetries() is called.
+class ManualRetryTransport : public NetHsmTransport {
+ public:
+  explicit ManualRetryTransport(const Options& options)
+      : NetHsmTransport(options), retry_scheduled_(&lock_) {}
+  // Sends the retries that are still held, since the base class waits for
+  // them.
+  ~ManualRetryTransport() override { RunRetries(); }
+
+  // Waits until a retry is held, and returns its delay.
+  TimeDelta WaitForRetry() {
+    base::AutoLock lock(lock_);
+    while (retries_.empty())
+      retry_scheduled_.Wait();
+    return retries_.front().first;
+  }
+
+  void RunRetries() {
+    vector<std::pair<TimeDelta, std::function<void()>>> retries;
+    {
+      base::AutoLock lock(lock_);
+      retries.swap(retries_);
+    }
+    for (size_t i = 0; i < retries.size(); ++i)
+      retries[i].second();
+  }
+
+ protected:
+  void RunAfter(TimeDelta delay, const std::function<void()>& task) override {
+    base::AutoLock lock(lock_);
+    retries_.push_back(std::make_pair(delay, task));
+    retry_scheduled_.Signal();
+  }
+
+ private:
+  base::Lock lock_;
+  base::ConditionVariable retry_scheduled_;
+  vector<std::pair<TimeDelta, std::function<void()>>> retries_;
+};
+
+}  // namespace
+
+class TestNetHsmTransport : public ::testing::Test {
+ protected:
+  void SetUp() {
+    server_.reset(new NetHsmServerFake(kServerUrl));
+    ASSERT_TRUE(server_->Start());
+    server_->AddKey("key1", "AQAB", "AQAB", "encrypt");
+    options_.url = kServerUrl;
+    options_.retry_delay = TimeDelta::FromMilliseconds(1);
+  }
+
+  std::shared_ptr<NetHsmTransport> CreateTransport() {
+    return std::make_shared<NetHsmTransport>(options_);
+  }
+
+  std::unique_ptr<NetHsmServerFake> server_;
+  NetHsmTransport::Options options_;
+};
+
+TEST_F(TestNetHsmTransport, Decrypt) {
+  NetUtilityImpl net_utility(nullptr, nullptr, CreateTransport());
+  ASSERT_TRUE(net_utility.Init());
+  boost::optional<string> result = net_utility.Decrypt(kKeyPath, "abc");
+  ASSERT_TRUE(result);
+  EXPECT_EQ("cba", *result);
+  EXPECT_FALSE(net_utility.Decrypt("/api/v0/keys/unknown", "abc"));
+}
+
+TEST_F(TestNetHsmTransport, ConcurrentRequests) {
+  const int kNumThreads = 8;
+  const int kNumIterations = 5;
+  options_.max_connections = 4;
+  server_->set_delay(TimeDelta::FromMilliseconds(50));
+  NetUtilityImpl net_utility(nullptr, nullptr, CreateTransport());
+  ASSERT_TRUE(net_utility.Init());
+
+  vector<std::unique_ptr<DecryptThread>> threads;
+  vector<PlatformThreadHandle> handles(kNumThreads);
+  for (int i = 0; i < kNumThreads; ++i) {
+    threads.emplace_back(new DecryptThread(&net_utility, kNumIterations));
+    ASSERT_TRUE(PlatformThread::Create(0, threads[i].get(), &handles[i]));
+  }
+  for (int i = 0; i < kNumThreads; ++i) {
+    PlatformThread::Join(handles[i]);
+    EXPECT_EQ(kNumIterations, threads[i]->num_successes());
+  }
+  // Requests overlap, but never on more connections than allowed.
+  EXPECT_GT(server_->max_requests_in_flight(), 1);
+  EXPECT_LE(server_->max_requests_in_flight(), 4);
+}
+
+TEST_F(TestNetHsmTransport, Sign) {
+  NetUtilityImpl net_utility(nullptr, nullptr, CreateTransport());
+  ASSERT_TRUE(net_utility.Init());
+  boost::optional<string> result = net_utility.Sign(kKeyPath, "abc");
+  ASSERT_TRUE(result);
+  EXPECT_EQ("cba", *result);
+  EXPECT_FALSE(net_utility.Sign("/api/v0/keys/unknown", "abc"));
+}
+
+TEST_F(TestNetHsmTransport, PipelinedSigns) {
+  const int kNumSignatures = 32;
+  options_.max_connections = 4;
+  server_->set_delay(TimeDelta::FromMilliseconds(20));
+  NetUtilityImpl net_utility(nullptr, nullptr, CreateTransport());
+  ASSERT_TRUE(net_utility.Init());
+
+  // All requests are queued without waiting for a connection.
+  vector<pplx::task<boost::optional<string>>> signatures;
+  for (int i = 0; i < kNumSignatures; ++i)
+    signatures.push_back(net_utility.SignAsync(kKeyPath, "abc"));
+  EXPECT_FALSE(signatures.back().is_done());
+  for (size_t i = 0; i < signatures.size(); ++i) {
+    boost::optional<string> result = signatures[i].get();
+    ASSERT_TRUE(result);
+    EXPECT_EQ("cba", *result);
+  }
+  EXPECT_EQ(kNumSignatures, server_->num_requests());
+  EXPECT_EQ(4, server_->max_requests_in_flight());
+}
+
+TEST_F(TestNetHsmTransport, RetryServerErrors) {
+  options_.max_retries = 2;
+  std::shared_ptr<NetHsmTransport> transport = CreateTransport();
+  server_->set_num_failures(2);
+  EXPECT_TRUE(transport->Request(web::http::methods::GET, kKeyPath, value()));
+  EXPECT_EQ(3, server_->num_requests());
+
+  server_->set_num_failures(3);
+  EXPECT_FALSE(transport->Request(web::http::methods::GET, kKeyPath, value()));
+  EXPECT_EQ(6, server_->num_requests());
+}
+
+// Test that a request waiting to be retried doesn't hold up the requests queued
+// behind it.
+TEST_F(TestNetHsmTransport, RetryLater) {
+  options_.max_connections = 1;
+  ManualRetryTransport transport(options_);
+  server_->set_num_failures(1);
+  NetHsmTransport::Result retried =
+      transport.RequestAsync(web::http::methods::GET, kKeyPath, value());
+  EXPECT_TRUE(transport.Request(web::http::methods::GET, kKeyPath, value()));
+  EXPECT_EQ(options_.retry_delay, transport.WaitForRetry());
+  EXPECT_FALSE(retried.is_done());
+  EXPECT_EQ(2, server_->num_requests());
+
+  transport.RunRetries();
+  EXPECT_TRUE(retried.get());
+  EXPECT_EQ(3, server_->num_requests());
+}
+
+TEST_F(TestNetHsmTransport, NoRetryClientErrors) {
+  std::shared_ptr<NetHsmTransport> transport = CreateTransport();
+  EXPECT_FALSE(transport->Request(web::http::methods::GET,
+                                  "/api/v0/keys/unknown", value()));
+  EXPECT_EQ(1, server_->num_requests());
+}
+
+TEST_F(TestNetHsmTransport, Timeout) {
+  options_.timeout = TimeDelta::FromMilliseconds(100);
+  options_.max_retries = 0;
+  server_->set_delay(TimeDelta::FromMilliseconds(500));
+  std::shared_ptr<NetHsmTransport> transport = CreateTransport();
+  EXPECT_FALSE(transport->Request(web::http::methods::GET, kKeyPath, value()));
+}
+
+}  // namespace chaps
@@ -6,6 +6,7 @@
 #define CHAPS_OBJECT_H_
 
 #include <map>
+#include <memory>
 #include <string>
 
 #include "pkcs11/cryptoki.h"
@@ -23,6 +24,13 @@ enum ObjectStage {
   kNumObjectStages
 };
 
+// ObjectCache is the base for state derived from an object's attributes that is
+// expensive to compute, such as a parsed key, and is kept with the object.
+class ObjectCache {
+ public:
+  virtual ~ObjectCache() {}
+};
+
 // Object is the interface for a PKCS #11 object.  This component manages all
 // object attributes and provides query and modify access to attributes
 // according to the current object policy.
@@ -100,6 +108,12 @@ class Object {
   // Get / set an identifier as designated by a store.
   virtual int store_id() const = 0;
   virtual void set_store_id(int store_id) = 0;
+  // Get / set state derived from the object's attributes. The cache is dropped
+  // whenever an attribute changes, after which GetCache() returns NULL. Objects
+  // may be read by several threads at once, so these are thread-safe and work
+  // on const objects.
+  virtual std::shared_ptr<ObjectCache> GetCache() const = 0;
+  virtual void SetCache(std::shared_ptr<ObjectCache> cache) const = 0;
 };
 
 }  // namespace chaps
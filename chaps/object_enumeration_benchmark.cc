@@ -0,0 +1,205 @@
+// Copyright 2016 The Chromium OS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// Measures how long a client takes to enumerate 1000 objects and read their
+// attributes through the Chaps daemon: with FindObjects and one
+// GetAttributeValue call per object, as C_GetAttributeValue does, with
+// FindObjects and one GetAttributeValues call, and with a single
+// FindObjectsWithAttributes call. Needs a running chapsd with a token in the
+// slot given by --slot (0 by default). The objects are session objects and
+// disappear when the benchmark ends.
+
+#include <stdio.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include <base/at_exit.h>
+#include <base/command_line.h>
+#include <base/logging.h>
+#include <base/macros.h>
+#include <base/strings/string_number_conversions.h>
+#include <base/strings/stringprintf.h>
+#include <base/time/time.h>
+
+#include "chaps/attributes.h"
+#include "chaps/chaps_proxy.h"
+#include "chaps/isolate.h"
+#include "pkcs11/cryptoki.h"
+
+using base::TimeDelta;
+using base::TimeTicks;
+using brillo::SecureBlob;
+using chaps::IsolateCredentialManager;
+using std::string;
+using std::vector;
+
+namespace {
+
+const int kNumObjects = 1000;
+const int kNumIterations = 5;
+const char kApplication[] = "object_enumeration_benchmark";
+
+vector<uint8_t> Serialize(CK_ATTRIBUTE_PTR attributes, CK_ULONG count) {
+  chaps::Attributes tmp(attributes, count);
+  vector<uint8_t> serialized;
+  CHECK(tmp.Serialize(&serialized));
+  return serialized;
+}
+
+void CreateObjects(chaps::ChapsProxyImpl* proxy,
+                   const SecureBlob& isolate_credential,
+                   uint64_t session_id) {
+  CK_OBJECT_CLASS data_class = CKO_DATA;
+  CK_BBOOL no = CK_FALSE;
+  for (int i = 0; i < kNumObjects; ++i) {
+    string label = base::StringPrintf("object %d", i);
+    string value(256, static_cast<char>(i));
+    CK_ATTRIBUTE attributes[] = {
+      {CKA_CLASS, &data_class, sizeof(data_class)},
+      {CKA_TOKEN, &no, sizeof(no)},
+      {CKA_APPLICATION, const_cast<char*>(kApplication),
+       sizeof(kApplication) - 1},
+      {CKA_LABEL, const_cast<char*>(label.data()), label.size()},
+      {CKA_VALUE, const_cast<char*>(value.data()), value.size()}
+    };
+    uint64_t handle = 0;
+    CHECK_EQ(CKR_OK, proxy->CreateObject(isolate_credential, session_id,
+                                         Serialize(attributes, 5), &handle));
+  }
+}
+
+// The attributes a certificate picker would read, with buffers large enough
+// for the values of the benchmark objects.
+vector<uint8_t> GetAttributeTemplate() {
+  char label[64];
+  char value[256];
+  CK_ATTRIBUTE attributes[] = {
+    {CKA_LABEL, label, sizeof(label)},
+    {CKA_VALUE, value, sizeof(value)}
+  };
+  return Serialize(attributes, 2);
+}
+
+vector<uint8_t> GetFindTemplate() {
+  CK_ATTRIBUTE attributes[] = {
+    {CKA_APPLICATION, const_cast<char*>(kApplication),
+     sizeof(kApplication) - 1}
+  };
+  return Serialize(attributes, 1);
+}
+
+vector<uint64_t> Find(chaps::ChapsProxyImpl* proxy,
+                      const SecureBlob& isolate_credential,
+                      uint64_t session_id) {
+  vector<uint64_t> objects;
+  CHECK_EQ(CKR_OK, proxy->FindObjectsInit(isolate_credential, session_id,
+                                          GetFindTemplate()));
+  CHECK_EQ(CKR_OK, proxy->FindObjects(isolate_credential, session_id,
+                                      kNumObjects, &objects));
+  CHECK_EQ(CKR_OK, proxy->FindObjectsFinal(isolate_credential, session_id));
+  CHECK_EQ(static_cast<size_t>(kNumObjects), objects.size());
+  return objects;
+}
+
+void EnumerateOneByOne(chaps::ChapsProxyImpl* proxy,
+                       const SecureBlob& isolate_credential,
+                       uint64_t session_id) {
+  vector<uint64_t> objects = Find(proxy, isolate_credential, session_id);
+  vector<uint8_t> attributes_in = GetAttributeTemplate();
+  for (size_t i = 0; i < objects.size(); ++i) {
+    vector<uint8_t> attributes_out;
+    CHECK_EQ(CKR_OK, proxy->GetAttributeValue(isolate_credential, session_id,
+                                              objects[i], attributes_in,
+                                              &attributes_out));
+  }
+}
+
+void EnumerateBatched(chaps::ChapsProxyImpl* proxy,
+                      const SecureBlob& isolate_credential,
+                      uint64_t session_id) {
+  vector<uint64_t> objects = Find(proxy, isolate_credential, session_id);
+  vector<vector<uint8_t>> attributes_out;
+  vector<uint32_t> results;
+  CHECK_EQ(CKR_OK, proxy->GetAttributeValues(isolate_credential, session_id,
+                                             objects, GetAttributeTemplate(),
+                                             &attributes_out, &results));
+  CHECK(results == vector<uint32_t>(kNumObjects, CKR_OK));
+}
+
+void EnumerateCombined(chaps::ChapsProxyImpl* proxy,
+                       const SecureBlob& isolate_credential,
+                       uint64_t session_id) {
+  vector<uint64_t> objects;
+  vector<vector<uint8_t>> attributes_out;
+  vector<uint32_t> results;
+  CHECK_EQ(CKR_OK, proxy->FindObjectsWithAttributes(isolate_credential,
+                                                    session_id,
+                                                    GetFindTemplate(),
+                                                    GetAttributeTemplate(),
+                                                    kNumObjects,
+                                                    &objects,
+                                                    &attributes_out,
+                                                    &results));
+  CHECK(results == vector<uint32_t>(kNumObjects, CKR_OK));
+}
+
+typedef void (*EnumerateFunction)(chaps::ChapsProxyImpl*,
+                                  const SecureBlob&,
+                                  uint64_t);
+
+// Returns the fastest of |kNumIterations| runs of |enumerate|.
+TimeDelta Measure(EnumerateFunction enumerate,
+                  chaps::ChapsProxyImpl* proxy,
+                  const SecureBlob& isolate_credential,
+                  uint64_t session_id) {
+  TimeDelta best = TimeDelta::Max();
+  for (int i = 0; i < kNumIterations; ++i) {
+    TimeTicks start = TimeTicks::Now();
+    enumerate(proxy, isolate_credential, session_id);
+    best = std::min(best, TimeTicks::Now() - start);
+  }
+  return best;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  base::AtExitManager at_exit;
+  base::CommandLine::Init(argc, argv);
+  base::CommandLine* cl = base::CommandLine::ForCurrentProcess();
+  uint64_t slot_id = 0;
+  if (cl->HasSwitch("slot"))
+    CHECK(base::StringToUint64(cl->GetSwitchValueASCII("slot"), &slot_id));
+
+  chaps::ChapsProxyImpl proxy;
+  CHECK(proxy.Init());
+  SecureBlob isolate_credential =
+      IsolateCredentialManager::GetDefaultIsolateCredential();
+  uint64_t session_id = 0;
+  CHECK_EQ(CKR_OK, proxy.OpenSession(isolate_credential, slot_id,
+                                     CKF_SERIAL_SESSION | CKF_RW_SESSION,
+                                     &session_id));
+  CreateObjects(&proxy, isolate_credential, session_id);
+
+  printf("%-32s %12s %12s\n", "enumeration", "ms", "objects/s");
+  struct {
+    const char* name;
+    EnumerateFunction enumerate;
+  } runs[] = {
+    {"GetAttributeValue per object", EnumerateOneByOne},
+    {"GetAttributeValues", EnumerateBatched},
+    {"FindObjectsWithAttributes", EnumerateCombined}
+  };
+  for (size_t i = 0; i < arraysize(runs); ++i) {
+    TimeDelta elapsed = Measure(runs[i].enumerate, &proxy, isolate_credential,
+                                session_id);
+    printf("%-32s %12.2f %12.0f\n", runs[i].name, elapsed.InMillisecondsF(),
+           kNumObjects / elapsed.InSecondsF());
+  }
+
+  proxy.CloseSession(isolate_credential, session_id);
+  return 0;
+}
@@ -78,6 +78,7 @@ CK_RV ObjectImpl::FinalizeNewObject() {
 CK_RV ObjectImpl::Copy(const Object* original) {
   stage_ = kCopy;
   attributes_ = *original->GetAttributeMap();
+  DropCache();
   policy_.reset();
   if (!SetPolicyByClass())
     return CKR_TEMPLATE_INCOMPLETE;
@@ -127,6 +128,7 @@ CK_RV ObjectImpl::SetAttributes(const CK_ATTRIBUTE_PTR attributes,
     }
     external_attributes_.insert(attributes[i].type);
     attributes_[attributes[i].type] = value;
+    DropCache();
   }
   if (policy_.get()) {
     if (!policy_->IsObjectComplete())
@@ -151,6 +153,7 @@ bool ObjectImpl::GetAttributeBool(CK_ATTRIBUTE_TYPE type,
 
 void ObjectImpl::SetAttributeBool(CK_ATTRIBUTE_TYPE type, bool value) {
   attributes_[type] = string(1, value ? 1 : 0);
+  DropCache();
 }
 
 int ObjectImpl::GetAttributeInt(CK_ATTRIBUTE_TYPE type,
@@ -174,6 +177,7 @@ void ObjectImpl::SetAttributeInt(CK_ATTRIBUTE_TYPE type, int value) {
   CK_ULONG long_value = value;
   attributes_[type] = string(reinterpret_cast<const char*>(&long_value),
                              sizeof(CK_ULONG));
+  DropCache();
 }
 
 string ObjectImpl::GetAttributeString(CK_ATTRIBUTE_TYPE type) const {
@@ -186,16 +190,32 @@ string ObjectImpl::GetAttributeString(CK_ATTRIBUTE_TYPE type) const {
 void ObjectImpl::SetAttributeString(CK_ATTRIBUTE_TYPE type,
                                     const string& value) {
   attributes_[type] = value;
+  DropCache();
 }
 
 void ObjectImpl::RemoveAttribute(CK_ATTRIBUTE_TYPE type) {
   attributes_.erase(type);
+  DropCache();
 }
 
 const AttributeMap* ObjectImpl::GetAttributeMap() const {
   return &attributes_;
 }
 
+std::shared_ptr<ObjectCache> ObjectImpl::GetCache() const {
+  base::AutoLock lock(cache_lock_);
+  return cache_;
+}
+
+void ObjectImpl::SetCache(std::shared_ptr<ObjectCache> cache) const {
+  base::AutoLock lock(cache_lock_);
+  cache_ = cache;
+}
+
+void ObjectImpl::DropCache() {
+  SetCache(std::shared_ptr<ObjectCache>());
+}
+
 bool ObjectImpl::SetPolicyByClass() {
   if (!IsAttributePresent(CKA_CLASS)) {
     LOG(ERROR) << "Missing object class attribute.";
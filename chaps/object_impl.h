@@ -12,6 +12,7 @@
 #include <string>
 
 #include <base/macros.h>
+#include <base/synchronization/lock.h>
 
 #include "pkcs11/cryptoki.h"
 
@@ -52,6 +53,8 @@ class ObjectImpl : public Object {
   virtual void set_handle(int handle) {handle_ = handle;}
   virtual int store_id() const {return store_id_;}
   virtual void set_store_id(int store_id) {store_id_ = store_id;}
+  virtual std::shared_ptr<ObjectCache> GetCache() const;
+  virtual void SetCache(std::shared_ptr<ObjectCache> cache) const;
 
  private:
   ChapsFactory* factory_;
@@ -62,8 +65,13 @@ class ObjectImpl : public Object {
   std::unique_ptr<ObjectPolicy> policy_;
   int handle_;
   int store_id_;
+  // Protects |cache_|.
+  mutable base::Lock cache_lock_;
+  mutable std::shared_ptr<ObjectCache> cache_;
 
   bool SetPolicyByClass();
+  // Drops |cache_|. Called whenever |attributes_| changes.
+  void DropCache();
 
   DISALLOW_COPY_AND_ASSIGN(ObjectImpl);
 };
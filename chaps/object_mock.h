@@ -46,6 +46,8 @@ class ObjectMock : public Object {
   MOCK_METHOD1(set_handle, void(int));
   MOCK_CONST_METHOD0(store_id, int());
   MOCK_METHOD1(set_store_id, void(int));
+  MOCK_CONST_METHOD0(GetCache, std::shared_ptr<ObjectCache>());
+  MOCK_CONST_METHOD1(SetCache, void(std::shared_ptr<ObjectCache>));
 
   void SetupFake() {
     handle_ = 0;
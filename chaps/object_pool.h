@@ -60,6 +60,10 @@ class ObjectPool {
   // Imports an object from an external source. Like 'Insert', this method takes
   // ownership of the 'object' pointer on success.
   virtual bool Import(Object* object) = 0;
+  // Imports several objects with a single write to persistent storage. Either
+  // all objects are imported and this method takes ownership of them, or none
+  // are.
+  virtual bool ImportBatch(const std::vector<Object*>& objects) = 0;
   // Deletes an existing object.
   virtual bool Delete(const Object* object) = 0;
   // Deletes all existing objects.
@@ -0,0 +1,255 @@
+// Copyright 2016 The Chromium OS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// Measures ObjectPool::Find latency against the number of objects in the pool,
+// for templates that are answered from the attribute index and for one that
+// has to be matched against every object. Then measures the throughput of
+// lookups from several threads at once, with and without a thread that keeps
+// modifying objects.
+
+#include <stdio.h>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <base/at_exit.h>
+#include <base/logging.h>
+#include <base/strings/stringprintf.h>
+#include <base/synchronization/cancellation_flag.h>
+#include <base/threading/platform_thread.h>
+#include <base/time/time.h>
+
+#include "chaps/chaps_factory_impl.h"
+#include "chaps/handle_generator.h"
+#include "chaps/object.h"
+#include "chaps/object_pool.h"
+#include "chaps/object_store.h"
+#include "pkcs11/cryptoki.h"
+
+using base::PlatformThread;
+using base::PlatformThreadHandle;
+using base::StringPrintf;
+using base::TimeDelta;
+using base::TimeTicks;
+using std::string;
+using std::vector;
+
+namespace {
+
+const int kNumObjects[] = {100, 1000, 10000, 100000};
+const int kNumSearches = 1000;
+const int kNumThreads[] = {1, 2, 4, 8, 16};
+const int kNumStressObjects = 10000;
+const TimeDelta kStressDuration = TimeDelta::FromSeconds(2);
+
+class BenchmarkHandleGenerator : public chaps::HandleGenerator {
+ public:
+  BenchmarkHandleGenerator() : last_handle_(0) {}
+  int CreateHandle() { return ++last_handle_; }
+
+ private:
+  int last_handle_;
+};
+
+// Inserts |num_keys| public and private RSA key pairs.
+void InsertKeyPairs(chaps::ChapsFactory* factory,
+                    chaps::ObjectPool* pool,
+                    int num_keys) {
+  for (int i = 0; i < num_keys; ++i) {
+    const CK_OBJECT_CLASS kClasses[] = {CKO_PUBLIC_KEY, CKO_PRIVATE_KEY};
+    for (CK_OBJECT_CLASS object_class : kClasses) {
+      chaps::Object* object = factory->CreateObject();
+      object->SetAttributeInt(CKA_CLASS, object_class);
+      object->SetAttributeInt(CKA_KEY_TYPE, CKK_RSA);
+      object->SetAttributeBool(CKA_TOKEN, true);
+      object->SetAttributeBool(CKA_PRIVATE, object_class == CKO_PRIVATE_KEY);
+      object->SetAttributeString(CKA_ID, StringPrintf("id%d", i));
+      object->SetAttributeString(CKA_LABEL, StringPrintf("key%d", i));
+      object->SetAttributeString(CKA_MODULUS, string(256, 'm'));
+      CHECK(pool->Insert(object));
+    }
+  }
+}
+
+// Returns the mean latency in microseconds of a search for |key| with the
+// given attributes. Every search must find |expected_matches| objects.
+double MeasureFind(chaps::ChapsFactory* factory,
+                   chaps::ObjectPool* pool,
+                   int key,
+                   bool with_class,
+                   bool with_id,
+                   bool with_label,
+                   size_t expected_matches) {
+  std::unique_ptr<chaps::Object> search_template(factory->CreateObject());
+  if (with_class)
+    search_template->SetAttributeInt(CKA_CLASS, CKO_PRIVATE_KEY);
+  if (with_id)
+    search_template->SetAttributeString(CKA_ID, StringPrintf("id%d", key));
+  if (with_label)
+    search_template->SetAttributeString(CKA_LABEL, StringPrintf("key%d", key));
+  // Without any indexed attribute, every object has to be matched.
+  if (!with_class && !with_id && !with_label)
+    search_template->SetAttributeString(CKA_MODULUS, string(256, 'm'));
+  TimeTicks start = TimeTicks::Now();
+  for (int i = 0; i < kNumSearches; ++i) {
+    vector<const chaps::Object*> objects;
+    CHECK(pool->Find(search_template.get(), &objects));
+    CHECK_EQ(expected_matches, objects.size());
+  }
+  return (TimeTicks::Now() - start).InMicroseconds() /
+         static_cast<double>(kNumSearches);
+}
+
+// Looks objects up by id and by handle until |stop| is set.
+class LookupThread : public PlatformThread::Delegate {
+ public:
+  LookupThread(chaps::ChapsFactory* factory,
+               chaps::ObjectPool* pool,
+               int num_keys,
+               int seed,
+               const base::CancellationFlag* stop)
+      : factory_(factory),
+        pool_(pool),
+        num_keys_(num_keys),
+        seed_(seed),
+        stop_(stop),
+        num_lookups_(0) {}
+  void ThreadMain() {
+    std::unique_ptr<chaps::Object> search_template(factory_->CreateObject());
+    for (int key = seed_; !stop_->IsSet(); key = (key + 7) % num_keys_) {
+      search_template->SetAttributeString(CKA_ID, StringPrintf("id%d", key));
+      vector<const chaps::Object*> objects;
+      CHECK(pool_->Find(search_template.get(), &objects));
+      CHECK(!objects.empty());
+      const chaps::Object* object = NULL;
+      CHECK(pool_->FindByHandle(objects[0]->handle(), &object));
+      num_lookups_ += 2;
+    }
+  }
+  int num_lookups() const { return num_lookups_; }
+
+ private:
+  chaps::ChapsFactory* factory_;
+  chaps::ObjectPool* pool_;
+  int num_keys_;
+  int seed_;
+  const base::CancellationFlag* stop_;
+  int num_lookups_;
+};
+
+// Keeps modifying and flushing objects until |stop| is set.
+class UpdateThread : public PlatformThread::Delegate {
+ public:
+  UpdateThread(chaps::ObjectPool* pool,
+               const vector<const chaps::Object*>& objects,
+               const base::CancellationFlag* stop)
+      : pool_(pool), objects_(objects), stop_(stop) {}
+  void ThreadMain() {
+    for (size_t i = 0; !stop_->IsSet(); i = (i + 1) % objects_.size()) {
+      chaps::Object* object = pool_->GetModifiableObject(objects_[i]);
+      object->SetAttributeString(CKA_APPLICATION, StringPrintf("app%zu", i));
+      CHECK(pool_->Flush(object));
+    }
+  }
+
+ private:
+  chaps::ObjectPool* pool_;
+  const vector<const chaps::Object*>& objects_;
+  const base::CancellationFlag* stop_;
+};
+
+// Returns the number of lookups per second from |num_threads| threads, while
+// an update thread runs if |with_updates|.
+double MeasureLookups(chaps::ChapsFactory* factory,
+                      chaps::ObjectPool* pool,
+                      int num_keys,
+                      int num_threads,
+                      bool with_updates) {
+  // Only data objects are modified. Lookups by id never match them, so lookup
+  // threads never read an object while it changes.
+  std::unique_ptr<chaps::Object> find_data(factory->CreateObject());
+  find_data->SetAttributeInt(CKA_CLASS, CKO_DATA);
+  vector<const chaps::Object*> data_objects;
+  CHECK(pool->Find(find_data.get(), &data_objects));
+
+  base::CancellationFlag stop;
+  TimeTicks start = TimeTicks::Now();
+  vector<std::unique_ptr<LookupThread>> threads;
+  vector<PlatformThreadHandle> handles(num_threads);
+  for (int i = 0; i < num_threads; ++i) {
+    threads.emplace_back(
+        new LookupThread(factory, pool, num_keys, i * num_keys / num_threads,
+                         &stop));
+    CHECK(PlatformThread::Create(0, threads[i].get(), &handles[i]));
+  }
+  std::unique_ptr<UpdateThread> update_thread;
+  PlatformThreadHandle update_handle;
+  if (with_updates) {
+    update_thread.reset(new UpdateThread(pool, data_objects, &stop));
+    CHECK(PlatformThread::Create(0, update_thread.get(), &update_handle));
+  }
+
+  PlatformThread::Sleep(kStressDuration);
+  stop.Set();
+  int num_lookups = 0;
+  for (int i = 0; i < num_threads; ++i) {
+    PlatformThread::Join(handles[i]);
+    num_lookups += threads[i]->num_lookups();
+  }
+  double elapsed = (TimeTicks::Now() - start).InSecondsF();
+  if (with_updates)
+    PlatformThread::Join(update_handle);
+  return num_lookups / elapsed;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  base::AtExitManager at_exit;
+  std::shared_ptr<chaps::ChapsFactoryImpl> factory =
+      std::make_shared<chaps::ChapsFactoryImpl>();
+
+  printf("%10s %14s %14s %14s %14s\n", "objects", "id us",
+         "class+label us", "class us", "unindexed us");
+  for (int num_objects : kNumObjects) {
+    std::unique_ptr<chaps::ObjectPool> pool(factory->CreateObjectPool(
+        std::make_shared<BenchmarkHandleGenerator>(),
+        std::unique_ptr<chaps::ObjectStore>()));
+    CHECK(pool);
+    int num_keys = num_objects / 2;
+    InsertKeyPairs(factory.get(), pool.get(), num_keys);
+    int key = num_keys / 2;
+    printf("%10d %14.2f %14.2f %14.2f %14.2f\n", num_objects,
+           MeasureFind(factory.get(), pool.get(), key, false, true, false, 2),
+           MeasureFind(factory.get(), pool.get(), key, true, false, true, 1),
+           MeasureFind(factory.get(), pool.get(), key, true, false, false,
+                       num_keys),
+           MeasureFind(factory.get(), pool.get(), key, false, false, false,
+                       num_objects));
+  }
+
+  std::unique_ptr<chaps::ObjectPool> pool(factory->CreateObjectPool(
+      std::make_shared<BenchmarkHandleGenerator>(),
+      std::unique_ptr<chaps::ObjectStore>()));
+  CHECK(pool);
+  int num_keys = kNumStressObjects / 2;
+  InsertKeyPairs(factory.get(), pool.get(), num_keys);
+  for (int i = 0; i < num_keys; ++i) {
+    chaps::Object* object = factory->CreateObject();
+    object->SetAttributeInt(CKA_CLASS, CKO_DATA);
+    object->SetAttributeBool(CKA_TOKEN, true);
+    object->SetAttributeString(CKA_LABEL, StringPrintf("data%d", i));
+    CHECK(pool->Insert(object));
+  }
+  printf("\n%10s %14s %14s\n", "threads", "lookups/s", "w/ updates");
+  for (int num_threads : kNumThreads) {
+    printf("%10d %14.0f %14.0f\n", num_threads,
+           MeasureLookups(factory.get(), pool.get(), num_keys, num_threads,
+                          false),
+           MeasureLookups(factory.get(), pool.get(), num_keys, num_threads,
+                          true));
+  }
+  return 0;
+}
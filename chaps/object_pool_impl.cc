@@ -10,7 +10,6 @@
 #include <vector>
 
 #include <base/logging.h>
-#include <base/synchronization/lock.h>
 #include <base/synchronization/waitable_event.h>
 
 #include "chaps/chaps.h"
@@ -20,9 +19,8 @@
 #include "chaps/object.h"
 #include "chaps/object_store.h"
 #include "chaps/proto_bindings/attributes.pb.h"
+#include "chaps/read_write_lock.h"
 
-using base::AutoLock;
-using base::AutoUnlock;
 using brillo::SecureBlob;
 using std::map;
 using std::string;
@@ -31,6 +29,18 @@ using std::vector;
 
 namespace chaps {
 
+namespace {
+
+// The attributes that applications commonly search for objects by.
+const CK_ATTRIBUTE_TYPE kIndexedAttributes[] = {
+  CKA_CLASS,
+  CKA_KEY_TYPE,
+  CKA_ID,
+  CKA_LABEL
+};
+
+}  // namespace
+
 ObjectPoolImpl::ObjectPoolImpl(std::shared_ptr<ChapsFactory> factory,
                                std::shared_ptr<HandleGenerator> handle_generator,
                                std::unique_ptr<ObjectStore> store)
@@ -47,14 +57,14 @@ ObjectPoolImpl::ObjectPoolImpl(std::shared_ptr<ChapsFactory> factory,
 ObjectPoolImpl::~ObjectPoolImpl() {}
 
 bool ObjectPoolImpl::Init() {
-  AutoLock lock(lock_);
+  AutoWriteLock lock(lock_);
   if (store_.get()) {
     if (!LoadPublicObjects())
       return false;
     // Import legacy objects. The existence of the 'imported' blob indicates
     // that legacy objects have already been imported. The contents of this blob
     // are ignored.
-    AutoUnlock unlock(lock_);
+    AutoWriteUnlock unlock(lock_);
     string imported_blob;
   } else {
     // There are no objects to load.
@@ -65,21 +75,21 @@ bool ObjectPoolImpl::Init() {
 }
 
 bool ObjectPoolImpl::GetInternalBlob(int blob_id, string* blob) {
-  AutoLock lock(lock_);
+  AutoWriteLock lock(lock_);
   if (store_.get())
     return store_->GetInternalBlob(blob_id, blob);
   return false;
 }
 
 bool ObjectPoolImpl::SetInternalBlob(int blob_id, const string& blob) {
-  AutoLock lock(lock_);
+  AutoWriteLock lock(lock_);
   if (store_.get())
     return store_->SetInternalBlob(blob_id, blob);
   return false;
 }
 
 bool ObjectPoolImpl::SetEncryptionKey(const SecureBlob& key) {
-  AutoLock lock(lock_);
+  AutoWriteLock lock(lock_);
   if (key.empty())
     LOG(WARNING) << "WARNING: Private object services will not be available.";
   if (store_.get() && !key.empty()) {
@@ -98,15 +108,13 @@ bool ObjectPoolImpl::SetEncryptionKey(const SecureBlob& key) {
 bool ObjectPoolImpl::Insert(Object* object) {
   // If it's a private object we need to wait until private objects have been
   // loaded.
-  if (object->IsPrivate() && !is_private_loaded_) {
-    AutoLock lock(lock_);
+  if (object->IsPrivate())
     WaitForPrivateObjects();
-  }
   return Import(object);
 }
 
 bool ObjectPoolImpl::Import(Object* object) {
-  AutoLock lock(lock_);
+  AutoWriteLock lock(lock_);
   if (objects_.find(object) != objects_.end())
     return false;
   if (store_.get()) {
@@ -126,30 +134,67 @@ bool ObjectPoolImpl::Import(Object* object) {
   object->set_handle(handle_generator_->CreateHandle());
   objects_.insert(object);
   handle_object_map_[object->handle()] = shared_ptr<const Object>(object);
+  AddToIndex(object);
+  return true;
+}
+
+bool ObjectPoolImpl::ImportBatch(const vector<Object*>& objects) {
+  AutoWriteLock lock(lock_);
+  for (size_t i = 0; i < objects.size(); ++i) {
+    if (objects_.find(objects[i]) != objects_.end())
+      return false;
+  }
+  if (store_.get()) {
+    vector<ObjectBlob> serialized(objects.size());
+    for (size_t i = 0; i < objects.size(); ++i) {
+      if (!Serialize(objects[i], &serialized[i]))
+        return false;
+      // Normalizes the object attribute values, see Import().
+      if (!Parse(serialized[i], objects[i]))
+        return false;
+    }
+    vector<int> store_ids;
+    if (!store_->InsertObjectBlobs(serialized, &store_ids))
+      return false;
+    for (size_t i = 0; i < objects.size(); ++i)
+      objects[i]->set_store_id(store_ids[i]);
+  }
+  for (size_t i = 0; i < objects.size(); ++i) {
+    Object* object = objects[i];
+    object->set_handle(handle_generator_->CreateHandle());
+    objects_.insert(object);
+    handle_object_map_[object->handle()] = shared_ptr<const Object>(object);
+    AddToIndex(object);
+  }
   return true;
 }
 
 bool ObjectPoolImpl::Delete(const Object* object) {
-  AutoLock lock(lock_);
+  AutoWriteLock lock(lock_);
   if (objects_.find(object) == objects_.end())
     return false;
   if (store_.get()) {
     // If it's a private object we need to wait until private objects have been
     // loaded.
-    if (object->IsPrivate() && !is_private_loaded_)
+    if (object->IsPrivate() && !is_private_loaded_) {
+      AutoWriteUnlock unlock(lock_);
       WaitForPrivateObjects();
+    }
     if (!store_->DeleteObjectBlob(object->store_id()))
       return false;
   }
+  RemoveFromIndex(object);
   handle_object_map_.erase(object->handle());
   objects_.erase(object);
   return true;
 }
 
 bool ObjectPoolImpl::DeleteAll() {
-  AutoLock lock(lock_);
+  AutoWriteLock lock(lock_);
   objects_.clear();
   handle_object_map_.clear();
+  attribute_index_.clear();
+  indexed_values_.clear();
   if (store_.get())
     return store_->DeleteAllObjectBlobs();
   return true;
@@ -157,16 +202,19 @@ bool ObjectPoolImpl::DeleteAll() {
 
 bool ObjectPoolImpl::Find(const Object* search_template,
                           vector<const Object*>* matching_objects) {
-  AutoLock lock(lock_);
   // If we're looking for private objects we need to wait until private objects
   // have been loaded.
-  if (((search_template->IsAttributePresent(CKA_PRIVATE) &&
+  if ((search_template->IsAttributePresent(CKA_PRIVATE) &&
       search_template->IsPrivate()) ||
       (search_template->IsAttributePresent(CKA_CLASS) &&
-      search_template->GetObjectClass() == CKO_PRIVATE_KEY)) &&
-      !is_private_loaded_)
+      search_template->GetObjectClass() == CKO_PRIVATE_KEY))
     WaitForPrivateObjects();
-  for (ObjectSet::iterator it = objects_.begin(); it != objects_.end(); ++it) {
+  AutoReadLock lock(lock_);
+  const ObjectSet* candidates = GetCandidates(search_template);
+  if (!candidates)
+    return true;
+  for (ObjectSet::const_iterator it = candidates->begin();
+       it != candidates->end(); ++it) {
     if (Matches(search_template, *it))
       matching_objects->push_back(*it);
   }
@@ -174,7 +222,7 @@ bool ObjectPoolImpl::Find(const Object* search_template,
 }
 
 bool ObjectPoolImpl::FindByHandle(int handle, const Object** object) {
-  AutoLock lock(lock_);
+  AutoReadLock lock(lock_);
   CHECK(object);
   HandleObjectMap::iterator it = handle_object_map_.find(handle);
   if (it == handle_object_map_.end())
@@ -188,17 +236,23 @@ Object* ObjectPoolImpl::GetModifiableObject(const Object* object) {
 }
 
 bool ObjectPoolImpl::Flush(const Object* object) {
-  AutoLock lock(lock_);
+  AutoWriteLock lock(lock_);
   if (objects_.find(object) == objects_.end())
     return false;
+  // The object has been modified in place, whether or not the store update
+  // below succeeds.
+  RemoveFromIndex(object);
+  AddToIndex(object);
   if (store_.get()) {
     ObjectBlob serialized;
     if (!Serialize(object, &serialized))
       return false;
     // If it's a private object we need to wait until private objects have been
     // loaded.
-    if (object->IsPrivate() && !is_private_loaded_)
+    if (object->IsPrivate() && !is_private_loaded_) {
+      AutoWriteUnlock unlock(lock_);
       WaitForPrivateObjects();
+    }
     if (!store_->UpdateObjectBlob(object->store_id(), serialized))
       return false;
   }
@@ -276,6 +330,7 @@ bool ObjectPoolImpl::LoadBlobs(const map<int, ObjectBlob>& object_blobs) {
       object->set_store_id(it->first);
       objects_.insert(object.get());
       handle_object_map_[object->handle()] = object;
+      AddToIndex(object.get());
     } else {
       LOG(WARNING) << "Object not parsable: " << it->first;
     }
@@ -300,10 +355,54 @@ bool ObjectPoolImpl::LoadPrivateObjects() {
 }
 
 void ObjectPoolImpl::WaitForPrivateObjects() {
-  AutoUnlock unlock(lock_);
+  if (private_loaded_event_.IsSignaled())
+    return;
   LOG(INFO) << "Waiting for private objects to be loaded.";
   private_loaded_event_.Wait();
   LOG(INFO) << "Done waiting for private objects.";
 }
 
+void ObjectPoolImpl::AddToIndex(const Object* object) {
+  vector<AttributeValue>& values = indexed_values_[object];
+  for (CK_ATTRIBUTE_TYPE type : kIndexedAttributes) {
+    if (!object->IsAttributePresent(type))
+      continue;
+    AttributeValue value(type, object->GetAttributeString(type));
+    attribute_index_[value].insert(object);
+    values.push_back(value);
+  }
+}
+
+void ObjectPoolImpl::RemoveFromIndex(const Object* object) {
+  map<const Object*, vector<AttributeValue>>::iterator it =
+      indexed_values_.find(object);
+  if (it == indexed_values_.end())
+    return;
+  for (const AttributeValue& value : it->second) {
+    AttributeIndex::iterator index_it = attribute_index_.find(value);
+    if (index_it == attribute_index_.end())
+      continue;
+    index_it->second.erase(object);
+    if (index_it->second.empty())
+      attribute_index_.erase(index_it);
+  }
+  indexed_values_.erase(it);
+}
+
+const ObjectSet* ObjectPoolImpl::GetCandidates(const Object* search_template) {
+  const ObjectSet* candidates = &objects_;
+  for (CK_ATTRIBUTE_TYPE type : kIndexedAttributes) {
+    if (!search_template->IsAttributePresent(type))
+      continue;
+    AttributeIndex::const_iterator it = attribute_index_.find(
+        AttributeValue(type, search_template->GetAttributeString(type)));
+    // No object holds this value, so none can match.
+    if (it == attribute_index_.end())
+      return NULL;
+    if (it->second.size() < candidates->size())
+      candidates = &it->second;
+  }
+  return candidates;
+}
+
 }  // namespace chaps
@@ -11,13 +11,15 @@
 #include <memory>
 #include <set>
 #include <string>
+#include <utility>
 #include <vector>
 
 #include <base/macros.h>
-#include <base/synchronization/lock.h>
 #include <base/synchronization/waitable_event.h>
 
 #include "chaps/object_store.h"
+#include "chaps/read_write_lock.h"
+#include "pkcs11/cryptoki.h"
 
 namespace chaps {
 
@@ -28,6 +30,11 @@ class HandleGenerator;
 // Value: Object shared pointer.
 typedef std::map<int, std::shared_ptr<const Object>> HandleObjectMap;
 typedef std::set<const Object*> ObjectSet;
+// An attribute type and one of its values.
+typedef std::pair<CK_ATTRIBUTE_TYPE, std::string> AttributeValue;
+// Key: The value of an indexed attribute.
+// Value: The objects that hold that value.
+typedef std::map<AttributeValue, ObjectSet> AttributeIndex;
 
 class ObjectPoolImpl : public ObjectPool {
  public:
@@ -45,6 +52,7 @@ class ObjectPoolImpl : public ObjectPool {
   virtual bool SetEncryptionKey(const brillo::SecureBlob& key);
   virtual bool Insert(Object* object);
   virtual bool Import(Object* object);
+  virtual bool ImportBatch(const std::vector<Object*>& objects);
   virtual bool Delete(const Object* object);
   virtual bool DeleteAll();
   virtual bool Find(const Object* search_template,
@@ -63,16 +71,35 @@ class ObjectPoolImpl : public ObjectPool {
   bool LoadBlobs(const std::map<int, ObjectBlob>& object_blobs);
   bool LoadPublicObjects();
   bool LoadPrivateObjects();
+  // Blocks until private objects have been loaded. Must be called without
+  // |lock_| held, since loading them needs it.
   void WaitForPrivateObjects();
+  // Adds |object| to |attribute_index_| under the values it holds for the
+  // indexed attributes, or removes it again.
+  void AddToIndex(const Object* object);
+  void RemoveFromIndex(const Object* object);
+  // Returns the objects that may match |search_template|: those indexed under
+  // the template value of the most selective indexed attribute, or all objects
+  // if the template has no indexed attributes.
+  const ObjectSet* GetCandidates(const Object* search_template);
 
   // Allows us to quickly check whether an object exists in the pool.
   ObjectSet objects_;
+  // Lets Find() avoid matching every object against templates that hold one
+  // of the commonly searched attributes. Objects are re-indexed when they are
+  // flushed, so a modified object must be flushed before it is searched for.
+  AttributeIndex attribute_index_;
+  // Key: An object in the pool.
+  // Value: The indexed attribute values it was indexed under.
+  std::map<const Object*, std::vector<AttributeValue>> indexed_values_;
   HandleObjectMap handle_object_map_;
   std::shared_ptr<ChapsFactory> factory_;
   std::shared_ptr<HandleGenerator> handle_generator_;
   std::unique_ptr<ObjectStore> store_;
   bool is_private_loaded_;
-  base::Lock lock_;
+  // Held for reading by lookups, which may run concurrently, and for writing
+  // by everything that changes the pool or uses the store.
+  ReadWriteLock lock_;
   base::WaitableEvent private_loaded_event_;
 
   DISALLOW_COPY_AND_ASSIGN(ObjectPoolImpl);
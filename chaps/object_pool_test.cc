@@ -278,6 +278,56 @@ TEST_F(TestObjectPool, DeleteAll) {
   EXPECT_EQ(0, v.size());
 }
 
+// Test searches by indexed attributes, and that the index follows updates.
+TEST_F(TestObjectPool, FindIndexed) {
+  for (int i = 0; i < 3; ++i) {
+    Object* o = CreateObjectMock();
+    o->SetAttributeInt(CKA_CLASS, i == 0 ? CKO_PUBLIC_KEY : CKO_PRIVATE_KEY);
+    o->SetAttributeString(CKA_ID, i == 2 ? "id2" : "id1");
+    o->SetAttributeString(CKA_APPLICATION, "app");
+    EXPECT_TRUE(pool2_->Insert(o));
+  }
+  vector<const Object*> v;
+  std::unique_ptr<Object> find_id(CreateObjectMock());
+  find_id->SetAttributeString(CKA_ID, "id1");
+  EXPECT_TRUE(pool2_->Find(find_id.get(), &v));
+  EXPECT_EQ(2, v.size());
+  // Templates with several indexed attributes, or with attributes that are not
+  // indexed, still match all of them.
+  find_id->SetAttributeInt(CKA_CLASS, CKO_PRIVATE_KEY);
+  find_id->SetAttributeString(CKA_APPLICATION, "app");
+  v.clear();
+  EXPECT_TRUE(pool2_->Find(find_id.get(), &v));
+  ASSERT_EQ(1, v.size());
+  std::unique_ptr<Object> find_app(CreateObjectMock());
+  find_app->SetAttributeString(CKA_APPLICATION, "app");
+  v.clear();
+  EXPECT_TRUE(pool2_->Find(find_app.get(), &v));
+  EXPECT_EQ(3, v.size());
+  std::unique_ptr<Object> find_unknown(CreateObjectMock());
+  find_unknown->SetAttributeString(CKA_LABEL, "unknown");
+  v.clear();
+  EXPECT_TRUE(pool2_->Find(find_unknown.get(), &v));
+  EXPECT_EQ(0, v.size());
+  // Modify the object found by id, then search by its old and new values.
+  v.clear();
+  EXPECT_TRUE(pool2_->Find(find_id.get(), &v));
+  ASSERT_EQ(1, v.size());
+  Object* o = pool2_->GetModifiableObject(v[0]);
+  o->SetAttributeString(CKA_ID, "id3");
+  EXPECT_TRUE(pool2_->Flush(o));
+  v.clear();
+  EXPECT_TRUE(pool2_->Find(find_id.get(), &v));
+  EXPECT_EQ(0, v.size());
+  find_id->SetAttributeString(CKA_ID, "id3");
+  EXPECT_TRUE(pool2_->Find(find_id.get(), &v));
+  ASSERT_EQ(1, v.size());
+  EXPECT_TRUE(pool2_->Delete(v[0]));
+  v.clear();
+  EXPECT_TRUE(pool2_->Find(find_id.get(), &v));
+  EXPECT_EQ(0, v.size());
+}
+
 }  // namespace chaps
 
 int main(int argc, char** argv) {
@@ -0,0 +1,101 @@
+// Copyright 2016 The Chromium OS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// Measures how long a token with thousands of objects takes to store, load
+// and delete with ObjectStoreImpl on disk. Objects are inserted both one at a
+// time and in a single batch.
+
+#include <stdio.h>
+
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <base/at_exit.h>
+#include <base/files/file_path.h>
+#include <base/files/scoped_temp_dir.h>
+#include <base/logging.h>
+#include <base/sys_info.h>
+#include <base/time/time.h>
+#include <brillo/secure_blob.h>
+
+#include "chaps/object_store_impl.h"
+
+using base::TimeTicks;
+using brillo::SecureBlob;
+using std::map;
+using std::string;
+using std::vector;
+
+namespace {
+
+const int kNumObjects[] = {1000, 4000};
+// About the size of a serialized RSA-2048 private key object.
+const size_t kBlobSize = 1500;
+
+// Creates a store in a new directory under |temp_dir|.
+std::unique_ptr<chaps::ObjectStoreImpl> CreateStore(
+    const base::ScopedTempDir& temp_dir, const string& name) {
+  std::unique_ptr<chaps::ObjectStoreImpl> store(new chaps::ObjectStoreImpl());
+  CHECK(store->Init(temp_dir.path().Append(name)));
+  string key(32, 'k');
+  CHECK(store->SetEncryptionKey(SecureBlob(key.begin(), key.end())));
+  return store;
+}
+
+double MillisecondsSince(TimeTicks start) {
+  return (TimeTicks::Now() - start).InMillisecondsF();
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  base::AtExitManager at_exit;
+  base::ScopedTempDir temp_dir;
+  CHECK(temp_dir.CreateUniqueTempDir());
+
+  printf("%d processors\n", base::SysInfo::NumberOfProcessors());
+  printf("%10s %14s %14s %14s %14s\n", "objects", "insert ms",
+         "batch ins. ms", "load ms", "delete all ms");
+  for (int num_objects : kNumObjects) {
+    vector<chaps::ObjectBlob> blobs(num_objects);
+    for (int i = 0; i < num_objects; ++i) {
+      blobs[i].blob = string(kBlobSize, static_cast<char>(i));
+      blobs[i].is_private = true;
+    }
+
+    std::unique_ptr<chaps::ObjectStoreImpl> store =
+        CreateStore(temp_dir, "single" + std::to_string(num_objects));
+    TimeTicks start = TimeTicks::Now();
+    for (int i = 0; i < num_objects; ++i) {
+      int handle = 0;
+      CHECK(store->InsertObjectBlob(blobs[i], &handle));
+    }
+    double insert_ms = MillisecondsSince(start);
+
+    store = CreateStore(temp_dir, "batch" + std::to_string(num_objects));
+    start = TimeTicks::Now();
+    vector<int> handles;
+    CHECK(store->InsertObjectBlobs(blobs, &handles));
+    double batch_insert_ms = MillisecondsSince(start);
+
+    // Load the token the way login does, with a freshly opened store.
+    store.reset();
+    store = CreateStore(temp_dir, "batch" + std::to_string(num_objects));
+    start = TimeTicks::Now();
+    map<int, chaps::ObjectBlob> loaded;
+    CHECK(store->LoadPrivateObjectBlobs(&loaded));
+    double load_ms = MillisecondsSince(start);
+    CHECK_EQ(static_cast<size_t>(num_objects), loaded.size());
+
+    start = TimeTicks::Now();
+    CHECK(store->DeleteAllObjectBlobs());
+    double delete_ms = MillisecondsSince(start);
+
+    printf("%10d %14.1f %14.1f %14.1f %14.1f\n", num_objects, insert_ms,
+           batch_insert_ms, load_ms, delete_ms);
+  }
+  return 0;
+}
@@ -9,6 +9,7 @@
 
 #include <map>
 #include <string>
+#include <vector>
 
 namespace chaps {
 
@@ -36,6 +37,14 @@ class ObjectStoreFake : public ObjectStore {
     object_blobs_[*handle] = blob;
     return true;
   }
+  virtual bool InsertObjectBlobs(const std::vector<ObjectBlob>& blobs,
+                                 std::vector<int>* handles) {
+    for (size_t i = 0; i < blobs.size(); ++i) {
+      handles->push_back(++last_handle_);
+      object_blobs_[last_handle_] = blobs[i];
+    }
+    return true;
+  }
   virtual bool DeleteObjectBlob(int handle) {
     object_blobs_.erase(handle);
     return true;
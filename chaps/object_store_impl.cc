@@ -4,20 +4,26 @@
 
 #include "chaps/object_store_impl.h"
 
+#include <algorithm>
 #include <limits>
 #include <map>
 #include <string>
+#include <utility>
 #include <vector>
 
+#include <base/bind.h>
 #include <base/files/file_util.h>
 #include <base/logging.h>
 #include <base/strings/string_number_conversions.h>
 #include <base/strings/string_piece.h>
 #include <base/strings/string_util.h>
 #include <base/strings/stringprintf.h>
+#include <base/sys_info.h>
+#include <base/threading/platform_thread.h>
 #include <brillo/secure_blob.h>
 #include <leveldb/db.h>
 #include <leveldb/env.h>
+#include <leveldb/write_batch.h>
 #ifndef NO_MEMENV
 #include <leveldb/helpers/memenv.h>
 #endif
@@ -26,9 +32,12 @@
 #endif
 
 #include "chaps/chaps_utility.h"
+#include "chaps/latency_stats.h"
 #include "pkcs11/cryptoki.h"
 
 using base::FilePath;
+using base::PlatformThread;
+using base::PlatformThreadHandle;
 using brillo::SecureBlob;
 using std::map;
 using std::string;
@@ -36,6 +45,8 @@ using std::vector;
 
 namespace {
 
+const char kLatencyCategory[] = "ObjectStore";
+
 // Encapsulate UMA event generation.
 class MetricsWrapper {
  public:
@@ -59,6 +70,16 @@ class MetricsWrapper {
 #endif
 };
 
+// Runs a closure on a thread of its own.
+class ClosureThread : public PlatformThread::Delegate {
+ public:
+  explicit ClosureThread(const base::Closure& closure) : closure_(closure) {}
+  void ThreadMain() { closure_.Run(); }
+
+ private:
+  base::Closure closure_;
+};
+
 }  // namespace
 
 namespace chaps {
@@ -79,6 +100,8 @@ const char ObjectStoreImpl::kObfuscationKey[] = {
     '\x14', '\x9c', '\xae', '\x57', '\xfb', '\x04', '\x13', '\x92', '\xc0',
     '\x84', '\x2a', '\xea', '\xf6', '\xfb'};
 const int ObjectStoreImpl::kBlobVersion = 1;
+const size_t ObjectStoreImpl::kMinBlobsPerDecryptThread = 16;
+const int ObjectStoreImpl::kMaxDecryptThreads = 8;
 
 ObjectStoreImpl::ObjectStoreImpl() {}
 
@@ -194,6 +217,47 @@ bool ObjectStoreImpl::InsertObjectBlob(const ObjectBlob& blob,
   return UpdateObjectBlob(*handle, blob);
 }
 
+bool ObjectStoreImpl::InsertObjectBlobs(const vector<ObjectBlob>& blobs,
+                                        vector<int>* handles) {
+  if (blobs.empty())
+    return true;
+  int first_id = 0;
+  if (!ReadInt(kIDTrackerKey, &first_id)) {
+    LOG(ERROR) << "Failed to read ID tracker.";
+    return false;
+  }
+  if (std::numeric_limits<int>::max() - first_id <
+      static_cast<int>(blobs.size())) {
+    LOG(ERROR) << "Object ID overflow.";
+    return false;
+  }
+  // The ID tracker and all blobs are written together, so that a failure
+  // leaves the database as it was.
+  leveldb::WriteBatch batch;
+  for (size_t i = 0; i < blobs.size(); ++i) {
+    ObjectBlob encrypted_blob;
+    if (!Encrypt(blobs[i], &encrypted_blob)) {
+      LOG(ERROR) << "Failed to encrypt object blob.";
+      return false;
+    }
+    BlobType type = blobs[i].is_private ? kPrivate : kPublic;
+    batch.Put(CreateBlobKey(type, first_id + static_cast<int>(i)),
+              encrypted_blob.blob);
+  }
+  batch.Put(kIDTrackerKey,
+            base::IntToString(first_id + static_cast<int>(blobs.size())));
+  if (!CommitBatch(&batch)) {
+    LOG(ERROR) << "Failed to write object blobs.";
+    return false;
+  }
+  for (size_t i = 0; i < blobs.size(); ++i) {
+    int id = first_id + static_cast<int>(i);
+    blob_type_map_[id] = blobs[i].is_private ? kPrivate : kPublic;
+    handles->push_back(id);
+  }
+  return true;
+}
+
 bool ObjectStoreImpl::DeleteObjectBlob(int handle) {
   leveldb::WriteOptions options;
   options.sync = true;
@@ -216,17 +280,14 @@ bool ObjectStoreImpl::DeleteAllObjectBlobs() {
     if (ParseBlobKey(it->key().ToString(), &type, &id) && type != kInternal)
       blobs_to_delete.push_back(it->key().ToString());
   }
-  bool deleted_all = true;
-  for (size_t i = 0; i < blobs_to_delete.size(); ++i) {
-    leveldb::WriteOptions options;
-    options.sync = true;
-    leveldb::Status status = db_->Delete(options, blobs_to_delete[i]);
-    if (!status.ok()) {
-      LOG(ERROR) << "Failed to delete blob: " << status.ToString();
-      deleted_all = false;
-    }
+  leveldb::WriteBatch batch;
+  for (size_t i = 0; i < blobs_to_delete.size(); ++i)
+    batch.Delete(blobs_to_delete[i]);
+  if (!CommitBatch(&batch)) {
+    LOG(ERROR) << "Failed to delete blobs.";
+    return false;
   }
-  return deleted_all;
+  return true;
 }
 
 bool ObjectStoreImpl::UpdateObjectBlob(int handle, const ObjectBlob& blob) {
@@ -260,27 +321,81 @@ bool ObjectStoreImpl::LoadPrivateObjectBlobs(map<int, ObjectBlob>* blobs) {
 
 bool ObjectStoreImpl::LoadObjectBlobs(BlobType type,
                                       map<int, ObjectBlob>* blobs) {
+  ScopedLatency latency(kLatencyCategory, __func__);
+  vector<BlobToDecrypt> blobs_to_decrypt;
   std::unique_ptr<leveldb::Iterator>
       it(db_->NewIterator(leveldb::ReadOptions()));
   for (it->SeekToFirst(); it->Valid(); it->Next()) {
     BlobType it_type;
     int id = 0;
     if (ParseBlobKey(it->key().ToString(), &it_type, &id) && type == it_type) {
-      ObjectBlob encrypted_blob;
-      encrypted_blob.is_private = (type == kPrivate);
-      encrypted_blob.blob = it->value().ToString();
-      ObjectBlob blob;
-      if (!Decrypt(encrypted_blob, &blob)) {
-        LOG(WARNING) << "Failed to decrypt object blob.";
-        continue;
-      }
-      (*blobs)[id] = blob;
-      blob_type_map_[id] = type;
+      BlobToDecrypt blob;
+      blob.id = id;
+      blob.encrypted_blob.is_private = (type == kPrivate);
+      blob.encrypted_blob.blob = it->value().ToString();
+      blob.is_decrypted = false;
+      blobs_to_decrypt.push_back(blob);
+    }
+  }
+
+  // Decryption and HMAC verification dominate the load time of large tokens,
+  // and each blob is independent, so spread them over several threads. The
+  // shares are fixed before any thread starts; this thread decrypts the first
+  // share and those of any threads that fail to start.
+  const size_t num_shares = std::max<size_t>(
+      std::min<size_t>(GetMaxDecryptThreads(),
+                       blobs_to_decrypt.size() / kMinBlobsPerDecryptThread),
+      1);
+  vector<std::unique_ptr<ClosureThread>> threads;
+  vector<PlatformThreadHandle> handles;
+  vector<size_t> local_shares(1, 0);
+  for (size_t share = 1; share < num_shares; ++share) {
+    std::unique_ptr<ClosureThread> thread(new ClosureThread(
+        base::Bind(&ObjectStoreImpl::DecryptBlobs, base::Unretained(this),
+                   &blobs_to_decrypt, share, num_shares)));
+    PlatformThreadHandle handle;
+    if (!CreateDecryptThread(thread.get(), &handle)) {
+      LOG(WARNING) << "Failed to create a decryption thread.";
+      local_shares.push_back(share);
+      continue;
+    }
+    threads.push_back(std::move(thread));
+    handles.push_back(handle);
+  }
+  for (size_t i = 0; i < local_shares.size(); ++i)
+    DecryptBlobs(&blobs_to_decrypt, local_shares[i], num_shares);
+  for (size_t i = 0; i < handles.size(); ++i)
+    PlatformThread::Join(handles[i]);
+
+  for (size_t i = 0; i < blobs_to_decrypt.size(); ++i) {
+    if (!blobs_to_decrypt[i].is_decrypted) {
+      LOG(WARNING) << "Failed to decrypt object blob.";
+      continue;
     }
+    (*blobs)[blobs_to_decrypt[i].id] = blobs_to_decrypt[i].blob;
+    blob_type_map_[blobs_to_decrypt[i].id] = type;
   }
   return true;
 }
 
+int ObjectStoreImpl::GetMaxDecryptThreads() {
+  return std::min(base::SysInfo::NumberOfProcessors(), kMaxDecryptThreads);
+}
+
+bool ObjectStoreImpl::CreateDecryptThread(PlatformThread::Delegate* delegate,
+                                          PlatformThreadHandle* handle) {
+  return PlatformThread::Create(0, delegate, handle);
+}
+
+void ObjectStoreImpl::DecryptBlobs(vector<BlobToDecrypt>* blobs,
+                                   size_t share,
+                                   size_t num_shares) {
+  for (size_t i = share; i < blobs->size(); i += num_shares) {
+    BlobToDecrypt& blob = (*blobs)[i];
+    blob.is_decrypted = Decrypt(blob.encrypted_blob, &blob.blob);
+  }
+}
+
 bool ObjectStoreImpl::Encrypt(const ObjectBlob& plain_text,
                               ObjectBlob* cipher_text) {
   if (plain_text.is_private && key_.empty()) {
@@ -415,7 +530,9 @@ bool ObjectStoreImpl::GetNextID(int* next_id) {
 }
 
 bool ObjectStoreImpl::ReadBlob(const string& key, string* value) {
+  ScopedLatency latency(kLatencyCategory, __func__);
   leveldb::Status status = db_->Get(leveldb::ReadOptions(), key, value);
+  latency.set_success(status.ok() || status.IsNotFound());
   if (!status.ok()) {
     if (!status.IsNotFound())
       LOG(ERROR) << "Failed to read value from database: " << status.ToString();
@@ -436,9 +553,11 @@ bool ObjectStoreImpl::ReadInt(const string& key, int* value) {
 }
 
 bool ObjectStoreImpl::WriteBlob(const string& key, const string& value) {
+  ScopedLatency latency(kLatencyCategory, __func__);
   leveldb::WriteOptions options;
   options.sync = true;
   leveldb::Status status = db_->Put(options, key, value);
+  latency.set_success(status.ok());
   if (!status.ok()) {
     LOG(ERROR) << "Failed to write value to database: " << status.ToString();
     return false;
@@ -450,6 +569,19 @@ bool ObjectStoreImpl::WriteInt(const string& key, int value) {
   return WriteBlob(key, base::IntToString(value));
 }
 
+bool ObjectStoreImpl::CommitBatch(leveldb::WriteBatch* batch) {
+  ScopedLatency latency(kLatencyCategory, __func__);
+  leveldb::WriteOptions options;
+  options.sync = true;
+  leveldb::Status status = db_->Write(options, batch);
+  latency.set_success(status.ok());
+  if (!status.ok()) {
+    LOG(ERROR) << "Failed to write batch to database: " << status.ToString();
+    return false;
+  }
+  return true;
+}
+
 ObjectStoreImpl::BlobType ObjectStoreImpl::GetBlobType(int blob_id) {
   map<int, BlobType>::iterator it = blob_type_map_.find(blob_id);
   if (it == blob_type_map_.end())
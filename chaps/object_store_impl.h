@@ -10,13 +10,16 @@
 #include <map>
 #include <memory>
 #include <string>
+#include <vector>
 
 #include <base/files/file_path.h>
 #include <base/macros.h>
+#include <base/threading/platform_thread.h>
 #include <brillo/secure_blob.h>
 //#include <gtest/gtest_prod.h>
 #include <leveldb/db.h>
 #include <leveldb/env.h>
+#include <leveldb/write_batch.h>
 
 namespace chaps {
 
@@ -36,12 +39,23 @@ class ObjectStoreImpl : public ObjectStore {
   virtual bool SetInternalBlob(int blob_id, const std::string& blob);
   virtual bool SetEncryptionKey(const brillo::SecureBlob& key);
   virtual bool InsertObjectBlob(const ObjectBlob& blob, int* handle);
+  virtual bool InsertObjectBlobs(const std::vector<ObjectBlob>& blobs,
+                                 std::vector<int>* handles);
   virtual bool DeleteObjectBlob(int handle);
   virtual bool DeleteAllObjectBlobs();
   virtual bool UpdateObjectBlob(int handle, const ObjectBlob& blob);
   virtual bool LoadPublicObjectBlobs(std::map<int, ObjectBlob>* blobs);
   virtual bool LoadPrivateObjectBlobs(std::map<int, ObjectBlob>* blobs);
 
+ protected:
+  // Returns the most threads that may decrypt blobs while loading objects.
+  virtual int GetMaxDecryptThreads();
+
+  // Starts a thread running 'delegate' to decrypt a share of the blobs being
+  // loaded. Returns true on success.
+  virtual bool CreateDecryptThread(base::PlatformThread::Delegate* delegate,
+                                   base::PlatformThreadHandle* handle);
+
  private:
   enum BlobType {
     kInternal,
@@ -49,9 +63,24 @@ class ObjectStoreImpl : public ObjectStore {
     kPublic
   };
 
+  // An object blob read from the database, to be decrypted.
+  struct BlobToDecrypt {
+    int id;
+    ObjectBlob encrypted_blob;
+    ObjectBlob blob;
+    bool is_decrypted;
+  };
+
   // Loads all object of a given type.
   bool LoadObjectBlobs(BlobType type, std::map<int, ObjectBlob>* blobs);
 
+  // Decrypts share 'share' of 'num_shares' in 'blobs', i.e. every
+  // 'num_shares'th blob starting at 'share'. Different shares may be
+  // decrypted on different threads at once.
+  void DecryptBlobs(std::vector<BlobToDecrypt>* blobs,
+                    size_t share,
+                    size_t num_shares);
+
   // Encrypts an object blob with a random IV and appends an HMAC.
   bool Encrypt(const ObjectBlob& plain_text,
                ObjectBlob* cipher_text);
@@ -92,6 +121,10 @@ class ObjectStoreImpl : public ObjectStore {
   // Writes an integer to the database. Returns true on success.
   bool WriteInt(const std::string& key, int value);
 
+  // Applies all changes in 'batch' to the database atomically. Returns true on
+  // success.
+  bool CommitBatch(leveldb::WriteBatch* batch);
+
   // Returns the blob type for the specified blob. If 'blob_id' is unknown,
   // kInternal is returned.
   BlobType GetBlobType(int blob_id);
@@ -118,6 +151,10 @@ class ObjectStoreImpl : public ObjectStore {
   static const char kObfuscationKey[];
   // The current blob format version.
   static const int kBlobVersion;
+  // The fewest blobs each thread decrypts when loading objects; fewer blobs
+  // than this are not worth a thread.
+  static const size_t kMinBlobsPerDecryptThread;
+  static const int kMaxDecryptThreads;
 
   brillo::SecureBlob key_;
   std::unique_ptr<leveldb::Env> env_;
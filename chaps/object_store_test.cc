@@ -6,7 +6,10 @@
 
 #include <map>
 #include <string>
+#include <vector>
 
+#include <base/strings/string_number_conversions.h>
+#include <base/threading/platform_thread.h>
 #include <gtest/gtest.h>
 #include <openssl/err.h>
 #include <openssl/rand.h>
@@ -15,6 +18,7 @@ using base::FilePath;
 using brillo::SecureBlob;
 using std::map;
 using std::string;
+using std::vector;
 
 namespace chaps {
 
@@ -220,6 +224,96 @@ TEST(TestObjectStore, DeleteAll) {
   EXPECT_TRUE(store.GetInternalBlob(1, &internal));
   EXPECT_EQ("internal", internal);
 }
+
+TEST(TestObjectStore, InsertLoadBatch) {
+  ObjectStoreImpl store;
+  const FilePath::CharType database[] = FILE_PATH_LITERAL(":memory:");
+  ASSERT_TRUE(store.Init(FilePath(database)));
+  string tmp(32, 'A');
+  SecureBlob key(tmp.begin(), tmp.end());
+  EXPECT_TRUE(store.SetEncryptionKey(key));
+  int handle;
+  ObjectBlob first = {"first", true};
+  EXPECT_TRUE(store.InsertObjectBlob(first, &handle));
+  // Enough blobs to be decrypted on several threads.
+  vector<ObjectBlob> blobs;
+  for (int i = 0; i < 200; ++i) {
+    ObjectBlob blob = {base::IntToString(i), (i % 2) == 0};
+    blobs.push_back(blob);
+  }
+  vector<int> handles;
+  EXPECT_TRUE(store.InsertObjectBlobs(blobs, &handles));
+  ASSERT_EQ(blobs.size(), handles.size());
+  // Ids keep increasing across single and batch inserts.
+  EXPECT_LT(handle, handles[0]);
+  int last_handle;
+  EXPECT_TRUE(store.InsertObjectBlob(first, &last_handle));
+  EXPECT_LT(handles.back(), last_handle);
+  map<int, ObjectBlob> objects, objects2;
+  EXPECT_TRUE(store.LoadPublicObjectBlobs(&objects));
+  EXPECT_TRUE(store.LoadPrivateObjectBlobs(&objects2));
+  EXPECT_EQ(100, objects.size());
+  EXPECT_EQ(102, objects2.size());
+  for (size_t i = 0; i < blobs.size(); ++i) {
+    map<int, ObjectBlob>& loaded = blobs[i].is_private ? objects2 : objects;
+    ASSERT_TRUE(loaded.end() != loaded.find(handles[i]));
+    EXPECT_EQ(blobs[i].blob, loaded[handles[i]].blob);
+    EXPECT_EQ(blobs[i].is_private, loaded[handles[i]].is_private);
+  }
+  // Blobs inserted in a batch can be updated and deleted one by one.
+  ObjectBlob updated = {"updated", true};
+  EXPECT_TRUE(store.UpdateObjectBlob(handles[0], updated));
+  EXPECT_TRUE(store.DeleteObjectBlob(handles[1]));
+  objects.clear();
+  objects2.clear();
+  EXPECT_TRUE(store.LoadPublicObjectBlobs(&objects));
+  EXPECT_TRUE(store.LoadPrivateObjectBlobs(&objects2));
+  EXPECT_EQ(99, objects.size());
+  EXPECT_EQ("updated", objects2[handles[0]].blob);
+}
+
+// Fails to start the decryption threads for some shares of the blobs.
+class ObjectStoreWithFailingThreads : public ObjectStoreImpl {
+ public:
+  ObjectStoreWithFailingThreads() : num_attempts_(0) {}
+
+ protected:
+  virtual int GetMaxDecryptThreads() { return 4; }
+  virtual bool CreateDecryptThread(base::PlatformThread::Delegate* delegate,
+                                   base::PlatformThreadHandle* handle) {
+    // Let only the first of every two threads start.
+    if (num_attempts_++ % 2)
+      return false;
+    return ObjectStoreImpl::CreateDecryptThread(delegate, handle);
+  }
+
+ private:
+  int num_attempts_;
+};
+
+TEST(TestObjectStore, LoadWithFailedDecryptThreads) {
+  ObjectStoreWithFailingThreads store;
+  const FilePath::CharType database[] = FILE_PATH_LITERAL(":memory:");
+  ASSERT_TRUE(store.Init(FilePath(database)));
+  string tmp(32, 'A');
+  SecureBlob key(tmp.begin(), tmp.end());
+  EXPECT_TRUE(store.SetEncryptionKey(key));
+  vector<ObjectBlob> blobs;
+  for (int i = 0; i < 200; ++i) {
+    ObjectBlob blob = {base::IntToString(i), true};
+    blobs.push_back(blob);
+  }
+  vector<int> handles;
+  EXPECT_TRUE(store.InsertObjectBlobs(blobs, &handles));
+  ASSERT_EQ(blobs.size(), handles.size());
+  // Every share is decrypted even though the second of the three extra threads
+  // fails to start.
+  map<int, ObjectBlob> objects;
+  EXPECT_TRUE(store.LoadPrivateObjectBlobs(&objects));
+  EXPECT_EQ(blobs.size(), objects.size());
+  for (size_t i = 0; i < blobs.size(); ++i)
+    EXPECT_EQ(blobs[i].blob, objects[handles[i]].blob);
+}
 #endif
 
 }  // namespace chaps
@@ -221,6 +221,28 @@ TEST_F(TestObject, SetAttributes) {
   EXPECT_EQ(CKR_ATTRIBUTE_VALUE_INVALID, object_->SetAttributes(invalid, 1));
 }
 
+// Test that the cache is kept until an attribute changes.
+TEST_F(TestObject, Cache) {
+  const ObjectImpl* const_object = object_.get();
+  EXPECT_FALSE(const_object->GetCache());
+  std::shared_ptr<ObjectCache> cache = std::make_shared<ObjectCache>();
+  const_object->SetCache(cache);
+  EXPECT_EQ(cache, const_object->GetCache());
+  EXPECT_EQ(CKR_OK, object_->FinalizeNewObject());
+  object_->SetAttributeString(CKA_LABEL, "label");
+  EXPECT_FALSE(const_object->GetCache());
+
+  const_object->SetCache(cache);
+  object_->RemoveAttribute(CKA_LABEL);
+  EXPECT_FALSE(const_object->GetCache());
+
+  const_object->SetCache(cache);
+  CK_BYTE label[] = "label";
+  CK_ATTRIBUTE templ[] = {{CKA_LABEL, &label, sizeof(label)}};
+  EXPECT_EQ(CKR_OK, object_->SetAttributes(templ, 1));
+  EXPECT_FALSE(const_object->GetCache());
+}
+
 }  // namespace chaps
 
 int main(int argc, char** argv) {
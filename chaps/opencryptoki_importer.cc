@@ -120,7 +120,7 @@ bool OpencryptokiImporter::ImportObjects(ObjectPool* object_pool) {
             << ready_for_import.size() << " public.";
   // Objects that have opencryptoki internal attributes such as tpm-protected
   // blobs need to be moved to the chaps format.
-  int num_imported = 0;
+  vector<Object*> objects;
   for (size_t i = 0; i < ready_for_import.size(); ++i) {
     if (IsPrivateKey(ready_for_import[i])) {
       // Private keys need authorization data decrypted which requires the TPM.
@@ -133,9 +133,9 @@ bool OpencryptokiImporter::ImportObjects(ObjectPool* object_pool) {
       LOG(WARNING) << "Failed to create an object instance.";
       continue;
     }
-    if (object_pool->Import(object))
-      ++num_imported;
+    objects.push_back(object);
   }
+  int num_imported = ImportBatch(objects, object_pool);
   LOG(INFO) << "Imported: " << num_imported << "; Pending: "
             << encrypted_objects_.size() + unflattened_objects_.size();
   return true;
@@ -149,7 +149,7 @@ bool OpencryptokiImporter::FinishImportAsync(ObjectPool* object_pool) {
   }
   // Objects that have opencryptoki internal attributes such as tpm-protected
   // blobs need to be moved to the chaps format.
-  int num_imported = 0;
+  vector<Object*> objects;
   for (size_t i = 0; i < unflattened_objects_.size(); ++i) {
     if (!ConvertToChapsFormat(&unflattened_objects_[i])) {
       LOG(WARNING) << "Failed to convert an object to Chaps format.";
@@ -160,13 +160,32 @@ bool OpencryptokiImporter::FinishImportAsync(ObjectPool* object_pool) {
       LOG(WARNING) << "Failed to create an object instance.";
       continue;
     }
-    if (object_pool->Import(object))
-      ++num_imported;
+    objects.push_back(object);
   }
+  int num_imported = ImportBatch(objects, object_pool);
   LOG(INFO) << "Finished importing " << num_imported << " pending objects.";
   return true;
 }
 
+int OpencryptokiImporter::ImportBatch(const vector<Object*>& objects,
+                                      ObjectPool* object_pool) {
+  if (objects.empty())
+    return 0;
+  if (object_pool->ImportBatch(objects))
+    return objects.size();
+  // Fall back to one object at a time so that a single bad object does not
+  // prevent the others from being imported.
+  LOG(WARNING) << "Failed to import objects in a batch.";
+  int num_imported = 0;
+  for (size_t i = 0; i < objects.size(); ++i) {
+    if (object_pool->Import(objects[i]))
+      ++num_imported;
+    else
+      delete objects[i];
+  }
+  return num_imported;
+}
+
 bool OpencryptokiImporter::ExtractObjectData(const string& object_file_content,
                                              bool* is_encrypted,
                                              string* object_data) {
@@ -80,6 +80,10 @@ class OpencryptokiImporter : public ObjectImporter {
   // Create an object instance complete with policies. Returns true on success.
   bool CreateObjectInstance(const AttributeMap& attributes, Object** object);
 
+  // Imports 'objects' into 'object_pool' and returns how many were imported.
+  // Takes ownership of all objects.
+  int ImportBatch(const std::vector<Object*>& objects, ObjectPool* object_pool);
+
   // Returns whether a given set of attributes represents a private key.
   bool IsPrivateKey(const AttributeMap& attributes);
 
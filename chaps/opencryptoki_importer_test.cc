@@ -165,6 +165,7 @@ class TestImporterBase {
     pool_.SetupFake(0);
     EXPECT_CALL(pool_, Insert(_)).Times(AnyNumber());
     EXPECT_CALL(pool_, Import(_)).Times(AnyNumber());
+    EXPECT_CALL(pool_, ImportBatch(_)).Times(AnyNumber());
     EXPECT_CALL(pool_, Find(_, _)).Times(AnyNumber());
     EXPECT_CALL(pool_, SetInternalBlob(3, _)).WillRepeatedly(Return(true));
     EXPECT_CALL(pool_, SetInternalBlob(4, _)).WillRepeatedly(Return(true));
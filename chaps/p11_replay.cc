@@ -5,20 +5,26 @@
 // The expensive PKCS #11 operations that occur during a VPN connect are C_Login
 // and C_Sign.  This program replays these along with minimal overhead calls.
 // The --generate switch can be used to prepare a private key to test against.
+// The --load switch instead drives a mix of operations from many threads at
+// once to measure throughput and latency under concurrency.
 
 #include <stdio.h>
 #include <stdlib.h>
 
+#include <algorithm>
 #include <memory>
 #include <string>
 #include <vector>
 
+#include <base/base64.h>
 #include <base/command_line.h>
 #include <base/files/file_path.h>
 #include <base/files/file_util.h>
 #include <base/logging.h>
 #include <base/macros.h>
+#include <base/rand_util.h>
 #include <base/strings/string_number_conversions.h>
+#include <base/strings/string_split.h>
 #include <base/strings/string_util.h>
 #include <base/threading/platform_thread.h>
 #include <base/time/time.h>
@@ -27,6 +33,8 @@
 #include <openssl/x509.h>
 
 #include "chaps/chaps_utility.h"
+#include "chaps/nethsm_server_fake.h"
+#include "chaps/nethsm_transport.h"
 #include "pkcs11/cryptoki.h"
 
 using base::TimeDelta;
@@ -170,11 +178,13 @@ void Sign(CK_SESSION_HANDLE session, const string& label) {
     exit(-1);
 }
 
-// Generates a test key pair.
-void GenerateKeyPair(CK_SESSION_HANDLE session,
-                     int key_size_bits,
-                     const string& label,
-                     bool is_temp) {
+// Generates a test key pair into |public_key_handle| and |private_key_handle|.
+// Returns the result of C_GenerateKeyPair.
+CK_RV TryGenerateKeyPair(CK_SESSION_HANDLE session,
+                         int key_size_bits,
+                         const string& label,
+                         CK_OBJECT_HANDLE* public_key_handle,
+                         CK_OBJECT_HANDLE* private_key_handle) {
   CK_MECHANISM mechanism;
   mechanism.mechanism = CKM_RSA_PKCS_KEY_PAIR_GEN;
   mechanism.pParameter = NULL;
@@ -204,16 +214,25 @@ void GenerateKeyPair(CK_SESSION_HANDLE session,
     {CKA_ID, const_cast<char*>(kKeyID), strlen(kKeyID)},
     {CKA_LABEL, const_cast<char*>(label.c_str()), label.length()},
   };
+  return C_GenerateKeyPair(session,
+                           &mechanism,
+                           public_attributes,
+                           arraysize(public_attributes),
+                           private_attributes,
+                           arraysize(private_attributes),
+                           public_key_handle,
+                           private_key_handle);
+}
+
+// Generates a test key pair.
+void GenerateKeyPair(CK_SESSION_HANDLE session,
+                     int key_size_bits,
+                     const string& label,
+                     bool is_temp) {
   CK_OBJECT_HANDLE public_key_handle = 0;
   CK_OBJECT_HANDLE private_key_handle = 0;
-  CK_RV result = C_GenerateKeyPair(session,
-                                   &mechanism,
-                                   public_attributes,
-                                   arraysize(public_attributes),
-                                   private_attributes,
-                                   arraysize(private_attributes),
-                                   &public_key_handle,
-                                   &private_key_handle);
+  CK_RV result = TryGenerateKeyPair(session, key_size_bits, label,
+                                    &public_key_handle, &private_key_handle);
   LOG(INFO) << "C_GenerateKeyPair: " << chaps::CK_RVToString(result);
   if (result != CKR_OK)
     exit(-1);
@@ -482,6 +501,21 @@ void TearDown(CK_SESSION_HANDLE session, bool logout) {
   LOG(INFO) << "C_Finalize: " << chaps::CK_RVToString(result);
 }
 
+// The operations that --load mixes, indexed like their --mix weights.
+enum LoadOperation {
+  kLoadFind,
+  kLoadSign,
+  kLoadDecrypt,
+  kLoadGenerate,
+  kNumLoadOperations
+};
+
+const char* const kLoadOperationNames[kNumLoadOperations] = {
+  "find", "sign", "decrypt", "generate"
+};
+
+const char kDefaultLoadMix[] = "find:4,sign:4,decrypt:2,generate:0";
+
 void PrintHelp() {
   printf("Usage: p11_replay [--slot=<slot>] [COMMAND]\n");
   printf("Commands:\n");
@@ -499,6 +533,13 @@ void PrintHelp() {
          " it into the token.\n");
   printf("  --list_objects : Lists all token objects.\n");
   printf("  --list_tokens: Lists token info for each loaded token.\n");
+  printf("  --load [--threads=<count> --duration=<seconds> --mix=<op:weight,...>"
+         " --label=<key_label> --nethsm_fake[=<delay_ms>]]"
+         " : Runs a random mix of find, sign, decrypt and generate operations"
+         " on a session per thread and prints throughput and latency"
+         " percentiles per operation. The default mix is %s. --nethsm_fake"
+         " serves the sign and decrypt keys from a local fake NetHSM.\n",
+         kDefaultLoadMix);
   printf("  --logout : Logs out once all other commands have finished.\n");
   printf("  --replay_vpn [--label=<key_label>]"
          " : Replays a L2TP/IPSEC VPN negotiation.\n");
@@ -579,6 +620,302 @@ void PrintTokens() {
   }
 }
 
+const char kLoadGenerateLabel[] = "_load_generate";
+
+// Key IDs of the keys served by --nethsm_fake. Chaps labels NetHSM keys with
+// their location, which is the ID under |kNetHsmKeysPath|.
+const char kNetHsmKeysPath[] = "/api/v0/keys/";
+const char kNetHsmSignKey[] = "load_sign";
+const char kNetHsmDecryptKey[] = "load_decrypt";
+
+struct LoadOptions {
+  CK_SLOT_ID slot;
+  int weights[kNumLoadOperations];
+  base::TimeDelta duration;
+  // Labels of the keys to sign and decrypt with.
+  string sign_label;
+  string decrypt_label;
+  int key_size_bits;
+};
+
+// Parses a mix like "find:4,sign:1" into a weight per operation. Operations
+// that are not listed get a weight of 0.
+bool ParseLoadMix(const string& mix, int weights[kNumLoadOperations]) {
+  base::StringPairs pairs;
+  if (!base::SplitStringIntoKeyValuePairs(mix, ':', ',', &pairs))
+    return false;
+  std::fill(weights, weights + kNumLoadOperations, 0);
+  int total = 0;
+  for (size_t i = 0; i < pairs.size(); ++i) {
+    const char* const* name = std::find(
+        kLoadOperationNames, kLoadOperationNames + kNumLoadOperations,
+        pairs[i].first);
+    if (name == kLoadOperationNames + kNumLoadOperations)
+      return false;
+    int weight = 0;
+    if (!base::StringToInt(pairs[i].second, &weight) || weight < 0)
+      return false;
+    weights[name - kLoadOperationNames] = weight;
+    total += weight;
+  }
+  return total > 0;
+}
+
+// Finds a key by class, label and usage, like a VPN or WiFi client looking up
+// its certificate key. Unlike Find(), this does not log or exit so it can run
+// in a timed loop.
+CK_RV FindLoadKey(CK_SESSION_HANDLE session,
+                  CK_OBJECT_CLASS class_value,
+                  CK_ATTRIBUTE_TYPE usage,
+                  const string& label,
+                  CK_OBJECT_HANDLE* key) {
+  CK_BBOOL true_value = CK_TRUE;
+  CK_ATTRIBUTE attributes[] = {
+    {CKA_CLASS, &class_value, sizeof(class_value)},
+    {usage, &true_value, sizeof(true_value)},
+    {CKA_LABEL, const_cast<char*>(label.c_str()), label.length()},
+  };
+  CK_RV result = C_FindObjectsInit(session, attributes, arraysize(attributes));
+  if (result != CKR_OK)
+    return result;
+  CK_ULONG object_count = 0;
+  result = C_FindObjects(session, key, 1, &object_count);
+  CK_RV final_result = C_FindObjectsFinal(session);
+  if (result != CKR_OK)
+    return result;
+  if (object_count == 0)
+    return CKR_KEY_HANDLE_INVALID;
+  return final_result;
+}
+
+// Runs randomly chosen operations, weighted by the --load mix, on a session of
+// its own until the deadline, and records how long each one took.
+class LoadThread : public base::PlatformThread::Delegate {
+ public:
+  LoadThread(const LoadOptions& options, TimeTicks deadline)
+      : options_(options),
+        deadline_(deadline),
+        session_(CK_INVALID_HANDLE),
+        sign_key_(CK_INVALID_HANDLE),
+        decrypt_key_(CK_INVALID_HANDLE),
+        num_failures_() {}
+
+  void ThreadMain() {
+    session_ = OpenSession(options_.slot);
+    if (options_.weights[kLoadSign] > 0)
+      FindKeyOrDie(CKO_PRIVATE_KEY, CKA_SIGN, options_.sign_label, &sign_key_);
+    if (options_.weights[kLoadDecrypt] > 0)
+      PrepareDecrypt();
+
+    int total_weight = 0;
+    for (int i = 0; i < kNumLoadOperations; ++i)
+      total_weight += options_.weights[i];
+    while (TimeTicks::Now() < deadline_) {
+      int pick = base::RandInt(0, total_weight - 1);
+      int operation = 0;
+      while (pick >= options_.weights[operation])
+        pick -= options_.weights[operation++];
+      TimeTicks start = TimeTicks::Now();
+      CK_RV result = Run(static_cast<LoadOperation>(operation));
+      if (result == CKR_OK)
+        latencies_[operation].push_back(TimeTicks::Now() - start);
+      else
+        ++num_failures_[operation];
+    }
+    C_CloseSession(session_);
+  }
+
+  const vector<TimeDelta>& latencies(int operation) const {
+    return latencies_[operation];
+  }
+  int num_failures(int operation) const { return num_failures_[operation]; }
+
+ private:
+  void FindKeyOrDie(CK_OBJECT_CLASS class_value,
+                    CK_ATTRIBUTE_TYPE usage,
+                    const string& label,
+                    CK_OBJECT_HANDLE* key) {
+    CK_RV result = FindLoadKey(session_, class_value, usage, label, key);
+    if (result != CKR_OK) {
+      LOG(ERROR) << "No key labeled " << label << ": "
+                 << chaps::CK_RVToString(result);
+      exit(-1);
+    }
+  }
+
+  // Encrypts a block with the public key so there is something to decrypt.
+  void PrepareDecrypt() {
+    CK_OBJECT_HANDLE public_key = CK_INVALID_HANDLE;
+    FindKeyOrDie(CKO_PUBLIC_KEY, CKA_ENCRYPT, options_.decrypt_label,
+                 &public_key);
+    FindKeyOrDie(CKO_PRIVATE_KEY, CKA_DECRYPT, options_.decrypt_label,
+                 &decrypt_key_);
+    CK_MECHANISM mechanism = {CKM_RSA_PKCS, NULL, 0};
+    CK_BYTE data[32] = {0};
+    CK_BYTE encrypted[512] = {0};
+    CK_ULONG encrypted_length = arraysize(encrypted);
+    CK_RV result = C_EncryptInit(session_, &mechanism, public_key);
+    if (result == CKR_OK) {
+      result = C_Encrypt(session_, data, arraysize(data), encrypted,
+                         &encrypted_length);
+    }
+    LOG(INFO) << "C_Encrypt: " << chaps::CK_RVToString(result);
+    if (result != CKR_OK)
+      exit(-1);
+    encrypted_data_.assign(encrypted, encrypted + encrypted_length);
+  }
+
+  CK_RV Run(LoadOperation operation) {
+    switch (operation) {
+      case kLoadFind: {
+        CK_OBJECT_HANDLE key = CK_INVALID_HANDLE;
+        return FindLoadKey(session_, CKO_PRIVATE_KEY, CKA_SIGN,
+                           options_.sign_label, &key);
+      }
+      case kLoadSign: {
+        CK_MECHANISM mechanism = {CKM_SHA1_RSA_PKCS, NULL, 0};
+        CK_RV result = C_SignInit(session_, &mechanism, sign_key_);
+        if (result != CKR_OK)
+          return result;
+        CK_BYTE data[200] = {0};
+        CK_BYTE signature[2048] = {0};
+        CK_ULONG signature_length = arraysize(signature);
+        return C_Sign(session_, data, arraysize(data), signature,
+                      &signature_length);
+      }
+      case kLoadDecrypt: {
+        CK_MECHANISM mechanism = {CKM_RSA_PKCS, NULL, 0};
+        CK_RV result = C_DecryptInit(session_, &mechanism, decrypt_key_);
+        if (result != CKR_OK)
+          return result;
+        CK_BYTE decrypted[512] = {0};
+        CK_ULONG decrypted_length = arraysize(decrypted);
+        return C_Decrypt(session_, encrypted_data_.data(),
+                         encrypted_data_.size(), decrypted, &decrypted_length);
+      }
+      case kLoadGenerate: {
+        CK_OBJECT_HANDLE public_key = 0;
+        CK_OBJECT_HANDLE private_key = 0;
+        CK_RV result = TryGenerateKeyPair(session_, options_.key_size_bits,
+                                          kLoadGenerateLabel, &public_key,
+                                          &private_key);
+        if (result != CKR_OK)
+          return result;
+        result = C_DestroyObject(session_, public_key);
+        CK_RV private_result = C_DestroyObject(session_, private_key);
+        return result != CKR_OK ? result : private_result;
+      }
+      case kNumLoadOperations:
+        break;
+    }
+    NOTREACHED();
+    return CKR_FUNCTION_FAILED;
+  }
+
+  const LoadOptions& options_;
+  const TimeTicks deadline_;
+  CK_SESSION_HANDLE session_;
+  CK_OBJECT_HANDLE sign_key_;
+  CK_OBJECT_HANDLE decrypt_key_;
+  vector<CK_BYTE> encrypted_data_;
+  vector<TimeDelta> latencies_[kNumLoadOperations];
+  int num_failures_[kNumLoadOperations];
+
+  DISALLOW_COPY_AND_ASSIGN(LoadThread);
+};
+
+// Returns the |percent| percentile of |sorted|, which must not be empty.
+TimeDelta Percentile(const vector<TimeDelta>& sorted, int percent) {
+  return sorted[(sorted.size() - 1) * percent / 100];
+}
+
+void PrintLoadRow(const char* name,
+                  vector<TimeDelta>* latencies,
+                  int num_failures,
+                  TimeDelta elapsed) {
+  printf("%10s %10zu %10d %10.1f", name, latencies->size(), num_failures,
+         latencies->size() / elapsed.InSecondsF());
+  if (latencies->empty()) {
+    printf("\n");
+    return;
+  }
+  std::sort(latencies->begin(), latencies->end());
+  printf(" %10.2f %10.2f %10.2f\n",
+         Percentile(*latencies, 50).InMillisecondsF(),
+         Percentile(*latencies, 95).InMillisecondsF(),
+         Percentile(*latencies, 99).InMillisecondsF());
+}
+
+// Runs |num_threads| LoadThreads for the configured duration, each with its
+// own session, and prints the throughput and latency of each operation.
+void RunLoad(const LoadOptions& options, int num_threads) {
+  printf("Load: %d threads for %jds\n", num_threads,
+         static_cast<intmax_t>(options.duration.InSeconds()));
+  vector<std::unique_ptr<LoadThread>> threads;
+  vector<base::PlatformThreadHandle> handles(num_threads);
+  TimeTicks start = TimeTicks::Now();
+  for (int i = 0; i < num_threads; ++i) {
+    threads.emplace_back(new LoadThread(options, start + options.duration));
+    if (!base::PlatformThread::Create(0, threads[i].get(), &handles[i]))
+      LOG(FATAL) << "Failed to create thread.";
+  }
+  for (int i = 0; i < num_threads; ++i)
+    base::PlatformThread::Join(handles[i]);
+  TimeDelta elapsed = TimeTicks::Now() - start;
+
+  printf("%10s %10s %10s %10s %10s %10s %10s\n", "operation", "count",
+         "failures", "ops/s", "p50 ms", "p95 ms", "p99 ms");
+  vector<TimeDelta> all_latencies;
+  int all_failures = 0;
+  for (int operation = 0; operation < kNumLoadOperations; ++operation) {
+    if (options.weights[operation] == 0)
+      continue;
+    vector<TimeDelta> latencies;
+    int num_failures = 0;
+    for (size_t i = 0; i < threads.size(); ++i) {
+      const vector<TimeDelta>& thread_latencies =
+          threads[i]->latencies(operation);
+      latencies.insert(latencies.end(), thread_latencies.begin(),
+                       thread_latencies.end());
+      num_failures += threads[i]->num_failures(operation);
+    }
+    all_latencies.insert(all_latencies.end(), latencies.begin(),
+                         latencies.end());
+    all_failures += num_failures;
+    PrintLoadRow(kLoadOperationNames[operation], &latencies, num_failures,
+                 elapsed);
+  }
+  PrintLoadRow("total", &all_latencies, all_failures, elapsed);
+}
+
+// Starts a fake NetHSM where chapsd expects the real one, serving a sign key
+// and a decrypt key that share a locally generated RSA public key.
+std::unique_ptr<chaps::NetHsmServerFake> StartNetHsmFake(int key_size_bits,
+                                                         TimeDelta delay) {
+  string url = chaps::NetHsmTransport::Options().url;
+  std::unique_ptr<chaps::NetHsmServerFake> server(
+      new chaps::NetHsmServerFake(url));
+  if (!server->Start()) {
+    LOG(ERROR) << "Failed to start the fake NetHSM at " << url;
+    exit(-1);
+  }
+  RSA* rsa = RSA_generate_key(key_size_bits, 0x10001, NULL, NULL);
+  if (!rsa) {
+    LOG(ERROR) << "Failed to locally generate key pair.";
+    exit(-1);
+  }
+  string modulus;
+  string public_exponent;
+  base::Base64Encode(bn2bin(rsa->n), &modulus);
+  base::Base64Encode(bn2bin(rsa->e), &public_exponent);
+  RSA_free(rsa);
+  server->AddKey(kNetHsmSignKey, modulus, public_exponent, "sign");
+  server->AddKey(kNetHsmDecryptKey, modulus, public_exponent, "encrypt");
+  server->set_delay(delay);
+  LOG(INFO) << "Fake NetHSM listening at " << url;
+  return server;
+}
+
 }  // namespace
 
 int main(int argc, char** argv) {
@@ -602,14 +939,28 @@ int main(int argc, char** argv) {
       cl->HasSwitch("id");
   bool digest_test = cl->HasSwitch("digest_test");
   bool list_tokens = cl->HasSwitch("list_tokens");
+  bool load = cl->HasSwitch("load");
   if (!generate && !generate_delete && !vpn && !wifi && !logout && !cleanup &&
-      !inject && !list_objects && !import && !digest_test && !list_tokens) {
+      !inject && !list_objects && !import && !digest_test && !list_tokens &&
+      !load) {
     PrintHelp();
     return 0;
   }
 
   brillo::InitLog(brillo::kLogToSyslog | brillo::kLogToStderr);
   base::TimeTicks start_ticks = base::TimeTicks::Now();
+  int key_size_bits = 2048;
+  if (cl->HasSwitch("key_size") &&
+      !base::StringToInt(cl->GetSwitchValueASCII("key_size"), &key_size_bits))
+    key_size_bits = 2048;
+  // The fake must be up before the library loads the NetHSM keys.
+  std::unique_ptr<chaps::NetHsmServerFake> nethsm_fake;
+  if (load && cl->HasSwitch("nethsm_fake")) {
+    int delay_ms = 0;
+    base::StringToInt(cl->GetSwitchValueASCII("nethsm_fake"), &delay_ms);
+    nethsm_fake = StartNetHsmFake(key_size_bits,
+                                  TimeDelta::FromMilliseconds(delay_ms));
+  }
   CK_SLOT_ID slot = Initialize();
   int tmp_slot = 0;
   if (cl->HasSwitch("slot") &&
@@ -621,10 +972,6 @@ int main(int argc, char** argv) {
   string label = "_default";
   if (cl->HasSwitch("label"))
     label = cl->GetSwitchValueASCII("label");
-  int key_size_bits = 2048;
-  if (cl->HasSwitch("key_size") &&
-      !base::StringToInt(cl->GetSwitchValueASCII("key_size"), &key_size_bits))
-    key_size_bits = 2048;
   if (generate || generate_delete) {
     session = Login(slot, false, session);
     PrintTicks(&start_ticks);
@@ -699,6 +1046,43 @@ int main(int argc, char** argv) {
   if (list_tokens) {
     PrintTokens();
   }
+  if (load) {
+    LoadOptions options;
+    options.slot = slot;
+    string mix = kDefaultLoadMix;
+    if (cl->HasSwitch("mix"))
+      mix = cl->GetSwitchValueASCII("mix");
+    if (!ParseLoadMix(mix, options.weights)) {
+      LOG(ERROR) << "Invalid arg, expecting a mix like " << kDefaultLoadMix;
+      exit(-1);
+    }
+    int duration_seconds = 10;
+    if (cl->HasSwitch("duration") &&
+        !base::StringToInt(cl->GetSwitchValueASCII("duration"),
+                           &duration_seconds))
+      duration_seconds = 10;
+    options.duration = TimeDelta::FromSeconds(duration_seconds);
+    int num_threads = 8;
+    if (cl->HasSwitch("threads") &&
+        !base::StringToInt(cl->GetSwitchValueASCII("threads"), &num_threads))
+      num_threads = 8;
+    if (num_threads < 1) {
+      LOG(ERROR) << "Invalid arg, expecting at least 1 thread.";
+      exit(-1);
+    }
+    if (nethsm_fake) {
+      options.sign_label = string(kNetHsmKeysPath) + kNetHsmSignKey;
+      options.decrypt_label = string(kNetHsmKeysPath) + kNetHsmDecryptKey;
+    } else {
+      options.sign_label = label;
+      options.decrypt_label = label;
+    }
+    options.key_size_bits = key_size_bits;
+    session = Login(slot, false, session);
+    PrintTicks(&start_ticks);
+    RunLoad(options, num_threads);
+    PrintTicks(&start_ticks);
+  }
   if (cleanup)
     DeleteAllTestKeys(session);
   TearDown(session, logout);
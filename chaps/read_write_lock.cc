@@ -0,0 +1,50 @@
+// Copyright 2016 The Chromium OS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "chaps/read_write_lock.h"
+
+#include <base/logging.h>
+
+namespace chaps {
+
+ReadWriteLock::ReadWriteLock() {
+  pthread_rwlockattr_t attributes;
+  pthread_rwlockattr_init(&attributes);
+#if defined(__GLIBC__)
+  // By default glibc lets new readers in while a writer waits, so a steady
+  // stream of readers keeps writers out indefinitely.
+  pthread_rwlockattr_setkind_np(&attributes,
+                                PTHREAD_RWLOCK_PREFER_WRITER_NONRECURSIVE_NP);
+#endif
+  int result = pthread_rwlock_init(&lock_, &attributes);
+  DCHECK_EQ(result, 0) << "pthread_rwlock_init failed: " << result;
+  pthread_rwlockattr_destroy(&attributes);
+}
+
+ReadWriteLock::~ReadWriteLock() {
+  int result = pthread_rwlock_destroy(&lock_);
+  DCHECK_EQ(result, 0) << "pthread_rwlock_destroy failed: " << result;
+}
+
+void ReadWriteLock::ReadAcquire() {
+  int result = pthread_rwlock_rdlock(&lock_);
+  DCHECK_EQ(result, 0) << "pthread_rwlock_rdlock failed: " << result;
+}
+
+void ReadWriteLock::ReadRelease() {
+  int result = pthread_rwlock_unlock(&lock_);
+  DCHECK_EQ(result, 0) << "pthread_rwlock_unlock failed: " << result;
+}
+
+void ReadWriteLock::WriteAcquire() {
+  int result = pthread_rwlock_wrlock(&lock_);
+  DCHECK_EQ(result, 0) << "pthread_rwlock_wrlock failed: " << result;
+}
+
+void ReadWriteLock::WriteRelease() {
+  int result = pthread_rwlock_unlock(&lock_);
+  DCHECK_EQ(result, 0) << "pthread_rwlock_unlock failed: " << result;
+}
+
+}  // namespace chaps
@@ -0,0 +1,79 @@
+// Copyright 2016 The Chromium OS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef CHAPS_READ_WRITE_LOCK_H_
+#define CHAPS_READ_WRITE_LOCK_H_
+
+#include <pthread.h>
+
+#include <base/macros.h>
+
+namespace chaps {
+
+// ReadWriteLock is held either by any number of readers at once or by a single
+// writer. base::Lock has no shared mode, so this wraps a POSIX rwlock. The lock
+// is not recursive, and a waiting writer keeps new readers out, so a thread
+// must never acquire it for reading twice.
+class ReadWriteLock {
+ public:
+  ReadWriteLock();
+  ~ReadWriteLock();
+
+  void ReadAcquire();
+  void ReadRelease();
+  void WriteAcquire();
+  void WriteRelease();
+
+ private:
+  pthread_rwlock_t lock_;
+
+  DISALLOW_COPY_AND_ASSIGN(ReadWriteLock);
+};
+
+// Holds a ReadWriteLock for reading for the lifetime of the instance.
+class AutoReadLock {
+ public:
+  explicit AutoReadLock(ReadWriteLock& lock) : lock_(lock) {
+    lock_.ReadAcquire();
+  }
+  ~AutoReadLock() { lock_.ReadRelease(); }
+
+ private:
+  ReadWriteLock& lock_;
+
+  DISALLOW_COPY_AND_ASSIGN(AutoReadLock);
+};
+
+// Holds a ReadWriteLock for writing for the lifetime of the instance.
+class AutoWriteLock {
+ public:
+  explicit AutoWriteLock(ReadWriteLock& lock) : lock_(lock) {
+    lock_.WriteAcquire();
+  }
+  ~AutoWriteLock() { lock_.WriteRelease(); }
+
+ private:
+  ReadWriteLock& lock_;
+
+  DISALLOW_COPY_AND_ASSIGN(AutoWriteLock);
+};
+
+// Releases a ReadWriteLock held for writing for the lifetime of the instance,
+// like base::AutoUnlock.
+class AutoWriteUnlock {
+ public:
+  explicit AutoWriteUnlock(ReadWriteLock& lock) : lock_(lock) {
+    lock_.WriteRelease();
+  }
+  ~AutoWriteUnlock() { lock_.WriteAcquire(); }
+
+ private:
+  ReadWriteLock& lock_;
+
+  DISALLOW_COPY_AND_ASSIGN(AutoWriteUnlock);
+};
+
+}  // namespace chaps
+
+#endif  // CHAPS_READ_WRITE_LOCK_H_
@@ -0,0 +1,132 @@
+// Copyright 2016 The Chromium OS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "chaps/request_dispatcher.h"
+
+#include <deque>
+
+#include <base/logging.h>
+#include <base/synchronization/condition_variable.h>
+#include <base/synchronization/lock.h>
+#include <base/threading/platform_thread.h>
+
+using base::AutoLock;
+using base::PlatformThread;
+using base::PlatformThreadHandle;
+
+namespace chaps {
+
+namespace {
+
+// Slot keys have the top bit set so that they never equal a session key.
+const uint64_t kSlotKeyFlag = UINT64_C(1) << 63;
+
+}  // namespace
+
+const uint64_t RequestDispatcher::kGlobalKey = ~UINT64_C(0);
+
+// Runs the requests in its queue, one at a time, on a thread of its own.
+class RequestDispatcher::Worker : public PlatformThread::Delegate {
+ public:
+  Worker() : request_posted_(&lock_), stopping_(false) {}
+
+  bool Start() {
+    return PlatformThread::Create(0, this, &handle_);
+  }
+
+  void Stop() {
+    {
+      AutoLock lock(lock_);
+      stopping_ = true;
+      request_posted_.Signal();
+    }
+    PlatformThread::Join(handle_);
+  }
+
+  void Post(const base::Closure& request) {
+    AutoLock lock(lock_);
+    if (stopping_) {
+      LOG(WARNING) << "Dropping a request posted after the dispatcher stopped.";
+      return;
+    }
+    requests_.push_back(request);
+    request_posted_.Signal();
+  }
+
+  void ThreadMain() {
+    for (;;) {
+      base::Closure request;
+      {
+        AutoLock lock(lock_);
+        while (requests_.empty() && !stopping_)
+          request_posted_.Wait();
+        if (requests_.empty())
+          return;
+        request = requests_.front();
+        requests_.pop_front();
+      }
+      request.Run();
+    }
+  }
+
+ private:
+  PlatformThreadHandle handle_;
+  base::Lock lock_;
+  base::ConditionVariable request_posted_;
+  std::deque<base::Closure> requests_;
+  bool stopping_;
+
+  DISALLOW_COPY_AND_ASSIGN(Worker);
+};
+
+RequestDispatcher::RequestDispatcher(size_t num_workers) : started_(false) {
+  CHECK_GT(num_workers, 0u);
+  for (size_t i = 0; i < num_workers; ++i)
+    workers_.emplace_back(new Worker());
+}
+
+RequestDispatcher::~RequestDispatcher() {
+  Stop();
+}
+
+bool RequestDispatcher::Start() {
+  CHECK(!started_);
+  for (size_t i = 0; i < workers_.size(); ++i) {
+    if (!workers_[i]->Start()) {
+      LOG(ERROR) << "Failed to start request worker " << i;
+      for (size_t j = 0; j < i; ++j)
+        workers_[j]->Stop();
+      return false;
+    }
+  }
+  started_ = true;
+  return true;
+}
+
+void RequestDispatcher::Stop() {
+  if (!started_)
+    return;
+  for (size_t i = 0; i < workers_.size(); ++i)
+    workers_[i]->Stop();
+  started_ = false;
+}
+
+void RequestDispatcher::Post(uint64_t key, const base::Closure& request) {
+  workers_[GetWorkerIndex(key)]->Post(request);
+}
+
+size_t RequestDispatcher::GetWorkerIndex(uint64_t key) const {
+  // Spreads consecutive keys, such as session handles, over the workers.
+  return ((key * UINT64_C(0x9E3779B97F4A7C15)) >> 32) % workers_.size();
+}
+
+uint64_t RequestDispatcher::GetSessionKey(uint64_t session_id) {
+  return session_id & ~kSlotKeyFlag;
+}
+
+uint64_t RequestDispatcher::GetSlotKey(uint64_t slot_id) {
+  return slot_id | kSlotKeyFlag;
+}
+
+}  // namespace chaps
@@ -0,0 +1,58 @@
+// Copyright 2016 The Chromium OS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef CHAPS_REQUEST_DISPATCHER_H_
+#define CHAPS_REQUEST_DISPATCHER_H_
+
+#include <stdint.h>
+
+#include <memory>
+#include <vector>
+
+#include <base/callback.h>
+#include <base/macros.h>
+
+namespace chaps {
+
+// RequestDispatcher runs requests on a fixed number of worker threads. Each
+// request is posted with a key naming what it operates on, e.g. a session. All
+// requests with the same key run on the same worker in the order they were
+// posted, while requests with different keys can run at the same time on
+// different workers. chapsd uses it so that a slow request on one session does
+// not hold up requests on other sessions.
+class RequestDispatcher {
+ public:
+  explicit RequestDispatcher(size_t num_workers);
+  // Stops the workers if they were started.
+  ~RequestDispatcher();
+
+  bool Start();
+  // Runs the requests posted so far and then stops the workers. Requests
+  // posted after this are dropped.
+  void Stop();
+
+  // Queues |request| to run on the worker for |key| and returns at once.
+  void Post(uint64_t key, const base::Closure& request);
+
+  // Keys for requests on a session, on a slot, and on neither.
+  static uint64_t GetSessionKey(uint64_t session_id);
+  static uint64_t GetSlotKey(uint64_t slot_id);
+  static const uint64_t kGlobalKey;
+
+  // Returns which worker runs the requests with |key|.
+  size_t GetWorkerIndex(uint64_t key) const;
+  size_t num_workers() const { return workers_.size(); }
+
+ private:
+  class Worker;
+
+  std::vector<std::unique_ptr<Worker>> workers_;
+  bool started_;
+
+  DISALLOW_COPY_AND_ASSIGN(RequestDispatcher);
+};
+
+}  // namespace chaps
+
+#endif  // CHAPS_REQUEST_DISPATCHER_H_
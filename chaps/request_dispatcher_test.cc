@@ -0,0 +1,282 @@
+// Copyright 2016 The Chromium OS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "chaps/request_dispatcher.h"
+
+#include <memory>
+#include <vector>
+
+#include <base/bind.h>
+#include <base/synchronization/lock.h>
+#include <base/synchronization/waitable_event.h>
+#include <base/time/time.h>
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include "chaps/attributes.h"
+#include "chaps/chaps_service.h"
+#include "chaps/isolate.h"
+#include "chaps/read_write_lock.h"
+#include "chaps/session_mock.h"
+#include "chaps/slot_locks.h"
+#include "chaps/slot_manager_mock.h"
+
+using base::TimeDelta;
+using base::WaitableEvent;
+using std::vector;
+using ::testing::_;
+using ::testing::DoAll;
+using ::testing::InvokeWithoutArgs;
+using ::testing::Return;
+using ::testing::SetArgumentPointee;
+
+namespace chaps {
+
+namespace {
+
+const size_t kNumWorkers = 4;
+
+void AppendValue(base::Lock* lock, vector<int>* values, int value) {
+  base::AutoLock auto_lock(*lock);
+  values->push_back(value);
+}
+
+void GenerateKeyPair(ChapsInterface* service,
+                     uint64_t session_id,
+                     uint32_t* result) {
+  vector<uint8_t> no_attributes;
+  Attributes().Serialize(&no_attributes);
+  uint64_t public_key = 0;
+  uint64_t private_key = 0;
+  *result = service->GenerateKeyPair(
+      IsolateCredentialManager::GetDefaultIsolateCredential(), session_id,
+      CKM_RSA_PKCS_KEY_PAIR_GEN, vector<uint8_t>(), no_attributes,
+      no_attributes, &public_key, &private_key);
+}
+
+void FindObjects(ChapsInterface* service,
+                 uint64_t session_id,
+                 WaitableEvent* done) {
+  vector<uint64_t> objects;
+  EXPECT_EQ(CKR_OK, service->FindObjects(
+      IsolateCredentialManager::GetDefaultIsolateCredential(), session_id, 10,
+      &objects));
+  done->Signal();
+}
+
+// The following run calls under the locks ChapsAdaptor takes for them.
+void LockedGenerateKeyPair(SlotLocks* locks,
+                           ChapsInterface* service,
+                           uint64_t session_id,
+                           uint32_t* result) {
+  AutoSessionLock lock(locks, session_id, AutoSlotLock::kRead);
+  GenerateKeyPair(service, session_id, result);
+}
+
+void LockedOpenSession(SlotLocks* locks,
+                       ChapsInterface* service,
+                       uint64_t slot_id,
+                       WaitableEvent* done) {
+  AutoReadLock lock(*locks->lock());
+  uint64_t session_id = 0;
+  EXPECT_EQ(CKR_OK, service->OpenSession(
+      IsolateCredentialManager::GetDefaultIsolateCredential(), slot_id,
+      CKF_SERIAL_SESSION, &session_id));
+  done->Signal();
+}
+
+void LockedDestroyObject(SlotLocks* locks,
+                         ChapsInterface* service,
+                         uint64_t session_id,
+                         WaitableEvent* done) {
+  AutoSessionLock lock(locks, session_id, AutoSlotLock::kWrite);
+  EXPECT_EQ(CKR_OK, service->DestroyObject(
+      IsolateCredentialManager::GetDefaultIsolateCredential(), session_id, 1));
+  done->Signal();
+}
+
+}  // namespace
+
+class TestRequestDispatcher : public ::testing::Test {
+ protected:
+  void SetUp() {
+    dispatcher_.reset(new RequestDispatcher(kNumWorkers));
+    ASSERT_TRUE(dispatcher_->Start());
+  }
+
+  std::unique_ptr<RequestDispatcher> dispatcher_;
+};
+
+TEST_F(TestRequestDispatcher, KeepsOrderPerKey) {
+  const int kNumKeys = 8;
+  const int kNumRequests = 100;
+  base::Lock lock;
+  vector<vector<int>> values(kNumKeys);
+  for (int i = 0; i < kNumRequests; ++i) {
+    for (int key = 0; key < kNumKeys; ++key) {
+      dispatcher_->Post(RequestDispatcher::GetSessionKey(key),
+                        base::Bind(&AppendValue, &lock, &values[key], i));
+    }
+  }
+  // Stop() runs everything that was posted.
+  dispatcher_->Stop();
+  for (int key = 0; key < kNumKeys; ++key) {
+    ASSERT_EQ(static_cast<size_t>(kNumRequests), values[key].size());
+    for (int i = 0; i < kNumRequests; ++i)
+      EXPECT_EQ(i, values[key][i]);
+  }
+}
+
+TEST_F(TestRequestDispatcher, SpreadsKeys) {
+  vector<bool> used(kNumWorkers, false);
+  for (uint64_t session_id = 1; session_id <= 16; ++session_id)
+    used[dispatcher_->GetWorkerIndex(
+        RequestDispatcher::GetSessionKey(session_id))] = true;
+  EXPECT_EQ(vector<bool>(kNumWorkers, true), used);
+  EXPECT_NE(RequestDispatcher::GetSessionKey(1),
+            RequestDispatcher::GetSlotKey(1));
+}
+
+// A key pair generation on a session of one slot holds up later requests on
+// that session, but not a search on a session of another slot.
+TEST_F(TestRequestDispatcher, LongOperationDoesNotBlockOtherSlot) {
+  const uint64_t kSlowSession = 1;
+  uint64_t fast_session = kSlowSession + 1;
+  while (dispatcher_->GetWorkerIndex(
+             RequestDispatcher::GetSessionKey(fast_session)) ==
+         dispatcher_->GetWorkerIndex(
+             RequestDispatcher::GetSessionKey(kSlowSession)))
+    ++fast_session;
+
+  std::shared_ptr<SlotManagerMock> slot_manager =
+      std::make_shared<SlotManagerMock>();
+  SessionMock slow_session;
+  SessionMock fast_session_mock;
+  EXPECT_CALL(*slot_manager, GetSession(_, kSlowSession, _))
+      .WillRepeatedly(DoAll(SetArgumentPointee<2>(&slow_session),
+                            Return(true)));
+  EXPECT_CALL(*slot_manager, GetSession(_, fast_session, _))
+      .WillRepeatedly(DoAll(SetArgumentPointee<2>(&fast_session_mock),
+                            Return(true)));
+  WaitableEvent release_key_generation(false, false);
+  EXPECT_CALL(slow_session, GenerateKeyPair(_, _, _, _, _, _, _, _))
+      .WillOnce(DoAll(InvokeWithoutArgs(&release_key_generation,
+                                        &WaitableEvent::Wait),
+                      Return(CKR_OK)));
+  EXPECT_CALL(slow_session, FindObjects(10, _))
+      .WillOnce(Return(CKR_OK));
+  EXPECT_CALL(fast_session_mock, FindObjects(10, _))
+      .WillOnce(Return(CKR_OK));
+  ChapsServiceImpl service(slot_manager);
+  ASSERT_TRUE(service.Init());
+
+  uint32_t key_generation_result = CKR_GENERAL_ERROR;
+  WaitableEvent slow_find_done(true, false);
+  WaitableEvent fast_find_done(true, false);
+  dispatcher_->Post(RequestDispatcher::GetSessionKey(kSlowSession),
+                    base::Bind(&GenerateKeyPair, &service, kSlowSession,
+                               &key_generation_result));
+  dispatcher_->Post(RequestDispatcher::GetSessionKey(kSlowSession),
+                    base::Bind(&FindObjects, &service, kSlowSession,
+                               &slow_find_done));
+  dispatcher_->Post(RequestDispatcher::GetSessionKey(fast_session),
+                    base::Bind(&FindObjects, &service, fast_session,
+                               &fast_find_done));
+
+  EXPECT_TRUE(fast_find_done.TimedWait(TimeDelta::FromSeconds(10)));
+  EXPECT_FALSE(slow_find_done.IsSignaled());
+  release_key_generation.Signal();
+  dispatcher_->Stop();
+  EXPECT_TRUE(slow_find_done.IsSignaled());
+  EXPECT_EQ(CKR_OK, key_generation_result);
+  service.TearDown();
+}
+
+// A slow call on one slot holds up destroying an object on that slot, but not
+// opening a session on another slot or destroying an object there.
+TEST_F(TestRequestDispatcher, SlowCallLocksOnlyItsSlot) {
+  const int kSlowSession = 1;
+  const int kSameSlotSession = 2;
+  const int kOtherSlotSession = 3;
+  // Each call is posted with a key of its own, on a worker of its own.
+  vector<uint64_t> keys;
+  vector<bool> used(kNumWorkers, false);
+  for (uint64_t key = 0; keys.size() < kNumWorkers; ++key) {
+    if (!used[dispatcher_->GetWorkerIndex(key)]) {
+      used[dispatcher_->GetWorkerIndex(key)] = true;
+      keys.push_back(key);
+    }
+  }
+
+  std::shared_ptr<SlotManagerMock> slot_manager =
+      std::make_shared<SlotManagerMock>();
+  SessionMock slow_session;
+  SessionMock same_slot_session;
+  SessionMock other_slot_session;
+  EXPECT_CALL(*slot_manager, GetSessionSlot(kSlowSession, _))
+      .WillRepeatedly(DoAll(SetArgumentPointee<1>(0), Return(true)));
+  EXPECT_CALL(*slot_manager, GetSessionSlot(kSameSlotSession, _))
+      .WillRepeatedly(DoAll(SetArgumentPointee<1>(0), Return(true)));
+  EXPECT_CALL(*slot_manager, GetSessionSlot(kOtherSlotSession, _))
+      .WillRepeatedly(DoAll(SetArgumentPointee<1>(1), Return(true)));
+  EXPECT_CALL(*slot_manager, GetSession(_, kSlowSession, _))
+      .WillRepeatedly(DoAll(SetArgumentPointee<2>(&slow_session),
+                            Return(true)));
+  EXPECT_CALL(*slot_manager, GetSession(_, kSameSlotSession, _))
+      .WillRepeatedly(DoAll(SetArgumentPointee<2>(&same_slot_session),
+                            Return(true)));
+  EXPECT_CALL(*slot_manager, GetSession(_, kOtherSlotSession, _))
+      .WillRepeatedly(DoAll(SetArgumentPointee<2>(&other_slot_session),
+                            Return(true)));
+  EXPECT_CALL(*slot_manager, GetSlotCount()).WillRepeatedly(Return(2));
+  EXPECT_CALL(*slot_manager, IsTokenAccessible(_, 1))
+      .WillRepeatedly(Return(true));
+  EXPECT_CALL(*slot_manager, IsTokenPresent(_, 1))
+      .WillRepeatedly(Return(true));
+  EXPECT_CALL(*slot_manager, OpenSession(_, 1, _)).WillOnce(Return(4));
+  WaitableEvent key_generation_started(true, false);
+  WaitableEvent release_key_generation(false, false);
+  EXPECT_CALL(slow_session, GenerateKeyPair(_, _, _, _, _, _, _, _))
+      .WillOnce(DoAll(InvokeWithoutArgs(&key_generation_started,
+                                        &WaitableEvent::Signal),
+                      InvokeWithoutArgs(&release_key_generation,
+                                        &WaitableEvent::Wait),
+                      Return(CKR_OK)));
+  EXPECT_CALL(same_slot_session, DestroyObject(1)).WillOnce(Return(CKR_OK));
+  EXPECT_CALL(other_slot_session, DestroyObject(1)).WillOnce(Return(CKR_OK));
+  ChapsServiceImpl service(slot_manager);
+  ASSERT_TRUE(service.Init());
+  ReadWriteLock lock;
+  SlotLocks locks(&lock, slot_manager.get());
+
+  uint32_t key_generation_result = CKR_GENERAL_ERROR;
+  WaitableEvent open_session_done(true, false);
+  WaitableEvent other_slot_destroy_done(true, false);
+  WaitableEvent same_slot_destroy_done(true, false);
+  dispatcher_->Post(keys[0], base::Bind(&LockedGenerateKeyPair, &locks,
+                                        &service, kSlowSession,
+                                        &key_generation_result));
+  // The key generation holds its slot's lock from here on.
+  EXPECT_TRUE(key_generation_started.TimedWait(TimeDelta::FromSeconds(10)));
+  dispatcher_->Post(keys[1], base::Bind(&LockedOpenSession, &locks, &service,
+                                        1, &open_session_done));
+  dispatcher_->Post(keys[2], base::Bind(&LockedDestroyObject, &locks,
+                                        &service, kOtherSlotSession,
+                                        &other_slot_destroy_done));
+  dispatcher_->Post(keys[3], base::Bind(&LockedDestroyObject, &locks,
+                                        &service, kSameSlotSession,
+                                        &same_slot_destroy_done));
+
+  EXPECT_TRUE(open_session_done.TimedWait(TimeDelta::FromSeconds(10)));
+  EXPECT_TRUE(other_slot_destroy_done.TimedWait(TimeDelta::FromSeconds(10)));
+  EXPECT_FALSE(same_slot_destroy_done.TimedWait(
+      TimeDelta::FromMilliseconds(100)));
+  release_key_generation.Signal();
+  dispatcher_->Stop();
+  EXPECT_TRUE(same_slot_destroy_done.IsSignaled());
+  EXPECT_EQ(CKR_OK, key_generation_result);
+  service.TearDown();
+}
+
+}  // namespace chaps
@@ -5,6 +5,7 @@
 #ifndef CHAPS_SESSION_H_
 #define CHAPS_SESSION_H_
 
+#include <set>
 #include <string>
 #include <vector>
 
@@ -37,6 +38,8 @@ class Session {
   virtual CK_STATE GetState() const = 0;
   virtual bool IsReadOnly() const = 0;
   virtual bool IsOperationActive(OperationType type) const = 0;
+  // Adds the keys of the session's active operations to |keys|.
+  virtual void GetOperationKeys(std::set<const Object*>* keys) const = 0;
   // Object management (see PKCS #11 v2.20: 11.7).
   virtual CK_RV CreateObject(const CK_ATTRIBUTE_PTR attributes,
                              int num_attributes,
@@ -0,0 +1,158 @@
+// Copyright 2016 The Chromium OS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// Measures software RSA operations per second through SessionImpl, with the
+// parsed keys kept with the key objects, and with them dropped before every
+// operation, so that every operation parses its key again.
+
+#include <stdio.h>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <base/at_exit.h>
+#include <base/logging.h>
+#include <base/time/time.h>
+
+#include "chaps/chaps_factory_impl.h"
+#include "chaps/handle_generator.h"
+#include "chaps/net_utility_impl.h"
+#include "chaps/object.h"
+#include "chaps/object_pool.h"
+#include "chaps/object_store.h"
+#include "chaps/session_impl.h"
+#include "pkcs11/cryptoki.h"
+
+using base::TimeTicks;
+using std::string;
+using std::vector;
+
+namespace {
+
+const CK_ULONG kModulusBits = 2048;
+const int kNumKeys = 32;
+const int kNumOperations = 500;
+
+class BenchmarkHandleGenerator : public chaps::HandleGenerator {
+ public:
+  BenchmarkHandleGenerator() : last_handle_(0) {}
+  int CreateHandle() { return ++last_handle_; }
+
+ private:
+  int last_handle_;
+};
+
+struct KeyPair {
+  const chaps::Object* public_key;
+  const chaps::Object* private_key;
+};
+
+KeyPair GenerateKeyPair(chaps::SessionImpl* session) {
+  CK_BBOOL no = CK_FALSE;
+  CK_BBOOL yes = CK_TRUE;
+  CK_BYTE public_exponent[] = {1, 0, 1};
+  CK_ULONG modulus_bits = kModulusBits;
+  CK_ATTRIBUTE public_attributes[] = {
+    {CKA_TOKEN, &no, sizeof(no)},
+    {CKA_VERIFY, &yes, sizeof(yes)},
+    {CKA_PUBLIC_EXPONENT, public_exponent, sizeof(public_exponent)},
+    {CKA_MODULUS_BITS, &modulus_bits, sizeof(modulus_bits)}
+  };
+  CK_ATTRIBUTE private_attributes[] = {
+    {CKA_TOKEN, &no, sizeof(no)},
+    {CKA_SIGN, &yes, sizeof(yes)}
+  };
+  int public_handle = 0;
+  int private_handle = 0;
+  CHECK_EQ(CKR_OK, session->GenerateKeyPair(CKM_RSA_PKCS_KEY_PAIR_GEN, "",
+                                            public_attributes, 4,
+                                            private_attributes, 2,
+                                            &public_handle, &private_handle));
+  KeyPair key_pair;
+  CHECK(session->GetObject(public_handle, &key_pair.public_key));
+  CHECK(session->GetObject(private_handle, &key_pair.private_key));
+  return key_pair;
+}
+
+// Returns signatures per second, using the keys in turn. If |drop_keys|, the
+// parsed key is dropped before each signature.
+double MeasureSign(chaps::SessionImpl* session,
+                   const vector<KeyPair>& keys,
+                   bool drop_keys,
+                   vector<string>* signatures) {
+  const string input(32, 'x');
+  TimeTicks start = TimeTicks::Now();
+  for (int i = 0; i < kNumOperations; ++i) {
+    const chaps::Object* key = keys[i % keys.size()].private_key;
+    if (drop_keys)
+      key->SetCache(std::shared_ptr<chaps::ObjectCache>());
+    CHECK_EQ(CKR_OK, session->OperationInit(chaps::kSign, CKM_SHA256_RSA_PKCS,
+                                            "", key));
+    int length = kModulusBits / 8;
+    string signature;
+    CHECK_EQ(CKR_OK, session->OperationSinglePart(chaps::kSign, input, &length,
+                                                  &signature));
+    if (signatures->size() < keys.size())
+      signatures->push_back(signature);
+  }
+  return kNumOperations / (TimeTicks::Now() - start).InSecondsF();
+}
+
+// Returns verifications per second, using the keys in turn. If |drop_keys|,
+// the parsed key is dropped before each verification.
+double MeasureVerify(chaps::SessionImpl* session,
+                     const vector<KeyPair>& keys,
+                     bool drop_keys,
+                     const vector<string>& signatures) {
+  const string input(32, 'x');
+  TimeTicks start = TimeTicks::Now();
+  for (int i = 0; i < kNumOperations; ++i) {
+    const chaps::Object* key = keys[i % keys.size()].public_key;
+    if (drop_keys)
+      key->SetCache(std::shared_ptr<chaps::ObjectCache>());
+    CHECK_EQ(CKR_OK,
+             session->OperationInit(chaps::kVerify, CKM_SHA256_RSA_PKCS, "",
+                                    key));
+    CHECK_EQ(CKR_OK, session->OperationUpdate(chaps::kVerify, input, NULL,
+                                              NULL));
+    CHECK_EQ(CKR_OK, session->VerifyFinal(signatures[i % keys.size()]));
+  }
+  return kNumOperations / (TimeTicks::Now() - start).InSecondsF();
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  base::AtExitManager at_exit;
+  std::shared_ptr<chaps::ChapsFactoryImpl> factory =
+      std::make_shared<chaps::ChapsFactoryImpl>();
+  std::shared_ptr<chaps::HandleGenerator> handle_generator =
+      std::make_shared<BenchmarkHandleGenerator>();
+  std::shared_ptr<chaps::ObjectPool> token_pool(factory->CreateObjectPool(
+      handle_generator, std::unique_ptr<chaps::ObjectStore>()));
+  CHECK(token_pool);
+  std::shared_ptr<chaps::NetUtility> net_utility =
+      std::make_shared<chaps::NetUtilityImpl>(token_pool, factory, nullptr);
+  chaps::SessionImpl session(0, token_pool, net_utility, factory,
+                             handle_generator, false);
+
+  vector<KeyPair> keys;
+  for (int i = 0; i < kNumKeys; ++i)
+    keys.push_back(GenerateKeyPair(&session));
+
+  // The first run records a signature for each key.
+  vector<string> signatures;
+  double uncached_sign = MeasureSign(&session, keys, true, &signatures);
+  double cached_sign = MeasureSign(&session, keys, false, &signatures);
+  double uncached_verify = MeasureVerify(&session, keys, true, signatures);
+  double cached_verify = MeasureVerify(&session, keys, false, signatures);
+
+  string key_size = "RSA-" + std::to_string(kModulusBits);
+  printf("%12s %14s %14s\n", key_size.c_str(), "new key/op", "cached key");
+  printf("%12s %14.0f %14.0f\n", "signs/s", uncached_sign, cached_sign);
+  printf("%12s %14.0f %14.0f\n", "verifies/s", uncached_verify,
+         cached_verify);
+  return 0;
+}
@@ -13,6 +13,7 @@
 #include <iostream>
 
 #include <base/logging.h>
+#include <base/strings/stringprintf.h>
 #include <brillo/secure_blob.h>
 #include <openssl/bio.h>
 #include <openssl/des.h>
@@ -25,6 +26,7 @@
 #include "chaps/chaps.h"
 #include "chaps/chaps_factory.h"
 #include "chaps/chaps_utility.h"
+#include "chaps/latency_stats.h"
 #include "chaps/object.h"
 #include "chaps/object_pool.h"
 #include "chaps/object_store.h"
@@ -48,6 +50,27 @@ static const int kMaxDigestOutputBytes = EVP_MAX_MD_SIZE;
 static const int kMinRSAKeyBits = 512;
 //static const int kMaxRSAKeyBitsHW = 2048;  // Max supported by the TPM.
 static const int kMaxRSAKeyBitsSW = kMaxRSAOutputBytes * 8;
+// Crypto operations are timed per operation type and mechanism.
+static const char kLatencyCategory[] = "Session";
+static const char* const kOperationNames[kNumOperationTypes] = {
+  "Encrypt", "Decrypt", "Digest", "Sign", "Verify"
+};
+
+// A software RSA key kept with the key object it was created from. Reusing it
+// saves converting the attributes and lets OpenSSL keep the Montgomery and
+// blinding values it computes on first use.
+class RSAKeyCache : public ObjectCache {
+ public:
+  explicit RSAKeyCache(RSA* rsa) : rsa_(rsa) {}
+  ~RSAKeyCache() override { RSA_free(rsa_); }
+
+  RSA* rsa() const { return rsa_; }
+
+ private:
+  RSA* rsa_;
+
+  DISALLOW_COPY_AND_ASSIGN(RSAKeyCache);
+};
 
 SessionImpl::SessionImpl(int slot_id,
                          std::shared_ptr<ObjectPool> token_object_pool,
@@ -73,8 +96,7 @@ SessionImpl::SessionImpl(int slot_id,
   CHECK(session_object_pool_.get());
 }
 
-SessionImpl::~SessionImpl() {
-}
+SessionImpl::~SessionImpl() {}
 
 int SessionImpl::GetSlot() const {
   return slot_id_;
@@ -93,6 +115,14 @@ bool SessionImpl::IsOperationActive(OperationType type) const {
   return operation_context_[type].is_valid_;
 }
 
+void SessionImpl::GetOperationKeys(std::set<const Object*>* keys) const {
+  CHECK(keys);
+  for (int i = 0; i < kNumOperationTypes; ++i) {
+    if (operation_context_[i].is_valid_ && operation_context_[i].key_)
+      keys->insert(operation_context_[i].key_);
+  }
+}
+
 CK_RV SessionImpl::CreateObject(const CK_ATTRIBUTE_PTR attributes,
                                 int num_attributes,
                                 int* new_object_handle) {
@@ -372,8 +402,13 @@ CK_RV SessionImpl::OperationFinalInternal(OperationType operation,
   context->is_valid_ = false;
   // Complete the operation if it has not already been done.
   if (!context->is_finished_) {
+    ScopedLatency latency(kLatencyCategory,
+                          base::StringPrintf("%s.0x%lx",
+                                             kOperationNames[operation],
+                                             context->mechanism_));
     if (context->is_cipher_) {
       CK_RV result = CipherFinal(context);
+      latency.set_result(result);
       if (result != CKR_OK)
         return result;
     } else if (context->is_digest_) {
@@ -391,16 +426,16 @@ CK_RV SessionImpl::OperationFinalInternal(OperationType operation,
     // Some RSA mechanisms use a digest so it's important to finish the digest
     // before finishing the RSA computation.
     if (IsRSA(context->mechanism_)) {
-      if (operation == kEncrypt) {
-        if (!RSAEncrypt(context))
-          return CKR_FUNCTION_FAILED;
-      } else if (operation == kDecrypt) {
-        if (!RSADecrypt(context))
-          return CKR_FUNCTION_FAILED;
-      } else if (operation == kSign) {
-        if (!RSASign(context))
-          return CKR_FUNCTION_FAILED;
-      }
+      bool success = true;
+      if (operation == kEncrypt)
+        success = RSAEncrypt(context);
+      else if (operation == kDecrypt)
+        success = RSADecrypt(context);
+      else if (operation == kSign)
+        success = RSASign(context);
+      latency.set_success(success);
+      if (!success)
+        return CKR_FUNCTION_FAILED;
     }
     context->is_finished_ = true;
   }
@@ -1137,6 +1172,17 @@ RSA* SessionImpl::CreateKeyFromObject(const Object* key_object) {
   return rsa;
 }
 
+std::shared_ptr<RSA> SessionImpl::GetRSAKey(const Object* key_object) {
+  // SessionImpl is the only user of object caches, so they all hold keys.
+  std::shared_ptr<RSAKeyCache> cache =
+      std::static_pointer_cast<RSAKeyCache>(key_object->GetCache());
+  if (!cache) {
+    cache = std::make_shared<RSAKeyCache>(CreateKeyFromObject(key_object));
+    key_object->SetCache(cache);
+  }
+  return std::shared_ptr<RSA>(cache, cache->rsa());
+}
+
 const EVP_CIPHER* SessionImpl::GetOpenSSLCipher(CK_MECHANISM_TYPE mechanism,
                                                 size_t key_size) {
   switch (mechanism) {
@@ -1213,7 +1259,8 @@ bool SessionImpl::RSADecrypt(OperationContext* context) {
       return false;
     }
   } else {
-    RSA* rsa = CreateKeyFromObject(context->key_);
+    std::shared_ptr<RSA> key = GetRSAKey(context->key_);
+    RSA* rsa = key.get();
     uint8_t buffer[kMaxRSAOutputBytes];
     CHECK(RSA_size(rsa) <= kMaxRSAOutputBytes);
     int length = RSA_private_decrypt(
@@ -1222,7 +1269,6 @@ bool SessionImpl::RSADecrypt(OperationContext* context) {
         buffer,
         rsa,
         RSA_PKCS1_PADDING);  // Strips PKCS #1 type 2 padding.
-    RSA_free(rsa);
     if (length == -1) {
       LOG(ERROR) << "RSA_private_decrypt failed: " << GetOpenSSLError();
       return false;
@@ -1233,7 +1279,8 @@ bool SessionImpl::RSADecrypt(OperationContext* context) {
 }
 
 bool SessionImpl::RSAEncrypt(OperationContext* context) {
-  RSA* rsa = CreateKeyFromObject(context->key_);
+  std::shared_ptr<RSA> key = GetRSAKey(context->key_);
+  RSA* rsa = key.get();
   uint8_t buffer[kMaxRSAOutputBytes];
   CHECK(RSA_size(rsa) <= kMaxRSAOutputBytes);
   int length = RSA_public_encrypt(
@@ -1242,7 +1289,6 @@ bool SessionImpl::RSAEncrypt(OperationContext* context) {
       buffer,
       rsa,
       RSA_PKCS1_PADDING);  // Adds PKCS #1 type 2 padding.
-  RSA_free(rsa);
   if (length == -1) {
     LOG(ERROR) << "RSA_public_encrypt failed: " << GetOpenSSLError();
     return false;
@@ -1255,14 +1301,26 @@ bool SessionImpl::RSASign(OperationContext* context) {
   string data_to_sign = GetDERDigestInfo(context->mechanism_) + context->data_;
   string signature;
   if (context->key_->IsTokenObject() &&
-      context->key_->IsAttributePresent(kKeyBlobAttribute)) {
+      context->key_->IsAttributePresent(kKeyLocationAttribute)) {
+    string key_loc = context->key_->GetAttributeString(kKeyLocationAttribute);
+    // C_Sign returns the signature, so this waits for the NetHSM, holding up
+    // the calls queued on this session's RequestDispatcher worker, including
+    // those of other sessions on that worker (see NetUtility::Sign()).
+    if (auto signed_data = net_utility_->Sign(key_loc, data_to_sign)) {
+      signature = *signed_data;
+    } else {
+      return false;
+    }
+  } else if (context->key_->IsTokenObject() &&
+             context->key_->IsAttributePresent(kKeyBlobAttribute)) {
     // int tpm_key_handle = 0;
     // if (!GetTPMKeyHandle(context->key_, &tpm_key_handle))
     //   return false;
     // if (!tpm_utility_ || !tpm_utility_->Sign(tpm_key_handle, data_to_sign, &signature))
     //   return false;
   } else {
-    RSA* rsa = CreateKeyFromObject(context->key_);
+    std::shared_ptr<RSA> key = GetRSAKey(context->key_);
+    RSA* rsa = key.get();
     CHECK(RSA_size(rsa) <= kMaxRSAOutputBytes);
     uint8_t buffer[kMaxRSAOutputBytes];
     int length = RSA_private_encrypt(
@@ -1271,7 +1329,6 @@ bool SessionImpl::RSASign(OperationContext* context) {
         buffer,
         rsa,
         RSA_PKCS1_PADDING);  // Adds PKCS #1 type 1 padding.
-    RSA_free(rsa);
     if (length == -1) {
       LOG(ERROR) << "RSA_private_encrypt failed: " << GetOpenSSLError();
       return false;
@@ -1288,7 +1345,8 @@ CK_RV SessionImpl::RSAVerify(OperationContext* context,
   if (context->key_->GetAttributeString(CKA_MODULUS).length() !=
       signature.length())
     return CKR_SIGNATURE_LEN_RANGE;
-  RSA* rsa = CreateKeyFromObject(context->key_);
+  std::shared_ptr<RSA> key = GetRSAKey(context->key_);
+  RSA* rsa = key.get();
   CHECK(RSA_size(rsa) <= kMaxRSAOutputBytes);
   uint8_t buffer[kMaxRSAOutputBytes];
   int length = RSA_public_decrypt(
@@ -1297,7 +1355,6 @@ CK_RV SessionImpl::RSAVerify(OperationContext* context,
       buffer,
       rsa,
       RSA_PKCS1_PADDING);  // Strips PKCS #1 type 1 padding.
-  RSA_free(rsa);
   if (length == -1) {
     LOG(ERROR) << "RSA_public_decrypt failed: " << GetOpenSSLError();
     return CKR_SIGNATURE_INVALID;
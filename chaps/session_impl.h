@@ -9,6 +9,7 @@
 
 #include <map>
 #include <memory>
+#include <set>
 #include <string>
 #include <vector>
 
@@ -51,6 +52,7 @@ class SessionImpl : public Session {
   virtual CK_STATE GetState() const;
   virtual bool IsReadOnly() const;
   virtual bool IsOperationActive(OperationType type) const;
+  virtual void GetOperationKeys(std::set<const Object*>* keys) const;
   // Object management.
   virtual CK_RV CreateObject(const CK_ATTRIBUTE_PTR attributes,
                              int num_attributes,
@@ -196,6 +198,12 @@ class SessionImpl : public Session {
   BIGNUM* ConvertToBIGNUM(const std::string& big_integer);
   // Always returns a non-NULL value.
   RSA* CreateKeyFromObject(const Object* key_object);
+  // Returns the key created from |key_object| by an earlier operation of any
+  // session, or creates one and keeps it with the object until the object's
+  // attributes change. Always returns a non-NULL value. Sessions on different
+  // threads may use the key at once, which OpenSSL 1.0 supports only with the
+  // locking callbacks that ScopedOpenSSL installs.
+  std::shared_ptr<RSA> GetRSAKey(const Object* key_object);
   const EVP_CIPHER* GetOpenSSLCipher(CK_MECHANISM_TYPE mechanism,
                                      size_t key_size);
   const EVP_MD* GetOpenSSLDigest(CK_MECHANISM_TYPE mechanism);
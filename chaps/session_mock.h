@@ -5,6 +5,7 @@
 #ifndef CHAPS_SESSION_MOCK_H_
 #define CHAPS_SESSION_MOCK_H_
 
+#include <set>
 #include <string>
 #include <vector>
 
@@ -26,6 +27,7 @@ class SessionMock : public Session {
   MOCK_CONST_METHOD0(GetState, CK_STATE());
   MOCK_CONST_METHOD0(IsReadOnly, bool());
   MOCK_CONST_METHOD1(IsOperationActive, bool(OperationType));
+  MOCK_CONST_METHOD1(GetOperationKeys, void(std::set<const Object*>*));
   MOCK_METHOD3(CreateObject, CK_RV(const CK_ATTRIBUTE_PTR,
                                    int,
                                    int*));
@@ -571,6 +571,36 @@ TEST_F(TestSession, RSASign) {
   EXPECT_EQ(CKR_OK, session_->VerifyFinal(sig2));
 }
 
+// Test that the parsed keys are kept with the key objects, and that signing
+// again with them gives the same results.
+TEST_F(TestSession, RSASignRepeated) {
+  const int kNumKeys = 4;
+  vector<const Object*> pub(kNumKeys), priv(kNumKeys);
+  for (int i = 0; i < kNumKeys; ++i)
+    GenerateRSAKeyPair(true, 512, &pub[i], &priv[i]);
+  string in(20, 'A');
+  vector<string> sigs(kNumKeys);
+  for (int round = 0; round < 2; ++round) {
+    for (int i = 0; i < kNumKeys; ++i) {
+      EXPECT_EQ(CKR_OK,
+                session_->OperationInit(kSign, CKM_RSA_PKCS, "", priv[i]));
+      int len = 64;
+      string sig;
+      EXPECT_EQ(CKR_OK, session_->OperationSinglePart(kSign, in, &len, &sig));
+      EXPECT_TRUE(priv[i]->GetCache());
+      if (round == 0)
+        sigs[i] = sig;
+      else
+        EXPECT_EQ(sigs[i], sig);
+      EXPECT_EQ(CKR_OK,
+                session_->OperationInit(kVerify, CKM_RSA_PKCS, "", pub[i]));
+      EXPECT_EQ(CKR_OK, session_->OperationUpdate(kVerify, in, NULL, NULL));
+      EXPECT_EQ(CKR_OK, session_->VerifyFinal(sig));
+      EXPECT_TRUE(pub[i]->GetCache());
+    }
+  }
+}
+
 // Test that requests for unsupported mechanisms are handled correctly.
 TEST_F(TestSession, MechanismInvalid) {
   const Object* key = NULL;
@@ -0,0 +1,58 @@
+// Copyright 2016 The Chromium OS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "chaps/slot_locks.h"
+
+#include <base/logging.h>
+
+#include "chaps/slot_manager.h"
+
+using base::AutoLock;
+
+namespace chaps {
+
+SlotLocks::SlotLocks(ReadWriteLock* lock, SlotManager* slot_manager)
+    : lock_(lock), slot_manager_(slot_manager) {
+  CHECK(lock_);
+}
+
+SlotLocks::~SlotLocks() {}
+
+ReadWriteLock* SlotLocks::GetSlotLock(uint64_t slot_id) {
+  AutoLock lock(slot_locks_lock_);
+  std::unique_ptr<ReadWriteLock>& slot_lock = slot_locks_[slot_id];
+  if (!slot_lock)
+    slot_lock.reset(new ReadWriteLock);
+  return slot_lock.get();
+}
+
+ReadWriteLock* SlotLocks::GetSessionLock(uint64_t session_id) {
+  int slot_id = 0;
+  if (!slot_manager_ ||
+      !slot_manager_->GetSessionSlot(static_cast<int>(session_id), &slot_id))
+    return &unknown_session_lock_;
+  return GetSlotLock(slot_id);
+}
+
+AutoSlotLock::AutoSlotLock(SlotLocks* locks, uint64_t slot_id, Mode mode)
+    : AutoSlotLock(locks, locks->GetSlotLock(slot_id), mode) {}
+
+AutoSlotLock::AutoSlotLock(SlotLocks* locks,
+                           ReadWriteLock* slot_lock,
+                           Mode mode)
+    : lock_(*locks->lock()), slot_lock_(slot_lock), mode_(mode) {
+  if (mode_ == kWrite)
+    slot_lock_->WriteAcquire();
+  else
+    slot_lock_->ReadAcquire();
+}
+
+AutoSlotLock::~AutoSlotLock() {
+  if (mode_ == kWrite)
+    slot_lock_->WriteRelease();
+  else
+    slot_lock_->ReadRelease();
+}
+
+}  // namespace chaps
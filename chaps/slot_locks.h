@@ -0,0 +1,89 @@
+// Copyright 2016 The Chromium OS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef CHAPS_SLOT_LOCKS_H_
+#define CHAPS_SLOT_LOCKS_H_
+
+#include <stdint.h>
+
+#include <map>
+#include <memory>
+
+#include <base/macros.h>
+#include <base/synchronization/lock.h>
+
+#include "chaps/read_write_lock.h"
+
+namespace chaps {
+
+class SlotManager;
+
+// SlotLocks holds a ReadWriteLock for each slot, so that calls on different
+// slots never wait for each other. Calls hold the lock of the slot they work on
+// for reading, or for writing if they change or delete objects that other
+// sessions of the slot may be using. Each call also holds |lock| for reading;
+// it is held for writing only while slots or isolates are added or removed.
+class SlotLocks {
+ public:
+  // Neither pointer is owned. If |slot_manager| is NULL, all sessions share
+  // one lock.
+  SlotLocks(ReadWriteLock* lock, SlotManager* slot_manager);
+  ~SlotLocks();
+
+  ReadWriteLock* lock() { return lock_; }
+
+  // Returns the lock for |slot_id|.
+  ReadWriteLock* GetSlotLock(uint64_t slot_id);
+  // Returns the lock for the slot |session_id| belongs to. Unknown sessions
+  // share a lock of their own.
+  ReadWriteLock* GetSessionLock(uint64_t session_id);
+
+ private:
+  ReadWriteLock* lock_;
+  SlotManager* slot_manager_;
+  // Protects |slot_locks_|. Locks are never removed, so the pointers handed
+  // out stay valid.
+  base::Lock slot_locks_lock_;
+  std::map<uint64_t, std::unique_ptr<ReadWriteLock>> slot_locks_;
+  ReadWriteLock unknown_session_lock_;
+
+  DISALLOW_COPY_AND_ASSIGN(SlotLocks);
+};
+
+// Holds the SlotLocks lock for reading and the lock of one slot for reading or
+// writing for the lifetime of the instance.
+class AutoSlotLock {
+ public:
+  enum Mode {
+    kRead,
+    kWrite
+  };
+
+  AutoSlotLock(SlotLocks* locks, uint64_t slot_id, Mode mode);
+  ~AutoSlotLock();
+
+ protected:
+  AutoSlotLock(SlotLocks* locks, ReadWriteLock* slot_lock, Mode mode);
+
+ private:
+  AutoReadLock lock_;
+  ReadWriteLock* slot_lock_;
+  Mode mode_;
+
+  DISALLOW_COPY_AND_ASSIGN(AutoSlotLock);
+};
+
+// Like AutoSlotLock, for the slot a session belongs to.
+class AutoSessionLock : public AutoSlotLock {
+ public:
+  AutoSessionLock(SlotLocks* locks, uint64_t session_id, Mode mode)
+      : AutoSlotLock(locks, locks->GetSessionLock(session_id), mode) {}
+
+ private:
+  DISALLOW_COPY_AND_ASSIGN(AutoSessionLock);
+};
+
+}  // namespace chaps
+
+#endif  // CHAPS_SLOT_LOCKS_H_
@@ -56,6 +56,16 @@ class SlotManager {
       int slot_id) = 0;
   virtual bool GetSession(const brillo::SecureBlob& isolate_credential,
       int session_id, Session** session) const = 0;
+  // Finds the slot a session belongs to, without checking whether the session
+  // is accessible. Returns false if the session doesn't exist.
+  virtual bool GetSessionSlot(int session_id, int* slot_id) const = 0;
+  // Returns true if the token in |slot_id| holds NetHSM keys that have been
+  // deleted from the NetHSM.
+  virtual bool HasStaleKeys(int slot_id) const = 0;
+  // Removes the objects of such keys from the token, except for keys that
+  // operations of the slot's sessions are using. Must be called while no other
+  // call on the slot is in progress.
+  virtual void RemoveStaleKeys(int slot_id) = 0;
 };
 
 }  // namespace chaps
@@ -9,6 +9,7 @@
 #include <limits>
 #include <map>
 #include <memory>
+#include <set>
 #include <string>
 #include <vector>
 
@@ -216,6 +217,7 @@ int SlotManagerImpl::OpenSession(const SecureBlob& isolate_credential,
       is_read_only));
   CHECK(session.get());
   int session_id = CreateHandle();
+  AutoLock lock(sessions_lock_);
   slot_list_[slot_id].sessions[session_id] = session;
   session_slot_map_[session_id] = slot_id;
   return session_id;
@@ -223,15 +225,24 @@ int SlotManagerImpl::OpenSession(const SecureBlob& isolate_credential,
 
 bool SlotManagerImpl::CloseSession(const SecureBlob& isolate_credential,
                                    int session_id) {
-  Session* session = NULL;
-  if (!GetSession(isolate_credential, session_id, &session))
+  // The session is destroyed after |sessions_lock_| has been released.
+  shared_ptr<Session> session;
+  AutoLock lock(sessions_lock_);
+  map<int, int>::iterator session_slot_iter =
+      session_slot_map_.find(session_id);
+  if (session_slot_iter == session_slot_map_.end())
     return false;
-  CHECK(session);
-  int slot_id = session_slot_map_[session_id];
+  int slot_id = session_slot_iter->second;
   CHECK_LT(static_cast<size_t>(slot_id), slot_list_.size());
-  CHECK(IsTokenAccessible(isolate_credential, slot_id));
-  session_slot_map_.erase(session_id);
-  slot_list_[slot_id].sessions.erase(session_id);
+  if (!IsTokenAccessible(isolate_credential, slot_id))
+    return false;
+  map<int, shared_ptr<Session>>::iterator session_iter =
+      slot_list_[slot_id].sessions.find(session_id);
+  if (session_iter == slot_list_[slot_id].sessions.end())
+    return false;
+  session = session_iter->second;
+  session_slot_map_.erase(session_slot_iter);
+  slot_list_[slot_id].sessions.erase(session_iter);
   return true;
 }
 
@@ -240,18 +251,21 @@ void SlotManagerImpl::CloseAllSessions(const SecureBlob& isolate_credential,
   CHECK_LT(static_cast<size_t>(slot_id), slot_list_.size());
   CHECK(IsTokenAccessible(isolate_credential, slot_id));
 
-  for (map<int, shared_ptr<Session>>::iterator iter =
-           slot_list_[slot_id].sessions.begin();
-       iter != slot_list_[slot_id].sessions.end();
+  // The sessions are destroyed after |sessions_lock_| has been released.
+  map<int, shared_ptr<Session>> sessions;
+  AutoLock lock(sessions_lock_);
+  sessions.swap(slot_list_[slot_id].sessions);
+  for (map<int, shared_ptr<Session>>::iterator iter = sessions.begin();
+       iter != sessions.end();
        ++iter) {
     session_slot_map_.erase(iter->first);
   }
-  slot_list_[slot_id].sessions.clear();
 }
 
 bool SlotManagerImpl::GetSession(const SecureBlob& isolate_credential,
                                  int session_id, Session** session) const {
   CHECK(session);
+  AutoLock lock(sessions_lock_);
 
   // Lookup which slot this session belongs to.
   map<int, int>::const_iterator session_slot_iter =
@@ -273,6 +287,43 @@ bool SlotManagerImpl::GetSession(const SecureBlob& isolate_credential,
   return true;
 }
 
+bool SlotManagerImpl::GetSessionSlot(int session_id, int* slot_id) const {
+  CHECK(slot_id);
+  AutoLock lock(sessions_lock_);
+  map<int, int>::const_iterator session_slot_iter =
+      session_slot_map_.find(session_id);
+  if (session_slot_iter == session_slot_map_.end())
+    return false;
+  *slot_id = session_slot_iter->second;
+  return true;
+}
+
+bool SlotManagerImpl::HasStaleKeys(int slot_id) const {
+  if (static_cast<size_t>(slot_id) >= slot_list_.size() ||
+      !IsTokenPresent(slot_id))
+    return false;
+  const shared_ptr<NetUtility>& net_utility = slot_list_[slot_id].net_utility;
+  return net_utility && net_utility->HasStaleKeys();
+}
+
+void SlotManagerImpl::RemoveStaleKeys(int slot_id) {
+  if (!HasStaleKeys(slot_id))
+    return;
+  std::set<const Object*> in_use;
+  {
+    AutoLock lock(sessions_lock_);
+    const map<int, shared_ptr<Session>>& sessions =
+        slot_list_[slot_id].sessions;
+    for (map<int, shared_ptr<Session>>::const_iterator iter =
+             sessions.begin();
+         iter != sessions.end();
+         ++iter) {
+      iter->second->GetOperationKeys(&in_use);
+    }
+  }
+  slot_list_[slot_id].net_utility->RemoveStaleKeys(in_use);
+}
+
 bool SlotManagerImpl::OpenIsolate(SecureBlob* isolate_credential,
                                   bool* new_isolate_created) {
   VLOG(1) << "SlotManagerImpl::OpenIsolate enter";
@@ -70,6 +70,9 @@ class SlotManagerImpl : public SlotManager,
                                 int slot_id);
   virtual bool GetSession(const brillo::SecureBlob& isolate_credential,
                           int session_id, Session** session) const;
+  virtual bool GetSessionSlot(int session_id, int* slot_id) const;
+  virtual bool HasStaleKeys(int slot_id) const;
+  virtual void RemoveStaleKeys(int slot_id);
 
   // TokenManagerInterface methods.
   virtual bool OpenIsolate(brillo::SecureBlob* isolate_credential,
@@ -181,6 +184,9 @@ class SlotManagerImpl : public SlotManager,
   // Key: A session identifier.
   // Value: The identifier of the associated slot.
   std::map<int, int> session_slot_map_;
+  // Protects |session_slot_map_| and the session maps of all slots, which
+  // change while calls on other slots use them.
+  mutable base::Lock sessions_lock_;
   std::map<brillo::SecureBlob, Isolate> isolate_map_;
   base::Lock handle_generator_lock_;
   bool auto_load_system_token_;
@@ -37,6 +37,9 @@ class SlotManagerMock : public SlotManager {
   MOCK_METHOD2(CloseAllSessions, void(const brillo::SecureBlob&, int));
   MOCK_CONST_METHOD3(GetSession, bool(const brillo::SecureBlob&, int,
                                       Session**));
+  MOCK_CONST_METHOD2(GetSessionSlot, bool(int, int*));
+  MOCK_CONST_METHOD1(HasStaleKeys, bool(int));
+  MOCK_METHOD1(RemoveStaleKeys, void(int));
 
  private:
   DISALLOW_COPY_AND_ASSIGN(SlotManagerMock);
@@ -288,10 +288,15 @@ TEST_F(TestSlotManager, TestSessions) {
   EXPECT_TRUE(slot_manager_->GetSession(ic_, id2, &s2));
   EXPECT_TRUE(s2 != NULL);
   EXPECT_NE(s1, s2);
+  int slot_id = -1;
+  EXPECT_TRUE(slot_manager_->GetSessionSlot(id1, &slot_id));
+  EXPECT_EQ(0, slot_id);
   EXPECT_TRUE(slot_manager_->CloseSession(ic_, id1));
   EXPECT_FALSE(slot_manager_->CloseSession(ic_, id1));
+  EXPECT_FALSE(slot_manager_->GetSessionSlot(id1, &slot_id));
   slot_manager_->CloseAllSessions(ic_, 0);
   EXPECT_FALSE(slot_manager_->CloseSession(ic_, id2));
+  EXPECT_FALSE(slot_manager_->GetSessionSlot(id2, &slot_id));
 }
 
 TEST_F(TestSlotManager, TestLoadTokenEvents) {
@@ -6,12 +6,28 @@
 
 #include <stdint.h>
 
+#include <iterator>
 #include <vector>
 
 #include "base/logging.h"
 
 namespace quipper {
 
+AddressMapper::AddressMapper(const AddressMapper& other)
+    : mappings_(other.mappings_),
+      page_alignment_(other.page_alignment_) {
+  // The indexes point into |mappings_|, so they must be rebuilt rather than
+  // copied.
+  for (MappingList::iterator iter = mappings_.begin(); iter != mappings_.end();
+       ++iter) {
+    real_addr_to_mapped_range_.insert(std::make_pair(iter->real_addr, iter));
+    if (iter->unmapped_space_after >= GetFreeSpaceIndexThreshold()) {
+      free_space_index_.insert(free_space_index_.end(),
+                               std::make_pair(iter->mapped_addr, iter));
+    }
+  }
+}
+
 bool AddressMapper::MapWithID(const uint64_t real_addr,
                               const uint64_t size,
                               const uint64_t id,
@@ -37,13 +53,19 @@ bool AddressMapper::MapWithID(const uint64_t real_addr,
   }
 
   // Check for collision with an existing mapping.  This must be an overlap that
-  // does not result in one range being completely covered by another
-  MappingList::iterator iter;
+  // does not result in one range being completely covered by another.
+  // Mappings do not overlap in real space, so the ranges that intersect the new
+  // one are exactly those walked backwards from the last mapping that starts
+  // within the new range, up to the first one that does not intersect it.
   std::vector<MappingList::iterator> mappings_to_delete;
   MappingList::iterator old_range_iter = mappings_.end();
-  for (iter = mappings_.begin(); iter != mappings_.end(); ++iter) {
+  MappingIndex::iterator index_iter =
+      real_addr_to_mapped_range_.upper_bound(range.real_addr + range.size - 1);
+  while (index_iter != real_addr_to_mapped_range_.begin()) {
+    --index_iter;
+    MappingList::iterator iter = index_iter->second;
     if (!iter->Intersects(range))
-      continue;
+      break;
     // Quit if existing ranges that collide aren't supposed to be removed.
     if (!remove_existing_mappings)
       return false;
@@ -120,7 +142,7 @@ bool AddressMapper::MapWithID(const uint64_t real_addr,
   if (mappings_.empty()) {
     range.mapped_addr = page_offset;
     range.unmapped_space_after = UINT64_MAX - range.size - page_offset;
-    mappings_.push_back(range);
+    InsertMapping(mappings_.end(), range);
     return true;
   }
 
@@ -129,54 +151,25 @@ bool AddressMapper::MapWithID(const uint64_t real_addr,
     range.mapped_addr = page_offset;
     range.unmapped_space_after =
         mappings_.begin()->mapped_addr - range.size - page_offset;
-    mappings_.push_front(range);
+    InsertMapping(mappings_.begin(), range);
     return true;
   }
 
   // Otherwise, search through the existing mappings for a free block after one
-  // of them.
-  for (iter = mappings_.begin(); iter != mappings_.end(); ++iter) {
-    MappedRange& existing_mapping = *iter;
-    if (page_alignment_) {
-      uint64_t end_of_existing_mapping =
-          existing_mapping.mapped_addr + existing_mapping.size;
-
-      // Find next page boundary after end of this existing mapping.
-      uint64_t existing_page_offset = GetAlignedOffset(end_of_existing_mapping);
-      uint64_t next_page_boundary =
-          existing_page_offset
-              ? end_of_existing_mapping - existing_page_offset + page_alignment_
-              : end_of_existing_mapping;
-      // Compute where the new mapping would end if it were aligned to this
-      // page boundary.
-      uint64_t mapping_offset = GetAlignedOffset(range.real_addr);
-      uint64_t end_of_new_mapping =
-          next_page_boundary + mapping_offset + range.size;
-      uint64_t end_of_unmapped_space_after =
-          end_of_existing_mapping + existing_mapping.unmapped_space_after;
-
-      // Check if there's enough room in the unmapped space following the
-      // current existing mapping for the page-aligned mapping.
-      if (end_of_new_mapping > end_of_unmapped_space_after)
-        continue;
-
-      range.mapped_addr = next_page_boundary + mapping_offset;
-      range.unmapped_space_after =
-          end_of_unmapped_space_after - end_of_new_mapping;
-      existing_mapping.unmapped_space_after =
-          range.mapped_addr - end_of_existing_mapping;
-    } else {
-      if (existing_mapping.unmapped_space_after < range.size)
-        continue;
-      // Insert the new mapping range immediately after the existing one.
-      range.mapped_addr = existing_mapping.mapped_addr + existing_mapping.size;
-      range.unmapped_space_after =
-          existing_mapping.unmapped_space_after - range.size;
-      existing_mapping.unmapped_space_after = 0;
+  // of them. A mapping followed by less unmapped space than the size of the new
+  // range cannot hold it, so when the new range is at least as large as the
+  // free space index threshold, only the indexed mappings need to be checked.
+  if (range.size >= GetFreeSpaceIndexThreshold()) {
+    for (const auto& free_space : free_space_index_) {
+      if (MapAfter(free_space.second, &range))
+        return true;
+    }
+  } else {
+    for (MappingList::iterator iter = mappings_.begin();
+         iter != mappings_.end(); ++iter) {
+      if (MapAfter(iter, &range))
+        return true;
     }
-
-    mappings_.insert(++iter, range);
-    return true;
   }
 
   // If it still hasn't succeeded in mapping, it means there is no free space in
@@ -200,14 +193,11 @@ void AddressMapper::DumpToLog() const {
 bool AddressMapper::GetMappedAddress(const uint64_t real_addr,
                                      uint64_t* mapped_addr) const {
   CHECK(mapped_addr);
-  MappingList::const_iterator iter;
-  for (iter = mappings_.begin(); iter != mappings_.end(); ++iter) {
-    if (!iter->ContainsAddress(real_addr))
-      continue;
-    *mapped_addr = iter->mapped_addr + real_addr - iter->real_addr;
-    return true;
-  }
-  return false;
+  MappingList::const_iterator iter = FindMappingContaining(real_addr);
+  if (iter == mappings_.end())
+    return false;
+  *mapped_addr = iter->mapped_addr + real_addr - iter->real_addr;
+  return true;
 }
 
 bool AddressMapper::GetMappedIDAndOffset(const uint64_t real_addr,
@@ -215,15 +205,12 @@ bool AddressMapper::GetMappedIDAndOffset(const uint64_t real_addr,
                                          uint64_t* offset) const {
   CHECK(id);
   CHECK(offset);
-  MappingList::const_iterator iter;
-  for (iter = mappings_.begin(); iter != mappings_.end(); ++iter) {
-    if (!iter->ContainsAddress(real_addr))
-      continue;
-    *id = iter->id;
-    *offset = real_addr - iter->real_addr + iter->offset_base;
-    return true;
-  }
-  return false;
+  MappingList::const_iterator iter = FindMappingContaining(real_addr);
+  if (iter == mappings_.end())
+    return false;
+  *id = iter->id;
+  *offset = real_addr - iter->real_addr + iter->offset_base;
+  return true;
 }
 
 uint64_t AddressMapper::GetMaxMappedLength() const {
@@ -239,16 +226,98 @@ uint64_t AddressMapper::GetMaxMappedLength() const {
   return max - min;
 }
 
+bool AddressMapper::MapAfter(MappingList::iterator mapping_iter,
+                             MappedRange* range) {
+  const MappedRange& existing_mapping = *mapping_iter;
+  uint64_t existing_unmapped_space_after;
+  if (page_alignment_) {
+    uint64_t end_of_existing_mapping =
+        existing_mapping.mapped_addr + existing_mapping.size;
+
+    // Find next page boundary after end of this existing mapping.
+    uint64_t existing_page_offset = GetAlignedOffset(end_of_existing_mapping);
+    uint64_t next_page_boundary =
+        existing_page_offset
+            ? end_of_existing_mapping - existing_page_offset + page_alignment_
+            : end_of_existing_mapping;
+    // Compute where the new mapping would end if it were aligned to this
+    // page boundary.
+    uint64_t mapping_offset = GetAlignedOffset(range->real_addr);
+    uint64_t end_of_new_mapping =
+        next_page_boundary + mapping_offset + range->size;
+    uint64_t end_of_unmapped_space_after =
+        end_of_existing_mapping + existing_mapping.unmapped_space_after;
+
+    // Check if there's enough room in the unmapped space following the
+    // current existing mapping for the page-aligned mapping.
+    if (end_of_new_mapping > end_of_unmapped_space_after)
+      return false;
+
+    range->mapped_addr = next_page_boundary + mapping_offset;
+    range->unmapped_space_after =
+        end_of_unmapped_space_after - end_of_new_mapping;
+    existing_unmapped_space_after =
+        range->mapped_addr - end_of_existing_mapping;
+  } else {
+    if (existing_mapping.unmapped_space_after < range->size)
+      return false;
+    // Insert the new mapping range immediately after the existing one.
+    range->mapped_addr = existing_mapping.mapped_addr + existing_mapping.size;
+    range->unmapped_space_after =
+        existing_mapping.unmapped_space_after - range->size;
+    existing_unmapped_space_after = 0;
+  }
+
+  SetUnmappedSpaceAfter(mapping_iter, existing_unmapped_space_after);
+  InsertMapping(std::next(mapping_iter), *range);
+  return true;
+}
+
+void AddressMapper::InsertMapping(MappingList::iterator position,
+                                  const MappedRange& range) {
+  MappingList::iterator iter = mappings_.insert(position, range);
+  real_addr_to_mapped_range_.insert(std::make_pair(range.real_addr, iter));
+  if (range.unmapped_space_after >= GetFreeSpaceIndexThreshold())
+    free_space_index_.insert(std::make_pair(range.mapped_addr, iter));
+}
+
 void AddressMapper::Unmap(MappingList::iterator mapping_iter) {
+  const MappedRange& range = *mapping_iter;
   // Add the freed up space to the free space counter of the previous
   // mapped region, if it exists.
   if (mapping_iter != mappings_.begin()) {
-    const MappedRange& range = *mapping_iter;
     MappingList::iterator previous_range_iter = std::prev(mapping_iter);
-    previous_range_iter->unmapped_space_after +=
-        range.size + range.unmapped_space_after;
+    SetUnmappedSpaceAfter(previous_range_iter,
+                          previous_range_iter->unmapped_space_after +
+                              range.size + range.unmapped_space_after);
   }
+  real_addr_to_mapped_range_.erase(range.real_addr);
+  free_space_index_.erase(range.mapped_addr);
   mappings_.erase(mapping_iter);
 }
 
+AddressMapper::MappingList::const_iterator
+AddressMapper::FindMappingContaining(uint64_t real_addr) const {
+  // Find the last mapping that starts at or before |real_addr|. It is the only
+  // one that can contain it.
+  MappingIndex::const_iterator index_iter =
+      real_addr_to_mapped_range_.upper_bound(real_addr);
+  if (index_iter == real_addr_to_mapped_range_.begin())
+    return mappings_.end();
+  --index_iter;
+  MappingList::const_iterator iter = index_iter->second;
+  if (!iter->ContainsAddress(real_addr))
+    return mappings_.end();
+  return iter;
+}
+
+void AddressMapper::SetUnmappedSpaceAfter(MappingList::iterator mapping_iter,
+                                          uint64_t unmapped_space_after) {
+  mapping_iter->unmapped_space_after = unmapped_space_after;
+  if (unmapped_space_after >= GetFreeSpaceIndexThreshold())
+    free_space_index_[mapping_iter->mapped_addr] = mapping_iter;
+  else
+    free_space_index_.erase(mapping_iter->mapped_addr);
+}
+
 }  // namespace quipper
@@ -9,6 +9,7 @@
 #include <stdint.h>
 
 #include <list>
+#include <map>
 
 namespace quipper {
 
@@ -19,7 +20,7 @@ class AddressMapper {
   // Copy constructor: copies mappings from |source| to this AddressMapper. This
   // is useful for copying mappings from parent to child process upon fork(). It
   // is also useful to copy kernel mappings to any process that is created.
-  AddressMapper(const AddressMapper& other) = default;
+  AddressMapper(const AddressMapper& other);
 
   // Maps a new address range [real_addr, real_addr + length) to quipper space.
   // |id| is an identifier value to be stored along with the mapping.
@@ -116,13 +117,43 @@ class AddressMapper {
     }
   };
 
-  // TODO(sque): implement with set or map to improve searching.
+  // Mappings are stored in order of quipper space address.
   typedef std::list<MappedRange> MappingList;
 
+  // Index of mappings keyed by the starting address of the indexed ranges.
+  // Values point to elements of |mappings_|.
+  typedef std::map<uint64_t, MappingList::iterator> MappingIndex;
+
+  AddressMapper& operator=(const AddressMapper&) = delete;
+
+  // Inserts |range| into |mappings_| before |position| and adds it to the
+  // indexes.
+  void InsertMapping(MappingList::iterator position, const MappedRange& range);
+
   // Removes an existing address mapping, given by an iterator pointing to an
   // element of |mappings_|.
   void Unmap(MappingList::iterator mapping_iter);
 
+  // Returns an iterator to the mapping containing |real_addr|, or
+  // |mappings_.end()| if there is none.
+  MappingList::const_iterator FindMappingContaining(uint64_t real_addr) const;
+
+  // Sets the unmapped space after |mapping_iter| to |unmapped_space_after| and
+  // updates |free_space_index_| accordingly.
+  void SetUnmappedSpaceAfter(MappingList::iterator mapping_iter,
+                             uint64_t unmapped_space_after);
+
+  // Returns the smallest amount of unmapped space after a mapping that is
+  // tracked in |free_space_index_|. Mappings followed by less unmapped space
+  // than this can only hold new ranges that are smaller than this amount.
+  uint64_t GetFreeSpaceIndexThreshold() const {
+    return page_alignment_ ? page_alignment_ : 1;
+  }
+
+  // Attempts to place |range| in the unmapped space after the mapping at
+  // |mapping_iter|. On success, inserts |range| and returns true.
+  bool MapAfter(MappingList::iterator mapping_iter, MappedRange* range);
+
   // Given an address, and a nonzero, power-of-two |page_alignment_| value,
   // returns the offset of the address from the start of the page it is on.
   // Equivalent to |addr % page_alignment_|. Should not be called if
@@ -134,6 +165,18 @@ class AddressMapper {
   // Container for all the existing mappings.
   MappingList mappings_;
 
+  // Maps the real address of each mapping to its element in |mappings_|.
+  // Mappings never overlap in real space, so this is sufficient to find the
+  // range containing any address with a single ordered lookup.
+  MappingIndex real_addr_to_mapped_range_;
+
+  // Maps the quipper space address of each mapping that is followed by at
+  // least GetFreeSpaceIndexThreshold() bytes of unmapped space to its element
+  // in |mappings_|. When nothing is ever unmapped, this only contains the last
+  // mapping, so finding room for a new range does not require walking every
+  // existing mapping.
+  MappingIndex free_space_index_;
+
   // If set to nonzero, use this as a mapping page boundary. If a mapping does
   // not begin at a multiple of this value, the remapped address should be given
   // an offset that is the remainder.
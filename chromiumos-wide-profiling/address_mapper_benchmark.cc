@@ -0,0 +1,100 @@
+// Copyright 2016 The Chromium OS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// Measures how AddressMapper insertion and lookup times scale with the number
+// of mapped ranges, using synthetic mmap-heavy address spaces.
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include "base/logging.h"
+
+#include "chromiumos-wide-profiling/address_mapper.h"
+
+namespace {
+
+// Page alignment used by PerfParser for process mappers.
+const uint64_t kPageAlignment = 0x1000;
+
+// Distance between the starts of consecutive synthetic mappings. Leaves a gap
+// between mappings so that lookups can miss.
+const uint64_t kMappingSpacing = 0x100000;
+
+// Number of lookups performed for each mapper size.
+const int kNumLookups = 1000000;
+
+// Mapper sizes to benchmark.
+const int kNumMappings[] = {10, 100, 1000, 10000, 100000};
+
+double SecondsSince(std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration<double>(
+      std::chrono::steady_clock::now() - start).count();
+}
+
+// Maps |num_mappings| ranges of random page-multiple sizes, in random order,
+// the way the MMAP events of a large process would. Returns the time taken.
+double MapRanges(int num_mappings, std::mt19937_64* rng,
+                 quipper::AddressMapper* mapper) {
+  std::vector<uint64_t> starts;
+  for (int i = 0; i < num_mappings; ++i)
+    starts.push_back(i * kMappingSpacing);
+  std::shuffle(starts.begin(), starts.end(), *rng);
+
+  std::uniform_int_distribution<uint64_t> num_pages(1, 128);
+  auto start_time = std::chrono::steady_clock::now();
+  for (size_t i = 0; i < starts.size(); ++i) {
+    uint64_t size = num_pages(*rng) * kPageAlignment;
+    CHECK(mapper->MapWithID(starts[i], size, i, 0, true));
+  }
+  return SecondsSince(start_time);
+}
+
+// Looks up random addresses within the mapped area of |mapper|. Returns the
+// time taken.
+double LookUpAddresses(int num_mappings, std::mt19937_64* rng,
+                       const quipper::AddressMapper& mapper) {
+  std::uniform_int_distribution<uint64_t> addr(
+      0, num_mappings * kMappingSpacing - 1);
+  std::vector<uint64_t> addrs;
+  for (int i = 0; i < kNumLookups; ++i)
+    addrs.push_back(addr(*rng));
+
+  uint64_t num_hits = 0;
+  auto start_time = std::chrono::steady_clock::now();
+  for (uint64_t real_addr : addrs) {
+    uint64_t id, offset;
+    if (mapper.GetMappedIDAndOffset(real_addr, &id, &offset))
+      ++num_hits;
+  }
+  double elapsed = SecondsSince(start_time);
+  CHECK_GT(num_hits, 0U);
+  return elapsed;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  std::mt19937_64 rng(0);
+  std::cout << std::setw(10) << "mappings" << std::setw(16) << "map ns/range"
+            << std::setw(18) << "lookup ns/addr" << std::endl;
+  for (int num_mappings : kNumMappings) {
+    quipper::AddressMapper mapper;
+    mapper.set_page_alignment(kPageAlignment);
+    double map_time = MapRanges(num_mappings, &rng, &mapper);
+    double lookup_time = LookUpAddresses(num_mappings, &rng, mapper);
+    std::cout << std::setw(10) << num_mappings
+              << std::setw(16) << std::fixed << std::setprecision(1)
+              << map_time * 1e9 / num_mappings
+              << std::setw(18) << lookup_time * 1e9 / kNumLookups
+              << std::endl;
+  }
+  return EXIT_SUCCESS;
+}
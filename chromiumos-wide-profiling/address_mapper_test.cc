@@ -459,4 +459,81 @@ TEST_F(AddressMapperTest, MisalignedSplitRangeWithPageAlignment) {
   EXPECT_FALSE(MapRange(kMisalignedRange, true));
 }
 
+// Test that a range freed by unmapping is reused by a later mapping that fits
+// in it, in preference to the space after the last mapping.
+TEST_F(AddressMapperTest, ReuseUnmappedSpace) {
+  const Range kRange0(0x01000, 0x1000, 0x1, 0);
+  const Range kRange1(0x10000, 0x4000, 0x2, 0);
+  const Range kRange2(0x20000, 0x1000, 0x3, 0);
+  ASSERT_TRUE(MapRange(kRange0, false));
+  ASSERT_TRUE(MapRange(kRange1, false));
+  ASSERT_TRUE(MapRange(kRange2, false));
+
+  // Replaces |kRange1|, but is too big to fit in the space it leaves behind.
+  const Range kBigRange(0x0f000, 0x6000, 0x4, 0);
+  ASSERT_TRUE(MapRange(kBigRange, true));
+  EXPECT_EQ(3U, mapper_->GetNumMappedRanges());
+  TestMappedRange(kBigRange, 0x6000);
+
+  // This one fits in the space that |kRange1| used to occupy.
+  const Range kSmallRange(0x30000, 0x3000, 0x5, 0);
+  ASSERT_TRUE(MapRange(kSmallRange, false));
+  TestMappedRange(kRange0, 0);
+  TestMappedRange(kSmallRange, 0x1000);
+  TestMappedRange(kRange2, 0x5000);
+  TestMappedRange(kBigRange, 0x6000);
+}
+
+// Test that a copied mapper has the same mappings as the original, and that
+// the two can be modified independently.
+TEST_F(AddressMapperTest, CopyMapper) {
+  mapper_->set_page_alignment(0x1000);
+  for (const Range& range : kMapRanges)
+    ASSERT_TRUE(MapRange(range, false));
+
+  std::unique_ptr<AddressMapper> original(mapper_.release());
+  mapper_.reset(new AddressMapper(*original));
+  EXPECT_EQ(arraysize(kMapRanges), mapper_->GetNumMappedRanges());
+  for (const Range& range : kMapRanges) {
+    TestMappedRange(range,
+                    GetMappedAddressFromRanges(kMapRanges,
+                                               arraysize(kMapRanges),
+                                               range.addr));
+  }
+
+  // Add a range to the copy only.
+  const Range kNewRange(0x50000000, 0x1000, 0x1234, 0);
+  ASSERT_TRUE(MapRange(kNewRange, false));
+  EXPECT_EQ(arraysize(kMapRanges) + 1, mapper_->GetNumMappedRanges());
+  EXPECT_EQ(arraysize(kMapRanges), original->GetNumMappedRanges());
+
+  uint64_t mapped_addr;
+  EXPECT_TRUE(mapper_->GetMappedAddress(kNewRange.addr, &mapped_addr));
+  EXPECT_FALSE(original->GetMappedAddress(kNewRange.addr, &mapped_addr));
+}
+
+// Map a large number of ranges in descending order of real address and make
+// sure that all of them can be looked up.
+TEST_F(AddressMapperTest, MapManyRanges) {
+  mapper_->set_page_alignment(0x1000);
+
+  const int kNumRanges = 10000;
+  const uint64_t kRangeSpacing = 0x10000;
+  const uint64_t kRangeSize = 0x8000;
+  for (int i = kNumRanges - 1; i >= 0; --i) {
+    ASSERT_TRUE(MapRange(Range(i * kRangeSpacing, kRangeSize, i, 0), false));
+  }
+  EXPECT_EQ(static_cast<size_t>(kNumRanges), mapper_->GetNumMappedRanges());
+  EXPECT_EQ(kNumRanges * kRangeSize, mapper_->GetMaxMappedLength());
+
+  for (int i = 0; i < kNumRanges; ++i) {
+    const Range range(i * kRangeSpacing, kRangeSize, i, 0);
+    uint64_t mapped_addr;
+    ASSERT_TRUE(mapper_->GetMappedAddress(range.addr, &mapped_addr));
+    EXPECT_EQ((kNumRanges - 1 - i) * kRangeSize, mapped_addr);
+    EXPECT_FALSE(
+        mapper_->GetMappedAddress(range.addr + range.size, &mapped_addr));
+  }
+}
+
 }  // namespace quipper
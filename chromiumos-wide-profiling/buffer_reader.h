@@ -29,16 +29,23 @@ class BufferReader : public DataReader {
 
   bool ReadData(const size_t size, void* dest) override;
 
+  const void* GetDataInPlace(size_t offset, size_t size) const override {
+    if (offset > size_ || size > size_ - offset)
+      return nullptr;
+    return buffer_ + offset;
+  }
+
   // Reads |size| bytes of the buffer as a null-terminated string into |str|.
   // Trailing nulls, if any, are not added to the string, but they are skipped
   // over. If there is no null terminator within these |size| bytes, then the
   // string is automatically terminated after |size| bytes.
   bool ReadString(const size_t size, string* str) override;
 
- private:
+ protected:
   // The data buffer from which to read.
   const char* buffer_;
 
+ private:
   // Data read offset from the start of |buffer_|.
   size_t offset_;
 };
@@ -0,0 +1,134 @@
+// Copyright 2016 The Chromium OS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "chromiumos-wide-profiling/build_id_cache.h"
+
+#include <stdio.h>
+#include <sys/sysmacros.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#include <sstream>
+#include <vector>
+
+#include "base/logging.h"
+
+#include "chromiumos-wide-profiling/binary_data_utils.h"
+#include "chromiumos-wide-profiling/file_utils.h"
+
+namespace quipper {
+
+namespace {
+
+// Written in place of the build ID of a file that is known to have none.
+const char kNoBuildId[] = "-";
+
+}  // namespace
+
+// static
+BuildIdCache::Key BuildIdCache::MakeKey(const string& name,
+                                        const struct stat& s) {
+  return Key(name, major(s.st_dev), minor(s.st_dev), s.st_ino, s.st_size,
+             s.st_mtim.tv_sec, s.st_mtim.tv_nsec);
+}
+
+bool BuildIdCache::Lookup(const string& name, const struct stat& s,
+                          string* build_id) const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  const auto it = build_ids_.find(MakeKey(name, s));
+  if (it == build_ids_.end())
+    return false;
+  *build_id = it->second;
+  return true;
+}
+
+void BuildIdCache::Insert(const string& name, const struct stat& s,
+                          const string& build_id) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  build_ids_[MakeKey(name, s)] = build_id;
+}
+
+size_t BuildIdCache::size() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return build_ids_.size();
+}
+
+// Each entry is stored on one line as:
+//   <major> <minor> <inode> <size> <mtime sec> <mtime nsec> <build ID> <name>
+// where the build ID is in hexadecimal, or kNoBuildId. The name comes last
+// because it may contain spaces.
+bool BuildIdCache::ReadFromFile(const string& filename) {
+  std::vector<char> contents;
+  if (!FileToBuffer(filename, &contents))
+    return false;
+
+  std::istringstream input(string(contents.begin(), contents.end()));
+  string line;
+  while (std::getline(input, line)) {
+    std::istringstream fields(line);
+    uint32_t maj, min;
+    uint64_t ino, size;
+    int64_t mtime_sec, mtime_nsec;
+    string build_id_hex, name;
+    fields >> maj >> min >> ino >> size >> mtime_sec >> mtime_nsec
+           >> build_id_hex;
+    if (!fields || fields.get() != ' ' || !std::getline(fields, name) ||
+        name.empty()) {
+      LOG(ERROR) << "Malformed build ID cache entry in " << filename << ": "
+                 << line;
+      return false;
+    }
+
+    string build_id;
+    if (build_id_hex != kNoBuildId) {
+      build_id.resize(build_id_hex.size() / 2);
+      if (build_id_hex.size() % 2 != 0 ||
+          !HexStringToRawData(build_id_hex,
+                              reinterpret_cast<u8*>(&build_id[0]),
+                              build_id.size())) {
+        LOG(ERROR) << "Invalid build ID in " << filename << ": " << line;
+        return false;
+      }
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    build_ids_[Key(name, maj, min, ino, size, mtime_sec, mtime_nsec)] =
+        build_id;
+  }
+  return true;
+}
+
+bool BuildIdCache::WriteToFile(const string& filename) const {
+  std::stringstream output;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (const auto& entry : build_ids_) {
+      const Key& key = entry.first;
+      const string& name = std::get<0>(key);
+      // Such a name could not be read back.
+      if (name.find('\n') != string::npos)
+        continue;
+      output << std::get<1>(key) << ' ' << std::get<2>(key) << ' '
+             << std::get<3>(key) << ' ' << std::get<4>(key) << ' '
+             << std::get<5>(key) << ' ' << std::get<6>(key) << ' '
+             << (entry.second.empty() ? kNoBuildId
+                                      : RawDataToHexString(entry.second))
+             << ' ' << name << '\n';
+    }
+  }
+
+  std::stringstream temp_filename;
+  temp_filename << filename << ".tmp." << getpid();
+  if (!BufferToFile(temp_filename.str(), output.str()))
+    return false;
+  if (rename(temp_filename.str().c_str(), filename.c_str()) != 0) {
+    PLOG(ERROR) << "Failed to rename " << temp_filename.str() << " to "
+                << filename;
+    unlink(temp_filename.str().c_str());
+    return false;
+  }
+  return true;
+}
+
+}  // namespace quipper
@@ -0,0 +1,73 @@
+// Copyright 2016 The Chromium OS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef CHROMIUMOS_WIDE_PROFILING_BUILD_ID_CACHE_H_
+#define CHROMIUMOS_WIDE_PROFILING_BUILD_ID_CACHE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/stat.h>
+
+#include <map>
+#include <mutex>  // NOLINT(build/c++11)
+#include <tuple>
+
+#include "base/macros.h"
+
+#include "chromiumos-wide-profiling/compat/string.h"
+
+namespace quipper {
+
+// Remembers the build IDs of DSOs that have been read from the filesystem, so
+// that converting many profiles from the same image does not have to open and
+// parse the same files again. An entry is keyed by the DSO name along with the
+// device, inode, size and modification time of the file it was read from, so a
+// file that is replaced or modified is read again.
+//
+// Entries are never evicted, so a cache should be owned by whoever knows how
+// long its files stay relevant, e.g. a tool converting a batch of profiles,
+// and passed to PerfParser through PerfParserOptions::build_id_cache.
+//
+// A BuildIdCache may be shared by any number of threads.
+class BuildIdCache {
+ public:
+  BuildIdCache() {}
+
+  // Looks up the build ID of |name| as read from a file with status |s|.
+  // Returns false if there is no entry. Otherwise stores the raw build ID in
+  // |build_id| and returns true. An empty build ID means that the file is known
+  // to have none.
+  bool Lookup(const string& name, const struct stat& s, string* build_id) const;
+
+  // Stores the raw |build_id| of |name| as read from a file with status |s|.
+  void Insert(const string& name, const struct stat& s, const string& build_id);
+
+  // Adds the entries stored in |filename| by WriteToFile(). Returns false if
+  // the file cannot be read or is malformed, keeping any entries read before
+  // the error.
+  bool ReadFromFile(const string& filename);
+
+  // Writes all entries to |filename|. The file is written under a temporary
+  // name and then renamed, so concurrent readers never see a partial file.
+  bool WriteToFile(const string& filename) const;
+
+  // Returns the number of entries.
+  size_t size() const;
+
+ private:
+  // (name, major, minor, inode, size, mtime seconds, mtime nanoseconds)
+  typedef std::tuple<string, uint32_t, uint32_t, uint64_t, uint64_t, int64_t,
+                     int64_t> Key;
+
+  static Key MakeKey(const string& name, const struct stat& s);
+
+  mutable std::mutex mutex_;
+  std::map<Key, string> build_ids_;
+
+  DISALLOW_COPY_AND_ASSIGN(BuildIdCache);
+};
+
+}  // namespace quipper
+
+#endif  // CHROMIUMOS_WIDE_PROFILING_BUILD_ID_CACHE_H_
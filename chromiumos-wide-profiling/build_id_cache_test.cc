@@ -0,0 +1,120 @@
+// Copyright 2016 The Chromium OS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "chromiumos-wide-profiling/build_id_cache.h"
+
+#include <sys/stat.h>
+#include <sys/sysmacros.h>
+#include <sys/types.h>
+
+#include "base/logging.h"
+
+#include "chromiumos-wide-profiling/compat/string.h"
+#include "chromiumos-wide-profiling/compat/test.h"
+#include "chromiumos-wide-profiling/file_utils.h"
+#include "chromiumos-wide-profiling/scoped_temp_path.h"
+
+namespace quipper {
+
+namespace {
+
+struct stat ExampleStat() {
+  struct stat s = {0};
+  s.st_dev = makedev(8, 1);
+  s.st_ino = 123456;
+  s.st_size = 4096;
+  s.st_mtim.tv_sec = 1454000000;
+  s.st_mtim.tv_nsec = 5000;
+  return s;
+}
+
+}  // namespace
+
+TEST(BuildIdCacheTest, LooksUpInsertedBuildIds) {
+  BuildIdCache cache;
+  const struct stat s = ExampleStat();
+  string build_id;
+  EXPECT_FALSE(cache.Lookup("/usr/lib/libfoo.so", s, &build_id));
+
+  cache.Insert("/usr/lib/libfoo.so", s, "\xde\xad\xf0\x0d");
+  EXPECT_TRUE(cache.Lookup("/usr/lib/libfoo.so", s, &build_id));
+  EXPECT_EQ("\xde\xad\xf0\x0d", build_id);
+
+  // Files known to have no build ID are cached with an empty one.
+  cache.Insert("/usr/lib/libbar.so", s, "");
+  build_id = "unchanged";
+  EXPECT_TRUE(cache.Lookup("/usr/lib/libbar.so", s, &build_id));
+  EXPECT_EQ("", build_id);
+
+  EXPECT_EQ(2, cache.size());
+}
+
+TEST(BuildIdCacheTest, MissesWhenFileChanges) {
+  BuildIdCache cache;
+  const struct stat s = ExampleStat();
+  cache.Insert("/usr/lib/libfoo.so", s, "\xde\xad\xf0\x0d");
+
+  string build_id;
+  EXPECT_FALSE(cache.Lookup("/usr/lib/libfoo2.so", s, &build_id));
+
+  struct stat changed = s;
+  changed.st_dev = makedev(8, 2);
+  EXPECT_FALSE(cache.Lookup("/usr/lib/libfoo.so", changed, &build_id));
+
+  changed = s;
+  changed.st_ino = s.st_ino + 1;
+  EXPECT_FALSE(cache.Lookup("/usr/lib/libfoo.so", changed, &build_id));
+
+  changed = s;
+  changed.st_size = s.st_size + 1;
+  EXPECT_FALSE(cache.Lookup("/usr/lib/libfoo.so", changed, &build_id));
+
+  changed = s;
+  changed.st_mtim.tv_nsec = s.st_mtim.tv_nsec + 1;
+  EXPECT_FALSE(cache.Lookup("/usr/lib/libfoo.so", changed, &build_id));
+}
+
+TEST(BuildIdCacheTest, WritesAndReadsFile) {
+  ScopedTempDir dir("/tmp/quipper_build_id_cache.");
+  const string filename = dir.path() + "cache";
+  const struct stat s = ExampleStat();
+
+  BuildIdCache cache;
+  cache.Insert("/usr/lib/libfoo.so", s, "\xde\xad\xf0\x0d");
+  cache.Insert("/usr/lib/libbar.so", s, "");
+  cache.Insert("/opt/my app/lib with spaces.so", s, "\x01\x23");
+  ASSERT_TRUE(cache.WriteToFile(filename));
+
+  BuildIdCache read_cache;
+  ASSERT_TRUE(read_cache.ReadFromFile(filename));
+  EXPECT_EQ(3, read_cache.size());
+
+  string build_id;
+  EXPECT_TRUE(read_cache.Lookup("/usr/lib/libfoo.so", s, &build_id));
+  EXPECT_EQ("\xde\xad\xf0\x0d", build_id);
+  EXPECT_TRUE(read_cache.Lookup("/usr/lib/libbar.so", s, &build_id));
+  EXPECT_EQ("", build_id);
+  EXPECT_TRUE(
+      read_cache.Lookup("/opt/my app/lib with spaces.so", s, &build_id));
+  EXPECT_EQ("\x01\x23", build_id);
+}
+
+TEST(BuildIdCacheTest, RejectsMalformedFile) {
+  ScopedTempDir dir("/tmp/quipper_build_id_cache.");
+  const string filename = dir.path() + "cache";
+
+  BuildIdCache cache;
+  EXPECT_FALSE(cache.ReadFromFile(filename));
+
+  ASSERT_TRUE(BufferToFile(filename, string("8 1 123456 4096\n")));
+  EXPECT_FALSE(cache.ReadFromFile(filename));
+
+  ASSERT_TRUE(BufferToFile(
+      filename, string("8 1 123456 4096 1454000000 5000 abc /lib/a.so\n")));
+  EXPECT_FALSE(cache.ReadFromFile(filename));
+
+  EXPECT_EQ(0, cache.size());
+}
+
+}  // namespace quipper
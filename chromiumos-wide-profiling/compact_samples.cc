@@ -0,0 +1,318 @@
+// Copyright 2016 The Chromium OS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "chromiumos-wide-profiling/compact_samples.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <map>
+#include <memory>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "base/logging.h"
+#include "base/macros.h"
+
+#include "chromiumos-wide-profiling/compat/proto.h"
+#include "chromiumos-wide-profiling/kernel/perf_internals.h"
+
+namespace quipper {
+
+namespace {
+
+using CompactSamples = PerfDataProto_CompactSampleEvents;
+using PerfEvent = PerfDataProto_PerfEvent;
+using ProcessSamples = PerfDataProto_CompactSampleEvents_ProcessSamples;
+using SampleEvent = PerfDataProto_SampleEvent;
+
+// Returns the bit of ProcessSamples::field_mask for SampleEvent field number
+// |field_number|.
+uint64_t FieldBit(int field_number) {
+  return 1ULL << field_number;
+}
+
+// If |event| is a sample that can be stored in columns, stores the mask of its
+// fields in |field_mask| and returns true.
+bool GetCompactFieldMask(const PerfEvent& event, uint64_t* field_mask) {
+  const auto& header = event.header();
+  if (header.type() != PERF_RECORD_SAMPLE || !header.has_type() ||
+      !header.has_misc() || !header.has_size() || !event.has_sample_event()) {
+    return false;
+  }
+  const SampleEvent& sample = event.sample_event();
+  if (sample.has_addr() || sample.has_raw_size() || sample.has_read_info() ||
+      sample.branch_stack_size() > 0 || sample.has_weight() ||
+      sample.has_data_src() || sample.has_transaction()) {
+    return false;
+  }
+
+  uint64_t mask = 0;
+  if (sample.has_ip())
+    mask |= FieldBit(SampleEvent::kIpFieldNumber);
+  if (sample.has_pid())
+    mask |= FieldBit(SampleEvent::kPidFieldNumber);
+  if (sample.has_tid())
+    mask |= FieldBit(SampleEvent::kTidFieldNumber);
+  if (sample.has_sample_time_ns())
+    mask |= FieldBit(SampleEvent::kSampleTimeNsFieldNumber);
+  if (sample.has_id())
+    mask |= FieldBit(SampleEvent::kIdFieldNumber);
+  if (sample.has_stream_id())
+    mask |= FieldBit(SampleEvent::kStreamIdFieldNumber);
+  if (sample.has_period())
+    mask |= FieldBit(SampleEvent::kPeriodFieldNumber);
+  if (sample.has_cpu())
+    mask |= FieldBit(SampleEvent::kCpuFieldNumber);
+  if (sample.callchain_size() > 0)
+    mask |= FieldBit(SampleEvent::kCallchainFieldNumber);
+  *field_mask = mask;
+  return true;
+}
+
+// Appends sample events to the columns of a CompactSampleEvents message.
+class SampleEncoder {
+ public:
+  explicit SampleEncoder(CompactSamples* compact) : compact_(compact) {}
+
+  // Appends |event|, which was at |event_index| in PerfDataProto.events and
+  // has the fields in |field_mask|.
+  void Add(uint64_t event_index, uint64_t field_mask, const PerfEvent& event) {
+    const SampleEvent& sample = event.sample_event();
+    Group& group = GetGroup(sample.pid(), field_mask);
+    ProcessSamples* samples = group.samples;
+
+    samples->add_event_index_delta(event_index - group.last_event_index);
+    group.last_event_index = event_index;
+    samples->add_header_misc(event.header().misc());
+    samples->add_header_size(event.header().size());
+
+    if (field_mask & FieldBit(SampleEvent::kTidFieldNumber))
+      samples->add_tid(sample.tid());
+    if (field_mask & FieldBit(SampleEvent::kSampleTimeNsFieldNumber)) {
+      samples->add_sample_time_ns_delta(
+          static_cast<int64_t>(sample.sample_time_ns() - group.last_time));
+      group.last_time = sample.sample_time_ns();
+    }
+    if (field_mask & FieldBit(SampleEvent::kIpFieldNumber))
+      samples->add_ip_index(GetAddressIndex(sample.ip()));
+    if (field_mask & FieldBit(SampleEvent::kIdFieldNumber))
+      samples->add_id(sample.id());
+    if (field_mask & FieldBit(SampleEvent::kStreamIdFieldNumber))
+      samples->add_stream_id(sample.stream_id());
+    if (field_mask & FieldBit(SampleEvent::kPeriodFieldNumber))
+      samples->add_period(sample.period());
+    if (field_mask & FieldBit(SampleEvent::kCpuFieldNumber))
+      samples->add_cpu(sample.cpu());
+    if (field_mask & FieldBit(SampleEvent::kCallchainFieldNumber)) {
+      samples->add_callchain_length(sample.callchain_size());
+      for (uint64_t address : sample.callchain())
+        samples->add_callchain_index(GetAddressIndex(address));
+    }
+  }
+
+ private:
+  // The samples of one process with one field mask, and the values that the
+  // next sample is delta-encoded against.
+  struct Group {
+    ProcessSamples* samples;
+    uint64_t last_event_index;
+    uint64_t last_time;
+  };
+
+  Group& GetGroup(uint32_t pid, uint64_t field_mask) {
+    auto it = groups_.find(std::make_pair(pid, field_mask));
+    if (it != groups_.end())
+      return it->second;
+
+    Group group = {compact_->add_processes(), 0, 0};
+    if (field_mask & FieldBit(SampleEvent::kPidFieldNumber))
+      group.samples->set_pid(pid);
+    group.samples->set_field_mask(field_mask);
+    return groups_.insert(
+        std::make_pair(std::make_pair(pid, field_mask), group)).first->second;
+  }
+
+  uint32_t GetAddressIndex(uint64_t address) {
+    auto result = address_indices_.insert(
+        std::make_pair(address, compact_->addresses_size()));
+    if (result.second)
+      compact_->add_addresses(address);
+    return result.first->second;
+  }
+
+  CompactSamples* compact_;
+  std::map<std::pair<uint32_t, uint64_t>, Group> groups_;
+  std::unordered_map<uint64_t, uint32_t> address_indices_;
+
+  DISALLOW_COPY_AND_ASSIGN(SampleEncoder);
+};
+
+// Returns true if |column| has one value per sample if |field_number| is in
+// |field_mask|, and no values otherwise.
+template <typename T>
+bool HasColumnSize(const RepeatedField<T>& column, int field_number,
+                   uint64_t field_mask, int num_samples) {
+  bool present = field_mask & FieldBit(field_number);
+  return column.size() == (present ? num_samples : 0);
+}
+
+// Decodes the samples of |samples| into |events|, at the positions given by
+// their event indices. Returns false if |samples| is malformed.
+bool DecodeProcessSamples(const ProcessSamples& samples,
+                          const RepeatedField<uint64>& addresses,
+                          std::vector<std::unique_ptr<PerfEvent>>* events) {
+  const uint64_t mask = samples.field_mask();
+  const int num_samples = samples.event_index_delta_size();
+  if (samples.header_misc_size() != num_samples ||
+      samples.header_size_size() != num_samples ||
+      !HasColumnSize(samples.tid(), SampleEvent::kTidFieldNumber, mask,
+                     num_samples) ||
+      !HasColumnSize(samples.sample_time_ns_delta(),
+                     SampleEvent::kSampleTimeNsFieldNumber, mask,
+                     num_samples) ||
+      !HasColumnSize(samples.ip_index(), SampleEvent::kIpFieldNumber, mask,
+                     num_samples) ||
+      !HasColumnSize(samples.id(), SampleEvent::kIdFieldNumber, mask,
+                     num_samples) ||
+      !HasColumnSize(samples.stream_id(), SampleEvent::kStreamIdFieldNumber,
+                     mask, num_samples) ||
+      !HasColumnSize(samples.period(), SampleEvent::kPeriodFieldNumber, mask,
+                     num_samples) ||
+      !HasColumnSize(samples.cpu(), SampleEvent::kCpuFieldNumber, mask,
+                     num_samples) ||
+      !HasColumnSize(samples.callchain_length(),
+                     SampleEvent::kCallchainFieldNumber, mask, num_samples)) {
+    LOG(ERROR) << "Compact samples of pid " << samples.pid()
+               << " have columns of different sizes";
+    return false;
+  }
+
+  // Address and callchain indices are stored as uint32, so compare them
+  // against unsigned sizes.
+  const uint32_t num_addresses = static_cast<uint32_t>(addresses.size());
+  const uint32_t num_callchain_indices =
+      static_cast<uint32_t>(samples.callchain_index_size());
+  uint64_t event_index = 0;
+  uint64_t time = 0;
+  uint32_t callchain_pos = 0;
+  for (int i = 0; i < num_samples; ++i) {
+    event_index += samples.event_index_delta(i);
+    if (event_index >= events->size() || (*events)[event_index]) {
+      LOG(ERROR) << "Invalid compact sample event index " << event_index;
+      return false;
+    }
+    std::unique_ptr<PerfEvent> event(new PerfEvent);
+    auto* header = event->mutable_header();
+    header->set_type(PERF_RECORD_SAMPLE);
+    header->set_misc(samples.header_misc(i));
+    header->set_size(samples.header_size(i));
+
+    SampleEvent* sample = event->mutable_sample_event();
+    if (mask & FieldBit(SampleEvent::kIpFieldNumber)) {
+      if (samples.ip_index(i) >= num_addresses) {
+        LOG(ERROR) << "Invalid compact sample address index";
+        return false;
+      }
+      sample->set_ip(addresses.Get(samples.ip_index(i)));
+    }
+    if (mask & FieldBit(SampleEvent::kPidFieldNumber))
+      sample->set_pid(samples.pid());
+    if (mask & FieldBit(SampleEvent::kTidFieldNumber))
+      sample->set_tid(samples.tid(i));
+    if (mask & FieldBit(SampleEvent::kSampleTimeNsFieldNumber)) {
+      time += samples.sample_time_ns_delta(i);
+      sample->set_sample_time_ns(time);
+    }
+    if (mask & FieldBit(SampleEvent::kIdFieldNumber))
+      sample->set_id(samples.id(i));
+    if (mask & FieldBit(SampleEvent::kStreamIdFieldNumber))
+      sample->set_stream_id(samples.stream_id(i));
+    if (mask & FieldBit(SampleEvent::kPeriodFieldNumber))
+      sample->set_period(samples.period(i));
+    if (mask & FieldBit(SampleEvent::kCpuFieldNumber))
+      sample->set_cpu(samples.cpu(i));
+    if (mask & FieldBit(SampleEvent::kCallchainFieldNumber)) {
+      const uint32_t length = samples.callchain_length(i);
+      if (length > num_callchain_indices - callchain_pos) {
+        LOG(ERROR) << "Compact sample callchains are truncated";
+        return false;
+      }
+      sample->mutable_callchain()->Reserve(length);
+      for (uint32_t j = 0; j < length; ++j) {
+        const uint32_t index = samples.callchain_index(callchain_pos++);
+        if (index >= num_addresses) {
+          LOG(ERROR) << "Invalid compact sample address index";
+          return false;
+        }
+        sample->add_callchain(addresses.Get(index));
+      }
+    }
+    (*events)[event_index] = std::move(event);
+  }
+  if (callchain_pos != num_callchain_indices) {
+    LOG(ERROR) << "Compact samples of pid " << samples.pid()
+               << " have unused callchain entries";
+    return false;
+  }
+  return true;
+}
+
+}  // namespace
+
+void CompactSampleEvents(PerfDataProto* proto) {
+  if (!ExpandSampleEvents(proto)) {
+    LOG(ERROR) << "Not compacting sample events";
+    return;
+  }
+
+  RepeatedPtrField<PerfEvent>* events = proto->mutable_events();
+  SampleEncoder encoder(proto->mutable_compact_samples());
+  int num_kept = 0;
+  for (int i = 0; i < events->size(); ++i) {
+    uint64_t field_mask;
+    if (GetCompactFieldMask(events->Get(i), &field_mask)) {
+      encoder.Add(i, field_mask, events->Get(i));
+      continue;
+    }
+    // Move the events that are kept to the front, preserving their order.
+    events->SwapElements(i, num_kept++);
+  }
+  events->DeleteSubrange(num_kept, events->size() - num_kept);
+
+  if (proto->compact_samples().processes_size() == 0)
+    proto->clear_compact_samples();
+}
+
+bool ExpandSampleEvents(PerfDataProto* proto) {
+  if (!proto->has_compact_samples())
+    return true;
+  const CompactSamples& compact = proto->compact_samples();
+
+  size_t num_events = proto->events_size();
+  for (const ProcessSamples& samples : compact.processes())
+    num_events += samples.event_index_delta_size();
+
+  // Place the samples first, then fill the remaining positions with the other
+  // events in order.
+  std::vector<std::unique_ptr<PerfEvent>> samples(num_events);
+  for (const ProcessSamples& process_samples : compact.processes()) {
+    if (!DecodeProcessSamples(process_samples, compact.addresses(), &samples))
+      return false;
+  }
+
+  RepeatedPtrField<PerfEvent>* events = proto->mutable_events();
+  std::vector<PerfEvent*> other_events(events->size());
+  events->ExtractSubrange(0, events->size(), other_events.data());
+  events->Reserve(num_events);
+  auto other_event = other_events.begin();
+  for (std::unique_ptr<PerfEvent>& sample : samples)
+    events->AddAllocated(sample ? sample.release() : *other_event++);
+
+  proto->clear_compact_samples();
+  return true;
+}
+
+}  // namespace quipper
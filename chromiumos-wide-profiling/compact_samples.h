@@ -0,0 +1,27 @@
+// Copyright 2016 The Chromium OS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef CHROMIUMOS_WIDE_PROFILING_COMPACT_SAMPLES_H_
+#define CHROMIUMOS_WIDE_PROFILING_COMPACT_SAMPLES_H_
+
+namespace quipper {
+
+class PerfDataProto;
+
+// Moves the sample events of |proto| into |proto->compact_samples()|, which
+// stores them in columns grouped by process. Only samples whose fields are
+// all among ip, pid, tid, sample_time_ns, id, stream_id, period, cpu and
+// callchain are moved; all other events stay in |proto->events()|. Any
+// existing compact samples are expanded first.
+void CompactSampleEvents(PerfDataProto* proto);
+
+// Moves the samples in |proto->compact_samples()| back to their original
+// positions in |proto->events()|, and clears the compact samples. Returns false
+// if the compact samples are malformed, in which case |proto| is left
+// unchanged.
+bool ExpandSampleEvents(PerfDataProto* proto);
+
+}  // namespace quipper
+
+#endif  // CHROMIUMOS_WIDE_PROFILING_COMPACT_SAMPLES_H_
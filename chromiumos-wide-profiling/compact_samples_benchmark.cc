@@ -0,0 +1,101 @@
+// Copyright 2016 The Chromium OS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// Compares the size and the encoding and decoding times of PerfDataProtos with
+// and without compact sample events. Runs over the perf.data files used by the
+// tests, or over the files given on the command line.
+
+#include <stdlib.h>
+
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <vector>
+
+#include "base/logging.h"
+
+#include "chromiumos-wide-profiling/compat/proto.h"
+#include "chromiumos-wide-profiling/compat/string.h"
+#include "chromiumos-wide-profiling/perf_reader.h"
+#include "chromiumos-wide-profiling/perf_test_files.h"
+#include "chromiumos-wide-profiling/test_utils.h"
+
+namespace {
+
+// Each measurement is repeated this many times, and the fastest run is kept.
+const int kNumRuns = 3;
+
+double SecondsSince(std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration<double>(
+      std::chrono::steady_clock::now() - start).count();
+}
+
+struct Result {
+  size_t size;
+  double encode_time;
+  double decode_time;
+};
+
+// Measures serializing |reader| to a protobuf string, and reading that string
+// back into a PerfReader.
+Result Measure(quipper::PerfReader* reader, bool compact) {
+  reader->set_serialize_compact_samples(compact);
+  Result result = {0, 0, 0};
+  for (int run = 0; run < kNumRuns; ++run) {
+    auto start_time = std::chrono::steady_clock::now();
+    quipper::PerfDataProto proto;
+    CHECK(reader->Serialize(&proto));
+    string serialized;
+    CHECK(proto.SerializeToString(&serialized));
+    double encode_time = SecondsSince(start_time);
+
+    start_time = std::chrono::steady_clock::now();
+    quipper::PerfDataProto parsed_proto;
+    CHECK(parsed_proto.ParseFromString(serialized));
+    quipper::PerfReader parsed_reader;
+    CHECK(parsed_reader.Deserialize(parsed_proto));
+    double decode_time = SecondsSince(start_time);
+
+    if (run == 0 || encode_time < result.encode_time)
+      result.encode_time = encode_time;
+    if (run == 0 || decode_time < result.decode_time)
+      result.decode_time = decode_time;
+    result.size = serialized.size();
+  }
+  return result;
+}
+
+void PrintResult(const string& filename, const char* format,
+                 const Result& result) {
+  std::cout << std::left << std::setw(40) << filename << std::setw(10)
+            << format << std::right << std::setw(12) << result.size
+            << std::setw(12) << std::fixed << std::setprecision(2)
+            << result.encode_time * 1e3
+            << std::setw(12) << result.decode_time * 1e3 << std::endl;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  std::vector<string> filenames(argv + 1, argv + argc);
+  if (filenames.empty()) {
+    for (const char* test_file : perf_test_files::GetPerfDataFiles())
+      filenames.push_back(quipper::GetTestInputFilePath(test_file));
+  }
+
+  std::cout << std::left << std::setw(40) << "file" << std::setw(10)
+            << "format" << std::right << std::setw(12) << "bytes"
+            << std::setw(12) << "encode ms" << std::setw(12) << "decode ms"
+            << std::endl;
+  for (const string& filename : filenames) {
+    quipper::PerfReader reader;
+    if (!reader.ReadFile(filename)) {
+      LOG(ERROR) << "Unable to read " << filename;
+      continue;
+    }
+    PrintResult(filename, "events", Measure(&reader, false));
+    PrintResult(filename, "compact", Measure(&reader, true));
+  }
+  return EXIT_SUCCESS;
+}
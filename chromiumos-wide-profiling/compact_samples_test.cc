@@ -0,0 +1,150 @@
+// Copyright 2016 The Chromium OS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "chromiumos-wide-profiling/compact_samples.h"
+
+#include <sstream>
+
+#include "base/logging.h"
+
+#include "chromiumos-wide-profiling/compat/proto.h"
+#include "chromiumos-wide-profiling/compat/string.h"
+#include "chromiumos-wide-profiling/compat/test.h"
+#include "chromiumos-wide-profiling/kernel/perf_internals.h"
+#include "chromiumos-wide-profiling/perf_reader.h"
+#include "chromiumos-wide-profiling/test_perf_data.h"
+
+namespace quipper {
+
+namespace {
+
+// Returns a profile of two processes with callchain samples, with an MMAP and
+// a FORK event among them.
+PerfDataProto ExampleProfile() {
+  std::stringstream input;
+  testing::ExamplePipedPerfDataFileHeader().WriteTo(&input);
+  testing::ExamplePerfEventAttrEvent_Hardware(
+      PERF_SAMPLE_IP | PERF_SAMPLE_TID | PERF_SAMPLE_TIME | PERF_SAMPLE_CPU |
+      PERF_SAMPLE_CALLCHAIN,
+      true /*sample_id_all*/).WriteTo(&input);
+
+  testing::ExampleMmapEvent(
+      1001, 0x1c1000, 0x1000, 0, "/usr/lib/foo.so",
+      testing::SampleInfo().Tid(1001).Time(10).Cpu(0)).WriteTo(&input);  // 0
+  testing::ExamplePerfSampleEvent(                                      // 1
+      testing::SampleInfo().Ip(0x1c1100).Tid(1001).Time(20).Cpu(0)
+          .Callchain({0x1c1100, 0x1c1200, 0x1c1300})).WriteTo(&input);
+  testing::ExamplePerfSampleEvent(                                      // 2
+      testing::SampleInfo().Ip(0x2c1100).Tid(1002, 1003).Time(25).Cpu(1)
+          .Callchain({0x2c1100})).WriteTo(&input);
+  testing::ExampleForkEvent(                                            // 3
+      1004, 1001, 1004, 1001, 30,
+      testing::SampleInfo().Tid(1004).Time(30).Cpu(0)).WriteTo(&input);
+  testing::ExamplePerfSampleEvent(                                      // 4
+      testing::SampleInfo().Ip(0x1c1100).Tid(1001).Time(40).Cpu(0)
+          .Callchain({0x1c1100, 0x1c1200, 0x1c1300})).WriteTo(&input);
+  testing::ExamplePerfSampleEvent(                                      // 5
+      testing::SampleInfo().Ip(0x1c1200).Tid(1001, 1005).Time(35).Cpu(1)
+          .Callchain({0x1c1200, 0x1c1300})).WriteTo(&input);
+
+  PerfReader reader;
+  CHECK(reader.ReadFromString(input.str()));
+  PerfDataProto proto;
+  CHECK(reader.Serialize(&proto));
+  return proto;
+}
+
+}  // namespace
+
+TEST(CompactSamplesTest, CompactsAndExpandsSamples) {
+  const PerfDataProto original = ExampleProfile();
+  ASSERT_EQ(6, original.events_size());
+
+  PerfDataProto proto = original;
+  CompactSampleEvents(&proto);
+
+  // Only the MMAP and FORK events are left.
+  ASSERT_EQ(2, proto.events_size());
+  EXPECT_EQ(PERF_RECORD_MMAP, proto.events(0).header().type());
+  EXPECT_EQ(PERF_RECORD_FORK, proto.events(1).header().type());
+
+  const PerfDataProto_CompactSampleEvents& compact = proto.compact_samples();
+  ASSERT_EQ(2, compact.processes_size());
+  EXPECT_EQ(1001, compact.processes(0).pid());
+  EXPECT_EQ(3, compact.processes(0).event_index_delta_size());
+  EXPECT_EQ(1002, compact.processes(1).pid());
+  EXPECT_EQ(1, compact.processes(1).event_index_delta_size());
+  // Each distinct address is stored once.
+  EXPECT_EQ(4, compact.addresses_size());
+  EXPECT_LT(proto.ByteSizeLong(), original.ByteSizeLong());
+
+  ASSERT_TRUE(ExpandSampleEvents(&proto));
+  EXPECT_FALSE(proto.has_compact_samples());
+  EXPECT_EQ(original.SerializeAsString(), proto.SerializeAsString());
+}
+
+TEST(CompactSamplesTest, KeepsSamplesWithOtherFields) {
+  PerfDataProto original = ExampleProfile();
+  original.mutable_events(1)->mutable_sample_event()->set_weight(5);
+  original.mutable_events(2)->mutable_sample_event()->add_branch_stack();
+
+  PerfDataProto proto = original;
+  CompactSampleEvents(&proto);
+  ASSERT_EQ(4, proto.events_size());
+  EXPECT_EQ(original.events(1).SerializeAsString(),
+            proto.events(1).SerializeAsString());
+  EXPECT_EQ(original.events(2).SerializeAsString(),
+            proto.events(2).SerializeAsString());
+  ASSERT_EQ(1, proto.compact_samples().processes_size());
+  EXPECT_EQ(2, proto.compact_samples().processes(0).event_index_delta_size());
+
+  ASSERT_TRUE(ExpandSampleEvents(&proto));
+  EXPECT_EQ(original.SerializeAsString(), proto.SerializeAsString());
+}
+
+TEST(CompactSamplesTest, CompactsAgainWithoutLosingSamples) {
+  const PerfDataProto original = ExampleProfile();
+  PerfDataProto proto = original;
+  CompactSampleEvents(&proto);
+  CompactSampleEvents(&proto);
+  ASSERT_TRUE(ExpandSampleEvents(&proto));
+  EXPECT_EQ(original.SerializeAsString(), proto.SerializeAsString());
+}
+
+TEST(CompactSamplesTest, RejectsMalformedCompactSamples) {
+  PerfDataProto compacted = ExampleProfile();
+  CompactSampleEvents(&compacted);
+
+  // Two samples at the same position.
+  PerfDataProto proto = compacted;
+  proto.mutable_compact_samples()->mutable_processes(0)
+      ->set_event_index_delta(1, 0);
+  string before = proto.SerializeAsString();
+  EXPECT_FALSE(ExpandSampleEvents(&proto));
+  EXPECT_EQ(before, proto.SerializeAsString());
+
+  // Position past the end of the events.
+  proto = compacted;
+  proto.mutable_compact_samples()->mutable_processes(1)
+      ->set_event_index_delta(0, 100);
+  EXPECT_FALSE(ExpandSampleEvents(&proto));
+
+  // Address index out of range.
+  proto = compacted;
+  proto.mutable_compact_samples()->mutable_processes(0)->set_ip_index(0, 100);
+  EXPECT_FALSE(ExpandSampleEvents(&proto));
+
+  // Missing column.
+  proto = compacted;
+  proto.mutable_compact_samples()->mutable_processes(0)->clear_tid();
+  EXPECT_FALSE(ExpandSampleEvents(&proto));
+
+  // Callchain entries left over.
+  proto = compacted;
+  proto.mutable_compact_samples()->mutable_processes(0)
+      ->add_callchain_index(0);
+  EXPECT_FALSE(ExpandSampleEvents(&proto));
+}
+
+}  // namespace quipper
@@ -8,10 +8,13 @@
 #include <stdlib.h>
 #include <unistd.h>
 
+#include <fstream>
+#include <sstream>
 #include <string>
 #include <vector>
 
 #include "base/logging.h"
+#include "base/macros.h"
 
 #include "chromiumos-wide-profiling/compat/proto.h"
 #include "chromiumos-wide-profiling/compat/string.h"
@@ -24,20 +27,29 @@ namespace quipper {
 
 namespace {
 
+// Number of events written per PerfDataProto chunk when streaming.
+const int kStreamingChunkSize = 10000;
+
 // Parse options from the format strings, set the options, and return the base
-// format. Returns the empty string if options are not recognized.
-string ParseFormatOptions(string format, PerfParserOptions* options) {
+// format. Options are separated from the format and from each other by '.',
+// e.g. "perf.remap.discard". |*stream| is set if the "stream" option is given.
+// Returns the empty string if options are not recognized.
+string ParseFormatOptions(string format, PerfParserOptions* options,
+                          bool* stream) {
   auto dot = format.find('.');
-  if (dot != string::npos) {
-    string opt = format.substr(dot+1);
-    format = format.substr(0, dot);
+  if (dot == string::npos)
+    return format;
+
+  std::stringstream opts(format.substr(dot + 1));
+  format = format.substr(0, dot);
+  string opt;
+  while (std::getline(opts, opt, '.')) {
     if (opt == "remap") {
       options->do_remap = true;
     } else if (opt == "discard") {
       options->discard_unused_events = true;
-    } else if (opt == "remap.discard") {
-      options->do_remap = true;
-      options->discard_unused_events = true;
+    } else if (opt == "stream") {
+      *stream = true;
     } else {
       LOG(ERROR) << "Unknown option: " << opt;
       return "";
@@ -46,13 +58,83 @@ string ParseFormatOptions(string format, PerfParserOptions* options) {
   return format;
 }
 
+// Writes the events it receives to a text format PerfDataProto, a chunk of at
+// most |kStreamingChunkSize| events at a time. Concatenated text format
+// messages are merged when parsed, so the chunks together read back as one
+// PerfDataProto.
+class ChunkedProtoTextWriter : public ParsedEventHandler {
+ public:
+  explicit ChunkedProtoTextWriter(std::ostream* out) : out_(out) {}
+
+  bool HandleParsedEvent(const ParsedEvent& parsed_event) override {
+    chunk_.add_events()->CopyFrom(*parsed_event.event_ptr);
+    if (chunk_.events_size() < kStreamingChunkSize)
+      return true;
+    return Flush();
+  }
+
+  // Writes out the events that have not been written yet.
+  bool Flush() {
+    if (chunk_.events_size() == 0)
+      return true;
+    bool result = Write(chunk_);
+    chunk_.Clear();
+    return result;
+  }
+
+  // Writes |perf_data_proto| in text format after the chunks written so far.
+  bool Write(const PerfDataProto& perf_data_proto) {
+    string output_string;
+    if (!TextFormat::PrintToString(perf_data_proto, &output_string))
+      return false;
+    out_->write(output_string.data(), output_string.size());
+    return out_->good();
+  }
+
+ private:
+  std::ostream* out_;
+
+  // Events that have not been written yet.
+  PerfDataProto chunk_;
+
+  DISALLOW_COPY_AND_ASSIGN(ChunkedProtoTextWriter);
+};
+
+// Converts the perf data in |input_filename| to a text format PerfDataProto in
+// |output_filename| without holding all of its events in memory at once.
+bool StreamPerfFileToProtoText(const string& input_filename,
+                               const string& output_filename,
+                               const PerfParserOptions& options) {
+  std::ofstream out(output_filename.c_str(),
+                    std::ios::out | std::ios::trunc | std::ios::binary);
+  if (!out.good()) {
+    LOG(ERROR) << "Unable to open file " << output_filename;
+    return false;
+  }
+
+  PerfReader reader;
+  PerfParser parser(&reader, options);
+  ChunkedProtoTextWriter writer(&out);
+  if (!parser.ParseFileStreaming(input_filename, &writer) || !writer.Flush())
+    return false;
+
+  // Everything other than the events goes after the last chunk, so that build
+  // IDs found while parsing are included.
+  PerfDataProto perf_data_proto;
+  reader.Serialize(&perf_data_proto);
+  PerfSerializer::SerializeParserStats(parser.stats(), &perf_data_proto);
+  // Reset the timestamp field since it causes reproducability issues when
+  // testing.
+  perf_data_proto.set_timestamp_sec(0);
+  return writer.Write(perf_data_proto);
+}
+
 // ReadInput reads the input and stores it within |reader|.
 bool ReadInput(const FormatAndFile& input,
-               PerfReader* reader,
-               PerfParserOptions* options) {
+               const string& format,
+               PerfReader* reader) {
   LOG(INFO) << "Reading input.";
 
-  string format = ParseFormatOptions(input.format, options);
   if (format == kPerfFormat) {
     return reader->ReadFile(input.filename);
   }
@@ -117,9 +199,20 @@ const char kPerfFormat[] = "perf";
 const char kProtoTextFormat[] = "text";
 
 bool ConvertFile(const FormatAndFile& input, const FormatAndFile& output) {
-  PerfReader reader;
   PerfParserOptions options;
-  if (!ReadInput(input, &reader, &options))
+  bool stream = false;
+  string input_format = ParseFormatOptions(input.format, &options, &stream);
+  if (stream) {
+    if (input_format != kPerfFormat || output.format != kProtoTextFormat) {
+      LOG(ERROR) << "Streaming is only supported for converting "
+                 << kPerfFormat << " to " << kProtoTextFormat;
+      return false;
+    }
+    return StreamPerfFileToProtoText(input.filename, output.filename, options);
+  }
+
+  PerfReader reader;
+  if (!ReadInput(input, input_format, &reader))
     return false;
   if (!WriteOutput(output, options, &reader))
     return false;
@@ -23,7 +23,9 @@ struct FormatAndFile {
   string filename;
 
   // The format of the file. Options are "perf" for perf data files, "text" for
-  // proto text files and "proto" for proto binary files.
+  // proto text files and "proto" for proto binary files. An input format may
+  // be followed by '.'-separated options: "remap", "discard", and "stream" to
+  // convert perf data to proto text one chunk of events at a time.
   string format;
 };
 
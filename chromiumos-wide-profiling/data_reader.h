@@ -37,6 +37,15 @@ class DataReader {
   // Reads raw data into a string.
   virtual bool ReadDataString(const size_t size, string* dest);
 
+  // Returns a pointer to |size| bytes of data starting at |offset| bytes from
+  // the beginning of the data, without copying them. Does not move the data
+  // read pointer. Returns nullptr if the data source is not memory-backed or if
+  // the requested range is out of bounds. The returned pointer remains valid
+  // for the lifetime of the reader.
+  virtual const void* GetDataInPlace(size_t offset, size_t size) const {
+    return nullptr;
+  }
+
   // Like ReadData(), but prints an error if it doesn't read all |size| bytes.
   virtual bool ReadDataValue(const size_t size, const string& value_name,
                              void* dest);
@@ -134,12 +134,12 @@ bool ReadElfBuildId(int fd, string* buildid) {
   return err;
 }
 
-// read /sys/module/<module_name>/notes/.note.gnu.build-id
-bool ReadModuleBuildId(string module_name, string* buildid) {
-  string note_filename =
-      "/sys/module/" + module_name + "/notes/.note.gnu.build-id";
+string ModuleBuildIdNotePath(const string& module_name) {
+  return "/sys/module/" + module_name + "/notes/.note.gnu.build-id";
+}
 
-  FileReader file(note_filename);
+bool ReadModuleBuildId(string module_name, string* buildid) {
+  FileReader file(ModuleBuildIdNotePath(module_name));
   if (!file.IsOpen())
     return false;
 
@@ -39,7 +39,10 @@ void InitializeLibelf();
 bool ReadElfBuildId(string filename, string* buildid);
 bool ReadElfBuildId(int fd, string* buildid);
 
-// Read buildid from /sys/module/<module_name>/notes/.note.gnu.build-id
+// Returns the path of the build ID note of a kernel module:
+// /sys/module/<module_name>/notes/.note.gnu.build-id
+string ModuleBuildIdNotePath(const string& module_name);
+// Read buildid from ModuleBuildIdNotePath(module_name).
 // (Does not use libelf.)
 bool ReadModuleBuildId(string module_name, string* buildid);
 // Read builid from Elf note data section.
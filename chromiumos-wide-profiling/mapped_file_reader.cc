@@ -0,0 +1,51 @@
+// Copyright 2016 The Chromium OS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "chromiumos-wide-profiling/mapped_file_reader.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "base/logging.h"
+
+namespace quipper {
+
+MappedFileReader::MappedFileReader(const string& filename)
+    : BufferReader(nullptr, 0) {
+  int fd = open(filename.c_str(), O_RDONLY);
+  if (fd < 0)
+    return;
+
+  struct stat stat_buf;
+  if (fstat(fd, &stat_buf) != 0 || !S_ISREG(stat_buf.st_mode) ||
+      stat_buf.st_size == 0) {
+    close(fd);
+    return;
+  }
+
+  void* mapping =
+      mmap(nullptr, stat_buf.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  // The mapping holds its own reference to the file.
+  close(fd);
+  if (mapping == MAP_FAILED) {
+    PLOG(WARNING) << "Unable to map " << filename;
+    return;
+  }
+
+  // Perf data is mostly read from front to back, so let the kernel read ahead
+  // aggressively. This is only a hint, so ignore failures.
+  madvise(mapping, stat_buf.st_size, MADV_SEQUENTIAL);
+
+  buffer_ = reinterpret_cast<const char*>(mapping);
+  size_ = stat_buf.st_size;
+}
+
+MappedFileReader::~MappedFileReader() {
+  if (IsMapped())
+    munmap(const_cast<char*>(buffer_), size_);
+}
+
+}  // namespace quipper
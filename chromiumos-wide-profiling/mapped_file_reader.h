@@ -0,0 +1,33 @@
+// Copyright 2016 The Chromium OS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef CHROMIUMOS_WIDE_PROFILING_MAPPED_FILE_READER_H_
+#define CHROMIUMOS_WIDE_PROFILING_MAPPED_FILE_READER_H_
+
+#include "base/macros.h"
+
+#include "chromiumos-wide-profiling/buffer_reader.h"
+
+namespace quipper {
+
+// Read from an input file by mapping it into memory. The file contents can then
+// be accessed in place, without being copied out of the file first. Only
+// non-empty regular files can be mapped. For anything else, IsMapped() returns
+// false, and the caller should fall back to another reader, e.g. FileReader.
+class MappedFileReader : public BufferReader {
+ public:
+  explicit MappedFileReader(const string& filename);
+  ~MappedFileReader() override;
+
+  bool IsMapped() const {
+    return buffer_ != nullptr;
+  }
+
+ private:
+  DISALLOW_COPY_AND_ASSIGN(MappedFileReader);
+};
+
+}  // namespace quipper
+
+#endif  // CHROMIUMOS_WIDE_PROFILING_MAPPED_FILE_READER_H_
@@ -0,0 +1,87 @@
+// Copyright 2016 The Chromium OS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "chromiumos-wide-profiling/mapped_file_reader.h"
+
+#include <stdint.h>
+#include <string.h>
+
+#include <vector>
+
+#include "chromiumos-wide-profiling/compat/test.h"
+#include "chromiumos-wide-profiling/file_utils.h"
+#include "chromiumos-wide-profiling/scoped_temp_path.h"
+
+namespace quipper {
+
+// Read in all data from a mapped file, in multiple chunks and not in order.
+TEST(MappedFileReaderTest, ReadWithJumps) {
+  // This string contains four parts, each 10 characters long.
+  const string kInputData =
+      "0:abcdefg;"
+      "1:hijklmn;"
+      "2:opqrstu;"
+      "3:vwxyzABC";
+
+  ScopedTempFile input_file;
+  ASSERT_TRUE(BufferToFile(input_file.path(), kInputData));
+  MappedFileReader reader(input_file.path());
+  ASSERT_TRUE(reader.IsMapped());
+  EXPECT_EQ(kInputData.size(), reader.size());
+
+  std::vector<uint8_t> output(10);
+
+  reader.SeekSet(10);
+  EXPECT_TRUE(reader.ReadData(10, output.data()));
+  EXPECT_EQ(20, reader.Tell());
+  EXPECT_EQ("1:hijklmn;", string(output.begin(), output.end()));
+
+  reader.SeekSet(30);
+  EXPECT_TRUE(reader.ReadData(10, output.data()));
+  EXPECT_EQ(40, reader.Tell());
+  EXPECT_EQ("3:vwxyzABC", string(output.begin(), output.end()));
+
+  // Must not be able to read past the end of the file.
+  reader.SeekSet(35);
+  EXPECT_FALSE(reader.ReadData(10, output.data()));
+  EXPECT_EQ(35, reader.Tell());
+}
+
+// Access the contents of a mapped file without copying them.
+TEST(MappedFileReaderTest, GetDataInPlace) {
+  const string kInputData = "abcdefghijklmnopqrstuvwxyz";
+
+  ScopedTempFile input_file;
+  ASSERT_TRUE(BufferToFile(input_file.path(), kInputData));
+  MappedFileReader reader(input_file.path());
+  ASSERT_TRUE(reader.IsMapped());
+
+  reader.SeekSet(3);
+  const char* data =
+      reinterpret_cast<const char*>(reader.GetDataInPlace(10, 16));
+  ASSERT_TRUE(data);
+  EXPECT_EQ("klmnopqrstuvwxyz", string(data, 16));
+  // The read pointer should not have moved.
+  EXPECT_EQ(3, reader.Tell());
+
+  EXPECT_TRUE(reader.GetDataInPlace(0, kInputData.size()));
+  EXPECT_FALSE(reader.GetDataInPlace(10, 17));
+  EXPECT_FALSE(reader.GetDataInPlace(27, 0));
+}
+
+// Files that cannot be mapped should be reported as such, so that the caller
+// can fall back to another reader.
+TEST(MappedFileReaderTest, UnmappableFiles) {
+  ScopedTempFile empty_file;
+  ASSERT_TRUE(BufferToFile(empty_file.path(), string()));
+  EXPECT_FALSE(MappedFileReader(empty_file.path()).IsMapped());
+
+  ScopedTempDir dir;
+  EXPECT_FALSE(MappedFileReader(dir.path()).IsMapped());
+
+  EXPECT_FALSE(MappedFileReader("/dev/null").IsMapped());
+  EXPECT_FALSE(MappedFileReader(dir.path() + "nonexistent").IsMapped());
+}
+
+}  // namespace quipper
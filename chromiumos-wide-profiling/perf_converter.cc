@@ -77,6 +77,10 @@ void PrintUsage() {
             << " -o <output filename> -O <output format> -v <verbosity level>";
   LOG(INFO) << "Format options are: '" << kPerfFormat << "' for perf.data"
             << " and '" << kProtoTextFormat << "' for proto text.";
+  LOG(INFO) << "Input format options can be appended with '.': 'remap',"
+            << " 'discard' and 'stream', e.g. '" << kPerfFormat
+            << ".remap.stream'. 'stream' converts perf.data to proto text in"
+            << " bounded memory.";
   LOG(INFO) << "By default it reads from perf.data and outputs to /dev/stdout"
             << " in proto text format.";
   LOG(INFO) << "Default verbosity level is 0. Higher values increase verbosity."
@@ -11,18 +11,24 @@
 #include <sys/types.h>
 #include <unistd.h>
 
+#include <algorithm>
+#include <functional>
 #include <memory>
 #include <set>
 #include <sstream>
+#include <vector>
 
 #include "base/logging.h"
 
 #include "chromiumos-wide-profiling/address_mapper.h"
 #include "chromiumos-wide-profiling/binary_data_utils.h"
+#include "chromiumos-wide-profiling/build_id_cache.h"
 #include "chromiumos-wide-profiling/compat/proto.h"
 #include "chromiumos-wide-profiling/compat/string.h"
+#include "chromiumos-wide-profiling/compat/thread.h"
 #include "chromiumos-wide-profiling/dso.h"
 #include "chromiumos-wide-profiling/huge_pages_mapping_deducer.h"
+#include "chromiumos-wide-profiling/perf_data_utils.h"
 
 namespace quipper {
 
@@ -55,6 +61,26 @@ bool IsNullBranchStackEntry(const BranchStackEntry& entry) {
   return (!entry.from_ip() && !entry.to_ip());
 }
 
+// Returns true if |event| is a sample event with the fields needed to map it.
+bool IsMappableSampleEvent(const PerfEvent& event) {
+  return event.has_sample_event() &&
+         event.sample_event().has_ip() &&
+         event.sample_event().has_pid() &&
+         event.sample_event().has_tid();
+}
+
+// A sample event to map, and the mappings of its process to map it against.
+struct SampleMappingJob {
+  ParsedEvent* parsed_event;
+  std::shared_ptr<const AddressMapper> mapper;
+};
+
+// Returns true if |e1| has an earlier timestamp than |e2|. Used to sort
+// pointers to events.
+bool CompareEventPointerTimes(const PerfEvent* e1, const PerfEvent* e2) {
+  return GetTimeFromPerfEvent(*e1) < GetTimeFromPerfEvent(*e2);
+}
+
 // Walks through all the perf events in |*reader| and searches for split
 // mappings due to huge pages. Combines these split mappings into one and
 // replaces the split mapping events. Modifies the events vector stored in
@@ -114,13 +140,22 @@ void CombineHugePagesMappings(PerfReader* reader) {
 
 }  // namespace
 
-PerfParser::PerfParser(PerfReader* reader) : reader_(reader) {}
+PerfParser::PerfParser(PerfReader* reader)
+    : reader_(reader),
+      streaming_handler_(nullptr),
+      num_streamed_events_(0),
+      round_max_time_(0),
+      previous_round_max_time_(0) {}
 
 PerfParser::~PerfParser() {}
 
 PerfParser::PerfParser(PerfReader* reader, const PerfParserOptions& options)
     : reader_(reader),
-      options_(options) {}
+      options_(options),
+      streaming_handler_(nullptr),
+      num_streamed_events_(0),
+      round_max_time_(0),
+      previous_round_max_time_(0) {}
 
 bool PerfParser::ParseRawEvents() {
   if (options_.sort_events_by_time) {
@@ -182,9 +217,226 @@ bool PerfParser::ParseRawEvents() {
   return true;
 }
 
+class PerfParser::SampleMappingThread : public Thread {
+ public:
+  SampleMappingThread(PerfParser* parser,
+                      const SampleMappingJob* begin,
+                      const SampleMappingJob* end)
+      : Thread("SampleMapping"),
+        parser_(parser),
+        begin_(begin),
+        end_(end),
+        num_mapped_(0) {}
+
+  const SampleMappingContext& context() const {
+    return context_;
+  }
+
+  SampleMappingContext* mutable_context() {
+    return &context_;
+  }
+
+  uint32_t num_mapped() const {
+    return num_mapped_;
+  }
+
+ protected:
+  void Run() override {
+    for (const SampleMappingJob* job = begin_; job != end_; ++job) {
+      context_.mapper = job->mapper.get();
+      if (parser_->MapSampleEvent(job->parsed_event, &context_))
+        ++num_mapped_;
+    }
+  }
+
+ private:
+  PerfParser* const parser_;
+  const SampleMappingJob* const begin_;
+  const SampleMappingJob* const end_;
+
+  SampleMappingContext context_;
+  uint32_t num_mapped_;
+
+  DISALLOW_COPY_AND_ASSIGN(SampleMappingThread);
+};
+
 bool PerfParser::ProcessEvents() {
+  StartProcessingEvents();
+
+  if (options_.num_mapping_threads > 1) {
+    if (!ProcessEventsAndMapSamplesInParallel())
+      return false;
+    return FinishProcessingEvents();
+  }
+
+  // NB: Not necessarily actually sorted by time.
+  for (size_t i = 0; i < parsed_events_.size(); ++i) {
+    if (!ProcessEvent(&parsed_events_[i], i))
+      return false;
+  }
+  return FinishProcessingEvents();
+}
+
+bool PerfParser::ProcessEventsAndMapSamplesInParallel() {
+  // Copies of the mappings of each process as of its latest sample. A process
+  // gets a new copy for the next sample after its mappings change.
+  std::map<uint32_t, std::shared_ptr<const AddressMapper>> mapper_snapshots;
+  std::vector<SampleMappingJob> jobs;
+
+  for (size_t i = 0; i < parsed_events_.size(); ++i) {
+    ParsedEvent& parsed_event = parsed_events_[i];
+    const PerfEvent& event = *parsed_event.event_ptr;
+    if (event.header().type() != PERF_RECORD_SAMPLE) {
+      if (!ProcessEvent(&parsed_event, i))
+        return false;
+      if (event.has_mmap_event())
+        mapper_snapshots.erase(event.mmap_event().pid());
+      continue;
+    }
+
+    VLOG(1) << "SAMPLE";
+    ++stats_.num_sample_events;
+    if (!IsMappableSampleEvent(event))
+      continue;
+    // The command and the process's mapper have to be looked up now, since
+    // later events may change them.
+    SetSampleCommand(&parsed_event);
+    const uint32_t pid = event.sample_event().pid();
+    std::shared_ptr<const AddressMapper>& snapshot = mapper_snapshots[pid];
+    if (!snapshot)
+      snapshot.reset(new AddressMapper(*GetOrCreateProcessMapper(pid).first));
+    jobs.push_back(SampleMappingJob{&parsed_event, snapshot});
+  }
+  mapper_snapshots.clear();
+
+  const size_t num_threads =
+      std::min(static_cast<size_t>(options_.num_mapping_threads), jobs.size());
+  std::vector<std::unique_ptr<SampleMappingThread>> threads;
+  for (size_t i = 0; i < num_threads; ++i) {
+    const SampleMappingJob* begin = jobs.data() + jobs.size() * i / num_threads;
+    const SampleMappingJob* end =
+        jobs.data() + jobs.size() * (i + 1) / num_threads;
+    threads.emplace_back(new SampleMappingThread(this, begin, end));
+    threads.back()->Start();
+  }
+
+  for (const auto& thread : threads) {
+    thread->Join();
+    stats_.num_sample_events_mapped += thread->num_mapped();
+    for (const MmapHit& hit : thread->context().hits)
+      RecordMmapHit(hit, hit.pidtid, nullptr);
+    callchains_.splice(callchains_.end(), thread->mutable_context()->callchains);
+  }
+  return true;
+}
+
+bool PerfParser::ParseFileStreaming(const string& filename,
+                                    ParsedEventHandler* handler) {
+  if (options_.discard_unused_events || options_.combine_huge_pages_mappings) {
+    LOG(ERROR) << "Discarding unused events and combining huge pages mappings "
+               << "are not supported when streaming.";
+    return false;
+  }
+
+  process_mappers_.clear();
+  parsed_events_.clear();
+  pending_events_.Clear();
+  streamed_mmap_events_.Clear();
+  streamed_mmap_parsed_events_.clear();
+  num_streamed_events_ = 0;
+  round_max_time_ = 0;
+  previous_round_max_time_ = 0;
+  streaming_handler_ = handler;
+  StartProcessingEvents();
+
+  reader_->set_event_handler(this);
+  bool result = reader_->ReadFile(filename);
+  reader_->set_event_handler(nullptr);
+
+  // Whatever is left over after the last round can now be processed.
+  if (result)
+    result = FlushPendingEvents(UINT64_MAX);
+  streaming_handler_ = nullptr;
+  if (!result)
+    return false;
+
+  FinishProcessingEvents();
+  return true;
+}
+
+bool PerfParser::HandleEvent(PerfEvent* event) {
+  if (event->header().type() == PERF_RECORD_FINISHED_ROUND) {
+    // perf guarantees that events written after the end of a round are no
+    // older than the newest event seen before the end of the previous round.
+    // Everything up to that time is in its final order.
+    if (!FlushPendingEvents(previous_round_max_time_))
+      return false;
+    previous_round_max_time_ = round_max_time_;
+    return true;
+  }
+
+  if (!options_.sort_events_by_time)
+    return ProcessStreamedEvent(event);
+
+  round_max_time_ = std::max(round_max_time_, GetTimeFromPerfEvent(*event));
+  pending_events_.Add()->Swap(event);
+  return true;
+}
+
+bool PerfParser::FlushPendingEvents(uint64_t max_time) {
+  int num_ready = pending_events_.size();
+  if (reader_->CanSortEventsByTime()) {
+    std::stable_sort(pending_events_.pointer_begin(),
+                     pending_events_.pointer_end(),
+                     CompareEventPointerTimes);
+    while (num_ready > 0 &&
+           GetTimeFromPerfEvent(pending_events_.Get(num_ready - 1)) >
+           max_time) {
+      --num_ready;
+    }
+  }
+
+  for (int i = 0; i < num_ready; ++i) {
+    if (!ProcessStreamedEvent(pending_events_.Mutable(i)))
+      return false;
+  }
+  pending_events_.DeleteSubrange(0, num_ready);
+  return true;
+}
+
+bool PerfParser::ProcessStreamedEvent(PerfEvent* event) {
+  const uint64_t id = num_streamed_events_++;
+  if (!event->has_mmap_event()) {
+    ParsedEvent parsed_event;
+    parsed_event.event_ptr = event;
+    if (!ProcessEvent(&parsed_event, id) ||
+        !streaming_handler_->HandleParsedEvent(parsed_event)) {
+      return false;
+    }
+    // The handler is done with the sample's callchain, so nothing points to
+    // the stored callchains anymore.
+    if (callchains_.size() >= options_.max_streamed_callchains) {
+      callchain_caches_.clear();
+      callchains_.clear();
+    }
+    return true;
+  }
+
+  // Samples that fall into this region will need to look it up by ID.
+  PerfEvent* mmap_event = streamed_mmap_events_.Add();
+  mmap_event->Swap(event);
+  ParsedEvent* parsed_event = &streamed_mmap_parsed_events_[id];
+  parsed_event->event_ptr = mmap_event;
+  return ProcessEvent(parsed_event, id) &&
+         streaming_handler_->HandleParsedEvent(*parsed_event);
+}
+
+void PerfParser::StartProcessingEvents() {
   stats_ = {0};
 
+  callchain_caches_.clear();
+  callchains_.clear();
+
   stats_.did_remap = false;   // Explicitly clear the remap flag.
 
   // Pid 0 is called the swapper process. Even though perf does not record a
@@ -194,83 +446,88 @@ bool PerfParser::ProcessEvents() {
   commands_.insert(kSwapperCommandName);
   pidtid_to_comm_map_[std::make_pair(kSwapperPid, kSwapperPid)] =
       &(*commands_.find(kSwapperCommandName));
+}
 
-  // NB: Not necessarily actually sorted by time.
-  for (size_t i = 0; i < parsed_events_.size(); ++i) {
-    ParsedEvent& parsed_event = parsed_events_[i];
-    PerfEvent& event = *parsed_event.event_ptr;
-    switch (event.header().type()) {
-      case PERF_RECORD_SAMPLE:
-        // SAMPLE doesn't have any fields to log at a fixed,
-        // previously-endian-swapped location. This used to log ip.
-        VLOG(1) << "SAMPLE";
-        ++stats_.num_sample_events;
-        if (MapSampleEvent(&parsed_event))
-          ++stats_.num_sample_events_mapped;
-        break;
-      case PERF_RECORD_MMAP:
-      case PERF_RECORD_MMAP2:
-      {
-        const char* mmap_type_name =
-            event.header().type() == PERF_RECORD_MMAP ? "MMAP" : "MMAP2";
-        VLOG(1) << mmap_type_name << ": " << event.mmap_event().filename();
-        ++stats_.num_mmap_events;
-        // Use the array index of the current mmap event as a unique identifier.
-        CHECK(MapMmapEvent(event.mutable_mmap_event(), i))
-            << "Unable to map " << mmap_type_name << " event!";
-        // No samples in this MMAP region yet, hopefully.
-        parsed_event.num_samples_in_mmap_region = 0;
-        DSOInfo dso_info;
-        dso_info.name = event.mmap_event().filename();
-        if (event.header().type() == PERF_RECORD_MMAP2) {
-          dso_info.maj = event.mmap_event().maj();
-          dso_info.min = event.mmap_event().min();
-          dso_info.ino = event.mmap_event().ino();
-        }
-        name_to_dso_.emplace(dso_info.name, dso_info);
-        break;
-      }
-      case PERF_RECORD_FORK:
-        VLOG(1) << "FORK: " << event.fork_event().ppid()
-                << ":" << event.fork_event().ptid()
-                << " -> " << event.fork_event().pid()
-                << ":" << event.fork_event().tid();
-        ++stats_.num_fork_events;
-        CHECK(MapForkEvent(event.fork_event())) << "Unable to map FORK event!";
-        break;
-      case PERF_RECORD_EXIT:
-        // EXIT events have the same structure as FORK events.
-        VLOG(1) << "EXIT: " << event.fork_event().ppid()
-                << ":" << event.fork_event().ptid();
-        ++stats_.num_exit_events;
-        break;
-      case PERF_RECORD_COMM:
-      {
-        VLOG(1) << "COMM: " << event.comm_event().pid()
-                << ":" << event.comm_event().tid() << ": "
-                << event.comm_event().comm();
-        ++stats_.num_comm_events;
-        CHECK(MapCommEvent(event.comm_event()));
-        commands_.insert(event.comm_event().comm());
-        const PidTid pidtid = std::make_pair(event.comm_event().pid(),
-                                             event.comm_event().tid());
-        pidtid_to_comm_map_[pidtid] =
-            &(*commands_.find(event.comm_event().comm()));
-        break;
+bool PerfParser::ProcessEvent(ParsedEvent* parsed_event, uint64_t id) {
+  PerfEvent& event = *parsed_event->event_ptr;
+  switch (event.header().type()) {
+    case PERF_RECORD_SAMPLE:
+      // SAMPLE doesn't have any fields to log at a fixed,
+      // previously-endian-swapped location. This used to log ip.
+      VLOG(1) << "SAMPLE";
+      ++stats_.num_sample_events;
+      if (MapSampleEvent(parsed_event))
+        ++stats_.num_sample_events_mapped;
+      break;
+    case PERF_RECORD_MMAP:
+    case PERF_RECORD_MMAP2:
+    {
+      const char* mmap_type_name =
+          event.header().type() == PERF_RECORD_MMAP ? "MMAP" : "MMAP2";
+      VLOG(1) << mmap_type_name << ": " << event.mmap_event().filename();
+      ++stats_.num_mmap_events;
+      // Use the index of the current mmap event as a unique identifier.
+      CHECK(MapMmapEvent(event.mutable_mmap_event(), id))
+          << "Unable to map " << mmap_type_name << " event!";
+      // No samples in this MMAP region yet, hopefully.
+      parsed_event->num_samples_in_mmap_region = 0;
+      DSOInfo dso_info;
+      dso_info.name = event.mmap_event().filename();
+      if (event.header().type() == PERF_RECORD_MMAP2) {
+        dso_info.maj = event.mmap_event().maj();
+        dso_info.min = event.mmap_event().min();
+        dso_info.ino = event.mmap_event().ino();
       }
-      case PERF_RECORD_LOST:
-      case PERF_RECORD_THROTTLE:
-      case PERF_RECORD_UNTHROTTLE:
-      case PERF_RECORD_READ:
-      case PERF_RECORD_MAX:
-        VLOG(1) << "Parsed event type: " << event.header().type()
-                << ". Doing nothing.";
-        break;
-      default:
-        LOG(ERROR) << "Unknown event type: " << event.header().type();
-        return false;
+      name_to_dso_.emplace(dso_info.name, dso_info);
+      break;
     }
+    case PERF_RECORD_FORK:
+      VLOG(1) << "FORK: " << event.fork_event().ppid()
+              << ":" << event.fork_event().ptid()
+              << " -> " << event.fork_event().pid()
+              << ":" << event.fork_event().tid();
+      ++stats_.num_fork_events;
+      CHECK(MapForkEvent(event.fork_event())) << "Unable to map FORK event!";
+      break;
+    case PERF_RECORD_EXIT:
+      // EXIT events have the same structure as FORK events.
+      VLOG(1) << "EXIT: " << event.fork_event().ppid()
+              << ":" << event.fork_event().ptid();
+      ++stats_.num_exit_events;
+      break;
+    case PERF_RECORD_COMM:
+    {
+      VLOG(1) << "COMM: " << event.comm_event().pid()
+              << ":" << event.comm_event().tid() << ": "
+              << event.comm_event().comm();
+      ++stats_.num_comm_events;
+      CHECK(MapCommEvent(event.comm_event()));
+      commands_.insert(event.comm_event().comm());
+      const PidTid pidtid = std::make_pair(event.comm_event().pid(),
+                                           event.comm_event().tid());
+      pidtid_to_comm_map_[pidtid] =
+          &(*commands_.find(event.comm_event().comm()));
+      break;
+    }
+    case PERF_RECORD_LOST:
+    case PERF_RECORD_THROTTLE:
+    case PERF_RECORD_UNTHROTTLE:
+    case PERF_RECORD_READ:
+    case PERF_RECORD_MAX:
+      VLOG(1) << "Parsed event type: " << event.header().type()
+              << ". Doing nothing.";
+      break;
+    default:
+      LOG(ERROR) << "Unknown event type: " << event.header().type();
+      return false;
   }
+  return true;
+}
+
+bool PerfParser::FinishProcessingEvents() {
+  // All samples have been mapped.
+  callchain_caches_.clear();
+
   if (!FillInDsoBuildIds())
     return false;
 
@@ -310,7 +567,11 @@ class FdCloser {
   int fd_;
 };
 
+// Reads the build ID of |dso| from the file at |dso_path|, unless |cache|, if
+// not null, already has it for that file. Updates the cache counters in
+// |stats|.
 bool ReadElfBuildIdIfSameInode(const string& dso_path, const DSOInfo& dso,
+                               BuildIdCache* cache, PerfEventStats* stats,
                                string* buildid) {
   int fd = open(dso_path.c_str(), O_RDONLY);
   FdCloser fd_closer(fd);
@@ -326,13 +587,31 @@ bool ReadElfBuildIdIfSameInode(const string& dso_path, const DSOInfo& dso,
   if (dso.maj != 0 && dso.min != 0 && !SameInode(dso, &s))
     return false;
 
-  return ReadElfBuildId(fd, buildid);
+  if (cache) {
+    if (cache->Lookup(dso.name, s, buildid)) {
+      ++stats->num_build_id_cache_hits;
+      return !buildid->empty();
+    }
+    ++stats->num_build_id_cache_misses;
+  }
+  // Files without a build ID are cached too, with an empty one.
+  string file_buildid;
+  if (!ReadElfBuildId(fd, &file_buildid))
+    file_buildid.clear();
+  if (cache)
+    cache->Insert(dso.name, s, file_buildid);
+  if (file_buildid.empty())
+    return false;
+  *buildid = file_buildid;
+  return true;
 }
 
 // Looks up build ID of a given DSO by reading directly from the file system.
 // - Does not support reading build ID of the main kernel binary.
 // - Reads build IDs of kernel modules and other DSOs using functions in dso.h.
-string FindDsoBuildId(const DSOInfo& dso_info) {
+// - Remembers the build IDs that it reads in |cache|, if not null.
+string FindDsoBuildId(const DSOInfo& dso_info, BuildIdCache* cache,
+                      PerfEventStats* stats) {
   string buildid_bin;
   const string& dso_name = dso_info.name;
   if (IsKernelNonModuleName(dso_name))
@@ -341,8 +620,20 @@ string FindDsoBuildId(const DSOInfo& dso_info) {
   if (dso_name.size() >= 2 && dso_name[0] == '[' && dso_name.back() == ']') {
     // This may not be successful, but either way, just return. buildid_bin
     // will be empty if the module was not found.
-    ReadModuleBuildId(dso_name.substr(1, dso_name.size() - 2),
-                      &buildid_bin);
+    const string module_name = dso_name.substr(1, dso_name.size() - 2);
+    struct stat s;
+    if (stat(ModuleBuildIdNotePath(module_name).c_str(), &s) != 0)
+      return buildid_bin;
+    if (cache) {
+      if (cache->Lookup(dso_name, s, &buildid_bin)) {
+        ++stats->num_build_id_cache_hits;
+        return buildid_bin;
+      }
+      ++stats->num_build_id_cache_misses;
+    }
+    ReadModuleBuildId(module_name, &buildid_bin);
+    if (cache)
+      cache->Insert(dso_name, s, buildid_bin);
     return buildid_bin;
   }
   // Try normal files, possibly inside containers.
@@ -353,7 +644,8 @@ string FindDsoBuildId(const DSOInfo& dso_info) {
     std::stringstream dso_path_stream;
     dso_path_stream << "/proc/" << tid << "/root/" << dso_name;
     string dso_path = dso_path_stream.str();
-    if (ReadElfBuildIdIfSameInode(dso_path, dso_info, &buildid_bin)) {
+    if (ReadElfBuildIdIfSameInode(dso_path, dso_info, cache, stats,
+                                  &buildid_bin)) {
       return buildid_bin;
     }
     // Avoid re-trying the parent process if it's the same for multiple threads.
@@ -365,12 +657,14 @@ string FindDsoBuildId(const DSOInfo& dso_info) {
     std::stringstream parent_dso_path_stream;
     parent_dso_path_stream << "/proc/" << pid << "/root/" << dso_name;
     string parent_dso_path = parent_dso_path_stream.str();
-    if (ReadElfBuildIdIfSameInode(parent_dso_path, dso_info, &buildid_bin)) {
+    if (ReadElfBuildIdIfSameInode(parent_dso_path, dso_info, cache, stats,
+                                  &buildid_bin)) {
       return buildid_bin;
     }
   }
   // Still don't have a buildid. Try our own filesystem:
-  if (ReadElfBuildIdIfSameInode(dso_name, dso_info, &buildid_bin)) {
+  if (ReadElfBuildIdIfSameInode(dso_name, dso_info, cache, stats,
+                                &buildid_bin)) {
     return buildid_bin;
   }
   return buildid_bin;  // still empty.
@@ -393,7 +687,8 @@ bool PerfParser::FillInDsoBuildIds() {
     // If there is both an existing build ID and a new build ID returned by
     // FindDsoBuildId(), overwrite the existing build ID.
     if (options_.read_missing_buildids && dso_info.hit) {
-      string buildid_bin = FindDsoBuildId(dso_info);
+      string buildid_bin = FindDsoBuildId(dso_info, options_.build_id_cache,
+                                          &stats_);
       if (!buildid_bin.empty()) {
         dso_info.build_id = RawDataToHexString(buildid_bin);
         new_buildids[dso_info.name] = dso_info.build_id;
@@ -421,23 +716,27 @@ void PerfParser::UpdatePerfEventsFromParsedEvents() {
   reader_->mutable_events()->Swap(&new_events);
 }
 
-bool PerfParser::MapSampleEvent(ParsedEvent* parsed_event) {
+void PerfParser::SetSampleCommand(ParsedEvent* parsed_event) {
+  const SampleEvent& sample_info = parsed_event->event_ptr->sample_event();
+  PidTid pidtid = std::make_pair(sample_info.pid(), sample_info.tid());
+  const auto comm_iter = pidtid_to_comm_map_.find(pidtid);
+  if (comm_iter != pidtid_to_comm_map_.end())
+    parsed_event->set_command(comm_iter->second);
+}
+
+bool PerfParser::MapSampleEvent(ParsedEvent* parsed_event,
+                                SampleMappingContext* context) {
   bool mapping_failed = false;
 
-  const PerfEvent& event = *parsed_event->event_ptr;
-  if (!event.has_sample_event() ||
-      !(event.sample_event().has_ip() &&
-        event.sample_event().has_pid() &&
-        event.sample_event().has_tid())) {
+  if (!IsMappableSampleEvent(*parsed_event->event_ptr))
     return false;
-  }
   SampleEvent& sample_info = *parsed_event->event_ptr->mutable_sample_event();
 
-  // Find the associated command.
+  // Find the associated command, unless that was done before handing the
+  // sample to another thread.
   PidTid pidtid = std::make_pair(sample_info.pid(), sample_info.tid());
-  const auto comm_iter = pidtid_to_comm_map_.find(pidtid);
-  if (comm_iter != pidtid_to_comm_map_.end())
-    parsed_event->set_command(comm_iter->second);
+  if (!context)
+    SetSampleCommand(parsed_event);
 
   const uint64_t unmapped_event_ip = sample_info.ip();
   uint64_t remapped_event_ip = 0;
@@ -446,7 +745,8 @@ bool PerfParser::MapSampleEvent(ParsedEvent* parsed_event) {
   if (!MapIPAndPidAndGetNameAndOffset(sample_info.ip(),
                                       pidtid,
                                       &remapped_event_ip,
-                                      &parsed_event->dso_and_offset)) {
+                                      &parsed_event->dso_and_offset,
+                                      context)) {
     mapping_failed = true;
   } else {
     sample_info.set_ip(remapped_event_ip);
@@ -457,14 +757,16 @@ bool PerfParser::MapSampleEvent(ParsedEvent* parsed_event) {
                     pidtid,
                     unmapped_event_ip,
                     sample_info.mutable_callchain(),
-                    parsed_event)) {
+                    parsed_event,
+                    context)) {
     mapping_failed = true;
   }
 
   if (sample_info.branch_stack_size() &&
       !MapBranchStack(pidtid,
                       sample_info.mutable_branch_stack(),
-                      parsed_event)) {
+                      parsed_event,
+                      context)) {
     mapping_failed = true;
   }
 
@@ -475,30 +777,69 @@ bool PerfParser::MapCallchain(const uint64_t ip,
                               const PidTid pidtid,
                               const uint64_t original_event_addr,
                               RepeatedField<uint64>* callchain,
-                              ParsedEvent* parsed_event) {
+                              ParsedEvent* parsed_event,
+                              SampleMappingContext* context) {
   if (!callchain) {
     LOG(ERROR) << "NULL call stack data.";
     return false;
   }
 
-  bool mapping_failed = false;
-
   // If the callchain's length is 0, there is no work to do.
   if (callchain->size() == 0)
     return true;
 
-  // Keeps track of whether the current entry is kernel or user.
-  parsed_event->callchain.resize(callchain->size());
+  std::vector<uint64_t> key(callchain->begin(), callchain->end());
+  key.push_back(original_event_addr);
+  CallchainCache& cache = context ? context->callchain_caches[context->mapper]
+                                  : callchain_caches_[pidtid.first];
+  auto inserted =
+      cache.insert(std::make_pair(std::move(key), MappedCallchain()));
+  MappedCallchain* mapped = &inserted.first->second;
+  if (inserted.second) {
+    auto* callchains = context ? &context->callchains : &callchains_;
+    callchains->emplace_back();
+    const AddressMapper* mapper =
+        context ? context->mapper
+                : GetOrCreateProcessMapper(pidtid.first).first;
+    MapNewCallchain(ip, pidtid, original_event_addr, *callchain, mapper,
+                    mapped, &callchains->back());
+  }
+
+  std::copy(mapped->entries.begin(), mapped->entries.end(),
+            callchain->begin());
+  parsed_event->callchain_ = mapped->dso_and_offsets;
+  for (const MmapHit& hit : mapped->hits)
+    RecordMmapHit(hit, pidtid, context);
+  return !mapped->mapping_failed;
+}
+
+void PerfParser::MapNewCallchain(
+    const uint64_t ip,
+    const PidTid pidtid,
+    const uint64_t original_event_addr,
+    const RepeatedField<uint64>& callchain,
+    const AddressMapper* mapper,
+    MappedCallchain* mapped,
+    std::vector<ParsedEvent::DSOAndOffset>* dso_and_offsets) {
+  // Collect the hits in a context of our own, so that they can be recorded
+  // again for each sample with this callchain.
+  SampleMappingContext context;
+  context.mapper = mapper;
+
+  mapped->entries.assign(callchain.begin(), callchain.end());
+  mapped->dso_and_offsets = dso_and_offsets;
+  mapped->mapping_failed = false;
+  dso_and_offsets->resize(callchain.size());
   int num_entries_mapped = 0;
-  for (int i = 0; i < callchain->size(); ++i) {
-    uint64_t entry = callchain->Get(i);
+  for (int i = 0; i < callchain.size(); ++i) {
+    uint64_t entry = callchain.Get(i);
     // When a callchain context entry is found, do not attempt to symbolize it.
     if (entry >= PERF_CONTEXT_MAX) {
       continue;
     }
     // The sample address has already been mapped so no need to map it.
     if (entry == original_event_addr) {
-      callchain->Set(i, ip);
+      mapped->entries[i] = ip;
       continue;
     }
     uint64_t mapped_addr = 0;
@@ -506,23 +847,45 @@ bool PerfParser::MapCallchain(const uint64_t ip,
             entry,
             pidtid,
             &mapped_addr,
-            &parsed_event->callchain[num_entries_mapped++])) {
-      mapping_failed = true;
+            &(*dso_and_offsets)[num_entries_mapped++],
+            &context)) {
+      mapped->mapping_failed = true;
     } else {
-      callchain->Set(i, mapped_addr);
+      mapped->entries[i] = mapped_addr;
     }
   }
-  // Not all the entries were mapped.  Trim |parsed_event->callchain| to
-  // remove unused entries at the end.
-  parsed_event->callchain.resize(num_entries_mapped);
+  // Not all the entries were mapped.  Trim |dso_and_offsets| to remove unused
+  // entries at the end.
+  dso_and_offsets->resize(num_entries_mapped);
+  dso_and_offsets->shrink_to_fit();
+  mapped->hits.swap(context.hits);
+}
 
-  return !mapping_failed;
+size_t PerfParser::CallchainHash::operator()(
+    const std::vector<uint64_t>& key) const {
+  size_t hash = key.size();
+  for (uint64_t entry : key)
+    hash ^= std::hash<uint64_t>()(entry) + 0x9e3779b9 + (hash << 6) +
+            (hash >> 2);
+  return hash;
+}
+
+void PerfParser::RecordMmapHit(const MmapHit& hit, PidTid pidtid,
+                               SampleMappingContext* context) {
+  if (context) {
+    context->hits.push_back(MmapHit{hit.mmap_event, hit.dso_info, pidtid});
+    return;
+  }
+  hit.dso_info->hit = true;
+  hit.dso_info->threads.insert(pidtid);
+  ++hit.mmap_event->num_samples_in_mmap_region;
 }
 
 bool PerfParser::MapBranchStack(
     const PidTid pidtid,
     RepeatedPtrField<BranchStackEntry>* branch_stack,
-    ParsedEvent* parsed_event) {
+    ParsedEvent* parsed_event,
+    SampleMappingContext* context) {
   if (!branch_stack) {
     LOG(ERROR) << "NULL branch stack data.";
     return false;
@@ -559,7 +922,8 @@ bool PerfParser::MapBranchStack(
     if (!MapIPAndPidAndGetNameAndOffset(entry->from_ip(),
                                         pidtid,
                                         &from_mapped,
-                                        &parsed_entry.from)) {
+                                        &parsed_entry.from,
+                                        context)) {
       return false;
     }
     entry->set_from_ip(from_mapped);
@@ -568,7 +932,8 @@ bool PerfParser::MapBranchStack(
     if (!MapIPAndPidAndGetNameAndOffset(entry->to_ip(),
                                         pidtid,
                                         &to_mapped,
-                                        &parsed_entry.to)) {
+                                        &parsed_entry.to,
+                                        context)) {
       return false;
     }
     entry->set_to_ip(to_mapped);
@@ -583,7 +948,8 @@ bool PerfParser::MapIPAndPidAndGetNameAndOffset(
     uint64_t ip,
     PidTid pidtid,
     uint64_t* new_ip,
-    ParsedEvent::DSOAndOffset* dso_and_offset) {
+    ParsedEvent::DSOAndOffset* dso_and_offset,
+    SampleMappingContext* context) {
   DCHECK(dso_and_offset);
   // Attempt to find the synthetic address of the IP sample in this order:
   // 1. Address space of the kernel.
@@ -594,16 +960,15 @@ bool PerfParser::MapIPAndPidAndGetNameAndOffset(
 
   // Sometimes the first event we see is a SAMPLE event and we don't have the
   // time to create an address mapper for a process. Example, for pid 0.
-  AddressMapper* mapper = GetOrCreateProcessMapper(pidtid.first).first;
+  const AddressMapper* mapper =
+      context ? context->mapper : GetOrCreateProcessMapper(pidtid.first).first;
   bool mapped = mapper->GetMappedAddress(ip, &mapped_addr);
   // TODO(asharif): What should we do when we cannot map a SAMPLE event?
 
   if (mapped) {
     uint64_t id = UINT64_MAX;
     CHECK(mapper->GetMappedIDAndOffset(ip, &id, &dso_and_offset->offset_));
-    // Make sure the ID points to a valid event.
-    CHECK_LE(id, parsed_events_.size());
-    ParsedEvent& parsed_event = parsed_events_[id];
+    ParsedEvent& parsed_event = *GetMmapParsedEvent(id);
     const auto& event = parsed_event.event_ptr;
     DCHECK(event->has_mmap_event()) << "Expected MMAP or MMAP2 event";
 
@@ -612,9 +977,8 @@ bool PerfParser::MapIPAndPidAndGetNameAndOffset(
     CHECK(dso_iter != name_to_dso_.end());
     dso_and_offset->dso_info_ = &dso_iter->second;
 
-    dso_iter->second.hit = true;
-    dso_iter->second.threads.insert(pidtid);
-    ++parsed_event.num_samples_in_mmap_region;
+    RecordMmapHit(MmapHit{&parsed_event, &dso_iter->second, pidtid}, pidtid,
+                  context);
 
     if (options_.do_remap) {
       if (GetPageAlignedOffset(mapped_addr) != GetPageAlignedOffset(ip)) {
@@ -631,6 +995,25 @@ bool PerfParser::MapIPAndPidAndGetNameAndOffset(
   return mapped;
 }
 
+const std::vector<ParsedEvent::DSOAndOffset>& ParsedEvent::callchain() const {
+  static const std::vector<DSOAndOffset>* const kEmptyCallchain =
+      new std::vector<DSOAndOffset>;
+  if (callchain_)
+    return *callchain_;
+  return *kEmptyCallchain;
+}
+
+ParsedEvent* PerfParser::GetMmapParsedEvent(uint64_t id) {
+  if (streaming_handler_) {
+    auto iter = streamed_mmap_parsed_events_.find(id);
+    CHECK(iter != streamed_mmap_parsed_events_.end());
+    return &iter->second;
+  }
+  // Make sure the ID points to a valid event.
+  CHECK_LE(id, parsed_events_.size());
+  return &parsed_events_[id];
+}
+
 bool PerfParser::MapMmapEvent(PerfDataProto_MMapEvent* event, uint64_t id) {
   // We need to hide only the real kernel addresses.  However, to make things
   // more secure, and make the mapping idempotent, we should remap all
@@ -684,6 +1067,8 @@ bool PerfParser::MapMmapEvent(PerfDataProto_MMapEvent* event, uint64_t id) {
     mapper->DumpToLog();
     return false;
   }
+  // Callchains mapped so far may map differently now.
+  callchain_caches_.erase(event->pid());
 
   if (options_.do_remap) {
     uint64_t mapped_addr;
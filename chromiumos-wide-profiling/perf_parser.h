@@ -7,6 +7,7 @@
 
 #include <stdint.h>
 
+#include <list>
 #include <map>
 #include <memory>
 #include <set>
@@ -26,6 +27,7 @@
 namespace quipper {
 
 class AddressMapper;
+class BuildIdCache;
 class PerfDataProto_BranchStackEntry;
 class PerfDataProto_CommEvent;
 class PerfDataProto_ForkEvent;
@@ -34,7 +36,7 @@ class PerfDataProto_PerfEvent;
 
 struct ParsedEvent {
   // TODO(sque): Turn this struct into a class to privatize member variables.
-  ParsedEvent() : command_(NULL) {}
+  ParsedEvent() : command_(NULL), callchain_(NULL) {}
 
   // Stores address of the original PerfDataProto_PerfEvent owned by a
   // PerfReader object.
@@ -88,8 +90,15 @@ struct ParsedEvent {
     }
   } dso_and_offset;
 
-  // DSO + offset info for callchain.
-  std::vector<DSOAndOffset> callchain;
+  // DSO + offset info for callchain. Owned by the PerfParser, and shared by
+  // the samples of a process that have identical callchains. Like the
+  // |dso_info_| pointers of the entries, it is only valid until the
+  // PerfParser is destroyed or parses again; during ParseFileStreaming(), only
+  // until HandleParsedEvent() returns. Copy the entries to keep them longer.
+  const std::vector<DSOAndOffset>* callchain_;
+
+  // Accessor for callchain. The result has the lifetime of |callchain_|.
+  const std::vector<DSOAndOffset>& callchain() const;
 
   // DSO + offset info for branch stack entries.
   struct BranchEntry {
@@ -108,8 +117,9 @@ struct ParsedEvent {
   // For comparing ParsedEvents.
   bool operator == (const ParsedEvent& other) const {
     return dso_and_offset == other.dso_and_offset &&
-           std::equal(callchain.begin(), callchain.end(),
-                      other.callchain.begin()) &&
+           callchain().size() == other.callchain().size() &&
+           std::equal(callchain().begin(), callchain().end(),
+                      other.callchain().begin()) &&
            std::equal(branch_stack.begin(), branch_stack.end(),
                       other.branch_stack.begin());
   }
@@ -131,6 +141,12 @@ struct PerfEventStats {
 
   // Whether address remapping was enabled during event parsing.
   bool did_remap;
+
+  // Number of build IDs that |read_missing_buildids| found in
+  // |PerfParserOptions::build_id_cache|, and that had to be read from the
+  // filesystem. Both stay 0 without a cache.
+  uint32_t num_build_id_cache_hits;
+  uint32_t num_build_id_cache_misses;
 };
 
 struct PerfParserOptions {
@@ -153,6 +169,9 @@ struct PerfParserOptions {
   // If buildids are missing from the input data, they can be retrieved from
   // the filesystem.
   bool read_missing_buildids = false;
+  // Build IDs read from the filesystem are remembered here, if not null. The
+  // cache is not owned by the parser.
+  BuildIdCache* build_id_cache = nullptr;
   // Checks for a split binary mapping where part of it is mapped as huge pages.
   // Combines the split mappings into a single mapping so future consumers of
   // the perf data can see that it is actually a single mapping and not two or
@@ -161,9 +180,32 @@ struct PerfParserOptions {
   // Right now, this is only enabled for Chrome. In the future, it could be
   // expanded to other binaries if they end up being huge pages-mapped.
   bool combine_huge_pages_mappings = false;
+  // Number of threads to map sample events on in ParseRawEvents(). With more
+  // than one, each sample is mapped against a copy of its process's mappings as
+  // of the sample's place in the event order, after all other events have been
+  // processed. This costs a copy of a process's mappings every time a sample
+  // follows a change to them. Not used by ParseFileStreaming().
+  int num_mapping_threads = 1;
+  // Maximum number of distinct mapped callchains that ParseFileStreaming()
+  // keeps for reuse. Callchains are keyed by the sample IP as well, so without
+  // a limit they would grow with the number of samples. Once there are this
+  // many, they are all dropped and mapped again as needed.
+  size_t max_streamed_callchains = 4096;
+};
+
+// Receives events from PerfParser::ParseFileStreaming() once they have been
+// processed.
+class ParsedEventHandler {
+ public:
+  virtual ~ParsedEventHandler() {}
+
+  // Called for each processed event. |parsed_event.event_ptr| and the
+  // event it points to, and |parsed_event.callchain()|, are only valid for the
+  // duration of the call. Returning false aborts parsing.
+  virtual bool HandleParsedEvent(const ParsedEvent& parsed_event) = 0;
 };
 
-class PerfParser {
+class PerfParser : public PerfEventHandler {
  public:
   explicit PerfParser(PerfReader* reader);
   ~PerfParser();
@@ -182,6 +224,27 @@ class PerfParser {
   // invalidated.
   bool ParseRawEvents();
 
+  // Reads |filename| with |reader_| and processes its events as they are read,
+  // handing each one to |handler| instead of keeping it. The attrs and
+  // metadata still end up in |reader_|, but its events() stay empty, so memory
+  // use does not grow with the number of samples. Only MMAP/MMAP2 events are
+  // retained, for looking up DSOs.
+  //
+  // If |options_.sort_events_by_time| is set, events are buffered and sorted
+  // one PERF_RECORD_FINISHED_ROUND at a time, the way perf itself orders them;
+  // inputs without round markers are buffered in full. Options that need the
+  // whole profile up front, |discard_unused_events| and
+  // |combine_huge_pages_mappings|, are not supported. parsed_events() is not
+  // populated.
+  bool ParseFileStreaming(const string& filename, ParsedEventHandler* handler);
+
+  // PerfEventHandler implementation, called by |reader_| during
+  // ParseFileStreaming().
+  bool HandleEvent(PerfDataProto_PerfEvent* event) override;
+
+  // The events point into storage owned by this parser, such as their
+  // callchains, so they must not be used after it is destroyed or parses
+  // again.
   const std::vector<ParsedEvent>& parsed_events() const {
     return parsed_events_;
   }
@@ -190,6 +253,12 @@ class PerfParser {
     return stats_;
   }
 
+  // Returns the number of distinct mapped callchains that are currently kept
+  // for the parsed events to point to.
+  size_t num_stored_callchains() const {
+    return callchains_.size();
+  }
+
   // Use with caution. Deserialization uses this to restore stats from proto.
   PerfEventStats* mutable_stats() {
     return &stats_;
@@ -199,6 +268,28 @@ class PerfParser {
   // Used for processing events.  e.g. remapping with synthetic addresses.
   bool ProcessEvents();
 
+  // The stages of ProcessEvents(), shared with ParseFileStreaming().
+  // StartProcessingEvents() resets the stats and per-process state.
+  // ProcessEvent() processes a single event, where |id| is its index in the
+  // processing order. FinishProcessingEvents() fills in build IDs and checks
+  // how many samples were mapped.
+  void StartProcessingEvents();
+  bool ProcessEvent(ParsedEvent* parsed_event, uint64_t id);
+  bool FinishProcessingEvents();
+
+  // Processes an event during ParseFileStreaming() and passes it on to
+  // |streaming_handler_|. MMAP/MMAP2 events are swapped out of |event| and
+  // retained.
+  bool ProcessStreamedEvent(PerfDataProto_PerfEvent* event);
+
+  // Sorts |pending_events_| by time if possible, then processes and removes
+  // those with a timestamp no later than |max_time|. If the events can not be
+  // sorted, processes all of them in their original order.
+  bool FlushPendingEvents(uint64_t max_time);
+
+  // Returns the MMAP/MMAP2 event that was given the mapping ID |id|.
+  ParsedEvent* GetMmapParsedEvent(uint64_t id);
+
   // Looks up build IDs for all DSOs present in |reader_| by direct lookup using
   // functions in dso.h. If there is a DSO with both an existing build ID and a
   // new build ID read using dso.h, this will overwrite the existing build ID.
@@ -209,22 +300,95 @@ class PerfParser {
   // |reader_| would be updated to contain the new sequence of events.
   void UpdatePerfEventsFromParsedEvents();
 
+  // A sample address that was mapped into the region of a MMAP/MMAP2 event.
+  struct MmapHit {
+    ParsedEvent* mmap_event;
+    DSOInfo* dso_info;
+    PidTid pidtid;
+  };
+
+  // The result of mapping a callchain against one version of the mappings of a
+  // process, which is reused for samples with the same callchain until the
+  // mappings change.
+  struct MappedCallchain {
+    // The callchain entries after mapping.
+    std::vector<uint64_t> entries;
+    // DSO + offset info for the entries, as in ParsedEvent::callchain().
+    const std::vector<ParsedEvent::DSOAndOffset>* dso_and_offsets;
+    // The MMAP regions that the entries fell in. The pid/tid of each hit is
+    // that of the sample being mapped.
+    std::vector<MmapHit> hits;
+    bool mapping_failed;
+  };
+
+  struct CallchainHash {
+    size_t operator()(const std::vector<uint64_t>& key) const;
+  };
+
+  // Mapped callchains, keyed by the unmapped callchain entries followed by the
+  // unmapped sample IP.
+  typedef std::unordered_map<std::vector<uint64_t>, MappedCallchain,
+                             CallchainHash> CallchainCache;
+
+  // State for mapping samples on a thread other than the one processing the
+  // other events. Without one, samples are mapped against the current
+  // mappings of their process, and their hits are recorded right away.
+  struct SampleMappingContext {
+    // The mappings of the sample's process to map against.
+    const AddressMapper* mapper;
+    // Hits to record once all threads are done.
+    std::vector<MmapHit> hits;
+    // Callchains mapped on this thread, by the mapper they were mapped
+    // against, and the storage for their DSO + offsets.
+    std::map<const AddressMapper*, CallchainCache> callchain_caches;
+    std::list<std::vector<ParsedEvent::DSOAndOffset>> callchains;
+  };
+
+  // Maps the sample events of |parsed_events_| on
+  // |options_.num_mapping_threads| threads, and processes the other events on
+  // this one.
+  bool ProcessEventsAndMapSamplesInParallel();
+
+  // Runs MapSampleEvent() on a range of samples.
+  class SampleMappingThread;
+
   // Does a sample event remap and then returns DSO name and offset of sample.
-  bool MapSampleEvent(ParsedEvent* parsed_event);
+  bool MapSampleEvent(ParsedEvent* parsed_event,
+                      SampleMappingContext* context = nullptr);
 
-  // Calls MapIPAndPidAndGetNameAndOffset() on the callchain of a sample event.
+  // Calls MapIPAndPidAndGetNameAndOffset() on the callchain of a sample event,
+  // unless the same callchain has been mapped against the same mappings
+  // before.
   bool MapCallchain(const uint64_t ip,
                     const PidTid pidtid,
                     uint64_t original_event_addr,
                     RepeatedField<uint64>* callchain,
-                    ParsedEvent* parsed_event);
+                    ParsedEvent* parsed_event,
+                    SampleMappingContext* context);
+
+  // Maps the entries of |callchain| against |mapper| into |mapped| and
+  // |dso_and_offsets|, collecting the hits in |mapped| instead of recording
+  // them.
+  void MapNewCallchain(const uint64_t ip,
+                       const PidTid pidtid,
+                       uint64_t original_event_addr,
+                       const RepeatedField<uint64>& callchain,
+                       const AddressMapper* mapper,
+                       MappedCallchain* mapped,
+                       std::vector<ParsedEvent::DSOAndOffset>* dso_and_offsets);
+
+  // Records that a sample of |pidtid| fell in the region of |hit|, or adds it
+  // to the hits of |context| if there is one.
+  void RecordMmapHit(const MmapHit& hit, PidTid pidtid,
+                     SampleMappingContext* context);
 
   // Trims the branch stack for null entries and calls
   // MapIPAndPidAndGetNameAndOffset() on each entry.
   bool MapBranchStack(
       const PidTid pidtid,
       RepeatedPtrField<PerfDataProto_BranchStackEntry>* branch_stack,
-      ParsedEvent* parsed_event);
+      ParsedEvent* parsed_event,
+      SampleMappingContext* context);
 
   // This maps a sample event and returns the mapped address, DSO name, and
   // offset within the DSO.  This is a private function because the API might
@@ -234,7 +398,12 @@ class PerfParser {
       uint64_t ip,
       const PidTid pidtid,
       uint64_t* new_ip,
-      ParsedEvent::DSOAndOffset* dso_and_offset);
+      ParsedEvent::DSOAndOffset* dso_and_offset,
+      SampleMappingContext* context);
+
+  // Sets the command of the sample event |parsed_event| from the command of
+  // its thread so far.
+  void SetSampleCommand(ParsedEvent* parsed_event);
 
   // Parses a MMAP event. Adds the mapping to the AddressMapper of the event's
   // process. If |options_.do_remap| is set, will update |event| with the
@@ -281,6 +450,31 @@ class PerfParser {
   // Maps process ID to an address mapper for that process.
   std::map<uint32_t, std::unique_ptr<AddressMapper>> process_mappers_;
 
+  // Callchains mapped against the current mappings of each process, by pid.
+  std::map<uint32_t, CallchainCache> callchain_caches_;
+
+  // Storage for the distinct callchains pointed to by the parsed events.
+  std::list<std::vector<ParsedEvent::DSOAndOffset>> callchains_;
+
+  // The following are only used during ParseFileStreaming().
+
+  // Receives the processed events. Set only while streaming.
+  ParsedEventHandler* streaming_handler_;
+
+  // Number of events processed so far. Used as the ID of the next event.
+  uint64_t num_streamed_events_;
+
+  // Events waiting to be sorted by time, and the latest timestamps seen
+  // before the current and the previous PERF_RECORD_FINISHED_ROUND.
+  RepeatedPtrField<PerfDataProto_PerfEvent> pending_events_;
+  uint64_t round_max_time_;
+  uint64_t previous_round_max_time_;
+
+  // Storage for the retained MMAP/MMAP2 events, and their ParsedEvents keyed
+  // by ID, which take the place of |parsed_events_| for DSO lookups.
+  RepeatedPtrField<PerfDataProto_PerfEvent> streamed_mmap_events_;
+  std::map<uint64_t, ParsedEvent> streamed_mmap_parsed_events_;
+
   DISALLOW_COPY_AND_ASSIGN(PerfParser);
 };
 
@@ -0,0 +1,94 @@
+// Copyright 2016 The Chromium OS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// Measures how long PerfParser takes to process perf data files with different
+// numbers of sample mapping threads. Runs over the perf.data files used by the
+// tests, or over the files given on the command line.
+
+#include <stdlib.h>
+
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <vector>
+
+#include "base/logging.h"
+
+#include "chromiumos-wide-profiling/compat/log_level.h"
+#include "chromiumos-wide-profiling/compat/string.h"
+#include "chromiumos-wide-profiling/file_utils.h"
+#include "chromiumos-wide-profiling/perf_parser.h"
+#include "chromiumos-wide-profiling/perf_reader.h"
+#include "chromiumos-wide-profiling/perf_test_files.h"
+#include "chromiumos-wide-profiling/test_utils.h"
+
+namespace {
+
+// Numbers of threads to benchmark.
+const int kNumMappingThreads[] = {1, 2, 4, 8, 16};
+
+// Each configuration is timed this many times, and the fastest run is kept.
+const int kNumRuns = 3;
+
+// Returns the fastest time in seconds that it took to parse |data| with
+// |num_mapping_threads| threads.
+double TimeParse(const std::vector<char>& data, int num_mapping_threads) {
+  quipper::PerfParserOptions options;
+  options.do_remap = true;
+  options.sample_mapping_percentage_threshold = 0;
+  options.num_mapping_threads = num_mapping_threads;
+
+  double best_time = 0;
+  for (int run = 0; run < kNumRuns; ++run) {
+    // Parsing modifies the events, so start from a fresh copy every time.
+    quipper::PerfReader reader;
+    CHECK(reader.ReadFromVector(data));
+    quipper::PerfParser parser(&reader, options);
+
+    auto start_time = std::chrono::steady_clock::now();
+    CHECK(parser.ParseRawEvents());
+    double time = std::chrono::duration<double>(
+        std::chrono::steady_clock::now() - start_time).count();
+    if (run == 0 || time < best_time)
+      best_time = time;
+  }
+  return best_time;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  // Keep the parser's per-file stats out of the results.
+  quipper::SetVerbosityLevel(-1);
+
+  std::vector<string> filenames(argv + 1, argv + argc);
+  if (filenames.empty()) {
+    for (const char* test_file : perf_test_files::GetPerfDataFiles())
+      filenames.push_back(quipper::GetTestInputFilePath(test_file));
+  }
+
+  std::cout << std::left << std::setw(40) << "file" << std::right
+            << std::setw(8) << "threads" << std::setw(12) << "ms"
+            << std::setw(10) << "speedup" << std::endl;
+  for (const string& filename : filenames) {
+    std::vector<char> data;
+    if (!quipper::FileToBuffer(filename, &data)) {
+      LOG(ERROR) << "Unable to read " << filename;
+      continue;
+    }
+
+    double serial_time = 0;
+    for (int num_mapping_threads : kNumMappingThreads) {
+      double time = TimeParse(data, num_mapping_threads);
+      if (num_mapping_threads == 1)
+        serial_time = time;
+      std::cout << std::left << std::setw(40) << filename << std::right
+                << std::setw(8) << num_mapping_threads
+                << std::setw(12) << std::fixed << std::setprecision(2)
+                << time * 1e3
+                << std::setw(10) << serial_time / time << std::endl;
+    }
+  }
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,135 @@
+// Copyright 2016 The Chromium OS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// Measures how long PerfParser takes to map callchain-heavy profiles, and how
+// much memory the parsed callchains take, on synthetic profiles in which many
+// samples share a limited number of deep stacks.
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <set>
+#include <sstream>
+#include <vector>
+
+#include "base/logging.h"
+
+#include "chromiumos-wide-profiling/compat/log_level.h"
+#include "chromiumos-wide-profiling/compat/string.h"
+#include "chromiumos-wide-profiling/kernel/perf_event.h"
+#include "chromiumos-wide-profiling/perf_parser.h"
+#include "chromiumos-wide-profiling/perf_reader.h"
+#include "chromiumos-wide-profiling/test_perf_data.h"
+
+namespace {
+
+// Number of processes that the samples are spread over. Each has its own
+// mappings and its own set of stacks.
+const int kNumProcesses = 8;
+
+// Size of each process's mapping, which all stack addresses fall in.
+const uint64_t kMappingSize = 0x100000;
+
+// Profile sizes to benchmark.
+const struct {
+  int num_stacks;  // Distinct stacks per process.
+  int depth;
+  int num_samples;
+} kProfiles[] = {
+  {100, 32, 200000},
+  {10000, 32, 200000},
+  {1000, 64, 500000},
+};
+
+// Returns piped perf data with |num_samples| samples, each taking one of
+// |num_stacks| stacks of |depth| entries in its process.
+string GenerateProfile(int num_stacks, int depth, int num_samples) {
+  std::stringstream input;
+  quipper::testing::ExamplePipedPerfDataFileHeader().WriteTo(&input);
+  quipper::testing::ExamplePerfEventAttrEvent_Hardware(
+      PERF_SAMPLE_IP | PERF_SAMPLE_TID | PERF_SAMPLE_CALLCHAIN,
+      true /*sample_id_all*/).WriteTo(&input);
+
+  std::mt19937_64 rng(0);
+  std::uniform_int_distribution<uint64_t> offset(0, kMappingSize - 1);
+  std::vector<std::vector<std::vector<uint64_t>>> stacks(kNumProcesses);
+  for (int process = 0; process < kNumProcesses; ++process) {
+    const uint32_t pid = 1000 + process;
+    const uint64_t start = 0x400000 + process * kMappingSize;
+    quipper::testing::ExampleMmapEvent(
+        pid, start, kMappingSize, 0, "/usr/lib/libbenchmark.so",
+        quipper::testing::SampleInfo().Tid(pid)).WriteTo(&input);
+    for (int i = 0; i < num_stacks; ++i) {
+      std::vector<uint64_t> stack = {PERF_CONTEXT_USER};
+      for (int j = 0; j < depth; ++j)
+        stack.push_back(start + offset(rng));
+      stacks[process].push_back(stack);
+    }
+  }
+
+  // Make some stacks much more common than others, as in real profiles.
+  std::geometric_distribution<int> stack_index(10.0 / num_stacks);
+  for (int i = 0; i < num_samples; ++i) {
+    const int process = i % kNumProcesses;
+    const std::vector<uint64_t>& stack =
+        stacks[process][stack_index(rng) % num_stacks];
+    quipper::testing::ExamplePerfSampleEvent(
+        quipper::testing::SampleInfo().Ip(stack[1]).Tid(1000 + process)
+            .Callchain(stack)).WriteTo(&input);
+  }
+  return input.str();
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  // Keep the parser's stats out of the results.
+  quipper::SetVerbosityLevel(-1);
+
+  std::cout << std::setw(8) << "stacks" << std::setw(7) << "depth"
+            << std::setw(9) << "samples" << std::setw(10) << "parse ms"
+            << std::setw(12) << "distinct" << std::setw(14) << "shared KB"
+            << std::setw(16) << "per-sample KB" << std::endl;
+  for (const auto& profile : kProfiles) {
+    string data =
+        GenerateProfile(profile.num_stacks, profile.depth, profile.num_samples);
+    quipper::PerfReader reader;
+    CHECK(reader.ReadFromString(data));
+
+    quipper::PerfParserOptions options;
+    options.do_remap = true;
+    quipper::PerfParser parser(&reader, options);
+    auto start_time = std::chrono::steady_clock::now();
+    CHECK(parser.ParseRawEvents());
+    double time = std::chrono::duration<double>(
+        std::chrono::steady_clock::now() - start_time).count();
+
+    // Compare the memory taken by the callchains of the parsed events with the
+    // memory they would take if each event had its own copy.
+    std::set<const void*> distinct_callchains;
+    size_t shared_bytes = 0;
+    size_t per_sample_bytes = 0;
+    for (const quipper::ParsedEvent& event : parser.parsed_events()) {
+      const auto& callchain = event.callchain();
+      size_t bytes = sizeof(callchain) + callchain.size() * sizeof(callchain[0]);
+      per_sample_bytes += bytes;
+      if (distinct_callchains.insert(&callchain).second)
+        shared_bytes += bytes;
+    }
+
+    std::cout << std::setw(8) << profile.num_stacks
+              << std::setw(7) << profile.depth
+              << std::setw(9) << profile.num_samples
+              << std::setw(10) << std::fixed << std::setprecision(1)
+              << time * 1e3
+              << std::setw(12) << distinct_callchains.size()
+              << std::setw(14) << shared_bytes / 1024
+              << std::setw(16) << per_sample_bytes / 1024 << std::endl;
+  }
+  return EXIT_SUCCESS;
+}
@@ -16,10 +16,13 @@
 
 #include "base/logging.h"
 
+#include "chromiumos-wide-profiling/build_id_cache.h"
 #include "chromiumos-wide-profiling/compat/string.h"
 #include "chromiumos-wide-profiling/compat/test.h"
 #include "chromiumos-wide-profiling/compat/thread.h"
 #include "chromiumos-wide-profiling/dso_test_utils.h"
+#include "chromiumos-wide-profiling/file_utils.h"
+#include "chromiumos-wide-profiling/perf_data_utils.h"
 #include "chromiumos-wide-profiling/perf_parser.h"
 #include "chromiumos-wide-profiling/perf_reader.h"
 #include "chromiumos-wide-profiling/perf_test_files.h"
@@ -1433,6 +1436,267 @@ TEST(PerfParserTest, OnlyReadsBuildidIfSampled) {
   EXPECT_EQ(filenames_to_build_ids.end(), it) << it->first << " "<< it->second;
 }
 
+TEST(PerfParserTest, ReadsBuildidsThroughCache) {
+  ScopedTempDir tmpdir("/tmp/quipper_tmp.");
+  const string unknown_file = tmpdir.path() + "buildid_not_known";
+  InitializeLibelf();
+  testing::WriteElfWithBuildid(unknown_file, ".note.gnu.build-id",
+                               "\xc0\x01\xd0\x0d");
+
+  std::stringstream input;
+
+  // header
+  testing::ExamplePipedPerfDataFileHeader().WriteTo(&input);
+
+  // data
+
+  // PERF_RECORD_HEADER_ATTR
+  testing::ExamplePerfEventAttrEvent_Hardware(PERF_SAMPLE_IP | PERF_SAMPLE_TID,
+                                              true /*sample_id_all*/)
+      .WriteTo(&input);
+
+  // PERF_RECORD_MMAP
+  testing::ExampleMmapEvent(
+      1001, 0x1c1000, 0x1000, 0, unknown_file,
+      testing::SampleInfo().Tid(1001)).WriteTo(&input);        // 0
+
+  // PERF_RECORD_SAMPLE
+  testing::ExamplePerfSampleEvent(
+      testing::SampleInfo().Ip(0x00000000001c100a).Tid(1001))  // 1
+      .WriteTo(&input);
+
+  //
+  // Parse input twice, sharing a cache.
+  //
+
+  BuildIdCache cache;
+  PerfParserOptions options;
+  options.read_missing_buildids = true;
+  options.build_id_cache = &cache;
+
+  for (int i = 0; i < 2; ++i) {
+    PerfReader reader;
+    EXPECT_TRUE(reader.ReadFromString(input.str()));
+    PerfParser parser(&reader, options);
+    EXPECT_TRUE(parser.ParseRawEvents());
+
+    // Only the first parse reads the file.
+    EXPECT_EQ(i == 0 ? 0 : 1, parser.stats().num_build_id_cache_hits);
+    EXPECT_EQ(i == 0 ? 1 : 0, parser.stats().num_build_id_cache_misses);
+
+    const std::vector<ParsedEvent>& events = parser.parsed_events();
+    ASSERT_EQ(2, events.size());
+    EXPECT_EQ(unknown_file, events[1].dso_and_offset.dso_name());
+    EXPECT_EQ("c001d00d", events[1].dso_and_offset.build_id());
+  }
+  EXPECT_EQ(1, cache.size());
+
+  // Without a cache, the file is read every time.
+  options.build_id_cache = nullptr;
+  PerfReader reader;
+  EXPECT_TRUE(reader.ReadFromString(input.str()));
+  PerfParser parser(&reader, options);
+  EXPECT_TRUE(parser.ParseRawEvents());
+  EXPECT_EQ(0, parser.stats().num_build_id_cache_hits);
+  EXPECT_EQ(0, parser.stats().num_build_id_cache_misses);
+  EXPECT_EQ("c001d00d",
+            parser.parsed_events()[1].dso_and_offset.build_id());
+}
+
+TEST(PerfParserTest, MapsSamplesOnMultipleThreads) {
+  std::stringstream input;
+
+  // header
+  testing::ExamplePipedPerfDataFileHeader().WriteTo(&input);
+
+  // PERF_RECORD_HEADER_ATTR
+  testing::ExamplePerfEventAttrEvent_Hardware(PERF_SAMPLE_IP |
+                                              PERF_SAMPLE_TID |
+                                              PERF_SAMPLE_TIME,
+                                              true /*sample_id_all*/)
+      .WriteTo(&input);
+
+  // Samples must be mapped against the mappings of their process at the time,
+  // not those at the end of the profile.
+  testing::ExampleMmapEvent(
+      1001, 0x1c1000, 0x1000, 0, "/usr/lib/foo.so",
+      testing::SampleInfo().Tid(1001).Time(10)).WriteTo(&input);
+  testing::ExamplePerfSampleEvent(                                // 1
+      testing::SampleInfo().Ip(0x1c1100).Tid(1001).Time(20)).WriteTo(&input);
+  testing::ExamplePerfSampleEvent(                                // 2
+      testing::SampleInfo().Ip(0x2c1100).Tid(1001).Time(30)).WriteTo(&input);
+  testing::ExampleMmapEvent(
+      1001, 0x2c1000, 0x1000, 0, "/usr/lib/bar.so",
+      testing::SampleInfo().Tid(1001).Time(40)).WriteTo(&input);
+  testing::ExamplePerfSampleEvent(                                // 4
+      testing::SampleInfo().Ip(0x2c1100).Tid(1001).Time(50)).WriteTo(&input);
+  testing::ExampleForkEvent(
+      1002, 1001, 1002, 1001, 60,
+      testing::SampleInfo().Tid(1002).Time(60)).WriteTo(&input);
+  testing::ExampleMmapEvent(
+      1001, 0x3c1000, 0x1000, 0, "/usr/lib/baz.so",
+      testing::SampleInfo().Tid(1001).Time(70)).WriteTo(&input);
+  testing::ExamplePerfSampleEvent(                                // 7
+      testing::SampleInfo().Ip(0x3c1100).Tid(1002).Time(80)).WriteTo(&input);
+  testing::ExamplePerfSampleEvent(                                // 8
+      testing::SampleInfo().Ip(0x2c1200).Tid(1002).Time(90)).WriteTo(&input);
+  testing::ExampleMmapEvent(
+      1001, 0x1c1000, 0x1000, 0, "/usr/lib/qux.so",
+      testing::SampleInfo().Tid(1001).Time(100)).WriteTo(&input);
+  testing::ExamplePerfSampleEvent(                                // 10
+      testing::SampleInfo().Ip(0x1c1100).Tid(1001).Time(110)).WriteTo(&input);
+  testing::ExamplePerfSampleEvent(                                // 11
+      testing::SampleInfo().Ip(0x3c1100).Tid(1001).Time(120)).WriteTo(&input);
+
+  PerfParserOptions options;
+  options.sample_mapping_percentage_threshold = 0;
+  options.do_remap = true;
+
+  PerfReader serial_reader;
+  ASSERT_TRUE(serial_reader.ReadFromString(input.str()));
+  PerfParser serial_parser(&serial_reader, options);
+  ASSERT_TRUE(serial_parser.ParseRawEvents());
+
+  options.num_mapping_threads = 3;
+  PerfReader parallel_reader;
+  ASSERT_TRUE(parallel_reader.ReadFromString(input.str()));
+  PerfParser parallel_parser(&parallel_reader, options);
+  ASSERT_TRUE(parallel_parser.ParseRawEvents());
+
+  EXPECT_EQ(7, parallel_parser.stats().num_sample_events);
+  EXPECT_EQ(5, parallel_parser.stats().num_sample_events_mapped);
+  EXPECT_EQ(serial_parser.stats().num_sample_events_mapped,
+            parallel_parser.stats().num_sample_events_mapped);
+
+  const std::vector<ParsedEvent>& serial_events =
+      serial_parser.parsed_events();
+  const std::vector<ParsedEvent>& parallel_events =
+      parallel_parser.parsed_events();
+  ASSERT_EQ(12, parallel_events.size());
+  ASSERT_EQ(serial_events.size(), parallel_events.size());
+  for (size_t i = 0; i < parallel_events.size(); ++i) {
+    EXPECT_TRUE(serial_events[i] == parallel_events[i]) << "Event " << i;
+    EXPECT_EQ(serial_events[i].event_ptr->SerializeAsString(),
+              parallel_events[i].event_ptr->SerializeAsString())
+        << "Event " << i;
+    if (parallel_events[i].event_ptr->has_mmap_event()) {
+      EXPECT_EQ(serial_events[i].num_samples_in_mmap_region,
+                parallel_events[i].num_samples_in_mmap_region)
+          << "Event " << i;
+    }
+  }
+
+  EXPECT_EQ("/usr/lib/foo.so", parallel_events[1].dso_and_offset.dso_name());
+  EXPECT_EQ("", parallel_events[2].dso_and_offset.dso_name());
+  EXPECT_EQ("/usr/lib/bar.so", parallel_events[4].dso_and_offset.dso_name());
+  EXPECT_EQ("", parallel_events[7].dso_and_offset.dso_name());
+  EXPECT_EQ("/usr/lib/bar.so", parallel_events[8].dso_and_offset.dso_name());
+  EXPECT_EQ("/usr/lib/qux.so", parallel_events[10].dso_and_offset.dso_name());
+  EXPECT_EQ("/usr/lib/baz.so", parallel_events[11].dso_and_offset.dso_name());
+}
+
+TEST(PerfParserTest, SharesIdenticalCallchains) {
+  std::stringstream input;
+
+  // header
+  testing::ExamplePipedPerfDataFileHeader().WriteTo(&input);
+
+  // PERF_RECORD_HEADER_ATTR
+  testing::ExamplePerfEventAttrEvent_Hardware(PERF_SAMPLE_IP |
+                                              PERF_SAMPLE_TID |
+                                              PERF_SAMPLE_CALLCHAIN,
+                                              true /*sample_id_all*/)
+      .WriteTo(&input);
+
+  const std::vector<u64> callchain =
+      {PERF_CONTEXT_USER, 0x1c1100, 0x1c1200, 0x1c1300};
+  testing::ExampleMmapEvent(
+      1001, 0x1c1000, 0x1000, 0, "/usr/lib/foo.so",
+      testing::SampleInfo().Tid(1001)).WriteTo(&input);           // 0
+  testing::ExamplePerfSampleEvent(                                // 1
+      testing::SampleInfo().Ip(0x1c1100).Tid(1001).Callchain(callchain))
+      .WriteTo(&input);
+  testing::ExamplePerfSampleEvent(                                // 2
+      testing::SampleInfo().Ip(0x1c1100).Tid(1001, 1002).Callchain(callchain))
+      .WriteTo(&input);
+  // The same addresses in another process are not mapped.
+  testing::ExamplePerfSampleEvent(                                // 3
+      testing::SampleInfo().Ip(0x1c1100).Tid(1003).Callchain(callchain))
+      .WriteTo(&input);
+  // New mappings apply to callchains that were mapped before.
+  testing::ExampleMmapEvent(
+      1001, 0x2c1000, 0x1000, 0, "/usr/lib/bar.so",
+      testing::SampleInfo().Tid(1001)).WriteTo(&input);           // 4
+  testing::ExamplePerfSampleEvent(                                // 5
+      testing::SampleInfo().Ip(0x1c1100).Tid(1001)
+          .Callchain({PERF_CONTEXT_USER, 0x1c1100, 0x1c1200, 0x2c1100}))
+      .WriteTo(&input);
+  testing::ExamplePerfSampleEvent(                                // 6
+      testing::SampleInfo().Ip(0x1c1100).Tid(1001).Callchain(callchain))
+      .WriteTo(&input);
+
+  PerfParserOptions options;
+  options.do_remap = true;
+  options.sample_mapping_percentage_threshold = 0;
+
+  PerfReader reader;
+  ASSERT_TRUE(reader.ReadFromString(input.str()));
+  PerfParser parser(&reader, options);
+  ASSERT_TRUE(parser.ParseRawEvents());
+  EXPECT_EQ(5, parser.stats().num_sample_events);
+  EXPECT_EQ(4, parser.stats().num_sample_events_mapped);
+
+  const std::vector<ParsedEvent>& events = parser.parsed_events();
+  ASSERT_EQ(7, events.size());
+
+  // Each entry other than the context and the sample IP is in the callchain.
+  ASSERT_EQ(2, events[1].callchain().size());
+  EXPECT_EQ("/usr/lib/foo.so", events[1].callchain()[0].dso_name());
+  EXPECT_EQ(0x200, events[1].callchain()[0].offset());
+  EXPECT_EQ("/usr/lib/foo.so", events[1].callchain()[1].dso_name());
+  EXPECT_EQ(0x300, events[1].callchain()[1].offset());
+  EXPECT_EQ(&events[1].callchain(), &events[2].callchain());
+  EXPECT_EQ(events[1].event_ptr->sample_event().callchain().size(),
+            events[2].event_ptr->sample_event().callchain().size());
+  EXPECT_TRUE(std::equal(
+      events[1].event_ptr->sample_event().callchain().begin(),
+      events[1].event_ptr->sample_event().callchain().end(),
+      events[2].event_ptr->sample_event().callchain().begin()));
+
+  ASSERT_EQ(2, events[3].callchain().size());
+  EXPECT_EQ("", events[3].callchain()[0].dso_name());
+  EXPECT_EQ("", events[3].callchain()[1].dso_name());
+
+  ASSERT_EQ(2, events[5].callchain().size());
+  EXPECT_EQ("/usr/lib/foo.so", events[5].callchain()[0].dso_name());
+  EXPECT_EQ("/usr/lib/bar.so", events[5].callchain()[1].dso_name());
+  EXPECT_EQ(0x100, events[5].callchain()[1].offset());
+  EXPECT_TRUE(events[1] == events[6]);
+
+  // Every sample counts towards the regions its callchain entries are in, even
+  // if the callchain was mapped only once.
+  EXPECT_EQ(11, events[0].num_samples_in_mmap_region);
+  EXPECT_EQ(1, events[4].num_samples_in_mmap_region);
+
+  // The same holds when mapping on multiple threads.
+  PerfReader parallel_reader;
+  ASSERT_TRUE(parallel_reader.ReadFromString(input.str()));
+  options.num_mapping_threads = 2;
+  PerfParser parallel_parser(&parallel_reader, options);
+  ASSERT_TRUE(parallel_parser.ParseRawEvents());
+  const std::vector<ParsedEvent>& parallel_events =
+      parallel_parser.parsed_events();
+  ASSERT_EQ(events.size(), parallel_events.size());
+  for (size_t i = 0; i < events.size(); ++i) {
+    EXPECT_TRUE(events[i] == parallel_events[i]) << "Event " << i;
+    EXPECT_EQ(events[i].event_ptr->SerializeAsString(),
+              parallel_events[i].event_ptr->SerializeAsString())
+        << "Event " << i;
+  }
+  EXPECT_EQ(11, parallel_events[0].num_samples_in_mmap_region);
+  EXPECT_EQ(1, parallel_events[4].num_samples_in_mmap_region);
+}
+
 TEST(PerfParserTest, HandlesFinishedRoundEventsAndSortsByTime) {
   // For now at least, we are ignoring PERF_RECORD_FINISHED_ROUND events.
 
@@ -1508,6 +1772,207 @@ TEST(PerfParserTest, HandlesFinishedRoundEventsAndSortsByTime) {
   EXPECT_EQ(12300050, events[4].event_ptr->sample_event().sample_time_ns());
 }
 
+namespace {
+
+// Stores copies of the events it receives from PerfParser::ParseFileStreaming.
+class ParsedEventCollector : public ParsedEventHandler {
+ public:
+  bool HandleParsedEvent(const ParsedEvent& parsed_event) override {
+    events_.Add()->CopyFrom(*parsed_event.event_ptr);
+    dso_and_offsets_.push_back(parsed_event.dso_and_offset);
+    return true;
+  }
+
+  const RepeatedPtrField<PerfEvent>& events() const { return events_; }
+  const std::vector<ParsedEvent::DSOAndOffset>& dso_and_offsets() const {
+    return dso_and_offsets_;
+  }
+
+ private:
+  RepeatedPtrField<PerfEvent> events_;
+  std::vector<ParsedEvent::DSOAndOffset> dso_and_offsets_;
+};
+
+}  // namespace
+
+TEST(PerfParserTest, ParseFileStreamingMatchesParseRawEvents) {
+  std::stringstream input;
+
+  // header
+  testing::ExamplePipedPerfDataFileHeader().WriteTo(&input);
+
+  // PERF_RECORD_HEADER_ATTR
+  testing::ExamplePerfEventAttrEvent_Hardware(PERF_SAMPLE_IP |
+                                              PERF_SAMPLE_TID |
+                                              PERF_SAMPLE_TIME,
+                                              true /*sample_id_all*/)
+      .WriteTo(&input);
+
+  // Each round may contain events older than the last event of the round
+  // before it, but not older than the last event of the round before that.
+  testing::ExampleMmapEvent(
+      1001, 0x1c1000, 0x1000, 0, "/usr/lib/foo.so",
+      testing::SampleInfo().Tid(1001).Time(10)).WriteTo(&input);
+  testing::ExamplePerfSampleEvent(
+      testing::SampleInfo().Ip(0x1c1100).Tid(1001).Time(20)).WriteTo(&input);
+  testing::ExamplePerfSampleEvent(
+      testing::SampleInfo().Ip(0x1c1200).Tid(1001).Time(30)).WriteTo(&input);
+  testing::FinishedRoundEvent().WriteTo(&input);
+
+  testing::ExamplePerfSampleEvent(
+      testing::SampleInfo().Ip(0x1c1300).Tid(1001).Time(25)).WriteTo(&input);
+  testing::ExampleMmapEvent(
+      1001, 0x2c1000, 0x1000, 0, "/usr/lib/bar.so",
+      testing::SampleInfo().Tid(1001).Time(35)).WriteTo(&input);
+  testing::ExamplePerfSampleEvent(
+      testing::SampleInfo().Ip(0x2c1100).Tid(1001).Time(50)).WriteTo(&input);
+  testing::ExamplePerfSampleEvent(
+      testing::SampleInfo().Ip(0x1c1400).Tid(1001).Time(40)).WriteTo(&input);
+  testing::FinishedRoundEvent().WriteTo(&input);
+
+  testing::ExamplePerfSampleEvent(
+      testing::SampleInfo().Ip(0x2c1200).Tid(1001).Time(45)).WriteTo(&input);
+  testing::ExamplePerfSampleEvent(
+      testing::SampleInfo().Ip(0x2c1300).Tid(1001).Time(60)).WriteTo(&input);
+
+  ScopedTempFile input_file;
+  ASSERT_FALSE(input_file.path().empty());
+  const string input_data = input.str();
+  ASSERT_TRUE(BufferToFile(input_file.path(), input_data));
+
+  PerfParserOptions options;
+  options.do_remap = true;
+  options.sort_events_by_time = true;
+
+  PerfReader batch_reader;
+  ASSERT_TRUE(batch_reader.ReadFile(input_file.path()));
+  PerfParser batch_parser(&batch_reader, options);
+  ASSERT_TRUE(batch_parser.ParseRawEvents());
+
+  PerfReader streaming_reader;
+  PerfParser streaming_parser(&streaming_reader, options);
+  ParsedEventCollector collector;
+  ASSERT_TRUE(streaming_parser.ParseFileStreaming(input_file.path(),
+                                                  &collector));
+
+  // The events are handed off rather than stored.
+  EXPECT_EQ(0, streaming_reader.events().size());
+  EXPECT_EQ(batch_reader.attrs().size(), streaming_reader.attrs().size());
+
+  const std::vector<ParsedEvent>& parsed_events =
+      batch_parser.parsed_events();
+  ASSERT_EQ(parsed_events.size(), collector.events().size());
+  uint64_t prev_time = 0;
+  for (size_t i = 0; i < parsed_events.size(); ++i) {
+    const PerfEvent& event = collector.events().Get(i);
+    EXPECT_EQ(parsed_events[i].event_ptr->SerializeAsString(),
+              event.SerializeAsString()) << "Event " << i;
+    EXPECT_TRUE(parsed_events[i].dso_and_offset ==
+                collector.dso_and_offsets()[i]) << "Event " << i;
+    EXPECT_LE(prev_time, GetTimeFromPerfEvent(event));
+    prev_time = GetTimeFromPerfEvent(event);
+  }
+
+  EXPECT_EQ(2, streaming_parser.stats().num_mmap_events);
+  EXPECT_EQ(7, streaming_parser.stats().num_sample_events);
+  EXPECT_EQ(7, streaming_parser.stats().num_sample_events_mapped);
+  EXPECT_TRUE(streaming_parser.stats().did_remap);
+}
+
+namespace {
+
+// Checks the callchains of the samples it receives from
+// PerfParser::ParseFileStreaming, and tracks how many callchains the parser
+// keeps while it does.
+class StreamedCallchainChecker : public ParsedEventHandler {
+ public:
+  explicit StreamedCallchainChecker(const PerfParser* parser)
+      : parser_(parser), num_samples_(0), max_stored_callchains_(0) {}
+
+  bool HandleParsedEvent(const ParsedEvent& parsed_event) override {
+    max_stored_callchains_ =
+        std::max(max_stored_callchains_, parser_->num_stored_callchains());
+    if (!parsed_event.event_ptr->has_sample_event())
+      return true;
+    ++num_samples_;
+    EXPECT_EQ(1, parsed_event.callchain().size());
+    if (parsed_event.callchain().size() == 1) {
+      EXPECT_EQ("/usr/lib/foo.so", parsed_event.callchain()[0].dso_name());
+      EXPECT_EQ(0x900, parsed_event.callchain()[0].offset());
+    }
+    return true;
+  }
+
+  int num_samples() const { return num_samples_; }
+  size_t max_stored_callchains() const { return max_stored_callchains_; }
+
+ private:
+  const PerfParser* parser_;
+  int num_samples_;
+  size_t max_stored_callchains_;
+};
+
+}  // namespace
+
+TEST(PerfParserTest, ParseFileStreamingBoundsStoredCallchains) {
+  std::stringstream input;
+
+  // header
+  testing::ExamplePipedPerfDataFileHeader().WriteTo(&input);
+
+  // PERF_RECORD_HEADER_ATTR
+  testing::ExamplePerfEventAttrEvent_Hardware(PERF_SAMPLE_IP |
+                                              PERF_SAMPLE_TID |
+                                              PERF_SAMPLE_TIME |
+                                              PERF_SAMPLE_CALLCHAIN,
+                                              true /*sample_id_all*/)
+      .WriteTo(&input);
+
+  testing::ExampleMmapEvent(
+      1001, 0x1c1000, 0x1000, 0, "/usr/lib/foo.so",
+      testing::SampleInfo().Tid(1001).Time(1)).WriteTo(&input);
+
+  // Every sample has a different IP, so every callchain is distinct.
+  const int kNumSamples = 1000;
+  for (int i = 0; i < kNumSamples; ++i) {
+    const u64 ip = 0x1c1000 + i % 0x800;
+    testing::ExamplePerfSampleEvent(
+        testing::SampleInfo().Ip(ip).Tid(1001).Time(10 + i)
+            .Callchain({PERF_CONTEXT_USER, ip, 0x1c1900}))
+        .WriteTo(&input);
+    if (i % 100 == 99)
+      testing::FinishedRoundEvent().WriteTo(&input);
+  }
+
+  ScopedTempFile input_file;
+  ASSERT_FALSE(input_file.path().empty());
+  ASSERT_TRUE(BufferToFile(input_file.path(), input.str()));
+
+  PerfParserOptions options;
+  options.do_remap = true;
+  options.sort_events_by_time = true;
+  options.max_streamed_callchains = 16;
+
+  PerfReader reader;
+  PerfParser parser(&reader, options);
+  StreamedCallchainChecker checker(&parser);
+  ASSERT_TRUE(parser.ParseFileStreaming(input_file.path(), &checker));
+
+  EXPECT_EQ(kNumSamples, checker.num_samples());
+  EXPECT_EQ(kNumSamples, parser.stats().num_sample_events_mapped);
+  EXPECT_EQ(16, checker.max_stored_callchains());
+  EXPECT_GE(16, parser.num_stored_callchains());
+}
+
+TEST(PerfParserTest, ParseFileStreamingRejectsDiscardUnusedEvents) {
+  PerfReader reader;
+  PerfParserOptions options;
+  options.discard_unused_events = true;
+  PerfParser parser(&reader, options);
+  ParsedEventCollector collector;
+  EXPECT_FALSE(parser.ParseFileStreaming("/dev/null", &collector));
+}
+
 TEST(PerfParserTest, MmapCoversEntireAddressSpace) {
   std::stringstream input;
 
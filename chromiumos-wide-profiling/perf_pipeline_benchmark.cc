@@ -0,0 +1,210 @@
+// Copyright 2016 The Chromium OS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// Measures the throughput of each stage of converting perf.data files to
+// protobufs and back: ReadFile, ParseRawEvents and Serialize, then Deserialize
+// and WriteFile. Runs over the perf.data files used by the tests and a large
+// synthetic profile, or over the files given on the command line.
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <vector>
+
+#include "base/logging.h"
+
+#include "chromiumos-wide-profiling/compat/log_level.h"
+#include "chromiumos-wide-profiling/compat/proto.h"
+#include "chromiumos-wide-profiling/compat/string.h"
+#include "chromiumos-wide-profiling/file_utils.h"
+#include "chromiumos-wide-profiling/kernel/perf_event.h"
+#include "chromiumos-wide-profiling/perf_parser.h"
+#include "chromiumos-wide-profiling/perf_reader.h"
+#include "chromiumos-wide-profiling/perf_test_files.h"
+#include "chromiumos-wide-profiling/scoped_temp_path.h"
+#include "chromiumos-wide-profiling/test_perf_data.h"
+#include "chromiumos-wide-profiling/test_utils.h"
+
+namespace {
+
+// Shape of the synthetic profile.
+const int kNumProcesses = 16;
+const int kNumCpus = 8;
+const int kNumSamples = 500000;
+const int kMaxCallchainDepth = 16;
+
+// Size of the one mapping of each process in the synthetic profile.
+const uint64_t kMappingSize = 0x100000;
+
+// Writes a piped-mode profile with |kNumSamples| callchain samples spread over
+// |kNumProcesses| to |filename|.
+bool WriteSyntheticProfile(const string& filename) {
+  std::stringstream input;
+  quipper::testing::ExamplePipedPerfDataFileHeader().WriteTo(&input);
+  quipper::testing::ExamplePerfEventAttrEvent_Hardware(
+      PERF_SAMPLE_IP | PERF_SAMPLE_TID | PERF_SAMPLE_TIME | PERF_SAMPLE_CPU |
+      PERF_SAMPLE_CALLCHAIN,
+      true /*sample_id_all*/).WriteTo(&input);
+
+  for (int process = 0; process < kNumProcesses; ++process) {
+    const uint32_t pid = 1000 + process;
+    quipper::testing::ExampleMmapEvent(
+        pid, 0x400000 + process * kMappingSize, kMappingSize, 0,
+        "/usr/lib/libsynthetic.so",
+        quipper::testing::SampleInfo().Tid(pid).Time(0).Cpu(0))
+        .WriteTo(&input);
+  }
+
+  std::mt19937_64 rng(0);
+  std::uniform_int_distribution<uint64_t> offset(0, kMappingSize - 1);
+  std::uniform_int_distribution<int> depth(1, kMaxCallchainDepth);
+  for (int i = 0; i < kNumSamples; ++i) {
+    const int process = i % kNumProcesses;
+    const uint64_t start = 0x400000 + process * kMappingSize;
+    std::vector<uint64_t> callchain = {PERF_CONTEXT_USER};
+    for (int j = depth(rng); j > 0; --j)
+      callchain.push_back(start + offset(rng));
+    quipper::testing::ExamplePerfSampleEvent(
+        quipper::testing::SampleInfo().Ip(callchain[1])
+            .Tid(1000 + process).Time(i + 1).Cpu(i % kNumCpus)
+            .Callchain(callchain)).WriteTo(&input);
+  }
+
+  std::ofstream file(filename, std::ios::binary);
+  file << input.rdbuf();
+  return file.good();
+}
+
+// Resets the peak resident set size of the process, so that the next call to
+// GetPeakRssKb() returns the peak since this call. Not all kernels support
+// this, in which case the peak since the start of the process is reported.
+void ResetPeakRss() {
+  std::ofstream clear_refs("/proc/self/clear_refs");
+  clear_refs << "5";
+}
+
+// Returns the peak resident set size of the process, in KB.
+int64_t GetPeakRssKb() {
+  std::ifstream status("/proc/self/status");
+  string line;
+  while (std::getline(status, line)) {
+    std::istringstream fields(line);
+    string name;
+    int64_t value;
+    if (fields >> name >> value && name == "VmHWM:")
+      return value;
+  }
+  return 0;
+}
+
+// Measures one stage of the pipeline. Construct it right before the stage
+// starts, and call Print() once it is done.
+class Stage {
+ public:
+  Stage() {
+    ResetPeakRss();
+    start_time_ = std::chrono::steady_clock::now();
+  }
+
+  // Prints the throughput of the stage over |num_events| events and |bytes|
+  // bytes of input or output.
+  void Print(const string& filename, const char* name, size_t num_events,
+             size_t bytes) const {
+    double time = std::chrono::duration<double>(
+        std::chrono::steady_clock::now() - start_time_).count();
+    std::cout << std::left << std::setw(40) << filename << std::setw(12)
+              << name << std::right << std::setw(10) << std::fixed
+              << std::setprecision(1) << time * 1e3
+              << std::setw(14) << std::setprecision(0) << num_events / time
+              << std::setw(12) << std::setprecision(1)
+              << bytes / time / (1 << 20)
+              << std::setw(14) << GetPeakRssKb() / 1024.0 << std::endl;
+  }
+
+ private:
+  std::chrono::steady_clock::time_point start_time_;
+};
+
+// Runs |filename| through the whole pipeline, printing the results of each
+// stage. The converted perf data is written to |output_filename|.
+bool RunPipeline(const string& filename, const string& output_filename) {
+  int64_t input_size = quipper::GetFileSize(filename);
+
+  quipper::PerfReader reader;
+  Stage read;
+  if (!reader.ReadFile(filename))
+    return false;
+  read.Print(filename, "read", reader.events().size(), input_size);
+
+  quipper::PerfParserOptions options;
+  options.do_remap = true;
+  options.sample_mapping_percentage_threshold = 0;
+  quipper::PerfParser parser(&reader, options);
+  Stage parse;
+  if (!parser.ParseRawEvents())
+    return false;
+  parse.Print(filename, "parse", reader.events().size(), input_size);
+
+  string serialized;
+  Stage serialize;
+  {
+    quipper::PerfDataProto proto;
+    if (!reader.Serialize(&proto) || !proto.SerializeToString(&serialized))
+      return false;
+  }
+  serialize.Print(filename, "serialize", reader.events().size(),
+                  serialized.size());
+
+  quipper::PerfReader output_reader;
+  Stage deserialize;
+  {
+    quipper::PerfDataProto proto;
+    if (!proto.ParseFromString(serialized) ||
+        !output_reader.Deserialize(proto)) {
+      return false;
+    }
+  }
+  deserialize.Print(filename, "deserialize", output_reader.events().size(),
+                    serialized.size());
+
+  Stage write;
+  if (!output_reader.WriteFile(output_filename))
+    return false;
+  write.Print(filename, "write", output_reader.events().size(),
+              quipper::GetFileSize(output_filename));
+  return true;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  // Keep the parser's per-file stats out of the results.
+  quipper::SetVerbosityLevel(-1);
+
+  quipper::ScopedTempFile synthetic_file;
+  std::vector<string> filenames(argv + 1, argv + argc);
+  if (filenames.empty()) {
+    for (const char* test_file : perf_test_files::GetPerfDataFiles())
+      filenames.push_back(quipper::GetTestInputFilePath(test_file));
+    CHECK(WriteSyntheticProfile(synthetic_file.path()));
+    filenames.push_back(synthetic_file.path());
+  }
+
+  std::cout << std::left << std::setw(40) << "file" << std::setw(12)
+            << "stage" << std::right << std::setw(10) << "ms"
+            << std::setw(14) << "events/s" << std::setw(12) << "MB/s"
+            << std::setw(14) << "peak RSS MB" << std::endl;
+  quipper::ScopedTempFile output_file;
+  for (const string& filename : filenames) {
+    if (!RunPipeline(filename, output_file.path()))
+      LOG(ERROR) << "Unable to convert " << filename;
+  }
+  return EXIT_SUCCESS;
+}
@@ -10,6 +10,11 @@
 #include <sys/time.h>
 
 #include <algorithm>
+#include <functional>
+#include <map>
+#include <queue>
+#include <tuple>
+#include <utility>
 #include <vector>
 
 #include "base/logging.h"
@@ -18,9 +23,11 @@
 #include "chromiumos-wide-profiling/binary_data_utils.h"
 #include "chromiumos-wide-profiling/buffer_reader.h"
 #include "chromiumos-wide-profiling/buffer_writer.h"
+#include "chromiumos-wide-profiling/compact_samples.h"
 #include "chromiumos-wide-profiling/compat/string.h"
 #include "chromiumos-wide-profiling/file_reader.h"
 #include "chromiumos-wide-profiling/file_utils.h"
+#include "chromiumos-wide-profiling/mapped_file_reader.h"
 #include "chromiumos-wide-profiling/perf_data_structures.h"
 #include "chromiumos-wide-profiling/perf_data_utils.h"
 #include "chromiumos-wide-profiling/sample_info_reader.h"
@@ -180,15 +187,105 @@ bool ReadPerfFileSection(DataReader* data, struct perf_file_section* section) {
   return true;
 }
 
-// Returns true if |e1| has an earlier timestamp than |e2|. Used to sort an
-// array of events.
-bool CompareEventTimes(const PerfEvent& e1, const PerfEvent& e2) {
-  return GetTimeFromPerfEvent(e1) < GetTimeFromPerfEvent(e2);
+// Returns the CPU and stream ID that |event| was recorded with. Missing fields
+// are returned as zero. The kernel writes the events of each CPU and stream to
+// the same buffer, so perf reads each such stream in time order.
+std::pair<uint32_t, uint64_t> GetEventStreamKey(const PerfEvent& event) {
+  if (event.header().type() == PERF_RECORD_SAMPLE) {
+    return std::make_pair(event.sample_event().cpu(),
+                          event.sample_event().stream_id());
+  }
+  const SampleInfo* sample_info = GetSampleInfoForEvent(event);
+  if (sample_info)
+    return std::make_pair(sample_info->cpu(), sample_info->stream_id());
+  return std::pair<uint32_t, uint64_t>(0, 0);
+}
+
+// Orders event indices by the times in |times|. Used to sort the events.
+class EventTimeIsEarlier {
+ public:
+  explicit EventTimeIsEarlier(const std::vector<uint64_t>& times)
+      : times_(times) {}
+
+  bool operator()(int i, int j) const {
+    return times_[i] < times_[j];
+  }
+
+ private:
+  const std::vector<uint64_t>& times_;
+};
+
+// Stores in |*order| the indices of |events| in order of |times|, keeping
+// events with equal times in their original order, by merging the streams
+// returned by GetEventStreamKey(). Returns false without changing |*order| if
+// the events of some stream are not in time order.
+bool MergeEventStreamsByTime(const RepeatedPtrField<PerfEvent>& events,
+                             const std::vector<uint64_t>& times,
+                             std::vector<int>* order) {
+  // Events without a timestamp, such as those recorded without sample_id_all,
+  // belong to no stream. They sort before all others, so they are kept apart
+  // and come first.
+  std::vector<int> timeless;
+
+  // Split the events into streams, making sure that each is sorted. perf reads
+  // whole blocks of events from each buffer, so the stream of the previous
+  // event is checked before looking up the key.
+  std::map<std::pair<uint32_t, uint64_t>, size_t> stream_numbers;
+  std::vector<std::vector<int>> streams;
+  std::pair<uint32_t, uint64_t> last_key;
+  size_t last_stream_number = 0;
+  for (int i = 0; i < events.size(); ++i) {
+    if (times[i] == 0) {
+      timeless.push_back(i);
+      continue;
+    }
+    const std::pair<uint32_t, uint64_t> key = GetEventStreamKey(events.Get(i));
+    if (streams.empty() || key != last_key) {
+      auto inserted =
+          stream_numbers.insert(std::make_pair(key, streams.size()));
+      if (inserted.second)
+        streams.emplace_back();
+      last_key = key;
+      last_stream_number = inserted.first->second;
+    }
+    std::vector<int>& stream = streams[last_stream_number];
+    if (!stream.empty() && times[stream.back()] > times[i])
+      return false;
+    stream.push_back(i);
+  }
+
+  // Merge the streams. Ties are broken by event index, which reproduces the
+  // order of a stable sort. Entries are (time, event index, stream number).
+  typedef std::tuple<uint64_t, int, size_t> HeapEntry;
+  std::priority_queue<HeapEntry, std::vector<HeapEntry>,
+                      std::greater<HeapEntry>> heads;
+  std::vector<size_t> next_in_stream(streams.size(), 1);
+  for (size_t i = 0; i < streams.size(); ++i)
+    heads.push(HeapEntry(times[streams[i][0]], streams[i][0], i));
+
+  order->assign(timeless.begin(), timeless.end());
+  order->reserve(events.size());
+  while (!heads.empty()) {
+    size_t stream_number = std::get<2>(heads.top());
+    order->push_back(std::get<1>(heads.top()));
+    heads.pop();
+
+    const std::vector<int>& stream = streams[stream_number];
+    size_t& next = next_in_stream[stream_number];
+    if (next < stream.size()) {
+      heads.push(HeapEntry(times[stream[next]], stream[next], stream_number));
+      ++next;
+    }
+  }
+  return true;
 }
 
 }  // namespace
 
-PerfReader::PerfReader() : is_cross_endian_(false) {
+PerfReader::PerfReader() : is_cross_endian_(false),
+                           event_handler_(nullptr),
+                           serialize_compact_samples_(false),
+                           last_sort_method_(kNotSorted) {
   // The metadata mask is stored in |proto_|. It should be initialized to 0
   // since it is used heavily.
   proto_.add_metadata_mask(0);
@@ -198,6 +295,8 @@ PerfReader::~PerfReader() {}
 
 bool PerfReader::Serialize(PerfDataProto* perf_data_proto) const {
   perf_data_proto->CopyFrom(proto_);
+  if (serialize_compact_samples_)
+    CompactSampleEvents(perf_data_proto);
 
   // Add a timestamp_sec to the protobuf.
   struct timeval timestamp_sec;
@@ -208,6 +307,8 @@ bool PerfReader::Serialize(PerfDataProto* perf_data_proto) const {
 
 bool PerfReader::Deserialize(const PerfDataProto& perf_data_proto) {
   proto_.CopyFrom(perf_data_proto);
+  if (!ExpandSampleEvents(&proto_))
+    return false;
 
   // Iterate through all attrs and create a SampleInfoReader for each of them.
   // This is necessary for writing the proto representation of perf data to raw
@@ -221,6 +322,12 @@ bool PerfReader::Deserialize(const PerfDataProto& perf_data_proto) {
 }
 
 bool PerfReader::ReadFile(const string& filename) {
+  // Prefer to map the file into memory, so that events can be read in place
+  // instead of being copied out of the file one at a time.
+  MappedFileReader mapped_reader(filename);
+  if (mapped_reader.IsMapped())
+    return ReadFromData(&mapped_reader);
+
   FileReader reader(filename);
   if (!reader.IsOpen()) {
     LOG(ERROR) << "Unable to open file " << filename;
@@ -543,18 +650,46 @@ void PerfReader::GetFilenamesToBuildIDs(
 }
 
 void PerfReader::MaybeSortEventsByTime() {
+  last_sort_method_ = kNotSorted;
+  if (!CanSortEventsByTime())
+    return;
+
+  const RepeatedPtrField<PerfEvent>& events = proto_.events();
+  std::vector<uint64_t> times(events.size());
+  for (int i = 0; i < events.size(); ++i)
+    times[i] = GetTimeFromPerfEvent(events.Get(i));
+
+  // Events are usually only out of order across CPUs, so merging the sorted
+  // per-CPU streams is enough. Otherwise, sort all of them.
+  std::vector<int> order;
+  if (MergeEventStreamsByTime(events, times, &order)) {
+    last_sort_method_ = kMergedStreams;
+  } else {
+    order.resize(events.size());
+    for (size_t i = 0; i < order.size(); ++i)
+      order[i] = i;
+    std::stable_sort(order.begin(), order.end(), EventTimeIsEarlier(times));
+    last_sort_method_ = kStableSorted;
+  }
+
+  // Rearrange the events by moving their pointers rather than their contents.
+  std::vector<PerfEvent*> unsorted_events(
+      proto_.mutable_events()->pointer_begin(),
+      proto_.mutable_events()->pointer_end());
+  auto sorted_event = proto_.mutable_events()->pointer_begin();
+  for (int index : order)
+    *sorted_event++ = unsorted_events[index];
+}
+
+bool PerfReader::CanSortEventsByTime() const {
   // Events can not be sorted by time if PERF_SAMPLE_TIME is not set in
   // attr.sample_type for all attrs.
   for (const auto& attr : attrs()) {
     if (!(attr.attr().sample_type() & PERF_SAMPLE_TIME)) {
-      return;
+      return false;
     }
   }
-
-  // Sort the events based on timestamp.
-  std::stable_sort(proto_.mutable_events()->begin(),
-                   proto_.mutable_events()->end(),
-                   CompareEventTimes);
+  return true;
 }
 
 bool PerfReader::ReadHeader(DataReader* data) {
@@ -824,24 +959,18 @@ bool PerfReader::ReadDataSection(DataReader* data) {
     }
 
     // Read the rest of the event data.
-    malloced_unique_ptr<event_t> event(CallocMemoryForEvent(header.size));
-    event->header = header;
-    if (!data->ReadDataValue(event->header.size - sizeof(event->header),
-                             "rest of event", &event->header + 1)) {
+    malloced_unique_ptr<event_t> event_copy;
+    const event_t* event = ReadEventAfterHeader(data, header, &event_copy);
+    if (!event)
       return false;
-    }
-    // TODO(sque): Find some way to combine this with the serialization below.
-    MaybeSwapEventFields(event.get(), data->is_cross_endian());
 
     // We must have a valid way to read sample info before reading perf events.
     CHECK(serializer_.SampleInfoReaderAvailable());
 
-    // Serialize the event to protobuf form.
-    PerfEvent* proto_event = proto_.add_events();
-    if (!serializer_.SerializeEvent(event, proto_event))
+    if (!StoreEvent(*event))
       return false;
 
-    data_remaining_bytes -= event->header.size;
+    data_remaining_bytes -= header.size;
   }
 
   DLOG(INFO) << "Number of events stored: "<< proto_.events_size();
@@ -1246,24 +1375,17 @@ bool PerfReader::ReadPipedData(DataReader* data) {
     // Compute the size of the post-header part of the event data.
     size_t size_without_header = header.size - sizeof(header);
 
-    if (header.type < PERF_RECORD_MAX) {
-      // Allocate space for an event struct based on the size in the header.
-      // Don't blindly allocate the entire event_t because it is a
-      // variable-sized type that may include data beyond what's nominally
-      // declared in its definition.
-      malloced_unique_ptr<event_t> event(CallocMemoryForEvent(header.size));
-      event->header = header;
-
+    // An event handler may use the round boundaries to bound how many events
+    // it buffers, so pass those along as well.
+    if (header.type < PERF_RECORD_MAX ||
+        (event_handler_ && header.type == PERF_RECORD_FINISHED_ROUND)) {
       // Read the rest of the event data.
-      if (!data->ReadDataValue(size_without_header, "rest of piped event",
-                               &event->header + 1)) {
+      malloced_unique_ptr<event_t> event_copy;
+      const event_t* event = ReadEventAfterHeader(data, header, &event_copy);
+      if (!event)
         break;
-      }
-      MaybeSwapEventFields(event.get(), data->is_cross_endian());
 
-      // Serialize the event to protobuf form.
-      PerfEvent* proto_event = proto_.add_events();
-      if (!serializer_.SerializeEvent(event, proto_event))
+      if (!StoreEvent(*event))
         return false;
 
       continue;
@@ -1754,6 +1876,55 @@ bool PerfReader::ReadAttrEventBlock(DataReader* data, size_t size) {
   return true;
 }
 
+bool PerfReader::StoreEvent(const event_t& event) {
+  if (!event_handler_)
+    return serializer_.SerializeEvent(event, proto_.add_events());
+
+  streamed_event_.Clear();
+  if (!serializer_.SerializeEvent(event, &streamed_event_))
+    return false;
+  return event_handler_->HandleEvent(&streamed_event_);
+}
+
+const event_t* PerfReader::ReadEventAfterHeader(
+    DataReader* data,
+    const perf_event_header& header,
+    malloced_unique_ptr<event_t>* event_copy) {
+  if (header.size < sizeof(header)) {
+    LOG(ERROR) << "Event size " << header.size << " is smaller than the event "
+               << "header. Type: " << header.type;
+    return nullptr;
+  }
+  const size_t size_without_header = header.size - sizeof(header);
+
+  // The header was read from just before the current read offset, so the whole
+  // event is available in place if |data| is memory-backed. Make sure the event
+  // is suitably aligned before accessing its fields directly.
+  if (!data->is_cross_endian()) {
+    const void* event_data =
+        data->GetDataInPlace(data->Tell() - sizeof(header), header.size);
+    if (event_data &&
+        reinterpret_cast<uintptr_t>(event_data) % alignof(event_t) == 0) {
+      data->SeekSet(data->Tell() + size_without_header);
+      return reinterpret_cast<const event_t*>(event_data);
+    }
+  }
+
+  // Allocate space for an event struct based on the size in the header.
+  // Don't blindly allocate the entire event_t because it is a variable-sized
+  // type that may include data beyond what's nominally declared in its
+  // definition.
+  event_copy->reset(CallocMemoryForEvent(header.size));
+  event_t* event = event_copy->get();
+  event->header = header;
+  if (!data->ReadDataValue(size_without_header, "rest of event",
+                           &event->header + 1)) {
+    return nullptr;
+  }
+  MaybeSwapEventFields(event, data->is_cross_endian());
+  return event;
+}
+
 void PerfReader::MaybeSwapEventFields(event_t* event, bool is_cross_endian) {
   if (!is_cross_endian)
     return;
@@ -33,6 +33,20 @@ class DataWriter;
 
 struct PerfFileAttr;
 
+// Receives the events of a perf data file one at a time as PerfReader reads
+// them, instead of having PerfReader store all of them. See
+// PerfReader::set_event_handler().
+class PerfEventHandler {
+ public:
+  virtual ~PerfEventHandler() {}
+
+  // Called for each event in the order in which it appears in the input.
+  // |event| is owned by the reader and is reused for the next event, so the
+  // handler must copy or Swap() out anything it wants to keep. Returning false
+  // aborts the read.
+  virtual bool HandleEvent(PerfDataProto_PerfEvent* event) = 0;
+};
+
 class PerfReader {
  public:
   PerfReader();
@@ -41,9 +55,16 @@ class PerfReader {
   // Copy stored contents to |*perf_data_proto|. Appends a timestamp. Returns
   // true on success.
   bool Serialize(PerfDataProto* perf_data_proto) const;
-  // Read in contents from a protobuf. Returns true on success.
+  // Read in contents from a protobuf. Accepts protobufs with compact sample
+  // events. Returns true on success.
   bool Deserialize(const PerfDataProto& perf_data_proto);
 
+  // While set, Serialize() stores sample events in the smaller column-oriented
+  // PerfDataProto::compact_samples. See compact_samples.h.
+  void set_serialize_compact_samples(bool compact) {
+    serialize_compact_samples_ = compact;
+  }
+
   bool ReadFile(const string& filename);
   bool ReadFromVector(const std::vector<char>& data);
   bool ReadFromString(const string& str);
@@ -83,10 +104,36 @@ class PerfReader {
   void GetFilenamesToBuildIDs(
       std::map<string, string>* filenames_to_build_ids) const;
 
+  // How MaybeSortEventsByTime() last ordered the events.
+  enum SortMethod {
+    // The events were not sorted, because some have no timestamp.
+    kNotSorted,
+    // The events of each CPU and stream were already in order and were merged.
+    kMergedStreams,
+    // Some stream was out of order, so all events were stable sorted.
+    kStableSorted,
+  };
+
   // Sort all events in |proto_| by timestamps if they are available. Otherwise
   // event order is unchanged.
   void MaybeSortEventsByTime();
 
+  // Returns how the last call to MaybeSortEventsByTime() ordered the events.
+  SortMethod last_sort_method() const { return last_sort_method_; }
+
+  // Returns true if all attrs read so far have PERF_SAMPLE_TIME set, i.e. if
+  // every event carries a timestamp that it can be sorted by.
+  bool CanSortEventsByTime() const;
+
+  // While |handler| is set, the Read*() functions pass each perf event to it
+  // as soon as it has been read, rather than storing it in events(). Attrs,
+  // event types and metadata are still stored. In piped mode, the handler also
+  // receives the PERF_RECORD_FINISHED_ROUND events that are otherwise dropped.
+  // Pass nullptr to go back to storing events. Does not take ownership.
+  void set_event_handler(PerfEventHandler* handler) {
+    event_handler_ = handler;
+  }
+
   // Accessors and mutators.
 
   // This is a plain accessor for the internal protobuf storage. It is meant for
@@ -224,6 +271,19 @@ class PerfReader {
   // For reading event blocks within piped perf data.
   bool ReadAttrEventBlock(DataReader* data, size_t size);
 
+  // Reads the rest of the event whose header, |header|, was just read from
+  // |data|. If |data| is memory-backed and the event does not need to be
+  // byte-swapped, returns a pointer to the event inside |data| without copying
+  // it. Otherwise, copies the event into |*event_copy|, swaps its byte order if
+  // necessary, and returns |event_copy->get()|. Returns nullptr on failure.
+  const event_t* ReadEventAfterHeader(DataReader* data,
+                                      const perf_event_header& header,
+                                      malloced_unique_ptr<event_t>* event_copy);
+
+  // Serializes |event| and either stores it in |proto_| or passes it to
+  // |event_handler_|. Returns false if either step fails.
+  bool StoreEvent(const event_t& event);
+
   // Swaps byte order for non-header fields of the data structure pointed to by
   // |event|, if |is_cross_endian| is true. Otherwise leaves the data the same.
   void MaybeSwapEventFields(event_t* event, bool is_cross_endian);
@@ -276,6 +336,19 @@ class PerfReader {
   // For serializing individual events.
   PerfSerializer serializer_;
 
+  // If set, receives events instead of |proto_|. See set_event_handler().
+  PerfEventHandler* event_handler_;
+
+  // Reused to hold each event passed to |event_handler_|, so that its
+  // submessages are only allocated once.
+  PerfDataProto_PerfEvent streamed_event_;
+
+  // Whether Serialize() compacts sample events.
+  bool serialize_compact_samples_;
+
+  // See last_sort_method().
+  SortMethod last_sort_method_;
+
   // When writing to a new perf data file, this is used to hold the generated
   // file header, which may differ from the input file header, if any.
   struct perf_file_header out_header_;
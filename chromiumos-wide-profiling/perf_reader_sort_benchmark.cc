@@ -0,0 +1,144 @@
+// Copyright 2016 The Chromium OS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// Compares PerfReader::MaybeSortEventsByTime() against a plain stable sort of
+// the events on synthetic multi-CPU profiles, where the events of each CPU are
+// in order but interleaved with those of the other CPUs in blocks. Some
+// profiles are recorded without sample_id_all and have an mmap without a
+// timestamp in every block, as in files that perf writes for older kernels.
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+
+#include "base/logging.h"
+
+#include "chromiumos-wide-profiling/compat/string.h"
+#include "chromiumos-wide-profiling/kernel/perf_event.h"
+#include "chromiumos-wide-profiling/perf_data_utils.h"
+#include "chromiumos-wide-profiling/perf_reader.h"
+#include "chromiumos-wide-profiling/test_perf_data.h"
+
+namespace {
+
+using quipper::PerfDataProto_PerfEvent;
+
+// Number of events that perf reads from one CPU's buffer at a time.
+const int kEventsPerBlock = 256;
+
+// Profile sizes to benchmark.
+const struct {
+  int num_cpus;
+  int num_events;
+  bool timeless_mmaps;
+} kProfiles[] = {
+  {4, 100000, false},
+  {4, 100000, true},
+  {16, 100000, false},
+  {16, 1000000, false},
+  {16, 1000000, true},
+  {64, 1000000, false},
+};
+
+double SecondsSince(std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration<double>(
+      std::chrono::steady_clock::now() - start).count();
+}
+
+// Returns piped perf data with |num_events| samples spread over |num_cpus|.
+// If |timeless_mmaps| is set, each block of samples is preceded by an mmap
+// without a timestamp.
+string GenerateProfile(int num_cpus, int num_events, bool timeless_mmaps) {
+  std::stringstream input;
+  quipper::testing::ExamplePipedPerfDataFileHeader().WriteTo(&input);
+  quipper::testing::ExamplePerfEventAttrEvent_Hardware(
+      PERF_SAMPLE_IP | PERF_SAMPLE_TID | PERF_SAMPLE_TIME | PERF_SAMPLE_CPU,
+      !timeless_mmaps /*sample_id_all*/).WriteTo(&input);
+
+  // Every CPU samples at the same rate but with a different phase, so that
+  // each block overlaps in time with the blocks of all other CPUs.
+  for (int block_start = 0; block_start < num_events;
+       block_start += kEventsPerBlock * num_cpus) {
+    for (int cpu = 0; cpu < num_cpus; ++cpu) {
+      if (timeless_mmaps) {
+        quipper::testing::ExampleMmapEvent(
+            1001, 0x1000, 0x1000, 0, "/usr/lib/foo.so",
+            quipper::testing::SampleInfo()).WriteTo(&input);
+      }
+      for (int i = 0; i < kEventsPerBlock; ++i) {
+        uint64_t time = (block_start + i * num_cpus) * 10 + cpu;
+        quipper::testing::ExamplePerfSampleEvent(
+            quipper::testing::SampleInfo()
+                .Ip(0x1000 + i).Tid(1001).Time(time).Cpu(cpu))
+            .WriteTo(&input);
+      }
+    }
+  }
+  return input.str();
+}
+
+bool CompareEventTimes(const PerfDataProto_PerfEvent& e1,
+                       const PerfDataProto_PerfEvent& e2) {
+  return quipper::GetTimeFromPerfEvent(e1) < quipper::GetTimeFromPerfEvent(e2);
+}
+
+// Returns the time taken to sort the events of |profile|, with either
+// MaybeSortEventsByTime() or a stable sort of the event messages. Stores how
+// MaybeSortEventsByTime() sorted them in |*method|.
+double TimeSort(const string& profile, bool use_stable_sort,
+                const char** method) {
+  quipper::PerfReader reader;
+  CHECK(reader.ReadFromString(profile));
+  auto start_time = std::chrono::steady_clock::now();
+  if (use_stable_sort) {
+    std::stable_sort(reader.mutable_events()->begin(),
+                     reader.mutable_events()->end(),
+                     CompareEventTimes);
+  } else {
+    reader.MaybeSortEventsByTime();
+  }
+  double seconds = SecondsSince(start_time);
+  switch (reader.last_sort_method()) {
+    case quipper::PerfReader::kNotSorted:
+      *method = "none";
+      break;
+    case quipper::PerfReader::kMergedStreams:
+      *method = "merge";
+      break;
+    case quipper::PerfReader::kStableSorted:
+      *method = "stable_sort";
+      break;
+  }
+  return seconds;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  std::cout << std::setw(6) << "cpus" << std::setw(10) << "events"
+            << std::setw(10) << "timeless" << std::setw(16) << "stable_sort ms"
+            << std::setw(10) << "new ms" << std::setw(14) << "new method"
+            << std::endl;
+  for (const auto& profile_params : kProfiles) {
+    string profile = GenerateProfile(profile_params.num_cpus,
+                                     profile_params.num_events,
+                                     profile_params.timeless_mmaps);
+    const char* method = nullptr;
+    double stable_sort_time = TimeSort(profile, true, &method);
+    double new_time = TimeSort(profile, false, &method);
+    std::cout << std::setw(6) << profile_params.num_cpus
+              << std::setw(10) << profile_params.num_events
+              << std::setw(10) << (profile_params.timeless_mmaps ? "yes" : "no")
+              << std::setw(16) << std::fixed << std::setprecision(1)
+              << stable_sort_time * 1e3
+              << std::setw(10) << new_time * 1e3
+              << std::setw(14) << method << std::endl;
+  }
+  return EXIT_SUCCESS;
+}
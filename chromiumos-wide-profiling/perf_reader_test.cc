@@ -857,9 +857,14 @@ TEST(PerfReaderTest, ReadsAndWritesMmap2Events) {
   ASSERT_TRUE(pr1.WriteToVector(&output_perf_data));
   PerfReader pr2;
   ASSERT_TRUE(pr2.ReadFromVector(output_perf_data));
-
-  // Test both versions:
-  for (PerfReader* pr : {&pr1, &pr2}) {
+  // Also read it in from a file, which maps the file into memory.
+  ScopedTempFile output_file;
+  ASSERT_TRUE(BufferToFile(output_file.path(), output_perf_data));
+  PerfReader pr3;
+  ASSERT_TRUE(pr3.ReadFile(output_file.path()));
+
+  // Test all versions:
+  for (PerfReader* pr : {&pr1, &pr2, &pr3}) {
     // PERF_RECORD_HEADER_ATTR is added to attr(), not events().
     EXPECT_EQ(1, pr->events().size());
 
@@ -1695,4 +1700,120 @@ TEST(PerfReaderTest, MetadataMaskInitialized) {
   EXPECT_EQ(0U, reader.metadata_mask());
 }
 
+namespace {
+
+// Writes a piped perf data header and an attr whose samples have a time and a
+// CPU.
+void WritePipedHeaderWithCpuAttr(std::stringstream* input) {
+  testing::ExamplePipedPerfDataFileHeader().WriteTo(input);
+  testing::ExamplePerfEventAttrEvent_Hardware(
+      PERF_SAMPLE_IP | PERF_SAMPLE_TID | PERF_SAMPLE_TIME | PERF_SAMPLE_CPU,
+      true /*sample_id_all*/).WriteTo(input);
+}
+
+// Writes a sample event with the given IP, time and CPU.
+void WriteSample(u64 ip, u64 time, u32 cpu, std::stringstream* input) {
+  testing::ExamplePerfSampleEvent(
+      testing::SampleInfo().Ip(ip).Tid(1001).Time(time).Cpu(cpu))
+      .WriteTo(input);
+}
+
+// Returns the IPs of the sample events in |reader|.
+std::vector<uint64_t> GetSampleIps(const PerfReader& reader) {
+  std::vector<uint64_t> ips;
+  for (const PerfEvent& event : reader.events()) {
+    if (event.has_sample_event())
+      ips.push_back(event.sample_event().ip());
+  }
+  return ips;
+}
+
+}  // namespace
+
+TEST(PerfReaderTest, SortsPerCpuStreamsByTime) {
+  std::stringstream input;
+  WritePipedHeaderWithCpuAttr(&input);
+
+  // Each CPU's events are in order, but they are interleaved in blocks, as
+  // perf reads them from the per-CPU buffers.
+  testing::ExampleMmapEvent(
+      1001, 0x1c1000, 0x1000, 0, "/usr/lib/foo.so",
+      testing::SampleInfo().Tid(1001).Time(5).Cpu(0)).WriteTo(&input);
+  WriteSample(0x1, 10, 0, &input);
+  WriteSample(0x2, 30, 0, &input);
+  WriteSample(0x3, 30, 0, &input);
+  WriteSample(0x4, 20, 1, &input);
+  WriteSample(0x5, 30, 1, &input);
+  WriteSample(0x6, 15, 2, &input);
+  WriteSample(0x7, 40, 2, &input);
+  WriteSample(0x8, 60, 0, &input);
+  WriteSample(0x9, 50, 1, &input);
+
+  PerfReader reader;
+  ASSERT_TRUE(reader.ReadFromString(input.str()));
+  reader.MaybeSortEventsByTime();
+
+  EXPECT_EQ(PerfReader::kMergedStreams, reader.last_sort_method());
+  ASSERT_EQ(10, reader.events().size());
+  EXPECT_TRUE(reader.events().Get(0).has_mmap_event());
+  // Events with equal times stay in their original order.
+  const std::vector<uint64_t> expected_ips =
+      {0x1, 0x6, 0x4, 0x2, 0x3, 0x5, 0x7, 0x9, 0x8};
+  EXPECT_EQ(expected_ips, GetSampleIps(reader));
+}
+
+TEST(PerfReaderTest, MergesPerCpuStreamsAroundTimelessEvents) {
+  std::stringstream input;
+  testing::ExamplePipedPerfDataFileHeader().WriteTo(&input);
+  testing::ExamplePerfEventAttrEvent_Hardware(
+      PERF_SAMPLE_IP | PERF_SAMPLE_TID | PERF_SAMPLE_TIME | PERF_SAMPLE_CPU,
+      false /*sample_id_all*/).WriteTo(&input);
+
+  // Without sample_id_all, the mmaps have no time or CPU. They are written
+  // between CPU 0's samples, but should not stop the streams from being
+  // merged.
+  WriteSample(0x1, 10, 0, &input);
+  testing::ExampleMmapEvent(
+      1001, 0x1c1000, 0x1000, 0, "/usr/lib/foo.so",
+      testing::SampleInfo()).WriteTo(&input);
+  WriteSample(0x2, 30, 0, &input);
+  WriteSample(0x3, 20, 1, &input);
+  testing::ExampleMmapEvent(
+      1001, 0x1c2000, 0x1000, 0, "/usr/lib/bar.so",
+      testing::SampleInfo()).WriteTo(&input);
+  WriteSample(0x4, 25, 1, &input);
+
+  PerfReader reader;
+  ASSERT_TRUE(reader.ReadFromString(input.str()));
+  reader.MaybeSortEventsByTime();
+
+  // The timeless mmaps come first, as they would with a stable sort.
+  EXPECT_EQ(PerfReader::kMergedStreams, reader.last_sort_method());
+  ASSERT_EQ(6, reader.events().size());
+  EXPECT_EQ("/usr/lib/foo.so", reader.events().Get(0).mmap_event().filename());
+  EXPECT_EQ("/usr/lib/bar.so", reader.events().Get(1).mmap_event().filename());
+  const std::vector<uint64_t> expected_ips = {0x1, 0x3, 0x4, 0x2};
+  EXPECT_EQ(expected_ips, GetSampleIps(reader));
+}
+
+TEST(PerfReaderTest, SortsUnorderedPerCpuStreamsByTime) {
+  std::stringstream input;
+  WritePipedHeaderWithCpuAttr(&input);
+
+  // CPU 0's events are out of order, so they can not just be merged.
+  WriteSample(0x1, 30, 0, &input);
+  WriteSample(0x2, 10, 0, &input);
+  WriteSample(0x3, 20, 1, &input);
+  WriteSample(0x4, 10, 1, &input);
+  WriteSample(0x5, 30, 0, &input);
+
+  PerfReader reader;
+  ASSERT_TRUE(reader.ReadFromString(input.str()));
+  reader.MaybeSortEventsByTime();
+
+  EXPECT_EQ(PerfReader::kStableSorted, reader.last_sort_method());
+  const std::vector<uint64_t> expected_ips = {0x2, 0x4, 0x3, 0x1, 0x5};
+  EXPECT_EQ(expected_ips, GetSampleIps(reader));
+}
+
 }  // namespace quipper
@@ -182,10 +182,8 @@ bool PerfSerializer::DeserializePerfEventType(
 }
 
 bool PerfSerializer::SerializeEvent(
-    const malloced_unique_ptr<event_t>& event_ptr,
+    const event_t& event,
     PerfDataProto_PerfEvent* event_proto) const {
-  const event_t& event = *event_ptr;
-
   if (!SerializeEventHeader(event.header, event_proto->mutable_header()))
     return false;
 
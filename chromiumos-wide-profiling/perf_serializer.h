@@ -62,6 +62,10 @@ class PerfSerializer {
       PerfFileAttr* event_attr) const;
 
   bool SerializeEvent(const malloced_unique_ptr<event_t>& event_ptr,
+                      PerfDataProto_PerfEvent* event_proto) const {
+    return SerializeEvent(*event_ptr, event_proto);
+  }
+  bool SerializeEvent(const event_t& event,
                       PerfDataProto_PerfEvent* event_proto) const;
   bool DeserializeEvent(const PerfDataProto_PerfEvent& event_proto,
                         malloced_unique_ptr<event_t>* event_ptr) const;
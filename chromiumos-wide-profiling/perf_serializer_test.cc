@@ -758,6 +758,62 @@ TEST(PerfSerializerTest, SerializesAndDeserializesForkAndExitEvents) {
   }
 }
 
+TEST(PerfSerializerTest, SerializesAndDeserializesCompactSamples) {
+  std::stringstream input;
+
+  // header
+  testing::ExamplePipedPerfDataFileHeader().WriteTo(&input);
+
+  // data
+
+  // PERF_RECORD_HEADER_ATTR
+  testing::ExamplePerfEventAttrEvent_Hardware(
+      PERF_SAMPLE_IP | PERF_SAMPLE_TID | PERF_SAMPLE_TIME |
+      PERF_SAMPLE_CALLCHAIN,
+      true /*sample_id_all*/).WriteTo(&input);
+
+  // PERF_RECORD_MMAP
+  testing::ExampleMmapEvent(
+      1001, 0x1c1000, 0x1000, 0, "/usr/lib/foo.so",
+      testing::SampleInfo().Tid(1001).Time(1000)).WriteTo(&input);
+
+  // PERF_RECORD_SAMPLE
+  for (int i = 0; i < 10; ++i) {
+    const u64 ip = 0x1c1000 + i * 0x10;
+    testing::ExamplePerfSampleEvent(
+        testing::SampleInfo().Ip(ip).Tid(1001 + i % 3)
+            .Time(2000 + i).Callchain({ip, 0x1c1800}))
+        .WriteTo(&input);
+  }
+
+  PerfReader reader;
+  ASSERT_TRUE(reader.ReadFromString(input.str()));
+
+  PerfDataProto perf_data_proto;
+  ASSERT_TRUE(reader.Serialize(&perf_data_proto));
+  reader.set_serialize_compact_samples(true);
+  PerfDataProto compact_perf_data_proto;
+  ASSERT_TRUE(reader.Serialize(&compact_perf_data_proto));
+
+  EXPECT_EQ(1, compact_perf_data_proto.events_size());
+  EXPECT_EQ(3, compact_perf_data_proto.compact_samples().processes_size());
+  EXPECT_LT(compact_perf_data_proto.ByteSizeLong(),
+            perf_data_proto.ByteSizeLong());
+
+  // Both protobufs are written out as the same perf data.
+  PerfReader out_reader;
+  ASSERT_TRUE(out_reader.Deserialize(perf_data_proto));
+  string output;
+  ASSERT_TRUE(out_reader.WriteToString(&output));
+
+  PerfReader compact_out_reader;
+  ASSERT_TRUE(compact_out_reader.Deserialize(compact_perf_data_proto));
+  EXPECT_EQ(11, compact_out_reader.events().size());
+  string compact_output;
+  ASSERT_TRUE(compact_out_reader.WriteToString(&compact_output));
+  EXPECT_EQ(output, compact_output);
+}
+
 // Regression test for http://crbug.com/500746.
 TEST(PerfSerializerTest, DeserializeLegacyExitEvents) {
   std::stringstream input;
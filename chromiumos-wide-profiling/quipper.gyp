@@ -20,6 +20,8 @@
         'binary_data_utils.cc',
         'buffer_reader.cc',
         'buffer_writer.cc',
+        'build_id_cache.cc',
+        'compact_samples.cc',
         'compat/cros/detail/log_level.cc',
         'data_reader.cc',
         'data_writer.cc',
@@ -27,6 +29,7 @@
         'file_reader.cc',
         'file_utils.cc',
         'huge_pages_mapping_deducer.cc',
+        'mapped_file_reader.cc',
         'perf_data_utils.cc',
         'perf_option_parser.cc',
         'perf_parser.cc',
@@ -127,6 +130,71 @@
   'conditions': [
     ['USE_test == 1', {
       'targets': [
+        {
+          'target_name': 'address_mapper_benchmark',
+          'type': 'executable',
+          'dependencies': [
+            'common',
+          ],
+          'sources': [
+            'address_mapper_benchmark.cc',
+          ],
+        },
+        {
+          'target_name': 'compact_samples_benchmark',
+          'type': 'executable',
+          'dependencies': [
+            'common',
+            'common_test',
+          ],
+          'sources': [
+            'compact_samples_benchmark.cc',
+          ],
+        },
+        {
+          'target_name': 'perf_parser_benchmark',
+          'type': 'executable',
+          'dependencies': [
+            'common',
+            'common_test',
+          ],
+          'sources': [
+            'perf_parser_benchmark.cc',
+          ],
+        },
+        {
+          'target_name': 'perf_parser_callchain_benchmark',
+          'type': 'executable',
+          'dependencies': [
+            'common',
+            'common_test',
+          ],
+          'sources': [
+            'perf_parser_callchain_benchmark.cc',
+          ],
+        },
+        {
+          'target_name': 'perf_pipeline_benchmark',
+          'type': 'executable',
+          'dependencies': [
+            'common',
+            'common_test',
+          ],
+          'sources': [
+            'perf_pipeline_benchmark.cc',
+          ],
+        },
+        {
+          'target_name': 'perf_reader_sort_benchmark',
+          'type': 'executable',
+          'dependencies': [
+            'common',
+            'common_test',
+          ],
+          'sources': [
+            'perf_reader_sort_benchmark.cc',
+          ],
+        },
         {
           # TODO(sque): Separate out longer tests and move into this target.
           'target_name': 'integration_tests',
@@ -167,9 +235,12 @@
             'binary_data_utils_test.cc',
             'buffer_reader_test.cc',
             'buffer_writer_test.cc',
+            'build_id_cache_test.cc',
+            'compact_samples_test.cc',
             'dso_test.cc',
             'file_reader_test.cc',
             'huge_pages_mapping_deducer_test.cc',
+            'mapped_file_reader_test.cc',
             'perf_data_utils_test.cc',
             'perf_option_parser_test.cc',
             'perf_parser_test.cc',
@@ -215,6 +215,15 @@ class SampleInfo {
   }
   SampleInfo& Time(u64 time) { return AddField(time); }
   SampleInfo& Id(u64 id) { return AddField(id); }
+  SampleInfo& Cpu(u32 cpu) {
+    return AddField(PunU32U64{.v32 = {cpu, 0}}.v64);
+  }
+  SampleInfo& Callchain(const std::vector<u64>& ips) {
+    AddField(ips.size());
+    for (u64 ip : ips)
+      AddField(ip);
+    return *this;
+  }
   SampleInfo& BranchStack_nr(u64 nr) { return AddField(nr); }
   SampleInfo& BranchStack_lbr(u64 from, u64 to, u64 flags) {
     AddField(from);
@@ -119,5 +119,20 @@ const char kDarkResumeWakeDurationMsName[] = "Power.DarkResumeWakeDurationMs";
 const int kDarkResumeWakeDurationMsMin = 0;
 const int kDarkResumeWakeDurationMsMax = 10 * 60 * 1000;
 
+const char kSuspendDelayWaitMsName[] = "Power.SuspendDelayWaitMs";
+const char kSuspendReadinessLatencyMsName[] = "Power.SuspendReadinessLatencyMs";
+const char kDarkSuspendReadinessLatencyMsName[] =
+    "Power.DarkSuspendReadinessLatencyMs";
+const int kSuspendDelayMsMin = 1;
+const int kSuspendDelayMsMax = 30 * 1000;
+
+const char kSuspendAttemptDurationMsName[] = "Power.SuspendAttemptDurationMs";
+const int kSuspendAttemptDurationMsMin = 1;
+const int kSuspendAttemptDurationMsMax = 60 * 1000;
+
+const char kSuspendFinishDurationMsName[] = "Power.SuspendFinishDurationMs";
+const int kSuspendFinishDurationMsMin = 1;
+const int kSuspendFinishDurationMsMax = 10 * 1000;
+
 }  // namespace metrics
 }  // namespace power_manager
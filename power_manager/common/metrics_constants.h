@@ -111,6 +111,20 @@ extern const char kDarkResumeWakeDurationMsName[];
 extern const int kDarkResumeWakeDurationMsMin;
 extern const int kDarkResumeWakeDurationMsMax;
 
+extern const char kSuspendDelayWaitMsName[];
+extern const char kSuspendReadinessLatencyMsName[];
+extern const char kDarkSuspendReadinessLatencyMsName[];
+extern const int kSuspendDelayMsMin;
+extern const int kSuspendDelayMsMax;
+
+extern const char kSuspendAttemptDurationMsName[];
+extern const int kSuspendAttemptDurationMsMin;
+extern const int kSuspendAttemptDurationMsMax;
+
+extern const char kSuspendFinishDurationMsName[];
+extern const int kSuspendFinishDurationMsMin;
+extern const int kSuspendFinishDurationMsMax;
+
 // Values for kBatteryInfoSampleName.
 enum class BatteryInfoSampleResult {
   READ,
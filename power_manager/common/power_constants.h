@@ -234,6 +234,11 @@ extern const char kBusServicePath[];
 extern const char kBusInterface[];
 extern const char kBusNameOwnerChangedSignal[];
 
+// powerd D-Bus method that returns a string describing the timing of recent
+// suspend requests (see policy::SuspendTrace). This isn't part of
+// chromeos/dbus/service_constants.h since it's only used for debugging.
+extern const char kGetSuspendTraceMethod[];
+
 // Small value used when comparing floating-point percentages.
 extern const double kEpsilon;
 
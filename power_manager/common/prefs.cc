@@ -4,7 +4,10 @@
 
 #include "power_manager/common/prefs.h"
 
-#include <set>
+#include <errno.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+
 #include <utility>
 
 #include <base/bind.h>
@@ -13,6 +16,7 @@
 #include <base/files/file_util.h>
 #include <base/location.h>
 #include <base/logging.h>
+#include <base/posix/eintr_wrapper.h>
 #include <base/strings/string_number_conversions.h>
 #include <base/strings/string_util.h>
 
@@ -27,6 +31,13 @@ namespace {
 // milliseconds.
 const int kDefaultWriteIntervalMs = 1000;
 
+// inotify events that indicate that a pref file's contents have changed or
+// that a directory has been removed. IN_CREATE and IN_ATTRIB catch pref files
+// that appear without being written, e.g. via link(), or become readable.
+const uint32_t kInotifyMask = IN_CLOSE_WRITE | IN_CREATE | IN_ATTRIB |
+                              IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO |
+                              IN_DELETE_SELF | IN_MOVE_SELF;
+
 }  // namespace
 
 Prefs::TestApi::TestApi(Prefs* prefs) : prefs_(prefs) {}
@@ -42,8 +53,21 @@ bool Prefs::TestApi::TriggerWriteTimeout() {
   return true;
 }
 
+bool Prefs::TestApi::IsCached(const std::string& name) const {
+  return prefs_->cache_.count(name) > 0;
+}
+
+Prefs::CachedPref::CachedPref()
+    : int64_parsed(false),
+      has_int64(false),
+      int64_value(0),
+      double_parsed(false),
+      has_double(false),
+      double_value(0.0) {}
+
 Prefs::Prefs()
-    : write_interval_(
+    : cache_enabled_(false),
+      write_interval_(
           base::TimeDelta::FromMilliseconds(kDefaultWriteIntervalMs)) {}
 
 Prefs::~Prefs() {
@@ -54,10 +78,13 @@ Prefs::~Prefs() {
 bool Prefs::Init(const std::vector<base::FilePath>& pref_paths) {
   CHECK(!pref_paths.empty());
   pref_paths_ = pref_paths;
-  return dir_watcher_.Watch(
-      pref_paths_[0],
-      false,
-      base::Bind(&Prefs::HandleFileChanged, base::Unretained(this)));
+  // Start watching before reading so that changes made while the cache is
+  // being loaded aren't missed.
+  if (!WatchPrefPaths())
+    return false;
+  if (cache_enabled_)
+    LoadCache();
+  return true;
 }
 
 void Prefs::AddObserver(PrefsObserver* observer) {
@@ -70,30 +97,150 @@ void Prefs::RemoveObserver(PrefsObserver* observer) {
   observers_.RemoveObserver(observer);
 }
 
-void Prefs::HandleFileChanged(const base::FilePath& path, bool error) {
-  if (error) {
-    LOG(ERROR) << "Got error while hearing about change to " << path.value();
-    return;
+void Prefs::OnFileCanReadWithoutBlocking(int fd) {
+  DCHECK_EQ(fd, inotify_fd_.get());
+  ReadInotifyEvents();
+}
+
+void Prefs::OnFileCanWriteWithoutBlocking(int fd) {
+  NOTREACHED() << "Unexpected non-blocking write notification for FD " << fd;
+}
+
+bool Prefs::WatchPrefPaths() {
+  inotify_fd_.reset(inotify_init1(IN_NONBLOCK | IN_CLOEXEC));
+  if (!inotify_fd_.is_valid()) {
+    PLOG(ERROR) << "Unable to create inotify instance";
+    return false;
+  }
+
+  cache_enabled_ = true;
+  for (size_t i = 0; i < pref_paths_.size(); ++i) {
+    const base::FilePath& dir = pref_paths_[i];
+    if (inotify_add_watch(inotify_fd_.get(), dir.value().c_str(),
+                          kInotifyMask) >= 0)
+      continue;
+    // The later directories hold read-only defaults (e.g. board-specific
+    // prefs), so one that doesn't exist now won't appear later.
+    if (i > 0 && errno == ENOENT)
+      continue;
+    PLOG(WARNING) << "Unable to watch " << dir.value() << " for changes; "
+                  << "prefs won't be cached";
+    cache_enabled_ = false;
+  }
+
+  if (!base::MessageLoopForIO::current()->WatchFileDescriptor(
+          inotify_fd_.get(),
+          true,
+          base::MessageLoopForIO::WATCH_READ,
+          &inotify_watcher_,
+          this)) {
+    LOG(ERROR) << "Unable to watch FD " << inotify_fd_.get();
+    return false;
   }
+  return true;
+}
 
-  // Rescan the directory if it changed.
-  if (path == pref_paths_[0]) {
-    UpdateFileWatchers(path);
+void Prefs::LoadCache() {
+  std::set<std::string> names;
+  for (const base::FilePath& dir : pref_paths_) {
+    base::FileEnumerator enumerator(dir, false, base::FileEnumerator::FILES);
+    for (base::FilePath path = enumerator.Next(); !path.empty();
+         path = enumerator.Next()) {
+      names.insert(path.BaseName().value());
+    }
+  }
+  for (const std::string& name : names)
+    GetPrefStrings(name, &cache_[name].results);
+  VLOG(1) << "Cached " << cache_.size() << " pref(s)";
+}
+
+void Prefs::ReadInotifyEvents() {
+  if (!inotify_fd_.is_valid())
     return;
+
+  const size_t old_num_changed_prefs = changed_prefs_.size();
+  char buf[4096]
+      __attribute__((aligned(__alignof__(struct inotify_event))));
+  while (true) {
+    const ssize_t bytes_read =
+        HANDLE_EINTR(read(inotify_fd_.get(), buf, sizeof(buf)));
+    if (bytes_read < 0) {
+      if (errno != EAGAIN && errno != EWOULDBLOCK)
+        PLOG(ERROR) << "Reading inotify events failed";
+      break;
+    }
+    if (bytes_read == 0)
+      break;
+
+    for (const char* ptr = buf; ptr < buf + bytes_read;) {
+      const struct inotify_event* event =
+          reinterpret_cast<const struct inotify_event*>(ptr);
+      ptr += sizeof(struct inotify_event) + event->len;
+
+      if (event->mask & IN_Q_OVERFLOW) {
+        // Some changes were lost, so nothing in the cache can be trusted.
+        LOG(WARNING) << "inotify queue overflowed; dropping cached prefs";
+        for (const auto& entry : cache_)
+          changed_prefs_.insert(entry.first);
+        cache_.clear();
+      } else if (event->mask & (IN_IGNORED | IN_DELETE_SELF | IN_MOVE_SELF)) {
+        if (cache_enabled_) {
+          LOG(WARNING) << "Pref directory was removed; no longer caching prefs";
+          for (const auto& entry : cache_)
+            changed_prefs_.insert(entry.first);
+          cache_.clear();
+          cache_enabled_ = false;
+        }
+      } else if (event->len > 0 && !(event->mask & IN_ISDIR)) {
+        // Resist the temptation to erase the pref from |prefs_to_write_|
+        // here, as it would cause a race:
+        // 1. SetInt64() is called and pref is written to disk.
+        // 2. SetInt64() is called and and the new value is queued.
+        // 3. This event is read regarding the initial write.
+        const std::string name(event->name);
+        cache_.erase(name);
+        changed_prefs_.insert(name);
+      }
+    }
+  }
+
+  // Observers are notified from a separate task so that they aren't called
+  // in the middle of a Get*() call.
+  if (changed_prefs_.size() > old_num_changed_prefs &&
+      notify_observers_task_.IsCancelled()) {
+    notify_observers_task_.Reset(
+        base::Bind(&Prefs::NotifyObservers, base::Unretained(this)));
+    base::MessageLoop::current()->PostTask(FROM_HERE,
+                                           notify_observers_task_.callback());
   }
+}
+
+void Prefs::NotifyObservers() {
+  notify_observers_task_.Cancel();
+  std::set<std::string> changed_prefs;
+  changed_prefs.swap(changed_prefs_);
+  for (const std::string& name : changed_prefs)
+    FOR_EACH_OBSERVER(PrefsObserver, observers_, OnPrefChanged(name));
+}
+
+Prefs::CachedPref* Prefs::GetCachedPref(const std::string& name) {
+  ReadInotifyEvents();
 
-  const std::string name = path.BaseName().value();
+  if (!cache_enabled_) {
+    uncached_pref_ = CachedPref();
+    GetPrefStrings(name, &uncached_pref_.results);
+    return &uncached_pref_;
+  }
 
-  // Resist the temptation to erase |name| from |prefs_to_write_| here, as
-  // it would cause a race:
-  // 1. SetInt64() is called and pref is written to disk.
-  // 2. SetInt64() is called and and the new value is queued.
-  // 3. HandleFileChanged() is called regarding the initial write.
-  FOR_EACH_OBSERVER(PrefsObserver, observers_, OnPrefChanged(name));
+  CacheMap::iterator it = cache_.find(name);
+  if (it == cache_.end()) {
+    it = cache_.insert(std::make_pair(name, CachedPref())).first;
+    GetPrefStrings(name, &it->second.results);
+  }
+  return &it->second;
 }
 
 void Prefs::GetPrefStrings(const std::string& name,
-                           bool read_all,
                            std::vector<PrefReadResult>* results) {
   CHECK(results);
   results->clear();
@@ -116,51 +263,58 @@ void Prefs::GetPrefStrings(const std::string& name,
     result.path = path.value();
     result.value = buf;
     results->push_back(result);
-    if (!read_all)
-      return;
   }
 }
 
 bool Prefs::GetString(const std::string& name, std::string* buf) {
   DCHECK(buf);
-  std::vector<PrefReadResult> results;
-  GetPrefStrings(name, false, &results);
-  if (results.empty())
+  const CachedPref* pref = GetCachedPref(name);
+  if (pref->results.empty())
     return false;
-  *buf = results[0].value;
+  *buf = pref->results[0].value;
   return true;
 }
 
 bool Prefs::GetInt64(const std::string& name, int64_t* value) {
   DCHECK(value);
-  std::vector<PrefReadResult> results;
-  GetPrefStrings(name, true, &results);
-
-  for (std::vector<PrefReadResult>::const_iterator iter = results.begin();
-       iter != results.end();
-       ++iter) {
-    if (base::StringToInt64(iter->value, value))
-      return true;
-    else
+  CachedPref* pref = GetCachedPref(name);
+  if (!pref->int64_parsed) {
+    pref->int64_parsed = true;
+    for (std::vector<PrefReadResult>::const_iterator iter =
+             pref->results.begin();
+         iter != pref->results.end();
+         ++iter) {
+      if (base::StringToInt64(iter->value, &pref->int64_value)) {
+        pref->has_int64 = true;
+        break;
+      }
       LOG(ERROR) << "Unable to parse int64_t from " << iter->path;
+    }
   }
-  return false;
+  if (pref->has_int64)
+    *value = pref->int64_value;
+  return pref->has_int64;
 }
 
 bool Prefs::GetDouble(const std::string& name, double* value) {
   DCHECK(value);
-  std::vector<PrefReadResult> results;
-  GetPrefStrings(name, true, &results);
-
-  for (std::vector<PrefReadResult>::const_iterator iter = results.begin();
-       iter != results.end();
-       ++iter) {
-    if (base::StringToDouble(iter->value, value))
-      return true;
-    else
+  CachedPref* pref = GetCachedPref(name);
+  if (!pref->double_parsed) {
+    pref->double_parsed = true;
+    for (std::vector<PrefReadResult>::const_iterator iter =
+             pref->results.begin();
+         iter != pref->results.end();
+         ++iter) {
+      if (base::StringToDouble(iter->value, &pref->double_value)) {
+        pref->has_double = true;
+        break;
+      }
       LOG(ERROR) << "Unable to parse double from " << iter->path;
+    }
   }
-  return false;
+  if (pref->has_double)
+    *value = pref->double_value;
+  return pref->has_double;
 }
 
 bool Prefs::GetBool(const std::string& name, bool* value) {
@@ -173,16 +327,19 @@ bool Prefs::GetBool(const std::string& name, bool* value) {
 
 void Prefs::SetString(const std::string& name, const std::string& value) {
   prefs_to_write_[name] = value;
+  cache_.erase(name);
   ScheduleWrite();
 }
 
 void Prefs::SetInt64(const std::string& name, int64_t value) {
   prefs_to_write_[name] = base::Int64ToString(value);
+  cache_.erase(name);
   ScheduleWrite();
 }
 
 void Prefs::SetDouble(const std::string& name, double value) {
   prefs_to_write_[name] = base::DoubleToString(value);
+  cache_.erase(name);
   ScheduleWrite();
 }
 
@@ -215,55 +372,4 @@ void Prefs::WritePrefs() {
   last_write_time_ = base::TimeTicks::Now();
 }
 
-void Prefs::UpdateFileWatchers(const base::FilePath& dir) {
-  // Look for files that have been created or unlinked.
-  base::FileEnumerator enumerator(dir, false, base::FileEnumerator::FILES);
-  std::set<std::string> current_prefs;
-  for (base::FilePath path = enumerator.Next(); !path.empty();
-       path = enumerator.Next()) {
-    current_prefs.insert(path.BaseName().value());
-  }
-  std::vector<std::string> added_prefs;
-  for (std::set<std::string>::const_iterator it = current_prefs.begin();
-       it != current_prefs.end();
-       ++it) {
-    if (file_watchers_.find(*it) == file_watchers_.end())
-      added_prefs.push_back(*it);
-  }
-  std::vector<std::string> removed_prefs;
-  for (FileWatcherMap::const_iterator it = file_watchers_.begin();
-       it != file_watchers_.end();
-       ++it) {
-    if (current_prefs.find(it->first) == current_prefs.end())
-      removed_prefs.push_back(it->first);
-  }
-
-  // Start watching new files.
-  for (std::vector<std::string>::const_iterator it = added_prefs.begin();
-       it != added_prefs.end();
-       ++it) {
-    const std::string& name = *it;
-    const base::FilePath path = dir.Append(name);
-    linked_ptr<base::FilePathWatcher> watcher(new base::FilePathWatcher);
-    if (watcher->Watch(
-            path,
-            false,
-            base::Bind(&Prefs::HandleFileChanged, base::Unretained(this)))) {
-      file_watchers_.insert(std::make_pair(name, watcher));
-    } else {
-      LOG(ERROR) << "Unable to watch " << path.value() << " for changes";
-    }
-    FOR_EACH_OBSERVER(PrefsObserver, observers_, OnPrefChanged(name));
-  }
-
-  // Stop watching old files.
-  for (std::vector<std::string>::const_iterator it = removed_prefs.begin();
-       it != removed_prefs.end();
-       ++it) {
-    const std::string& name = *it;
-    file_watchers_.erase(name);
-    FOR_EACH_OBSERVER(PrefsObserver, observers_, OnPrefChanged(name));
-  }
-}
-
 }  // namespace power_manager
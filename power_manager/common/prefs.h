@@ -8,13 +8,15 @@
 #include <stdint.h>
 
 #include <map>
+#include <set>
 #include <string>
 #include <vector>
 
+#include <base/cancelable_callback.h>
 #include <base/compiler_specific.h>
 #include <base/files/file_path.h>
-#include <base/files/file_path_watcher.h>
-#include <base/memory/linked_ptr.h>
+#include <base/files/scoped_file.h>
+#include <base/message_loop/message_loop.h>
 #include <base/observer_list.h>
 #include <base/time/time.h>
 #include <base/timer/timer.h>
@@ -49,7 +51,13 @@ class PrefsInterface {
 // Multiple directories are supported; this allows a default set of prefs
 // to be placed on the readonly root partition and a second set of
 // prefs under /var to be overlaid and changed at runtime.
-class Prefs : public PrefsInterface {
+//
+// Values are cached in memory after they're first read. The directories are
+// watched via inotify; a change to a pref file drops its cached value and
+// notifies observers. Pending inotify events are also consumed before each
+// lookup, so a value written by another process is seen by the next Get*()
+// call even if the message loop hasn't run in the meantime.
+class Prefs : public PrefsInterface, public base::MessageLoopForIO::Watcher {
  public:
   // Helper class for tests.
   class TestApi {
@@ -65,6 +73,9 @@ class Prefs : public PrefsInterface {
     // wasn't set.
     bool TriggerWriteTimeout();
 
+    // Returns true if |name|'s value is currently cached.
+    bool IsCached(const std::string& name) const;
+
    private:
     Prefs* prefs_;  // weak
 
@@ -74,8 +85,9 @@ class Prefs : public PrefsInterface {
   Prefs();
   virtual ~Prefs();
 
-  // Earlier directories in |pref_paths_| take precedence over later ones.  Only
-  // the first directory is watched for changes.
+  // Earlier directories in |pref_paths_| take precedence over later ones.  All
+  // directories are watched for changes, and the prefs that they contain are
+  // read into the cache.
   bool Init(const std::vector<base::FilePath>& pref_paths);
 
   // PrefsInterface implementation:
@@ -89,26 +101,59 @@ class Prefs : public PrefsInterface {
   void SetInt64(const std::string& name, int64_t value) override;
   void SetDouble(const std::string& name, double value) override;
 
- private:
-  typedef std::map<std::string, linked_ptr<base::FilePathWatcher>>
-      FileWatcherMap;
+  // base::MessageLoopForIO::Watcher implementation:
+  void OnFileCanReadWithoutBlocking(int fd) override;
+  void OnFileCanWriteWithoutBlocking(int fd) override;
 
+ private:
   // Result of a pref file read operation.
   struct PrefReadResult {
     std::string value;  // The value that was read.
     std::string path;   // The pref file from which |value| was read.
   };
 
-  // Called by |file_watcher_| when a pref is changed. Notifies |observers_|.
-  void HandleFileChanged(const base::FilePath& path, bool error);
+  // A pref's values from all of |pref_paths_|, along with the results of
+  // parsing them as numbers once they've been requested in that form.
+  struct CachedPref {
+    CachedPref();
+
+    std::vector<PrefReadResult> results;
+
+    bool int64_parsed;  // True if |has_int64| and |int64_value| are set.
+    bool has_int64;
+    int64_t int64_value;
+
+    bool double_parsed;  // True if |has_double| and |double_value| are set.
+    bool has_double;
+    double double_value;
+  };
+
+  typedef std::map<std::string, CachedPref> CacheMap;
+
+  // Adds inotify watches for |pref_paths_| and starts watching |inotify_fd_|.
+  // Returns false if changes can't be detected at all; if only some
+  // directories couldn't be watched, |cache_enabled_| is cleared instead.
+  bool WatchPrefPaths();
+
+  // Reads every pref present in |pref_paths_| into |cache_|.
+  void LoadCache();
+
+  // Reads all pending events from |inotify_fd_|, drops the changed prefs from
+  // |cache_|, and schedules NotifyObservers() to report them.
+  void ReadInotifyEvents();
+
+  // Notifies |observers_| about the prefs in |changed_prefs_|.
+  void NotifyObservers();
+
+  // Returns |name|'s values, reading them from disk if they aren't cached.
+  // The returned pointer is valid until the next call.
+  CachedPref* GetCachedPref(const std::string& name);
 
   // Reads contents of pref files given by |name| from all the paths in
   // |pref_paths_| in order, where they exist.  Strips them of whitespace.
-  // Stores each read result in |results|.
-  // If |read_all| is true, it will attempt to read from all pref paths.
-  // Otherwise it will return after successfully reading one pref file.
+  // Stores each read result in |results|.  A value in |prefs_to_write_| is
+  // used in place of the first path's file.
   void GetPrefStrings(const std::string& name,
-                      bool read_all,
                       std::vector<PrefReadResult>* results);
 
   // Calls WritePrefs() immediately if prefs haven't been written to disk
@@ -120,10 +165,6 @@ class Prefs : public PrefsInterface {
   // |last_write_time_|, and clears |prefs_to_write_|.
   void WritePrefs();
 
-  // Updates |file_watchers_| to contain a watcher for every file currently in
-  // |dir|.
-  void UpdateFileWatchers(const base::FilePath& dir);
-
   // List of file paths to read from, in order of precedence.
   // A value read from the first path will be used instead of values from the
   // other paths.
@@ -131,11 +172,29 @@ class Prefs : public PrefsInterface {
 
   base::ObserverList<PrefsObserver> observers_;
 
-  // For notification of updates to pref files.
-  base::FilePathWatcher dir_watcher_;
+  // inotify instance watching the directories in |pref_paths_|, and the
+  // watcher that reports when it has events.
+  base::ScopedFD inotify_fd_;
+  base::MessageLoopForIO::FileDescriptorWatcher inotify_watcher_;
+
+  // Map from pref names to their values on disk (or queued in
+  // |prefs_to_write_|).  Entries are dropped when the corresponding files
+  // change.
+  CacheMap cache_;
+
+  // False if some directory in |pref_paths_| couldn't be watched, in which
+  // case prefs are always read from disk.
+  bool cache_enabled_;
+
+  // Holds the values returned by GetCachedPref() while |cache_enabled_| is
+  // false.
+  CachedPref uncached_pref_;
+
+  // Prefs whose files have changed since observers were last notified.
+  std::set<std::string> changed_prefs_;
 
-  // Map from pref file basenames to base::FilePathWatchers.
-  FileWatcherMap file_watchers_;
+  // Runs NotifyObservers().
+  base::CancelableClosure notify_observers_task_;
 
   // Calls WritePrefs().
   base::OneShotTimer write_prefs_timer_;
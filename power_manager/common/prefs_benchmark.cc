@@ -0,0 +1,115 @@
+// Copyright 2016 The Chromium OS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// Measures how many pref reads per second Prefs serves from a set of
+// directories laid out like powerd's, compared to reading the pref files from
+// disk on every lookup as Prefs used to.
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include <base/at_exit.h>
+#include <base/files/file_path.h>
+#include <base/files/file_util.h>
+#include <base/files/scoped_temp_dir.h>
+#include <base/logging.h>
+#include <base/macros.h>
+#include <base/message_loop/message_loop.h>
+#include <base/strings/string_number_conversions.h>
+#include <base/strings/string_util.h>
+#include <base/strings/stringprintf.h>
+#include <base/time/time.h>
+
+#include "power_manager/common/prefs.h"
+
+namespace {
+
+// Number of prefs in each directory, from the read-write directory to the
+// defaults.
+const int kNumPrefs[] = {5, 20, 60};
+const int kNumReads = 100000;
+
+std::string GetPrefName(int index) {
+  return base::StringPrintf("pref_%d", index);
+}
+
+// Reads |name| the way Prefs did before it had a cache.
+bool ReadUncached(const std::vector<base::FilePath>& paths,
+                  const std::string& name,
+                  int64_t* value) {
+  for (const base::FilePath& dir : paths) {
+    std::string buf;
+    if (!base::ReadFileToString(dir.Append(name), &buf))
+      continue;
+    base::TrimWhitespaceASCII(buf, base::TRIM_TRAILING, &buf);
+    if (base::StringToInt64(buf, value))
+      return true;
+  }
+  return false;
+}
+
+void Report(const char* name, base::TimeDelta elapsed) {
+  printf("%-24s %12.2f %14.0f\n", name, elapsed.InMillisecondsF(),
+         kNumReads / elapsed.InSecondsF());
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  base::AtExitManager at_exit;
+  base::MessageLoopForIO message_loop;
+
+  base::ScopedTempDir temp_dirs[arraysize(kNumPrefs)];
+  std::vector<base::FilePath> paths;
+  int max_prefs = 0;
+  for (size_t i = 0; i < arraysize(kNumPrefs); ++i) {
+    CHECK(temp_dirs[i].CreateUniqueTempDir());
+    paths.push_back(temp_dirs[i].path());
+    for (int j = 0; j < kNumPrefs[i]; ++j) {
+      const std::string value = base::IntToString(j) + "\n";
+      CHECK_EQ(static_cast<int>(value.size()),
+               base::WriteFile(paths[i].Append(GetPrefName(j)), value.data(),
+                               value.size()));
+    }
+    max_prefs = std::max(max_prefs, kNumPrefs[i]);
+  }
+
+  // Also look up names that don't exist, as powerd does for optional prefs.
+  const int kNumNames = max_prefs + 10;
+  std::vector<std::string> names;
+  for (int i = 0; i < kNumNames; ++i)
+    names.push_back(GetPrefName(i));
+
+  printf("%-24s %12s %14s\n", "reads", "ms", "reads/s");
+
+  base::TimeTicks start = base::TimeTicks::Now();
+  int64_t value = 0;
+  for (int i = 0; i < kNumReads; ++i)
+    ReadUncached(paths, names[i % kNumNames], &value);
+  Report("uncached", base::TimeTicks::Now() - start);
+
+  power_manager::Prefs prefs;
+  CHECK(prefs.Init(paths));
+  start = base::TimeTicks::Now();
+  for (int i = 0; i < kNumReads; ++i)
+    prefs.GetInt64(names[i % kNumNames], &value);
+  Report("Prefs::GetInt64", base::TimeTicks::Now() - start);
+
+  // Rewrite a pref after every 100 reads so that lookups also pay for
+  // invalidation and re-reading.
+  const base::FilePath changed_path = paths[0].Append(GetPrefName(0));
+  start = base::TimeTicks::Now();
+  for (int i = 0; i < kNumReads; ++i) {
+    if (i % 100 == 0)
+      CHECK_EQ(1, base::WriteFile(changed_path, "1", 1));
+    prefs.GetInt64(names[i % kNumNames], &value);
+  }
+  Report("with 1% writes", base::TimeTicks::Now() - start);
+
+  return 0;
+}
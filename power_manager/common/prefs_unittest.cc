@@ -300,6 +300,61 @@ TEST_F(PrefsTest, WatchPrefs) {
   EXPECT_EQ(kPrefName, observer.RunUntilPrefChanged());
 }
 
+// Test that cached prefs are refreshed when their files are changed by
+// someone else.
+TEST_F(PrefsTest, CacheObservesExternalEdits) {
+  const char kName[] = "foo";
+  const base::FilePath kPath = paths_[0].Append(kName);
+  const base::FilePath kDefaultPath = paths_[2].Append(kName);
+  ASSERT_EQ(1, base::WriteFile(kDefaultPath, "1", 1));
+
+  TestPrefsObserver observer(&prefs_);
+  ASSERT_TRUE(prefs_.Init(paths_));
+  EXPECT_TRUE(test_api_.IsCached(kName));
+  int64_t value = -1;
+  EXPECT_TRUE(prefs_.GetInt64(kName, &value));
+  EXPECT_EQ(1, value);
+
+  // Changes should be seen by the next read, without running the loop.
+  ASSERT_EQ(1, base::WriteFile(kDefaultPath, "2", 1));
+  EXPECT_TRUE(prefs_.GetInt64(kName, &value));
+  EXPECT_EQ(2, value);
+  ASSERT_EQ(1, base::WriteFile(kPath, "3", 1));
+  EXPECT_TRUE(prefs_.GetInt64(kName, &value));
+  EXPECT_EQ(3, value);
+  std::string string_value;
+  EXPECT_TRUE(prefs_.GetString(kName, &string_value));
+  EXPECT_EQ("3", string_value);
+
+  // Observers should still hear about the change, once.
+  EXPECT_EQ(kName, observer.RunUntilPrefChanged());
+
+  // Removing the overriding file should expose the default value again.
+  ASSERT_TRUE(base::DeleteFile(kPath, false));
+  EXPECT_TRUE(prefs_.GetInt64(kName, &value));
+  EXPECT_EQ(2, value);
+  EXPECT_EQ(kName, observer.RunUntilPrefChanged());
+
+  // Prefs that don't exist should be noticed when they're created.
+  const char kNewName[] = "bar";
+  EXPECT_FALSE(prefs_.GetInt64(kNewName, &value));
+  EXPECT_TRUE(test_api_.IsCached(kNewName));
+  ASSERT_EQ(1, base::WriteFile(paths_[1].Append(kNewName), "4", 1));
+  EXPECT_TRUE(prefs_.GetInt64(kNewName, &value));
+  EXPECT_EQ(4, value);
+
+  // Files that are linked into place, rather than written, should also be
+  // noticed.
+  base::ScopedTempDir target_dir;
+  ASSERT_TRUE(target_dir.CreateUniqueTempDir());
+  const base::FilePath kTargetPath = target_dir.path().Append(kNewName);
+  ASSERT_EQ(1, base::WriteFile(kTargetPath, "5", 1));
+  ASSERT_TRUE(
+      base::CreateSymbolicLink(kTargetPath, paths_[0].Append(kNewName)));
+  EXPECT_TRUE(prefs_.GetInt64(kNewName, &value));
+  EXPECT_EQ(5, value);
+}
+
 // Test that additional write requests made soon after an initial request
 // are deferred.
 TEST_F(PrefsTest, DeferredWrites) {
@@ -66,10 +66,12 @@
         'powerd/system/display/external_display.cc',
         'powerd/system/ec_wakeup_helper.cc',
         'powerd/system/event_device.cc',
+        'powerd/system/iio_buffer.cc',
         'powerd/system/input_watcher.cc',
         'powerd/system/internal_backlight.cc',
         'powerd/system/peripheral_battery_watcher.cc',
         'powerd/system/power_supply.cc',
+        'powerd/system/power_supply_sampler.cc',
         'powerd/system/rolling_average.cc',
         'powerd/system/tagged_device.cc',
         'powerd/system/udev.cc',
@@ -126,6 +128,7 @@
         'powerd/policy/keyboard_backlight_controller.cc',
         'powerd/policy/state_controller.cc',
         'powerd/policy/suspend_delay_controller.cc',
+        'powerd/policy/suspend_trace.cc',
         'powerd/policy/suspender.cc',
       ],
     },
@@ -232,6 +235,7 @@
     {
       'target_name': 'powerd_dbus_suspend',
       'type': 'executable',
+      'dependencies': ['libutil'],
       'sources': ['tools/powerd_dbus_suspend.cc'],
     },
     {
@@ -322,6 +326,12 @@
             'common/util_unittest.cc',
           ],
         },
+        {
+          'target_name': 'prefs_benchmark',
+          'type': 'executable',
+          'dependencies': ['libutil'],
+          'sources': ['common/prefs_benchmark.cc'],
+        },
         {
           'target_name': 'power_manager_system_test',
           'type': 'executable',
@@ -346,14 +356,38 @@
             'powerd/system/dark_resume_unittest.cc',
             'powerd/system/display/display_watcher_unittest.cc',
             'powerd/system/display/external_display_unittest.cc',
+            'powerd/system/iio_buffer_unittest.cc',
             'powerd/system/input_watcher_unittest.cc',
             'powerd/system/internal_backlight_unittest.cc',
             'powerd/system/peripheral_battery_watcher_unittest.cc',
+            'powerd/system/power_supply_sampler_unittest.cc',
             'powerd/system/power_supply_unittest.cc',
             'powerd/system/rolling_average_unittest.cc',
             'powerd/system/tagged_device_unittest.cc',
           ],
         },
+        {
+          'target_name': 'power_supply_benchmark',
+          'type': 'executable',
+          'dependencies': [
+            'libsystem',
+            'libsystem_stub',
+            'libutil',
+            'libutil_test',
+          ],
+          'sources': ['powerd/system/power_supply_benchmark.cc'],
+        },
+        {
+          'target_name': 'input_watcher_benchmark',
+          'type': 'executable',
+          'dependencies': [
+            'libsystem',
+            'libsystem_stub',
+            'libutil',
+            'libutil_test',
+          ],
+          'sources': ['powerd/system/input_watcher_benchmark.cc'],
+        },
         {
           'target_name': 'power_manager_policy_test',
           'type': 'executable',
@@ -376,6 +410,7 @@
             'powerd/policy/keyboard_backlight_controller_unittest.cc',
             'powerd/policy/state_controller_unittest.cc',
             'powerd/policy/suspend_delay_controller_unittest.cc',
+            'powerd/policy/suspend_trace_unittest.cc',
             'powerd/policy/suspender_unittest.cc',
           ],
         },
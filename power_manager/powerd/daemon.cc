@@ -755,6 +755,11 @@ void Daemon::GenerateDarkResumeMetrics(
                                                 suspend_duration);
 }
 
+void Daemon::GenerateSuspendTraceMetrics(
+    const policy::SuspendTrace::Request& request) {
+  metrics_collector_->GenerateSuspendTraceMetrics(request);
+}
+
 void Daemon::ShutDownForFailedSuspend() {
   ShutDown(ShutdownMode::POWER_OFF, ShutdownReason::SUSPEND_FAILED);
 }
@@ -936,6 +941,7 @@ void Daemon::InitDBus() {
        &Suspender::HandleDarkSuspendReadiness},
       {kRecordDarkResumeWakeReasonMethod,
        &Suspender::RecordDarkResumeWakeReason},
+      {kGetSuspendTraceMethod, &Suspender::GetSuspendTrace},
   };
   for (const auto& it : kSuspenderMethods) {
     dbus_wrapper_->ExportMethod(
@@ -136,6 +136,8 @@ class Daemon : public policy::BacklightControllerObserver,
       const std::vector<policy::Suspender::DarkResumeInfo>&
           dark_resume_wake_durations,
       base::TimeDelta suspend_duration) override;
+  void GenerateSuspendTraceMetrics(
+      const policy::SuspendTrace::Request& request) override;
   void ShutDownForFailedSuspend() override;
   void ShutDownForDarkResume() override;
 
@@ -297,6 +297,56 @@ void MetricsCollector::GenerateDarkResumeMetrics(
   }
 }
 
+void MetricsCollector::GenerateSuspendTraceMetrics(
+    const policy::SuspendTrace::Request& request) {
+  for (const auto& span : request.spans) {
+    switch (span.phase) {
+      case policy::SuspendTrace::Phase::WAIT_FOR_DELAYS:
+        SendMetric(kSuspendDelayWaitMsName,
+                   span.duration.InMilliseconds(),
+                   kSuspendDelayMsMin,
+                   kSuspendDelayMsMax,
+                   kDefaultBuckets);
+        break;
+      case policy::SuspendTrace::Phase::SUSPEND:
+        if (request.success) {
+          SendMetric(kSuspendAttemptDurationMsName,
+                     span.duration.InMilliseconds(),
+                     kSuspendAttemptDurationMsMin,
+                     kSuspendAttemptDurationMsMax,
+                     kDefaultBuckets);
+        }
+        break;
+      case policy::SuspendTrace::Phase::FINISH:
+        if (request.success) {
+          SendMetric(kSuspendFinishDurationMsName,
+                     span.duration.InMilliseconds(),
+                     kSuspendFinishDurationMsMin,
+                     kSuspendFinishDurationMsMax,
+                     kDefaultBuckets);
+        }
+        break;
+      default:
+        break;
+    }
+  }
+
+  for (const auto& delay : request.delays) {
+    SendMetric(kSuspendReadinessLatencyMsName,
+               delay.latency.InMilliseconds(),
+               kSuspendDelayMsMin,
+               kSuspendDelayMsMax,
+               kDefaultBuckets);
+  }
+  for (const auto& delay : request.dark_delays) {
+    SendMetric(kDarkSuspendReadinessLatencyMsName,
+               delay.latency.InMilliseconds(),
+               kSuspendDelayMsMin,
+               kSuspendDelayMsMax,
+               kDefaultBuckets);
+  }
+}
+
 void MetricsCollector::GenerateUserActivityMetrics() {
   if (last_idle_event_timestamp_.is_null())
     return;
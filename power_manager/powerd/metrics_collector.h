@@ -85,6 +85,13 @@ class MetricsCollector {
       const std::vector<policy::Suspender::DarkResumeInfo>& wake_durations,
       base::TimeDelta suspend_duration);
 
+  // Called after a suspend request has completed (successfully or not).
+  // Generates UMA metrics for the time spent waiting for suspend delays, each
+  // delay's readiness latency, and, for successful requests, the time taken by
+  // each suspend attempt and by the resume.
+  void GenerateSuspendTraceMetrics(
+      const policy::SuspendTrace::Request& request);
+
   // Generates UMA metrics on when leaving the idle state.
   void GenerateUserActivityMetrics();
 
@@ -550,6 +550,85 @@ TEST_F(MetricsCollectorTest, GatherDarkResumeMetrics) {
   collector_.GenerateDarkResumeMetrics(wake_durations, suspend_duration);
 }
 
+TEST_F(MetricsCollectorTest, GatherSuspendTraceMetrics) {
+  Init();
+
+  policy::SuspendTrace::Request request;
+  request.finished = true;
+  request.success = true;
+  const base::TimeDelta kWaitDuration = base::TimeDelta::FromMilliseconds(240);
+  const base::TimeDelta kSuspendDuration = base::TimeDelta::FromSeconds(2);
+  const base::TimeDelta kFinishDuration =
+      base::TimeDelta::FromMilliseconds(87);
+  const std::vector<std::pair<policy::SuspendTrace::Phase, base::TimeDelta>>
+      kSpans = {
+          {policy::SuspendTrace::Phase::PREPARE,
+           base::TimeDelta::FromMilliseconds(5)},
+          {policy::SuspendTrace::Phase::WAIT_FOR_DELAYS, kWaitDuration},
+          {policy::SuspendTrace::Phase::SUSPEND, kSuspendDuration},
+          {policy::SuspendTrace::Phase::FINISH, kFinishDuration},
+      };
+  for (const auto& it : kSpans) {
+    policy::SuspendTrace::Span span;
+    span.phase = it.first;
+    span.duration = it.second;
+    request.spans.push_back(span);
+  }
+  policy::SuspendTrace::DelayLatency delay;
+  delay.latency = base::TimeDelta::FromMilliseconds(180);
+  request.delays.push_back(delay);
+  policy::SuspendTrace::DelayLatency dark_delay;
+  dark_delay.latency = base::TimeDelta::FromMilliseconds(1200);
+  request.dark_delays.push_back(dark_delay);
+
+  ExpectMetric(kSuspendDelayWaitMsName,
+               kWaitDuration.InMilliseconds(),
+               kSuspendDelayMsMin,
+               kSuspendDelayMsMax,
+               kDefaultBuckets);
+  ExpectMetric(kSuspendAttemptDurationMsName,
+               kSuspendDuration.InMilliseconds(),
+               kSuspendAttemptDurationMsMin,
+               kSuspendAttemptDurationMsMax,
+               kDefaultBuckets);
+  ExpectMetric(kSuspendFinishDurationMsName,
+               kFinishDuration.InMilliseconds(),
+               kSuspendFinishDurationMsMin,
+               kSuspendFinishDurationMsMax,
+               kDefaultBuckets);
+  ExpectMetric(kSuspendReadinessLatencyMsName,
+               delay.latency.InMilliseconds(),
+               kSuspendDelayMsMin,
+               kSuspendDelayMsMax,
+               kDefaultBuckets);
+  ExpectMetric(kDarkSuspendReadinessLatencyMsName,
+               dark_delay.latency.InMilliseconds(),
+               kSuspendDelayMsMin,
+               kSuspendDelayMsMax,
+               kDefaultBuckets);
+  collector_.GenerateSuspendTraceMetrics(request);
+
+  // Only the delay metrics should be sent for unsuccessful requests.
+  Mock::VerifyAndClearExpectations(metrics_lib_);
+  request.success = false;
+  ExpectMetric(kSuspendDelayWaitMsName,
+               kWaitDuration.InMilliseconds(),
+               kSuspendDelayMsMin,
+               kSuspendDelayMsMax,
+               kDefaultBuckets);
+  ExpectMetric(kSuspendReadinessLatencyMsName,
+               delay.latency.InMilliseconds(),
+               kSuspendDelayMsMin,
+               kSuspendDelayMsMax,
+               kDefaultBuckets);
+  ExpectMetric(kDarkSuspendReadinessLatencyMsName,
+               dark_delay.latency.InMilliseconds(),
+               kSuspendDelayMsMin,
+               kSuspendDelayMsMax,
+               kDefaultBuckets);
+  collector_.GenerateSuspendTraceMetrics(request);
+}
+
 TEST_F(MetricsCollectorTest, BatteryDischargeRateWhileSuspended) {
   const double kEnergyBeforeSuspend = 60;
   const double kEnergyAfterResume = 50;
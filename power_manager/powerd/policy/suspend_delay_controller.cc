@@ -14,6 +14,7 @@
 #include <base/strings/string_number_conversions.h>
 #include <chromeos/dbus/service_constants.h>
 
+#include "power_manager/common/clock.h"
 #include "power_manager/common/util.h"
 #include "power_manager/powerd/policy/suspend_delay_observer.h"
 #include "power_manager/proto_bindings/suspend.pb.h"
@@ -33,7 +34,8 @@ SuspendDelayController::SuspendDelayController(int initial_delay_id,
                                                const std::string& description)
     : description_(description),
       next_delay_id_(initial_delay_id),
-      current_suspend_id_(0) {}
+      current_suspend_id_(0),
+      clock_(new Clock) {}
 
 SuspendDelayController::~SuspendDelayController() {}
 
@@ -104,6 +106,7 @@ void SuspendDelayController::HandleSuspendReadiness(
                  << ", which we weren't waiting for";
     return;
   }
+  RecordReadinessLatency(delay_id, false);
   RemoveDelayFromWaitList(delay_id);
 }
 
@@ -129,6 +132,8 @@ void SuspendDelayController::HandleDBusClientDisconnected(
 
 void SuspendDelayController::PrepareForSuspend(int suspend_id) {
   current_suspend_id_ = suspend_id;
+  suspend_start_time_ = clock_->GetCurrentTime();
+  readiness_latencies_.clear();
 
   size_t old_count = delay_ids_being_waited_on_.size();
   delay_ids_being_waited_on_.clear();
@@ -177,6 +182,20 @@ std::string SuspendDelayController::GetDelayDescription(int delay_id) const {
   return it != registered_delays_.end() ? it->second.description : "unknown";
 }
 
+void SuspendDelayController::RecordReadinessLatency(int delay_id,
+                                                    bool timed_out) {
+  SuspendTrace::DelayLatency latency;
+  latency.delay_id = delay_id;
+  DelayInfoMap::const_iterator it = registered_delays_.find(delay_id);
+  if (it != registered_delays_.end()) {
+    latency.description = it->second.description;
+    latency.dbus_client = it->second.dbus_client;
+  }
+  latency.latency = clock_->GetCurrentTime() - suspend_start_time_;
+  latency.timed_out = timed_out;
+  readiness_latencies_.push_back(latency);
+}
+
 void SuspendDelayController::UnregisterDelayInternal(int delay_id) {
   if (!registered_delays_.count(delay_id)) {
     LOG(WARNING) << "Ignoring request to remove unknown " << GetLogDescription()
@@ -208,6 +227,7 @@ void SuspendDelayController::OnDelayExpiration() {
       tardy_delays += ", ";
     tardy_delays += base::IntToString(*it) + " (" + delay.dbus_client + ": " +
                     delay.description + ")";
+    RecordReadinessLatency(*it, true);
   }
   LOG(WARNING) << "Timed out while waiting for " << GetLogDescription()
                << " request " << current_suspend_id_
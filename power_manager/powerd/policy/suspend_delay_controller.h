@@ -6,16 +6,21 @@
 #define POWER_MANAGER_POWERD_POLICY_SUSPEND_DELAY_CONTROLLER_H_
 
 #include <map>
+#include <memory>
 #include <set>
 #include <string>
+#include <vector>
 
 #include <base/macros.h>
 #include <base/observer_list.h>
 #include <base/time/time.h>
 #include <base/timer/timer.h>
 
+#include "power_manager/powerd/policy/suspend_trace.h"
+
 namespace power_manager {
 
+class Clock;
 class RegisterSuspendDelayReply;
 class RegisterSuspendDelayRequest;
 class SuspendReadinessInfo;
@@ -34,6 +39,15 @@ class SuspendDelayController {
 
   bool ready_for_suspend() const { return delay_ids_being_waited_on_.empty(); }
 
+  // Latencies of the delays that have reported readiness or timed out during
+  // the current (or most-recent) suspend request, in the order that they did
+  // so.
+  const std::vector<SuspendTrace::DelayLatency>& readiness_latencies() const {
+    return readiness_latencies_;
+  }
+
+  Clock* clock_for_testing() { return clock_.get(); }
+
   // Adds or removes an observer that will be notified when it's safe to
   // suspend.
   void AddObserver(SuspendDelayObserver* observer);
@@ -89,6 +103,10 @@ class SuspendDelayController {
   // Returns the human-readable description of |delay_id|.
   std::string GetDelayDescription(int delay_id) const;
 
+  // Appends |delay_id|'s time since |suspend_start_time_| to
+  // |readiness_latencies_|.
+  void RecordReadinessLatency(int delay_id, bool timed_out);
+
   // Removes |delay_id| from |registered_delays_| and calls
   // RemoveDelayFromWaitList().
   void UnregisterDelayInternal(int delay_id);
@@ -130,6 +148,14 @@ class SuspendDelayController {
   // suspend.
   std::set<int> delay_ids_being_waited_on_;
 
+  std::unique_ptr<Clock> clock_;
+
+  // Time at which PrepareForSuspend() was last called.
+  base::TimeTicks suspend_start_time_;
+
+  // Latencies recorded since the last PrepareForSuspend() call.
+  std::vector<SuspendTrace::DelayLatency> readiness_latencies_;
+
   // Used to invoke NotifyObservers().
   base::OneShotTimer notify_observers_timer_;
 
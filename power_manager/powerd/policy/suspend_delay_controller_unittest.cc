@@ -9,6 +9,7 @@
 #include <chromeos/dbus/service_constants.h>
 #include <gtest/gtest.h>
 
+#include "power_manager/common/clock.h"
 #include "power_manager/common/test_main_loop_runner.h"
 #include "power_manager/powerd/policy/suspend_delay_observer.h"
 #include "power_manager/proto_bindings/suspend.pb.h"
@@ -315,5 +316,48 @@ TEST_F(SuspendDelayControllerTest, MultipleDelays) {
   EXPECT_TRUE(controller_.ready_for_suspend());
 }
 
+TEST_F(SuspendDelayControllerTest, ReadinessLatencies) {
+  // Register a delay that reports readiness and one that times out.
+  const std::string kClient1 = "client1";
+  int delay_id1 =
+      RegisterSuspendDelay(base::TimeDelta::FromMilliseconds(8), kClient1);
+  const std::string kClient2 = "client2";
+  int delay_id2 =
+      RegisterSuspendDelay(base::TimeDelta::FromMilliseconds(8), kClient2);
+
+  Clock* clock = controller_.clock_for_testing();
+  const base::TimeTicks kStartTime = base::TimeTicks::FromInternalValue(1000);
+  clock->set_current_time_for_testing(kStartTime);
+  const int kSuspendId = 5;
+  controller_.PrepareForSuspend(kSuspendId);
+  EXPECT_TRUE(controller_.readiness_latencies().empty());
+
+  const base::TimeDelta kReadyDelay = base::TimeDelta::FromMilliseconds(3);
+  clock->set_current_time_for_testing(kStartTime + kReadyDelay);
+  HandleSuspendReadiness(delay_id1, kSuspendId, kClient1);
+
+  const base::TimeDelta kTimeoutDelay = base::TimeDelta::FromMilliseconds(8);
+  clock->set_current_time_for_testing(kStartTime + kTimeoutDelay);
+  EXPECT_TRUE(observer_.RunUntilReadyForSuspend());
+
+  const std::vector<SuspendTrace::DelayLatency>& latencies =
+      controller_.readiness_latencies();
+  ASSERT_EQ(2u, latencies.size());
+  EXPECT_EQ(delay_id1, latencies[0].delay_id);
+  EXPECT_EQ(kClient1, latencies[0].dbus_client);
+  EXPECT_EQ(kClient1 + "-desc", latencies[0].description);
+  EXPECT_EQ(kReadyDelay.ToInternalValue(),
+            latencies[0].latency.ToInternalValue());
+  EXPECT_FALSE(latencies[0].timed_out);
+  EXPECT_EQ(delay_id2, latencies[1].delay_id);
+  EXPECT_EQ(kTimeoutDelay.ToInternalValue(),
+            latencies[1].latency.ToInternalValue());
+  EXPECT_TRUE(latencies[1].timed_out);
+
+  // The latencies should be cleared for the next request.
+  controller_.PrepareForSuspend(kSuspendId + 1);
+  EXPECT_TRUE(controller_.readiness_latencies().empty());
+}
+
 }  // namespace policy
 }  // namespace power_manager
@@ -0,0 +1,172 @@
+// Copyright 2016 The Chromium OS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "power_manager/powerd/policy/suspend_trace.h"
+
+#include <stdint.h>
+
+#include <base/format_macros.h>
+#include <base/logging.h>
+#include <base/strings/stringprintf.h>
+
+namespace power_manager {
+namespace policy {
+
+namespace {
+
+// Appends a line describing |latency| to |out|.
+void AppendDelayLatency(const SuspendTrace::DelayLatency& latency,
+                        const char* type,
+                        std::string* out) {
+  base::StringAppendF(out,
+                      "  %s delay %d (%s: %s): %s%" PRId64 " ms\n",
+                      type,
+                      latency.delay_id,
+                      latency.dbus_client.c_str(),
+                      latency.description.c_str(),
+                      latency.timed_out ? "timed out after " : "",
+                      latency.latency.InMilliseconds());
+}
+
+}  // namespace
+
+SuspendTrace::DelayLatency::DelayLatency() : delay_id(0), timed_out(false) {}
+
+SuspendTrace::Request::Request()
+    : suspend_id(0), finished(false), success(false) {}
+
+SuspendTrace::Request::~Request() {}
+
+// static
+std::string SuspendTrace::PhaseToString(Phase phase) {
+  switch (phase) {
+    case Phase::PREPARE:
+      return "prepare";
+    case Phase::WAIT_FOR_DELAYS:
+      return "wait_for_delays";
+    case Phase::SUSPEND:
+      return "suspend";
+    case Phase::WAIT_FOR_DARK_DELAYS:
+      return "wait_for_dark_delays";
+    case Phase::WAIT_TO_RESUSPEND:
+      return "wait_to_resuspend";
+    case Phase::FINISH:
+      return "finish";
+  }
+  NOTREACHED() << "Unhandled phase " << static_cast<int>(phase);
+  return "unknown";
+}
+
+SuspendTrace::SuspendTrace(size_t max_requests)
+    : max_requests_(max_requests), span_open_(false) {
+  DCHECK_GT(max_requests_, 0u);
+}
+
+SuspendTrace::~SuspendTrace() {}
+
+void SuspendTrace::StartRequest(int suspend_id,
+                                base::Time wall_time,
+                                base::TimeTicks now) {
+  if (GetCurrentRequest())
+    FinishRequest(false, now);
+
+  while (requests_.size() >= max_requests_)
+    requests_.pop_front();
+
+  requests_.push_back(Request());
+  Request& request = requests_.back();
+  request.suspend_id = suspend_id;
+  request.start_wall_time = wall_time;
+  request.start = now;
+}
+
+void SuspendTrace::StartPhase(Phase phase, base::TimeTicks now) {
+  Request* request = GetCurrentRequest();
+  if (!request)
+    return;
+
+  EndPhase(now);
+  Span span;
+  span.phase = phase;
+  span.start = now;
+  request->spans.push_back(span);
+  span_open_ = true;
+}
+
+void SuspendTrace::EndPhase(base::TimeTicks now) {
+  Request* request = GetCurrentRequest();
+  if (!request || !span_open_)
+    return;
+
+  Span& span = request->spans.back();
+  span.duration = now - span.start;
+  span_open_ = false;
+}
+
+bool SuspendTrace::GetCurrentPhase(Phase* phase) const {
+  DCHECK(phase);
+  if (!span_open_)
+    return false;
+
+  *phase = requests_.back().spans.back().phase;
+  return true;
+}
+
+void SuspendTrace::AddDelayLatencies(const std::vector<DelayLatency>& latencies,
+                                     bool dark) {
+  Request* request = GetCurrentRequest();
+  if (!request)
+    return;
+
+  std::vector<DelayLatency>* delays =
+      dark ? &request->dark_delays : &request->delays;
+  delays->insert(delays->end(), latencies.begin(), latencies.end());
+}
+
+const SuspendTrace::Request* SuspendTrace::FinishRequest(bool success,
+                                                         base::TimeTicks now) {
+  Request* request = GetCurrentRequest();
+  if (!request)
+    return nullptr;
+
+  EndPhase(now);
+  request->duration = now - request->start;
+  request->finished = true;
+  request->success = success;
+  return request;
+}
+
+std::string SuspendTrace::ToString() const {
+  std::string out;
+  for (const Request& request : requests_) {
+    base::StringAppendF(
+        &out,
+        "request %d at %" PRId64 " (%s): %" PRId64 " ms\n",
+        request.suspend_id,
+        static_cast<int64_t>(request.start_wall_time.ToTimeT()),
+        !request.finished ? "in progress"
+                          : (request.success ? "succeeded" : "failed"),
+        request.duration.InMilliseconds());
+    for (const Span& span : request.spans) {
+      base::StringAppendF(&out,
+                          "  +%" PRId64 " ms %s: %" PRId64 " ms\n",
+                          (span.start - request.start).InMilliseconds(),
+                          PhaseToString(span.phase).c_str(),
+                          span.duration.InMilliseconds());
+    }
+    for (const DelayLatency& latency : request.delays)
+      AppendDelayLatency(latency, "suspend", &out);
+    for (const DelayLatency& latency : request.dark_delays)
+      AppendDelayLatency(latency, "dark suspend", &out);
+  }
+  return out;
+}
+
+SuspendTrace::Request* SuspendTrace::GetCurrentRequest() {
+  return !requests_.empty() && !requests_.back().finished ? &requests_.back()
+                                                          : nullptr;
+}
+
+}  // namespace policy
+}  // namespace power_manager
@@ -0,0 +1,149 @@
+// Copyright 2016 The Chromium OS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef POWER_MANAGER_POWERD_POLICY_SUSPEND_TRACE_H_
+#define POWER_MANAGER_POWERD_POLICY_SUSPEND_TRACE_H_
+
+#include <stddef.h>
+
+#include <deque>
+#include <string>
+#include <vector>
+
+#include <base/macros.h>
+#include <base/time/time.h>
+
+namespace power_manager {
+namespace policy {
+
+// Records how long each phase of recent suspend requests took, along with how
+// long each client that registered a suspend delay took to report readiness.
+//
+// Times are taken from the monotonic clock, which doesn't advance while the
+// system is suspended. The duration of a Phase::SUSPEND span is thus the time
+// spent entering and leaving suspend rather than the time spent asleep.
+class SuspendTrace {
+ public:
+  // Phases of a suspend request, in the order that they usually occur.
+  enum class Phase {
+    // Suspender::Delegate::PrepareToSuspend() is running.
+    PREPARE = 0,
+    // SuspendImminent has been emitted and powerd is waiting for clients that
+    // registered suspend delays to report readiness.
+    WAIT_FOR_DELAYS,
+    // Suspender::Delegate::DoSuspend() is running.
+    SUSPEND,
+    // The system is in dark resume and DarkSuspendImminent has been emitted;
+    // powerd is waiting for dark suspend delays.
+    WAIT_FOR_DARK_DELAYS,
+    // powerd is waiting to retry a failed attempt or to resuspend from a dark
+    // resume that wasn't announced to clients.
+    WAIT_TO_RESUSPEND,
+    // The request is being completed and preparations are being undone.
+    FINISH,
+  };
+
+  // A contiguous period spent in a single phase.
+  struct Span {
+    Phase phase;
+    base::TimeTicks start;
+    base::TimeDelta duration;
+  };
+
+  // The time taken by a single suspend delay to report readiness.
+  struct DelayLatency {
+    DelayLatency();
+
+    int delay_id;
+    std::string description;
+    std::string dbus_client;
+
+    // Time between the suspend request being announced and the client's
+    // HandleSuspendReadiness call, or until the delay timed out.
+    base::TimeDelta latency;
+    bool timed_out;
+  };
+
+  // Everything recorded for a single suspend request.
+  struct Request {
+    Request();
+    ~Request();
+
+    int suspend_id;
+    base::Time start_wall_time;
+    base::TimeTicks start;
+
+    // Time between the start of the request and its completion.
+    base::TimeDelta duration;
+
+    // True once the request has been completed.
+    bool finished;
+
+    // True if the request ended with the system resuming successfully.
+    bool success;
+
+    std::vector<Span> spans;
+
+    // Latencies of regular suspend delays and of the dark suspend delays from
+    // all of the request's dark resumes.
+    std::vector<DelayLatency> delays;
+    std::vector<DelayLatency> dark_delays;
+  };
+
+  // Returns a short lowercase name for |phase|, e.g. "wait_for_delays".
+  static std::string PhaseToString(Phase phase);
+
+  // |max_requests| is the number of requests that are retained.
+  explicit SuspendTrace(size_t max_requests);
+  ~SuspendTrace();
+
+  // Returns the retained requests, oldest first. The last request may still be
+  // in progress.
+  const std::deque<Request>& requests() const { return requests_; }
+
+  // Starts recording a new request. An in-progress request is finished
+  // unsuccessfully first. The oldest request is discarded if the trace is full.
+  void StartRequest(int suspend_id, base::Time wall_time, base::TimeTicks now);
+
+  // Ends the current span, if any, and starts a new one for |phase|. Does
+  // nothing if no request is in progress.
+  void StartPhase(Phase phase, base::TimeTicks now);
+
+  // Ends the current span, if any.
+  void EndPhase(base::TimeTicks now);
+
+  // Returns true and copies the current span's phase to |phase| if a span is
+  // in progress.
+  bool GetCurrentPhase(Phase* phase) const;
+
+  // Appends |latencies| to the current request's regular or dark delays.
+  void AddDelayLatencies(const std::vector<DelayLatency>& latencies,
+                         bool dark);
+
+  // Ends the current span and completes the current request. Returns the
+  // completed request, or null if no request was in progress.
+  const Request* FinishRequest(bool success, base::TimeTicks now);
+
+  // Returns a human-readable dump of the retained requests.
+  std::string ToString() const;
+
+ private:
+  // Returns the request currently in progress, or null if there isn't one.
+  Request* GetCurrentRequest();
+
+  // Maximum size of |requests_|.
+  const size_t max_requests_;
+
+  std::deque<Request> requests_;
+
+  // True if the current span in the last request hasn't ended yet.
+  bool span_open_;
+
+  DISALLOW_COPY_AND_ASSIGN(SuspendTrace);
+};
+
+}  // namespace policy
+}  // namespace power_manager
+
+#endif  // POWER_MANAGER_POWERD_POLICY_SUSPEND_TRACE_H_
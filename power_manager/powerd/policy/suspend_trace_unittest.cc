@@ -0,0 +1,113 @@
+// Copyright 2016 The Chromium OS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "power_manager/powerd/policy/suspend_trace.h"
+
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+#include <base/time/time.h>
+#include <gtest/gtest.h>
+
+namespace power_manager {
+namespace policy {
+
+namespace {
+
+// Returns a monotonic time |ms| milliseconds after an arbitrary base time.
+base::TimeTicks TimeAt(int64_t ms) {
+  return base::TimeTicks::FromInternalValue(1000) +
+         base::TimeDelta::FromMilliseconds(ms);
+}
+
+}  // namespace
+
+TEST(SuspendTraceTest, RecordPhases) {
+  SuspendTrace trace(5);
+  EXPECT_TRUE(trace.requests().empty());
+
+  // Phases shouldn't be recorded while no request is in progress.
+  trace.StartPhase(SuspendTrace::Phase::PREPARE, TimeAt(0));
+  EXPECT_TRUE(trace.requests().empty());
+  EXPECT_FALSE(trace.FinishRequest(true, TimeAt(0)));
+
+  trace.StartRequest(3, base::Time(), TimeAt(0));
+  trace.StartPhase(SuspendTrace::Phase::PREPARE, TimeAt(0));
+  trace.StartPhase(SuspendTrace::Phase::WAIT_FOR_DELAYS, TimeAt(10));
+  SuspendTrace::Phase phase = SuspendTrace::Phase::PREPARE;
+  EXPECT_TRUE(trace.GetCurrentPhase(&phase));
+  EXPECT_EQ(SuspendTrace::Phase::WAIT_FOR_DELAYS, phase);
+
+  SuspendTrace::DelayLatency latency;
+  latency.delay_id = 7;
+  latency.description = "chrome";
+  latency.dbus_client = ":1.5";
+  latency.latency = base::TimeDelta::FromMilliseconds(90);
+  trace.AddDelayLatencies(std::vector<SuspendTrace::DelayLatency>(1, latency),
+                          false);
+  trace.StartPhase(SuspendTrace::Phase::SUSPEND, TimeAt(100));
+  trace.StartPhase(SuspendTrace::Phase::FINISH, TimeAt(400));
+
+  const SuspendTrace::Request* request = trace.FinishRequest(true, TimeAt(450));
+  ASSERT_TRUE(request);
+  EXPECT_FALSE(trace.GetCurrentPhase(&phase));
+  EXPECT_EQ(3, request->suspend_id);
+  EXPECT_TRUE(request->finished);
+  EXPECT_TRUE(request->success);
+  EXPECT_EQ(450, request->duration.InMilliseconds());
+
+  ASSERT_EQ(4u, request->spans.size());
+  EXPECT_EQ(SuspendTrace::Phase::PREPARE, request->spans[0].phase);
+  EXPECT_EQ(10, request->spans[0].duration.InMilliseconds());
+  EXPECT_EQ(SuspendTrace::Phase::WAIT_FOR_DELAYS, request->spans[1].phase);
+  EXPECT_EQ(90, request->spans[1].duration.InMilliseconds());
+  EXPECT_EQ(SuspendTrace::Phase::SUSPEND, request->spans[2].phase);
+  EXPECT_EQ(300, request->spans[2].duration.InMilliseconds());
+  EXPECT_EQ(SuspendTrace::Phase::FINISH, request->spans[3].phase);
+  EXPECT_EQ(50, request->spans[3].duration.InMilliseconds());
+
+  ASSERT_EQ(1u, request->delays.size());
+  EXPECT_EQ(7, request->delays[0].delay_id);
+  EXPECT_TRUE(request->dark_delays.empty());
+
+  // Spot-check the dump.
+  const std::string dump = trace.ToString();
+  EXPECT_NE(std::string::npos, dump.find("request 3 at 0 (succeeded): 450 ms"))
+      << dump;
+  EXPECT_NE(std::string::npos, dump.find("+100 ms suspend: 300 ms")) << dump;
+  EXPECT_NE(std::string::npos,
+            dump.find("suspend delay 7 (:1.5: chrome): 90 ms"))
+      << dump;
+}
+
+TEST(SuspendTraceTest, DropOldestRequests) {
+  const size_t kMaxRequests = 3;
+  SuspendTrace trace(kMaxRequests);
+  for (int i = 1; i <= 5; ++i) {
+    trace.StartRequest(i, base::Time(), TimeAt(i * 100));
+    trace.StartPhase(SuspendTrace::Phase::PREPARE, TimeAt(i * 100));
+    trace.FinishRequest(true, TimeAt(i * 100 + 10));
+  }
+  ASSERT_EQ(kMaxRequests, trace.requests().size());
+  EXPECT_EQ(3, trace.requests()[0].suspend_id);
+  EXPECT_EQ(5, trace.requests()[2].suspend_id);
+
+  // Starting a new request should finish an abandoned one unsuccessfully.
+  trace.StartRequest(6, base::Time(), TimeAt(600));
+  trace.StartPhase(SuspendTrace::Phase::WAIT_FOR_DELAYS, TimeAt(600));
+  trace.StartRequest(7, base::Time(), TimeAt(700));
+  ASSERT_EQ(kMaxRequests, trace.requests().size());
+  const SuspendTrace::Request& abandoned = trace.requests()[1];
+  EXPECT_EQ(6, abandoned.suspend_id);
+  EXPECT_TRUE(abandoned.finished);
+  EXPECT_FALSE(abandoned.success);
+  ASSERT_EQ(1u, abandoned.spans.size());
+  EXPECT_EQ(100, abandoned.spans[0].duration.InMilliseconds());
+  EXPECT_FALSE(trace.requests()[2].finished);
+}
+
+}  // namespace policy
+}  // namespace power_manager
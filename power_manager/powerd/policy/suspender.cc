@@ -25,6 +25,9 @@ namespace {
 // Default wake reason powerd uses to report wake-reason-specific wake duration
 // metrics.
 const char kDefaultWakeReason[] = "Other";
+
+// Number of suspend requests retained in Suspender's trace.
+const size_t kMaxTracedRequests = 20;
 }  // namespace
 
 namespace power_manager {
@@ -36,6 +39,10 @@ void Suspender::TestApi::SetCurrentWallTime(base::Time wall_time) {
   suspender_->clock_->set_current_wall_time_for_testing(wall_time);
 }
 
+void Suspender::TestApi::SetCurrentTime(base::TimeTicks now) {
+  suspender_->clock_->set_current_time_for_testing(now);
+}
+
 bool Suspender::TestApi::TriggerResuspendTimeout() {
   if (!suspender_->resuspend_timer_.IsRunning())
     return false;
@@ -66,7 +73,8 @@ Suspender::Suspender()
       max_retries_(0),
       current_num_attempts_(0),
       initial_num_attempts_(0),
-      last_dark_resume_wake_reason_(kDefaultWakeReason) {}
+      last_dark_resume_wake_reason_(kDefaultWakeReason),
+      trace_(kMaxTracedRequests) {}
 
 Suspender::~Suspender() {}
 
@@ -202,6 +210,16 @@ void Suspender::RecordDarkResumeWakeReason(
   response_sender.Run(dbus::Response::FromMethodCall(method_call));
 }
 
+void Suspender::GetSuspendTrace(
+    dbus::MethodCall* method_call,
+    dbus::ExportedObject::ResponseSender response_sender) {
+  std::unique_ptr<dbus::Response> response =
+      dbus::Response::FromMethodCall(method_call);
+  dbus::MessageWriter writer(response.get());
+  writer.AppendString(trace_.ToString());
+  response_sender.Run(std::move(response));
+}
+
 void Suspender::HandleLidOpened() {
   HandleEvent(Event::USER_ACTIVITY);
 }
@@ -415,10 +433,15 @@ void Suspender::StartRequest() {
   dark_resume_wake_durations_.clear();
   last_dark_resume_wake_reason_ = kDefaultWakeReason;
 
+  trace_.StartRequest(suspend_request_id_, suspend_request_start_time_,
+                      clock_->GetCurrentTime());
+  StartTracePhase(SuspendTrace::Phase::PREPARE);
+
   // Call PrepareToSuspend() before emitting SuspendImminent -- powerd needs to
   // set the backlight level to 0 before Chrome turns the display on in response
   // to the signal.
   delegate_->PrepareToSuspend();
+  StartTracePhase(SuspendTrace::Phase::WAIT_FOR_DELAYS);
   suspend_delay_controller_->PrepareForSuspend(suspend_request_id_);
   dark_resume_->PrepareForSuspendRequest();
   delegate_->SetSuspendAnnounced(true);
@@ -428,6 +451,7 @@ void Suspender::StartRequest() {
 void Suspender::FinishRequest(bool success) {
   LOG(INFO) << "Finishing request " << suspend_request_id_ << " "
             << (success ? "" : "un") << "successfully";
+  StartTracePhase(SuspendTrace::Phase::FINISH);
   resuspend_timer_.Stop();
   suspend_delay_controller_->FinishSuspend(suspend_request_id_);
   dark_suspend_delay_controller_->FinishSuspend(dark_suspend_id_);
@@ -448,6 +472,7 @@ void Suspender::FinishRequest(bool success) {
                                          suspend_duration);
   }
   dark_resume_->UndoPrepareForSuspendRequest();
+  FinishTrace(success);
 }
 
 Suspender::State Suspender::Suspend() {
@@ -458,6 +483,7 @@ Suspender::State Suspender::Suspend() {
     case system::DarkResumeInterface::Action::SHUT_DOWN:
       LOG(INFO) << "Shutting down from dark resume";
       // Don't call FinishRequest(); we want the backlight to stay off.
+      FinishTrace(false);
       delegate_->ShutDownForDarkResume();
       return State::SHUTTING_DOWN;
     case system::DarkResumeInterface::Action::SUSPEND:
@@ -502,6 +528,7 @@ Suspender::State Suspender::Suspend() {
                  clock_->GetCurrentWallTime() - dark_resume_start_time_);
   }
   current_num_attempts_++;
+  StartTracePhase(SuspendTrace::Phase::SUSPEND);
   const Delegate::SuspendResult result =
       delegate_->DoSuspend(wakeup_count_, wakeup_count_valid_, duration);
 
@@ -566,11 +593,13 @@ Suspender::State Suspender::Suspend() {
     if (dark_resume_->CanSafelyExitDarkResume()) {
       LOG(INFO) << "Notifying registered dark suspend delays about "
                 << dark_suspend_id_;
+      StartTracePhase(SuspendTrace::Phase::WAIT_FOR_DARK_DELAYS);
       dark_suspend_delay_controller_->PrepareForSuspend(dark_suspend_id_);
       EmitDarkSuspendImminentSignal(dark_suspend_id_);
     } else {
       wakeup_count_ = 0;
       wakeup_count_valid_ = false;
+      StartTracePhase(SuspendTrace::Phase::WAIT_TO_RESUSPEND);
       ScheduleResuspend(result == Delegate::SuspendResult::SUCCESS
                             ? base::TimeDelta()
                             : retry_delay_);
@@ -587,6 +616,7 @@ Suspender::State Suspender::Suspend() {
     LOG(ERROR) << "Unsuccessfully attempted to suspend "
                << current_num_attempts_ << " times; shutting down";
     // Don't call FinishRequest(); we want the backlight to stay off.
+    FinishTrace(false);
     delegate_->ShutDownForFailedSuspend();
     return State::SHUTTING_DOWN;
   }
@@ -595,10 +625,40 @@ Suspender::State Suspender::Suspend() {
                << "will retry in " << retry_delay_.InMilliseconds() << " ms";
   if (!suspend_request_supplied_wakeup_count_)
     wakeup_count_valid_ = delegate_->ReadSuspendWakeupCount(&wakeup_count_);
+  StartTracePhase(SuspendTrace::Phase::WAIT_TO_RESUSPEND);
   ScheduleResuspend(retry_delay_);
   return State::WAITING_TO_RESUSPEND;
 }
 
+void Suspender::StartTracePhase(SuspendTrace::Phase phase) {
+  RecordDelayLatencies();
+  trace_.StartPhase(phase, clock_->GetCurrentTime());
+}
+
+void Suspender::FinishTrace(bool success) {
+  RecordDelayLatencies();
+  const SuspendTrace::Request* request =
+      trace_.FinishRequest(success, clock_->GetCurrentTime());
+  if (request)
+    delegate_->GenerateSuspendTraceMetrics(*request);
+}
+
+void Suspender::RecordDelayLatencies() {
+  // Each wait is recorded when the phase that it belongs to ends, so that the
+  // latencies are captured even if the request is aborted mid-wait.
+  SuspendTrace::Phase phase;
+  if (!trace_.GetCurrentPhase(&phase))
+    return;
+
+  if (phase == SuspendTrace::Phase::WAIT_FOR_DELAYS) {
+    trace_.AddDelayLatencies(suspend_delay_controller_->readiness_latencies(),
+                             false);
+  } else if (phase == SuspendTrace::Phase::WAIT_FOR_DARK_DELAYS) {
+    trace_.AddDelayLatencies(
+        dark_suspend_delay_controller_->readiness_latencies(), true);
+  }
+}
+
 void Suspender::ScheduleResuspend(const base::TimeDelta& delay) {
   resuspend_timer_.Start(FROM_HERE,
                          delay,
@@ -21,6 +21,7 @@
 #include <dbus/message.h>
 
 #include "power_manager/powerd/policy/suspend_delay_observer.h"
+#include "power_manager/powerd/policy/suspend_trace.h"
 #include "power_manager/proto_bindings/suspend.pb.h"
 
 namespace power_manager {
@@ -71,6 +72,9 @@ class SuspendDelayController;
 //
 // At any point before Suspend() has been called, user activity can cancel the
 // current suspend attempt.
+//
+// The timing of each phase of recent requests is recorded in a SuspendTrace,
+// which can be dumped via D-Bus.
 class Suspender : public SuspendDelayObserver {
  public:
   // Information about dark resumes used for histograms.
@@ -154,6 +158,10 @@ class Suspender : public SuspendDelayObserver {
         const std::vector<DarkResumeInfo>& dark_resume_wake_durations,
         base::TimeDelta suspend_duration_) = 0;
 
+    // Generates and reports latency metrics for a completed request.
+    virtual void GenerateSuspendTraceMetrics(
+        const SuspendTrace::Request& request) = 0;
+
     // Shuts the system down in response to repeated failed suspend attempts.
     virtual void ShutDownForFailedSuspend() = 0;
 
@@ -180,6 +188,9 @@ class Suspender : public SuspendDelayObserver {
     // Sets the time used as "now".
     void SetCurrentWallTime(base::Time wall_time);
 
+    // Sets the monotonic time used as "now" for |trace_|.
+    void SetCurrentTime(base::TimeTicks now);
+
     // Runs Suspender::HandleEvent(EVENT_READY_TO_RESUSPEND) if
     // |resuspend_timer_| is running. Returns false otherwise.
     bool TriggerResuspendTimeout();
@@ -199,6 +210,8 @@ class Suspender : public SuspendDelayObserver {
   Suspender();
   virtual ~Suspender();
 
+  const SuspendTrace& trace() const { return trace_; }
+
   void Init(Delegate* delegate,
             system::DBusWrapperInterface* dbus_wrapper,
             system::DarkResumeInterface* dark_resume,
@@ -237,6 +250,8 @@ class Suspender : public SuspendDelayObserver {
   void RecordDarkResumeWakeReason(
       dbus::MethodCall* method_call,
       dbus::ExportedObject::ResponseSender response_sender);
+  void GetSuspendTrace(dbus::MethodCall* method_call,
+                       dbus::ExportedObject::ResponseSender response_sender);
 
   // Handles the lid being opened, user activity, or the system shutting down,
   // any of which may abort an in-progress suspend attempt.
@@ -314,6 +329,17 @@ class Suspender : public SuspendDelayObserver {
   // performing any work needed to put the system into this state.
   State Suspend();
 
+  // Starts |phase| in |trace_|, first recording the readiness latencies of
+  // the suspend delays that powerd was waiting for, if any.
+  void StartTracePhase(SuspendTrace::Phase phase);
+
+  // Completes the current request in |trace_| and reports its metrics.
+  void FinishTrace(bool success);
+
+  // Copies the latencies from the delay controller that |trace_|'s current
+  // phase was waiting on, if any, into |trace_|.
+  void RecordDelayLatencies();
+
   // Starts |resuspend_timer_| to send EVENT_READY_TO_RESUSPEND after |delay|.
   void ScheduleResuspend(const base::TimeDelta& delay);
 
@@ -398,6 +424,9 @@ class Suspender : public SuspendDelayObserver {
   // Runs HandleEvent(EVENT_READY_TO_RESUSPEND).
   base::OneShotTimer resuspend_timer_;
 
+  // Timing of recent suspend requests.
+  SuspendTrace trace_;
+
   DISALLOW_COPY_AND_ASSIGN(Suspender);
 };
 
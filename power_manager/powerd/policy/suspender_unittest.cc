@@ -45,7 +45,8 @@ class TestDelegate : public Suspender::Delegate, public ActionRecorder {
         suspend_wakeup_count_valid_(false),
         suspend_was_successful_(false),
         num_suspend_attempts_(0),
-        suspend_canceled_while_in_dark_resume_(false) {}
+        suspend_canceled_while_in_dark_resume_(false),
+        num_traced_requests_(0) {}
 
   void set_lid_closed(bool closed) { lid_closed_ = closed; }
   void set_report_success_for_read_wakeup_count(bool success) {
@@ -83,6 +84,10 @@ class TestDelegate : public Suspender::Delegate, public ActionRecorder {
   base::TimeDelta last_suspend_duration() const {
     return last_suspend_duration_;
   }
+  int num_traced_requests() const { return num_traced_requests_; }
+  const SuspendTrace::Request& last_traced_request() const {
+    return last_traced_request_;
+  }
 
   // Delegate implementation:
   int GetInitialSuspendId() override { return 1; }
@@ -134,6 +139,14 @@ class TestDelegate : public Suspender::Delegate, public ActionRecorder {
     last_suspend_duration_ = suspend_duration;
   }
 
+  // This isn't recorded as an action since it accompanies every completed
+  // request.
+  void GenerateSuspendTraceMetrics(
+      const SuspendTrace::Request& request) override {
+    num_traced_requests_++;
+    last_traced_request_ = request;
+  }
+
   void ShutDownForFailedSuspend() override {
     AppendAction(kShutDown);
     RunAndResetCallback(&shutdown_callback_);
@@ -192,6 +205,11 @@ class TestDelegate : public Suspender::Delegate, public ActionRecorder {
   std::vector<Suspender::DarkResumeInfo> dark_resume_wake_durations_;
   base::TimeDelta last_suspend_duration_;
 
+  // Number of GenerateSuspendTraceMetrics() calls and the request passed to
+  // the last one.
+  int num_traced_requests_;
+  SuspendTrace::Request last_traced_request_;
+
   DISALLOW_COPY_AND_ASSIGN(TestDelegate);
 };
 
@@ -323,6 +341,60 @@ TEST_F(SuspenderTest, SuspendResume) {
   EXPECT_FALSE(test_api_.TriggerResuspendTimeout());
 }
 
+// Tests that the time spent in each phase of a request is traced.
+TEST_F(SuspenderTest, TraceSuspendPhases) {
+  Init();
+  const base::TimeTicks kRequestTime = base::TimeTicks::FromInternalValue(1000);
+  test_api_.SetCurrentTime(kRequestTime);
+  suspender_.RequestSuspend();
+  const int suspend_id = test_api_.suspend_id();
+  EXPECT_EQ(0, delegate_.num_traced_requests());
+
+  // Make the delays take 200 ms to become ready and the suspend attempt take
+  // another 50 ms.
+  const base::TimeDelta kDelayDuration = base::TimeDelta::FromMilliseconds(200);
+  test_api_.SetCurrentTime(kRequestTime + kDelayDuration);
+  const base::TimeDelta kSuspendDuration =
+      base::TimeDelta::FromMilliseconds(50);
+  delegate_.set_suspend_callback(
+      base::Bind(&Suspender::TestApi::SetCurrentTime,
+                 base::Unretained(&test_api_),
+                 kRequestTime + kDelayDuration + kSuspendDuration));
+  AnnounceReadyForSuspend(suspend_id);
+  EXPECT_EQ(JoinActions(kSuspend, kUnprepare, NULL), delegate_.GetActions());
+
+  ASSERT_EQ(1u, suspender_.trace().requests().size());
+  const SuspendTrace::Request& request = suspender_.trace().requests()[0];
+  EXPECT_EQ(suspend_id, request.suspend_id);
+  EXPECT_TRUE(request.finished);
+  EXPECT_TRUE(request.success);
+  EXPECT_EQ((kDelayDuration + kSuspendDuration).ToInternalValue(),
+            request.duration.ToInternalValue());
+
+  ASSERT_EQ(4u, request.spans.size());
+  EXPECT_EQ(SuspendTrace::Phase::PREPARE, request.spans[0].phase);
+  EXPECT_EQ(SuspendTrace::Phase::WAIT_FOR_DELAYS, request.spans[1].phase);
+  EXPECT_EQ(kDelayDuration.ToInternalValue(),
+            request.spans[1].duration.ToInternalValue());
+  EXPECT_EQ(SuspendTrace::Phase::SUSPEND, request.spans[2].phase);
+  EXPECT_EQ(kSuspendDuration.ToInternalValue(),
+            request.spans[2].duration.ToInternalValue());
+  EXPECT_EQ(SuspendTrace::Phase::FINISH, request.spans[3].phase);
+
+  // Metrics should be reported for the completed request.
+  EXPECT_EQ(1, delegate_.num_traced_requests());
+  EXPECT_EQ(suspend_id, delegate_.last_traced_request().suspend_id);
+
+  // A canceled request should also be traced.
+  suspender_.RequestSuspend();
+  suspender_.HandleUserActivity();
+  ASSERT_EQ(2u, suspender_.trace().requests().size());
+  EXPECT_FALSE(suspender_.trace().requests()[1].success);
+  EXPECT_EQ(SuspendTrace::Phase::WAIT_FOR_DELAYS,
+            suspender_.trace().requests()[1].spans[1].phase);
+  EXPECT_EQ(2, delegate_.num_traced_requests());
+}
+
 // Tests that Suspender doesn't pass a wakeup count to the delegate when it was
 // unable to fetch one.
 TEST_F(SuspenderTest, MissingWakeupCount) {
@@ -10,6 +10,7 @@
 #include <cerrno>
 #include <cmath>
 #include <cstring>
+#include <utility>
 
 #include <base/bind.h>
 #include <base/files/file_enumerator.h>
@@ -31,17 +32,40 @@ namespace {
 const base::FilePath::CharType kDefaultDeviceListPath[] =
     FILE_PATH_LITERAL("/sys/bus/iio/devices");
 
-// Default interval for polling the ambient light sensor.
-const int kDefaultPollIntervalMs = 1000;
+// Default path examined for IIO device nodes.
+const base::FilePath::CharType kDefaultDeviceNodeDir[] =
+    FILE_PATH_LITERAL("/dev");
+
+// Reads a floating-point sysfs attribute from |path| into |value|. Returns
+// false if the file is missing or malformed.
+bool ReadDoubleFile(const base::FilePath& path, double* value) {
+  std::string data;
+  if (!base::ReadFileToString(path, &data))
+    return false;
+  base::TrimWhitespaceASCII(data, base::TRIM_ALL, &data);
+  return base::StringToDouble(data, value);
+}
 
 }  // namespace
 
+AmbientLightSensor::Stats::Stats()
+    : polls(0), buffer_wakeups(0), buffer_samples(0) {}
+
+const int AmbientLightSensor::kDefaultPollIntervalMs = 1000;
 const int AmbientLightSensor::kNumInitAttemptsBeforeLogging = 5;
 const int AmbientLightSensor::kNumInitAttemptsBeforeGivingUp = 20;
+const int AmbientLightSensor::kBufferLength = 16;
+const int AmbientLightSensor::kBufferWatermark = 1;
 
 AmbientLightSensor::AmbientLightSensor()
     : device_list_path_(kDefaultDeviceListPath),
+      device_node_dir_(kDefaultDeviceNodeDir),
+      apply_scale_(false),
+      scale_(1.0),
+      offset_(0.0),
+      tried_buffer_(false),
       poll_interval_ms_(kDefaultPollIntervalMs),
+      sampling_frequency_(1000.0 / kDefaultPollIntervalMs),
       lux_value_(-1),
       num_init_attempts_(0) {}
 
@@ -73,6 +97,30 @@ int AmbientLightSensor::GetAmbientLightLux() {
   return lux_value_;
 }
 
+void AmbientLightSensor::OnFileCanReadWithoutBlocking(int fd) {
+  DCHECK(buffer_);
+  DCHECK_EQ(fd, buffer_->fd());
+  stats_.buffer_wakeups++;
+
+  samples_.clear();
+  const bool success = buffer_->ReadSamples(&samples_);
+  stats_.buffer_samples += samples_.size();
+
+  // Report every sample rather than just the last one so that observers that
+  // require several consecutive readings before acting see all of them.
+  for (int64_t raw : samples_)
+    UpdateLux(RawToLux(raw));
+
+  if (!success) {
+    LOG(WARNING) << "Falling back to polling " << device_dir_.value();
+    CloseBuffer();
+  }
+}
+
+void AmbientLightSensor::OnFileCanWriteWithoutBlocking(int fd) {
+  NOTREACHED() << "Unexpected non-blocking write notification for FD " << fd;
+}
+
 void AmbientLightSensor::StartTimer() {
   poll_timer_.Start(FROM_HERE,
                     base::TimeDelta::FromMilliseconds(poll_interval_ms_),
@@ -93,6 +141,7 @@ void AmbientLightSensor::ReadAls() {
 
   // The timer will be restarted after the read finishes.
   poll_timer_.Stop();
+  stats_.polls++;
   als_file_.StartRead(
       base::Bind(&AmbientLightSensor::ReadCallback, base::Unretained(this)),
       base::Bind(&AmbientLightSensor::ErrorCallback, base::Unretained(this)));
@@ -103,14 +152,16 @@ void AmbientLightSensor::ReadCallback(const std::string& data) {
   base::TrimWhitespaceASCII(data, base::TRIM_ALL, &trimmed_data);
   int value = 0;
   if (base::StringToInt(trimmed_data, &value)) {
-    lux_value_ = value;
-    VLOG(1) << "Read lux " << lux_value_;
-    FOR_EACH_OBSERVER(
-        AmbientLightObserver, observers_, OnAmbientLightUpdated(this));
+    UpdateLux(value);
   } else {
     LOG(ERROR) << "Could not read lux value from ALS file contents: ["
                << trimmed_data << "]";
   }
+
+  // After the first successful read, switch to the device's buffer if
+  // possible so that the sensor no longer needs to be polled.
+  if (!tried_buffer_ && lux_value_ >= 0 && InitBuffer())
+    return;
   StartTimer();
 }
 
@@ -119,6 +170,72 @@ void AmbientLightSensor::ErrorCallback() {
   StartTimer();
 }
 
+bool AmbientLightSensor::InitBuffer() {
+  DCHECK(!buffer_);
+  tried_buffer_ = true;
+  if (channel_.empty())
+    return false;
+
+  // Buffers hold raw values. Scale them when the polled attribute held
+  // processed values so that both modes report the same units.
+  scale_ = 1.0;
+  offset_ = 0.0;
+  if (apply_scale_) {
+    ReadDoubleFile(device_dir_.Append(channel_ + "_scale"), &scale_);
+    ReadDoubleFile(device_dir_.Append(channel_ + "_offset"), &offset_);
+  }
+
+  std::unique_ptr<IioBuffer> buffer(new IioBuffer);
+  if (!buffer->Open(device_dir_,
+                    device_node_dir_.Append(device_dir_.BaseName()),
+                    channel_,
+                    sampling_frequency_,
+                    kBufferLength,
+                    kBufferWatermark))
+    return false;
+
+  if (!base::MessageLoopForIO::current()->WatchFileDescriptor(
+          buffer->fd(),
+          true,
+          base::MessageLoopForIO::WATCH_READ,
+          &buffer_watcher_,
+          this)) {
+    LOG(ERROR) << "Unable to watch FD " << buffer->fd();
+    return false;
+  }
+
+  // The device keeps sampling whether or not the light changes, so this is
+  // the cost of buffered reads, vs. 3600 * 1000 / |poll_interval_ms_| wakeups
+  // per hour for polling; each wakeup reads the device node instead of
+  // reopening the sysfs attribute.
+  if (buffer->sampling_frequency() > 0.0) {
+    LOG(INFO) << "Expecting "
+              << lround(buffer->sampling_frequency() * 3600 / kBufferWatermark)
+              << " wakeups per hour for " << device_dir_.value();
+  }
+
+  buffer_ = std::move(buffer);
+  poll_timer_.Stop();
+  return true;
+}
+
+void AmbientLightSensor::CloseBuffer() {
+  buffer_watcher_.StopWatchingFileDescriptor();
+  buffer_.reset();
+  StartTimer();
+}
+
+void AmbientLightSensor::UpdateLux(int lux) {
+  lux_value_ = lux;
+  VLOG(1) << "Read lux " << lux_value_;
+  FOR_EACH_OBSERVER(
+      AmbientLightObserver, observers_, OnAmbientLightUpdated(this));
+}
+
+int AmbientLightSensor::RawToLux(int64_t raw) const {
+  return static_cast<int>(lround((raw + offset_) * scale_));
+}
+
 bool AmbientLightSensor::InitAlsFile() {
   CHECK(!als_file_.HasOpenedFile());
 
@@ -143,6 +260,14 @@ bool AmbientLightSensor::InitAlsFile() {
         continue;
       if (als_file_.Init(als_path.value())) {
         LOG(INFO) << "Using lux file " << als_path.value();
+        device_dir_ = check_path;
+        // Only IIO channels (e.g. "in_illuminance0") can be buffered.
+        const std::string name = input_names[i];
+        channel_ = base::StartsWith(name, "in_", base::CompareCase::SENSITIVE)
+                       ? name.substr(0, name.rfind('_'))
+                       : std::string();
+        apply_scale_ =
+            base::EndsWith(name, "_input", base::CompareCase::SENSITIVE);
         return true;
       }
     }
@@ -5,18 +5,24 @@
 #ifndef POWER_MANAGER_POWERD_SYSTEM_AMBIENT_LIGHT_SENSOR_H_
 #define POWER_MANAGER_POWERD_SYSTEM_AMBIENT_LIGHT_SENSOR_H_
 
+#include <stdint.h>
+
 #include <list>
+#include <memory>
 #include <string>
+#include <vector>
 
 #include <base/compiler_specific.h>
 #include <base/files/file_path.h>
 #include <base/macros.h>
+#include <base/message_loop/message_loop.h>
 #include <base/observer_list.h>
 #include <base/timer/timer.h>
 
 #include "power_manager/common/power_constants.h"
 #include "power_manager/powerd/system/ambient_light_observer.h"
 #include "power_manager/powerd/system/async_file_reader.h"
+#include "power_manager/powerd/system/iio_buffer.h"
 
 namespace power_manager {
 namespace system {
@@ -38,13 +44,45 @@ class AmbientLightSensorInterface {
   DISALLOW_COPY_AND_ASSIGN(AmbientLightSensorInterface);
 };
 
-class AmbientLightSensor : public AmbientLightSensorInterface {
+// Reads the ambient light level from an IIO device. If the device supports
+// buffered reads, it samples at the rate at which the attribute would
+// otherwise be polled and powerd wakes up for each sample to read it from the
+// device node, so changes are seen as quickly as when polling; otherwise, the
+// device's sysfs attribute is polled.
+class AmbientLightSensor : public AmbientLightSensorInterface,
+                           public base::MessageLoopForIO::Watcher {
  public:
+  // Counts of the sensor's activity, used to compare the cost of the two
+  // modes.
+  struct Stats {
+    Stats();
+
+    // Number of times that the sysfs attribute was read.
+    int64_t polls;
+
+    // Number of times that the device node was reported as readable.
+    int64_t buffer_wakeups;
+
+    // Number of samples read from the device node.
+    int64_t buffer_samples;
+  };
+
+  // Default interval for polling the ambient light sensor. Buffered reads
+  // sample at the same rate.
+  static const int kDefaultPollIntervalMs;
+
   // Number of failed init attempts before AmbientLightSensor will start logging
   // warnings or stop trying entirely.
   static const int kNumInitAttemptsBeforeLogging;
   static const int kNumInitAttemptsBeforeGivingUp;
 
+  // Number of scans that the kernel is asked to be able to queue, and number of
+  // queued scans at which the device node becomes readable. The watermark is
+  // kept at a single scan so that a change in the light level isn't seen
+  // later than it would be by polling.
+  static const int kBufferLength;
+  static const int kBufferWatermark;
+
   AmbientLightSensor();
   virtual ~AmbientLightSensor();
 
@@ -54,6 +92,18 @@ class AmbientLightSensor : public AmbientLightSensorInterface {
   void set_poll_interval_ms_for_testing(int interval_ms) {
     poll_interval_ms_ = interval_ms;
   }
+  void set_sampling_frequency_for_testing(double frequency) {
+    sampling_frequency_ = frequency;
+  }
+  void set_device_node_dir_for_testing(const base::FilePath& path) {
+    device_node_dir_ = path;
+  }
+
+  const Stats& stats() const { return stats_; }
+
+  // Returns true if samples are being read from the device's buffer rather
+  // than by polling.
+  bool buffered() const { return buffer_.get() != nullptr; }
 
   // Starts polling.  This is separate from c'tor so that tests can call
   // set_*_for_testing() first.
@@ -68,10 +118,27 @@ class AmbientLightSensor : public AmbientLightSensorInterface {
   void RemoveObserver(AmbientLightObserver* observer) override;
   int GetAmbientLightLux() override;
 
+  // base::MessageLoopForIO::Watcher implementation:
+  void OnFileCanReadWithoutBlocking(int fd) override;
+  void OnFileCanWriteWithoutBlocking(int fd) override;
+
  private:
   // Starts |poll_timer_|.
   void StartTimer();
 
+  // Tries to read from the buffer of the device at |device_dir_|, stopping
+  // |poll_timer_| on success. Returns true if buffered reads were started.
+  bool InitBuffer();
+
+  // Stops reading from the buffer and resumes polling.
+  void CloseBuffer();
+
+  // Updates |lux_value_| and notifies observers.
+  void UpdateLux(int lux);
+
+  // Converts a raw buffer value to lux using |scale_| and |offset_|.
+  int RawToLux(int64_t raw) const;
+
   // Handler for a periodic event that reads the ambient light sensor.
   void ReadAls();
 
@@ -79,19 +146,52 @@ class AmbientLightSensor : public AmbientLightSensorInterface {
   void ReadCallback(const std::string& data);
   void ErrorCallback();
 
-  // Initializes |als_file_|. Returns true on success.
+  // Initializes |als_file_|, |device_dir_|, and |channel_|. Returns true on
+  // success.
   bool InitAlsFile();
 
   // Path containing backlight devices.  Typically under /sys, but can be
   // overridden by tests.
   base::FilePath device_list_path_;
 
+  // Directory containing IIO device nodes. Typically /dev, but can be
+  // overridden by tests.
+  base::FilePath device_node_dir_;
+
+  // sysfs directory of the sensor's device and name of its illuminance channel
+  // (e.g. "in_illuminance0"), set by InitAlsFile().
+  base::FilePath device_dir_;
+  std::string channel_;
+
+  // True if the polled attribute holds processed rather than raw values, in
+  // which case buffered values are converted using |scale_| and |offset_|:
+  // lux = (raw + offset) * scale.
+  bool apply_scale_;
+  double scale_;
+  double offset_;
+
+  // Non-null while samples are being read from the device's buffer.
+  std::unique_ptr<IioBuffer> buffer_;
+  base::MessageLoopForIO::FileDescriptorWatcher buffer_watcher_;
+
+  // Raw values read by the last call to OnFileCanReadWithoutBlocking().
+  std::vector<int64_t> samples_;
+
+  // True once buffered reads have been attempted for |device_dir_|.
+  bool tried_buffer_;
+
+  Stats stats_;
+
   // Runs ReadAls().
   base::RepeatingTimer poll_timer_;
 
   // Time between polls of the sensor file, in milliseconds.
   int poll_interval_ms_;
 
+  // Rate in Hz at which a buffered device is asked to sample. Defaults to one
+  // sample per poll interval.
+  double sampling_frequency_;
+
   // List of backlight controllers that are currently interested in updates from
   // this sensor.
   base::ObserverList<AmbientLightObserver> observers_;
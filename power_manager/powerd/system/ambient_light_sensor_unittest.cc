@@ -4,13 +4,27 @@
 
 #include "power_manager/powerd/system/ambient_light_sensor.h"
 
+#include <fcntl.h>
+#include <stdint.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
 #include <memory>
+#include <string>
+#include <vector>
 
 #include <base/compiler_specific.h>
 #include <base/files/file_path.h>
 #include <base/files/file_util.h>
+#include <base/files/scoped_file.h>
 #include <base/files/scoped_temp_dir.h>
+#include <base/logging.h>
+#include <base/posix/eintr_wrapper.h>
 #include <base/strings/string_number_conversions.h>
+#include <base/strings/string_util.h>
+#include <base/time/time.h>
+#include <base/timer/timer.h>
 #include <gtest/gtest.h>
 
 #include "power_manager/common/test_main_loop_runner.h"
@@ -32,9 +46,11 @@ const int kPollIntervalMs = 100;
 // until it receives notification that the ambient light level has changed.
 class TestObserver : public AmbientLightObserver {
  public:
-  TestObserver() {}
+  TestObserver() : num_updates_(0) {}
   virtual ~TestObserver() {}
 
+  int num_updates() const { return num_updates_; }
+
   // Runs |loop_| until OnAmbientLightUpdated() is called.
   bool RunUntilAmbientLightUpdated() {
     return loop_runner_.StartLoop(
@@ -43,15 +59,35 @@ class TestObserver : public AmbientLightObserver {
 
   // AmbientLightObserver implementation:
   void OnAmbientLightUpdated(AmbientLightSensorInterface* sensor) override {
+    num_updates_++;
     loop_runner_.StopLoop();
   }
 
  private:
   TestMainLoopRunner loop_runner_;
 
+  // Number of times that OnAmbientLightUpdated() has been called.
+  int num_updates_;
+
   DISALLOW_COPY_AND_ASSIGN(TestObserver);
 };
 
+// Writes |data| to |path|.
+void WriteFile(const base::FilePath& path, const std::string& data) {
+  CHECK_EQ(base::WriteFile(path, data.data(), data.size()),
+           static_cast<int>(data.size()))
+      << "Unable to write to " << path.value();
+}
+
+// Returns the trimmed contents of |path|.
+std::string ReadFile(const base::FilePath& path) {
+  std::string data;
+  CHECK(base::ReadFileToString(path, &data)) << "Unable to read "
+                                             << path.value();
+  base::TrimWhitespaceASCII(data, base::TRIM_ALL, &data);
+  return data;
+}
+
 }  // namespace
 
 class AmbientLightSensorTest : public ::testing::Test {
@@ -127,5 +163,288 @@ TEST_F(AmbientLightSensorTest, GiveUpAfterTooManyFailures) {
   EXPECT_LT(sensor_->GetAmbientLightLux(), 0);
 }
 
+// Stands in for the kernel side of an IIO device's buffer. While running, it
+// queues a scan holding the current raw value at the sampling frequency that
+// was written to the device's sysfs directory, and writes the queued scans to
+// the FIFO standing in for the device node whenever the watermark is reached,
+// as the kernel makes the node readable.
+class FakeIioDevice {
+ public:
+  FakeIioDevice(const base::FilePath& device_dir,
+                const base::FilePath& device_node)
+      : device_dir_(device_dir),
+        device_node_(device_node),
+        raw_value_(0),
+        watermark_(1),
+        num_scans_(0) {}
+  ~FakeIioDevice() {}
+
+  void set_raw_value(uint16_t value) { raw_value_ = value; }
+  int num_scans() const { return num_scans_; }
+  bool running() const { return timer_.IsRunning(); }
+
+  // Starts queuing scans. Must be called after the sensor has opened the
+  // device node.
+  void Start() {
+    double frequency = 0.0;
+    CHECK(base::StringToDouble(
+        ReadFile(device_dir_.Append("sampling_frequency")), &frequency));
+    CHECK_GT(frequency, 0.0);
+    CHECK(base::StringToInt(ReadFile(device_dir_.Append("buffer/watermark")),
+                            &watermark_));
+    writer_.reset(HANDLE_EINTR(
+        open(device_node_.value().c_str(), O_WRONLY | O_NONBLOCK)));
+    CHECK(writer_.is_valid());
+    timer_.Start(FROM_HERE,
+                 base::TimeDelta::FromMicroseconds(
+                     static_cast<int64_t>(1000000 / frequency)),
+                 this,
+                 &FakeIioDevice::QueueScan);
+  }
+
+  // Stops queuing scans and closes the write end of the FIFO, so that the
+  // next read from the device node hits EOF.
+  void Stop() {
+    timer_.Stop();
+    writer_.reset();
+  }
+
+ private:
+  // Queues a 16-bit little-endian scan holding |raw_value_|.
+  void QueueScan() {
+    queued_.push_back(static_cast<char>(raw_value_ & 0xff));
+    queued_.push_back(static_cast<char>(raw_value_ >> 8));
+    num_scans_++;
+    if (queued_.size() / 2 < static_cast<size_t>(watermark_))
+      return;
+    CHECK_EQ(HANDLE_EINTR(write(writer_.get(), queued_.data(), queued_.size())),
+             static_cast<ssize_t>(queued_.size()));
+    queued_.clear();
+  }
+
+  base::FilePath device_dir_;
+  base::FilePath device_node_;
+
+  // Write end of the FIFO at |device_node_|.
+  base::ScopedFD writer_;
+
+  uint16_t raw_value_;
+  int watermark_;
+
+  // Scans that haven't been written to |writer_| yet.
+  std::string queued_;
+
+  // Total number of scans queued.
+  int num_scans_;
+
+  // Runs QueueScan().
+  base::RepeatingTimer timer_;
+
+  DISALLOW_COPY_AND_ASSIGN(FakeIioDevice);
+};
+
+// Sets up a fake IIO device that supports buffered reads: a sysfs directory
+// with scan elements, buffer attributes, a sampling frequency, and a
+// data-ready trigger, along with a FIFO standing in for the device node.
+class AmbientLightSensorBufferTest : public ::testing::Test {
+ public:
+  AmbientLightSensorBufferTest() {}
+  ~AmbientLightSensorBufferTest() override {}
+
+  void SetUp() override {
+    CHECK(temp_dir_.CreateUniqueTempDir());
+    const base::FilePath sys_dir = temp_dir_.path().Append("sys");
+    device_dir_ = sys_dir.Append("iio:device0");
+    const base::FilePath scan_dir = device_dir_.Append("scan_elements");
+    CHECK(base::CreateDirectory(scan_dir));
+    CHECK(base::CreateDirectory(device_dir_.Append("buffer")));
+    CHECK(base::CreateDirectory(device_dir_.Append("trigger")));
+    CHECK(base::CreateDirectory(sys_dir.Append("trigger0")));
+
+    WriteFile(device_dir_.Append("name"), "acpi-als");
+    WriteFile(device_dir_.Append("in_illuminance_input"), "50");
+    WriteFile(device_dir_.Append("in_illuminance_scale"), "0.5");
+    WriteFile(device_dir_.Append("sampling_frequency"), "0");
+    WriteFile(scan_dir.Append("in_illuminance_en"), "0");
+    WriteFile(scan_dir.Append("in_illuminance_index"), "0");
+    WriteFile(scan_dir.Append("in_illuminance_type"), "le:u16/16>>0");
+    WriteFile(device_dir_.Append("buffer/enable"), "0");
+    WriteFile(device_dir_.Append("buffer/length"), "0");
+    WriteFile(device_dir_.Append("buffer/watermark"), "1");
+    WriteFile(device_dir_.Append("trigger/current_trigger"), "");
+    WriteFile(sys_dir.Append("trigger0/name"), "acpi-als-dev0");
+
+    const base::FilePath dev_dir = temp_dir_.path().Append("dev");
+    CHECK(base::CreateDirectory(dev_dir));
+    device_node_ = dev_dir.Append("iio:device0");
+    CHECK_EQ(mkfifo(device_node_.value().c_str(), 0600), 0);
+    device_.reset(new FakeIioDevice(device_dir_, device_node_));
+
+    sensor_.reset(new AmbientLightSensor);
+    sensor_->set_device_list_path_for_testing(sys_dir);
+    sensor_->set_device_node_dir_for_testing(dev_dir);
+    sensor_->set_poll_interval_ms_for_testing(kPollIntervalMs);
+    sensor_->set_sampling_frequency_for_testing(kSamplingFrequency);
+    sensor_->AddObserver(&observer_);
+  }
+
+  void TearDown() override { sensor_->RemoveObserver(&observer_); }
+
+ protected:
+  // Rate at which the sensor asks the device to sample, in Hz.
+  static const int kSamplingFrequency = 50;
+
+  // Initializes |sensor_| and waits for its initial sysfs reading, after
+  // which it should switch to the buffer. Starts |device_| if it did.
+  void Init() {
+    sensor_->Init();
+    ASSERT_TRUE(observer_.RunUntilAmbientLightUpdated());
+    EXPECT_EQ(50, sensor_->GetAmbientLightLux());
+    if (sensor_->buffered())
+      device_->Start();
+  }
+
+  // Runs the message loop until |sensor_| reports |lux|. Returns false if it
+  // doesn't within kUpdateTimeoutMs.
+  bool WaitForLux(int lux) {
+    const base::TimeTicks deadline =
+        base::TimeTicks::Now() +
+        base::TimeDelta::FromMilliseconds(kUpdateTimeoutMs);
+    while (sensor_->GetAmbientLightLux() != lux) {
+      if (base::TimeTicks::Now() > deadline ||
+          !observer_.RunUntilAmbientLightUpdated())
+        return false;
+    }
+    return true;
+  }
+
+  // Returns the contents of an attribute in |device_dir_|.
+  std::string ReadAttribute(const std::string& name) {
+    return ReadFile(device_dir_.Append(name));
+  }
+
+  base::ScopedTempDir temp_dir_;
+  base::FilePath device_dir_;
+  base::FilePath device_node_;
+
+  std::unique_ptr<FakeIioDevice> device_;
+
+  TestObserver observer_;
+
+  std::unique_ptr<AmbientLightSensor> sensor_;
+
+ private:
+  DISALLOW_COPY_AND_ASSIGN(AmbientLightSensorBufferTest);
+};
+
+TEST_F(AmbientLightSensorBufferTest, ReadFromBuffer) {
+  Init();
+  ASSERT_TRUE(sensor_->buffered());
+  EXPECT_FALSE(sensor_->TriggerPollTimerForTesting());
+  EXPECT_EQ("1", ReadAttribute("scan_elements/in_illuminance_en"));
+  EXPECT_EQ("1", ReadAttribute("buffer/enable"));
+  EXPECT_EQ(base::IntToString(AmbientLightSensor::kBufferLength),
+            ReadAttribute("buffer/length"));
+  EXPECT_EQ(base::IntToString(AmbientLightSensor::kBufferWatermark),
+            ReadAttribute("buffer/watermark"));
+  EXPECT_EQ("acpi-als-dev0", ReadAttribute("trigger/current_trigger"));
+  EXPECT_EQ(base::IntToString(kSamplingFrequency),
+            ReadAttribute("sampling_frequency"));
+
+  // Raw values should be scaled, and every sample should be reported, even
+  // though several are read per wakeup.
+  const int initial_updates = observer_.num_updates();
+  device_->set_raw_value(400);
+  ASSERT_TRUE(WaitForLux(200));
+  EXPECT_EQ(initial_updates + sensor_->stats().buffer_samples,
+            observer_.num_updates());
+  EXPECT_EQ(1, sensor_->stats().polls);
+  EXPECT_GE(sensor_->stats().buffer_samples,
+            AmbientLightSensor::kBufferWatermark *
+                sensor_->stats().buffer_wakeups);
+}
+
+TEST_F(AmbientLightSensorBufferTest, WakeupsAndLatency) {
+  // At the default rate, the device samples as often as the sysfs attribute
+  // would be polled, whether or not the light changes, and powerd wakes up
+  // once per kBufferWatermark samples to read them. A change should be seen
+  // within one poll interval, as with polling.
+  const int kNumChanges = 3;
+  const int64_t kMaxLatencyMs = AmbientLightSensor::kDefaultPollIntervalMs;
+  const int64_t kPollsPerHour =
+      3600 * 1000 / AmbientLightSensor::kDefaultPollIntervalMs;
+  const int64_t kWakeupsPerHour =
+      kPollsPerHour / AmbientLightSensor::kBufferWatermark;
+
+  sensor_->set_sampling_frequency_for_testing(
+      1000.0 / AmbientLightSensor::kDefaultPollIntervalMs);
+  Init();
+  ASSERT_TRUE(sensor_->buffered());
+  const base::TimeTicks start = base::TimeTicks::Now();
+  base::TimeDelta max_latency;
+  for (int i = 0; i < kNumChanges; ++i) {
+    const base::TimeTicks change_time = base::TimeTicks::Now();
+    device_->set_raw_value(200 + 10 * i);
+    ASSERT_TRUE(WaitForLux(100 + 5 * i));
+    max_latency = std::max(max_latency, base::TimeTicks::Now() - change_time);
+  }
+  const base::TimeDelta elapsed = base::TimeTicks::Now() - start;
+
+  const int64_t wakeups = sensor_->stats().buffer_wakeups;
+  const int64_t samples = sensor_->stats().buffer_samples;
+  LOG(INFO) << "Woke " << wakeups << " times for " << samples << " samples in "
+            << elapsed.InMilliseconds() << " ms (" << kWakeupsPerHour
+            << " wakeups/hour vs. " << kPollsPerHour << " polls/hour); max "
+            << "latency " << max_latency.InMilliseconds() << " ms";
+  EXPECT_GT(wakeups, 0);
+  EXPECT_LE(samples, device_->num_scans());
+  EXPECT_GE(samples, AmbientLightSensor::kBufferWatermark * wakeups);
+  EXPECT_EQ(1, sensor_->stats().polls);
+
+  // Allow for the fake device's timer firing late.
+  const int64_t kTimerSlackMs = 50;
+  EXPECT_LE(max_latency.InMilliseconds(), kMaxLatencyMs + kTimerSlackMs);
+}
+
+TEST_F(AmbientLightSensorBufferTest, FallBackToPollingOnError) {
+  Init();
+  ASSERT_TRUE(sensor_->buffered());
+  device_->set_raw_value(120);
+  ASSERT_TRUE(WaitForLux(60));
+
+  // Closing the FIFO's write end makes the next read hit EOF, after which the
+  // sensor should disable the buffer and resume polling the sysfs attribute.
+  device_->Stop();
+  WriteFile(device_dir_.Append("in_illuminance_input"), "75");
+  ASSERT_TRUE(WaitForLux(75));
+  EXPECT_FALSE(sensor_->buffered());
+  EXPECT_EQ("0", ReadAttribute("buffer/enable"));
+  EXPECT_EQ("", ReadAttribute("trigger/current_trigger"));
+  EXPECT_TRUE(sensor_->TriggerPollTimerForTesting());
+}
+
+TEST_F(AmbientLightSensorBufferTest, PollWithoutDeviceNode) {
+  base::DeleteFile(device_node_, false);
+  Init();
+  EXPECT_FALSE(sensor_->buffered());
+  EXPECT_EQ("0", ReadAttribute("scan_elements/in_illuminance_en"));
+  EXPECT_EQ("0", ReadAttribute("buffer/enable"));
+  EXPECT_EQ("", ReadAttribute("trigger/current_trigger"));
+
+  WriteFile(device_dir_.Append("in_illuminance_input"), "60");
+  ASSERT_TRUE(WaitForLux(60));
+  EXPECT_EQ(0, sensor_->stats().buffer_wakeups);
+}
+
+TEST_F(AmbientLightSensorBufferTest, PollWithoutTrigger) {
+  // Without a trigger, the device would never queue any scans.
+  base::DeleteFile(temp_dir_.path().Append("sys/trigger0"), true);
+  Init();
+  EXPECT_FALSE(sensor_->buffered());
+  EXPECT_EQ("0", ReadAttribute("scan_elements/in_illuminance_en"));
+  EXPECT_EQ("0", ReadAttribute("buffer/enable"));
+  EXPECT_TRUE(sensor_->TriggerPollTimerForTesting());
+}
+
 }  // namespace system
 }  // namespace power_manager
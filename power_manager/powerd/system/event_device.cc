@@ -28,6 +28,8 @@ static constexpr int kMaxBit = MAX(MAX(EV_MAX, KEY_MAX), SW_MAX);
 
 // EventDevice
 
+const size_t EventDevice::kMaxEventsPerRead = 64;
+
 EventDevice::EventDevice(int fd, const base::FilePath& path)
     : fd_(fd), path_(path) {}
 
@@ -121,17 +123,21 @@ bool EventDevice::GetSwitchBit(int bit) {
 
 bool EventDevice::ReadEvents(std::vector<input_event>* events_out) {
   DCHECK(events_out);
-  events_out->clear();
 
-  struct input_event events[64];
-  ssize_t read_size = HANDLE_EINTR(read(fd_, events, sizeof(events)));
+  // Read directly into |events_out| rather than into a local buffer that then
+  // needs to be copied.
+  events_out->resize(kMaxEventsPerRead);
+  ssize_t read_size = HANDLE_EINTR(
+      read(fd_, events_out->data(), kMaxEventsPerRead * sizeof(input_event)));
   if (read_size < 0) {
     // ENODEV is expected if the device was just unplugged.
     if (errno != EAGAIN && errno != EWOULDBLOCK && errno != ENODEV)
       PLOG(ERROR) << "Reading events from " << path_.value() << " failed";
+    events_out->clear();
     return false;
   } else if (read_size == 0) {
     LOG(ERROR) << "Read returned 0 when reading events from " << path_.value();
+    events_out->clear();
     return false;
   }
 
@@ -139,12 +145,11 @@ bool EventDevice::ReadEvents(std::vector<input_event>* events_out) {
   if (read_size % sizeof(struct input_event)) {
     LOG(ERROR) << "Read " << read_size << " byte(s) while expecting "
                << sizeof(struct input_event) << "-byte events";
+    events_out->clear();
     return false;
   }
 
-  events_out->reserve(num_events);
-  for (size_t i = 0; i < num_events; ++i)
-    events_out->push_back(events[i]);
+  events_out->resize(num_events);
   return true;
 }
 
@@ -7,6 +7,8 @@
 
 #include "power_manager/powerd/system/event_device_interface.h"
 
+#include <stddef.h>
+
 #include <memory>
 #include <string>
 #include <vector>
@@ -22,6 +24,9 @@ namespace system {
 class EventDevice : public EventDeviceInterface,
                     public base::MessageLoopForIO::Watcher {
  public:
+  // Maximum number of events returned by a single ReadEvents() call.
+  static const size_t kMaxEventsPerRead;
+
   EventDevice(int fd, const base::FilePath& path);
   virtual ~EventDevice();
 
@@ -58,8 +58,10 @@ class EventDeviceInterface {
   // Must not be called after ReadEvents() or WatchForEvents().
   virtual TabletMode GetInitialTabletMode() = 0;
 
-  // Reads a number of events into |events_out|. Returns true if the operation
-  // was successful and events were present.
+  // Reads a number of events into |events_out|, replacing its previous
+  // contents. The vector's existing capacity is reused, so callers that pass
+  // the same vector on every call don't allocate once it has grown. Returns
+  // true if the operation was successful and events were present.
   virtual bool ReadEvents(std::vector<input_event>* events_out) = 0;
 
   // Start watching this device for incoming events, and run |new_events_cb|
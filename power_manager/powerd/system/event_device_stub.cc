@@ -74,7 +74,9 @@ bool EventDeviceStub::ReadEvents(std::vector<input_event>* events_out) {
   if (events_.empty())
     return false;
 
-  events_out->swap(events_);
+  // Copy rather than swap so that both vectors keep their capacity, as with
+  // EventDevice.
+  events_out->assign(events_.begin(), events_.end());
   events_.clear();
   return true;
 }
@@ -0,0 +1,373 @@
+// Copyright 2016 The Chromium OS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "power_manager/powerd/system/iio_buffer.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <utility>
+
+#include <base/files/file_enumerator.h>
+#include <base/files/file_util.h>
+#include <base/logging.h>
+#include <base/posix/eintr_wrapper.h>
+#include <base/strings/string_number_conversions.h>
+#include <base/strings/string_util.h>
+
+namespace power_manager {
+namespace system {
+
+namespace {
+
+// Suffixes of the scan_elements files describing each channel.
+const char kEnableSuffix[] = "_en";
+const char kIndexSuffix[] = "_index";
+const char kTypeSuffix[] = "_type";
+
+// Maximum number of bytes to read from the device node at once.
+const size_t kReadSize = 4096;
+
+// Reads |path| into |value|, trimming trailing whitespace. Returns true on
+// success.
+bool ReadSysfsString(const base::FilePath& path, std::string* value) {
+  if (!base::ReadFileToString(path, value))
+    return false;
+  base::TrimWhitespaceASCII(*value, base::TRIM_TRAILING, value);
+  return true;
+}
+
+// Writes |value| to |path|. Returns true on success.
+bool WriteSysfsString(const base::FilePath& path, const std::string& value) {
+  if (base::WriteFile(path, value.data(), value.size()) !=
+      static_cast<int>(value.size())) {
+    PLOG(WARNING) << "Unable to write \"" << value << "\" to " << path.value();
+    return false;
+  }
+  return true;
+}
+
+}  // namespace
+
+IioBuffer::ScanType::ScanType()
+    : big_endian(false), is_signed(false), bits(0), storage_bits(0), shift(0) {}
+
+// static
+bool IioBuffer::ParseScanType(const std::string& str, ScanType* type) {
+  DCHECK(type);
+  char endian = 0, sign = 0;
+  int bits = 0, storage_bits = 0, shift = 0;
+  int consumed = 0;
+  // Repeated channels (e.g. "le:s16/16X3>>0") don't match the ">>" and are
+  // rejected.
+  if (sscanf(str.c_str(),  // NOLINT(runtime/printf)
+             "%ce:%c%d/%d>>%d%n",
+             &endian,
+             &sign,
+             &bits,
+             &storage_bits,
+             &shift,
+             &consumed) != 5 ||
+      consumed != static_cast<int>(str.size()))
+    return false;
+  if ((endian != 'l' && endian != 'b') || (sign != 's' && sign != 'u'))
+    return false;
+  if (storage_bits != 8 && storage_bits != 16 && storage_bits != 32 &&
+      storage_bits != 64)
+    return false;
+  if (bits <= 0 || shift < 0 || bits + shift > storage_bits)
+    return false;
+
+  type->big_endian = endian == 'b';
+  type->is_signed = sign == 's';
+  type->bits = bits;
+  type->storage_bits = storage_bits;
+  type->shift = shift;
+  return true;
+}
+
+IioBuffer::IioBuffer()
+    : selected_trigger_(false),
+      sampling_frequency_(0.0),
+      scan_size_(0),
+      offset_(0) {}
+
+IioBuffer::~IioBuffer() {
+  Close();
+}
+
+bool IioBuffer::Open(const base::FilePath& sysfs_dir,
+                     const base::FilePath& device_node,
+                     const std::string& channel,
+                     double sampling_frequency,
+                     int length,
+                     int watermark) {
+  DCHECK(!fd_.is_valid());
+  sysfs_dir_ = sysfs_dir;
+  device_node_ = device_node;
+
+  const base::FilePath scan_dir = sysfs_dir_.Append("scan_elements");
+  const base::FilePath enable_path =
+      scan_dir.Append(channel + kEnableSuffix);
+  std::string was_enabled;
+  if (!ReadSysfsString(enable_path, &was_enabled)) {
+    VLOG(1) << sysfs_dir_.value() << " doesn't support buffered reads of "
+            << channel;
+    return false;
+  }
+
+  // Someone else is already using the buffer.
+  std::string buffer_enabled;
+  const base::FilePath buffer_dir = sysfs_dir_.Append("buffer");
+  if (ReadSysfsString(buffer_dir.Append("enable"), &buffer_enabled) &&
+      buffer_enabled == "1") {
+    LOG(WARNING) << "Buffer for " << sysfs_dir_.value() << " already enabled";
+    return false;
+  }
+
+  if (was_enabled != "1" && !WriteSysfsString(enable_path, "1"))
+    return false;
+
+  if (!ComputeScanLayout(channel) ||
+      !WriteSysfsString(buffer_dir.Append("length"),
+                        base::IntToString(length)) ||
+      !SelectTrigger()) {
+    if (was_enabled != "1")
+      WriteSysfsString(enable_path, "0");
+    return false;
+  }
+  SetSamplingFrequency(sampling_frequency);
+
+  // The watermark is only supported by newer kernels; without it, the device
+  // node becomes readable as soon as a single scan is queued.
+  const base::FilePath watermark_path = buffer_dir.Append("watermark");
+  if (base::PathExists(watermark_path))
+    WriteSysfsString(watermark_path, base::IntToString(watermark));
+
+  if (!SetBufferEnabled(true)) {
+    RestoreTrigger();
+    if (was_enabled != "1")
+      WriteSysfsString(enable_path, "0");
+    return false;
+  }
+
+  fd_.reset(HANDLE_EINTR(
+      open(device_node_.value().c_str(), O_RDONLY | O_NONBLOCK | O_CLOEXEC)));
+  if (!fd_.is_valid()) {
+    PLOG(WARNING) << "Unable to open " << device_node_.value();
+    SetBufferEnabled(false);
+    RestoreTrigger();
+    if (was_enabled != "1")
+      WriteSysfsString(enable_path, "0");
+    return false;
+  }
+
+  LOG(INFO) << "Reading " << channel << " from " << device_node_.value()
+            << " (" << scan_size_ << "-byte scans at " << sampling_frequency_
+            << " Hz, watermark " << watermark << ")";
+  pending_.clear();
+  return true;
+}
+
+void IioBuffer::Close() {
+  if (!fd_.is_valid())
+    return;
+
+  fd_.reset();
+  SetBufferEnabled(false);
+  RestoreTrigger();
+  pending_.clear();
+}
+
+bool IioBuffer::ReadSamples(std::vector<int64_t>* values) {
+  DCHECK(values);
+  DCHECK(fd_.is_valid());
+
+  uint8_t buf[kReadSize];
+  while (true) {
+    const ssize_t size = HANDLE_EINTR(read(fd_.get(), buf, sizeof(buf)));
+    if (size < 0) {
+      if (errno == EAGAIN || errno == EWOULDBLOCK)
+        return true;
+      PLOG(ERROR) << "Reading from " << device_node_.value() << " failed";
+      return false;
+    } else if (size == 0) {
+      LOG(ERROR) << "Read returned 0 when reading from "
+                 << device_node_.value();
+      return false;
+    }
+
+    pending_.insert(pending_.end(), buf, buf + size);
+    size_t pos = 0;
+    for (; pending_.size() - pos >= scan_size_; pos += scan_size_)
+      values->push_back(DecodeSample(&pending_[pos]));
+    pending_.erase(pending_.begin(), pending_.begin() + pos);
+  }
+}
+
+bool IioBuffer::ComputeScanLayout(const std::string& channel) {
+  // Each enabled element is aligned to its own size within the scan, in the
+  // order given by the elements' indexes, and the scan is padded to a
+  // multiple of the largest element's size.
+  struct Element {
+    int index;
+    size_t size;
+    bool is_channel;
+  };
+  std::vector<Element> elements;
+
+  const base::FilePath scan_dir = sysfs_dir_.Append("scan_elements");
+  base::FileEnumerator file_enum(scan_dir,
+                                 false,
+                                 base::FileEnumerator::FILES,
+                                 std::string("*") + kEnableSuffix);
+  for (base::FilePath path = file_enum.Next(); !path.empty();
+       path = file_enum.Next()) {
+    std::string enabled;
+    if (!ReadSysfsString(path, &enabled) || enabled != "1")
+      continue;
+
+    const std::string name = path.BaseName().value();
+    const std::string prefix =
+        name.substr(0, name.size() - strlen(kEnableSuffix));
+    std::string index_str, type_str;
+    ScanType type;
+    Element element;
+    if (!ReadSysfsString(scan_dir.Append(prefix + kIndexSuffix),
+                         &index_str) ||
+        !base::StringToInt(index_str, &element.index) ||
+        !ReadSysfsString(scan_dir.Append(prefix + kTypeSuffix), &type_str) ||
+        !ParseScanType(type_str, &type)) {
+      LOG(WARNING) << "Unable to read scan element " << prefix << " in "
+                   << scan_dir.value();
+      return false;
+    }
+    element.size = type.storage_bits / 8;
+    element.is_channel = prefix == channel;
+    if (element.is_channel)
+      type_ = type;
+    elements.push_back(element);
+  }
+
+  std::sort(elements.begin(),
+            elements.end(),
+            [](const Element& a, const Element& b) {
+              return a.index < b.index;
+            });
+
+  bool found_channel = false;
+  size_t offset = 0, max_size = 1;
+  for (const Element& element : elements) {
+    if (offset % element.size)
+      offset += element.size - offset % element.size;
+    if (element.is_channel) {
+      offset_ = offset;
+      found_channel = true;
+    }
+    offset += element.size;
+    max_size = std::max(max_size, element.size);
+  }
+  if (!found_channel) {
+    LOG(WARNING) << channel << " isn't enabled in " << scan_dir.value();
+    return false;
+  }
+  if (offset % max_size)
+    offset += max_size - offset % max_size;
+  scan_size_ = offset;
+  return true;
+}
+
+bool IioBuffer::SetBufferEnabled(bool enabled) {
+  return WriteSysfsString(sysfs_dir_.Append("buffer").Append("enable"),
+                          enabled ? "1" : "0");
+}
+
+bool IioBuffer::SelectTrigger() {
+  selected_trigger_ = false;
+  const base::FilePath current_path =
+      sysfs_dir_.Append("trigger").Append("current_trigger");
+  std::string current;
+  // Devices without the attribute fill their buffers by themselves.
+  if (!ReadSysfsString(current_path, &current) || !current.empty())
+    return true;
+
+  // Drivers name their data-ready triggers "<name>-dev<N>" for device
+  // "iio:device<N>".
+  const std::string device = sysfs_dir_.BaseName().value();
+  const size_t index_pos = device.find_first_of("0123456789");
+  std::string name;
+  if (index_pos == std::string::npos ||
+      !ReadSysfsString(sysfs_dir_.Append("name"), &name)) {
+    LOG(WARNING) << "Unable to name the trigger of " << sysfs_dir_.value();
+    return false;
+  }
+  const std::string trigger = name + "-dev" + device.substr(index_pos);
+
+  base::FileEnumerator trigger_enum(sysfs_dir_.DirName(),
+                                    false,
+                                    base::FileEnumerator::DIRECTORIES,
+                                    "trigger*");
+  for (base::FilePath path = trigger_enum.Next(); !path.empty();
+       path = trigger_enum.Next()) {
+    std::string trigger_name;
+    if (!ReadSysfsString(path.Append("name"), &trigger_name) ||
+        trigger_name != trigger)
+      continue;
+    if (!WriteSysfsString(current_path, trigger))
+      return false;
+    selected_trigger_ = true;
+    return true;
+  }
+  LOG(WARNING) << "No trigger " << trigger << " for " << sysfs_dir_.value();
+  return false;
+}
+
+void IioBuffer::RestoreTrigger() {
+  if (!selected_trigger_)
+    return;
+  WriteSysfsString(sysfs_dir_.Append("trigger").Append("current_trigger"),
+                   "");
+  selected_trigger_ = false;
+}
+
+void IioBuffer::SetSamplingFrequency(double frequency) {
+  sampling_frequency_ = 0.0;
+  const base::FilePath path = sysfs_dir_.Append("sampling_frequency");
+  if (!base::PathExists(path))
+    return;
+  WriteSysfsString(path, base::DoubleToString(frequency));
+  // Devices round the rate to one that they support.
+  std::string value;
+  if (!ReadSysfsString(path, &value) ||
+      !base::StringToDouble(value, &sampling_frequency_))
+    sampling_frequency_ = 0.0;
+}
+
+int64_t IioBuffer::DecodeSample(const uint8_t* scan) const {
+  const uint8_t* bytes = scan + offset_;
+  const int size = type_.storage_bits / 8;
+  uint64_t raw = 0;
+  for (int i = 0; i < size; ++i) {
+    if (type_.big_endian)
+      raw = (raw << 8) | bytes[i];
+    else
+      raw |= static_cast<uint64_t>(bytes[i]) << (8 * i);
+  }
+
+  raw >>= type_.shift;
+  if (type_.bits < 64) {
+    const uint64_t mask = (static_cast<uint64_t>(1) << type_.bits) - 1;
+    raw &= mask;
+    if (type_.is_signed && (raw >> (type_.bits - 1)) & 1)
+      raw |= ~mask;
+  }
+  return static_cast<int64_t>(raw);
+}
+
+}  // namespace system
+}  // namespace power_manager
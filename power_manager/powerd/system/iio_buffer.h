@@ -0,0 +1,137 @@
+// Copyright 2016 The Chromium OS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef POWER_MANAGER_POWERD_SYSTEM_IIO_BUFFER_H_
+#define POWER_MANAGER_POWERD_SYSTEM_IIO_BUFFER_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+#include <base/files/file_path.h>
+#include <base/files/scoped_file.h>
+#include <base/macros.h>
+
+namespace power_manager {
+namespace system {
+
+// Reads samples of a single channel from an Industrial I/O device's buffer
+// (i.e. from /dev/iio:deviceN) instead of from its sysfs attributes.
+//
+// The kernel queues a scan each time that the device's trigger fires, i.e. at
+// the device's sampling frequency, and reports the device node as readable
+// once |watermark| scans are queued, so the caller wakes up once per
+// |watermark| samples instead of polling. See the "buffer", "scan_elements",
+// "trigger" and "sampling_frequency" attributes in the kernel's
+// Documentation/ABI/testing/sysfs-bus-iio.
+class IioBuffer {
+ public:
+  // Layout of a channel's value within a scan, as described by a
+  // scan_elements/*_type file such as "le:s12/16>>4".
+  struct ScanType {
+    ScanType();
+
+    bool big_endian;
+    bool is_signed;
+
+    // Number of meaningful bits, and of bits that the value occupies.
+    int bits;
+    int storage_bits;
+
+    // Number of bits that the value must be shifted right by.
+    int shift;
+  };
+
+  // Parses |str|, the contents of a scan_elements/*_type file, into |type|.
+  // Returns false if |str| is malformed or describes a repeated channel.
+  static bool ParseScanType(const std::string& str, ScanType* type);
+
+  IioBuffer();
+  ~IioBuffer();
+
+  // Returns the FD of the open device node, or -1 if the buffer isn't open.
+  int fd() const { return fd_.get(); }
+
+  // Returns the rate in Hz at which the device queues scans, as reported by
+  // the device after Open(), or 0 if the device doesn't report it.
+  double sampling_frequency() const { return sampling_frequency_; }
+
+  // Enables |channel| (e.g. "in_illuminance") in the scan elements of the
+  // device at |sysfs_dir|, enables its buffer, and opens |device_node| for
+  // nonblocking reads. If the device needs a trigger and has none, its own
+  // data-ready trigger is selected. |sampling_frequency| is the rate in Hz at
+  // which the device is asked to sample, |length| is the number of scans that
+  // the kernel should be able to queue and |watermark| is the number of queued
+  // scans at which the device node becomes readable; the frequency and the
+  // watermark are skipped on devices and kernels that don't support them.
+  // Returns false, leaving the device as it was, if the device doesn't support
+  // buffered reads.
+  bool Open(const base::FilePath& sysfs_dir,
+            const base::FilePath& device_node,
+            const std::string& channel,
+            double sampling_frequency,
+            int length,
+            int watermark);
+
+  // Disables the buffer, deselects the trigger if Open() selected it, and
+  // closes the device node.
+  void Close();
+
+  // Reads all of the queued scans and appends the channel's values from them
+  // to |values|, oldest first. Returns false if the device couldn't be read;
+  // reading when nothing is queued succeeds without adding any values.
+  bool ReadSamples(std::vector<int64_t>* values);
+
+ private:
+  // Computes |scan_size_| and |offset_| from the enabled scan elements.
+  bool ComputeScanLayout(const std::string& channel);
+
+  // Enables or disables the buffer by writing to buffer/enable.
+  bool SetBufferEnabled(bool enabled);
+
+  // Selects the device's data-ready trigger if the device has a
+  // trigger/current_trigger attribute and no trigger is selected. Returns
+  // false if a trigger is needed but couldn't be selected.
+  bool SelectTrigger();
+
+  // Deselects the trigger if SelectTrigger() selected it.
+  void RestoreTrigger();
+
+  // Writes |frequency| to the device's sampling_frequency attribute, if any,
+  // and reads back the rate that the device chose into
+  // |sampling_frequency_|.
+  void SetSamplingFrequency(double frequency);
+
+  // Extracts the channel's value from the scan starting at |scan|.
+  int64_t DecodeSample(const uint8_t* scan) const;
+
+  base::FilePath sysfs_dir_;
+  base::FilePath device_node_;
+  base::ScopedFD fd_;
+
+  // Format of the channel's values.
+  ScanType type_;
+
+  // True if Open() selected the device's trigger.
+  bool selected_trigger_;
+
+  // Rate reported by the device's sampling_frequency attribute.
+  double sampling_frequency_;
+
+  // Size of each scan and offset of the channel's value within it, in bytes.
+  size_t scan_size_;
+  size_t offset_;
+
+  // Bytes of a partial scan left over from the last read.
+  std::vector<uint8_t> pending_;
+
+  DISALLOW_COPY_AND_ASSIGN(IioBuffer);
+};
+
+}  // namespace system
+}  // namespace power_manager
+
+#endif  // POWER_MANAGER_POWERD_SYSTEM_IIO_BUFFER_H_
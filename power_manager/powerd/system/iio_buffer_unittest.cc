@@ -0,0 +1,264 @@
+// Copyright 2016 The Chromium OS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "power_manager/powerd/system/iio_buffer.h"
+
+#include <fcntl.h>
+#include <stdint.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <string>
+#include <vector>
+
+#include <base/files/file_path.h>
+#include <base/files/file_util.h>
+#include <base/files/scoped_file.h>
+#include <base/files/scoped_temp_dir.h>
+#include <base/logging.h>
+#include <base/posix/eintr_wrapper.h>
+#include <base/strings/string_number_conversions.h>
+#include <base/strings/string_util.h>
+#include <gtest/gtest.h>
+
+namespace power_manager {
+namespace system {
+
+namespace {
+
+// Writes |data| to |path|.
+void WriteFile(const base::FilePath& path, const std::string& data) {
+  CHECK_EQ(base::WriteFile(path, data.data(), data.size()),
+           static_cast<int>(data.size()))
+      << "Unable to write to " << path.value();
+}
+
+// Returns the trimmed contents of |path|.
+std::string ReadFile(const base::FilePath& path) {
+  std::string data;
+  CHECK(base::ReadFileToString(path, &data)) << "Unable to read "
+                                             << path.value();
+  base::TrimWhitespaceASCII(data, base::TRIM_ALL, &data);
+  return data;
+}
+
+// Appends the |size| least-significant bytes of |value| to |out| in
+// little-endian order.
+void AppendLittleEndian(uint64_t value, size_t size, std::string* out) {
+  for (size_t i = 0; i < size; ++i)
+    out->push_back(static_cast<char>((value >> (8 * i)) & 0xff));
+}
+
+}  // namespace
+
+class IioBufferTest : public ::testing::Test {
+ public:
+  IioBufferTest() {}
+  ~IioBufferTest() override {}
+
+  void SetUp() override {
+    CHECK(temp_dir_.CreateUniqueTempDir());
+    sysfs_dir_ = temp_dir_.path().Append("iio:device0");
+    scan_dir_ = sysfs_dir_.Append("scan_elements");
+    buffer_dir_ = sysfs_dir_.Append("buffer");
+    CHECK(base::CreateDirectory(scan_dir_));
+    CHECK(base::CreateDirectory(buffer_dir_));
+    WriteFile(buffer_dir_.Append("enable"), "0");
+    WriteFile(buffer_dir_.Append("length"), "0");
+    WriteFile(buffer_dir_.Append("watermark"), "1");
+
+    device_node_ = temp_dir_.path().Append("node");
+    CHECK_EQ(mkfifo(device_node_.value().c_str(), 0600), 0);
+  }
+
+ protected:
+  // Adds a scan element named |name| to |scan_dir_|.
+  void AddElement(const std::string& name,
+                  int index,
+                  const std::string& type,
+                  bool enabled) {
+    WriteFile(scan_dir_.Append(name + "_en"), enabled ? "1" : "0");
+    WriteFile(scan_dir_.Append(name + "_index"), base::IntToString(index));
+    WriteFile(scan_dir_.Append(name + "_type"), type);
+  }
+
+  // Opens |device_node_| for writing. Must be called after |buffer_| has
+  // opened it for reading.
+  void OpenWriter() {
+    writer_.reset(HANDLE_EINTR(
+        open(device_node_.value().c_str(), O_WRONLY | O_NONBLOCK)));
+    CHECK(writer_.is_valid());
+  }
+
+  // Writes |data| to the device node.
+  void WriteScans(const std::string& data) {
+    CHECK_EQ(HANDLE_EINTR(write(writer_.get(), data.data(), data.size())),
+             static_cast<ssize_t>(data.size()));
+  }
+
+  base::ScopedTempDir temp_dir_;
+  base::FilePath sysfs_dir_;
+  base::FilePath scan_dir_;
+  base::FilePath buffer_dir_;
+  base::FilePath device_node_;
+  base::ScopedFD writer_;
+
+  IioBuffer buffer_;
+
+ private:
+  DISALLOW_COPY_AND_ASSIGN(IioBufferTest);
+};
+
+TEST_F(IioBufferTest, ParseScanType) {
+  IioBuffer::ScanType type;
+  ASSERT_TRUE(IioBuffer::ParseScanType("le:s12/16>>4", &type));
+  EXPECT_FALSE(type.big_endian);
+  EXPECT_TRUE(type.is_signed);
+  EXPECT_EQ(12, type.bits);
+  EXPECT_EQ(16, type.storage_bits);
+  EXPECT_EQ(4, type.shift);
+
+  ASSERT_TRUE(IioBuffer::ParseScanType("be:u32/32>>0", &type));
+  EXPECT_TRUE(type.big_endian);
+  EXPECT_FALSE(type.is_signed);
+  EXPECT_EQ(32, type.bits);
+  EXPECT_EQ(32, type.storage_bits);
+  EXPECT_EQ(0, type.shift);
+
+  EXPECT_FALSE(IioBuffer::ParseScanType("", &type));
+  EXPECT_FALSE(IioBuffer::ParseScanType("le:s16/16X3>>0", &type));
+  EXPECT_FALSE(IioBuffer::ParseScanType("le:s12/12>>0", &type));
+  EXPECT_FALSE(IioBuffer::ParseScanType("le:s16/16>>4", &type));
+  EXPECT_FALSE(IioBuffer::ParseScanType("me:s16/16>>0", &type));
+  EXPECT_FALSE(IioBuffer::ParseScanType("le:s16/16>>0 ", &type));
+}
+
+TEST_F(IioBufferTest, ReadSamples) {
+  // The 16-bit illuminance value should be followed by padding that aligns the
+  // 64-bit timestamp, giving 16-byte scans. The disabled element should be
+  // ignored.
+  AddElement("in_illuminance", 0, "le:u16/16>>0", false);
+  AddElement("in_intensity_ir", 1, "le:u32/32>>0", false);
+  AddElement("in_timestamp", 2, "le:s64/64>>0", true);
+  ASSERT_TRUE(
+      buffer_.Open(sysfs_dir_, device_node_, "in_illuminance", 1.0, 8, 2));
+  EXPECT_EQ("1", ReadFile(scan_dir_.Append("in_illuminance_en")));
+  EXPECT_EQ("1", ReadFile(buffer_dir_.Append("enable")));
+  EXPECT_EQ("8", ReadFile(buffer_dir_.Append("length")));
+  EXPECT_EQ("2", ReadFile(buffer_dir_.Append("watermark")));
+  OpenWriter();
+
+  // Nothing is queued yet.
+  std::vector<int64_t> values;
+  EXPECT_TRUE(buffer_.ReadSamples(&values));
+  EXPECT_TRUE(values.empty());
+
+  std::string data;
+  AppendLittleEndian(300, 8, &data);
+  AppendLittleEndian(12345678, 8, &data);
+  AppendLittleEndian(65535, 8, &data);
+  AppendLittleEndian(12345679, 8, &data);
+  AppendLittleEndian(7, 8, &data);
+  WriteScans(data);
+  EXPECT_TRUE(buffer_.ReadSamples(&values));
+  EXPECT_EQ((std::vector<int64_t>{300, 65535}), values);
+
+  // The partial scan should be completed by the next read.
+  values.clear();
+  WriteScans(std::string(8, '\0'));
+  EXPECT_TRUE(buffer_.ReadSamples(&values));
+  EXPECT_EQ(std::vector<int64_t>(1, 7), values);
+
+  // A closed writer should be reported as an error.
+  writer_.reset();
+  EXPECT_FALSE(buffer_.ReadSamples(&values));
+
+  buffer_.Close();
+  EXPECT_EQ("0", ReadFile(buffer_dir_.Append("enable")));
+  EXPECT_EQ(-1, buffer_.fd());
+}
+
+TEST_F(IioBufferTest, DecodeSignedShiftedValues) {
+  AddElement("in_illuminance", 0, "be:s12/16>>4", true);
+  ASSERT_TRUE(
+      buffer_.Open(sysfs_dir_, device_node_, "in_illuminance", 1.0, 8, 1));
+  OpenWriter();
+
+  // -5 and 2047 as 12-bit values, shifted left by 4 and stored big-endian.
+  WriteScans(std::string("\xff\xb0\x7f\xf0", 4));
+  std::vector<int64_t> values;
+  EXPECT_TRUE(buffer_.ReadSamples(&values));
+  EXPECT_EQ((std::vector<int64_t>{-5, 2047}), values);
+}
+
+TEST_F(IioBufferTest, OpenFailures) {
+  // The channel doesn't have a scan element.
+  AddElement("in_intensity_ir", 0, "le:u16/16>>0", false);
+  EXPECT_FALSE(
+      buffer_.Open(sysfs_dir_, device_node_, "in_illuminance", 1.0, 8, 1));
+  EXPECT_EQ("0", ReadFile(buffer_dir_.Append("enable")));
+
+  // The buffer is already in use.
+  AddElement("in_illuminance", 1, "le:u16/16>>0", false);
+  WriteFile(buffer_dir_.Append("enable"), "1");
+  EXPECT_FALSE(
+      buffer_.Open(sysfs_dir_, device_node_, "in_illuminance", 1.0, 8, 1));
+  EXPECT_EQ("0", ReadFile(scan_dir_.Append("in_illuminance_en")));
+
+  // The device node is missing. The channel and buffer should be left
+  // disabled.
+  WriteFile(buffer_dir_.Append("enable"), "0");
+  EXPECT_FALSE(buffer_.Open(sysfs_dir_,
+                            temp_dir_.path().Append("missing"),
+                            "in_illuminance",
+                            1.0,
+                            8,
+                            1));
+  EXPECT_EQ("0", ReadFile(scan_dir_.Append("in_illuminance_en")));
+  EXPECT_EQ("0", ReadFile(buffer_dir_.Append("enable")));
+  EXPECT_EQ(-1, buffer_.fd());
+}
+
+TEST_F(IioBufferTest, SelectTriggerAndFrequency) {
+  AddElement("in_illuminance", 0, "le:u16/16>>0", false);
+  WriteFile(sysfs_dir_.Append("name"), "cros-ec-light");
+  WriteFile(sysfs_dir_.Append("sampling_frequency"), "0");
+  const base::FilePath trigger_dir = sysfs_dir_.Append("trigger");
+  CHECK(base::CreateDirectory(trigger_dir));
+  WriteFile(trigger_dir.Append("current_trigger"), "");
+
+  // Without the device's data-ready trigger, no scans would ever be queued.
+  EXPECT_FALSE(
+      buffer_.Open(sysfs_dir_, device_node_, "in_illuminance", 2.0, 8, 1));
+  EXPECT_EQ("0", ReadFile(scan_dir_.Append("in_illuminance_en")));
+  EXPECT_EQ("0", ReadFile(buffer_dir_.Append("enable")));
+
+  const base::FilePath other_dir = temp_dir_.path().Append("trigger0");
+  const base::FilePath own_dir = temp_dir_.path().Append("trigger1");
+  CHECK(base::CreateDirectory(other_dir));
+  CHECK(base::CreateDirectory(own_dir));
+  WriteFile(other_dir.Append("name"), "cros-ec-accel-dev1");
+  WriteFile(own_dir.Append("name"), "cros-ec-light-dev0");
+  ASSERT_TRUE(
+      buffer_.Open(sysfs_dir_, device_node_, "in_illuminance", 2.0, 8, 1));
+  EXPECT_EQ("cros-ec-light-dev0",
+            ReadFile(trigger_dir.Append("current_trigger")));
+  EXPECT_EQ("2", ReadFile(sysfs_dir_.Append("sampling_frequency")));
+  EXPECT_DOUBLE_EQ(2.0, buffer_.sampling_frequency());
+
+  // The trigger should be deselected once the buffer is disabled.
+  buffer_.Close();
+  EXPECT_EQ("0", ReadFile(buffer_dir_.Append("enable")));
+  EXPECT_EQ("", ReadFile(trigger_dir.Append("current_trigger")));
+
+  // A trigger that someone else selected should be left alone.
+  WriteFile(trigger_dir.Append("current_trigger"), "hrtimer0");
+  ASSERT_TRUE(
+      buffer_.Open(sysfs_dir_, device_node_, "in_illuminance", 2.0, 8, 1));
+  buffer_.Close();
+  EXPECT_EQ("hrtimer0", ReadFile(trigger_dir.Append("current_trigger")));
+}
+
+}  // namespace system
+}  // namespace power_manager
@@ -275,22 +275,51 @@ uint32_t InputWatcher::GetDeviceTypes(
   return device_types;
 }
 
+// static
+uint32_t InputWatcher::GetHandledEventTypes(uint32_t device_types) {
+  uint32_t types = 0;
+  if (device_types & (DEVICE_LID_SWITCH | DEVICE_TABLET_MODE_SWITCH))
+    types |= 1u << EV_SW;
+  if (device_types & DEVICE_POWER_BUTTON)
+    types |= 1u << EV_KEY;
+  if (device_types & DEVICE_HOVER)
+    types |= (1u << EV_ABS) | (1u << EV_KEY) | (1u << EV_SYN);
+  return types;
+}
+
 void InputWatcher::OnNewEvents(EventDeviceInterface* device) {
   SendQueuedEvents();
 
-  std::vector<input_event> events;
-  if (!device->ReadEvents(&events))
+  if (!device->ReadEvents(&events_))
     return;
 
-  VLOG(1) << "Read " << events.size() << " event(s) from "
+  VLOG(1) << "Read " << events_.size() << " event(s) from "
           << device->GetDebugName();
   const uint32_t device_types = GetDeviceTypes(device);
-  for (size_t i = 0; i < events.size(); ++i) {
-    // Update |lid_state_| here instead of in ProcessEvent() so we can avoid
-    // modifying it in response to queued events.
-    if (device_types & DEVICE_LID_SWITCH)
-      GetLidStateFromEvent(events[i], &lid_state_);
-    ProcessEvent(events[i], device_types);
+  // Update |lid_state_| here instead of in ProcessEvent() so we can avoid
+  // modifying it in response to queued events.
+  ProcessEvents(events_.data(),
+                events_.size(),
+                device_types,
+                (device_types & DEVICE_LID_SWITCH) != 0);
+}
+
+void InputWatcher::ProcessEvents(const input_event* events,
+                                 size_t num_events,
+                                 uint32_t device_types,
+                                 bool update_lid_state) {
+  static_assert(EV_MAX < 32, "Event types don't fit in a uint32_t bitfield");
+  // Most events from keyboards and touch devices (e.g. EV_MSC scancodes and
+  // EV_REL motion) are of no interest to powerd and can be skipped without
+  // running the per-device-type checks in ProcessEvent().
+  const uint32_t handled_types = GetHandledEventTypes(device_types);
+  for (size_t i = 0; i < num_events; ++i) {
+    const input_event& event = events[i];
+    if (event.type > EV_MAX || !(handled_types & (1u << event.type)))
+      continue;
+    if (update_lid_state)
+      GetLidStateFromEvent(event, &lid_state_);
+    ProcessEvent(event, device_types);
   }
 }
 
@@ -5,6 +5,9 @@
 #ifndef POWER_MANAGER_POWERD_SYSTEM_INPUT_WATCHER_H_
 #define POWER_MANAGER_POWERD_SYSTEM_INPUT_WATCHER_H_
 
+#include <stddef.h>
+#include <stdint.h>
+
 #include <map>
 #include <memory>
 #include <set>
@@ -55,6 +58,21 @@ class InputWatcher : public InputWatcherInterface,
   // to keyboard events.
   static const char kPowerButtonToSkipForLegacy[];
 
+  // Different types of devices monitored by InputWatcher. It's possible for a
+  // given device to fulfill more than one role.
+  enum DeviceType {
+    DEVICE_NONE = 0,
+    DEVICE_POWER_BUTTON = 1 << 0,
+    DEVICE_LID_SWITCH = 1 << 1,
+    DEVICE_TABLET_MODE_SWITCH = 1 << 2,
+    DEVICE_HOVER = 1 << 3,
+  };
+
+  // Returns a bitfield with a (1 << EV_*) bit set for each event type that
+  // devices described by |device_types| (a DeviceType bitfield) can report
+  // events of interest with.
+  static uint32_t GetHandledEventTypes(uint32_t device_types);
+
   InputWatcher();
   virtual ~InputWatcher();
 
@@ -88,22 +106,20 @@ class InputWatcher : public InputWatcherInterface,
                    UdevAction action) override;
 
  private:
-  // Different types of devices monitored by InputWatcher. It's possible for a
-  // given device to fulfill more than one role.
-  enum DeviceType {
-    DEVICE_NONE = 0,
-    DEVICE_POWER_BUTTON = 1 << 0,
-    DEVICE_LID_SWITCH = 1 << 1,
-    DEVICE_TABLET_MODE_SWITCH = 1 << 2,
-    DEVICE_HOVER = 1 << 3,
-  };
-
   // Returns a bitfield of DeviceType values describing |device|.
   uint32_t GetDeviceTypes(const EventDeviceInterface* device) const;
 
   // Flushes queued events and reads new events from |device|.
   void OnNewEvents(EventDeviceInterface* device);
 
+  // Calls ProcessEvent() for each of the |num_events| events starting at
+  // |events|, skipping events with types that aren't handled for
+  // |device_types|. |lid_state_| is also updated if |update_lid_state| is true.
+  void ProcessEvents(const input_event* events,
+                     size_t num_events,
+                     uint32_t device_types,
+                     bool update_lid_state);
+
   // Updates internal state and notifies observers in response to |event|.
   // |device_types| is a DeviceType bitfield describing the device from which
   // the event was read.
@@ -180,6 +196,10 @@ class InputWatcher : public InputWatcherInterface,
   bool single_touch_hover_valid_;
   bool single_touch_hover_distance_nonzero_;
 
+  // Buffer that OnNewEvents() reads events into, reused across calls to avoid
+  // allocating for each read.
+  std::vector<input_event> events_;
+
   // (Events, DeviceType-bitfield) tuples read from |lid_device_| by
   // QueryLidState() that haven't yet been sent to observers.
   std::vector<std::pair<input_event, uint32_t>> queued_events_;
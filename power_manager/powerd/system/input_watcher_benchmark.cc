@@ -0,0 +1,220 @@
+// Copyright 2016 The Chromium OS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// Measures how long InputWatcher takes to dispatch synthetic streams of input
+// events resembling those reported by a hover-capable touchpad, a keyboard that
+// also reports power button events, and a lid switch. Each stream is delivered
+// in batches of up to EventDevice::kMaxEventsPerRead events, as when reading
+// from /dev/input/eventN.
+
+#include <linux/input.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include <memory>
+#include <string>
+#include <utility>
+
+#include <base/at_exit.h>
+#include <base/files/file_path.h>
+#include <base/files/file_util.h>
+#include <base/files/scoped_temp_dir.h>
+#include <base/format_macros.h>
+#include <base/logging.h>
+#include <base/macros.h>
+#include <base/memory/linked_ptr.h>
+#include <base/message_loop/message_loop.h>
+#include <base/time/time.h>
+
+#include "power_manager/common/fake_prefs.h"
+#include "power_manager/common/power_constants.h"
+#include "power_manager/powerd/system/event_device.h"
+#include "power_manager/powerd/system/event_device_stub.h"
+#include "power_manager/powerd/system/input_observer.h"
+#include "power_manager/powerd/system/input_watcher.h"
+#include "power_manager/powerd/system/udev_stub.h"
+
+namespace {
+
+using power_manager::system::EventDevice;
+using power_manager::system::EventDeviceStub;
+
+const int kNumBatches = 20000;
+
+struct Event {
+  uint16_t type;
+  uint16_t code;
+  int32_t value;
+};
+
+// One frame of a two-finger touchpad report. Only the tracking IDs and the
+// SYN_REPORT matter for hover detection.
+const Event kTouchpadFrame[] = {
+    {EV_ABS, ABS_MT_SLOT, 0},
+    {EV_ABS, ABS_MT_TRACKING_ID, 10},
+    {EV_ABS, ABS_MT_POSITION_X, 500},
+    {EV_ABS, ABS_MT_POSITION_Y, 300},
+    {EV_ABS, ABS_MT_PRESSURE, 40},
+    {EV_ABS, ABS_MT_SLOT, 1},
+    {EV_ABS, ABS_MT_TRACKING_ID, 11},
+    {EV_ABS, ABS_MT_POSITION_X, 700},
+    {EV_ABS, ABS_MT_POSITION_Y, 320},
+    {EV_ABS, ABS_MT_PRESSURE, 35},
+    {EV_ABS, ABS_X, 500},
+    {EV_ABS, ABS_Y, 300},
+    {EV_ABS, ABS_PRESSURE, 40},
+    {EV_KEY, BTN_TOOL_DOUBLETAP, 1},
+    {EV_MSC, MSC_SCAN, 0},
+    {EV_SYN, SYN_REPORT, 0},
+};
+
+// A keystroke on a keyboard that also reports the power button.
+const Event kKeyboardFrame[] = {
+    {EV_MSC, MSC_SCAN, 30},
+    {EV_KEY, KEY_A, 1},
+    {EV_SYN, SYN_REPORT, 0},
+    {EV_MSC, MSC_SCAN, 30},
+    {EV_KEY, KEY_A, 0},
+    {EV_SYN, SYN_REPORT, 0},
+};
+
+// The lid being closed and opened.
+const Event kLidFrame[] = {
+    {EV_SW, SW_LID, 1},
+    {EV_SYN, SYN_REPORT, 0},
+    {EV_SW, SW_LID, 0},
+    {EV_SYN, SYN_REPORT, 0},
+};
+
+// Counts notifications so that the work done by observers is comparable to
+// powerd's.
+class CountingObserver : public power_manager::system::InputObserver {
+ public:
+  CountingObserver() : num_notifications_(0) {}
+  ~CountingObserver() override {}
+
+  int64_t num_notifications() const { return num_notifications_; }
+
+  // InputObserver implementation:
+  void OnLidEvent(power_manager::LidState state) override {
+    num_notifications_++;
+  }
+  void OnTabletModeEvent(power_manager::TabletMode mode) override {
+    num_notifications_++;
+  }
+  void OnPowerButtonEvent(power_manager::ButtonState state) override {
+    num_notifications_++;
+  }
+  void OnHoverStateChange(bool hovering) override { num_notifications_++; }
+
+ private:
+  int64_t num_notifications_;
+
+  DISALLOW_COPY_AND_ASSIGN(CountingObserver);
+};
+
+// Repeatedly fills |device| with a full batch of events from |frame| and
+// notifies InputWatcher about it, then prints the time per batch and per event.
+void Run(const char* name,
+         EventDeviceStub* device,
+         const Event* frame,
+         size_t frame_size,
+         const CountingObserver& observer) {
+  const size_t batch_size =
+      EventDevice::kMaxEventsPerRead / frame_size * frame_size;
+  const int64_t start_notifications = observer.num_notifications();
+  const base::TimeTicks start = base::TimeTicks::Now();
+  for (int i = 0; i < kNumBatches; ++i) {
+    for (size_t j = 0; j < batch_size; ++j) {
+      const Event& event = frame[j % frame_size];
+      device->AppendEvent(event.type, event.code, event.value);
+    }
+    device->NotifyAboutEvents();
+  }
+  const base::TimeDelta elapsed = base::TimeTicks::Now() - start;
+  printf("%-10s %8zu %12.2f %10.1f %14" PRId64 "\n",
+         name,
+         batch_size,
+         elapsed.InMicrosecondsF() / kNumBatches,
+         elapsed.InMicrosecondsF() * 1000 / (kNumBatches * batch_size),
+         observer.num_notifications() - start_notifications);
+}
+
+// Registers |device| with |factory| as |name| within |dev_input_dir|.
+void AddDevice(const base::FilePath& dev_input_dir,
+               const std::string& name,
+               linked_ptr<EventDeviceStub> device,
+               power_manager::system::EventDeviceFactoryStub* factory) {
+  const base::FilePath path = dev_input_dir.Append(name);
+  CHECK_EQ(0, base::WriteFile(path, "", 0));
+  factory->RegisterDevice(path, device);
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  base::AtExitManager at_exit;
+  base::MessageLoopForIO message_loop;
+  logging::SetMinLogLevel(logging::LOG_WARNING);
+
+  base::ScopedTempDir temp_dir;
+  CHECK(temp_dir.CreateUniqueTempDir());
+  const base::FilePath dev_input_dir = temp_dir.path().Append("dev/input");
+  const base::FilePath sys_class_input_dir =
+      temp_dir.path().Append("sys/class/input");
+  CHECK(base::CreateDirectory(dev_input_dir));
+  CHECK(base::CreateDirectory(sys_class_input_dir));
+
+  std::unique_ptr<power_manager::system::EventDeviceFactoryStub> factory(
+      new power_manager::system::EventDeviceFactoryStub);
+
+  linked_ptr<EventDeviceStub> touchpad(new EventDeviceStub);
+  touchpad->set_debug_name("touchpad");
+  touchpad->set_hover_supported(true);
+  touchpad->set_has_left_button(true);
+  AddDevice(dev_input_dir, "event0", touchpad, factory.get());
+
+  linked_ptr<EventDeviceStub> keyboard(new EventDeviceStub);
+  keyboard->set_debug_name("keyboard");
+  keyboard->set_is_power_button(true);
+  AddDevice(dev_input_dir, "event1", keyboard, factory.get());
+
+  linked_ptr<EventDeviceStub> lid(new EventDeviceStub);
+  lid->set_debug_name("lid");
+  lid->set_is_lid_switch(true);
+  AddDevice(dev_input_dir, "event2", lid, factory.get());
+
+  power_manager::FakePrefs prefs;
+  prefs.SetInt64(power_manager::kUseLidPref, 1);
+  prefs.SetInt64(power_manager::kDetectHoverPref, 1);
+  power_manager::system::UdevStub udev;
+  power_manager::system::InputWatcher watcher;
+  watcher.set_dev_input_path_for_testing(dev_input_dir);
+  watcher.set_sys_class_input_path_for_testing(sys_class_input_dir);
+  CHECK(watcher.Init(std::move(factory), &prefs, &udev));
+
+  CountingObserver observer;
+  watcher.AddObserver(&observer);
+
+  printf("%-10s %8s %12s %10s %14s\n",
+         "stream",
+         "batch",
+         "us/batch",
+         "ns/event",
+         "notifications");
+  Run("touchpad",
+      touchpad.get(),
+      kTouchpadFrame,
+      arraysize(kTouchpadFrame),
+      observer);
+  Run("keyboard",
+      keyboard.get(),
+      kKeyboardFrame,
+      arraysize(kKeyboardFrame),
+      observer);
+  Run("lid", lid.get(), kLidFrame, arraysize(kLidFrame), observer);
+
+  watcher.RemoveObserver(&observer);
+  return 0;
+}
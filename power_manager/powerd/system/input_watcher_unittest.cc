@@ -637,6 +637,55 @@ TEST_F(InputWatcherTest, RegisterForUdevEvents) {
       udev_.HasSubsystemObserver(InputWatcher::kInputUdevSubsystem, dead_ptr));
 }
 
+TEST_F(InputWatcherTest, IgnoreUnhandledEventTypes) {
+  linked_ptr<EventDeviceStub> device(new EventDeviceStub);
+  device->set_is_power_button(true);
+  device->set_is_lid_switch(true);
+  AddDevice("event0", device);
+
+  linked_ptr<EventDeviceStub> touchpad(new EventDeviceStub);
+  touchpad->set_hover_supported(true);
+  touchpad->set_has_left_button(true);
+  AddDevice("event1", touchpad);
+
+  detect_hover_pref_ = 1;
+  Init();
+
+  // Events of types that aren't reported by power buttons or lid switches,
+  // including out-of-range types, should be skipped without disturbing the
+  // handling of the events around them.
+  device->AppendEvent(EV_MSC, MSC_SCAN, 1);
+  device->AppendEvent(EV_SW, SW_LID, 1);
+  device->AppendEvent(EV_SYN, SYN_REPORT, 0);
+  device->AppendEvent(EV_REL, REL_X, 5);
+  device->AppendEvent(EV_KEY, KEY_POWER, 1);
+  device->AppendEvent(0xff, KEY_POWER, 0);
+  device->AppendEvent(EV_KEY, KEY_POWER, 0);
+  device->NotifyAboutEvents();
+  EXPECT_EQ(JoinActions(kLidClosedAction,
+                        kPowerButtonDownAction,
+                        kPowerButtonUpAction,
+                        NULL),
+            observer_->GetActions());
+  EXPECT_EQ(LidState::CLOSED, input_watcher_->QueryLidState());
+
+  // Hover devices report hovering through EV_ABS, EV_KEY and EV_SYN events,
+  // so those are all handled, and only the change in hover state should be
+  // reported for the position updates below. EV_MSC events should be skipped.
+  EXPECT_EQ((1u << EV_ABS) | (1u << EV_KEY) | (1u << EV_SYN),
+            InputWatcher::GetHandledEventTypes(InputWatcher::DEVICE_HOVER));
+  touchpad->AppendEvent(EV_ABS, ABS_MT_TRACKING_ID, 0);
+  touchpad->AppendEvent(EV_ABS, ABS_MT_POSITION_X, 100);
+  touchpad->AppendEvent(EV_ABS, ABS_MT_POSITION_Y, 200);
+  touchpad->AppendEvent(EV_MSC, MSC_SCAN, 1000);
+  touchpad->AppendEvent(EV_SYN, SYN_REPORT, 0);
+  touchpad->AppendEvent(EV_ABS, ABS_MT_POSITION_X, 110);
+  touchpad->AppendEvent(EV_MSC, MSC_SCAN, 2000);
+  touchpad->AppendEvent(EV_SYN, SYN_REPORT, 0);
+  touchpad->NotifyAboutEvents();
+  EXPECT_EQ(kHoverOnAction, observer_->GetActions());
+}
+
 TEST_F(InputWatcherTest, TolerateMissingDevInputDirectory) {
   // /dev/input may not exist on systems that lack lid switches or power
   // buttons: http://b/29239109. Check that InputWatcher doesn't report failure
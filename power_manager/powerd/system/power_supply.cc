@@ -10,7 +10,6 @@
 #include <utility>
 
 #include <base/bind.h>
-#include <base/files/file_enumerator.h>
 #include <base/files/file_path.h>
 #include <base/files/file_util.h>
 #include <base/logging.h>
@@ -25,6 +24,7 @@
 #include "power_manager/common/power_constants.h"
 #include "power_manager/common/prefs.h"
 #include "power_manager/common/util.h"
+#include "power_manager/powerd/system/power_supply_sampler.h"
 #include "power_manager/powerd/system/udev.h"
 #include "power_manager/proto_bindings/power_supply_properties.pb.h"
 
@@ -33,13 +33,15 @@ namespace system {
 
 namespace {
 
-// sysfs reports only integer values.  For non-integral values, it scales them
-// up by 10^6.  This factor scales them back down accordingly.
-const double kDoubleScaleFactor = 0.000001;
-
 // Default time interval between polls, in milliseconds.
 const int kDefaultPollMs = 30000;
 
+// Time to wait after a udev event before updating the status, in
+// milliseconds. Connecting or disconnecting a charger produces a burst of
+// events for the line power source and the battery; they're handled by a
+// single update.
+const int kUdevEventDelayMs = 100;
+
 // Default values for |battery_stabilized_after_*_delay_|, in milliseconds.
 const int kDefaultBatteryStabilizedAfterStartupDelayMs = 5000;
 const int kDefaultBatteryStabilizedAfterLinePowerConnectedDelayMs = 5000;
@@ -67,37 +69,6 @@ const char kBatteryStatusFull[] = "Full";
 // which the system is being charged.
 const char kLinePowerStatusCharging[] = "Charging";
 
-// Reads the contents of |filename| within |directory| into |out|, trimming
-// trailing whitespace.  Returns true on success.
-bool ReadAndTrimString(const base::FilePath& directory,
-                       const std::string& filename,
-                       std::string* out) {
-  if (!base::ReadFileToString(directory.Append(filename), out))
-    return false;
-
-  base::TrimWhitespaceASCII(*out, base::TRIM_TRAILING, out);
-  return true;
-}
-
-// Reads a 64-bit integer value from a file and returns true on success.
-bool ReadInt64(const base::FilePath& directory,
-               const std::string& filename,
-               int64_t* out) {
-  std::string buffer;
-  if (!ReadAndTrimString(directory, filename, &buffer))
-    return false;
-  return base::StringToInt64(buffer, out);
-}
-
-// Reads an integer value and scales it to a double (see |kDoubleScaleFactor|.
-// Returns 0.0 on failure.
-double ReadScaledDouble(const base::FilePath& directory,
-                        const std::string& filename) {
-  int64_t value = 0;
-  return ReadInt64(directory, filename, &value) ? kDoubleScaleFactor * value
-                                                : 0.0;
-}
-
 // Returns true if |type|, a power supply type read from a "type" file in
 // sysfs, indicates USB BC1.2 types.
 bool IsLowPowerUsbChargerType(const std::string& type) {
@@ -115,15 +86,17 @@ bool IsDualRoleType(const std::string& type) {
 
 // Returns true if |path|, a sysfs directory, corresponds to an external
 // peripheral (e.g. a wireless mouse or keyboard).
-bool IsExternalPeripheral(const base::FilePath& path) {
+bool IsExternalPeripheral(PowerSupplySampler* sampler,
+                          const base::FilePath& path) {
   std::string scope;
-  return ReadAndTrimString(path, "scope", &scope) && scope == "Device";
+  return sampler->ReadString(path, "scope", &scope) && scope == "Device";
 }
 
 // Returns true if |path|, a sysfs directory, corresponds to a battery.
-bool IsBatteryPresent(const base::FilePath& path) {
+bool IsBatteryPresent(PowerSupplySampler* sampler,
+                      const base::FilePath& path) {
   int64_t present = 0;
-  return ReadInt64(path, "present", &present) && present != 0;
+  return sampler->ReadInt64(path, "present", &present) && present != 0;
 }
 
 // Returns a string describing |type|.
@@ -413,6 +386,15 @@ void PowerSupply::TestApi::AdvanceTime(base::TimeDelta interval) {
                                                       interval);
 }
 
+bool PowerSupply::TestApi::TriggerUdevEventTimeout() {
+  if (!power_supply_->udev_event_timer_.IsRunning())
+    return false;
+
+  power_supply_->udev_event_timer_.Stop();
+  power_supply_->HandleUdevEventTimeout();
+  return true;
+}
+
 bool PowerSupply::TestApi::TriggerPollTimeout() {
   if (!power_supply_->poll_timer_.IsRunning())
     return false;
@@ -453,6 +435,7 @@ void PowerSupply::Init(const base::FilePath& power_supply_path,
 
   prefs_ = prefs;
   power_supply_path_ = power_supply_path;
+  sampler_.reset(new PowerSupplySampler(power_supply_path_));
 
   poll_delay_ = GetMsPref(kBatteryPollIntervalPref, kDefaultPollMs);
   battery_stabilized_after_startup_delay_ =
@@ -542,6 +525,9 @@ PowerStatus PowerSupply::GetPowerStatus() const {
 }
 
 bool PowerSupply::RefreshImmediately() {
+  // Explicit refreshes (e.g. at startup and in dark resume) look for power
+  // supplies again instead of trusting that no udev events were missed.
+  sampler_->Invalidate();
   return PerformUpdate(UpdatePolicy::UNCONDITIONALLY,
                        NotifyPolicy::ASYNCHRONOUSLY);
 }
@@ -554,6 +540,7 @@ void PowerSupply::SetSuspended(bool suspended) {
   if (is_suspended_) {
     VLOG(1) << "Stopping polling due to suspend";
     poll_timer_.Stop();
+    udev_event_timer_.Stop();
     current_poll_delay_for_testing_ = base::TimeDelta();
   } else {
     DeferBatterySampling(battery_stabilized_after_resume_delay_);
@@ -586,12 +573,17 @@ void PowerSupply::OnUdevEvent(const std::string& subsystem,
                               const std::string& sysname,
                               UdevAction action) {
   VLOG(1) << "Got udev event for " << sysname;
-  // Bail out of the update if the available power sources didn't actually
-  // change to avoid recording new samples and updating battery estimates in
-  // response to spurious udev events (see http://crosbug.com/p/37403).
-  if (!is_suspended_) {
-    PerformUpdate(UpdatePolicy::ONLY_IF_STATE_CHANGED,
-                  NotifyPolicy::SYNCHRONOUSLY);
+  // The set of supplies and their attributes only changes when a supply is
+  // added or removed.
+  if (action == UdevAction::ADD || action == UdevAction::REMOVE)
+    sampler_->Invalidate();
+
+  if (!is_suspended_ && !udev_event_timer_.IsRunning()) {
+    udev_event_timer_.Start(
+        FROM_HERE,
+        base::TimeDelta::FromMilliseconds(kUdevEventDelayMs),
+        this,
+        &PowerSupply::HandleUdevEventTimeout);
   }
 }
 
@@ -645,17 +637,13 @@ bool PowerSupply::UpdatePowerStatus(UpdatePolicy policy) {
   base::FilePath battery_path;
 
   // Iterate through sysfs's power supply information.
-  base::FileEnumerator file_enum(
-      power_supply_path_, false, base::FileEnumerator::DIRECTORIES);
-  for (base::FilePath path = file_enum.Next(); !path.empty();
-       path = file_enum.Next()) {
-    if (IsExternalPeripheral(path))
+  for (const base::FilePath& path : sampler_->GetSupplyPaths()) {
+    if (IsExternalPeripheral(sampler_.get(), path))
       continue;
 
     std::string type;
-    if (!base::ReadFileToString(path.Append("type"), &type))
+    if (!sampler_->ReadString(path, "type", &type))
       continue;
-    base::TrimWhitespaceASCII(type, base::TRIM_TRAILING, &type);
 
     saw_power_source = true;
 
@@ -671,7 +659,8 @@ bool PowerSupply::UpdatePowerStatus(UpdatePolicy policy) {
 
   // If no battery was found, assume that the system is actually on AC power.
   if (!status.line_power_on &&
-      (battery_path.empty() || !IsBatteryPresent(battery_path))) {
+      (battery_path.empty() ||
+       !IsBatteryPresent(sampler_.get(), battery_path))) {
     if (saw_power_source) {
       // Batteryless Chromeboxes sometimes don't report any power sources. If we
       // saw at least one source but it wasn't online, the battery status might
@@ -763,14 +752,14 @@ void PowerSupply::ReadLinePowerDirectory(const base::FilePath& path,
 
   // Bidirectional/dual-role ports export a "status" field.
   std::string line_status;
-  ReadAndTrimString(path, "status", &line_status);
+  sampler_->ReadString(path, "status", &line_status);
   const bool dual_role_port = !line_status.empty();
   if (dual_role_port)
     status->supports_dual_role_devices = true;
 
   // An "Unknown" type indicates a sink-only device that can't supply power.
   std::string type;
-  ReadAndTrimString(path, "type", &type);
+  sampler_->ReadString(path, "type", &type);
   if (type == kUnknownType)
     return;
   const bool dual_role_connected = IsDualRoleType(type);
@@ -779,7 +768,8 @@ void PowerSupply::ReadLinePowerDirectory(const base::FilePath& path,
   // case a value of 0 indicates we're connected to a dual-role device but not
   // sinking power.
   int64_t online = 0;
-  if ((!ReadInt64(path, "online", &online) || !online) && !dual_role_connected)
+  if ((!sampler_->ReadInt64(path, "online", &online) || !online) &&
+      !dual_role_connected)
     return;
 
   // If we've made it this far, there's a dedicated source or dual-role device
@@ -794,11 +784,12 @@ void PowerSupply::ReadLinePowerDirectory(const base::FilePath& path,
   // additional discussion.
   port->active_by_default = !dual_role_port || !dual_role_connected;
 
-  ReadAndTrimString(path, "manufacturer", &port->manufacturer_id);
-  ReadAndTrimString(path, "model_name", &port->model_id);
+  sampler_->ReadString(path, "manufacturer", &port->manufacturer_id);
+  sampler_->ReadString(path, "model_name", &port->model_id);
 
-  const double max_voltage = ReadScaledDouble(path, "voltage_max_design");
-  const double max_current = ReadScaledDouble(path, "current_max");
+  const double max_voltage =
+      sampler_->ReadScaledDouble(path, "voltage_max_design");
+  const double max_current = sampler_->ReadScaledDouble(path, "current_max");
   port->max_power = max_voltage * max_current;  // watts
 
   VLOG(1) << "Added power source " << port->id << ":"
@@ -821,9 +812,9 @@ void PowerSupply::ReadLinePowerDirectory(const base::FilePath& path,
   status->line_power_on = true;
   status->line_power_path = path.value();
   status->line_power_type = type;
-  status->line_power_voltage = ReadScaledDouble(path, "voltage_now");
+  status->line_power_voltage = sampler_->ReadScaledDouble(path, "voltage_now");
   status->line_power_max_voltage = max_voltage;
-  status->line_power_current = ReadScaledDouble(path, "current_now");
+  status->line_power_current = sampler_->ReadScaledDouble(path, "current_now");
   status->line_power_max_current = max_current;
 
   // The USB PD driver reports the maximum power as being 0 watts while it's
@@ -853,24 +844,24 @@ bool PowerSupply::ReadBatteryDirectory(const base::FilePath& path,
                                        PowerStatus* status) {
   VLOG(1) << "Reading battery status from " << path.value();
   status->battery_path = path.value();
-  status->battery_is_present = IsBatteryPresent(path);
+  status->battery_is_present = IsBatteryPresent(sampler_.get(), path);
   if (!status->battery_is_present)
     return true;
 
   std::string status_value;
-  ReadAndTrimString(path, "status", &status_value);
+  sampler_->ReadString(path, "status", &status_value);
 
   // POWER_SUPPLY_PROP_VENDOR does not seem to be a valid property
   // defined in <linux/power_supply.h>.
-  ReadAndTrimString(
+  sampler_->ReadString(
       path,
-      base::PathExists(path.Append("manufacturer")) ? "manufacturer" : "vendor",
+      sampler_->HasAttribute(path, "manufacturer") ? "manufacturer" : "vendor",
       &status->battery_vendor);
-  ReadAndTrimString(path, "model_name", &status->battery_model_name);
-  ReadAndTrimString(path, "serial_number", &status->battery_serial);
-  ReadAndTrimString(path, "technology", &status->battery_technology);
+  sampler_->ReadString(path, "model_name", &status->battery_model_name);
+  sampler_->ReadString(path, "serial_number", &status->battery_serial);
+  sampler_->ReadString(path, "technology", &status->battery_technology);
 
-  double voltage = ReadScaledDouble(path, "voltage_now");
+  double voltage = sampler_->ReadScaledDouble(path, "voltage_now");
   status->battery_voltage = voltage;
 
   // Attempt to determine nominal voltage for time-remaining calculations. This
@@ -879,10 +870,10 @@ bool PowerSupply::ReadBatteryDirectory(const base::FilePath& path,
   // Some batteries don't have a voltage_min/max_design attribute, so just use
   // the current voltage in that case.
   double nominal_voltage = voltage;
-  if (base::PathExists(path.Append("voltage_min_design")))
-    nominal_voltage = ReadScaledDouble(path, "voltage_min_design");
-  else if (base::PathExists(path.Append("voltage_max_design")))
-    nominal_voltage = ReadScaledDouble(path, "voltage_max_design");
+  if (sampler_->HasAttribute(path, "voltage_min_design"))
+    nominal_voltage = sampler_->ReadScaledDouble(path, "voltage_min_design");
+  else if (sampler_->HasAttribute(path, "voltage_max_design"))
+    nominal_voltage = sampler_->ReadScaledDouble(path, "voltage_max_design");
 
   // Nominal voltage is not required to obtain the charge level; if it's
   // missing, just use |battery_voltage|. Save the fact that it was zero so it
@@ -924,20 +915,22 @@ bool PowerSupply::ReadBatteryDirectory(const base::FilePath& path,
   double charge = 0;
   double energy = 0;
 
-  if (base::PathExists(path.Append("energy_now")))
-    energy = ReadScaledDouble(path, "energy_now");
+  if (sampler_->HasAttribute(path, "energy_now"))
+    energy = sampler_->ReadScaledDouble(path, "energy_now");
 
-  if (base::PathExists(path.Append("charge_full"))) {
-    charge_full = ReadScaledDouble(path, "charge_full");
-    charge_full_design = ReadScaledDouble(path, "charge_full_design");
-    charge = ReadScaledDouble(path, "charge_now");
+  if (sampler_->HasAttribute(path, "charge_full")) {
+    charge_full = sampler_->ReadScaledDouble(path, "charge_full");
+    charge_full_design = sampler_->ReadScaledDouble(path, "charge_full_design");
+    charge = sampler_->ReadScaledDouble(path, "charge_now");
     if (energy <= 0.0)
       energy = charge * nominal_voltage;
-  } else if (base::PathExists(path.Append("energy_full"))) {
+  } else if (sampler_->HasAttribute(path, "energy_full")) {
     DCHECK_GT(nominal_voltage, 0);
-    charge_full = ReadScaledDouble(path, "energy_full") / nominal_voltage;
+    charge_full =
+        sampler_->ReadScaledDouble(path, "energy_full") / nominal_voltage;
     charge_full_design =
-        ReadScaledDouble(path, "energy_full_design") / nominal_voltage;
+        sampler_->ReadScaledDouble(path, "energy_full_design") /
+        nominal_voltage;
     charge = energy / nominal_voltage;
   } else {
     LOG(WARNING) << "Ignoring reading without battery charge/energy";
@@ -963,9 +956,10 @@ bool PowerSupply::ReadBatteryDirectory(const base::FilePath& path,
   // The current can be reported as negative on some systems but not on others,
   // so it can't be used to determine whether the battery is charging or
   // discharging.
-  double current = base::PathExists(path.Append("power_now"))
-                       ? fabs(ReadScaledDouble(path, "power_now")) / voltage
-                       : fabs(ReadScaledDouble(path, "current_now"));
+  double current =
+      sampler_->HasAttribute(path, "power_now")
+          ? fabs(sampler_->ReadScaledDouble(path, "power_now")) / voltage
+          : fabs(sampler_->ReadScaledDouble(path, "current_now"));
   status->battery_current = current;
   status->battery_energy_rate = current * voltage;
 
@@ -1120,6 +1114,14 @@ void PowerSupply::SchedulePoll() {
   current_poll_delay_for_testing_ = delay;
 }
 
+void PowerSupply::HandleUdevEventTimeout() {
+  // Bail out of the update if the available power sources didn't actually
+  // change to avoid recording new samples and updating battery estimates in
+  // response to spurious udev events (see http://crosbug.com/p/37403).
+  PerformUpdate(UpdatePolicy::ONLY_IF_STATE_CHANGED,
+                NotifyPolicy::SYNCHRONOUSLY);
+}
+
 void PowerSupply::HandlePollTimeout() {
   current_poll_delay_for_testing_ = base::TimeDelta();
   PerformUpdate(UpdatePolicy::UNCONDITIONALLY, NotifyPolicy::SYNCHRONOUSLY);
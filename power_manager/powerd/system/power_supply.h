@@ -36,6 +36,7 @@ enum class PowerSupplyType;
 namespace system {
 
 struct PowerStatus;
+class PowerSupplySampler;
 class UdevInterface;
 
 // Copies fields from |status| into |proto|.
@@ -236,6 +237,8 @@ class PowerSupply : public PowerSupplyInterface, public UdevSubsystemObserver {
       return power_supply_->current_poll_delay_for_testing_;
     }
 
+    PowerSupplySampler* sampler() { return power_supply_->sampler_.get(); }
+
     // Returns the time that will be used as "now".
     base::TimeTicks GetCurrentTime() const;
 
@@ -249,6 +252,10 @@ class PowerSupply : public PowerSupplyInterface, public UdevSubsystemObserver {
     // Returns false otherwise.
     bool TriggerPollTimeout() WARN_UNUSED_RESULT;
 
+    // If |udev_event_timer_| was running, calls HandleUdevEventTimeout() and
+    // returns true. Returns false otherwise.
+    bool TriggerUdevEventTimeout() WARN_UNUSED_RESULT;
+
    private:
     PowerSupply* power_supply_;  // weak
 
@@ -383,6 +390,10 @@ class PowerSupply : public PowerSupplyInterface, public UdevSubsystemObserver {
   // Schedules |poll_timer_| to call HandlePollTimeout().
   void SchedulePoll();
 
+  // Handles |udev_event_timer_| firing. Updates |power_status_| if the power
+  // sources or battery state changed.
+  void HandleUdevEventTimeout();
+
   // Handles |poll_timer_| firing. Updates |power_status_| and reschedules the
   // timer.
   void HandlePollTimeout();
@@ -407,6 +418,9 @@ class PowerSupply : public PowerSupplyInterface, public UdevSubsystemObserver {
   // supplies.
   base::FilePath power_supply_path_;
 
+  // Reads the power supplies' attributes from |power_supply_path_|.
+  std::unique_ptr<PowerSupplySampler> sampler_;
+
   // Remaining battery time at which the system will shut down automatically.
   // Empty if unset.
   base::TimeDelta low_battery_shutdown_time_;
@@ -464,6 +478,10 @@ class PowerSupply : public PowerSupplyInterface, public UdevSubsystemObserver {
   // Delay used when |poll_timer_| was last started.
   base::TimeDelta current_poll_delay_for_testing_;
 
+  // Calls HandleUdevEventTimeout(). Started by the first udev event in a
+  // burst; later events in the burst are handled by the same update.
+  base::OneShotTimer udev_event_timer_;
+
   // Calls NotifyObservers().
   base::CancelableClosure notify_observers_task_;
 
@@ -0,0 +1,124 @@
+// Copyright 2016 The Chromium OS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// Measures the cost of a PowerSupply update against a fake sysfs tree with a
+// battery, an AC adapter, and two USB PD ports: once when the supplies are
+// rediscovered and every attribute is reopened (as every update used to do),
+// and once for a periodic poll that rereads the already-open attributes.
+
+#include <stdio.h>
+
+#include <string>
+
+#include <base/at_exit.h>
+#include <base/files/file_path.h>
+#include <base/files/file_util.h>
+#include <base/files/scoped_temp_dir.h>
+#include <base/logging.h>
+#include <base/message_loop/message_loop.h>
+#include <base/time/time.h>
+
+#include "power_manager/common/fake_prefs.h"
+#include "power_manager/common/power_constants.h"
+#include "power_manager/powerd/system/power_supply.h"
+#include "power_manager/powerd/system/power_supply_sampler.h"
+#include "power_manager/powerd/system/udev_stub.h"
+
+namespace {
+
+const int kNumSamples = 2000;
+
+void WriteValue(const base::FilePath& dir,
+                const std::string& name,
+                const std::string& value) {
+  CHECK_EQ(static_cast<int>(value.size()),
+           base::WriteFile(dir.Append(name), value.data(), value.size()));
+}
+
+void CreateSysfsTree(const base::FilePath& root) {
+  const base::FilePath battery = root.Append("BAT0");
+  CHECK(base::CreateDirectory(battery));
+  WriteValue(battery, "type", "Battery\n");
+  WriteValue(battery, "present", "1\n");
+  WriteValue(battery, "status", "Discharging\n");
+  WriteValue(battery, "manufacturer", "ACME\n");
+  WriteValue(battery, "model_name", "Battery\n");
+  WriteValue(battery, "serial_number", "1234\n");
+  WriteValue(battery, "technology", "Li-ion\n");
+  WriteValue(battery, "voltage_now", "12000000\n");
+  WriteValue(battery, "voltage_min_design", "11400000\n");
+  WriteValue(battery, "charge_full", "4000000\n");
+  WriteValue(battery, "charge_full_design", "4200000\n");
+  WriteValue(battery, "charge_now", "2000000\n");
+  WriteValue(battery, "current_now", "1000000\n");
+
+  const base::FilePath ac = root.Append("AC");
+  CHECK(base::CreateDirectory(ac));
+  WriteValue(ac, "type", "Mains\n");
+  WriteValue(ac, "online", "0\n");
+
+  for (const char* name : {"CROS_USB_PD_CHARGER0", "CROS_USB_PD_CHARGER1"}) {
+    const base::FilePath port = root.Append(name);
+    CHECK(base::CreateDirectory(port));
+    WriteValue(port, "type", "USB\n");
+    WriteValue(port, "online", "0\n");
+    WriteValue(port, "status", "Discharging\n");
+    WriteValue(port, "current_max", "0\n");
+    WriteValue(port, "voltage_max_design", "0\n");
+  }
+}
+
+// Prints the time and syscalls per sample since |start| and |start_stats|.
+void Report(const char* name,
+            base::TimeTicks start,
+            const power_manager::system::PowerSupplySampler::Stats& start_stats,
+            const power_manager::system::PowerSupplySampler::Stats& stats) {
+  const double elapsed_us = (base::TimeTicks::Now() - start).InMicrosecondsF();
+  printf("%-12s %10.1f %8.1f %8.1f %8.1f %8.1f\n", name,
+         elapsed_us / kNumSamples,
+         static_cast<double>(stats.directory_scans -
+                             start_stats.directory_scans) / kNumSamples,
+         static_cast<double>(stats.opens - start_stats.opens) / kNumSamples,
+         static_cast<double>(stats.reads - start_stats.reads) / kNumSamples,
+         static_cast<double>(stats.closes - start_stats.closes) / kNumSamples);
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  base::AtExitManager at_exit;
+  base::MessageLoopForIO message_loop;
+
+  base::ScopedTempDir temp_dir;
+  CHECK(temp_dir.CreateUniqueTempDir());
+  CreateSysfsTree(temp_dir.path());
+
+  power_manager::FakePrefs prefs;
+  prefs.SetInt64(power_manager::kMaxCurrentSamplesPref, 5);
+  prefs.SetInt64(power_manager::kMaxChargeSamplesPref, 5);
+  power_manager::system::UdevStub udev;
+  power_manager::system::PowerSupply power_supply;
+  power_manager::system::PowerSupply::TestApi test_api(&power_supply);
+  power_supply.Init(temp_dir.path(), &prefs, &udev, false);
+  const power_manager::system::PowerSupplySampler* sampler =
+      test_api.sampler();
+
+  printf("%-12s %10s %8s %8s %8s %8s\n", "update", "us", "scans", "opens",
+         "reads", "closes");
+
+  power_manager::system::PowerSupplySampler::Stats start_stats =
+      sampler->stats();
+  base::TimeTicks start = base::TimeTicks::Now();
+  for (int i = 0; i < kNumSamples; ++i)
+    CHECK(power_supply.RefreshImmediately());
+  Report("rediscover", start, start_stats, sampler->stats());
+
+  start_stats = sampler->stats();
+  start = base::TimeTicks::Now();
+  for (int i = 0; i < kNumSamples; ++i)
+    CHECK(test_api.TriggerPollTimeout());
+  Report("poll", start, start_stats, sampler->stats());
+
+  return 0;
+}
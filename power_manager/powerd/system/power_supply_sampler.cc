@@ -0,0 +1,147 @@
+// Copyright 2016 The Chromium OS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "power_manager/powerd/system/power_supply_sampler.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <utility>
+
+#include <base/files/file_enumerator.h>
+#include <base/logging.h>
+#include <base/posix/eintr_wrapper.h>
+#include <base/strings/string_number_conversions.h>
+#include <base/strings/string_util.h>
+
+namespace power_manager {
+namespace system {
+
+namespace {
+
+// sysfs attributes are never larger than a page.
+const size_t kMaxAttributeSize = 4096;
+
+// Factor that scales the integers that sysfs reports for non-integral values
+// back down.
+const double kDoubleScaleFactor = 0.000001;
+
+}  // namespace
+
+PowerSupplySampler::Stats::Stats()
+    : directory_scans(0), opens(0), reads(0), closes(0) {}
+
+PowerSupplySampler::PowerSupplySampler(const base::FilePath& power_supply_path)
+    : power_supply_path_(power_supply_path), scanned_(false) {}
+
+PowerSupplySampler::~PowerSupplySampler() {}
+
+void PowerSupplySampler::Invalidate() {
+  for (const auto& attribute : attributes_) {
+    if (attribute.second.is_valid())
+      stats_.closes++;
+  }
+  attributes_.clear();
+  supply_paths_.clear();
+  scanned_ = false;
+}
+
+const std::vector<base::FilePath>& PowerSupplySampler::GetSupplyPaths() {
+  if (!scanned_)
+    ScanSupplies();
+  return supply_paths_;
+}
+
+bool PowerSupplySampler::HasAttribute(const base::FilePath& dir,
+                                      const std::string& name) {
+  return GetFd(dir, name) >= 0;
+}
+
+bool PowerSupplySampler::ReadString(const base::FilePath& dir,
+                                    const std::string& name,
+                                    std::string* out) {
+  DCHECK(out);
+  const int fd = GetFd(dir, name);
+  if (fd < 0)
+    return false;
+
+  char buf[kMaxAttributeSize];
+  stats_.reads++;
+  const ssize_t size = HANDLE_EINTR(pread(fd, buf, sizeof(buf), 0));
+  if (size < 0) {
+    // The file may belong to a supply that has since been removed (ENODEV),
+    // so don't keep reading through it.
+    PLOG(WARNING) << "Unable to read " << dir.Append(name).value();
+    CloseFd(dir, name);
+    return false;
+  }
+
+  out->assign(buf, size);
+  base::TrimWhitespaceASCII(*out, base::TRIM_TRAILING, out);
+  return true;
+}
+
+bool PowerSupplySampler::ReadInt64(const base::FilePath& dir,
+                                   const std::string& name,
+                                   int64_t* out) {
+  std::string buffer;
+  if (!ReadString(dir, name, &buffer))
+    return false;
+  return base::StringToInt64(buffer, out);
+}
+
+double PowerSupplySampler::ReadScaledDouble(const base::FilePath& dir,
+                                            const std::string& name) {
+  int64_t value = 0;
+  return ReadInt64(dir, name, &value) ? kDoubleScaleFactor * value : 0.0;
+}
+
+int PowerSupplySampler::GetFd(const base::FilePath& dir,
+                              const std::string& name) {
+  DCHECK(power_supply_path_.IsParent(dir))
+      << dir.value() << " isn't a child of " << power_supply_path_.value();
+  const std::string path = dir.Append(name).value();
+  auto it = attributes_.find(path);
+  if (it == attributes_.end()) {
+    stats_.opens++;
+    base::ScopedFD fd(
+        HANDLE_EINTR(open(path.c_str(), O_RDONLY | O_CLOEXEC)));
+    // Only remember that the file is missing; other errors may not last.
+    if (!fd.is_valid() && errno != ENOENT) {
+      PLOG(WARNING) << "Unable to open " << path;
+      return -1;
+    }
+    it = attributes_.insert(std::make_pair(path, std::move(fd))).first;
+  }
+  return it->second.get();
+}
+
+void PowerSupplySampler::CloseFd(const base::FilePath& dir,
+                                 const std::string& name) {
+  auto it = attributes_.find(dir.Append(name).value());
+  if (it == attributes_.end())
+    return;
+  if (it->second.is_valid())
+    stats_.closes++;
+  attributes_.erase(it);
+}
+
+void PowerSupplySampler::ScanSupplies() {
+  stats_.directory_scans++;
+  supply_paths_.clear();
+  base::FileEnumerator file_enum(
+      power_supply_path_, false, base::FileEnumerator::DIRECTORIES);
+  for (base::FilePath path = file_enum.Next(); !path.empty();
+       path = file_enum.Next()) {
+    supply_paths_.push_back(path);
+  }
+  scanned_ = true;
+  VLOG(1) << "Found " << supply_paths_.size() << " power supply director"
+          << (supply_paths_.size() == 1 ? "y" : "ies") << " in "
+          << power_supply_path_.value();
+}
+
+}  // namespace system
+}  // namespace power_manager
@@ -0,0 +1,110 @@
+// Copyright 2016 The Chromium OS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef POWER_MANAGER_POWERD_SYSTEM_POWER_SUPPLY_SAMPLER_H_
+#define POWER_MANAGER_POWERD_SYSTEM_POWER_SUPPLY_SAMPLER_H_
+
+#include <stdint.h>
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include <base/files/file_path.h>
+#include <base/files/scoped_file.h>
+#include <base/macros.h>
+
+namespace power_manager {
+namespace system {
+
+// Reads the attributes of the power supplies in a sysfs directory like
+// /sys/class/power_supply.
+//
+// The supply directories are listed once and each attribute file is opened
+// the first time that it's read. The file stays open and later reads use
+// pread(), so sampling a supply again costs one syscall per attribute.
+// Attributes that didn't exist are remembered as missing. sysfs only adds or
+// removes a supply's attributes when the supply is added or removed, which
+// udev reports; Invalidate() should be called when that happens. Files that
+// fail to open for other reasons, or whose reads fail, are opened again the
+// next time that they're needed.
+class PowerSupplySampler {
+ public:
+  // Counts of the syscalls made by the sampler.
+  struct Stats {
+    Stats();
+
+    int64_t directory_scans;
+    int64_t opens;
+    int64_t reads;
+    int64_t closes;
+  };
+
+  explicit PowerSupplySampler(const base::FilePath& power_supply_path);
+  ~PowerSupplySampler();
+
+  const Stats& stats() const { return stats_; }
+
+  // Closes all attribute files and lists the supply directories again the
+  // next time that they're needed.
+  void Invalidate();
+
+  // Returns the supply directories, in the order that the kernel listed
+  // them.
+  const std::vector<base::FilePath>& GetSupplyPaths();
+
+  // Returns true if |name| exists within |dir|, a supply directory.
+  bool HasAttribute(const base::FilePath& dir, const std::string& name);
+
+  // Reads |name| within |dir| into |out|, trimming trailing whitespace.
+  // Returns true on success.
+  bool ReadString(const base::FilePath& dir,
+                  const std::string& name,
+                  std::string* out);
+
+  // Reads a 64-bit integer from |name| within |dir|. Returns true on success.
+  bool ReadInt64(const base::FilePath& dir,
+                 const std::string& name,
+                 int64_t* out);
+
+  // Reads an integer from |name| within |dir| and scales it down to a double.
+  // sysfs reports non-integral values such as voltages multiplied by 10^6.
+  // Returns 0.0 on failure.
+  double ReadScaledDouble(const base::FilePath& dir, const std::string& name);
+
+ private:
+  // Returns the FD of |name| within |dir|, opening the file if it hasn't
+  // been opened yet. Returns -1 if the file couldn't be opened.
+  int GetFd(const base::FilePath& dir, const std::string& name);
+
+  // Closes the file for |name| within |dir|, so that it's opened again the
+  // next time that it's needed.
+  void CloseFd(const base::FilePath& dir, const std::string& name);
+
+  // Lists the directories within |power_supply_path_| into |supply_paths_|.
+  void ScanSupplies();
+
+  // Base sysfs directory containing subdirectories corresponding to power
+  // supplies.
+  const base::FilePath power_supply_path_;
+
+  // Directories within |power_supply_path_|.
+  std::vector<base::FilePath> supply_paths_;
+
+  // True if |supply_paths_| is up-to-date.
+  bool scanned_;
+
+  // Map from attribute paths to their open files. Files that don't exist are
+  // stored with invalid FDs.
+  std::map<std::string, base::ScopedFD> attributes_;
+
+  Stats stats_;
+
+  DISALLOW_COPY_AND_ASSIGN(PowerSupplySampler);
+};
+
+}  // namespace system
+}  // namespace power_manager
+
+#endif  // POWER_MANAGER_POWERD_SYSTEM_POWER_SUPPLY_SAMPLER_H_
@@ -0,0 +1,122 @@
+// Copyright 2016 The Chromium OS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "power_manager/powerd/system/power_supply_sampler.h"
+
+#include <memory>
+#include <string>
+
+#include <base/files/file_util.h>
+#include <base/files/scoped_temp_dir.h>
+#include <gtest/gtest.h>
+
+namespace power_manager {
+namespace system {
+
+class PowerSupplySamplerTest : public ::testing::Test {
+ public:
+  PowerSupplySamplerTest() {}
+  ~PowerSupplySamplerTest() override {}
+
+  void SetUp() override {
+    ASSERT_TRUE(temp_dir_.CreateUniqueTempDir());
+    battery_dir_ = temp_dir_.path().Append("BAT0");
+    ASSERT_TRUE(base::CreateDirectory(battery_dir_));
+    sampler_.reset(new PowerSupplySampler(temp_dir_.path()));
+  }
+
+ protected:
+  // Writes |value| to |filename| within |dir|.
+  void WriteValue(const base::FilePath& dir,
+                  const std::string& filename,
+                  const std::string& value) {
+    ASSERT_EQ(static_cast<int>(value.size()),
+              base::WriteFile(dir.Append(filename), value.data(),
+                              value.size()));
+  }
+
+  base::ScopedTempDir temp_dir_;
+  base::FilePath battery_dir_;
+  std::unique_ptr<PowerSupplySampler> sampler_;
+};
+
+TEST_F(PowerSupplySamplerTest, ReadValues) {
+  WriteValue(battery_dir_, "status", "Charging\n");
+  WriteValue(battery_dir_, "voltage_now", "12500000\n");
+
+  ASSERT_EQ(1u, sampler_->GetSupplyPaths().size());
+  EXPECT_EQ(battery_dir_.value(), sampler_->GetSupplyPaths()[0].value());
+
+  std::string status;
+  EXPECT_TRUE(sampler_->ReadString(battery_dir_, "status", &status));
+  EXPECT_EQ("Charging", status);
+  int64_t voltage = 0;
+  EXPECT_TRUE(sampler_->ReadInt64(battery_dir_, "voltage_now", &voltage));
+  EXPECT_EQ(12500000, voltage);
+  EXPECT_DOUBLE_EQ(12.5,
+                   sampler_->ReadScaledDouble(battery_dir_, "voltage_now"));
+  EXPECT_FALSE(sampler_->ReadInt64(battery_dir_, "status", &voltage));
+  EXPECT_FALSE(sampler_->HasAttribute(battery_dir_, "current_now"));
+  EXPECT_DOUBLE_EQ(0.0,
+                   sampler_->ReadScaledDouble(battery_dir_, "current_now"));
+}
+
+TEST_F(PowerSupplySamplerTest, KeepFilesOpen) {
+  WriteValue(battery_dir_, "status", "Charging");
+  std::string status;
+  ASSERT_TRUE(sampler_->ReadString(battery_dir_, "status", &status));
+  EXPECT_EQ(1, sampler_->stats().opens);
+
+  // Later reads should see new values without opening the file again.
+  WriteValue(battery_dir_, "status", "Full");
+  ASSERT_TRUE(sampler_->ReadString(battery_dir_, "status", &status));
+  EXPECT_EQ("Full", status);
+  EXPECT_EQ(1, sampler_->stats().opens);
+  EXPECT_EQ(2, sampler_->stats().reads);
+
+  // Missing files should also only be checked once.
+  EXPECT_FALSE(sampler_->HasAttribute(battery_dir_, "current_now"));
+  WriteValue(battery_dir_, "current_now", "1000000");
+  EXPECT_FALSE(sampler_->HasAttribute(battery_dir_, "current_now"));
+  EXPECT_EQ(2, sampler_->stats().opens);
+
+  // After the sampler is invalidated, the supplies should be listed and the
+  // files opened again.
+  sampler_->GetSupplyPaths();
+  EXPECT_EQ(1, sampler_->stats().directory_scans);
+  sampler_->Invalidate();
+  EXPECT_EQ(1, sampler_->stats().closes);
+  EXPECT_TRUE(sampler_->HasAttribute(battery_dir_, "current_now"));
+  EXPECT_EQ(3, sampler_->stats().opens);
+  sampler_->GetSupplyPaths();
+  EXPECT_EQ(2, sampler_->stats().directory_scans);
+}
+
+TEST_F(PowerSupplySamplerTest, RetryFailedFiles) {
+  // Files that fail to open for reasons other than not existing shouldn't be
+  // remembered as missing.
+  const base::FilePath current_path = battery_dir_.Append("current_now");
+  ASSERT_TRUE(base::CreateSymbolicLink(current_path, current_path));
+  EXPECT_FALSE(sampler_->HasAttribute(battery_dir_, "current_now"));
+  ASSERT_TRUE(base::DeleteFile(current_path, false));
+  WriteValue(battery_dir_, "current_now", "1000000");
+  EXPECT_TRUE(sampler_->HasAttribute(battery_dir_, "current_now"));
+  EXPECT_EQ(2, sampler_->stats().opens);
+
+  // A file whose read fails should be closed and opened again next time.
+  const base::FilePath status_path = battery_dir_.Append("status");
+  ASSERT_TRUE(base::CreateDirectory(status_path));
+  std::string status;
+  EXPECT_FALSE(sampler_->ReadString(battery_dir_, "status", &status));
+  EXPECT_EQ(3, sampler_->stats().opens);
+  EXPECT_EQ(1, sampler_->stats().closes);
+  ASSERT_TRUE(base::DeleteFile(status_path, false));
+  WriteValue(battery_dir_, "status", "Full");
+  EXPECT_TRUE(sampler_->ReadString(battery_dir_, "status", &status));
+  EXPECT_EQ("Full", status);
+  EXPECT_EQ(4, sampler_->stats().opens);
+}
+
+}  // namespace system
+}  // namespace power_manager
@@ -20,6 +20,7 @@
 #include "power_manager/common/fake_prefs.h"
 #include "power_manager/common/power_constants.h"
 #include "power_manager/common/test_main_loop_runner.h"
+#include "power_manager/powerd/system/power_supply_sampler.h"
 #include "power_manager/powerd/system/udev_stub.h"
 #include "power_manager/proto_bindings/power_supply_properties.pb.h"
 
@@ -215,10 +216,10 @@ class PowerSupplyTest : public ::testing::Test {
     return success;
   }
 
-  // Sends a udev event to |power_supply_|.
-  void SendUdevEvent() {
-    power_supply_->OnUdevEvent(
-        PowerSupply::kUdevSubsystem, "AC", UdevAction::CHANGE);
+  // Sends a udev event to |power_supply_| and runs the resulting update.
+  void SendUdevEvent(UdevAction action = UdevAction::CHANGE) {
+    power_supply_->OnUdevEvent(PowerSupply::kUdevSubsystem, "AC", action);
+    ASSERT_TRUE(test_api_->TriggerUdevEventTimeout());
   }
 
   FakePrefs prefs_;
@@ -1434,7 +1435,7 @@ TEST_F(PowerSupplyTest, IgnoreSpuriousUdevEvents) {
   WriteValue(dir, "online", "1");
   WriteValue(dir, "status", kNotCharging);
   UpdateChargeAndCurrent(kCharge, kHighCurrent);
-  SendUdevEvent();
+  SendUdevEvent(UdevAction::ADD);
   EXPECT_EQ(0, observer.num_updates());
   EXPECT_EQ(MakeEstimateString(false, 0, kLowCurrentSec),
             GetEstimateStringFromStatus(power_supply_->GetPowerStatus()));
@@ -1459,6 +1460,72 @@ TEST_F(PowerSupplyTest, IgnoreSpuriousUdevEvents) {
   power_supply_->RemoveObserver(&observer);
 }
 
+TEST_F(PowerSupplyTest, CoalesceUdevEvents) {
+  TestObserver observer;
+  power_supply_->AddObserver(&observer);
+  WriteDefaultValues(PowerSource::AC);
+  Init();
+  ASSERT_TRUE(power_supply_->RefreshImmediately());
+
+  // A burst of events should result in a single update once the timer fires.
+  UpdatePowerSourceAndBatteryStatus(
+      PowerSource::BATTERY, kAcType, kDischarging);
+  for (int i = 0; i < 5; ++i) {
+    power_supply_->OnUdevEvent(
+        PowerSupply::kUdevSubsystem, "AC", UdevAction::CHANGE);
+  }
+  EXPECT_EQ(0, observer.num_updates());
+  EXPECT_TRUE(power_supply_->GetPowerStatus().line_power_on);
+  ASSERT_TRUE(test_api_->TriggerUdevEventTimeout());
+  EXPECT_EQ(1, observer.num_updates());
+  EXPECT_FALSE(power_supply_->GetPowerStatus().line_power_on);
+  EXPECT_FALSE(test_api_->TriggerUdevEventTimeout());
+
+  // Events received while suspended should be ignored.
+  power_supply_->SetSuspended(true);
+  power_supply_->OnUdevEvent(
+      PowerSupply::kUdevSubsystem, "AC", UdevAction::CHANGE);
+  EXPECT_FALSE(test_api_->TriggerUdevEventTimeout());
+
+  power_supply_->RemoveObserver(&observer);
+}
+
+TEST_F(PowerSupplyTest, ReuseSysfsFiles) {
+  WriteDefaultValues(PowerSource::AC);
+  Init();
+  PowerStatus status;
+  ASSERT_TRUE(UpdateStatus(&status));
+  const PowerSupplySampler::Stats initial_stats =
+      test_api_->sampler()->stats();
+
+  // Polling should reread the files that are already open without listing or
+  // opening anything.
+  UpdatePowerSourceAndBatteryStatus(
+      PowerSource::BATTERY, kAcType, kDischarging);
+  ASSERT_TRUE(test_api_->TriggerPollTimeout());
+  EXPECT_FALSE(power_supply_->GetPowerStatus().line_power_on);
+  const PowerSupplySampler::Stats& stats = test_api_->sampler()->stats();
+  EXPECT_EQ(initial_stats.directory_scans, stats.directory_scans);
+  EXPECT_EQ(initial_stats.opens, stats.opens);
+  EXPECT_GT(stats.reads, initial_stats.reads);
+
+  // A supply that shows up along with a udev "add" event should be found.
+  const base::FilePath usb_dir = temp_dir_.path().Append("usb");
+  ASSERT_TRUE(base::CreateDirectory(usb_dir));
+  WriteValue(usb_dir, "type", kUsbType);
+  WriteValue(usb_dir, "online", "1");
+  SendUdevEvent(UdevAction::ADD);
+  status = power_supply_->GetPowerStatus();
+  EXPECT_TRUE(status.line_power_on);
+  EXPECT_EQ(kUsbType, status.line_power_type);
+  EXPECT_EQ(initial_stats.directory_scans + 1, stats.directory_scans);
+
+  // Its removal should also be noticed.
+  ASSERT_TRUE(base::DeleteFile(usb_dir, true));
+  SendUdevEvent(UdevAction::REMOVE);
+  EXPECT_FALSE(power_supply_->GetPowerStatus().line_power_on);
+}
+
 TEST_F(PowerSupplyTest, CopyPowerStatusToProtocolBuffer) {
   // Start out with a status indicating that the system is charging.
   PowerStatus status;
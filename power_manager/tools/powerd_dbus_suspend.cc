@@ -8,9 +8,11 @@
 // This tool will block and only exit after it has received a D-Bus
 // resume signal from powerd.
 
+#include <stdio.h>
 #include <unistd.h>
 
 #include <memory>
+#include <string>
 
 #include <base/at_exit.h>
 #include <base/bind.h>
@@ -27,6 +29,8 @@
 #include <dbus/message.h>
 #include <dbus/object_proxy.h>
 
+#include "power_manager/common/power_constants.h"
+
 namespace {
 
 // The sysfs entry that controls RTC wake alarms.  To set an alarm, write
@@ -52,6 +56,19 @@ void OnTimeout() {
              << " signal within the timeout.";
 }
 
+// Asks powerd for the timing of recent suspend requests and prints it.
+void PrintSuspendTrace(dbus::ObjectProxy* powerd_proxy) {
+  dbus::MethodCall method_call(power_manager::kPowerManagerInterface,
+                               power_manager::kGetSuspendTraceMethod);
+  std::unique_ptr<dbus::Response> response(powerd_proxy->CallMethodAndBlock(
+      &method_call, dbus::ObjectProxy::TIMEOUT_USE_DEFAULT));
+  CHECK(response) << power_manager::kGetSuspendTraceMethod << " failed";
+  std::string trace;
+  dbus::MessageReader reader(response.get());
+  CHECK(reader.PopString(&trace)) << "Unable to read suspend trace";
+  printf("%s", trace.c_str());
+}
+
 }  // namespace
 
 int main(int argc, char* argv[]) {
@@ -71,6 +88,10 @@ int main(int argc, char* argv[]) {
                "RTC alarm timeout in seconds.  Sets an RTC "
                "alarm that fires after the given interval.  Useful "
                "to ensure that device resumes while testing remotely.");
+  DEFINE_bool(print_trace,
+              false,
+              "Print the time that powerd spent in each phase of recent "
+              "suspend requests after resuming.");
 
   brillo::FlagHelper::Init(
       argc, argv, "Instruct powerd to suspend the system.");
@@ -122,5 +143,8 @@ int main(int argc, char* argv[]) {
   }
 
   base::RunLoop().Run();
+
+  if (FLAGS_print_trace)
+    PrintSuspendTrace(powerd_proxy);
   return 0;
 }